@@ -1,5 +1,7 @@
 #include "IApp.hpp"
+#include "frame_profiler.hpp"
 #include "shellapi.h"
+#include <algorithm>
 #include <stdexcept>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -107,40 +109,89 @@ int IApp::run()
 
 	startup();
 
-	MSG msg = {};
 	bool running = true;
 	while (running && !quitting())
 	{
-		/*while*/ if (::PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
+		// blocks until a message arrives when idle, otherwise until the next
+		// frame slot
+		DWORD timeout = INFINITE;
+		if (needs_frame() && !::IsIconic(m_hwnd))
 		{
-			::TranslateMessage(&msg);
-			::DispatchMessage(&msg);
-			if (msg.message == WM_QUIT)
-				running = false;
+			const auto now = clock::now();
+			timeout = now < m_next_frame_time
+				? (DWORD)std::chrono::ceil<std::chrono::milliseconds>(m_next_frame_time - now).count()
+				: 0;
 		}
 
-		if (running)
+		if (timeout)
+			::MsgWaitForMultipleObjectsEx(0, nullptr, timeout, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+
+		running = dispatch_messages();
+		if (!running)
+			break;
+
+		// minimized: nothing to present
+		if (!needs_frame() || ::IsIconic(m_hwnd))
+			continue;
+
+		const auto frame_time = clock::now();
+		if (frame_time < m_next_frame_time)
+			continue;
+
+		// the frame interval depends on what keeps the loop awake
+		const bool interactive = m_input_frames || s_redraw_requested || is_animating()
+			|| ImGui::GetIO().WantTextInput;
+		const uint32_t fps = interactive ? m_max_fps : m_background_fps;
+		m_next_frame_time = fps ? frame_time + std::chrono::microseconds(1000000 / fps) : frame_time;
+
+		s_redraw_requested = false;
+		if (m_input_frames)
+			--m_input_frames;
+
+		auto& profiler = frame_profiler::get();
+		cp::scoped_span_sink profiler_sink(profiler.begin_frame());
+
+		ImGui_ImplDX11_NewFrame();
+		ImGui_ImplWin32_NewFrame();
+		ImGui::NewFrame();
+		ImGuizmo::BeginFrame();
+
 		{
-			ImGui_ImplDX11_NewFrame();
-			ImGui_ImplWin32_NewFrame();
-			ImGui::NewFrame();
-			ImGuizmo::BeginFrame();
+			cp::scoped_span span("app.upload_decoded_textures");
+			upload_decoded_textures();
+		}
 
+		{
+			cp::scoped_span span("app.update");
 			update();
+		}
 
+		{
+			cp::scoped_span span("app.draw_imgui");
 			draw_imgui();
+		}
 
+		{
+			cp::scoped_span span("app.render");
 			ImGui::Render();
 			m_devctx->OMSetRenderTargets(1, m_rtv.GetAddressOf(), NULL);
 			m_devctx->ClearRenderTargetView(m_rtv.Get(), (float*)&m_bg_color);
 			ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+		}
 
+		{
+			cp::scoped_span span("app.present");
 			d3d_present();
 		}
+
+		profiler.end_frame();
 	}
 
 	cleanup();
 
+	// textures must be released before the device
+	stop_texture_workers();
+
 	DragAcceptFiles(m_hwnd, FALSE);
 
 	ImGui_ImplDX11_Shutdown();
@@ -154,6 +205,52 @@ int IApp::run()
 	return 0;
 }
 
+bool IApp::dispatch_messages()
+{
+	MSG msg = {};
+	while (::PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
+	{
+		if (msg.message == WM_QUIT)
+			return false;
+
+		::TranslateMessage(&msg);
+		::DispatchMessage(&msg);
+		m_input_frames = m_frames_after_input;
+	}
+	return true;
+}
+
+bool IApp::needs_frame() const
+{
+	return m_input_frames
+		|| s_redraw_requested
+		|| s_background_jobs_cnt > 0
+		|| is_animating()
+		|| ImGui::GetIO().WantTextInput; // caret blinking
+}
+
+void IApp::request_redraw()
+{
+	s_redraw_requested = true;
+
+	// wakes the main loop up
+	IApp* app = g_runningApp;
+	if (app && app->m_hwnd)
+		::PostMessage(app->m_hwnd, WM_NULL, 0, 0);
+}
+
+void IApp::begin_background_job()
+{
+	++s_background_jobs_cnt;
+	request_redraw();
+}
+
+void IApp::end_background_job()
+{
+	--s_background_jobs_cnt;
+	request_redraw();
+}
+
 LRESULT IApp::window_proc(UINT message, WPARAM wParam, LPARAM lParam)
 {
 	switch (message)
@@ -263,17 +360,8 @@ void IApp::d3d_cleanup_rtv()
 	m_rtv.Reset();
 }
 
-std::shared_ptr<AppImage> IApp::load_texture_from_file(const std::string& filename)
+ComPtr<ID3D11ShaderResourceView> IApp::create_texture(const unsigned char* rgba, int w, int h)
 {
-	if (!m_device)
-		return {};
-
-	int w = 0, h = 0;
-	// Load from disk into a raw RGBA buffer
-	unsigned char* image_data = stbi_load(filename.c_str(), &w, &h, NULL, 4);
-	if (image_data == NULL)
-		return {};
-
 	ComPtr<ID3D11ShaderResourceView> tex;
 
 	// Create texture
@@ -291,10 +379,11 @@ std::shared_ptr<AppImage> IApp::load_texture_from_file(const std::string& filena
 
 	ComPtr<ID3D11Texture2D> texture;
 	D3D11_SUBRESOURCE_DATA subResource;
-	subResource.pSysMem = image_data;
+	subResource.pSysMem = rgba;
 	subResource.SysMemPitch = desc.Width * 4;
 	subResource.SysMemSlicePitch = 0;
-	m_device->CreateTexture2D(&desc, &subResource, &texture);
+	if (FAILED(m_device->CreateTexture2D(&desc, &subResource, &texture)))
+		return {};
 
 	// Create texture view
 	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
@@ -305,8 +394,164 @@ std::shared_ptr<AppImage> IApp::load_texture_from_file(const std::string& filena
 	srvDesc.Texture2D.MostDetailedMip = 0;
 	m_device->CreateShaderResourceView(texture.Get(), &srvDesc, &tex);
 
+	return tex;
+}
+
+std::shared_ptr<AppImage> IApp::load_texture_from_file(const std::string& filename)
+{
+	if (!m_device)
+		return {};
+
+	int w = 0, h = 0;
+	// Load from disk into a raw RGBA buffer
+	unsigned char* image_data = stbi_load(filename.c_str(), &w, &h, NULL, 4);
+	if (image_data == NULL)
+		return {};
+
+	ComPtr<ID3D11ShaderResourceView> tex = create_texture(image_data, w, h);
 	stbi_image_free(image_data);
 
+	if (!tex)
+		return {};
+
 	return std::make_shared<AppImage>(tex, w, h);
 }
 
+std::shared_ptr<AppImage> IApp::load_texture_async(const std::string& filename)
+{
+	if (!m_device)
+		return {};
+
+	auto it = m_texture_cache_map.find(filename);
+	if (it != m_texture_cache_map.end())
+	{
+		m_texture_cache.splice(m_texture_cache.begin(), m_texture_cache, it->second);
+		return it->second->img;
+	}
+
+	auto img = std::make_shared<AppImage>();
+	m_texture_cache.push_front(texture_cache_entry{filename, img, 0});
+	m_texture_cache_map.emplace(filename, m_texture_cache.begin());
+
+	{
+		std::lock_guard<std::mutex> lock(m_texture_jobs_mtx);
+		while (m_texture_workers.size() < m_texture_workers_cnt)
+			m_texture_workers.emplace_back(&IApp::texture_worker, this);
+		m_texture_jobs.push_back(texture_job{filename, img});
+	}
+	m_texture_jobs_cv.notify_one();
+
+	return img;
+}
+
+void IApp::texture_worker()
+{
+	std::unique_lock<std::mutex> lock(m_texture_jobs_mtx);
+	while (true)
+	{
+		m_texture_jobs_cv.wait(lock, [this]() { return m_stop_texture_workers || !m_texture_jobs.empty(); });
+		if (m_stop_texture_workers)
+			break;
+
+		texture_job job = std::move(m_texture_jobs.front());
+		m_texture_jobs.pop_front();
+
+		// evicted and unused
+		if (job.img.expired())
+			continue;
+
+		lock.unlock();
+		job.rgba = stbi_load(job.filename.c_str(), &job.w, &job.h, NULL, 4);
+		lock.lock();
+
+		// failures are uploaded too, to be dropped from the cache
+		m_decoded_textures.push_back(std::move(job));
+		request_redraw();
+	}
+}
+
+void IApp::upload_decoded_textures()
+{
+	std::vector<texture_job> jobs;
+	{
+		std::lock_guard<std::mutex> lock(m_texture_jobs_mtx);
+		const size_t cnt = std::min<size_t>(m_decoded_textures.size(), m_texture_uploads_per_frame);
+		if (!cnt)
+			return;
+
+		jobs.assign(
+			std::make_move_iterator(m_decoded_textures.begin()),
+			std::make_move_iterator(m_decoded_textures.begin() + cnt));
+		m_decoded_textures.erase(m_decoded_textures.begin(), m_decoded_textures.begin() + cnt);
+
+		// the rest is for the next frames
+		if (!m_decoded_textures.empty())
+			request_redraw();
+	}
+
+	for (auto& job : jobs)
+	{
+		auto img = job.img.lock();
+		auto it = m_texture_cache_map.find(job.filename);
+		const bool cached = it != m_texture_cache_map.end() && it->second->img == img;
+
+		if (img && job.rgba)
+		{
+			img->tex = create_texture(job.rgba, job.w, job.h);
+			img->w = job.w;
+			img->h = job.h;
+		}
+
+		if (job.rgba)
+			stbi_image_free(job.rgba);
+
+		if (!cached)
+			continue;
+
+		if (!img || !img->ready())
+		{
+			// decoding failed, the next request retries
+			m_texture_cache.erase(it->second);
+			m_texture_cache_map.erase(it);
+			continue;
+		}
+
+		it->second->size = (size_t)img->w * img->h * 4;
+		m_texture_cache_size += it->second->size;
+	}
+
+	// the most recent entry is kept even if it is over budget
+	while (m_texture_cache_size > m_texture_cache_budget && m_texture_cache.size() > 1)
+	{
+		auto& entry = m_texture_cache.back();
+		m_texture_cache_size -= entry.size;
+		m_texture_cache_map.erase(entry.filename);
+		m_texture_cache.pop_back();
+	}
+}
+
+void IApp::stop_texture_workers()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_texture_jobs_mtx);
+		m_stop_texture_workers = true;
+	}
+	m_texture_jobs_cv.notify_all();
+
+	for (auto& t : m_texture_workers)
+		t.join();
+	m_texture_workers.clear();
+
+	for (auto& job : m_decoded_textures)
+	{
+		if (job.rgba)
+			stbi_image_free(job.rgba);
+	}
+	m_decoded_textures.clear();
+	m_texture_jobs.clear();
+
+	m_texture_cache.clear();
+	m_texture_cache_map.clear();
+	m_texture_cache_size = 0;
+}
+
@@ -4,6 +4,14 @@
 #endif
 
 #include "pch.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 #include "imgui/imgui.h"
 #include "imgui/imgui_internal.h"
@@ -52,8 +60,12 @@ struct scoped_imgui_button_hue {
 
 #define WINDOW_STYLE WS_OVERLAPPEDWINDOW
 
+// an image loaded with IApp::load_texture_async has no texture until it is
+// uploaded by the main loop, a placeholder is drawn meanwhile
 class AppImage
 {
+	friend class IApp;
+
 private:
 	ComPtr<ID3D11ShaderResourceView> tex;
 	int w, h;
@@ -62,8 +74,27 @@ public:
 	AppImage(const ComPtr<ID3D11ShaderResourceView>& tex, int w, int h)
 		: tex(tex), w(w), h(h) {}
 
+	// pending image
+	AppImage()
+		: w(0), h(0) {}
+
+	bool ready() const { return !!tex; }
+
 	void draw(ImVec2 size = {0, 0}, bool rescale=true)
 	{
+		if (!tex)
+		{
+			// the size isn't known yet, square if not given
+			if (size.x <= 0)
+				size.x = size.y > 0 ? size.y : 64.f;
+			if (size.y <= 0)
+				size.y = size.x;
+			const ImVec2 pos = ImGui::GetCursorScreenPos();
+			ImGui::GetWindowDrawList()->AddRectFilled(pos, pos + size, ImGui::GetColorU32(ImGuiCol_FrameBg));
+			ImGui::Dummy(size);
+			return;
+		}
+
 		if (size.x <= 0)
 		{
 			size.x = (float)w;
@@ -90,6 +121,18 @@ public:
 	virtual LRESULT window_proc(UINT msg, WPARAM wParam, LPARAM lParam);
 	HWND get_hwnd() { return m_hwnd; }
 
+	// Frame scheduling: when idle (no input for a few frames, no animation,
+	// no background job) the main loop blocks on window messages instead of
+	// rendering every vsync.
+	// These can be called from any thread.
+
+	// renders at least one more frame (e.g. a job has new results to show)
+	static void request_redraw();
+	// while jobs are running frames are rendered at m_background_fps
+	// (progress bars), the end of a job requests a redraw
+	static void begin_background_job();
+	static void end_background_job();
+
 protected:
 	virtual void startup() = 0;
 	virtual void cleanup() = 0;
@@ -97,12 +140,21 @@ protected:
 	virtual void draw_imgui() = 0;
 	virtual void on_resized() {};
 	virtual bool quitting() const { return false; }
+	// true to keep rendering (capped at m_max_fps) while nothing else happens
+	virtual bool is_animating() const { return false; }
 	virtual bool has_file_drop() const { return false; }
 	virtual void on_file_drop(std::wstring fpath) {};
 
 public:
 	std::shared_ptr<AppImage> load_texture_from_file(const std::string& filename);
 
+	// Decodes the image on a worker thread and returns a pending image right
+	// away, the main loop uploads decoded images (a few per frame).
+	// Images are cached by filename up to m_texture_cache_budget bytes, least
+	// recently requested ones are evicted first (images still referenced
+	// elsewhere stay alive).
+	std::shared_ptr<AppImage> load_texture_async(const std::string& filename);
+
 private:
 	bool d3d_init();
 	void d3d_fini();
@@ -111,6 +163,16 @@ private:
 	void d3d_create_rtv();
 	void d3d_cleanup_rtv();
 
+	// returns false on WM_QUIT
+	bool dispatch_messages();
+	bool needs_frame() const;
+
+	ComPtr<ID3D11ShaderResourceView> create_texture(const unsigned char* rgba, int w, int h);
+
+	void texture_worker();
+	void upload_decoded_textures();
+	void stop_texture_workers();
+
 private:
 	ComPtr<ID3D11Device> m_device;
 	ComPtr<ID3D11DeviceContext> m_devctx;
@@ -121,12 +183,62 @@ private:
 	ComPtr<IDCompositionVisual> m_dcomp_visual;
 	HANDLE m_swapchain_waitable_object;
 
+	using clock = std::chrono::steady_clock;
+
+	static inline std::atomic<bool> s_redraw_requested = true;
+	static inline std::atomic<int> s_background_jobs_cnt = 0;
+
+	// frames still to render after the last input, imgui needs a couple of
+	// frames to settle (hover states, popups closing..)
+	uint32_t m_input_frames = 0;
+	clock::time_point m_next_frame_time = {};
+
+	// asynchronous textures (see load_texture_async)
+	struct texture_job
+	{
+		std::string filename;
+		std::weak_ptr<AppImage> img;
+		unsigned char* rgba = nullptr; // stbi allocated
+		int w = 0, h = 0;
+	};
+
+	std::mutex m_texture_jobs_mtx;
+	std::condition_variable m_texture_jobs_cv;
+	std::deque<texture_job> m_texture_jobs; // to decode
+	std::vector<texture_job> m_decoded_textures; // to upload
+	std::vector<std::thread> m_texture_workers;
+	bool m_stop_texture_workers = false;
+
+	// most recently requested first
+	struct texture_cache_entry
+	{
+		std::string filename;
+		std::shared_ptr<AppImage> img;
+		size_t size = 0; // 0 until uploaded
+	};
+
+	std::list<texture_cache_entry> m_texture_cache;
+	std::unordered_map<std::string, std::list<texture_cache_entry>::iterator> m_texture_cache_map;
+	size_t m_texture_cache_size = 0;
+
 protected:
 	std::wstring m_wndname = L"IApp";
 	HWND m_hwnd = 0;
 	uint32_t m_display_width = 1280;
 	uint32_t m_display_height = 800;
 	ImVec4 m_bg_color = ImVec4(0.2f, 0.2f, 0.3f, 1.f);
+
+	// 0 means vsync only
+	uint32_t m_max_fps = 0;
+	// rate while only background jobs are running
+	uint32_t m_background_fps = 20;
+	// frames rendered after each input
+	uint32_t m_frames_after_input = 3;
+	// cached decoded images, in bytes of texture memory
+	size_t m_texture_cache_budget = 128 << 20;
+	// uploads are spread over frames
+	uint32_t m_texture_uploads_per_frame = 4;
+	uint32_t m_texture_workers_cnt = 2;
 };
 
 #define CREATE_APPLICATION(app_class) \
@@ -1,18 +1,214 @@
 #include <imgui/imgui.h>
 #include <imgui/imgui_internal.h>
 #include <cctype>
+#include <cstring>
 #include <vector>
 #include <set>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 #include <future>
+#include <thread>
+#include <cpinternals/common/task_scheduler.hpp>
 
 // https://github.com/HasKha/GWToolboxpp
 
 namespace ImGui {
 
+  using combo_matches = std::shared_ptr<const std::vector<int>>;
+
+  // Substring search over a fixed list of item texts.
+  // Candidates of a query are the shortest posting list among its trigrams,
+  // or the results of a cached query it contains when there are fewer (typing
+  // refines the previous query), they are then checked with strstr.
+  // The trigrams are indexed in the background once the index is created.
+  class combo_index
+  {
+  public:
+    static constexpr size_t max_cached_queries = 64;
+
+    combo_index(std::vector<const char*> texts, int first_item)
+      : m_texts(std::move(texts)), m_first_item(first_item)
+    {
+      m_build.run([this]() { build(); });
+    }
+
+    size_t items_count() const { return m_first_item + m_texts.size(); }
+    int first_item() const { return m_first_item; }
+
+    // returns the sorted indices of the matching items,
+    // null if cancelled (cancelled() is polled while checking candidates)
+    template <typename CancelledFn>
+    combo_matches query(const std::string& word, CancelledFn&& cancelled)
+    {
+      // the build runs here if it didn't start yet
+      while (!m_build.is_done())
+      {
+        if (cancelled())
+          return nullptr;
+        if (!m_build.try_run_one())
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+
+      const std::vector<int>* candidates = nullptr;
+      combo_matches refined;
+      {
+        std::lock_guard<std::mutex> lock(m_cache_mtx);
+        auto it = m_cache.find(word);
+        if (it != m_cache.end())
+        {
+          it->second.last_use = ++m_uses;
+          return it->second.matches;
+        }
+
+        // smallest results of a query contained in word
+        for (const auto& [cached_word, entry] : m_cache)
+        {
+          if (word.find(cached_word) != std::string::npos
+            && (!refined || entry.matches->size() < refined->size()))
+          {
+            refined = entry.matches;
+          }
+        }
+      }
+      candidates = refined.get();
+
+      if (word.size() >= 3)
+      {
+        for (size_t i = 0; i + 3 <= word.size(); ++i)
+        {
+          auto it = m_trigrams.find(trigram_key(word.data() + i));
+          if (it == m_trigrams.end())
+            return store(word, std::vector<int>());
+          if (!candidates || it->second.size() < candidates->size())
+            candidates = &it->second;
+        }
+      }
+
+      std::vector<int> ret;
+      const char* search_cstr = word.c_str();
+
+      const auto check = [&](int idx, size_t n) -> bool
+      {
+        if ((n & 0xFFF) == 0 && cancelled())
+          return false;
+        if (strstr(m_texts[idx - m_first_item], search_cstr) != nullptr)
+          ret.push_back(idx);
+        return true;
+      };
+
+      if (candidates)
+      {
+        for (size_t n = 0; n < candidates->size(); ++n)
+        {
+          if (!check((*candidates)[n], n))
+            return nullptr;
+        }
+      }
+      else
+      {
+        for (size_t n = 0; n < m_texts.size(); ++n)
+        {
+          if (!check(static_cast<int>(n) + m_first_item, n))
+            return nullptr;
+        }
+      }
+
+      return store(word, std::move(ret));
+    }
+
+  protected:
+    struct cache_entry
+    {
+      combo_matches matches;
+      uint64_t last_use = 0;
+    };
+
+    static uint32_t trigram_key(const char* s)
+    {
+      return (uint32_t)(uint8_t)s[0] | ((uint32_t)(uint8_t)s[1] << 8) | ((uint32_t)(uint8_t)s[2] << 16);
+    }
+
+    void build()
+    {
+      for (size_t n = 0; n < m_texts.size(); ++n)
+      {
+        const int idx = static_cast<int>(n) + m_first_item;
+        const char* s = m_texts[n];
+        const size_t len = strlen(s);
+        for (size_t i = 0; i + 3 <= len; ++i)
+        {
+          // items are indexed in order, a repeated trigram is the last entry
+          auto& postings = m_trigrams[trigram_key(s + i)];
+          if (postings.empty() || postings.back() != idx)
+            postings.push_back(idx);
+        }
+      }
+    }
+
+    combo_matches store(const std::string& word, std::vector<int> matches)
+    {
+      auto ret = std::make_shared<const std::vector<int>>(std::move(matches));
+
+      std::lock_guard<std::mutex> lock(m_cache_mtx);
+      if (m_cache.size() >= max_cached_queries)
+      {
+        auto oldest = m_cache.begin();
+        for (auto it = m_cache.begin(); it != m_cache.end(); ++it)
+        {
+          if (it->second.last_use < oldest->second.last_use)
+            oldest = it;
+        }
+        m_cache.erase(oldest);
+      }
+      m_cache[word] = cache_entry{ret, ++m_uses};
+      return ret;
+    }
+
+    const std::vector<const char*> m_texts;
+    const int m_first_item;
+
+    std::unordered_map<uint32_t, std::vector<int>> m_trigrams;
+
+    std::mutex m_cache_mtx;
+    std::map<std::string, cache_entry> m_cache;
+    uint64_t m_uses = 0;
+
+    // last member, its destruction waits for build()
+    cp::task_group m_build{cp::task_priority::background};
+  };
+
+  // one index per items_key, rebuilt when the items count changes
+  static std::shared_ptr<combo_index> get_combo_index(
+    const void* items_key, bool(*items_getter)(void*, int, const char**),
+    void* data, int items_count, int first_item)
+  {
+    static std::map<const void*, std::shared_ptr<combo_index>> indices;
+
+    auto& index = indices[items_key];
+    if (index && index->items_count() == (size_t)items_count && index->first_item() == first_item)
+      return index;
+
+    std::vector<const char*> texts;
+    texts.reserve(items_count > first_item ? items_count - first_item : 0);
+    for (int i = first_item; i < items_count; ++i)
+    {
+      const char* item_text = "";
+      items_getter(data, i, &item_text);
+      texts.push_back(item_text);
+    }
+
+    index = std::make_shared<combo_index>(std::move(texts), first_item);
+    return index;
+  }
+
   [[nodiscard]] bool BetterCombo(
     const char* label, int* current_item,
     bool(*items_getter)(void*, int, const char**), 
-    void* data, int items_count)
+    void* data, int items_count,
+    const void* items_key, int first_indexed_item)
   {
     ImGuiContext& g = *ImGui::GetCurrentContext();
     ImGuiWindow* window = GetCurrentWindow();
@@ -29,11 +225,12 @@ namespace ImGui {
     // keyboard_selected will stay as-is when re-opening the combo, or even others.
     static int keyboard_selected = -1;
   
-    static std::vector<int> filtered_indices;
+    // results are shared with the cache of the index
+    static combo_matches filtered_indices;
     static bool filtered = false;
 
     static std::atomic<size_t> task_uid = 0;
-    static std::future<std::vector<int>> task_future;
+    static std::future<combo_matches> task_future;
 
     static ImGuiID last_id = 0;
 
@@ -49,8 +246,8 @@ namespace ImGui {
       word[0] = '\0';
       last_id = id;
       task_uid++;
-      task_future = std::future<std::vector<int>>();
-      filtered_indices.clear();
+      task_future = std::future<combo_matches>();
+      filtered_indices.reset();
       filtered = false;
     }
 
@@ -106,7 +303,35 @@ namespace ImGui {
 
     if (update_keyboard_match)
     {
-      if (word[0] != '\0')
+      if (word[0] != '\0' && items_key)
+      {
+        // unindexed items are checked here, their texts may not outlive the call
+        std::vector<int> unindexed;
+        for (int i = 0; i < first_indexed_item && i < items_count; ++i)
+        {
+          const char* item_text;
+          if (items_getter(data, i, &item_text) && strstr(item_text, word) != nullptr)
+          {
+            unindexed.push_back(i);
+          }
+        }
+
+        auto index = get_combo_index(items_key, items_getter, data, items_count, first_indexed_item);
+        task_uid++;
+        task_future = cp::task_scheduler::get().async(
+          [index = std::move(index), unindexed = std::move(unindexed), search = std::string(word), self_uid = task_uid.load()]() mutable -> combo_matches
+          {
+            combo_matches matches = index->query(search, [&]() { return self_uid != task_uid.load(); });
+            if (!matches || unindexed.empty())
+              return matches;
+
+            unindexed.insert(unindexed.end(), matches->begin(), matches->end());
+            return std::make_shared<const std::vector<int>>(std::move(unindexed));
+          },
+          cp::task_priority::high
+        );
+      }
+      else if (word[0] != '\0')
       {
         std::vector<const char*> in;
         for (int i = 0; i < items_count; ++i)
@@ -118,8 +343,8 @@ namespace ImGui {
           }
         }
         task_uid++;
-        task_future = std::async(
-          [](std::vector<const char*> in, std::string search, size_t self_uid, std::atomic<size_t>& uid) -> std::vector<int>
+        task_future = cp::task_scheduler::get().async(
+          [in = std::move(in), search = std::string(word), self_uid = task_uid.load()]() -> combo_matches
           {
             std::vector<int> ret;
 
@@ -128,10 +353,9 @@ namespace ImGui {
             int i = 0;
             for (auto& s : in)
             {
-              if (self_uid != uid.load())
+              if (self_uid != task_uid.load())
               {
-                ret.clear();
-                return {};
+                return nullptr;
               }
 
               if (strstr(s, search_cstr) != nullptr)
@@ -142,28 +366,29 @@ namespace ImGui {
               i++;
             }
 
-            return ret;
+            return std::make_shared<const std::vector<int>>(std::move(ret));
           },
-          std::move(in),
-          std::string(word),
-          task_uid.load(),
-          std::ref(task_uid)
+          cp::task_priority::high
         );
       }
       else
       {
         task_uid++;
-        task_future = std::future<std::vector<int>>();
-        filtered_indices.clear();
+        task_future = std::future<combo_matches>();
+        filtered_indices.reset();
         filtered = false;
       }
     }
 
     if (task_future.valid() && task_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
     {
-      filtered = true;
-      filtered_indices = task_future.get();
-      if (filtered_indices.size())
+      // a cancelled task returns null, a newer one is running
+      if (combo_matches matches = task_future.get())
+      {
+        filtered = true;
+        filtered_indices = std::move(matches);
+      }
+      if (filtered && filtered_indices->size())
       {
         keyboard_selected = 0;
         keyboard_selected_now = true;
@@ -172,20 +397,18 @@ namespace ImGui {
   
     // Display items
     bool value_changed = false;
-    auto it = filtered_indices.begin();
-    int last_valid_i = 0;
 
     ImGuiListClipper clipper;
 
-    clipper.Begin(filtered ? (int)filtered_indices.size() : items_count);
+    clipper.Begin(filtered ? (int)filtered_indices->size() : items_count);
 
-    int last_j = filtered_indices.size() ? filtered_indices[0] : 0;
+    int last_j = (filtered && filtered_indices->size()) ? (*filtered_indices)[0] : 0;
 
     while (clipper.Step())
     {
       for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
       {
-        int j = filtered ? filtered_indices[i] : i;
+        int j = filtered ? (*filtered_indices)[i] : i;
 
         PushID((void*)(intptr_t)j);
 
@@ -2,9 +2,16 @@
 
 namespace ImGui {
 
+  // items_key: when not null, items [first_indexed_item, items_count) are
+  // searched through a substring index shared by all the combos passing the
+  // same key (e.g. &TweakDBID_resolver::get().sorted_names(), a stable
+  // sorted_names_list). their texts must stay valid and unchanged as long
+  // as items_count doesn't change.
+  // items before first_indexed_item (e.g. the current value) are scanned.
   bool BetterCombo(
 		const char* label, int* current_item,
 		bool(*items_getter)(void*, int, const char**), 
-		void* data, int items_count);
+		void* data, int items_count,
+		const void* items_key = nullptr, int first_indexed_item = 0);
 
 }
\ No newline at end of file
@@ -28,14 +28,20 @@ SOFTWARE.
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cstring>
 #include <filesystem>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
+#include <system_error>
+#include <thread>
 #include <vector>
 
 #include <cpinternals/utils.hpp>
+#include <appbase/IApp.hpp>
 
 
 #ifndef IMGUI_VERSION
@@ -69,6 +75,8 @@ public:
 
   FileBrowser &operator=(const FileBrowser &copyFrom);
 
+  ~FileBrowser();
+
   // set the window size (in pixels)
   // default is (700, 450)
   void SetWindowSize(int width, int height) noexcept;
@@ -133,6 +141,72 @@ private:
 
   void SetPwdUncatched(const std::filesystem::path &pwd);
 
+  struct FileRecord
+  {
+    bool isDir = false;
+    std::filesystem::path name;
+    std::string showName;
+    std::filesystem::path extension;
+  };
+
+  // directories first, then by name
+  static bool RecordLess(const FileRecord &L, const FileRecord &R);
+
+  // pwd_ is listed by a background thread (network shares can take seconds),
+  // entries are streamed into fileRecords_ by PollListing() each frame.
+  // the thread is detached and only holds the shared state, so a stuck
+  // enumeration never blocks the ui.
+  struct Listing
+  {
+    std::filesystem::path dir;
+    std::atomic<bool> cancel = false;
+    std::atomic<bool> done = false;
+    std::mutex mtx;
+    std::vector<FileRecord> pending; // guarded by mtx
+    std::string error;               // guarded by mtx
+  };
+
+  static constexpr size_t LISTING_BATCH_SIZE = 256;
+
+  static void ListDirectory(Listing &listing);
+  void StartListing();
+  void CancelListing();
+  void PollListing();
+
+  // listed directories, reused while their change notification isn't
+  // signaled (the current one is listed again when it is)
+  struct DirCache
+  {
+    DirCache() = default;
+    DirCache(const DirCache &) = delete;
+    DirCache &operator=(const DirCache &) = delete;
+
+    ~DirCache()
+    {
+      UnwatchDirectory(watch);
+    }
+
+    std::vector<FileRecord> records;
+    void *watch = nullptr;
+    bool complete = false; // records is a full listing
+    std::uint64_t lastUse = 0;
+  };
+
+  static constexpr size_t DIR_CACHE_SIZE = 16;
+
+  void EvictDirCache();
+
+  // returns nullptr if the directory can't be watched (it is then never
+  // cached). HasDirectoryChanged re-arms the notification when it returns
+  // true, before the directory is listed again.
+  static void *WatchDirectory(const std::filesystem::path &dir);
+  static bool HasDirectoryChanged(void *watch);
+  static void UnwatchDirectory(void *watch);
+
+  // indices of the records passing the filters, the list view only submits
+  // the visible ones
+  void UpdateShownRecords();
+
 #ifdef _WIN32
   static std::uint32_t GetDrivesBitMask();
 #endif
@@ -164,14 +238,15 @@ private:
   std::filesystem::path pwd_;
   std::set<std::filesystem::path> selectedFilenames_;
 
-  struct FileRecord
-  {
-    bool isDir = false;
-    std::filesystem::path name;
-    std::string showName;
-    std::filesystem::path extension;
-  };
   std::vector<FileRecord> fileRecords_;
+  std::shared_ptr<Listing> listing_;
+
+  std::map<std::filesystem::path, DirCache> dirCache_;
+  std::uint64_t dirCacheUses_ = 0;
+
+  std::vector<size_t> shownRecords_;
+  bool shownRecordsDirty_ = true;
+  int shownTypeFilterIndex_ = -1;
 
   // IMPROVE: truncate when selectedFilename_.length() > inputNameBuf_.size() - 1
   static constexpr size_t INPUT_NAME_BUF_SIZE = 512;
@@ -181,7 +256,7 @@ private:
   std::unique_ptr<std::array<char, INPUT_NAME_BUF_SIZE>> newDirNameBuf_;
 
 #ifdef _WIN32
-  uint32_t drives_;
+  uint32_t drives_ = 0; // probed when the drive combo is opened
 #endif
 };
 } // namespace ImGui
@@ -202,10 +277,6 @@ inline ImGui::FileBrowser::FileBrowser(ImGuiFileBrowserFlags flags)
 
   typeFilters_.clear();
   typeFilterIndex_ = 0;
-
-#ifdef _WIN32
-  drives_ = GetDrivesBitMask();
-#endif
 }
 
 inline ImGui::FileBrowser::FileBrowser(const FileBrowser &copyFrom)
@@ -229,7 +300,11 @@ inline ImGui::FileBrowser &ImGui::FileBrowser::operator=(
   pwd_ = copyFrom.pwd_;
   selectedFilenames_ = copyFrom.selectedFilenames_;
 
+  // the copy doesn't share the listing nor the cache
+  CancelListing();
+  dirCache_.clear();
   fileRecords_ = copyFrom.fileRecords_;
+  shownRecordsDirty_ = true;
 
   *inputNameBuf_ = *copyFrom.inputNameBuf_;
 
@@ -243,6 +318,11 @@ inline ImGui::FileBrowser &ImGui::FileBrowser::operator=(
   return *this;
 }
 
+inline ImGui::FileBrowser::~FileBrowser()
+{
+  CancelListing();
+}
+
 inline void ImGui::FileBrowser::SetWindowSize(int width, int height) noexcept
 {
   assert(width > 0 && height > 0);
@@ -321,6 +401,8 @@ inline void ImGui::FileBrowser::Display()
   isOpened_ = true;
   ScopeGuard endPopup([] { EndPopup(); });
 
+  PollListing();
+
   // display elements in pwd
 
 #ifdef _WIN32
@@ -345,6 +427,8 @@ inline void ImGui::FileBrowser::Display()
   if(BeginCombo("##select_drive", driveStr))
   {
     ScopeGuard guard([&] { ImGui::EndCombo(); });
+    if(IsWindowAppearing())
+      drives_ = GetDrivesBitMask();
     for(int i = 0; i < 26; ++i)
     {
       if(!(drives_ & (1 << i)))
@@ -403,7 +487,10 @@ inline void ImGui::FileBrowser::Display()
   SameLine();
 
   if(SmallButton("*"))
+  {
+    dirCache_.erase(pwd_);
     SetPwd(pwd_);
+  }
 
   if(newDirNameBuf_)
   {
@@ -448,81 +535,83 @@ inline void ImGui::FileBrowser::Display()
       ImGuiWindowFlags_AlwaysHorizontalScrollbar : 0);
     ScopeGuard endChild([] { EndChild(); });
 
-    for(auto &rsc : fileRecords_)
-    {
-      if (!rsc.isDir && typeFilters_.size() > 0 &&
-        static_cast<size_t>(typeFilterIndex_) < typeFilters_.size() &&
-        !(rsc.extension == typeFilters_[typeFilterIndex_]))
-        continue;
-
-      if(!rsc.name.empty() && rsc.name.c_str()[0] == '$')
-        continue;
+    UpdateShownRecords();
 
-      bool selected = selectedFilenames_.find(rsc.name)
-        != selectedFilenames_.end();
-
-      if(Selectable(rsc.showName.c_str(), selected,
-        ImGuiSelectableFlags_DontClosePopups))
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<int>(shownRecords_.size()));
+    while(clipper.Step())
+    {
+      for(int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
       {
-        const bool multiSelect =
-          (flags_ & ImGuiFileBrowserFlags_MultipleSelection) &&
-          IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows) &&
-          (GetIO().KeyCtrl || GetIO().KeyShift);
+        auto &rsc = fileRecords_[shownRecords_[i]];
 
-        if(selected)
-        {
-          if(!multiSelect)
-            selectedFilenames_.clear();
-          else
-            selectedFilenames_.erase(rsc.name);
+        bool selected = selectedFilenames_.find(rsc.name)
+          != selectedFilenames_.end();
 
-          (*inputNameBuf_)[0] = '\0';
-        }
-        else if(rsc.name != "..")
+        if(Selectable(rsc.showName.c_str(), selected,
+          ImGuiSelectableFlags_DontClosePopups))
         {
-          if((rsc.isDir && (flags_ & ImGuiFileBrowserFlags_SelectDirectory)) ||
-            (!rsc.isDir && !(flags_ & ImGuiFileBrowserFlags_SelectDirectory)))
+          const bool multiSelect =
+            (flags_ & ImGuiFileBrowserFlags_MultipleSelection) &&
+            IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows) &&
+            (GetIO().KeyCtrl || GetIO().KeyShift);
+
+          if(selected)
           {
             if(!multiSelect)
               selectedFilenames_.clear();
-            selectedFilenames_.insert(rsc.name);
-            if(!(flags_ & ImGuiFileBrowserFlags_SelectDirectory))
+            else
+              selectedFilenames_.erase(rsc.name);
+
+            (*inputNameBuf_)[0] = '\0';
+          }
+          else if(rsc.name != "..")
+          {
+            if((rsc.isDir && (flags_ & ImGuiFileBrowserFlags_SelectDirectory)) ||
+              (!rsc.isDir && !(flags_ & ImGuiFileBrowserFlags_SelectDirectory)))
             {
+              if(!multiSelect)
+                selectedFilenames_.clear();
+              selectedFilenames_.insert(rsc.name);
+              if(!(flags_ & ImGuiFileBrowserFlags_SelectDirectory))
+              {
 #ifdef _MSC_VER
-              strcpy_s(
-                inputNameBuf_->data(), inputNameBuf_->size(),
-                u8StrToStr(rsc.name.u8string()).c_str());
+                strcpy_s(
+                  inputNameBuf_->data(), inputNameBuf_->size(),
+                  u8StrToStr(rsc.name.u8string()).c_str());
 #else
-              std::strncpy(inputNameBuf_->data(),
-                u8StrToStr(rsc.name.u8string()).c_str(),
-                inputNameBuf_->size() - 1);
+                std::strncpy(inputNameBuf_->data(),
+                  u8StrToStr(rsc.name.u8string()).c_str(),
+                  inputNameBuf_->size() - 1);
 #endif
+              }
             }
           }
+          else
+          {
+            if(!multiSelect)
+              selectedFilenames_.clear();
+          }
         }
-        else
-        {
-          if(!multiSelect)
-            selectedFilenames_.clear();
-        }
-      }
 
-      if(IsItemClicked(0) && IsMouseDoubleClicked(0))
-      {
-        if(rsc.isDir)
-        {
-          setNewPwd = true;
-          newPwd = (rsc.name != "..") ? (pwd_ / rsc.name) :
-            pwd_.parent_path();
-        }
-        else if(!(flags_ & ImGuiFileBrowserFlags_SelectDirectory))
+        if(IsItemClicked(0) && IsMouseDoubleClicked(0))
         {
-          selectedFilenames_ = { rsc.name };
-          ok_ = true;
-          CloseCurrentPopup();
+          if(rsc.isDir)
+          {
+            setNewPwd = true;
+            newPwd = (rsc.name != "..") ? (pwd_ / rsc.name) :
+              pwd_.parent_path();
+          }
+          else if(!(flags_ & ImGuiFileBrowserFlags_SelectDirectory))
+          {
+            selectedFilenames_ = { rsc.name };
+            ok_ = true;
+            CloseCurrentPopup();
+          }
         }
       }
     }
+    clipper.End();
   }
 
   if(setNewPwd)
@@ -574,6 +663,11 @@ inline void ImGui::FileBrowser::Display()
     SameLine();
     Text("%s", statusStr_.c_str());
   }
+  else if(listing_ && !(flags_ & ImGuiFileBrowserFlags_NoStatusBar))
+  {
+    SameLine();
+    TextDisabled("listing... (%d entries)", int(fileRecords_.size()) - 1);
+  }
 
   if(!typeFilters_.empty())
   {
@@ -648,19 +742,84 @@ inline void ImGui::FileBrowser::SetTypeFilters(
 {
   typeFilters_ = typeFilters;
   typeFilterIndex_ = 0;
+  shownRecordsDirty_ = true;
 }
 
 inline void ImGui::FileBrowser::SetPwdUncatched(const std::filesystem::path &pwd)
 {
-  fileRecords_ = { FileRecord{ true, "..", "[D] ..", "" } };
+  const std::filesystem::path dir = absolute(pwd);
+  if(!is_directory(dir))
+  {
+    throw std::filesystem::filesystem_error("not a directory", dir,
+      std::make_error_code(std::errc::not_a_directory));
+  }
+
+  CancelListing();
+  pwd_ = dir;
+  selectedFilenames_.clear();
+  (*inputNameBuf_)[0] = '\0';
+  shownRecordsDirty_ = true;
 
-  for(auto &p : std::filesystem::directory_iterator(pwd))
+  auto &cache = dirCache_[pwd_];
+  cache.lastUse = ++dirCacheUses_;
+  if(!cache.watch)
   {
+    // watched before being listed so that no change is missed
+    cache.watch = WatchDirectory(pwd_);
+    cache.complete = false;
+  }
+
+  if(cache.complete && !HasDirectoryChanged(cache.watch))
+  {
+    fileRecords_ = cache.records;
+    return;
+  }
+
+  cache.complete = false;
+  StartListing();
+  EvictDirCache();
+}
+
+inline bool ImGui::FileBrowser::RecordLess(
+  const FileRecord &L, const FileRecord &R)
+{
+  return (L.isDir ^ R.isDir) ? L.isDir : (L.name < R.name);
+}
+
+inline void ImGui::FileBrowser::ListDirectory(Listing &listing)
+{
+  std::vector<FileRecord> batch;
+  batch.reserve(LISTING_BATCH_SIZE);
+
+  const auto flush = [&]
+  {
+    std::lock_guard<std::mutex> lock(listing.mtx);
+    if(listing.pending.empty())
+      listing.pending.swap(batch);
+    else
+    {
+      std::move(batch.begin(), batch.end(),
+        std::back_inserter(listing.pending));
+      batch.clear();
+    }
+  };
+
+  std::error_code ec;
+  std::filesystem::directory_iterator it(listing.dir, ec), end;
+  for(; !ec && it != end; it.increment(ec))
+  {
+    if(listing.cancel)
+      return;
+
+    // the attributes come with the enumeration, no extra stat
+    const auto &p = *it;
+    std::error_code statEc;
+
     FileRecord rcd;
 
-    if(p.is_regular_file())
+    if(p.is_regular_file(statEc))
       rcd.isDir = false;
-    else if(p.is_directory())
+    else if(p.is_directory(statEc))
       rcd.isDir = true;
     else
       continue;
@@ -673,18 +832,151 @@ inline void ImGui::FileBrowser::SetPwdUncatched(const std::filesystem::path &pwd
 
     rcd.showName = (rcd.isDir ? "[D] " : "[F] ") +
       u8StrToStr(p.path().filename().u8string());
-    fileRecords_.push_back(rcd);
+    batch.push_back(std::move(rcd));
+
+    if(batch.size() >= LISTING_BATCH_SIZE)
+      flush();
   }
 
-  std::sort(fileRecords_.begin(), fileRecords_.end(),
-    [](const FileRecord &L, const FileRecord &R)
+  flush();
+  if(ec)
   {
-    return (L.isDir ^ R.isDir) ? L.isDir : (L.name < R.name);
-  });
+    std::lock_guard<std::mutex> lock(listing.mtx);
+    listing.error = ec.message();
+  }
+  listing.done = true;
+}
 
-  pwd_ = absolute(pwd);
-  selectedFilenames_.clear();
-  (*inputNameBuf_)[0] = '\0';
+inline void ImGui::FileBrowser::StartListing()
+{
+  CancelListing();
+
+  fileRecords_ = { FileRecord{ true, "..", "[D] ..", "" } };
+  shownRecordsDirty_ = true;
+
+  listing_ = std::make_shared<Listing>();
+  listing_->dir = pwd_;
+
+  // keeps the app rendering while entries are streamed in
+  IApp::begin_background_job();
+  std::thread([listing = listing_]
+  {
+    ListDirectory(*listing);
+    IApp::end_background_job();
+  }).detach();
+}
+
+inline void ImGui::FileBrowser::CancelListing()
+{
+  if(listing_)
+  {
+    listing_->cancel = true;
+    listing_.reset();
+  }
+}
+
+inline void ImGui::FileBrowser::PollListing()
+{
+  if(!listing_)
+  {
+    // the shown directory changed, list it again
+    auto it = dirCache_.find(pwd_);
+    if(it != dirCache_.end() && it->second.complete &&
+      HasDirectoryChanged(it->second.watch))
+    {
+      it->second.complete = false;
+      StartListing();
+    }
+    return;
+  }
+
+  // done is read first, entries flushed before it was set are taken below
+  const bool done = listing_->done;
+
+  std::vector<FileRecord> batch;
+  std::string error;
+  {
+    std::lock_guard<std::mutex> lock(listing_->mtx);
+    batch.swap(listing_->pending);
+    error = listing_->error;
+  }
+
+  if(!batch.empty())
+  {
+    // ".." stays first, batches are merged into the sorted records
+    std::sort(batch.begin(), batch.end(), RecordLess);
+    const size_t mid = fileRecords_.size();
+    std::move(batch.begin(), batch.end(), std::back_inserter(fileRecords_));
+    std::inplace_merge(fileRecords_.begin() + 1,
+      fileRecords_.begin() + mid, fileRecords_.end(), RecordLess);
+    shownRecordsDirty_ = true;
+  }
+
+  if(!done)
+    return;
+
+  listing_.reset();
+
+  auto it = dirCache_.find(pwd_);
+  if(!error.empty())
+  {
+    statusStr_ = "last error: " + error;
+    if(it != dirCache_.end())
+      dirCache_.erase(it);
+  }
+  else if(it != dirCache_.end())
+  {
+    if(!it->second.watch)
+      dirCache_.erase(it);
+    else
+    {
+      it->second.records = fileRecords_;
+      it->second.complete = true;
+    }
+  }
+}
+
+inline void ImGui::FileBrowser::EvictDirCache()
+{
+  while(dirCache_.size() > DIR_CACHE_SIZE)
+  {
+    auto oldest = dirCache_.end();
+    for(auto it = dirCache_.begin(); it != dirCache_.end(); ++it)
+    {
+      if(it->first != pwd_ &&
+        (oldest == dirCache_.end() || it->second.lastUse < oldest->second.lastUse))
+        oldest = it;
+    }
+    if(oldest == dirCache_.end())
+      break;
+    dirCache_.erase(oldest);
+  }
+}
+
+inline void ImGui::FileBrowser::UpdateShownRecords()
+{
+  if(!shownRecordsDirty_ && shownTypeFilterIndex_ == typeFilterIndex_)
+    return;
+
+  shownRecordsDirty_ = false;
+  shownTypeFilterIndex_ = typeFilterIndex_;
+
+  shownRecords_.clear();
+  shownRecords_.reserve(fileRecords_.size());
+  for(size_t i = 0; i < fileRecords_.size(); ++i)
+  {
+    const auto &rsc = fileRecords_[i];
+
+    if (!rsc.isDir && typeFilters_.size() > 0 &&
+      static_cast<size_t>(typeFilterIndex_) < typeFilters_.size() &&
+      !(rsc.extension == typeFilters_[typeFilterIndex_]))
+      continue;
+
+    if(!rsc.name.empty() && rsc.name.c_str()[0] == '$')
+      continue;
+
+    shownRecords_.push_back(i);
+  }
 }
 
 #if defined(__cpp_lib_char8_t)
@@ -735,4 +1027,43 @@ inline std::uint32_t ImGui::FileBrowser::GetDrivesBitMask()
   return ret;
 }
 
+inline void *ImGui::FileBrowser::WatchDirectory(const std::filesystem::path &dir)
+{
+  HANDLE handle = FindFirstChangeNotificationW(dir.c_str(), FALSE,
+    FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME);
+  return handle == INVALID_HANDLE_VALUE ? nullptr : handle;
+}
+
+inline bool ImGui::FileBrowser::HasDirectoryChanged(void *watch)
+{
+  if(!watch)
+    return true;
+  if(WaitForSingleObject(watch, 0) != WAIT_OBJECT_0)
+    return false;
+  FindNextChangeNotification(watch);
+  return true;
+}
+
+inline void ImGui::FileBrowser::UnwatchDirectory(void *watch)
+{
+  if(watch)
+    FindCloseChangeNotification(watch);
+}
+
+#else
+
+inline void *ImGui::FileBrowser::WatchDirectory(const std::filesystem::path &)
+{
+  return nullptr;
+}
+
+inline bool ImGui::FileBrowser::HasDirectoryChanged(void *)
+{
+  return true;
+}
+
+inline void ImGui::FileBrowser::UnwatchDirectory(void *)
+{
+}
+
 #endif
@@ -0,0 +1,256 @@
+#include "frame_profiler.hpp"
+#include <fstream>
+#include <unordered_map>
+#include "IApp.hpp"
+
+frame_profiler::frame_profiler()
+{
+  static constexpr char default_export_path[] = "frames_trace.json";
+  m_export_path.assign(default_export_path, default_export_path + sizeof(default_export_path));
+  m_export_path.resize(260);
+}
+
+cp::span_sink* frame_profiler::begin_frame()
+{
+  m_in_frame = false;
+  if (!m_enabled || m_paused)
+    return nullptr;
+
+  auto& f = m_frames[m_frames_recorded % frames_cnt];
+  f.index = m_frames_recorded;
+  f.zones.clear(); // keeps the arena
+  f.start = clock::now();
+  f.duration_us = 0;
+  f.allocs_cnt = cp::current_allocs_count();
+
+  m_in_frame = true;
+  return this;
+}
+
+void frame_profiler::end_frame()
+{
+  if (!m_in_frame)
+    return;
+
+  auto& f = m_frames[m_frames_recorded % frames_cnt];
+  f.duration_us = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - f.start).count();
+  f.allocs_cnt = cp::current_allocs_count() - f.allocs_cnt;
+
+  // spans are reported on completion (children before their parent)
+  std::stable_sort(f.zones.begin(), f.zones.end(), [](const zone& a, const zone& b) {
+    return a.begin_us != b.begin_us ? a.begin_us < b.begin_us : a.depth < b.depth;
+  });
+
+  ++m_frames_recorded;
+  m_in_frame = false;
+}
+
+void frame_profiler::on_span(const cp::span_record& rec)
+{
+  if (!m_in_frame)
+    return;
+
+  auto& f = m_frames[m_frames_recorded % frames_cnt];
+  const int64_t end_us = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - f.start).count();
+  const int64_t duration_us = static_cast<int64_t>(rec.duration_ms * 1000.);
+
+  f.zones.push_back(zone{rec.name, std::string(rec.label), rec.depth,
+    std::max<int64_t>(0, end_us - duration_us), duration_us, rec.allocs_cnt});
+}
+
+const frame_profiler::frame* frame_profiler::last_frame() const
+{
+  if (!m_frames_recorded)
+    return nullptr;
+  return &m_frames[(m_frames_recorded - 1) % frames_cnt];
+}
+
+void frame_profiler::draw_window(bool* p_open)
+{
+  ImGui::SetNextWindowSize(ImVec2(700, 500), ImGuiCond_FirstUseEver);
+  if (!ImGui::Begin("frame profiler", p_open))
+  {
+    ImGui::End();
+    return;
+  }
+
+  ImGui::Checkbox("enabled", &m_enabled);
+  ImGui::SameLine();
+  ImGui::Checkbox("pause", &m_paused);
+  ImGui::SameLine();
+  ImGui::SetNextItemWidth(250);
+  ImGui::InputText("##export_path", m_export_path.data(), m_export_path.size());
+  ImGui::SameLine();
+  if (ImGui::Button("export chrome trace"))
+    export_chrome_trace(m_export_path.data());
+
+  const frame* last = last_frame();
+  if (!last)
+  {
+    ImGui::Text("no frame recorded");
+    ImGui::End();
+    return;
+  }
+
+  // frame times
+  std::vector<float> durations_ms;
+  durations_ms.reserve(frames_cnt);
+  for_each_frame([&](const frame& f) {
+    durations_ms.push_back(f.duration_us / 1000.f);
+  });
+
+  float max_ms = 0.f;
+  for (float ms : durations_ms)
+    max_ms = std::max(max_ms, ms);
+
+  ImGui::Text("frame %llu: %.2f ms, %llu allocs (max %.2f ms over %d frames)",
+    (unsigned long long)last->index, last->duration_us / 1000.f,
+    (unsigned long long)last->allocs_cnt, max_ms, (int)durations_ms.size());
+  ImGui::PlotHistogram("##frames", durations_ms.data(), (int)durations_ms.size(),
+    0, nullptr, 0.f, max_ms, ImVec2(-1, 60));
+
+  // per frame cost of zones, by name (a name can be used by several zones of
+  // a frame, e.g. one per editor)
+  struct zone_stats
+  {
+    int64_t total_us = 0;
+    int64_t max_us = 0;
+    uint64_t total_allocs = 0;
+  };
+
+  std::unordered_map<const char*, zone_stats> stats;
+  size_t frames_with_zones = 0;
+  for_each_frame([&](const frame& f) {
+    std::unordered_map<const char*, zone_stats> frame_stats;
+    for (const auto& z : f.zones)
+    {
+      auto& s = frame_stats[z.name];
+      s.total_us += z.duration_us;
+      s.total_allocs += z.allocs_cnt;
+    }
+    for (const auto& [name, fs] : frame_stats)
+    {
+      auto& s = stats[name];
+      s.total_us += fs.total_us;
+      s.max_us = std::max(s.max_us, fs.total_us);
+      s.total_allocs += fs.total_allocs;
+    }
+    ++frames_with_zones;
+  });
+
+  // zones of the last frame, with the stats of their name
+  static ImGuiTableFlags tbl_flags = ImGuiTableFlags_Resizable | ImGuiTableFlags_RowBg
+    | ImGuiTableFlags_BordersOuter | ImGuiTableFlags_ScrollY;
+
+  if (ImGui::BeginTable("zones", 6, tbl_flags))
+  {
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableSetupColumn("zone", ImGuiTableColumnFlags_WidthStretch);
+    ImGui::TableSetupColumn("ms", ImGuiTableColumnFlags_WidthFixed, 60.f);
+    ImGui::TableSetupColumn("allocs", ImGuiTableColumnFlags_WidthFixed, 60.f);
+    ImGui::TableSetupColumn("avg ms/frame", ImGuiTableColumnFlags_WidthFixed, 90.f);
+    ImGui::TableSetupColumn("max ms/frame", ImGuiTableColumnFlags_WidthFixed, 90.f);
+    ImGui::TableSetupColumn("avg allocs/frame", ImGuiTableColumnFlags_WidthFixed, 110.f);
+    ImGui::TableHeadersRow();
+
+    const float indent = ImGui::GetStyle().IndentSpacing * 0.5f;
+    const float frames = (float)std::max<size_t>(frames_with_zones, 1);
+
+    ImGuiListClipper clipper;
+    clipper.Begin((int)last->zones.size());
+    while (clipper.Step())
+    {
+      for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+      {
+        const auto& z = last->zones[i];
+        const auto& s = stats[z.name];
+
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::SetCursorPosX(ImGui::GetCursorPosX() + indent * z.depth);
+        if (z.label.empty())
+          ImGui::TextUnformatted(z.name);
+        else
+          ImGui::Text("%s (%s)", z.name, z.label.c_str());
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", z.duration_us / 1000.f);
+        ImGui::TableNextColumn();
+        ImGui::Text("%llu", (unsigned long long)z.allocs_cnt);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", s.total_us / 1000.f / frames);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", s.max_us / 1000.f);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f", s.total_allocs / frames);
+      }
+    }
+    clipper.End();
+
+    ImGui::EndTable();
+  }
+
+  ImGui::End();
+}
+
+namespace {
+
+void write_json_string(std::ostream& os, const char* s)
+{
+  os << '"';
+  for (; *s; ++s)
+  {
+    const char c = *s;
+    if (c == '"' || c == '\\')
+      os << '\\' << c;
+    else if (static_cast<unsigned char>(c) < 0x20)
+      os << ' ';
+    else
+      os << c;
+  }
+  os << '"';
+}
+
+} // namespace
+
+bool frame_profiler::export_chrome_trace(const std::filesystem::path& path) const
+{
+  std::ofstream ofs(path);
+  if (!ofs.is_open())
+    return false;
+
+  clock::time_point origin = {};
+  bool first = true;
+
+  ofs << "{\"traceEvents\":[";
+  for_each_frame([&](const frame& f) {
+    if (first)
+      origin = f.start;
+
+    const int64_t frame_ts = std::chrono::duration_cast<std::chrono::microseconds>(f.start - origin).count();
+
+    ofs << (first ? "\n" : ",\n");
+    first = false;
+    ofs << "{\"name\":\"frame " << f.index << "\",\"ph\":\"X\",\"pid\":0,\"tid\":0"
+        << ",\"ts\":" << frame_ts << ",\"dur\":" << f.duration_us
+        << ",\"args\":{\"allocs\":" << f.allocs_cnt << "}}";
+
+    for (const auto& z : f.zones)
+    {
+      ofs << ",\n{\"name\":";
+      write_json_string(ofs, z.name);
+      ofs << ",\"ph\":\"X\",\"pid\":0,\"tid\":0"
+          << ",\"ts\":" << frame_ts + z.begin_us << ",\"dur\":" << z.duration_us
+          << ",\"args\":{\"allocs\":" << z.allocs_cnt;
+      if (!z.label.empty())
+      {
+        ofs << ",\"label\":";
+        write_json_string(ofs, z.label.c_str());
+      }
+      ofs << "}}";
+    }
+  });
+  ofs << "\n]}\n";
+
+  return ofs.good();
+}
+
@@ -0,0 +1,105 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <cpinternals/common/instrumentation.hpp>
+
+// Frame profiler
+// span sink of the main loop (see cp::scoped_span): the spans reported by
+// the main thread during a frame (widgets, but also cpinternals code run by
+// them) are recorded into a per-frame arena (vectors reused from frame to
+// frame) kept in a ring buffer of the last frames_cnt frames.
+// allocation counts are recorded if the program installs a counter (see
+// cp::set_allocs_counter).
+//
+//  void draw()
+//  {
+//    cp::scoped_span span("my_widget::draw");
+//    ..
+//  }
+//
+// draw_window() shows the spans of the last frame and per-frame stats by
+// span name, the ring can be exported to the Chrome trace format
+// (chrome://tracing).
+class frame_profiler
+  : public cp::span_sink
+{
+public:
+  static constexpr size_t frames_cnt = 256;
+
+  using clock = std::chrono::steady_clock;
+
+  struct zone
+  {
+    const char* name; // static string
+    std::string label;
+    uint32_t depth;
+    int64_t begin_us; // since the start of the frame
+    int64_t duration_us;
+    uint64_t allocs_cnt;
+  };
+
+  struct frame
+  {
+    uint64_t index = 0;
+    clock::time_point start = {};
+    int64_t duration_us = 0;
+    uint64_t allocs_cnt = 0;
+    std::vector<zone> zones; // in begin order
+  };
+
+private:
+  frame_profiler();
+
+public:
+  frame_profiler(const frame_profiler&) = delete;
+  frame_profiler& operator=(const frame_profiler&) = delete;
+
+  static frame_profiler& get()
+  {
+    static frame_profiler s;
+    return s;
+  }
+
+  bool enabled() const { return m_enabled; }
+  void set_enabled(bool enabled) { m_enabled = enabled; }
+
+  // called by the main loop (see IApp::run), returns the sink to install on
+  // the main thread for the frame or nullptr if frames aren't recorded
+  cp::span_sink* begin_frame();
+  void end_frame();
+
+  void on_span(const cp::span_record& rec) override;
+
+  // last complete frame, nullptr if there is none
+  const frame* last_frame() const;
+
+  // frames from oldest to newest
+  template <typename Fn>
+  void for_each_frame(Fn&& fn) const
+  {
+    const size_t cnt = static_cast<size_t>(std::min<uint64_t>(m_frames_recorded, frames_cnt));
+    for (size_t i = 0; i < cnt; ++i)
+      fn(m_frames[(m_frames_recorded - cnt + i) % frames_cnt]);
+  }
+
+  void draw_window(bool* p_open = nullptr);
+
+  // writes the recorded frames in Chrome trace event format
+  bool export_chrome_trace(const std::filesystem::path& path) const;
+
+protected:
+  bool m_enabled = true;
+
+  std::array<frame, frames_cnt> m_frames;
+  uint64_t m_frames_recorded = 0; // complete frames
+  bool m_in_frame = false;
+
+  bool m_paused = false; // overlay: frozen view
+  std::vector<char> m_export_path;
+};
+
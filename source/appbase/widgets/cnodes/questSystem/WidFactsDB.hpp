@@ -1,9 +1,12 @@
 #pragma once
 #include <inttypes.h>
+#include <utility>
 #include <appbase/IApp.hpp>
 #include <appbase/extras/imgui_better_combo.hpp>
 #include "cpinternals/csav/nodes/questSystem/FactsDB.hpp"
 #include <appbase/widgets/cpinternals.hpp>
+#include <appbase/widgets/virtual_list.hpp>
+#include <appbase/widgets/view_cache.hpp>
 
 namespace UI {
 
@@ -11,35 +14,54 @@ struct WidFactsTable
 {
   // returns true if content has been edited
   [[nodiscard]] static inline bool draw(cp::csav::FactsTable& x, const char* label)
+  {
+    return draw(std::as_const(x), label, [&x]() -> cp::csav::FactsTable& { return x; });
+  }
+
+  // x is only read, get_mutable() is called to apply an edit
+  template <typename GetMutable>
+  [[nodiscard]] static inline bool draw(const cp::csav::FactsTable& x, const char* label, GetMutable&& get_mutable)
   {
     ImGuiWindow* window = ImGui::GetCurrentWindow();
     if (window->SkipItems)
       return false;
 
-    scoped_imgui_id _sii(&x);
+    scoped_imgui_id _sii((void*)&x);
     bool modified = false;
 
-    auto& facts = x.facts();
-
     static ImGuiTableFlags tbl_flags =
       ImGuiTableFlags_BordersOuter | ImGuiTableFlags_BordersV |
       ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable;
 
     const float line_height = ImGui::GetTextLineHeightWithSpacing();
-    const float full_height = line_height * static_cast<float>(facts.size());
+    const float full_height = line_height * static_cast<float>(x.size());
+
+    // facts are stored sorted by hash, new ones are inserted in place.
+    // hashes are unique: adding or renaming onto an existing one is refused
+    // (set() would overwrite its value).
+    ImGuiStorage* storage = ImGui::GetStateStorage();
+    const ImGuiID conflict_id = ImGui::GetID("##conflict");
 
     ImGui::Text("Actions:");
     ImGui::SameLine();
-    if (ImGui::Button("Prepend new fact"))
+    if (ImGui::Button("Add new fact"))
     {
-      facts.emplace(facts.begin());
+      if (x.contains(0))
+        storage->SetBool(conflict_id, true);
+      else
+      {
+        get_mutable().set(0, 0);
+        storage->SetBool(conflict_id, false);
+        modified = true;
+      }
     }
-    ImGui::SameLine();
-    if (ImGui::Button("Sort facts lexicographically ascending"))
+    if (x.contains(0) && ImGui::IsItemHovered())
+      ImGui::SetTooltip("A new fact has hash 0, rename the existing one first.");
+
+    if (storage->GetBool(conflict_id))
     {
-      std::sort(facts.begin(), facts.end(), [](const cp::CFact& a, const cp::CFact& b) -> bool {
-        return a.name().strv() < b.name().strv();
-      });
+      ImGui::SameLine();
+      ImGui::TextColored(ImVec4(1.f, 0.3f, 0.3f, 1.f), "a fact with that name already exists in this table");
     }
 
 
@@ -47,11 +69,13 @@ struct WidFactsTable
     ImVec2 size = ImVec2(-FLT_MIN, std::min(600.f, full_height));
     if (ImGui::BeginTable(label, 1, tbl_flags))
     {
-      // TODO: use clipper
-      int i = 0;
-      for (auto& fact : facts)
+      int edited_idx = -1;
+      cp::CFact edited_fact;
+
+      // only visible facts are drawn (and get their name resolved)
+      imgui_clipped_rows((int)x.size(), [&](int i)
       {
-        scoped_imgui_id __sii(&fact);
+        scoped_imgui_id __sii(i);
 
         ImGui::TableNextRow();
         ImGui::TableNextColumn();
@@ -61,21 +85,32 @@ struct WidFactsTable
           torem_idx = i;
         }
         ImGui::SameLine();
-        modified |= WidCFact::draw(fact);
 
-        ++i;
-      }
+        // renaming moves the fact, edits are applied after the loop
+        cp::CFact fact = x.fact(i);
+        if (WidCFact::draw(fact))
+        {
+          edited_idx = i;
+          edited_fact = fact;
+        }
+      });
 
-      ImGui::TableNextRow();
-      ImGui::TableNextColumn();
-      if (ImGui::Button("append new fact"))
+      if (edited_idx != -1)
       {
-        facts.emplace_back();
+        const bool renamed = x.fact(edited_idx).hash() != edited_fact.hash();
+        if (renamed && x.contains(edited_fact.hash()))
+          storage->SetBool(conflict_id, true);
+        else
+        {
+          get_mutable().assign(edited_idx, edited_fact);
+          storage->SetBool(conflict_id, false);
+          modified = true;
+        }
       }
-
-      if (torem_idx != -1)
+      else if (torem_idx != -1)
       {
-        facts.erase(facts.begin() + torem_idx);
+        get_mutable().erase(torem_idx);
+        storage->SetBool(conflict_id, false);
         modified = true;
       }
 
@@ -89,8 +124,24 @@ struct WidFactsTable
 
 struct WidFactsDB
 {
+  // labels kept across frames, owned by the caller
+  struct view
+  {
+    imgui_label_cache<size_t> tab_labels;
+
+    void sync(uint64_t generation)
+    {
+      tab_labels.sync(generation);
+    }
+
+    size_t memory_usage() const
+    {
+      return tab_labels.memory_usage();
+    }
+  };
+
   // returns true if content has been edited
-  [[nodiscard]] static inline bool draw(cp::csav::FactsDB& x, const char* label)
+  [[nodiscard]] static inline bool draw(cp::csav::FactsDB& x, const char* label, view& v)
   {
     ImGuiWindow* window = ImGui::GetCurrentWindow();
     if (window->SkipItems)
@@ -108,19 +159,21 @@ struct WidFactsDB
 
     if (ImGui::BeginTabBar(label, tab_bar_flags))
     {
-      size_t i = 0;
-      for (auto& table : x.tables())
+      // drawn from the const tables, the mutable accessor invalidates the
+      // hash index so it is only used to apply an edit
+      const auto& tables = std::as_const(x).tables();
+      for (size_t i = 0; i < tables.size(); ++i)
       {
-        auto tab_label = fmt::format("FactsTable#{}", i);
+        const auto& tab_label = v.tab_labels.get(i, [i]() { return fmt::format("FactsTable#{}", i); });
         if (ImGui::BeginTabItem(tab_label.c_str(), 0, ImGuiTabItemFlags_None))
         {
           ImGui::BeginChild("##FactsTableScroll", ImVec2(0, 0), false, ImGuiWindowFlags_NoSavedSettings);
-          modified |= WidFactsTable::draw(table, tab_label.c_str());
+          modified |= WidFactsTable::draw(tables[i], tab_label.c_str(),
+            [&x, i]() -> cp::csav::FactsTable& { return x.tables()[i]; });
           ImGui::EndChild();
 
           ImGui::EndTabItem();
         }
-        ++i;
       }
 
       ImGui::EndTabBar();
@@ -14,15 +14,20 @@ namespace UI {
 
 struct WidCFact
 {
+  struct ItemGetterData
+  {
+    const char* cur_name;
+    const std::vector<cp::gname>& namelist;
+  };
+
   static inline bool ItemGetter(void* data, int n, const char** out_str)
   { 
-    static std::string tmp;
-    auto& namelist = cp::CFact_resolver::get().sorted_names();
+    auto& dataref = *(ItemGetterData*)data;
     if (n == 0)
-      *out_str = (const char*)data;
+      *out_str = dataref.cur_name;
     else
     {
-      *out_str = namelist[n-1].c_str();
+      *out_str = dataref.namelist[n-1].c_str();
     }
     return true;
   }
@@ -33,14 +38,18 @@ struct WidCFact
     scoped_imgui_id _sii(&x);
     bool modified = false;
 
-    auto& namelist = cp::CFact_resolver::get().sorted_names();
+    // the snapshot is held for the frame, names can be registered meanwhile
+    const auto& names = cp::CFact_resolver::get().sorted_names();
+    const auto snapshot = names.get();
+    const auto& namelist = *snapshot;
 
     // tricky ;)
     int current_item_idx = 0;
 
     const auto& curname = x.name();
+    ItemGetterData data {curname.c_str(), namelist};
     ImGui::SetNextItemWidth(std::min(380.f, ImGui::GetContentRegionAvailWidth() * 0.5f));
-    modified |= ImGui::BetterCombo("name, ", &current_item_idx, &ItemGetter, (void*)curname.c_str(), static_cast<int>(namelist.size() + 1));
+    modified |= ImGui::BetterCombo("name, ", &current_item_idx, &ItemGetter, (void*)&data, static_cast<int>(namelist.size() + 1), &names, 1);
 
     if (current_item_idx > 0)
     {
@@ -76,13 +85,16 @@ struct TweakDBID_widget
     scoped_imgui_id _sii(&x);
     bool modified = false;
 
-    auto& namelist = TweakDBID_resolver::get().sorted_names(cat);
+    // the snapshot is held for the frame, names can be registered meanwhile
+    const auto& names = TweakDBID_resolver::get().sorted_names(cat);
+    const auto snapshot = names.get();
+    const auto& namelist = *snapshot;
 
     // tricky ;)
     int item_current = 0;
 
     ItemGetterData data {x.name(), namelist};
-    ImGui::BetterCombo(label, &item_current, &ItemGetter, (void*)&data, (int)namelist.size()+1);
+    ImGui::BetterCombo(label, &item_current, &ItemGetter, (void*)&data, (int)namelist.size()+1, &names, 1);
 
     if (item_current != 0)
     {
@@ -157,13 +169,17 @@ struct CName_widget
 
     ImGui::SameLine();
 
-    auto& namelist = CName_resolver::get().sorted_names();
+    // the snapshot is held for the frame, names can be registered meanwhile
+    const auto& names = CName_resolver::get().sorted_names();
+    const auto snapshot = names.get();
+    const auto& namelist = *snapshot;
 
     // tricky ;)
     int item_current = 0;
 
     const auto& curname = x.string();
-    ImGui::BetterCombo(label, &item_current, &ItemGetter, (void*)curname.c_str(), (int)namelist.size()+1);
+    ItemGetterData data {curname.c_str(), namelist};
+    ImGui::BetterCombo(label, &item_current, &ItemGetter, (void*)&data, (int)namelist.size()+1, &names, 1);
 
     if (item_current != 0)
     {
@@ -174,13 +190,19 @@ struct CName_widget
     return modified;
   }
 
+  struct ItemGetterData
+  {
+    const char* cur_name;
+    const std::vector<gname>& namelist;
+  };
+
   static inline bool ItemGetter(void* data, int n, const char** out_str)
   { 
-    auto& namelist = CName_resolver::get().sorted_names();
+    auto& dataref = *(ItemGetterData*)data;
     if (n == 0)
-      *out_str = (const char*)data;
+      *out_str = dataref.cur_name;
     else
-      *out_str = namelist[n-1].c_str();
+      *out_str = dataref.namelist[n-1].c_str();
     return true;
   }
 };
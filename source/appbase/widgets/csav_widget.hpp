@@ -1,7 +1,10 @@
 #pragma once
 
 #include <stdint.h>
+#include <chrono>
 #include <thread>
+#include <mutex>
+#include <atomic>
 #include <utility>
 #include <iostream>
 #include <fstream>
@@ -10,14 +13,19 @@
 #include <map>
 #include <vector>
 #include <memory>
+#include <optional>
 
 #include <appbase/IApp.hpp>
 #include <cpinternals/utils.hpp>
+#include <cpinternals/common/instrumentation.hpp>
+#include <cpinternals/common/task_scheduler.hpp>
 #include <appbase/ps_json_storage.hpp>
 
 #include "cpinternals/csav.hpp"
+#include "cpinternals/csav/memory_report.hpp"
 #include "cpinternals/ctypes.hpp"
 #include "hexeditor_windows_mgr.hpp"
+#include "node_tree_view.hpp"
 #include "node_editors.hpp"
 #include <appbase/widgets/cpinternals.hpp>
 // TODO: make package headers..
@@ -28,16 +36,39 @@ void ImGui::ShowDemoWindow(bool* p_open);
 
 using loading_bar_job_fntype = bool (*)(float& progress);
 
+// Job running as a high priority task of the task_scheduler, with a
+// progress bar.
+// cancel() is forwarded to the job through progress_t::cancel, it is up to
+// the job to poll it.
 class loading_bar_job_widget
 {
-  std::thread thread;
+  cp::task_group job{cp::task_priority::high};
+  bool running = false;
   bool finished = false;
   progress_t progress = {};
+  std::atomic<bool> cancel_requested = false;
+  cp::span_log spans;
 
 public:
   bool failed = false;
+  std::string error; // set by op_status jobs
 
-  bool is_running() const { return thread.joinable(); }
+  loading_bar_job_widget() = default;
+  loading_bar_job_widget(const loading_bar_job_widget&) = delete;
+  loading_bar_job_widget& operator=(const loading_bar_job_widget&) = delete;
+
+  ~loading_bar_job_widget()
+  {
+    cancel();
+    wait();
+  }
+
+  bool is_running() const { return running; }
+
+  void cancel() { cancel_requested = true; }
+  bool is_cancelled() const { return cancel_requested; }
+
+  float progress_value() const { return progress.value; }
 
   template <class Fn, std::enable_if_t<std::is_same_v<std::invoke_result_t<Fn, progress_t&>, bool>, int> = 0> 
   bool start(Fn&& fn)
@@ -46,18 +77,60 @@ public:
       return false;
     failed = false;
     progress = {};
-    thread = std::thread([this, fn]() {
+    cancel_requested = false;
+    progress.cancel = &cancel_requested;
+    spans.clear();
+    IApp::begin_background_job();
+    running = true;
+    job.run([this, fn]() {
+      cp::scoped_span_sink sink(&spans);
       failed = !fn(progress);
       finished = true;
+      IApp::end_background_job();
+    });
+    return true;
+  }
+
+  template <class Fn, std::enable_if_t<std::is_same_v<std::invoke_result_t<Fn, progress_t&>, op_status>, int> = 0> 
+  bool start(Fn&& fn)
+  {
+    if (is_running())
+      return false;
+    failed = false;
+    error.clear();
+    progress = {};
+    cancel_requested = false;
+    progress.cancel = &cancel_requested;
+    spans.clear();
+    IApp::begin_background_job();
+    running = true;
+    job.run([this, fn]() {
+      cp::scoped_span_sink sink(&spans);
+      op_status status = fn(progress);
+      failed = !status;
+      if (failed)
+        error = status.err();
+      finished = true;
+      IApp::end_background_job();
     });
     return true;
   }
 
+  // blocks until the job is done
+  void wait()
+  {
+    if (running)
+      job.wait();
+    running = false;
+    finished = false;
+  }
+
   void update()
   {
     if (finished) {
       finished = false;
-      thread.join();
+      job.wait();
+      running = false;
     }
   }
 
@@ -71,8 +144,162 @@ public:
         ImGui::Text(progress.comment.c_str());
       else
         ImGui::Text("processing...");
+      draw_timings();
     }
   }
+
+  void draw_timings()
+  {
+    if (!ImGui::TreeNode("timings"))
+      return;
+
+    const auto entries = spans.entries();
+    for (const auto& e : entries)
+    {
+      std::string label = e.label.empty() ? e.name : fmt::format("{} ({})", e.name, e.label);
+      if (e.count > 1)
+        label += fmt::format(" x{}", e.count);
+      ImGui::Text("%*s%-48s %9.2fms %10.3fMB %8llu allocs", (int)e.depth * 2, "",
+        label.c_str(), e.duration_ms, e.bytes / (1024. * 1024.), e.allocs_cnt);
+    }
+
+    ImGui::TreePop();
+  }
+};
+
+// Background pattern search on a node_search_index, matches are streamed
+// to the UI thread by poll().
+// A search whose pattern refines the previous completed one (e.g. the user
+// typed a longer needle) only filters the previous matches.
+class node_search_job
+{
+public:
+  using index_type = cp::csav::node_search_index;
+  using match = index_type::match;
+
+  node_search_job() = default;
+  node_search_job(const node_search_job&) = delete;
+  node_search_job& operator=(const node_search_job&) = delete;
+
+  ~node_search_job()
+  {
+    cancel();
+  }
+
+  bool is_running() const { return m_running; }
+
+  // results must be the vector given to poll() since the last start
+  void start(const std::shared_ptr<const index_type>& index, std::string needle, std::string mask, std::vector<match>& results)
+  {
+    poll(results);
+
+    const bool refine = !is_running() && m_completed && m_index == index
+      && index_type::refines(m_needle, m_mask, needle, mask);
+
+    std::vector<match> prev_results;
+    if (refine)
+      prev_results = std::move(results);
+
+    cancel();
+    results.clear();
+
+    m_index = index;
+    m_needle = needle;
+    m_mask = mask;
+
+    auto st = std::make_shared<state>();
+    m_state = st;
+
+    IApp::begin_background_job();
+    m_running = true;
+    m_search.run([st, index, needle, mask, refine, prev_results = std::move(prev_results)]()
+    {
+      bool completed = true;
+      try
+      {
+        if (refine)
+        {
+          std::vector<match> matches;
+          completed = index->refine(prev_results, needle, mask, matches, &st->cancel);
+          std::lock_guard<std::mutex> lock(st->mtx);
+          st->pending = std::move(matches);
+        }
+        else
+        {
+          completed = index->search(needle, mask, 0, [&st](std::vector<match>&& matches) {
+            std::lock_guard<std::mutex> lock(st->mtx);
+            std::move(matches.begin(), matches.end(), std::back_inserter(st->pending));
+          }, &st->cancel);
+        }
+      }
+      catch (std::exception&)
+      {
+        completed = false;
+      }
+      st->completed = completed;
+      st->done = true;
+      IApp::end_background_job();
+    });
+  }
+
+  // appends the new matches to results, returns true if there were some
+  bool poll(std::vector<match>& results)
+  {
+    if (!m_state)
+      return false;
+
+    bool added = false;
+    {
+      std::lock_guard<std::mutex> lock(m_state->mtx);
+      if (m_state->pending.size())
+      {
+        std::move(m_state->pending.begin(), m_state->pending.end(), std::back_inserter(results));
+        m_state->pending.clear();
+        added = true;
+      }
+    }
+
+    if (m_state->done && m_running)
+    {
+      m_search.wait();
+      m_running = false;
+      m_completed = m_state->completed;
+    }
+
+    return added;
+  }
+
+  // discards the running search, blocks until its task is done
+  void cancel()
+  {
+    if (m_state)
+      m_state->cancel = true;
+    if (m_running)
+      m_search.wait();
+    m_running = false;
+    m_state.reset();
+    m_completed = false;
+  }
+
+protected:
+  struct state
+  {
+    std::atomic<bool> cancel = false;
+    std::atomic<bool> done = false;
+    bool completed = false; // valid once done
+    std::mutex mtx;
+    std::vector<match> pending;
+  };
+
+  cp::task_group m_search{cp::task_priority::high};
+  bool m_running = false;
+  std::shared_ptr<state> m_state;
+
+  // last search
+  std::shared_ptr<const index_type> m_index;
+  std::string m_needle;
+  std::string m_mask;
+  bool m_completed = false;
 };
 
 static inline bool s_use_ps4_weird_format = false;
@@ -83,6 +310,7 @@ class csav_collapsable_header
 protected:
   ImGui::FileBrowser save_dialog;
   static inline loading_bar_job_widget save_job; // only one save job
+  loading_bar_job_widget verify_job; // background reserialization check
 
   std::shared_ptr<cp::savegame> m_csav;
   std::shared_ptr<AppImage> m_img;
@@ -91,16 +319,54 @@ protected:
   std::vector<std::shared_ptr<node_editor_widget>> m_collapsible_editors;
   std::vector<std::shared_ptr<node_editor_widget>> m_advanced_collapsible_editors;
 
+  // display strings of the tabs, dropped on node events (see draw_content)
+  UI::WidFactsDB::view m_facts_view;
+  CInventory_widget::view m_inventory_view;
+
+  // built on demand, see draw_memory_report
+  std::optional<cp::csav::memory_report> m_memory_report;
+  size_t m_memory_report_views_bytes = 0;
+
 
   bool m_closed = false; // can be destroyed
   bool m_closing = false; // close button clicked
 
+  // session compaction (see csav_list_widget::update): the save of an
+  // inactive tab is kept serialized, everything built from it is dropped and
+  // it is reloaded when the tab is activated again
+  enum class session_state : uint8_t
+  {
+    expanded,
+    compacting,  // being serialized, m_csav is off-limits
+    compacted,   // m_csav is null
+    rehydrating, // being reloaded from m_compacted_data
+  };
+
+  using clock = std::chrono::steady_clock;
+
+  session_state m_session_state = session_state::expanded;
+  std::filesystem::path m_filepath;
+  clock::time_point m_last_active = clock::now();
+  clock::time_point m_compaction_start;
+  std::vector<char> m_compacted_data; // set by the compaction job
+  std::shared_ptr<cp::savegame> m_rehydrated_save; // set by the rehydration job
+  // declared after what its jobs write, destroyed first
+  loading_bar_job_widget m_session_job;
+
   //std::vector<ScanEntryWidget> scan_entries;
   //using scan_entry_it = decltype(scan_entries)::iterator;
   std::array<char, 24 * 3 + 1> search_needle = {};
   std::array<char, 24     + 1> search_mask = {};
 
 public:
+  // before opening: saves then only write back the systems edited in the
+  // tabs and recompress only the chunks whose data changed
+  static void enable_incremental_saves(cp::savegame& csav)
+  {
+    csav.track_dirty_systems = true;
+    csav.tree.set_incremental_save(true);
+  }
+
   csav_collapsable_header(const std::shared_ptr<cp::savegame>& csav, const std::shared_ptr<AppImage>& img, std::string_view name = "")
     : save_dialog(ImGuiFileBrowserFlags_EnterNewFilename | ImGuiFileBrowserFlags_CreateNewDir)
     , m_csav(csav), m_img(img)
@@ -120,6 +386,14 @@ public:
 
     if (m_csav)
     {
+      m_filepath = m_csav->filepath;
+
+      // the check works on copies, editors are usable meanwhile
+      auto check = std::make_shared<cp::savegame::reserialization_check>(m_csav->make_reserialization_check());
+      verify_job.start([check](progress_t& progress) -> op_status {
+        return check->run(progress);
+      });
+
       //add_collapsible_editor<System_editor>("ScriptableSystemsContainer", true);
       //add_collapsible_editor<PSData_editor>("PSData", true);
       //
@@ -133,6 +407,10 @@ public:
 
   ~csav_collapsable_header()
   {
+    verify_job.wait();
+    m_session_job.cancel();
+    m_session_job.wait();
+
     // fail-safe, not the best
     while (save_job.is_running())
       Sleep(1);
@@ -176,6 +454,52 @@ public:
   void update()
   {
     save_job.update();
+    verify_job.update();
+    update_session();
+  }
+
+  clock::duration inactive_time(clock::time_point now) const
+  {
+    return now - m_last_active;
+  }
+
+  bool is_compacted() const
+  {
+    return m_session_state == session_state::compacted;
+  }
+
+  // serializes the save in background, it is dropped once done unless the
+  // tab has been activated meanwhile.
+  // skipped while the save is busy or has edits outside of its tree
+  // (uncommitted editors, opened hex editor windows).
+  bool start_compaction()
+  {
+    if (m_session_state != session_state::expanded || m_closing || !m_csav)
+      return false;
+
+    if (save_job.is_running() || verify_job.is_running() || search_job.is_running())
+      return false;
+
+    if (has_uncommitted_changes() || has_opened_hexeditor_windows())
+      return false;
+
+    m_compacted_data.clear();
+    m_compaction_start = clock::now();
+    m_session_state = session_state::compacting;
+
+    // the current format is kept, the data never leaves memory
+    const bool ps4w = m_csav->tree.ver().ps4w;
+    m_session_job.start([this, csav = m_csav, ps4w](progress_t& progress) -> op_status {
+      memory_ostream out;
+      op_status status = csav->save_with_progress(out, progress, ps4w, cp::csav::node_tree::save_profile::fast);
+      if (status)
+      {
+        const auto data = out.gather();
+        m_compacted_data.assign(data.begin(), data.end());
+      }
+      return status;
+    });
+    return true;
   }
 
   const std::string& pretty_name() 
@@ -188,7 +512,15 @@ public:
 
   void draw()
   {
+    cp::scoped_span span("ui.csav_header.draw");
     scoped_imgui_id sii {this};
+
+    m_last_active = clock::now();
+    if (m_session_state != session_state::expanded)
+    {
+      draw_session_state();
+      return;
+    }
     ImVec2 center(ImGui::GetIO().DisplaySize.x * 0.5f, ImGui::GetIO().DisplaySize.y * 0.5f);
 
     std::string label = fmt::format("{} (csav {})",
@@ -368,7 +700,7 @@ public:
         }
         else
         {
-          auto& src_buf = appearance_src->data();
+          const auto src_buf = appearance_src->data();
           appearance_node->nonconst().assign_data(src_buf.begin(), src_buf.end());
 
           // RELOAD the editor data
@@ -401,6 +733,8 @@ public:
 
     ImGui::PopStyleVar();
 
+    draw_verify_status();
+
     const float indent = 12.f;
 
     //const ImGuiID id = ImGui::GetCurrentWindow()->GetID((void*)this);
@@ -411,6 +745,173 @@ public:
     //ImGui::EndChild();
   }
 
+protected:
+  bool has_uncommitted_changes() const
+  {
+    for (auto& ce : m_collapsible_editors)
+    {
+      if (ce->has_changes())
+        return true;
+    }
+    for (auto& ce : m_advanced_collapsible_editors)
+    {
+      if (ce->has_changes())
+        return true;
+    }
+    return false;
+  }
+
+  bool has_opened_hexeditor_windows() const
+  {
+    return hexeditor_windows_mgr::get().any_opened_window([this](const auto& node) {
+      for (const auto& n : m_csav->tree.find_nodes(node->name()))
+      {
+        if (n == node)
+          return true;
+      }
+      return false;
+    });
+  }
+
+  // drops the save and everything built from it
+  void drop_expanded_state()
+  {
+    search_job.cancel();
+    search_result.clear();
+    selected_result = (size_t)-1;
+    search_index.reset();
+    search_index_root.reset();
+
+    m_facts_view = {};
+    m_inventory_view = {};
+    m_tree_view.clear();
+    m_memory_report.reset();
+    m_memory_report_views_bytes = 0;
+
+    m_collapsible_editors.clear();
+    m_advanced_collapsible_editors.clear();
+
+    m_csav.reset();
+  }
+
+  void start_rehydration()
+  {
+    m_session_state = session_state::rehydrating;
+    m_session_job.start([this](progress_t& progress) -> op_status {
+      auto cs = std::make_shared<cp::savegame>();
+      cs->tree.set_shared_payloads(true);
+      enable_incremental_saves(*cs);
+      // systems are parsed as soon as their node is lifted
+      op_status status = cs->open_pipelined(std::span<const char>(m_compacted_data), progress, false);
+      if (status)
+      {
+        cs->filepath = m_filepath;
+        m_rehydrated_save = cs;
+      }
+      return status;
+    });
+  }
+
+  void update_session()
+  {
+    m_session_job.update();
+    if (m_session_job.is_running())
+      return;
+
+    switch (m_session_state)
+    {
+      case session_state::compacting:
+      {
+        // kept if activated meanwhile, the data is then already stale
+        if (!m_session_job.failed && m_last_active < m_compaction_start)
+        {
+          drop_expanded_state();
+          m_session_state = session_state::compacted;
+        }
+        else
+        {
+          m_compacted_data.clear();
+          m_session_state = session_state::expanded;
+        }
+        break;
+      }
+      case session_state::rehydrating:
+      {
+        if (m_rehydrated_save)
+        {
+          m_csav = std::move(m_rehydrated_save);
+          std::vector<char>().swap(m_compacted_data);
+          m_session_state = session_state::expanded;
+        }
+        else
+        {
+          // the error is shown until retried
+          m_session_state = session_state::compacted;
+        }
+        break;
+      }
+      default:
+        break;
+    }
+
+    // nothing to save in a compacted save, its tab isn't drawn to close it
+    if (m_closing && m_session_state == session_state::compacted)
+      m_closed = true;
+  }
+
+  void draw_session_state()
+  {
+    switch (m_session_state)
+    {
+      case session_state::compacting:
+      {
+        ImGui::Text("compacting inactive save...");
+        m_session_job.draw();
+        break;
+      }
+      case session_state::compacted:
+      {
+        if (!m_session_job.failed)
+        {
+          start_rehydration();
+          break;
+        }
+
+        ImGui::TextColored(ImVec4(1.f, 0.3f, 0.3f, 1.f), "couldn't restore compacted save: %s", m_session_job.error.c_str());
+        m_session_job.draw_timings();
+        if (ImGui::Button("Retry"))
+          start_rehydration();
+        break;
+      }
+      case session_state::rehydrating:
+      {
+        ImGui::Text("restoring compacted save...");
+        m_session_job.draw();
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+public:
+  void draw_verify_status()
+  {
+    if (verify_job.is_running())
+    {
+      ImGui::Text("checking reserialization in background... %.0f%%", verify_job.progress_value() * 100);
+    }
+    else if (verify_job.failed)
+    {
+      ImGui::TextColored(ImVec4(1.f, 0.3f, 0.3f, 1.f), "reserialization check failed: %s", verify_job.error.c_str());
+      if (ImGui::IsItemHovered())
+        ImGui::SetTooltip(
+          "If your save has been edited with an older version of CPSE,\n"
+          "please make the game save it again.\n"
+          "Otherwise, please open an issue.");
+    }
+  }
+
   int selected_item1 = -1;
   int selected_item2 = -1;
   int selected_item3 = -1;
@@ -420,11 +921,27 @@ public:
 
   bool modified = false; // unused atm, this pending save feature needs refactoring
 
+  // the systems edited in the tabs are written back on save
+  void mark_modified(bool edited, std::initializer_list<std::string_view> nodenames)
+  {
+    if (!edited)
+      return;
+
+    modified = true;
+    for (auto nodename : nodenames)
+      m_csav->mark_system_dirty(nodename);
+  }
+
   TweakDBID vehicle_tdbid { 0x0000001B4E8371E1 };
   std::string result_str = "err";
 
   void draw_content()
   {
+    cp::scoped_span span("ui.csav_header.content");
+    const uint64_t edits_cnt = m_csav->tree.edits_count();
+    m_facts_view.sync(edits_cnt);
+    m_inventory_view.sync(edits_cnt);
+
     // Expose a couple of the available flags. In most cases you may just call BeginTabBar() with no flags (0).
     static ImGuiTabBarFlags tab_bar_flags =
       //ImGuiTabBarFlags_Reorderable |
@@ -451,6 +968,7 @@ public:
         if (ImGui::Button("APPLY"))
         {
           bool res = m_csav->psdata.replace_spawned_vehicles(vehicle_tdbid);
+          mark_modified(res, {"PSData"});
           result_str = res ? "     success :)     " : "failed :( please open an issue.";
           ImGui::OpenPopup("Result##RESULT");
         }
@@ -479,7 +997,7 @@ public:
       if (ImGui::BeginTabItem("Facts", 0, ImGuiTabItemFlags_None))
       {
         ImGui::BeginChild("current editor", ImVec2(0, 0), false, ImGuiWindowFlags_NoSavedSettings);
-        modified |= UI::WidFactsDB::draw(m_csav->factsdb, "Facts");
+        mark_modified(UI::WidFactsDB::draw(m_csav->factsdb, "Facts", m_facts_view), {"FactsDB"});
         ImGui::EndChild();
         ImGui::EndTabItem();
       }
@@ -487,7 +1005,8 @@ public:
       if (ImGui::BeginTabItem("Inventories", 0, ImGuiTabItemFlags_None))
       {
         ImGui::BeginChild("current editor", ImVec2(0, 0), false, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoScrollWithMouse);
-        modified |= CInventory_widget::draw(m_csav->inventory, &m_csav->stats);
+        // item editors can add stat modifiers
+        mark_modified(CInventory_widget::draw(m_csav->inventory, m_inventory_view, &m_csav->stats), {"inventory", "StatsSystem"});
         ImGui::EndChild();
         ImGui::EndTabItem();
       }
@@ -496,7 +1015,7 @@ public:
       {
         //scoped_imgui_id _sii("Appearance Customization");
         ImGui::BeginChild("current editor", ImVec2(0, 0), false, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoScrollWithMouse);
-        modified |= CCharacterCustomization_widget::draw(m_csav->chtrcustom);
+        mark_modified(CCharacterCustomization_widget::draw(m_csav->chtrcustom), {"CharacetrCustomization_Appearances"});
         ImGui::EndChild();
         ImGui::EndTabItem();
       }
@@ -504,7 +1023,7 @@ public:
       if (ImGui::BeginTabItem("Scriptable Systems", 0, ImGuiTabItemFlags_None))
       {
         ImGui::BeginChild("current editor", ImVec2(0, 0), false, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoScrollWithMouse);
-        modified |= CSystem_widget::draw(m_csav->scriptables.system(), &selected_item1);
+        mark_modified(CSystem_widget::draw(m_csav->scriptables.system(), &selected_item1), {"ScriptableSystemsContainer"});
         ImGui::EndChild();
         ImGui::EndTabItem();
       }
@@ -517,7 +1036,7 @@ public:
         if (ImGui::BeginTabItem("Stats Map", 0, ImGuiTabItemFlags_None))
         {
           ImGui::BeginChild("current editor", ImVec2(0, 0), false, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoScrollWithMouse);
-          modified |= CSystem_widget::draw(m_csav->stats.system(), &selected_item2);
+          mark_modified(CSystem_widget::draw(m_csav->stats.system(), &selected_item2), {"StatsSystem"});
           ImGui::EndChild();
           ImGui::EndTabItem();
         }
@@ -525,7 +1044,7 @@ public:
         if (ImGui::BeginTabItem("Stats Pool", 0, ImGuiTabItemFlags_None))
         {
           ImGui::BeginChild("current editor", ImVec2(0, 0), false, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoScrollWithMouse);
-          modified |= CSystem_widget::draw(m_csav->statspool.system(), &selected_item3);
+          mark_modified(CSystem_widget::draw(m_csav->statspool.system(), &selected_item3), {"StatPoolsSystem"});
           ImGui::EndChild();
           ImGui::EndTabItem();
         }
@@ -533,7 +1052,7 @@ public:
         if (ImGui::BeginTabItem("Persistent Data", 0, ImGuiTabItemFlags_None))
         {
           ImGui::BeginChild("current editor", ImVec2(0, 0), false, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoScrollWithMouse);
-          modified |= CPSData_widget::draw(m_csav->psdata, &selected_item4);
+          mark_modified(CPSData_widget::draw(m_csav->psdata, &selected_item4), {"PSData"});
           ImGui::EndChild();
           ImGui::EndTabItem();
         }
@@ -541,7 +1060,7 @@ public:
         if (ImGui::BeginTabItem("God Mode", 0, ImGuiTabItemFlags_None))
         {
           ImGui::BeginChild("current editor", ImVec2(0, 0), false, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoScrollWithMouse);
-          modified |= CSystem_widget::draw(m_csav->godmode.system(), &selected_item5);
+          mark_modified(CSystem_widget::draw(m_csav->godmode.system(), &selected_item5), {"godModeSystem"});
           ImGui::EndChild();
           ImGui::EndTabItem();
         }
@@ -570,6 +1089,14 @@ public:
           ImGui::EndTabItem();
         }
 
+        if (ImGui::BeginTabItem("Memory Usage", 0, ImGuiTabItemFlags_None))
+        {
+          ImGui::BeginChild("current editor", ImVec2(0, 0), false, ImGuiWindowFlags_NoSavedSettings);
+          draw_memory_report();
+          ImGui::EndChild();
+          ImGui::EndTabItem();
+        }
+
       }
 
       ImGui::EndTabBar();
@@ -605,6 +1132,68 @@ public:
     
   }
 
+  // walks the whole save, only refreshed on demand
+  void draw_memory_report()
+  {
+    if (ImGui::Button("refresh") || !m_memory_report)
+    {
+      m_memory_report = cp::csav::memory_report::build(*m_csav);
+      m_memory_report_views_bytes = m_facts_view.memory_usage() + m_inventory_view.memory_usage();
+    }
+
+    static ImGuiTableFlags flags = ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersOuter
+      | ImGuiTableFlags_BordersV | ImGuiTableFlags_Resizable;
+
+    auto mb = [](size_t bytes) { return fmt::format("{:.2f} MB", bytes / (1024. * 1024.)); };
+
+    ImVec2 size = ImVec2(-FLT_MIN, -FLT_MIN);
+    if (ImGui::BeginTable("##memory_table", 10, flags, size))
+    {
+      ImGui::TableSetupScrollFreeze(0, 1);
+      ImGui::TableSetupColumn("node");
+      ImGui::TableSetupColumn("total");
+      ImGui::TableSetupColumn("nodes");
+      ImGui::TableSetupColumn("node data");
+      ImGui::TableSetupColumn("objects");
+      ImGui::TableSetupColumn("object data");
+      ImGui::TableSetupColumn("props");
+      ImGui::TableSetupColumn("prop data");
+      ImGui::TableSetupColumn("strings");
+      ImGui::TableSetupColumn("caches");
+      ImGui::TableHeadersRow();
+
+      auto draw_row = [&](std::string_view name, const cp::memory_usage& mu)
+      {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn(); ImGui::TextUnformatted(name.data(), name.data() + name.size());
+        ImGui::TableNextColumn(); ImGui::TextUnformatted(mb(mu.total_bytes()).c_str());
+        ImGui::TableNextColumn(); ImGui::Text("%zu", mu.nodes_cnt);
+        ImGui::TableNextColumn(); ImGui::TextUnformatted(mb(mu.node_bytes).c_str());
+        ImGui::TableNextColumn(); ImGui::Text("%zu", mu.objects_cnt);
+        ImGui::TableNextColumn(); ImGui::TextUnformatted(mb(mu.object_bytes).c_str());
+        ImGui::TableNextColumn(); ImGui::Text("%zu", mu.props_cnt);
+        ImGui::TableNextColumn(); ImGui::TextUnformatted(mb(mu.prop_bytes).c_str());
+        ImGui::TableNextColumn(); ImGui::TextUnformatted(mb(mu.string_bytes).c_str());
+        ImGui::TableNextColumn(); ImGui::TextUnformatted(mb(mu.cache_bytes).c_str());
+      };
+
+      const auto& report = *m_memory_report;
+      for (const auto& r : report.rows)
+        draw_row(r.system_loaded ? r.name : r.name + " (not loaded)", r.usage);
+      draw_row("other nodes", report.other_nodes);
+
+      cp::memory_usage views;
+      views.cache_bytes = m_memory_report_views_bytes;
+      draw_row("widget caches", views);
+
+      cp::memory_usage total = report.total;
+      total += views;
+      draw_row("total", total);
+
+      ImGui::EndTable();
+    }
+  }
+
   void draw_node_descs()
   {
     static ImGuiTableFlags flags = ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersOuter
@@ -648,9 +1237,9 @@ public:
   void draw_csav_t()
   {
     ImGui::BeginChild("csav_t", ImVec2(0, 0), false, ImGuiWindowFlags_NoSavedSettings);
-    if (m_csav->root)
-      for (const auto& n : m_csav->root->children())
-        draw_tree_node(n);
+    m_tree_view.draw(m_csav->root, [this](const node_tree_view::row& row) {
+      return draw_tree_row(row);
+    });
     ImGui::EndChild();
   }
 
@@ -672,9 +1261,11 @@ public:
     */
 
     static char search_text[256];
-    const bool text_search = ImGui::Button("search text", ImVec2(150, 0)); ImGui::SameLine();
+    bool text_search = ImGui::Button("search text", ImVec2(150, 0)); ImGui::SameLine();
     ImGui::PushItemWidth(slider_width);
-    ImGui::InputText("input text", search_text, 256);
+    // searches as you type, longer needles refine the previous results
+    if (ImGui::InputText("input text", search_text, 256) && strlen(search_text) >= 3)
+      text_search = true;
     const bool crc32_search = ImGui::Button("search crc32", ImVec2(150, 0)); ImGui::SameLine();
     TweakDBID nhash(search_text);
     std::stringstream ss;
@@ -717,6 +1308,14 @@ public:
       search_pattern_in_nodes(std::string((char*)&f64_v, (char*)&f64_v + 8), "");
     }
 
+    static char search_node_name[256];
+    const bool name_search = ImGui::Button("search node name", ImVec2(150, 0)); ImGui::SameLine();
+    ImGui::PushItemWidth(slider_width);
+    ImGui::InputText("node name", search_node_name, 256);
+    if (name_search) {
+      search_nodes_by_name(search_node_name);
+    }
+
     ImGui::Separator();
     if (ImGui::Button("search bytes from editor clipboard (context/copy)"))
     {
@@ -741,6 +1340,17 @@ public:
 
     // results
 
+    search_job.poll(search_result);
+    if (search_job.is_running())
+    {
+      ImGui::Text("searching... %d match(es) so far", (int)search_result.size());
+      ImGui::SameLine();
+      if (ImGui::SmallButton("cancel##search"))
+        search_job.cancel();
+    }
+    else
+      ImGui::Text("%d match(es)", (int)search_result.size());
+
     static std::shared_ptr<node_hexeditor> nh;
 
     static float u32row_width = ImGui::CalcTextSize("0xFFFFFFFF ").x;
@@ -766,13 +1376,13 @@ public:
           ImGui::TableNextColumn();
 
           static char matchname[512];
-          ImFormatString(matchname, 512, "offset 0x%08X in node %4d - %s", match.offset, match.n->idx(), match.n->name().c_str());
+          ImFormatString(matchname, 512, "offset 0x%08X in node %4d - %s", match.offset, match.node->idx(), match.node->name().c_str());
 
           if (ImGui::Selectable(matchname, selected_result == row))
           {
             selected_result = row;
-            if (!nh || nh->node() != match.n)
-              nh = std::make_shared<node_hexeditor>(match.n);
+            if (!nh || nh->node() != match.node)
+              nh = std::make_shared<node_hexeditor>(match.node);
             nh->select(match.offset, match.size);
           }
         }
@@ -792,13 +1402,12 @@ public:
 
 
 protected:
-  void draw_tree_node(const std::shared_ptr<const cp::savegame::node_type>& node)
+  // retained rows of the node tree panel (see draw_csav_t)
+  node_tree_view m_tree_view;
+
+  bool draw_tree_row(const node_tree_view::row& row)
   {
-    if (!node)
-    {
-      ImGui::Text("null");
-      return;
-    }
+    const auto& node = row.node;
 
     auto& emgr = hexeditor_windows_mgr::get();
     auto editor = emgr.find_window(node);
@@ -806,9 +1415,11 @@ protected:
     const bool selected = editor && editor->is_opened();
     const bool focused = editor && editor->has_focus();
 
-    ImGuiTreeNodeFlags node_flags = selected ? ImGuiTreeNodeFlags_Selected : 0;
+    ImGuiTreeNodeFlags node_flags = ImGuiTreeNodeFlags_NoTreePushOnOpen;
+    if (selected)
+      node_flags |= ImGuiTreeNodeFlags_Selected;
     if (!node->has_children())
-      node_flags |= ImGuiTreeNodeFlags_Leaf | ImGuiTreeNodeFlags_NoTreePushOnOpen;
+      node_flags |= ImGuiTreeNodeFlags_Leaf;
 
     if (focused)
     {
@@ -817,10 +1428,7 @@ protected:
       ImGui::PushStyleColor(ImGuiCol_Header, focus_col);
     }
 
-    bool opened =
-      (node->is_blob() or node->is_root())
-      ? ImGui::TreeNodeEx((void*)node.get(), node_flags, "%s", node->name().c_str())
-      : ImGui::TreeNodeEx((void*)node.get(), node_flags, "%s (%u)", node->name().c_str(), node->idx());
+    const bool opened = ImGui::TreeNodeEx((void*)node.get(), node_flags, "%s", row.label.c_str());
 
     if (focused)
     {
@@ -836,26 +1444,36 @@ protected:
         editor->take_focus();
     }
 
-    if (opened && node->has_children())
-    {
-      for (auto& child : node->children())
-        draw_tree_node(child);
-
-      ImGui::TreePop();
-    }
+    return opened;
   }
 
   // hex search.. 
 
-  struct search_match {
-    std::shared_ptr<const cp::savegame::node_type> n;
-    size_t offset;
-    size_t size;
-  };
+  using search_match = cp::csav::node_search_index::match;
+  std::shared_ptr<const cp::csav::node_search_index> search_index;
+  std::shared_ptr<const cp::savegame::node_type> search_index_root;
+  uint64_t search_index_edits = 0;
+  node_search_job search_job;
   std::vector<search_match> search_result;
   size_t selected_result = (size_t)-1;
 
-  std::vector<search_match>& search_pattern_in_nodes(const std::string& needle, const std::string& mask)
+  // the index is a snapshot of the tree, rebuilt (on this thread) after edits
+  const std::shared_ptr<const cp::csav::node_search_index>& current_search_index()
+  {
+    const uint64_t edits = m_csav->tree.edits_count();
+    if (!search_index || search_index_root != m_csav->root || search_index_edits != edits)
+    {
+      auto index = std::make_shared<cp::csav::node_search_index>();
+      index->build(m_csav->root);
+      search_index = index;
+      search_index_root = m_csav->root;
+      search_index_edits = edits;
+    }
+    return search_index;
+  }
+
+  // results are streamed into search_result by draw_search_tools
+  void search_pattern_in_nodes(const std::string& needle, const std::string& mask)
   {
     selected_result = (size_t)-1;
     // history draft
@@ -869,24 +1487,27 @@ protected:
       ss << "mask:" << mask;
     auto it = searches.emplace(ss.str(), std::vector<search_match>());
     */
-    search_result.clear();
     if (m_csav and !std::all_of(needle.begin(), needle.end(), [](char i) { return i==0; })) // searching for zeroes is just.. the way to die
-      search_pattern_in_nodes_rec(search_result, m_csav->root, needle, mask);
-    return search_result;
+    {
+      search_job.start(current_search_index(), needle, mask, search_result);
+    }
+    else
+    {
+      search_job.cancel();
+      search_result.clear();
+    }
   }
 
-  void search_pattern_in_nodes_rec(std::vector<search_match>& matches, const std::shared_ptr<const cp::savegame::node_type> node, const std::string& needle, const std::string& mask)
+  void search_nodes_by_name(std::string_view name)
   {
-    auto& haystack = node->data();
-    std::vector<uintptr_t> match_offsets;
-    if (mask.size())
-      match_offsets = sse2_strstr_masked((uint8_t*)haystack.data(), haystack.size(), (uint8_t*)needle.data(), needle.size(), mask.data(), mask.size());
-    else
-      match_offsets = sse2_strstr((uint8_t*)haystack.data(), haystack.size(), (uint8_t*)needle.data(), needle.size());
-    for (auto off : match_offsets)
-      matches.emplace_back(search_match{node, off, needle.size()});
-    for (auto& c : node->children())
-      search_pattern_in_nodes_rec(matches, c, needle, mask);
+    selected_result = (size_t)-1;
+    search_job.cancel();
+    search_result.clear();
+    if (m_csav)
+    {
+      for (auto& n : m_csav->tree.find_nodes(name))
+        search_result.emplace_back(search_match{n, 0, 0, 0, n->data().size()});
+    }
   }
 };
 
@@ -894,13 +1515,26 @@ class csav_list_widget
 {
 protected:
   ImGui::FileBrowser open_dialog;
-  loading_bar_job_widget open_job;
-  std::filesystem::path open_filepath;
-  std::shared_ptr<cp::savegame> opened_save;
-  std::shared_ptr<AppImage> opened_save_img;
+
+  // savefiles being opened, loads run concurrently on their own threads
+  struct open_request
+  {
+    std::filesystem::path filepath;
+    std::shared_ptr<AppImage> img;
+    loading_bar_job_widget job;
+    std::shared_ptr<cp::savegame> opened_save; // set by the job
+  };
+
+  // requests own running jobs, they must not be moved
+  std::list<open_request> m_open_requests;
 
   std::list<csav_collapsable_header> m_list;
 
+  // saves whose tab stayed inactive that long are compacted
+  // (see csav_collapsable_header::start_compaction)
+  static inline bool s_compact_inactive_saves = true;
+  static inline int s_compaction_delay_s = 120;
+
 public:
   csav_list_widget()
   {
@@ -915,28 +1549,47 @@ public:
     }
     catch (std::exception&) {}
   }
+
+  ~csav_list_widget()
+  {
+    // cancel all of them before the requests wait for their job
+    for (auto& req : m_open_requests)
+      req.job.cancel();
+  }
   
   void update()
   {
-    open_job.update();
-    if (opened_save)
+    // opened saves are added in completion order,
+    // failed requests are kept until their error is dismissed
+    for (auto it = m_open_requests.begin(); it != m_open_requests.end();)
     {
-      m_list.emplace_back(opened_save, opened_save_img);
-      opened_save.reset();
-      opened_save_img.reset();
+      it->job.update();
+      if (!it->job.is_running() && (it->opened_save || it->job.is_cancelled()))
+      {
+        if (it->opened_save)
+          m_list.emplace_back(it->opened_save, it->img);
+        it = m_open_requests.erase(it);
+      }
+      else
+        ++it;
     }
 
-    m_list.erase(
-      std::remove_if(m_list.begin(), m_list.end(), [](auto& a){ return a.is_closed(); }),
-      m_list.end()
-    );
+    // headers own running jobs, they must not be moved
+    m_list.remove_if([](auto& a){ return a.is_closed(); });
 
+    const auto now = std::chrono::steady_clock::now();
+    const auto compaction_delay = std::chrono::seconds(std::max(s_compaction_delay_s, 1));
     for (auto& cs : m_list)
+    {
       cs.update();
+      if (s_compact_inactive_saves && cs.inactive_time(now) >= compaction_delay)
+        cs.start_compaction();
+    }
   }
 
   void draw_list()
   {
+    cp::scoped_span span("ui.csav_list.draw");
     // todo: remove that when error popup is app-wide
     node_editor_widget::draw_popups();
 
@@ -950,7 +1603,7 @@ public:
     // the underlying bool will be set to false when the tab is closed.
     if (ImGui::BeginTabBar("MyTabBar", tab_bar_flags))
     {
-      if (ImGui::TabItemButton("  +  ", ImGuiTabItemFlags_Leading | ImGuiTabItemFlags_NoTooltip) && !open_job.is_running())
+      if (ImGui::TabItemButton("  +  ", ImGuiTabItemFlags_Leading | ImGuiTabItemFlags_NoTooltip))
         open_dialog.Open();
 
       size_t i = 0;
@@ -972,40 +1625,48 @@ public:
 
   void open_file(IApp* owning_app, std::wstring fpath)
   {
-    if (open_job.is_running())
+    const auto filepath = std::filesystem::absolute(fpath);
+
+    // already being opened
+    for (const auto& req : m_open_requests)
     {
-      // todo: add centralized error modal popup to IApp
-      // and open an error here
-      return;
+      if (req.filepath == filepath && req.job.is_running())
+        return;
     }
 
-    open_filepath = std::filesystem::absolute(fpath);
-
     try
     {
-      std::filesystem::path dirpath = open_filepath;
+      std::filesystem::path dirpath = filepath;
       auto& jroot = ps_json_storage::get().jroot();
       jroot["open_path"] = dirpath.remove_filename().string();
     }
     catch (std::exception&) {}
 
-    auto screenshot_path = open_filepath;
+    auto& req = m_open_requests.emplace_back();
+    req.filepath = filepath;
+
+    auto screenshot_path = filepath;
     screenshot_path.replace_filename(L"screenshot.png");
     if (std::filesystem::exists(screenshot_path))
-      opened_save_img = owning_app->load_texture_from_file(screenshot_path.string());
+      req.img = owning_app->load_texture_async(screenshot_path.string());
 
-    open_job.start([this](progress_t& progress) -> bool {
+    req.job.start([preq = &req](progress_t& progress) -> op_status {
       auto cs = std::make_shared<cp::savegame>();
-      if (!cs->open_with_progress(open_filepath, progress, s_dump_decompressed_data))
-        return false;
-      opened_save = cs;
-      return true;
+      // saves of a playthrough are often open together, they share their
+      // identical payloads
+      cs->tree.set_shared_payloads(true);
+      csav_collapsable_header::enable_incremental_saves(*cs);
+      // reserialization is checked in background once opened (see csav_collapsable_header)
+      op_status status = cs->open_with_progress(preq->filepath, progress, s_dump_decompressed_data, false, false);
+      if (status)
+        preq->opened_save = cs;
+      return status;
     });
   }
 
   void draw_menu_item(IApp* owning_app)
   {
-    if (ImGui::MenuItem("Open savefile", 0, false, !open_job.is_running()))
+    if (ImGui::MenuItem("Open savefile"))
       open_dialog.Open();
 
     open_dialog.Display();
@@ -1016,57 +1677,65 @@ public:
       open_dialog.ClearSelected();
     }
 
-    // be sure that this modal is opened
-    if (open_job.is_running())
-      ImGui::OpenPopup("Loading..##LOAD");
-
     if (ImGui::BeginMenu("Options"))
     {
       ImGui::Checkbox("use ps4wizard format", &s_use_ps4_weird_format);
       ImGui::Checkbox("dump decompressed data", &s_dump_decompressed_data);
       ImGui::Checkbox("show CObject field types", &CObject::show_field_types);
       ImGui::Checkbox("show CProperty skipped flag", &CProperty::imgui_show_skipped);
+      ImGui::Checkbox("compact inactive saves", &s_compact_inactive_saves);
+      ImGui::InputInt("compaction delay (s)", &s_compaction_delay_s);
       ImGui::EndMenu();
     }
 
-    if (0 && ImGui::Button("open error"))
-      ImGui::OpenPopup("Loading..##LOAD");
+    draw_open_requests();
+  }
+
+protected:
+  // not modal: the opened saves can be edited while others are loading
+  void draw_open_requests()
+  {
+    if (m_open_requests.empty())
+      return;
 
     // Always center this window when appearing
     ImVec2 center(ImGui::GetIO().DisplaySize.x * 0.5f, ImGui::GetIO().DisplaySize.y * 0.5f);
     ImGui::SetNextWindowPos(center, ImGuiCond_Appearing, ImVec2(0.5f, 0.5f));
 
-    bool pushed_stylecol = false;
-    if (open_job.failed) {
-      ImGui::PushStyleColor(ImGuiCol_ModalWindowDimBg, (ImVec4)ImColor::HSV(0.f, 1.f, 0.6f, 0.35f));
-      pushed_stylecol = true;
-    }
-
-    if (ImGui::BeginPopupModal("Loading..##LOAD", NULL, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoMove))
+    if (ImGui::Begin("Loading..##LOAD", NULL, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoCollapse))
     {
-      ImGui::Text("path: %s", open_filepath.string().c_str());
-
-      if (open_job.is_running())
-      {
-        open_job.draw();
-      }
-      else if (open_job.failed)
-      {
-        ImGui::Text("error, couldn't load savefile");
-        ImGui::Separator();
-        if (ImGui::Button("OK", ImVec2(ImGui::GetContentRegionAvail().x, 0)))
-          ImGui::CloseCurrentPopup();
-      }
-      else
+      for (auto it = m_open_requests.begin(); it != m_open_requests.end();)
       {
-        ImGui::CloseCurrentPopup();
-      }
+        scoped_imgui_id _sii(&*it);
+        auto& job = it->job;
 
-      ImGui::EndPopup();
-    }
+        if (it != m_open_requests.begin())
+          ImGui::Separator();
+        ImGui::Text("path: %s", it->filepath.string().c_str());
 
-    if (pushed_stylecol)
-      ImGui::PopStyleColor();
+        if (job.is_running())
+        {
+          job.draw();
+          if (job.is_cancelled())
+            ImGui::TextDisabled("cancelling...");
+          else if (ImGui::Button("Cancel"))
+            job.cancel();
+        }
+        else if (job.failed)
+        {
+          ImGui::TextColored(ImVec4(1.f, 0.3f, 0.3f, 1.f), "error, couldn't load savefile: %s", job.error.c_str());
+          job.draw_timings();
+          if (ImGui::Button("OK"))
+          {
+            it = m_open_requests.erase(it);
+            continue;
+          }
+        }
+
+        ++it;
+      }
+    }
+    ImGui::End();
   }
 };
 
@@ -1,5 +1,6 @@
 #pragma once
 #include "node_editors.hpp"
+#include <cpinternals/common/instrumentation.hpp>
 
 class hexeditor_windows_mgr
 {
@@ -61,8 +62,22 @@ public:
     return window.get();
   }
 
+  // true if an opened window edits a node accepted by pred
+  template <typename Pred>
+  bool any_opened_window(Pred&& pred) const
+  {
+    for (const auto& [weak_node, window] : m_windows)
+    {
+      auto n = weak_node.lock();
+      if (n && window && window->is_opened() && pred(n))
+        return true;
+    }
+    return false;
+  }
+
   void draw_windows()
   {
+    cp::scoped_span span("ui.hexeditor_windows.draw");
     uint64_t id = (uint64_t)this;
     for (auto it = m_windows.begin(); it != m_windows.end();)
     {
@@ -1,6 +1,8 @@
 #pragma once
 #include <appbase/IApp.hpp>
 #include <list>
+#include <cpinternals/common/stable_vector.hpp>
+#include "virtual_list.hpp"
 
 
 inline bool imgui_close_button(ImGuiID id, const ImVec2& pos, const float height)
@@ -57,13 +59,22 @@ inline bool imgui_list_tree_widget(std::list<T>& l, GetTNameStringFn&& name_fn,
 
   scoped_imgui_id _sii(&l);
 
+  // collapsed items out of view are skipped (their label isn't built)
+  imgui_row_skipper skipper(window->GetID("##rows"));
+
   for (auto it = l.begin(); it != l.end();)
   {
     scoped_imgui_id _sii1(&*it);
 
-    auto label = std::forward<GetTNameStringFn>(name_fn)(*it);
     auto id = window->GetID(&*it);
-    bool expand = ImGui::TreeNodeBehavior(window->GetID(&*it), flags, label.c_str());
+    if (skipper.skip(ImGui::TreeNodeBehaviorIsOpen(id, flags)))
+    {
+      ++it;
+      continue;
+    }
+
+    const auto& label = std::forward<GetTNameStringFn>(name_fn)(*it);
+    bool expand = ImGui::TreeNodeBehavior(id, flags, label.c_str());
 
     ImGuiContext& g = *ImGui::GetCurrentContext();
     ImGuiLastItemDataBackup last_item_backup {};
@@ -91,6 +102,8 @@ inline bool imgui_list_tree_widget(std::list<T>& l, GetTNameStringFn&& name_fn,
       ImGui::TreePop();
     }
 
+    skipper.end_row();
+
     if (removed)
     {
       it = l.erase(it);
@@ -100,6 +113,92 @@ inline bool imgui_list_tree_widget(std::list<T>& l, GetTNameStringFn&& name_fn,
       ++it;
   }
 
+  skipper.flush();
+
+  if (default_insertable && ImGui::SmallButton("append new"))
+  {
+    modified = true;
+    l.push_back(T{}); // todo: CreateNewTFn parameter
+  }
+
+  return modified;
+}
+
+// same for stable_vector, items are identified by their stable id
+template <typename T, typename GetTNameStringFn, typename DrawTContentFn>
+inline bool imgui_list_tree_widget(cp::stable_vector<T>& l, GetTNameStringFn&& name_fn, DrawTContentFn&& draw_fn, ImGuiTreeNodeFlags flags = 0, bool erasable_items=true, bool default_insertable=true, uint32_t clipcnt = 0)
+{
+  ImGuiWindow* window = ImGui::GetCurrentWindow();
+  if (window->SkipItems)
+    return false;
+
+  bool modified = false;
+
+  if (default_insertable && ImGui::SmallButton("prepend new"))
+  {
+    modified = true;
+    l.push_front(T{}); // todo: CreateNewTFn parameter
+  }
+
+  if (l.empty())
+  {
+    ImGui::Text("empty list");
+    return false;
+  }
+
+  if (erasable_items && (flags & ImGuiTreeNodeFlags_SpanAvailWidth))
+    flags |= ImGuiTreeNodeFlags_AllowItemOverlap | ImGuiTreeNodeFlags_ClipLabelForTrailingButton;
+
+  scoped_imgui_id _sii(&l);
+
+  // collapsed items out of view are skipped (their label isn't built)
+  imgui_row_skipper skipper(window->GetID("##rows"));
+
+  for (size_t i = 0; i < l.size();)
+  {
+    const int item_id = (int)l.id(i);
+    ImGui::PushID(item_id);
+
+    const ImGuiID id = window->GetID(item_id);
+    if (skipper.skip(ImGui::TreeNodeBehaviorIsOpen(id, flags)))
+    {
+      ImGui::PopID();
+      ++i;
+      continue;
+    }
+
+    const auto& label = std::forward<GetTNameStringFn>(name_fn)(l[i]);
+    bool expand = ImGui::TreeNodeBehavior(id, flags, label.c_str());
+
+    ImGuiLastItemDataBackup last_item_backup {};
+    bool removed = false;
+    if (erasable_items)
+    {
+      ImGui::SameLine();
+      removed = ImGui::SmallButton("remove");
+    }
+    last_item_backup.Restore();
+
+    if (expand)
+    {
+      modified |= std::forward<DrawTContentFn>(draw_fn)(l[i]);
+      ImGui::TreePop();
+    }
+
+    skipper.end_row();
+    ImGui::PopID();
+
+    if (removed)
+    {
+      i = l.erase(i);
+      modified = true;
+    }
+    else
+      ++i;
+  }
+
+  skipper.flush();
+
   if (default_insertable && ImGui::SmallButton("append new"))
   {
     modified = true;
@@ -9,11 +9,23 @@
 #include "hexedit.hpp"
 #include "appbase/extras/imgui_stdlib.h"
 
+// edits a string of the appearance records, the new value is interned
+// (other records that referenced the old one keep it)
+inline bool cetr_string_input(const char* label, cp::csav::cetr_string_table& strings, uint32_t& idx)
+{
+  std::string s = strings.at(idx);
+  if (ImGui::InputText(label, &s))
+  {
+    idx = strings.intern(s);
+    return true;
+  }
+  return false;
+}
 
 struct cetr_uk_thing5_widget
 {
   // returns true if content has been edited
-  [[nodiscard]] static inline bool draw(cp::csav::cetr_uk_thing5& x)
+  [[nodiscard]] static inline bool draw(cp::csav::cetr_uk_thing5& x, cp::csav::cetr_string_table& strings)
   {
     ImGuiWindow* window = ImGui::GetCurrentWindow();
     if (window->SkipItems)
@@ -21,9 +33,9 @@ struct cetr_uk_thing5_widget
 
     bool modified = false;
 
-    modified |= ImGui::InputText("uk_string_1##cetr5", &x.uk0);
-    modified |= ImGui::InputText("uk_string_2##cetr5", &x.uk1);
-    modified |= ImGui::InputText("uk_string_3##cetr5", &x.uk2);
+    modified |= cetr_string_input("uk_string_1##cetr5", strings, x.uk0);
+    modified |= cetr_string_input("uk_string_2##cetr5", strings, x.uk1);
+    modified |= cetr_string_input("uk_string_3##cetr5", strings, x.uk2);
 
     return modified;
   }
@@ -33,7 +45,7 @@ struct cetr_uk_thing5_widget
 struct cetr_uk_thing4_widget
 {
   // returns true if content has been edited
-  [[nodiscard]] static inline bool draw(cp::csav::cetr_uk_thing4& x)
+  [[nodiscard]] static inline bool draw(cp::csav::cetr_uk_thing4& x, cp::csav::cetr_string_table& strings)
   {
     ImGuiWindow* window = ImGui::GetCurrentWindow();
     if (window->SkipItems)
@@ -41,8 +53,8 @@ struct cetr_uk_thing4_widget
 
     bool modified = false;
 
-    modified |= ImGui::InputText("uk_string_1##cetr4", &x.uk0);
-    modified |= ImGui::InputText("uk_string_2##cetr4", &x.uk1);
+    modified |= cetr_string_input("uk_string_1##cetr4", strings, x.uk0);
+    modified |= cetr_string_input("uk_string_2##cetr4", strings, x.uk1);
 
     modified |= ImGui::InputScalar("uk_u32_1(hex)##cetr4", ImGuiDataType_U32, &x.uk2, NULL, NULL, "%08X", ImGuiInputTextFlags_CharsHexadecimal);
     modified |= ImGui::InputScalar("uk_u32_2(hex)##cetr4", ImGuiDataType_U32, &x.uk3, NULL, NULL, "%08X", ImGuiInputTextFlags_CharsHexadecimal);
@@ -54,7 +66,7 @@ struct cetr_uk_thing4_widget
 struct cetr_uk_thing3_widget
 {
   // returns true if content has been edited
-  [[nodiscard]] static inline bool draw(cp::csav::cetr_uk_thing3& x)
+  [[nodiscard]] static inline bool draw(cp::csav::cetr_uk_thing3& x, cp::csav::cetr_string_table& strings)
   {
     ImGuiWindow* window = ImGui::GetCurrentWindow();
     if (window->SkipItems)
@@ -64,8 +76,8 @@ struct cetr_uk_thing3_widget
 
     modified |= CName_widget::draw(x.cn, "Entry's CName##cetr3");
 
-    modified |= ImGui::InputText("Property Value##cetr3", &x.uk0);
-    modified |= ImGui::InputText("Property Type##cetr3", &x.uk1);
+    modified |= cetr_string_input("Property Value##cetr3", strings, x.uk0);
+    modified |= cetr_string_input("Property Type##cetr3", strings, x.uk1);
 
     modified |= ImGui::InputScalar("uk_u32_1(hex)##cetr3", ImGuiDataType_U32, &x.uk2, NULL, NULL, "%08X", ImGuiInputTextFlags_CharsHexadecimal);
     modified |= ImGui::InputScalar("uk_u32_2(hex)##cetr3", ImGuiDataType_U32, &x.uk3, NULL, NULL, "%08X", ImGuiInputTextFlags_CharsHexadecimal);
@@ -77,7 +89,7 @@ struct cetr_uk_thing3_widget
 struct cetr_uk_thing2_widget
 {
   // returns true if content has been edited
-  [[nodiscard]] static inline bool draw(cp::csav::cetr_uk_thing2& x)
+  [[nodiscard]] static inline bool draw(cp::csav::cetr_uk_thing2& x, cp::csav::cetr_string_table& strings)
   {
     ImGuiWindow* window = ImGui::GetCurrentWindow();
     if (window->SkipItems)
@@ -85,18 +97,20 @@ struct cetr_uk_thing2_widget
 
     bool modified = false;
 
-    modified |= ImGui::InputText("name##cetr2", &x.uks);
+    modified |= cetr_string_input("name##cetr2", strings, x.uks);
 
     if (ImGui::TreeNode("Array #1##cetr2"))
     {
       static auto name_fn = [](const cp::csav::cetr_uk_thing3& y) { return y.cn.gstr().string(); };
-      modified |= imgui_list_tree_widget(x.vuk3, name_fn, &cetr_uk_thing3_widget::draw, 0, true, true);
+      auto draw_fn = [&](cp::csav::cetr_uk_thing3& y) { return cetr_uk_thing3_widget::draw(y, strings); };
+      modified |= imgui_list_tree_widget(x.vuk3, name_fn, draw_fn, 0, true, true);
       ImGui::TreePop();
     }
     if (ImGui::TreeNode("Array #2##cetr2"))
     {
-      static auto name_fn = [](const cp::csav::cetr_uk_thing4& y) { return y.uk0; };
-      modified |= imgui_list_tree_widget(x.vuk4, name_fn, &cetr_uk_thing4_widget::draw, 0, true, true);
+      auto name_fn = [&](const cp::csav::cetr_uk_thing4& y) { return strings.at(y.uk0); };
+      auto draw_fn = [&](cp::csav::cetr_uk_thing4& y) { return cetr_uk_thing4_widget::draw(y, strings); };
+      modified |= imgui_list_tree_widget(x.vuk4, name_fn, draw_fn, 0, true, true);
       ImGui::TreePop();
     }
 
@@ -107,7 +121,7 @@ struct cetr_uk_thing2_widget
 struct cetr_uk_thing1_widget
 {
   // returns true if content has been edited
-  [[nodiscard]] static inline bool draw(cp::csav::cetr_uk_thing1& x, bool editable_list = false)
+  [[nodiscard]] static inline bool draw(cp::csav::cetr_uk_thing1& x, cp::csav::cetr_string_table& strings, bool editable_list = false)
   {
     ImGuiWindow* window = ImGui::GetCurrentWindow();
     if (window->SkipItems)
@@ -115,8 +129,9 @@ struct cetr_uk_thing1_widget
 
     bool modified = false;
 
-    static auto name_fn = [](const cp::csav::cetr_uk_thing2& y) { return y.uks; };
-    modified |= imgui_list_tree_widget(x.vuk2, name_fn, &cetr_uk_thing2_widget::draw, 0, editable_list, editable_list);
+    auto name_fn = [&](const cp::csav::cetr_uk_thing2& y) { return strings.at(y.uks); };
+    auto draw_fn = [&](cp::csav::cetr_uk_thing2& y) { return cetr_uk_thing2_widget::draw(y, strings); };
+    modified |= imgui_list_tree_widget(x.vuk2, name_fn, draw_fn, 0, editable_list, editable_list);
 
     return modified;
   }
@@ -149,33 +164,34 @@ struct CCharacterCustomization_widget
 
     if (ImGui::TreeNode("Struct #1##cetr"))
     {
-      modified |= cetr_uk_thing1_widget::draw(x.ukt0);
+      modified |= cetr_uk_thing1_widget::draw(x.ukt0, x.strings);
       ImGui::TreePop();
     }
 
     if (ImGui::TreeNode("Struct #2##cetr"))
     {
-      modified |= cetr_uk_thing1_widget::draw(x.ukt1, true);
+      modified |= cetr_uk_thing1_widget::draw(x.ukt1, x.strings, true);
       ImGui::TreePop();
     }
 
     if (ImGui::TreeNode("Struct #3##cetr"))
     {
-      modified |= cetr_uk_thing1_widget::draw(x.ukt2, true);
+      modified |= cetr_uk_thing1_widget::draw(x.ukt2, x.strings, true);
       ImGui::TreePop();
     }
 
     if (ImGui::TreeNode("Array #1##cetr"))
     {
       static auto name_fn = [](const cp::csav::cetr_uk_thing5& y) { return std::string("unnamed"); };
-      modified |= imgui_list_tree_widget(x.ukt5, name_fn, &cetr_uk_thing5_widget::draw, 0, true, true);
+      auto draw_fn = [&](cp::csav::cetr_uk_thing5& y) { return cetr_uk_thing5_widget::draw(y, x.strings); };
+      modified |= imgui_list_tree_widget(x.ukt5, name_fn, draw_fn, 0, true, true);
       ImGui::TreePop();
     }
 
     if (ImGui::TreeNode("Array #2##cetr"))
     {
-      static auto name_fn = [](const std::string& y) { return y; };
-      static auto edit_fn = [](std::string& y) { return ImGui::InputText("string", &y); };
+      auto name_fn = [&](const uint32_t& y) { return x.strings.at(y); };
+      auto edit_fn = [&](uint32_t& y) { return cetr_string_input("string", x.strings, y); };
       modified |= imgui_list_tree_widget(x.uk6s, name_fn, edit_fn, 0, true, true);
       ImGui::TreePop();
     }
@@ -131,6 +131,70 @@ struct CPSData_widget
     return true;
   }
 
+  // class selection, objects are found through CPSData::find_objects
+  static inline std::string class_filter;
+  static inline std::string selected_class;
+
+  // same layout as CSystem_widget, restricted to the objects of one class
+  [[nodiscard]] static inline bool draw_class_objects(cp::csav::CPSData& psdata, const std::vector<uint32_t>& indices, int* selected_object)
+  {
+    bool modified = false;
+
+    auto& objects = psdata.system().objects();
+
+    static ImGuiTableFlags tbl_flags = ImGuiTableFlags_BordersOuter | ImGuiTableFlags_BordersV
+      | ImGuiTableFlags_Resizable;
+
+    ImVec2 size = ImVec2(-FLT_MIN, ImGui::GetContentRegionAvail().y);
+    if (ImGui::BeginTable("##class_objects", 2, tbl_flags, size))
+    {
+      ImGui::TableSetupScrollFreeze(0, 1);
+      ImGui::TableSetupColumn("objects", ImGuiTableColumnFlags_WidthFixed, 230.f);
+      ImGui::TableSetupColumn("selected object", ImGuiTableColumnFlags_WidthStretch);
+      ImGui::TableHeadersRow();
+
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn();
+
+      ImGui::BeginChild("Objects", ImVec2(-FLT_MIN, 0));
+      ImGuiListClipper clipper;
+      clipper.Begin((int)indices.size(), ImGui::GetTextLineHeightWithSpacing());
+      while (clipper.Step())
+      {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+        {
+          const int object_idx = (int)indices[i];
+          ImGui::PushID(object_idx);
+          if (ImGui::Selectable(fmt::format("{:>3d} {}", object_idx, selected_class).c_str(), object_idx == *selected_object))
+            *selected_object = object_idx;
+          ImGui::PopID();
+        }
+      }
+      ImGui::EndChild();
+
+      ImGui::TableNextColumn();
+
+      ImGui::BeginChild("Selected Object");
+
+      int object_idx = *selected_object;
+      if (object_idx >= 0 && object_idx < objects.size())
+      {
+        auto& obj = objects[object_idx];
+        auto ctype = obj->ctypename();
+        ImGui::Text("object type: %s", ctype.c_str());
+        modified |= obj->imgui_widget(ctype.c_str(), true);
+      }
+      else
+        ImGui::Text("no selected object");
+
+      ImGui::EndChild();
+
+      ImGui::EndTable();
+    }
+
+    return modified;
+  }
+
   // returns true if content has been edited
   [[nodiscard]] static inline bool draw(cp::csav::CPSData& psdata, int* selected_object)
   {
@@ -143,8 +207,45 @@ struct CPSData_widget
       ImGui::EndChild();
     }
 
+    ImGui::InputText("class filter", &class_filter);
+    if (ImGui::BeginCombo("class", selected_class.empty() ? "(all)" : selected_class.c_str()))
+    {
+      if (ImGui::Selectable("(all)", selected_class.empty()))
+        selected_class.clear();
+
+      for (const auto& ctypename : psdata.m_obj_ctypenames)
+      {
+        if (!class_filter.empty() && ctypename.find(class_filter) == std::string::npos)
+          continue;
+
+        if (ImGui::Selectable(ctypename.c_str(), ctypename == selected_class))
+        {
+          selected_class = ctypename;
+          *selected_object = -1;
+        }
+      }
+
+      ImGui::EndCombo();
+    }
+
+    const std::vector<uint32_t>* class_objects = nullptr;
+    if (!selected_class.empty())
+      class_objects = psdata.find_objects(gname(selected_class));
+
     //ImGui::Text("PSData");
-    modified |= CSystem_widget::draw(psdata.system(), selected_object);
+    if (class_objects)
+    {
+      modified |= draw_class_objects(psdata, *class_objects, selected_object);
+    }
+    else
+    {
+      const size_t objects_cnt = psdata.system().objects().size();
+      modified |= CSystem_widget::draw(psdata.system(), selected_object);
+
+      // an object was erased
+      if (psdata.system().objects().size() != objects_cnt)
+        psdata.build_index();
+    }
 
     static int selected_dummy = -1;
     ImGui::ListBox("trailing names", &selected_dummy, &trailing_name_string_getter, (void*)&psdata.trailing_names, (int)psdata.trailing_names.size());
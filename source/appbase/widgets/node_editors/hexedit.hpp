@@ -1,14 +1,18 @@
 #pragma once
 
 #include "node_editor.hpp"
+#include "piece_table.hpp"
 #include "cpinternals/utils.hpp"
 #include "appbase/extras/imgui_memory_editor.hpp"
 
+// edits are kept in a piece table over a copy of the node data taken on
+// reload: typing, pasting or erasing doesn't move the rest of the buffer,
+// and commit only writes the edited ranges when the size didn't change.
 class node_hexeditor
   : public node_editor_widget
 {
   static inline std::vector<char> m_clipboard;
-  std::vector<char> editbuf;
+  byte_piece_table m_buf;
   MemoryEditor me;
   bool m_write_event = false;
 
@@ -30,8 +34,8 @@ public:
 
   void select(size_t offset, size_t len)
   {
-    me.DataSelectionStart = std::min(offset, editbuf.size() - 1);
-    me.DataSelectionEnd = std::min(offset + len - 1, editbuf.size() - 1);
+    me.DataSelectionStart = std::min(offset, m_buf.size() - 1);
+    me.DataSelectionEnd = std::min(offset + len - 1, m_buf.size() - 1);
     me.DataEditingAddr = -1; // cancel pending edit that shouldn't exist anyway
     me.ScrollToAddrNext = me.DataSelectionStart;
   }
@@ -39,7 +43,7 @@ public:
 protected:
   static inline ImU8 read_fn(const ImU8* data, size_t off)
   {
-    auto& buf = ((node_hexeditor*)data)->editbuf;
+    auto& buf = ((node_hexeditor*)data)->m_buf;
     if (off < buf.size())
       return buf.at(off);
     return 0;
@@ -48,21 +52,17 @@ protected:
   static inline void write_fn(ImU8* data, size_t off, ImU8 d)
   {
     node_hexeditor* e = (node_hexeditor*)data;
-    auto& buf = e->editbuf;
-    if (off < buf.size() && buf[off] != d)
-    {
-      buf[off] = d;
+    if (e->m_buf.overwrite(off, (char)d))
       e->m_write_event = true;
-    }
   }
 
   static inline bool highlight_fn(const ImU8* data, size_t off)
   {
     const node_hexeditor* e = (node_hexeditor*)data;
-    auto& buf = e->editbuf;
-    auto& original = e->node()->data();
+    auto& buf = e->m_buf;
+    auto& original = buf.original();
     if (off < buf.size() && off < original.size())
-      return buf[off] != original[off];
+      return buf.at(off) != original[off];
     return false;
   }
 
@@ -74,7 +74,7 @@ protected:
     ImVec2 c1 = ImGui::GetCursorScreenPos();
 
     MemoryEditor::Sizes s;
-    me.CalcSizes(s, editbuf.size(), 0);
+    me.CalcSizes(s, m_buf.size(), 0);
     ImVec2 child_size = size;
     if (child_size.x <= 0)
       child_size.x = s.WindowWidth + 20.f;
@@ -84,7 +84,15 @@ protected:
     //ImGui::SetNextWindowSizeConstraints(ImVec2(0.0f, 0.0f), ImVec2(s.WindowWidth, FLT_MAX));
     ImGui::BeginChild(id, child_size, 1, ImGuiWindowFlags_AlwaysAutoResize);
 
-    me.DrawContents((void*)this, editbuf.size(), 0);
+    me.DrawContents((void*)this, m_buf.size(), 0);
+
+    if (ImGui::IsWindowFocused(ImGuiFocusedFlags_ChildWindows) && ImGui::GetIO().KeyCtrl)
+    {
+      if (ImGui::IsKeyPressed('Z'))
+        modified |= m_buf.undo();
+      else if (ImGui::IsKeyPressed('Y'))
+        modified |= m_buf.redo();
+    }
 
     //if (ImGui::IsWindowHovered(ImGuiHoveredFlags_ChildWindows))
     //  ImGui::Text("Window Hovered");
@@ -98,35 +106,40 @@ protected:
 
     if (ImGui::BeginPopup("context##hexedit"))
     {
-      if (me.DataSelectionStart != (size_t)-1 || editbuf.empty())
+      if (ImGui::Selectable("undo (ctrl+z)", false, m_buf.can_undo() ? 0 : ImGuiSelectableFlags_Disabled))
+        modified |= m_buf.undo();
+      if (ImGui::Selectable("redo (ctrl+y)", false, m_buf.can_redo() ? 0 : ImGuiSelectableFlags_Disabled))
+        modified |= m_buf.redo();
+      ImGui::Separator();
+
+      if (me.DataSelectionStart != (size_t)-1 || m_buf.empty())
       {
         size_t seladdr_beg = me.SelectionStart();
         size_t seladdr_end = seladdr_beg + me.SelectionLen();
 
-        if (editbuf.empty()) {
+        if (m_buf.empty()) {
           seladdr_beg = 0;
           seladdr_end = 0;
         }
 
-        if (!editbuf.empty())
+        if (!m_buf.empty())
         {
           if (ImGui::Selectable("copy"))
-            m_clipboard.assign(editbuf.begin() + seladdr_beg, editbuf.begin() + seladdr_end);
+            m_clipboard = m_buf.read(seladdr_beg, seladdr_end - seladdr_beg);
 
           if (ImGui::Selectable("paste"))
           {
-            editbuf.erase(editbuf.begin() + seladdr_beg, editbuf.begin() + seladdr_end);
-            editbuf.insert(editbuf.begin() + seladdr_beg, m_clipboard.begin(), m_clipboard.end());
+            m_buf.replace(seladdr_beg, seladdr_end - seladdr_beg, m_clipboard.data(), m_clipboard.size());
             modified = true;
           }
           if (ImGui::Selectable("paste insert"))
           {
-            editbuf.insert(editbuf.begin() + seladdr_beg, m_clipboard.begin(), m_clipboard.end());
+            m_buf.insert(seladdr_beg, m_clipboard.data(), m_clipboard.size());
             modified = true;
           }
           if (ImGui::Selectable("erase"))
           {
-            editbuf.erase(editbuf.begin() + seladdr_beg, editbuf.begin() + seladdr_end);
+            m_buf.erase(seladdr_beg, seladdr_end - seladdr_beg);
             modified = true;
           }
           ImGui::Separator();
@@ -143,7 +156,7 @@ protected:
         if (ImGui::Selectable("insert"))
         {
           std::vector<char> values((size_t)cnt, value);
-          editbuf.insert(editbuf.begin() + seladdr_beg, values.begin(), values.end());
+          m_buf.insert(seladdr_beg, values.data(), values.size());
           modified = true;
         }
       }
@@ -162,14 +175,33 @@ protected:
 
   bool commit_impl() override
   {
-    ncnode()->assign_data(editbuf.begin(), editbuf.end());
+    auto node = ncnode();
+    if (!node)
+      return false;
+
+    // the node still holds the original (not modified by another editor)
+    if (!is_dirty() && m_buf.size() == node->data().size())
+    {
+      node->edit_data([this](std::vector<char>& data) {
+        m_buf.for_each_changed_range([&](size_t offset, const char* src, size_t len) {
+          std::memcpy(data.data() + offset, src, len);
+        });
+      });
+    }
+    else
+    {
+      const auto buf = m_buf.materialize();
+      node->assign_data(buf.begin(), buf.end());
+    }
+
+    m_buf.rebase();
     return true;
   }
 
   bool reload_impl() override 
   {
-    const auto& buf = node()->data();
-    editbuf.assign(buf.begin(), buf.end());
+    const auto data = node()->data();
+    m_buf.reset({data.begin(), data.end()});
     return true;
   }
 };
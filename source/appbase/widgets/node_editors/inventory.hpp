@@ -5,6 +5,7 @@
 #include "cpinternals/ctypes.hpp"
 #include "cpinternals/csav/nodes/CInventory.hpp"
 #include "itemData.hpp"
+#include "appbase/widgets/view_cache.hpp"
 
 
 // to be used with CInventory struct
@@ -12,8 +13,41 @@ struct CInventory_widget
 {
   //static CItemData copied_item = ;
 
+  // labels kept across frames, owned by the caller (one per inventory)
+  struct view
+  {
+    imgui_label_cache<uint64_t> subinv_labels; // by uid
+    imgui_label_cache<uint64_t> item_labels;   // by subinv id << 32 | item id
+
+    void sync(uint64_t generation)
+    {
+      subinv_labels.sync(generation);
+      item_labels.sync(generation);
+    }
+
+    size_t memory_usage() const
+    {
+      return subinv_labels.memory_usage() + item_labels.memory_usage();
+    }
+  };
+
+  static std::string subinv_label(uint64_t uid)
+  {
+    switch (uid)
+    {
+      case 1: return "V's bag";
+      case 0x00000000000F4240: return "Car Stash";
+      case 0x38E8D0C9F9A087AE: return "Nomade Stash";
+      case 0x6E48C594562422DE: return "Judy's Stash";
+      case 0x7901DE03D136A5AF: return "V's Wardrobe";
+      case 0xEDAD8C9B086A615E: return "River's Stash";
+      default: break;
+    }
+    return fmt::format("inventory_{:016X}", uid);
+  }
+
   // returns true if content has been edited
-  [[nodiscard]] static inline bool draw(cp::csav::CInventory& inv, cp::csav::CStats* stats=nullptr)
+  [[nodiscard]] static inline bool draw(cp::csav::CInventory& inv, view& v, cp::csav::CStats* stats=nullptr)
   {
     if (!inv.has_valid_data)
       ImGui::Text("has invalid data");
@@ -22,34 +56,22 @@ struct CInventory_widget
     //scoped_imgui_id _sii("##inventory_editor");
     bool modified = false;
 
-    for (auto inv_it = inv.m_subinvs.begin(); inv_it != inv.m_subinvs.end(); ++inv_it)
+    for (size_t inv_idx = 0; inv_idx < inv.m_subinvs.size(); ++inv_idx)
     {
       ImGuiWindow* window = ImGui::GetCurrentWindow();
-      ImGuiID row_id = window->GetID(&*inv_it);
-
-      auto& subinv = *inv_it;
+      ImGuiID row_id = window->GetID((int)inv.m_subinvs.id(inv_idx));
 
+      auto& subinv = inv.m_subinvs[inv_idx];
 
-      std::string inv_label = "V's bag";
-      switch (subinv.uid)
-      {
-        case 1: break;
-        case 0x00000000000F4240: inv_label = "Car Stash"; break;
-        case 0x38E8D0C9F9A087AE: inv_label = "Nomade Stash"; break;
-        case 0x6E48C594562422DE: inv_label = "Judy's Stash"; break;
-        case 0x7901DE03D136A5AF: inv_label = "V's Wardrobe"; break;
-        case 0xEDAD8C9B086A615E: inv_label = "River's Stash"; break;
-        default:
-          inv_label = fmt::format("inventory_{:016X}", subinv.uid);break;
-      }
+      const auto& inv_label = v.subinv_labels.get(subinv.uid, [&]() { return subinv_label(subinv.uid); });
 
       if (ImGui::TreeNodeBehavior(row_id, ImGuiTreeNodeFlags_Framed, inv_label.c_str()))
       {
         if (ImGui::Button("Sort (alpha)", ImVec2(0, 30)))
         {
-          subinv.items.sort([](const cp::csav::CItemData& a, const cp::csav::CItemData& b){
-            return a.name() < b.name();
-          });
+          // names are resolved once per item
+          subinv.items.sort_by_key([](const cp::csav::CItemData& item) { return item.name().strv(); });
+          modified = true;
         }
         ImGui::SameLine();
         if (ImGui::Button("Add dummy item (alcohol6)", ImVec2(0, 30)))
@@ -60,7 +82,7 @@ struct CInventory_widget
           item_data.iid.uk.uk4 = 2;
           item_data.uk1_012 = 0x213ACD;
           item_data.quantity = 1; // quantity
-          subinv.items.insert(subinv.items.begin(), 1, item_data);
+          subinv.items.push_front(item_data);
           modified = true;
         }
         ImGui::SameLine();
@@ -71,16 +93,29 @@ struct CInventory_widget
           modified = true;
         }
 
-        static auto name_fn = [](const cp::csav::CItemData& item) { return item.iid.shortname(); };
-        modified |= imgui_list_tree_widget(subinv.items, name_fn,
-         [stats](cp::csav::CItemData& itemData) { return CItemData_widget::draw(itemData, stats); },
-         0, true, false);
+        const uint64_t subinv_key = (uint64_t)inv.m_subinvs.id(inv_idx) << 32;
+        auto name_fn = [&](const cp::csav::CItemData& item) -> const std::string& {
+          const size_t item_idx = (size_t)(&item - subinv.items.data());
+          return v.item_labels.get(subinv_key | subinv.items.id(item_idx), [&]() { return item.iid.shortname().strv(); });
+        };
+
+        if (imgui_list_tree_widget(subinv.items, name_fn,
+          [stats](cp::csav::CItemData& itemData) { return CItemData_widget::draw(itemData, stats); },
+          0, true, false))
+        {
+          // an item may have been renamed
+          v.item_labels.invalidate();
+          modified = true;
+        }
 
         ImGui::TreePop();
       }
     }
     ImGui::EndChild();
 
+    if (modified)
+      inv.invalidate_index();
+
     return modified;
   }
 };
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <typeinfo>
 #include <functional>
 #include <vector>
 #include <map>
@@ -8,7 +9,9 @@
 #include <iostream>
 
 #include "appbase/IApp.hpp"
+#include "cpinternals/common/instrumentation.hpp"
 #include "cpinternals/csav/node.hpp"
+#include "cpinternals/csav/node_history.hpp"
 #include "cpinternals/csav/version.hpp"
 #include "spdlog/spdlog.h"
 
@@ -142,6 +145,8 @@ public:
 protected:
   void draw_content(const ImVec2& size = ImVec2(0, 0))
   {
+    // labelled with the editor type
+    cp::scoped_span span("ui.node_editor.draw", typeid(*this).name());
     m_is_drawing = true;
     m_has_unsaved_changes |= draw_impl(size);
     m_is_drawing = false;
@@ -149,6 +154,11 @@ protected:
 
 private:
   static inline std::vector<std::string> s_errors;
+  static inline cp::csav::node_history s_history;
+
+public:
+  // undo/redo of commits, shared by all editors (windows are global)
+  static cp::csav::node_history& history() { return s_history; }
 
 protected:
   void error(std::string_view msg)
@@ -159,6 +169,7 @@ protected:
 public:
   bool commit()
   {
+    s_history.record(fmt::format("commit {}", node_name()), node());
     if (!commit_impl())
     {
       error("commit failed");
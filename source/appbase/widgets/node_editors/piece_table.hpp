@@ -0,0 +1,298 @@
+#pragma once
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+// Editable byte sequence over an immutable original buffer.
+// The content is a list of pieces, each one a range of either the original
+// buffer or of an append-only buffer of added bytes. Edits split and merge
+// pieces instead of moving bytes: their cost depends on the number of
+// edited ranges, not on the size of the buffer.
+// Since bytes are never overwritten an undo step is a copy of the pieces.
+class byte_piece_table
+{
+public:
+  static constexpr size_t max_undo_steps = 256;
+
+  struct piece
+  {
+    bool added; // range of m_added instead of m_original
+    size_t src_offset;
+    size_t len;
+  };
+
+  byte_piece_table() = default;
+
+  void reset(std::vector<char> original)
+  {
+    m_original = std::move(original);
+    reset_pieces();
+  }
+
+  const std::vector<char>& original() const { return m_original; }
+
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+
+  // true if the content differs from the original (or may, after edits
+  // that cancel each other)
+  bool is_edited() const
+  {
+    if (m_pieces.empty())
+      return !m_original.empty();
+    const auto& p = m_pieces.front();
+    return m_pieces.size() != 1 || p.added || p.len != m_original.size();
+  }
+
+  char at(size_t offset) const
+  {
+    const size_t i = find_piece(offset);
+    const auto& p = m_pieces[i];
+    return source(p)[p.src_offset + (offset - m_starts[i])];
+  }
+
+  // copies [offset, offset + len) to dst, the range must be valid
+  void read(size_t offset, size_t len, char* dst) const
+  {
+    while (len)
+    {
+      const size_t i = find_piece(offset);
+      const auto& p = m_pieces[i];
+      const size_t rel = offset - m_starts[i];
+      const size_t n = std::min(len, p.len - rel);
+      std::memcpy(dst, source(p) + p.src_offset + rel, n);
+      dst += n;
+      offset += n;
+      len -= n;
+    }
+  }
+
+  std::vector<char> read(size_t offset, size_t len) const
+  {
+    std::vector<char> ret(len);
+    read(offset, len, ret.data());
+    return ret;
+  }
+
+  std::vector<char> materialize() const
+  {
+    return read(0, m_size);
+  }
+
+  // returns false if the byte already has this value
+  bool overwrite(size_t offset, char value)
+  {
+    if (offset >= m_size || at(offset) == value)
+      return false;
+    replace(offset, 1, &value, 1);
+    return true;
+  }
+
+  // replaces [offset, offset + erase_len) with data[0, len),
+  // the range is clamped to the content
+  void replace(size_t offset, size_t erase_len, const char* data, size_t len)
+  {
+    offset = std::min(offset, m_size);
+    erase_len = std::min(erase_len, m_size - offset);
+    if (!erase_len && !len)
+      return;
+
+    push_undo_step();
+
+    const size_t erase_end = offset + erase_len;
+    std::vector<piece> pieces;
+    pieces.reserve(m_pieces.size() + 2);
+
+    bool inserted = false;
+    const auto insert = [&]()
+    {
+      inserted = true;
+      if (len)
+      {
+        pieces.push_back(piece{true, m_added.size(), len});
+        m_added.insert(m_added.end(), data, data + len);
+      }
+    };
+
+    size_t pos = 0;
+    for (const auto& p : m_pieces)
+    {
+      const size_t end = pos + p.len;
+      if (pos < offset)
+        pieces.push_back(piece{p.added, p.src_offset, std::min(end, offset) - pos});
+      if (!inserted && end >= offset)
+        insert();
+      if (end > erase_end)
+      {
+        const size_t from = std::max(pos, erase_end);
+        pieces.push_back(piece{p.added, p.src_offset + (from - pos), end - from});
+      }
+      pos = end;
+    }
+
+    if (!inserted)
+      insert();
+
+    m_pieces = std::move(pieces);
+    merge_pieces();
+    update_starts();
+  }
+
+  void insert(size_t offset, const char* data, size_t len)
+  {
+    replace(offset, 0, data, len);
+  }
+
+  void erase(size_t offset, size_t len)
+  {
+    replace(offset, len, nullptr, 0);
+  }
+
+  bool can_undo() const { return !m_undo.empty(); }
+  bool can_redo() const { return !m_redo.empty(); }
+
+  bool undo()
+  {
+    if (m_undo.empty())
+      return false;
+    m_redo.push_back(std::move(m_pieces));
+    m_pieces = std::move(m_undo.back());
+    m_undo.pop_back();
+    update_starts();
+    return true;
+  }
+
+  bool redo()
+  {
+    if (m_redo.empty())
+      return false;
+    m_undo.push_back(std::move(m_pieces));
+    m_pieces = std::move(m_redo.back());
+    m_redo.pop_back();
+    update_starts();
+    return true;
+  }
+
+  // calls fn(offset, data, len) for each range whose bytes don't come from
+  // the same offset in the original, e.g. to patch a copy of the original.
+  // only valid if the size didn't change.
+  template <typename Fn>
+  void for_each_changed_range(Fn&& fn) const
+  {
+    for (size_t i = 0; i < m_pieces.size(); ++i)
+    {
+      const auto& p = m_pieces[i];
+      if (p.added || p.src_offset != m_starts[i])
+        fn(m_starts[i], source(p) + p.src_offset, p.len);
+    }
+  }
+
+  // makes the current content the original one, clears the undo history.
+  // the original is patched in place if only added ranges changed.
+  void rebase()
+  {
+    bool in_place = (m_size == m_original.size());
+    for (size_t i = 0; in_place && i < m_pieces.size(); ++i)
+    {
+      const auto& p = m_pieces[i];
+      in_place = p.added || p.src_offset == m_starts[i];
+    }
+
+    if (in_place)
+    {
+      for_each_changed_range([this](size_t offset, const char* data, size_t len) {
+        std::memcpy(m_original.data() + offset, data, len);
+      });
+    }
+    else
+    {
+      m_original = materialize();
+    }
+
+    reset_pieces();
+  }
+
+protected:
+  const char* source(const piece& p) const
+  {
+    return p.added ? m_added.data() : m_original.data();
+  }
+
+  void reset_pieces()
+  {
+    m_added.clear();
+    m_pieces.clear();
+    if (!m_original.empty())
+      m_pieces.push_back(piece{false, 0, m_original.size()});
+    m_undo.clear();
+    m_redo.clear();
+    update_starts();
+  }
+
+  void push_undo_step()
+  {
+    m_redo.clear();
+    m_undo.push_back(m_pieces);
+    if (m_undo.size() > max_undo_steps)
+      m_undo.pop_front();
+  }
+
+  // merges consecutive pieces that are contiguous in the same buffer,
+  // e.g. bytes typed one after the other
+  void merge_pieces()
+  {
+    size_t j = 0;
+    for (size_t i = 1; i < m_pieces.size(); ++i)
+    {
+      auto& last = m_pieces[j];
+      const auto& p = m_pieces[i];
+      if (p.added == last.added && last.src_offset + last.len == p.src_offset)
+        last.len += p.len;
+      else
+        m_pieces[++j] = p;
+    }
+    if (!m_pieces.empty())
+      m_pieces.resize(j + 1);
+  }
+
+  void update_starts()
+  {
+    m_starts.resize(m_pieces.size());
+    size_t pos = 0;
+    for (size_t i = 0; i < m_pieces.size(); ++i)
+    {
+      m_starts[i] = pos;
+      pos += m_pieces[i].len;
+    }
+    m_size = pos;
+    m_last_piece = 0;
+  }
+
+  // offset must be < size(), reads of visible rows are sequential so the
+  // last piece is checked first
+  size_t find_piece(size_t offset) const
+  {
+    if (m_last_piece < m_pieces.size())
+    {
+      const size_t start = m_starts[m_last_piece];
+      if (offset >= start && offset - start < m_pieces[m_last_piece].len)
+        return m_last_piece;
+    }
+
+    auto it = std::upper_bound(m_starts.begin(), m_starts.end(), offset);
+    m_last_piece = static_cast<size_t>(it - m_starts.begin()) - 1;
+    return m_last_piece;
+  }
+
+  std::vector<char> m_original;
+  std::vector<char> m_added;
+  std::vector<piece> m_pieces;
+  std::vector<size_t> m_starts; // offset of each piece in the content
+  size_t m_size = 0;
+  mutable size_t m_last_piece = 0;
+
+  std::deque<std::vector<piece>> m_undo;
+  std::deque<std::vector<piece>> m_redo;
+};
+
@@ -0,0 +1,269 @@
+#pragma once
+#include <inttypes.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <appbase/IApp.hpp>
+#include <cpinternals/csav/node.hpp>
+
+// Retained model of a node tree panel: the visible rows (children of the
+// expanded nodes, depth-first) are flattened with their labels once, and
+// only the rows under a node whose children changed are rebuilt (from the
+// children_update events of the expanded nodes, which are listened to).
+// draw() only submits the rows in the clip rect: a frame costs O(visible
+// rows) whatever the number of expanded nodes.
+// events can come from other threads, they are applied by the next draw().
+class node_tree_view
+  : public cp::csav::node_listener_t
+{
+public:
+  using node_type = cp::csav::node_t;
+  using shared_node_type = std::shared_ptr<const node_type>;
+
+  struct row
+  {
+    shared_node_type node;
+    std::string label;
+    uint32_t depth = 0;
+    bool expanded = false;
+  };
+
+  node_tree_view() = default;
+  node_tree_view(const node_tree_view&) = delete;
+  node_tree_view& operator=(const node_tree_view&) = delete;
+
+  ~node_tree_view() override
+  {
+    clear();
+  }
+
+  void clear()
+  {
+    for (const auto& [ptr, node] : m_expanded)
+      node->remove_listener(this);
+    m_expanded.clear();
+    m_rows.clear();
+    m_root.reset();
+
+    std::lock_guard<std::mutex> lock(m_pending_mtx);
+    m_pending.clear();
+  }
+
+  size_t rows_count() const
+  {
+    return m_rows.size();
+  }
+
+  // the children of root are the top-level rows, the rows are rebuilt if
+  // root has been replaced since the last call.
+  // draw_row_fn(const row&) submits the tree node item of the row (with
+  // ImGuiTreeNodeFlags_NoTreePushOnOpen) and returns its open state, the
+  // row is expanded or collapsed accordingly.
+  template <typename DrawRowFn>
+  void draw(const shared_node_type& root, DrawRowFn&& draw_row_fn)
+  {
+    sync(root);
+
+    // same as the tree pushes of nested tree nodes
+    const float indent_width = ImGui::GetStyle().IndentSpacing;
+    size_t toggled_idx = (size_t)-1;
+
+    ImGuiListClipper clipper;
+    clipper.Begin((int)m_rows.size());
+    while (clipper.Step())
+    {
+      for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+      {
+        const row& r = m_rows[i];
+        const float indent = r.depth * indent_width;
+        if (indent > 0.f)
+          ImGui::Indent(indent);
+
+        ImGui::SetNextItemOpen(r.expanded);
+        const bool opened = draw_row_fn(r);
+        if (opened != r.expanded && r.node->has_children())
+          toggled_idx = (size_t)i;
+
+        if (indent > 0.f)
+          ImGui::Unindent(indent);
+      }
+    }
+    clipper.End();
+
+    // rows are only spliced once the clipper is done with them
+    if (toggled_idx != (size_t)-1)
+    {
+      if (m_rows[toggled_idx].expanded)
+        collapse(toggled_idx);
+      else
+        expand(toggled_idx);
+    }
+  }
+
+  void on_node_event(const shared_node_type& node, cp::csav::node_event_e evt) override
+  {
+    if (evt != cp::csav::node_event_e::children_update)
+      return;
+
+    std::lock_guard<std::mutex> lock(m_pending_mtx);
+    m_pending.insert(node.get());
+  }
+
+protected:
+  static std::string make_label(const node_type& node)
+  {
+    if (node.is_blob() || node.is_root())
+      return node.name().string();
+    return fmt::format("{} ({})", node.name().c_str(), node.idx());
+  }
+
+  // appends the rows of node's children, recursively for the expanded ones
+  void flatten_children(const node_type& node, uint32_t depth, std::vector<row>& out) const
+  {
+    for (const auto& child : node.children())
+    {
+      if (!child)
+        continue;
+
+      const bool expanded = child->has_children() && m_expanded.count(child.get());
+      out.push_back(row{child, make_label(*child), depth, expanded});
+      if (expanded)
+        flatten_children(*child, depth + 1, out);
+    }
+  }
+
+  // end of the rows under the row at idx
+  size_t subtree_end(size_t idx) const
+  {
+    const uint32_t depth = m_rows[idx].depth;
+    size_t end = idx + 1;
+    while (end < m_rows.size() && m_rows[end].depth > depth)
+      ++end;
+    return end;
+  }
+
+  void listen(const shared_node_type& node)
+  {
+    if (m_expanded.emplace(node.get(), node).second)
+      node->add_listener(this);
+  }
+
+  void unlisten(const node_type* node)
+  {
+    auto it = m_expanded.find(node);
+    if (it != m_expanded.end())
+    {
+      it->second->remove_listener(this);
+      m_expanded.erase(it);
+    }
+  }
+
+  void expand(size_t idx)
+  {
+    row& r = m_rows[idx];
+    r.expanded = true;
+    listen(r.node);
+
+    std::vector<row> children;
+    flatten_children(*r.node, r.depth + 1, children);
+    m_rows.insert(m_rows.begin() + idx + 1, std::make_move_iterator(children.begin()), std::make_move_iterator(children.end()));
+  }
+
+  // the expanded descendants stay expanded (imgui's behavior)
+  void collapse(size_t idx)
+  {
+    m_rows[idx].expanded = false;
+    unlisten(m_rows[idx].node.get());
+    m_rows.erase(m_rows.begin() + idx + 1, m_rows.begin() + subtree_end(idx));
+  }
+
+  // replaces the rows in [begin, end) by the ones of parent's children,
+  // the expanded nodes that aren't visible anymore are forgotten
+  void replace_rows(size_t begin, size_t end, const node_type& parent, uint32_t depth)
+  {
+    std::unordered_set<const node_type*> old_expanded;
+    for (size_t i = begin; i < end; ++i)
+    {
+      if (m_rows[i].expanded)
+        old_expanded.insert(m_rows[i].node.get());
+    }
+
+    std::vector<row> rows;
+    flatten_children(parent, depth, rows);
+
+    for (const auto& r : rows)
+    {
+      if (r.expanded)
+        old_expanded.erase(r.node.get());
+    }
+    for (const node_type* n : old_expanded)
+      unlisten(n);
+
+    m_rows.erase(m_rows.begin() + begin, m_rows.begin() + end);
+    m_rows.insert(m_rows.begin() + begin, std::make_move_iterator(rows.begin()), std::make_move_iterator(rows.end()));
+  }
+
+  void rebuild_subtree(size_t idx)
+  {
+    row& r = m_rows[idx];
+    replace_rows(idx + 1, subtree_end(idx), *r.node, r.depth + 1);
+
+    if (!m_rows[idx].node->has_children())
+    {
+      m_rows[idx].expanded = false;
+      unlisten(m_rows[idx].node.get());
+    }
+  }
+
+  void sync(const shared_node_type& root)
+  {
+    if (root != m_root)
+    {
+      clear();
+      m_root = root;
+      if (m_root)
+      {
+        listen(m_root);
+        flatten_children(*m_root, 0, m_rows);
+      }
+      return;
+    }
+
+    std::unordered_set<const node_type*> pending;
+    {
+      std::lock_guard<std::mutex> lock(m_pending_mtx);
+      pending.swap(m_pending);
+    }
+
+    if (pending.empty() || !m_root)
+      return;
+
+    if (pending.count(m_root.get()))
+    {
+      // the top-level rows changed
+      replace_rows(0, m_rows.size(), *m_root, 0);
+      return;
+    }
+
+    // a rebuilt subtree can contain other pending nodes, they are found
+    // again in the new rows
+    for (size_t i = 0; i < m_rows.size() && !pending.empty(); ++i)
+    {
+      if (m_rows[i].expanded && pending.erase(m_rows[i].node.get()))
+        rebuild_subtree(i);
+    }
+  }
+
+  shared_node_type m_root;
+  std::vector<row> m_rows;
+  // listened nodes: the expanded ones and root, kept alive until unlistened
+  std::unordered_map<const node_type*, shared_node_type> m_expanded;
+
+  std::mutex m_pending_mtx;
+  std::unordered_set<const node_type*> m_pending;
+};
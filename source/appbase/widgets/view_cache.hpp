@@ -0,0 +1,57 @@
+#pragma once
+#include <inttypes.h>
+#include <string>
+#include <unordered_map>
+
+#include <cpinternals/common/memory_usage.hpp>
+
+// Display strings of a widget (formatted labels, resolved names..) kept
+// across frames, each one is built on first use.
+// The owner drops them when the displayed data changes: sync() with a
+// counter of the node events (e.g. node_tree::edits_count) before drawing,
+// invalidate() when a draw function reports an edit.
+template <typename KeyT>
+class imgui_label_cache
+{
+  std::unordered_map<KeyT, std::string> m_labels;
+  uint64_t m_generation = 0;
+
+public:
+  template <typename MakeFn>
+  const std::string& get(const KeyT& key, MakeFn&& make_fn)
+  {
+    auto it = m_labels.find(key);
+    if (it == m_labels.end())
+      it = m_labels.emplace(key, std::string(make_fn())).first;
+    return it->second;
+  }
+
+  void invalidate()
+  {
+    m_labels.clear();
+  }
+
+  // estimated heap bytes of the labels
+  size_t memory_usage() const
+  {
+    size_t bytes = cp::heap_bytes(m_labels);
+    for (const auto& [key, label] : m_labels)
+      bytes += cp::heap_bytes(label);
+    return bytes;
+  }
+
+  void invalidate(const KeyT& key)
+  {
+    m_labels.erase(key);
+  }
+
+  void sync(uint64_t generation)
+  {
+    if (generation != m_generation)
+    {
+      invalidate();
+      m_generation = generation;
+    }
+  }
+};
+
@@ -0,0 +1,106 @@
+#pragma once
+#include <appbase/IApp.hpp>
+
+// Virtualized rows for the node editor widgets: only visible rows are
+// submitted, hidden ones are not formatted nor resolved (names..) and are
+// replaced by blank space so that scrolling stays consistent.
+
+// rows of uniform height (e.g. table rows), draw_row_fn(i) is only called for
+// visible rows. row_height is measured on the first row if not given.
+template <typename DrawRowFn>
+inline void imgui_clipped_rows(int rows_cnt, DrawRowFn&& draw_row_fn, float row_height = -1.f)
+{
+  ImGuiListClipper clipper;
+  clipper.Begin(rows_cnt, row_height);
+  while (clipper.Step())
+  {
+    for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+      draw_row_fn(i);
+  }
+  clipper.End();
+}
+
+// rows of variable height (e.g. tree nodes that can be opened): collapsed
+// rows outside of the clip rect are skipped, open ones are always submitted.
+// the height of collapsed rows is measured on submitted ones and kept in the
+// window storage (under id) for the next frames.
+//
+//  imgui_row_skipper skipper(id);
+//  for (each row)
+//  {
+//    if (skipper.skip(is_open))
+//      continue;
+//    .. draw row ..
+//    skipper.end_row();
+//  }
+//  skipper.flush();
+class imgui_row_skipper
+{
+  ImGuiStorage* m_storage;
+  ImGuiID m_id;
+  float m_row_height;
+  float m_skipped = 0.f;
+  float m_row_start = 0.f;
+  bool m_measure = false;
+
+public:
+  explicit imgui_row_skipper(ImGuiID id)
+    : m_storage(ImGui::GetStateStorage()), m_id(id)
+  {
+    m_row_height = m_storage->GetFloat(id, ImGui::GetFrameHeightWithSpacing());
+  }
+
+  ~imgui_row_skipper()
+  {
+    flush();
+    m_storage->SetFloat(m_id, m_row_height);
+  }
+
+  imgui_row_skipper(const imgui_row_skipper&) = delete;
+  imgui_row_skipper& operator=(const imgui_row_skipper&) = delete;
+
+  // returns true if the row must not be submitted (it is accounted for),
+  // otherwise end_row() must be called after it
+  bool skip(bool is_open)
+  {
+    ImGuiWindow* window = ImGui::GetCurrentWindow();
+
+    if (!is_open)
+    {
+      const float y = window->DC.CursorPos.y + m_skipped;
+      if (y + m_row_height < window->ClipRect.Min.y || y > window->ClipRect.Max.y)
+      {
+        m_skipped += m_row_height;
+        return true;
+      }
+    }
+
+    flush();
+    m_measure = !is_open;
+    m_row_start = window->DC.CursorPos.y;
+    return false;
+  }
+
+  void end_row()
+  {
+    if (m_measure)
+    {
+      const float height = ImGui::GetCurrentWindow()->DC.CursorPos.y - m_row_start;
+      if (height > 0.f)
+        m_row_height = height;
+      m_measure = false;
+    }
+  }
+
+  // submits the skipped space, before any item that isn't a row
+  void flush()
+  {
+    if (m_skipped > 0.f)
+    {
+      // Dummy adds the item spacing
+      ImGui::Dummy(ImVec2(0.f, m_skipped - ImGui::GetStyle().ItemSpacing.y));
+      m_skipped = 0.f;
+    }
+  }
+};
+
@@ -8,7 +8,9 @@
 #include <filesystem>
 #include <cctype>
 #include <cwchar>
+#include <cwctype>
 #include <algorithm>
+#include <unordered_set>
 
 #include <cpinternals/common.hpp>
 
@@ -84,6 +86,37 @@ inline cpfs* fs_from_ffs(FSP_FILE_SYSTEM* FileSystem)
   return reinterpret_cast<cpfs*>(FileSystem->UserContext);
 }
 
+// the "stats" named stream of the root, a snapshot of cpfs_stats::report
+// taken on open
+inline bool is_stats_stream_path(std::wstring_view wfilepath)
+{
+  return wfilepath == L"\\:stats" || wfilepath == L"\\:stats:$DATA";
+}
+
+// "\dir\file:name[:$DATA]" -> "\dir\file", stream is "name" (empty for the
+// default stream)
+inline std::wstring_view split_stream_name(std::wstring_view wfilepath, std::wstring_view& stream)
+{
+  stream = {};
+
+  const size_t pos = wfilepath.find(L':');
+  if (pos == std::wstring_view::npos)
+  {
+    return wfilepath;
+  }
+
+  constexpr std::wstring_view type_suffix = L":$DATA";
+
+  stream = wfilepath.substr(pos + 1);
+  if (stream.size() >= type_suffix.size()
+    && _wcsnicmp(stream.data() + stream.size() - type_suffix.size(), type_suffix.data(), type_suffix.size()) == 0)
+  {
+    stream.remove_suffix(type_suffix.size());
+  }
+
+  return wfilepath.substr(0, pos);
+}
+
 
 void fill_fsp_info(FSP_FSCTL_FILE_INFO& fsp_finfo, const cp::filesystem::directory_entry& de)
 {
@@ -156,9 +189,28 @@ struct file_context
   {
     fsp_finfo = {};
 
-    if (is_tfs_file)
+    if (uncooked_data)
+    {
+      // times of the source file
+      fsp_finfo = tfs_finfo;
+      fsp_finfo.FileSize        = uncooked_data->size();
+      fsp_finfo.AllocationSize  = (uncooked_data->size() + 4095) / 4096 * 4096;
+    }
+    else if (is_stats_stream)
     {
-      ::fill_fsp_info(fsp_finfo, dirent);
+      const uint64_t now = cp::file_time(cp::clock::now()).hns_since_win_epoch;
+
+      fsp_finfo.FileAttributes  = FILE_ATTRIBUTE_ARCHIVE | FILE_ATTRIBUTE_READONLY;
+      fsp_finfo.FileSize        = stats_text.size();
+      fsp_finfo.AllocationSize  = (stats_text.size() + 4095) / 4096 * 4096;
+      fsp_finfo.CreationTime    = now;
+      fsp_finfo.LastAccessTime  = now;
+      fsp_finfo.LastWriteTime   = now;
+      fsp_finfo.ChangeTime      = now;
+    }
+    else if (is_tfs_file)
+    {
+      fsp_finfo = tfs_finfo;
     }
     else
     {
@@ -210,8 +262,13 @@ struct file_context
 
   bool is_tfs_file = false;
   cp::filesystem::directory_entry dirent;
-  cp::archive_file_stream afs;
-  mutable std::mutex m_afs_mtx;
+  // info of dirent, depot entries don't change while mounted
+  FSP_FSCTL_FILE_INFO tfs_finfo = {};
+  // positional reads only (see archive::read_file_range), shared by concurrent readers
+  cp::archive::file_handle fhandle;
+  // sequential access detection, reads of a handle can be concurrent
+  std::atomic<uint64_t> next_read_offset = 0;
+  std::atomic<uint32_t> readahead_end = 0; // blocks below it were already queued (reset on seeks)
   bool m_symlink = false;
 
   bool is_diff_only = false; // path cannot be converted to a cp path
@@ -219,6 +276,14 @@ struct file_context
   
   PVOID dir_buffer = nullptr;
   std::unordered_set<cp::filesystem::path_id> overridden_pids;
+
+  bool is_stats_stream = false;
+  std::string stats_text;
+
+  // file:raw, the reads serve the disk bytes of fhandle (tfs_finfo has their size)
+  bool is_raw_stream = false;
+  // file:<format>, converted on open
+  uncook_cache::buffer_type uncooked_data;
 };
 
 
@@ -259,14 +324,59 @@ NTSTATUS GetSecurityByName(
 
   std::wstring_view wfilepath = FileName;
 
+  if (is_stats_stream_path(wfilepath))
+  {
+    if (PFileAttributes != nullptr)
+    {
+      *PFileAttributes = FILE_ATTRIBUTE_ARCHIVE | FILE_ATTRIBUTE_READONLY;
+    }
+
+    if (PSecurityDescriptorSize != nullptr)
+    {
+      const size_t sd_size = file_context::sdesc().size();
+
+      if (sd_size > *PSecurityDescriptorSize)
+      {
+        *PSecurityDescriptorSize = sd_size;
+        return STATUS_BUFFER_OVERFLOW;
+      }
+      *PSecurityDescriptorSize = sd_size;
+
+      if (SecurityDescriptor != nullptr)
+      {
+        std::memcpy(SecurityDescriptor, file_context::sdesc().get(), sd_size);
+      }
+    }
+
+    return STATUS_SUCCESS;
+  }
+
+  // streams have the security of their file
+  std::wstring_view stream;
+  wfilepath = split_stream_name(wfilepath, stream);
+
+  // no path is built for the lookup
   bool tfs_compatible{};
-  cp::filesystem::path tfs_path(wfilepath, tfs_compatible);
+  bool tfs_by_pid{};
+  const cp::path_id tfs_pid = cp::filesystem::directory_entry::lookup_pid(wfilepath, tfs_by_pid, tfs_compatible);
 
   win_handle fh;
 
-  if (fs->has_diffdir)
+  // the index answers for the paths that aren't in the diff dir, the disk is
+  // only asked for the security of the overriding files
+  diffdir_index::entry diff_entry;
+  if (fs->has_diffdir && fs->diffdir.find(wfilepath, diff_entry))
   {
-    auto diff_path = fs->diffdir_path / FileName;
+    if (PSecurityDescriptorSize == nullptr)
+    {
+      if (PFileAttributes != nullptr)
+      {
+        *PFileAttributes = diff_entry.info.FileAttributes;
+      }
+      return STATUS_SUCCESS;
+    }
+
+    auto diff_path = fs->diffdir_path / wfilepath.substr(1);
 
     fh = win_handle(
       CreateFileW(
@@ -326,26 +436,31 @@ NTSTATUS GetSecurityByName(
 
   if (tfs_compatible)
   {
-    cp::filesystem::directory_entry entry(fs->tfs, tfs_path);
-    if (!entry.exists() || !(entry.is_file() || entry.is_directory()))
+    using entry_kind = cp::filesystem::detail::treefs::entry_kind;
+
+    const entry_kind kind = fs->tfs.get_entry_kind(tfs_pid);
+    const bool is_file = kind == entry_kind::file;
+    const bool is_directory = kind == entry_kind::directory || kind == entry_kind::root;
+
+    if (!is_file && !is_directory)
     {
       // TODO: if not found, check for parent directory
       // and return STATUS_NOT_A_DIRECTORY if parent isn't a dir
       // or STATUS_OBJECT_PATH_NOT_FOUND if not found
 
-      SPDLOG_INFO("no entry found for {}", tfs_path.strv());
+      SPDLOG_INFO("no entry found for {}", std::filesystem::path(wfilepath).string());
       return STATUS_OBJECT_NAME_NOT_FOUND;
     }
 
     if (PFileAttributes != nullptr)
     {
-      if (entry.is_pidlink())
+      if (tfs_by_pid)
       {
         *PFileAttributes = FILE_ATTRIBUTE_REPARSE_POINT | FILE_ATTRIBUTE_ARCHIVE;
       }
       else
       {
-        *PFileAttributes = entry.is_file() ? FILE_ATTRIBUTE_ARCHIVE : FILE_ATTRIBUTE_DIRECTORY;
+        *PFileAttributes = is_file ? FILE_ATTRIBUTE_ARCHIVE : FILE_ATTRIBUTE_DIRECTORY;
       }
     }
 
@@ -456,6 +571,83 @@ NTSTATUS Create(
   return STATUS_SUCCESS;
 }
 
+// opens file:raw or file:<format> of a depot file
+static NTSTATUS open_depot_stream(
+  cpfs* fs, std::wstring_view wfilepath, std::wstring_view stream,
+  PVOID *PFileContext, FSP_FSCTL_FILE_INFO *FileInfo)
+{
+  bool is_ascii = false;
+  std::string format = ws_to_ascii(stream, is_ascii);
+  if (!is_ascii)
+  {
+    return STATUS_OBJECT_NAME_NOT_FOUND;
+  }
+
+  std::transform(format.begin(), format.end(), format.begin(), [](char c) { return (char)std::tolower((uint8_t)c); });
+
+  const bool is_raw = format == "raw";
+  if (!is_raw && !fs->uncooked.has_converter(format))
+  {
+    return STATUS_OBJECT_NAME_NOT_FOUND;
+  }
+
+  bool tfs_compatible{};
+  cp::filesystem::path tfs_path(wfilepath, tfs_compatible);
+  if (!tfs_compatible)
+  {
+    return STATUS_OBJECT_NAME_NOT_FOUND;
+  }
+
+  auto fctx = std::make_unique<file_context>();
+  fctx->wrel_path = wfilepath.substr(1);
+  fctx->wrel_path.append(L":").append(stream);
+
+  fctx->dirent.assign(fs->tfs, tfs_path);
+  if (!fctx->dirent.is_file())
+  {
+    return STATUS_OBJECT_NAME_NOT_FOUND;
+  }
+
+  fctx->fhandle = fs->tfs.get_file_handle(fctx->dirent.pid());
+  if (!fctx->fhandle.is_valid())
+  {
+    return STATUS_OBJECT_NAME_NOT_FOUND;
+  }
+
+  fctx->is_tfs_file = true;
+  ::fill_fsp_info(fctx->tfs_finfo, fctx->dirent);
+
+  const auto& ar = fctx->fhandle.source_archive();
+  const uint32_t file_idx = fctx->fhandle.file_index();
+
+  if (is_raw)
+  {
+    const uint64_t disk_size = ar->get_file_info(file_idx).disk_size;
+    fctx->is_raw_stream = true;
+    fctx->tfs_finfo.FileSize = disk_size;
+    fctx->tfs_finfo.AllocationSize = (disk_size + 4095) / 4096 * 4096;
+  }
+  else
+  {
+    fctx->uncooked_data = fs->uncooked.get(*ar, file_idx, format);
+    if (!fctx->uncooked_data)
+    {
+      return STATUS_OBJECT_NAME_NOT_FOUND;
+    }
+  }
+
+  fs->stats.add_open(fctx->dirent.pid());
+
+  NTSTATUS Status = STATUS_SUCCESS;
+  if (FileInfo != nullptr)
+  {
+    Status = fctx->fill_fsp_info(*FileInfo);
+  }
+
+  *PFileContext = fctx.release();
+  return Status;
+}
+
 NTSTATUS Open(
   FSP_FILE_SYSTEM *FileSystem,
   PWSTR FileName, UINT32 CreateOptions, UINT32 GrantedAccess,
@@ -467,12 +659,35 @@ NTSTATUS Open(
   wprintf(L"Open %s CreateOptions:%X\n", FileName, CreateOptions);
 #endif
 
-  //TODO: create dirent for directories even if a diff one exists !
-
   cpfs* fs = fs_from_ffs(FileSystem);
+  cpfs_stats::op_timer timer(fs->stats, cpfs_stats::op::open);
 
   std::wstring_view wfilepath = FileName;
 
+  if (is_stats_stream_path(wfilepath))
+  {
+    file_context* fctx = new file_context();
+    fctx->wrel_path = wfilepath.substr(1);
+    fctx->is_stats_stream = true;
+    fctx->stats_text = fs->stats.report(*fs);
+    *PFileContext = fctx;
+
+    if (FileInfo != nullptr)
+    {
+      return fctx->fill_fsp_info(*FileInfo);
+    }
+    return STATUS_SUCCESS;
+  }
+
+  // streams of the diff dir's files are the ones on disk
+  std::wstring_view stream;
+  const std::wstring_view wbasepath = split_stream_name(wfilepath, stream);
+  diffdir_index::entry base_entry;
+  if (!stream.empty() && !(fs->has_diffdir && fs->diffdir.find(wbasepath, base_entry)))
+  {
+    return open_depot_stream(fs, wbasepath, stream, PFileContext, FileInfo);
+  }
+
   bool tfs_compatible{};
   cp::filesystem::path tfs_path(wfilepath, tfs_compatible);
 
@@ -482,9 +697,10 @@ NTSTATUS Open(
   fctx->wrel_path = wfilepath.substr(1);
   fctx->is_diff_only = !tfs_compatible;
 
-  if (fs->has_diffdir)
+  diffdir_index::entry diff_entry;
+  if (fs->has_diffdir && fs->diffdir.find(wfilepath, diff_entry))
   {
-    auto diff_path = fs->diffdir_path / wfilepath;
+    auto diff_path = fs->diffdir_path / wfilepath.substr(1);
 
     ULONG CreateFlags = FILE_FLAG_BACKUP_SEMANTICS;
 
@@ -503,6 +719,12 @@ NTSTATUS Open(
         diff_path.c_str(),
         GrantedAccess, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 0,
         OPEN_EXISTING, CreateFlags, 0));
+
+    // the depot's directory of the same path is listed with it
+    if (fctx->handle && diff_entry.is_directory() && tfs_compatible)
+    {
+      fctx->dirent.assign(fs->tfs, tfs_path);
+    }
   }
 
   if (fctx->handle)
@@ -516,8 +738,18 @@ NTSTATUS Open(
 
     if (fctx->dirent.is_file())
     {
-      fctx->afs.open(fs->tfs.get_file_handle(fctx->dirent.pid()));
-      assert(fctx->afs.is_open());
+      fctx->fhandle = fs->tfs.get_file_handle(fctx->dirent.pid());
+      assert(fctx->fhandle.is_valid());
+
+      // prefetch: the first segment is decompressed in background, in the
+      // segment cache, while the caller gets to its first read
+      const auto& ar = fctx->fhandle.source_archive();
+      const uint32_t seg_idx = ar->records()[fctx->fhandle.file_index()].segs_irange.beg();
+      if (ar->is_valid_segments_irange(ar->records()[fctx->fhandle.file_index()].segs_irange)
+        && ar->segments()[seg_idx].is_segment_compressed())
+      {
+        fs->io_pool.submit([ar, seg_idx]() { ar->read_segment_cached(seg_idx); });
+      }
     }
 
     if (!fctx->dirent.exists() || !(fctx->dirent.is_file() || fctx->dirent.is_directory()))
@@ -532,7 +764,10 @@ NTSTATUS Open(
     }
 
     fctx->is_tfs_file = true;
+    ::fill_fsp_info(fctx->tfs_finfo, fctx->dirent);
     *PFileContext = fctx;
+
+    fs->stats.add_open(fctx->dirent.pid());
   }
   else
   {
@@ -656,6 +891,183 @@ VOID Close(
   delete reinterpret_cast<file_context*>(FileContext);
 }
 
+// returns the status, sets bytes_transferred
+using read_fn_type = std::function<NTSTATUS(ULONG& bytes_transferred)>;
+
+// runs read_fn on the io pool and returns STATUS_PENDING, the request being
+// completed with FspFileSystemSendResponse once read_fn returns.
+// read_fn is run in place if the pool isn't running.
+static NTSTATUS read_async(cpfs* fs, FSP_FILE_SYSTEM* FileSystem, read_fn_type read_fn, PULONG PBytesTransferred)
+{
+  const UINT64 hint = FspFileSystemGetOperationContext()->Request->Hint;
+
+  auto task = [FileSystem, hint, read_fn]()
+  {
+    ULONG bytes_transferred = 0;
+    const NTSTATUS Status = read_fn(bytes_transferred);
+
+    FSP_FSCTL_TRANSACT_RSP Response{};
+    Response.Size = sizeof(Response);
+    Response.Kind = FspFsctlTransactReadKind;
+    Response.Hint = hint;
+    Response.IoStatus.Status = Status;
+    Response.IoStatus.Information = bytes_transferred;
+    FspFileSystemSendResponse(FileSystem, &Response);
+  };
+
+  if (fs->io_pool.submit(std::move(task)))
+  {
+    return STATUS_PENDING;
+  }
+
+  ULONG bytes_transferred = 0;
+  const NTSTATUS Status = read_fn(bytes_transferred);
+  if (PBytesTransferred)
+  {
+    *PBytesTransferred = bytes_transferred;
+  }
+  return Status;
+}
+
+// share of the disk size of a file for size bytes of its content
+static uint64_t estimate_disk_bytes(const std::shared_ptr<const cp::archive>& ar, uint32_t file_idx, uint64_t size)
+{
+  const auto finfo = ar->get_file_info(file_idx);
+  return finfo.size ? size * finfo.disk_size / finfo.size : 0;
+}
+
+// returns the block from the cache, or reads and caches it (nullptr on error)
+static cp::file_block_cache::buffer_type get_file_block(
+  cpfs* fs, const std::shared_ptr<const cp::archive>& ar, uint32_t file_idx,
+  uint64_t fsize, size_t block_size, uint32_t block_idx)
+{
+  auto& cache = fs->block_cache;
+  if (auto buf = cache.find(ar.get(), file_idx, block_idx))
+  {
+    return buf;
+  }
+
+  const uint64_t block_beg = uint64_t(block_idx) * block_size;
+  if (block_beg >= fsize)
+  {
+    return nullptr;
+  }
+
+  auto buf = std::make_shared<std::vector<char>>((size_t)std::min<uint64_t>(block_size, fsize - block_beg));
+  if (!ar->read_file_range(file_idx, block_beg, *buf))
+  {
+    return nullptr;
+  }
+
+  fs->stats.add_fetched(buf->size(), estimate_disk_bytes(ar, file_idx, buf->size()));
+
+  cp::file_block_cache::buffer_type ret = std::move(buf);
+  cache.insert(ar.get(), file_idx, block_idx, ret);
+  return ret;
+}
+
+// reads through the block cache if it is enabled
+static bool read_file_blocks(
+  cpfs* fs, const std::shared_ptr<const cp::archive>& ar, uint32_t file_idx,
+  uint64_t fsize, size_t block_size, uint64_t offset, std::span<char> dst)
+{
+  if (!fs->block_cache.is_enabled())
+  {
+    if (!ar->read_file_range(file_idx, offset, dst))
+    {
+      return false;
+    }
+
+    fs->stats.add_fetched(dst.size(), estimate_disk_bytes(ar, file_idx, dst.size()));
+    return true;
+  }
+
+  size_t dst_pos = 0;
+  while (dst_pos < dst.size())
+  {
+    const uint64_t pos = offset + dst_pos;
+    const uint32_t block_idx = (uint32_t)(pos / block_size);
+
+    auto buf = get_file_block(fs, ar, file_idx, fsize, block_size, block_idx);
+    if (!buf)
+    {
+      return false;
+    }
+
+    const size_t local_offset = (size_t)(pos - uint64_t(block_idx) * block_size);
+    const size_t cnt = std::min(buf->size() - local_offset, dst.size() - dst_pos);
+    std::memcpy(dst.data() + dst_pos, buf->data() + local_offset, cnt);
+    dst_pos += cnt;
+  }
+
+  return true;
+}
+
+// queues the readahead of the blocks following a sequential read
+static void queue_readahead(
+  cpfs* fs, file_context* fctx, uint64_t fsize, size_t block_size,
+  uint64_t offset, ULONG len)
+{
+  // sequential if it starts where the previous read of the handle ended
+  const bool sequential = fctx->next_read_offset.exchange(offset + len) == offset;
+  if (!sequential)
+  {
+    // a seek, the next sequential run starts its readahead from its own position
+    fctx->readahead_end = 0;
+    return;
+  }
+
+  if (!fs->readahead_blocks || !fs->block_cache.is_enabled())
+  {
+    return;
+  }
+
+  const uint64_t blocks_cnt = (fsize + block_size - 1) / block_size;
+  const uint64_t next_block = (offset + len - 1) / block_size + 1;
+  const uint32_t end_block = (uint32_t)std::min<uint64_t>(blocks_cnt, next_block + fs->readahead_blocks);
+
+  // claims [prev_end, end_block) so that concurrent reads don't queue blocks twice
+  uint32_t prev_end = fctx->readahead_end.load();
+  do
+  {
+    if (prev_end >= end_block)
+    {
+      return;
+    }
+  }
+  while (!fctx->readahead_end.compare_exchange_weak(prev_end, end_block));
+
+  const auto& ar = fctx->fhandle.source_archive();
+  const uint32_t file_idx = fctx->fhandle.file_index();
+
+  for (uint32_t block_idx = (uint32_t)std::max<uint64_t>(next_block, prev_end); block_idx < end_block; ++block_idx)
+  {
+    if (fs->block_cache.contains(ar.get(), file_idx, block_idx))
+    {
+      continue;
+    }
+
+    fs->io_pool.submit([fs, ar, file_idx, fsize, block_size, block_idx]() {
+      get_file_block(fs, ar, file_idx, fsize, block_size, block_idx);
+    });
+  }
+}
+
+// reads of the streams kept in memory (stats, uncooked files)
+static NTSTATUS read_memory_stream(std::span<const char> data, PVOID Buffer, UINT64 Offset, ULONG Length, PULONG PBytesTransferred)
+{
+  const ULONG len = Offset < data.size() ? (ULONG)std::min<uint64_t>(data.size() - Offset, Length) : 0;
+  if (Buffer && len)
+  {
+    std::memcpy(Buffer, data.data() + Offset, len);
+  }
+  if (PBytesTransferred)
+  {
+    *PBytesTransferred = len;
+  }
+  return STATUS_SUCCESS;
+}
+
 static NTSTATUS Read(
   FSP_FILE_SYSTEM* FileSystem,
   PVOID FileContext, PVOID Buffer, UINT64 Offset, ULONG Length,
@@ -669,65 +1081,141 @@ static NTSTATUS Read(
     return STATUS_INVALID_HANDLE;
   }
 
+  if (fctx->is_stats_stream)
+  {
+    return read_memory_stream(fctx->stats_text, Buffer, Offset, Length, PBytesTransferred);
+  }
+
+  if (fctx->uncooked_data)
+  {
+    return read_memory_stream(*fctx->uncooked_data, Buffer, Offset, Length, PBytesTransferred);
+  }
+
+  if (fctx->is_raw_stream)
+  {
+    const auto& fh = fctx->fhandle;
+    const uint64_t fsize = fctx->tfs_finfo.FileSize;
+    const ULONG len = Offset < fsize ? (ULONG)std::min<uint64_t>(fsize - Offset, Length) : 0;
+
+    if (!Buffer || !len)
+    {
+      if (PBytesTransferred)
+      {
+        *PBytesTransferred = len;
+      }
+      return STATUS_SUCCESS;
+    }
+
+    const auto start = cpfs_stats::clock::now();
+
+    // no block cache: it holds decoded blocks, and disk bytes need no decoding
+    return read_async(fs, FileSystem,
+      [fs, ar = fh.source_archive(), file_idx = fh.file_index(), pid = fctx->dirent.pid(), Buffer, Offset, len, start](ULONG& bytes_transferred) -> NTSTATUS
+      {
+        cp::scoped_trace_span span(cpfs_stats::trace_name(cpfs_stats::op::read));
+        span.set_bytes(len);
+        if (!ar->read_file_raw_range(file_idx, Offset, std::span<char>((char*)Buffer, len)))
+        {
+          SPDLOG_ERROR("couldn't read raw file {} of {}", file_idx, ar->path().string());
+          return STATUS_UNEXPECTED_IO_ERROR;
+        }
+        bytes_transferred = len;
+        fs->stats.add_fetched(len, len);
+        fs->stats.add_served(pid, len);
+        fs->stats.record(cpfs_stats::op::read, start);
+        return STATUS_SUCCESS;
+      },
+      PBytesTransferred);
+  }
+
   if (fctx->is_tfs_file)
   {
     if (fctx->dirent.is_file())
     {
-      auto& afs = fctx->afs;
-      if (!afs.is_open())
+      const auto& fh = fctx->fhandle;
+      if (!fh.is_valid())
       {
-        SPDLOG_ERROR("!fctx->afs.is_open()");
+        SPDLOG_ERROR("!fctx->fhandle.is_valid()");
         return STATUS_INVALID_HANDLE;
       }
 
-      if (!afs.size())
+      const uint64_t fsize = fctx->dirent.get_file_info().size;
+      if (!fsize)
       {
-        SPDLOG_ERROR("!fctx->afs.size()");
+        SPDLOG_ERROR("file size is 0");
         return STATUS_INVALID_HANDLE;
       }
 
       ULONG len = 0;
 
-      if (Offset < afs.size())
+      if (Offset < fsize)
       {
-        len = std::min(ULONG(afs.size() - Offset), Length);
+        len = (ULONG)std::min<uint64_t>(fsize - Offset, Length);
+      }
 
-        if (Buffer)
+      if (!Buffer || !len)
+      {
+        if (PBytesTransferred)
         {
-          std::scoped_lock<std::mutex> sl(fctx->m_afs_mtx);
-          afs.seek(Offset);
-          afs.read(std::span<char>((char*)Buffer, len));
+          *PBytesTransferred = len;
         }
+        return STATUS_SUCCESS;
       }
 
-      if (PBytesTransferred)
-      {
-        *PBytesTransferred = len;
-      }
+      const size_t block_size = fs->block_cache.block_size();
 
-      return STATUS_SUCCESS;
+      // the latency includes the wait in the io pool
+      const auto start = cpfs_stats::clock::now();
+
+      // the archive is kept alive by the task
+      const NTSTATUS Status = read_async(fs, FileSystem,
+        [fs, ar = fh.source_archive(), file_idx = fh.file_index(), pid = fctx->dirent.pid(), fsize, block_size, Buffer, Offset, len, start](ULONG& bytes_transferred) -> NTSTATUS
+        {
+          // the latency is recorded from the callback, the span only covers the task
+          cp::scoped_trace_span span(cpfs_stats::trace_name(cpfs_stats::op::read));
+          span.set_bytes(len);
+          if (!read_file_blocks(fs, ar, file_idx, fsize, block_size, Offset, std::span<char>((char*)Buffer, len)))
+          {
+            SPDLOG_ERROR("couldn't read file {} of {}", file_idx, ar->path().string());
+            return STATUS_UNEXPECTED_IO_ERROR;
+          }
+          bytes_transferred = len;
+          fs->stats.add_served(pid, len);
+          fs->stats.record(cpfs_stats::op::read, start);
+          return STATUS_SUCCESS;
+        },
+        PBytesTransferred);
+
+      // queued after the read so that it doesn't wait behind its readahead
+      queue_readahead(fs, fctx, fsize, block_size, Offset, len);
+
+      return Status;
     }
     
     return STATUS_INVALID_HANDLE;
   }
   else
   {
-    // TODO: ASYNC IO
+    const HANDLE Handle = fctx->handle.get();
 
-    OVERLAPPED Overlapped = { 0 };
+    return read_async(fs, FileSystem,
+      [Handle, Buffer, Offset, Length](ULONG& bytes_transferred) -> NTSTATUS
+      {
+        OVERLAPPED Overlapped = { 0 };
 
-    Overlapped.Offset = (DWORD)Offset;
-    Overlapped.OffsetHigh = (DWORD)(Offset >> 32);
+        Overlapped.Offset = (DWORD)Offset;
+        Overlapped.OffsetHigh = (DWORD)(Offset >> 32);
 
-    if (!ReadFile(fctx->handle.get(), Buffer, Length, PBytesTransferred, &Overlapped))
-    {
-      DWORD dwErr = GetLastError();
-      SPDLOG_ERROR("ReadFile: {}", cp::windowz::format_error(dwErr));
-      return FspNtStatusFromWin32(dwErr);
-    }
+        if (!ReadFile(Handle, Buffer, Length, &bytes_transferred, &Overlapped))
+        {
+          DWORD dwErr = GetLastError();
+          SPDLOG_ERROR("ReadFile: {}", cp::windowz::format_error(dwErr));
+          return FspNtStatusFromWin32(dwErr);
+        }
+        return STATUS_SUCCESS;
+      },
+      PBytesTransferred);
   }
-
-  return STATUS_SUCCESS;
 }
 
 static NTSTATUS Write(
@@ -822,6 +1310,8 @@ NTSTATUS GetFileInfo(
   PVOID FileContext,
   FSP_FSCTL_FILE_INFO* FileInfo)
 {
+  cpfs_stats::op_timer timer(fs_from_ffs(FileSystem)->stats, cpfs_stats::op::get_file_info);
+
   auto fctx = reinterpret_cast<file_context*>(FileContext);
   if (!fctx)
   {
@@ -1058,6 +1548,127 @@ NTSTATUS SetSecurity(
 
 #define FULLPATH_SIZE                   (MAX_PATH + FSP_FSCTL_TRANSACT_PATH_SIZEMAX / sizeof(WCHAR))
 
+// listing of a directory that has entries in the diff dir: its entries and
+// the depot's ones they don't override, in the directory buffer of the handle.
+// the buffer is built on fresh searches and handles the markers.
+NTSTATUS ReadMergedDirectory(
+  cpfs* fs, file_context* fctx, PWSTR Marker,
+  PVOID Buffer, ULONG Length, PULONG PBytesTransferred)
+{
+  NTSTATUS Status = STATUS_SUCCESS;
+
+  if (FspFileSystemAcquireDirectoryBuffer(&fctx->dir_buffer, Marker == NULL, &Status))
+  {
+    std::array<char, sizeof(FSP_FSCTL_DIR_INFO) + MAX_PATH * 2> dir_info_buf{};
+    auto dir_info = reinterpret_cast<FSP_FSCTL_DIR_INFO*>(dir_info_buf.data());
+
+    std::vector<diffdir_index::entry> diff_entries;
+    fs->diffdir.list(fctx->wrel_path, diff_entries);
+
+    std::unordered_set<std::wstring> overrides;
+    overrides.reserve(diff_entries.size());
+
+    for (const auto& e : diff_entries)
+    {
+      overrides.insert(diffdir_index::lower_key(e.name));
+
+      dir_info_buf.fill(0);
+      set_fsp_dir_info_wname(*dir_info, e.name);
+      dir_info->FileInfo = e.info;
+
+      if (!FspFileSystemFillDirectoryBuffer(&fctx->dir_buffer, dir_info, &Status))
+      {
+        break;
+      }
+    }
+
+    if (NT_SUCCESS(Status) && fctx->dirent.is_directory())
+    {
+      cp::filesystem::directory_entry iter_dirent = fctx->dirent;
+      iter_dirent.assign_first_child_with_prefix({});
+
+      std::wstring lname;
+      while (iter_dirent.exists())
+      {
+        const std::string_view name = iter_dirent.filename_strv();
+        lname.assign(name.begin(), name.end());
+        std::transform(lname.begin(), lname.end(), lname.begin(),
+          [](wchar_t c){ return static_cast<wchar_t>(std::towlower(c)); });
+
+        if (overrides.find(lname) == overrides.end())
+        {
+          dir_info_buf.fill(0);
+          set_fsp_dir_info_ascii_name(*dir_info, name);
+          fill_fsp_info(dir_info->FileInfo, iter_dirent);
+
+          if (!FspFileSystemFillDirectoryBuffer(&fctx->dir_buffer, dir_info, &Status))
+          {
+            break;
+          }
+        }
+
+        iter_dirent.assign_next_with_prefix({});
+      }
+    }
+
+    FspFileSystemReleaseDirectoryBuffer(&fctx->dir_buffer);
+  }
+
+  if (!NT_SUCCESS(Status))
+  {
+    return Status;
+  }
+
+  FspFileSystemReadDirectoryBuffer(&fctx->dir_buffer, Marker, Buffer, Length, PBytesTransferred);
+
+  return STATUS_SUCCESS;
+}
+
+// listing of a depot directory, children starting with prefix (lower case).
+// it is built once per search in the directory buffer of the handle, the
+// continuation calls are served from it (the marker is found by a binary
+// search of the sorted entries).
+NTSTATUS ReadBufferedDirectory(
+  file_context* fctx, const std::string& prefix, PWSTR Marker,
+  PVOID Buffer, ULONG Length, PULONG PBytesTransferred)
+{
+  NTSTATUS Status = STATUS_SUCCESS;
+
+  if (FspFileSystemAcquireDirectoryBuffer(&fctx->dir_buffer, Marker == NULL, &Status))
+  {
+    std::array<char, sizeof(FSP_FSCTL_DIR_INFO) + MAX_PATH * 2> dir_info_buf{};
+    auto dir_info = reinterpret_cast<FSP_FSCTL_DIR_INFO*>(dir_info_buf.data());
+
+    cp::filesystem::directory_entry iter_dirent = fctx->dirent;
+    iter_dirent.assign_first_child_with_prefix(prefix);
+
+    while (iter_dirent.exists())
+    {
+      dir_info_buf.fill(0);
+      set_fsp_dir_info_ascii_name(*dir_info, iter_dirent.filename_strv());
+      fill_fsp_info(dir_info->FileInfo, iter_dirent);
+
+      if (!FspFileSystemFillDirectoryBuffer(&fctx->dir_buffer, dir_info, &Status))
+      {
+        break;
+      }
+
+      iter_dirent.assign_next_with_prefix(prefix);
+    }
+
+    FspFileSystemReleaseDirectoryBuffer(&fctx->dir_buffer);
+  }
+
+  if (!NT_SUCCESS(Status))
+  {
+    return Status;
+  }
+
+  FspFileSystemReadDirectoryBuffer(&fctx->dir_buffer, Marker, Buffer, Length, PBytesTransferred);
+
+  return STATUS_SUCCESS;
+}
+
 // supports Pattern and Marker
 NTSTATUS ReadDirectory(
   FSP_FILE_SYSTEM* FileSystem, PVOID FileContext,
@@ -1068,6 +1679,8 @@ NTSTATUS ReadDirectory(
   //scope_timer stimr("ReadDirectory");
 
   cpfs* fs = fs_from_ffs(FileSystem);
+  cpfs_stats::op_timer timer(fs->stats, cpfs_stats::op::read_directory);
+
   auto fctx = reinterpret_cast<file_context*>(FileContext);
   if (!fctx)
   {
@@ -1075,12 +1688,24 @@ NTSTATUS ReadDirectory(
     return STATUS_INVALID_HANDLE;
   }
 
+  // a listing is counted once, on its first call
+  if (Marker == nullptr && fctx->dirent.is_directory())
+  {
+    fs->stats.add_listing(fctx->dirent.pid());
+  }
+
 #ifdef PRINT_CALL_ARGS
   printf("ReadDirectory(.., \"%S\", \"%S\", \"%S\", .., %d, ..)\n", fctx->wrel_path.c_str(), Pattern, Marker, Length);
 #endif
 
   const bool has_diffdir = fs->has_diffdir;
 
+  // the driver checks the pattern of the merged listing
+  if (has_diffdir && fs->diffdir.has_children(fctx->wrel_path))
+  {
+    return ReadMergedDirectory(fs, fctx, Marker, Buffer, Length, PBytesTransferred);
+  }
+
   const cp::filesystem::directory_entry& dirent = fctx->dirent;
 
   bool read_tfs = dirent.is_directory();
@@ -1097,6 +1722,9 @@ NTSTATUS ReadDirectory(
   bool use_marker_for_tfs = false;
   bool tfs_marker_is_pattern = false;
   std::string tfs_marker;
+  // set for "prefix*" patterns (lower case), only the children starting with it
+  // are listed, with a range scan of the sorted children if the tree is compact
+  std::string tfs_prefix;
 
   // note: the driver will do a pattern check itself too
   // can we do something fast enough that it is worth it.. ?
@@ -1133,7 +1761,25 @@ NTSTATUS ReadDirectory(
           }
 
           SPDLOG_WARN("Pattern equals Marker");
-          wprintf(L"Filename:%s Pattern:%s Marker:%s\n", fctx->wrel_path.c_str(), Pattern, Marker); 
+        }
+      }
+      else if (wpattern_view.size() > 1 && wpattern_view.back() == '*')
+      {
+        const std::wstring_view wprefix = wpattern_view.substr(0, wpattern_view.size() - 1);
+
+        const bool prefix_has_wildcards = std::find_if(
+          wprefix.begin(), wprefix.end(),
+          [](wchar_t pc){
+            return pc == '*' || pc == '?' || pc == '>' || pc == '<' || pc == '"';
+          }) != wprefix.end();
+
+        if (!prefix_has_wildcards)
+        {
+          bool converted{};
+          tfs_prefix = ws_to_ascii(wprefix, converted);
+          read_tfs = converted; // no tfs name can match a non-ascii prefix
+          std::transform(tfs_prefix.begin(), tfs_prefix.end(), tfs_prefix.begin(),
+            [](char c){ return static_cast<char>(std::tolower(c)); });
         }
       }
     }
@@ -1143,6 +1789,12 @@ NTSTATUS ReadDirectory(
     Pattern = (PWSTR)L"*";
   }
 
+  // listings (not single entry lookups) page in many calls
+  if (read_tfs && !single_entry)
+  {
+    return ReadBufferedDirectory(fctx, tfs_prefix, Marker, Buffer, Length, PBytesTransferred);
+  }
+
   std::array<char, sizeof(FSP_FSCTL_DIR_INFO) + MAX_PATH * 2> dir_info_buf{};
   auto dir_info = reinterpret_cast<FSP_FSCTL_DIR_INFO*>(dir_info_buf.data());
 
@@ -1390,13 +2042,13 @@ NTSTATUS ReadDirectory(
       if (!tfs_marker_is_pattern)
       {
         // when marker is given, caller expects next entry
-        iter_dirent.assign_next();
+        iter_dirent.assign_next_with_prefix(tfs_prefix);
       }
     }
     else
     {
       iter_dirent = dirent;
-      iter_dirent.assign_first_child();
+      iter_dirent.assign_first_child_with_prefix(tfs_prefix);
     }
 
     while (iter_dirent.exists())
@@ -1421,7 +2073,7 @@ NTSTATUS ReadDirectory(
         break;
       }
 
-      iter_dirent.assign_next();
+      iter_dirent.assign_next_with_prefix(tfs_prefix);
     }
   }
 
@@ -1572,11 +2224,13 @@ NTSTATUS ResolveReparsePoints(
   std::wstring_view wfilepath = FileName;
 
   bool tfs_compatible{};
-  cp::filesystem::path tfs_path(wfilepath, tfs_compatible);
+  bool tfs_by_pid{};
+  const cp::path_id tfs_pid = cp::filesystem::directory_entry::lookup_pid(wfilepath, tfs_by_pid, tfs_compatible);
 
-  if (tfs_compatible)
+  // only pidlinks are reparse points, others are answered without a directory_entry
+  if (tfs_compatible && tfs_by_pid && fs->tfs.has_entry(tfs_pid))
   {
-    cp::filesystem::directory_entry dirent(fs->tfs, tfs_path);
+    cp::filesystem::directory_entry dirent(fs->tfs, tfs_pid);
     if (dirent.is_pidlink())
     {
       if (!ResolveLastPathComponent)
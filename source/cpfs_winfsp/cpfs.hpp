@@ -1,9 +1,16 @@
 #pragma once
 #include <cpfs_winfsp/winfsp.hpp>
+#include <cpfs_winfsp/cpfs_stats.hpp>
+#include <cpfs_winfsp/diffdir_index.hpp>
+#include <cpfs_winfsp/uncook_cache.hpp>
 
+#include <algorithm>
 #include <filesystem>
+#include <vector>
 
 #include <cpinternals/common.hpp>
+#include <cpinternals/common/parallel.hpp>
+#include <cpinternals/archive/file_block_cache.hpp>
 #include <cpinternals/filesystem/archive.hpp>
 #include <cpinternals/filesystem/treefs.hpp>
 #include <cpinternals/oodle/oodle.hpp>
@@ -35,8 +42,13 @@ struct scope_timer
   std::string name;
 };
 
-// todo list:
-//  - named streams (:raw for raw access, otherwise try to uncook)
+// named streams of depot files:
+//  - file:raw is the file as stored in its archive (read_file_raw_range):
+//    segments as on disk, nothing is decompressed. for repackers.
+//  - file:<format> is the file converted to format, see uncook_cache.
+// the root has a :stats stream, see cpfs_stats.
+// they are opened by name but not listed (no GetStreamInfo): copies of the
+// mount's files would read them all.
 
 struct cpfs
 {
@@ -159,6 +171,8 @@ struct cpfs
   {
     scope_timer st("load_archive loop");
 
+    std::vector<std::filesystem::path> archive_paths;
+
     for (const auto& dirent: std::filesystem::directory_iterator(content_path))
     {
       auto fname = dirent.path().filename();
@@ -173,10 +187,29 @@ struct cpfs
           }
         }
     
-        tfs.load_archive(dirent.path().string());
+        archive_paths.emplace_back(dirent.path());
       }
     }
 
+    // the cache is only valid for the same load order
+    std::sort(archive_paths.begin(), archive_paths.end());
+
+    if (tfs.load_cache(cache_path, archive_paths, mapped_archives))
+    {
+      SPDLOG_INFO("tree loaded from {}", cache_path.string());
+      return true;
+    }
+
+    const bool all_loaded = tfs.load_archives(archive_paths, mapped_archives) == archive_paths.size();
+
+    // sorted contiguous listings for ReadDirectory, saved as is in the cache
+    tfs.compact();
+
+    if (all_loaded && !tfs.save_cache(cache_path))
+    {
+      SPDLOG_WARN("couldn't save {}", cache_path.string());
+    }
+
     return true;
   }
 
@@ -187,9 +220,20 @@ struct cpfs
       return false;
     }
 
+    if (has_diffdir && !diffdir.open(diffdir_path))
+    {
+      SPDLOG_ERROR("couldn't index the diff directory, it is disabled");
+      has_diffdir = false;
+    }
+
+    // reads are completed asynchronously from there
+    io_pool.start(io_workers_cnt);
+
     NTSTATUS Status = FspFileSystemStartDispatcher(m_fsp_fs, 0);
     if (!NT_SUCCESS(Status))
     {
+      io_pool.join();
+      diffdir.close();
       SPDLOG_ERROR("FspFileSystemStartDispatcher: error {:08X}", Status);
       return false;
     }
@@ -204,7 +248,12 @@ struct cpfs
     {
       assert(m_fsp_fs);
       FspFileSystemStopDispatcher(m_fsp_fs);
+      // pending reads send their response before the file system is deleted
+      io_pool.join();
+      diffdir.close();
       m_started = false;
+
+      SPDLOG_INFO("stats:\n{}", stats.report(*this));
     }
   }
 
@@ -220,13 +269,36 @@ struct cpfs
 
   bool has_diffdir = false;
   std::filesystem::path diffdir_path;
+  // answers the lookups of the diff directory, indexed on start
+  diffdir_index diffdir;
   std::wstring disk_letter;
   std::wstring volume_label;
 
   std::filesystem::path content_path;
+  std::filesystem::path cache_path = "./treefs.cache";
+  // archives are mapped in memory (see archive::load_mapped), reads (raw
+  // ones especially) copy from the mapped pages
+  bool mapped_archives = false;
+  // empty if no report is asked, see cp::filesystem::override_table
+  std::filesystem::path override_report_path;
   cp::filesystem::treefs tfs;
+
+  // blocks of archive files read through the mount, a budget of 0 disables it
+  cp::file_block_cache block_cache;
+  // blocks read ahead on handles that are read sequentially, 0 disables it
+  size_t readahead_blocks = 4;
+
+  // 0 means one per hardware thread
+  size_t io_workers_cnt = 0;
+  cp::task_pool io_pool;
   std::shared_mutex mtx;
 
+  // also readable from the mount, see cpfs_stats
+  cpfs_stats stats;
+
+  // converters of the file:<format> streams and their results
+  uncook_cache uncooked;
+
 private:
 
   bool m_started = false;
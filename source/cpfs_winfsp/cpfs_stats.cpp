@@ -0,0 +1,143 @@
+#include <cpfs_winfsp/cpfs_stats.hpp>
+#include <cpfs_winfsp/cpfs.hpp>
+
+#include <algorithm>
+
+#include <cpinternals/archive/segment_cache.hpp>
+
+namespace {
+
+constexpr std::string_view op_names[cpfs_stats::ops_cnt] = {
+  "open",
+  "read",
+  "read_directory",
+  "get_file_info",
+};
+
+constexpr const char* op_trace_names[cpfs_stats::ops_cnt] = {
+  "cpfs.open",
+  "cpfs.read",
+  "cpfs.read_directory",
+  "cpfs.get_file_info",
+};
+
+double ratio_of(uint64_t num, uint64_t den)
+{
+  return den ? double(num) / double(den) : 0.0;
+}
+
+} // namespace
+
+const char* cpfs_stats::trace_name(op o)
+{
+  return op_trace_names[static_cast<size_t>(o)];
+}
+
+void cpfs_stats::record(op o, clock::time_point start)
+{
+  const auto us = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start).count();
+  m_latencies[static_cast<size_t>(o)].record(static_cast<uint64_t>(us));
+}
+
+void cpfs_stats::add_served(cp::path_id pid, uint64_t bytes)
+{
+  m_bytes_served.fetch_add(bytes, std::memory_order_relaxed);
+
+  auto& sh = shard_of(pid);
+  std::lock_guard<std::mutex> lock(sh.mtx);
+  auto& ec = sh.entries[pid];
+  ++ec.reads;
+  ec.bytes += bytes;
+}
+
+void cpfs_stats::add_fetched(uint64_t bytes, uint64_t disk_bytes_estimate)
+{
+  m_blocks_fetched.fetch_add(1, std::memory_order_relaxed);
+  m_bytes_fetched.fetch_add(bytes, std::memory_order_relaxed);
+  m_disk_bytes_fetched.fetch_add(disk_bytes_estimate, std::memory_order_relaxed);
+}
+
+void cpfs_stats::add_open(cp::path_id pid)
+{
+  auto& sh = shard_of(pid);
+  std::lock_guard<std::mutex> lock(sh.mtx);
+  ++sh.entries[pid].opens;
+}
+
+void cpfs_stats::add_listing(cp::path_id pid)
+{
+  auto& sh = shard_of(pid);
+  std::lock_guard<std::mutex> lock(sh.mtx);
+  ++sh.entries[pid].listings;
+}
+
+std::string cpfs_stats::report(const cpfs& fs, size_t top_n) const
+{
+  std::string ret;
+  auto out = std::back_inserter(ret);
+
+  const auto uptime = std::chrono::duration_cast<std::chrono::seconds>(clock::now() - m_start).count();
+  fmt::format_to(out, "uptime: {}s\n\n", uptime);
+
+  fmt::format_to(out, "{:<16}{:>12}{:>12}{:>12}{:>12}{:>12}{:>12}\n",
+    "latency (us)", "calls", "avg", "p50", "p90", "p99", "max");
+  for (size_t i = 0; i < ops_cnt; ++i)
+  {
+    const auto h = m_latencies[i].snapshot();
+    fmt::format_to(out, "{:<16}{:>12}{:>12}{:>12}{:>12}{:>12}{:>12}\n",
+      op_names[i], h.count, h.count ? h.total / h.count : 0,
+      h.percentile(0.5), h.percentile(0.9), h.percentile(0.99), h.max);
+  }
+
+  const uint64_t served = m_bytes_served.load(std::memory_order_relaxed);
+  const uint64_t fetched = m_bytes_fetched.load(std::memory_order_relaxed);
+  const uint64_t disk_fetched = m_disk_bytes_fetched.load(std::memory_order_relaxed);
+
+  fmt::format_to(out, "\nbytes served: {}\n", served);
+  fmt::format_to(out, "bytes fetched from archives: {} in {} blocks (decompressed), ~{} on disk\n",
+    fetched, m_blocks_fetched.load(std::memory_order_relaxed), disk_fetched);
+  fmt::format_to(out, "fetched/served: {:.3f}\n", ratio_of(fetched, served));
+
+  const auto bc = fs.block_cache.get_stats();
+  fmt::format_to(out, "\nblock cache: {} blocks, {} bytes of {}, hit rate {:.3f} ({} hits, {} misses), {} evictions\n",
+    bc.entries_cnt, bc.bytes, fs.block_cache.budget(),
+    ratio_of(bc.hits, bc.hits + bc.misses), bc.hits, bc.misses, bc.evictions);
+
+  const auto& seg_cache = cp::segment_cache::get();
+  const auto sc = seg_cache.get_stats();
+  fmt::format_to(out, "segment cache: {} segments, {} bytes of {}, hit rate {:.3f} ({} hits, {} misses), {} evictions\n",
+    sc.entries_cnt, sc.bytes, seg_cache.budget(),
+    ratio_of(sc.hits, sc.hits + sc.misses), sc.hits, sc.misses, sc.evictions);
+
+  // rankings
+  std::vector<std::pair<cp::path_id, entry_counters>> entries;
+  for (const auto& sh : m_shards)
+  {
+    std::lock_guard<std::mutex> lock(sh.mtx);
+    entries.insert(entries.end(), sh.entries.begin(), sh.entries.end());
+  }
+
+  auto write_ranking = [&](std::string_view title, uint64_t entry_counters::* field)
+  {
+    const size_t cnt = std::min(top_n, entries.size());
+    std::partial_sort(entries.begin(), entries.begin() + cnt, entries.end(), [field](const auto& a, const auto& b) {
+      return a.second.*field > b.second.*field;
+    });
+
+    fmt::format_to(out, "\n{}:\n", title);
+    for (size_t i = 0; i < cnt && entries[i].second.*field; ++i)
+    {
+      const auto& [pid, ec] = entries[i];
+      const auto p = fs.tfs.get_path(pid);
+      fmt::format_to(out, "{:>14}  {}\n", ec.*field, p ? std::string(p->strv()) : fmt::format("{:016x}", pid.hash));
+    }
+  };
+
+  write_ranking("most read files (bytes)", &entry_counters::bytes);
+  write_ranking("most read files (reads)", &entry_counters::reads);
+  write_ranking("most opened entries", &entry_counters::opens);
+  write_ranking("most listed directories", &entry_counters::listings);
+
+  return ret;
+}
+
@@ -0,0 +1,111 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <cpinternals/common.hpp>
+#include <cpinternals/common/instrumentation.hpp>
+#include <cpinternals/common/latency_histogram.hpp>
+
+struct cpfs;
+
+// Counters of the mount, to tune the cache sizes for a workload:
+//  - latency histograms of the file system operations,
+//  - bytes served to callers, bytes fetched from the archives on block cache
+//    misses (decompressed) and their estimated size on disk,
+//  - the most opened, read and listed entries.
+// Lock-free except for the per-entry counters, which are spread over shards.
+// The report is served as the "stats" named stream of the root
+// (\\:stats on the mount) and logged on shutdown.
+struct cpfs_stats
+{
+  enum class op : uint32_t
+  {
+    open,
+    read,
+    read_directory,
+    get_file_info,
+    count_
+  };
+
+  static constexpr size_t ops_cnt = static_cast<size_t>(op::count_);
+
+  using clock = std::chrono::steady_clock;
+
+  // "cpfs.open"..., static strings for the trace events
+  static const char* trace_name(op o);
+
+  // records the latency of an operation on destruction, and its span when
+  // a trace is recorded
+  struct op_timer
+  {
+    op_timer(cpfs_stats& stats, op o)
+      : stats(stats), o(o), start(clock::now()), span(trace_name(o)) {}
+
+    ~op_timer()
+    {
+      stats.record(o, start);
+    }
+
+    cpfs_stats& stats;
+    op o;
+    clock::time_point start;
+    cp::scoped_trace_span span;
+  };
+
+  cpfs_stats() = default;
+  cpfs_stats(const cpfs_stats&) = delete;
+  cpfs_stats& operator=(const cpfs_stats&) = delete;
+
+  void record(op o, clock::time_point start);
+
+  // bytes returned to a reader of a depot file
+  void add_served(cp::path_id pid, uint64_t bytes);
+  // a block of a file was fetched from its archive (cache miss or readahead)
+  void add_fetched(uint64_t bytes, uint64_t disk_bytes_estimate);
+
+  void add_open(cp::path_id pid);
+  void add_listing(cp::path_id pid);
+
+  // text report, with the cache counters of fs and the top_n entries of
+  // each ranking
+  std::string report(const cpfs& fs, size_t top_n = 20) const;
+
+protected:
+  struct entry_counters
+  {
+    uint64_t opens = 0;
+    uint64_t reads = 0;
+    uint64_t bytes = 0;
+    uint64_t listings = 0;
+  };
+
+  static constexpr size_t shards_cnt = 16;
+
+  struct shard
+  {
+    mutable std::mutex mtx;
+    std::unordered_map<cp::path_id, entry_counters> entries;
+  };
+
+  shard& shard_of(cp::path_id pid)
+  {
+    return m_shards[static_cast<size_t>(pid.hash ^ (pid.hash >> 32)) & (shards_cnt - 1)];
+  }
+
+  // in microseconds
+  std::array<cp::atomic_latency_histogram, ops_cnt> m_latencies;
+
+  std::atomic<uint64_t> m_bytes_served = 0;
+  std::atomic<uint64_t> m_bytes_fetched = 0;
+  std::atomic<uint64_t> m_disk_bytes_fetched = 0;
+  std::atomic<uint64_t> m_blocks_fetched = 0;
+
+  std::array<shard, shards_cnt> m_shards;
+  clock::time_point m_start = clock::now();
+};
+
@@ -0,0 +1,410 @@
+#include <cpfs_winfsp/diffdir_index.hpp>
+
+#include <cwctype>
+#include <mutex>
+
+#include <cpinternals/os/platform_utils.hpp>
+
+namespace {
+
+// WIN32_FIND_DATAW and WIN32_FILE_ATTRIBUTE_DATA share these fields
+template <typename Win32Data>
+void fill_entry_info(FSP_FSCTL_FILE_INFO& fsp_finfo, const Win32Data& data)
+{
+  fsp_finfo = {};
+  fsp_finfo.FileAttributes  = data.dwFileAttributes;
+
+  fsp_finfo.FileSize        = (uint64_t(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+  fsp_finfo.AllocationSize  = (fsp_finfo.FileSize + 4095) / 4096 * 4096;
+
+  fsp_finfo.CreationTime    = filetime_to_fsp_time(data.ftCreationTime);
+  fsp_finfo.LastAccessTime  = filetime_to_fsp_time(data.ftLastAccessTime);
+  fsp_finfo.LastWriteTime   = filetime_to_fsp_time(data.ftLastWriteTime);
+  fsp_finfo.ChangeTime      = fsp_finfo.LastWriteTime;
+}
+
+std::wstring_view parent_key(std::wstring_view key)
+{
+  const size_t pos = key.rfind(L'\\');
+  return pos == std::wstring_view::npos ? std::wstring_view() : key.substr(0, pos);
+}
+
+std::wstring_view filename(std::wstring_view rel_path)
+{
+  const size_t pos = rel_path.find_last_of(L"\\/");
+  return pos == std::wstring_view::npos ? rel_path : rel_path.substr(pos + 1);
+}
+
+} // namespace
+
+std::wstring diffdir_index::lower_key(std::wstring_view rel_path)
+{
+  while (!rel_path.empty() && (rel_path.front() == L'\\' || rel_path.front() == L'/'))
+  {
+    rel_path.remove_prefix(1);
+  }
+
+  while (!rel_path.empty() && (rel_path.back() == L'\\' || rel_path.back() == L'/'))
+  {
+    rel_path.remove_suffix(1);
+  }
+
+  std::wstring ret(rel_path);
+  for (auto& c : ret)
+  {
+    c = (c == L'/') ? L'\\' : static_cast<wchar_t>(std::towlower(c));
+  }
+
+  return ret;
+}
+
+bool diffdir_index::open(const std::filesystem::path& dir)
+{
+  close();
+
+  m_root = dir;
+
+  m_dir_handle = CreateFileW(
+    dir.c_str(), FILE_LIST_DIRECTORY,
+    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+    OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+
+  if (m_dir_handle == INVALID_HANDLE_VALUE)
+  {
+    SPDLOG_ERROR("couldn't open diff directory {}: {}", dir.string(), cp::os::last_error_string());
+    return false;
+  }
+
+  m_stop_event = CreateEventW(NULL, TRUE, FALSE, NULL);
+  m_overlapped = {};
+  m_overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+  m_notify_buf.resize(64 * 1024 / sizeof(DWORD));
+
+  // the watch starts before the scan, changes made during the scan are
+  // notified afterwards
+  if (!m_stop_event || !m_overlapped.hEvent || !arm_watch())
+  {
+    SPDLOG_ERROR("couldn't watch diff directory {}: {}", dir.string(), cp::os::last_error_string());
+    close();
+    return false;
+  }
+
+  {
+    std::unique_lock<std::shared_mutex> lock(m_mtx);
+    rescan_locked();
+    SPDLOG_INFO("diff directory {}: {} entries", dir.string(), m_entries.size());
+  }
+
+  m_watcher = std::thread([this]() { watch_loop(); });
+  return true;
+}
+
+void diffdir_index::close()
+{
+  if (m_watcher.joinable())
+  {
+    SetEvent(m_stop_event);
+    m_watcher.join();
+  }
+  else if (m_dir_handle != INVALID_HANDLE_VALUE && m_overlapped.hEvent)
+  {
+    // armed by open but not waited on
+    DWORD bytes = 0;
+    CancelIoEx(m_dir_handle, &m_overlapped);
+    GetOverlappedResult(m_dir_handle, &m_overlapped, &bytes, TRUE);
+  }
+
+  if (m_dir_handle != INVALID_HANDLE_VALUE)
+  {
+    CloseHandle(m_dir_handle);
+    m_dir_handle = INVALID_HANDLE_VALUE;
+  }
+
+  if (m_overlapped.hEvent)
+  {
+    CloseHandle(m_overlapped.hEvent);
+    m_overlapped.hEvent = NULL;
+  }
+
+  if (m_stop_event)
+  {
+    CloseHandle(m_stop_event);
+    m_stop_event = NULL;
+  }
+
+  std::unique_lock<std::shared_mutex> lock(m_mtx);
+  m_entries.clear();
+  m_dirs.clear();
+}
+
+bool diffdir_index::find(std::wstring_view rel_path, entry& out) const
+{
+  const std::wstring key = lower_key(rel_path);
+
+  std::shared_lock<std::shared_mutex> lock(m_mtx);
+
+  auto it = m_entries.find(key);
+  if (it == m_entries.end())
+  {
+    return false;
+  }
+
+  out = it->second;
+  return true;
+}
+
+bool diffdir_index::list(std::wstring_view rel_dir, std::vector<entry>& out) const
+{
+  out.clear();
+
+  const std::wstring key = lower_key(rel_dir);
+
+  std::shared_lock<std::shared_mutex> lock(m_mtx);
+
+  auto it = m_dirs.find(key);
+  if (it == m_dirs.end())
+  {
+    return false;
+  }
+
+  out.reserve(it->second.size());
+  for (const auto& child_key : it->second)
+  {
+    out.push_back(m_entries.at(child_key));
+  }
+
+  return true;
+}
+
+bool diffdir_index::has_children(std::wstring_view rel_dir) const
+{
+  const std::wstring key = lower_key(rel_dir);
+
+  std::shared_lock<std::shared_mutex> lock(m_mtx);
+
+  auto it = m_dirs.find(key);
+  return it != m_dirs.end() && !it->second.empty();
+}
+
+size_t diffdir_index::size() const
+{
+  std::shared_lock<std::shared_mutex> lock(m_mtx);
+  return m_entries.size();
+}
+
+void diffdir_index::scan_dir_locked(const std::wstring& key, const std::filesystem::path& path)
+{
+  auto& children = m_dirs[key];
+
+  WIN32_FIND_DATAW fd;
+  HANDLE find_handle = FindFirstFileExW(
+    (path / L"*").c_str(), FindExInfoBasic, &fd,
+    FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+
+  if (find_handle == INVALID_HANDLE_VALUE)
+  {
+    return;
+  }
+
+  std::vector<std::pair<std::wstring, std::wstring>> subdirs;
+
+  do
+  {
+    const std::wstring_view name = fd.cFileName;
+    if (name == L"." || name == L"..")
+    {
+      continue;
+    }
+
+    std::wstring child_key = key.empty() ? lower_key(name) : key + L'\\' + lower_key(name);
+
+    entry& e = m_entries[child_key];
+    e.name = name;
+    fill_entry_info(e.info, fd);
+
+    if (e.is_directory())
+    {
+      subdirs.emplace_back(child_key, name);
+    }
+
+    children.insert(std::move(child_key));
+  }
+  while (FindNextFileW(find_handle, &fd));
+
+  FindClose(find_handle);
+
+  for (const auto& [child_key, name] : subdirs)
+  {
+    scan_dir_locked(child_key, path / name);
+  }
+}
+
+void diffdir_index::rescan_locked()
+{
+  m_entries.clear();
+  m_dirs.clear();
+  scan_dir_locked(std::wstring(), m_root);
+}
+
+void diffdir_index::update_locked(std::wstring_view rel_path)
+{
+  const std::wstring key = lower_key(rel_path);
+  if (key.empty())
+  {
+    return;
+  }
+
+  WIN32_FILE_ATTRIBUTE_DATA data;
+  if (!GetFileAttributesExW((m_root / rel_path).c_str(), GetFileExInfoStandard, &data))
+  {
+    // already gone, its removal is notified next
+    erase_locked(rel_path);
+    return;
+  }
+
+  const std::wstring parent(parent_key(key));
+  if (!parent.empty() && m_entries.find(parent) == m_entries.end())
+  {
+    update_locked(rel_path.substr(0, rel_path.find_last_of(L"\\/")));
+  }
+
+  entry& e = m_entries[key];
+  e.name = filename(rel_path);
+  fill_entry_info(e.info, data);
+  m_dirs[parent].insert(key);
+
+  if (e.is_directory())
+  {
+    // a directory moved in comes with its content
+    if (m_dirs.find(key) == m_dirs.end())
+    {
+      scan_dir_locked(key, m_root / rel_path);
+    }
+  }
+  else
+  {
+    erase_subtree_locked(key);
+  }
+}
+
+void diffdir_index::erase_locked(std::wstring_view rel_path)
+{
+  const std::wstring key = lower_key(rel_path);
+  if (key.empty())
+  {
+    return;
+  }
+
+  erase_subtree_locked(key);
+  m_entries.erase(key);
+
+  auto it = m_dirs.find(std::wstring(parent_key(key)));
+  if (it != m_dirs.end())
+  {
+    it->second.erase(key);
+  }
+}
+
+void diffdir_index::erase_subtree_locked(const std::wstring& key)
+{
+  auto it = m_dirs.find(key);
+  if (it == m_dirs.end())
+  {
+    return;
+  }
+
+  const std::set<std::wstring> children = std::move(it->second);
+  m_dirs.erase(it);
+
+  for (const auto& child_key : children)
+  {
+    erase_subtree_locked(child_key);
+    m_entries.erase(child_key);
+  }
+}
+
+bool diffdir_index::arm_watch()
+{
+  ResetEvent(m_overlapped.hEvent);
+
+  constexpr DWORD filter =
+    FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_ATTRIBUTES |
+    FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_CREATION;
+
+  return ReadDirectoryChangesW(
+    m_dir_handle, m_notify_buf.data(), static_cast<DWORD>(m_notify_buf.size() * sizeof(DWORD)),
+    TRUE, filter, NULL, &m_overlapped, NULL);
+}
+
+void diffdir_index::watch_loop()
+{
+  const HANDLE events[2] = {m_overlapped.hEvent, m_stop_event};
+
+  for (;;)
+  {
+    const DWORD wait = WaitForMultipleObjects(2, events, FALSE, INFINITE);
+
+    DWORD bytes = 0;
+    if (wait != WAIT_OBJECT_0)
+    {
+      CancelIoEx(m_dir_handle, &m_overlapped);
+      GetOverlappedResult(m_dir_handle, &m_overlapped, &bytes, TRUE);
+      return;
+    }
+
+    const bool completed = GetOverlappedResult(m_dir_handle, &m_overlapped, &bytes, FALSE);
+    const DWORD err = completed ? ERROR_SUCCESS : GetLastError();
+
+    {
+      std::unique_lock<std::shared_mutex> lock(m_mtx);
+
+      if (!completed || bytes == 0)
+      {
+        // the notifications overflowed the buffer
+        if (completed || err == ERROR_NOTIFY_ENUM_DIR)
+        {
+          SPDLOG_INFO("diff directory changes overflowed, rescanning it");
+          rescan_locked();
+        }
+        else
+        {
+          SPDLOG_ERROR("diff directory watch failed: {}", cp::os::format_error(err));
+          return;
+        }
+      }
+      else
+      {
+        const char* p = reinterpret_cast<const char*>(m_notify_buf.data());
+        for (;;)
+        {
+          auto info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(p);
+          const std::wstring_view rel_path(info->FileName, info->FileNameLength / sizeof(WCHAR));
+
+          switch (info->Action)
+          {
+            case FILE_ACTION_REMOVED:
+            case FILE_ACTION_RENAMED_OLD_NAME:
+              erase_locked(rel_path);
+              break;
+            default:
+              update_locked(rel_path);
+              break;
+          }
+
+          if (info->NextEntryOffset == 0)
+          {
+            break;
+          }
+          p += info->NextEntryOffset;
+        }
+      }
+    }
+
+    if (!arm_watch())
+    {
+      SPDLOG_ERROR("diff directory watch failed: {}", cp::os::last_error_string());
+      return;
+    }
+  }
+}
+
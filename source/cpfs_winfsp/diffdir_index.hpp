@@ -0,0 +1,94 @@
+#pragma once
+#include <cpfs_winfsp/winfsp.hpp>
+
+#include <filesystem>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// In-memory index of the diff directory, the overlay whose files override
+// (or add to) the depot's ones.
+// Lookups and listings of the mount don't touch the disk: resolving an
+// override is a hash probe and a directory's children are kept sorted.
+// A watcher thread keeps the index current with ReadDirectoryChangesW, the
+// directory is rescanned if the change notifications overflow.
+// Paths are relative to the diff directory ('\\' separators, the leading one
+// is optional) and matched case-insensitively, like the mount.
+struct diffdir_index
+{
+  struct entry
+  {
+    std::wstring name; // case-preserved filename
+    FSP_FSCTL_FILE_INFO info = {};
+
+    bool is_directory() const
+    {
+      return (info.FileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+    }
+  };
+
+  diffdir_index() = default;
+
+  ~diffdir_index()
+  {
+    close();
+  }
+
+  diffdir_index(const diffdir_index&) = delete;
+  diffdir_index& operator=(const diffdir_index&) = delete;
+
+  // scans the directory and starts watching it
+  bool open(const std::filesystem::path& dir);
+
+  void close();
+
+  bool is_open() const
+  {
+    return m_watcher.joinable();
+  }
+
+  // false if the path isn't in the overlay (the root isn't an entry)
+  bool find(std::wstring_view rel_path, entry& out) const;
+
+  // children of a directory, sorted by lower case name.
+  // false if the directory isn't in the overlay.
+  bool list(std::wstring_view rel_dir, std::vector<entry>& out) const;
+
+  bool has_children(std::wstring_view rel_dir) const;
+
+  size_t size() const;
+
+  // lower case path without leading and trailing separators, the key of
+  // the entries
+  static std::wstring lower_key(std::wstring_view rel_path);
+
+protected:
+  // the callers of the _locked methods hold m_mtx exclusively
+  void scan_dir_locked(const std::wstring& key, const std::filesystem::path& path);
+  void rescan_locked();
+  void update_locked(std::wstring_view rel_path);
+  void erase_locked(std::wstring_view rel_path);
+  void erase_subtree_locked(const std::wstring& key);
+
+  // issues the next ReadDirectoryChangesW
+  bool arm_watch();
+  void watch_loop();
+
+  std::filesystem::path m_root;
+
+  mutable std::shared_mutex m_mtx;
+  std::unordered_map<std::wstring, entry> m_entries;
+  // keys of the children of the directories, "" is the root
+  std::unordered_map<std::wstring, std::set<std::wstring>> m_dirs;
+
+  HANDLE m_dir_handle = INVALID_HANDLE_VALUE;
+  HANDLE m_stop_event = NULL;
+  OVERLAPPED m_overlapped = {};
+  std::vector<DWORD> m_notify_buf; // DWORD-aligned for FILE_NOTIFY_INFORMATION
+  std::thread m_watcher;
+};
+
@@ -17,6 +17,8 @@
 
 #include <cpfs_winfsp/resource.h>
 #include <cpfs_winfsp/cpfs.hpp>
+#include <cpinternals/filesystem/override_table.hpp>
+#include <cpinternals/common/trace_recorder.hpp>
 
 
 void debug_symlink(const std::filesystem::path& p);
@@ -76,6 +78,99 @@ void HideConsole()
   }
 }
 
+// options:
+//  --block-cache-mb <n>  budget of the block cache of archive files (0 disables it)
+//  --block-size-kb <n>   size of the cached blocks
+//  --readahead <n>       blocks read ahead on handles read sequentially (0 disables it)
+//  --io-workers <n>      threads completing reads (0 means one per hardware thread)
+//  --diffdir <path>      directory whose files override or add to the depot's ones
+//  --override-report <path>  writes the files contained by several archives once loaded
+//  --mapped              maps the archives in memory instead of reading them
+//  --uncook-cache <path> directory of the converted files (file:<format> streams)
+void ParseCommandLine(cpfs& fs)
+{
+  int argc = 0;
+  LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+  if (!argv)
+  {
+    return;
+  }
+
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::wstring_view arg = argv[i];
+
+    size_t value = 0;
+    auto read_value = [&]() -> bool
+    {
+      if (i + 1 >= argc)
+      {
+        return false;
+      }
+
+      const wchar_t* str = argv[i + 1];
+      wchar_t* end = nullptr;
+      const unsigned long long v = wcstoull(str, &end, 10);
+      if (end == str || *end != L'\0')
+      {
+        return false;
+      }
+
+      ++i;
+      value = static_cast<size_t>(v);
+      return true;
+    };
+
+    if (arg == L"--block-cache-mb" && read_value())
+    {
+      fs.block_cache.set_budget(value * 1024 * 1024);
+    }
+    else if (arg == L"--block-size-kb" && read_value() && value)
+    {
+      fs.block_cache.set_block_size(value * 1024);
+    }
+    else if (arg == L"--readahead" && read_value())
+    {
+      fs.readahead_blocks = value;
+    }
+    else if (arg == L"--io-workers" && read_value())
+    {
+      fs.io_workers_cnt = value;
+    }
+    else if (arg == L"--diffdir" && i + 1 < argc)
+    {
+      fs.has_diffdir = true;
+      fs.diffdir_path = argv[++i];
+    }
+    else if (arg == L"--override-report" && i + 1 < argc)
+    {
+      fs.override_report_path = argv[++i];
+    }
+    else if (arg == L"--mapped")
+    {
+      fs.mapped_archives = true;
+    }
+    else if (arg == L"--uncook-cache" && i + 1 < argc)
+    {
+      fs.uncooked.dir = argv[++i];
+    }
+    else if (arg == L"--trace" && i + 1 < argc)
+    {
+      cp::trace_recorder::get().start(argv[++i]);
+    }
+    else
+    {
+      SPDLOG_WARN("ignored command line argument: {}", std::filesystem::path(arg).string());
+    }
+  }
+
+  LocalFree(argv);
+
+  SPDLOG_INFO("block cache: {}MB, blocks of {}KB, readahead: {} blocks, io workers: {}",
+    fs.block_cache.budget() / (1024 * 1024), fs.block_cache.block_size() / 1024,
+    fs.readahead_blocks, fs.io_workers_cnt);
+}
+
 int wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine, int nShowCmd)
 {
   s_hInst = hInstance;
@@ -117,12 +212,26 @@ int wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine, int n
 
   cpfs cpfs;
 
+  ParseCommandLine(cpfs);
+  // no-op if --trace was passed
+  cp::trace_recorder::get().start_from_env();
+
   SPDLOG_INFO("initializing cpfs");
   cpfs.init(-1);
 
   SPDLOG_INFO("loading archives");
   cpfs.load_archives();
 
+  if (!cpfs.override_report_path.empty())
+  {
+    cp::filesystem::override_table overrides;
+    overrides.build(cpfs.tfs);
+    if (overrides.write_report(cpfs.override_report_path, cpfs.tfs))
+    {
+      SPDLOG_INFO("override report written to {}", cpfs.override_report_path.string());
+    }
+  }
+
   SPDLOG_INFO("starting cpfs");
   cpfs.start();
 
@@ -169,6 +278,8 @@ int wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine, int n
     }
   }
 
+  cp::trace_recorder::get().stop();
+
   
 
 
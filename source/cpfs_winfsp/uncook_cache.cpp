@@ -0,0 +1,160 @@
+#include <cpfs_winfsp/uncook_cache.hpp>
+
+#include <algorithm>
+
+#include <cpinternals/common/hashing.hpp>
+#include <cpinternals/os/file_reader.hpp>
+#include <cpinternals/os/file_writer.hpp>
+
+namespace {
+
+bool is_null_digest(const cp::sha1_digest& digest)
+{
+  return std::all_of(std::begin(digest.parts), std::end(digest.parts), [](uint32_t x) { return x == 0; });
+}
+
+std::string digest_hex(const cp::sha1_digest& digest)
+{
+  std::string ret;
+  ret.reserve(40);
+  for (uint8_t b : std::span(reinterpret_cast<const uint8_t*>(digest.parts), sizeof(digest.parts)))
+  {
+    fmt::format_to(std::back_inserter(ret), "{:02x}", b);
+  }
+  return ret;
+}
+
+} // namespace
+
+void uncook_cache::register_converter(std::string format, converter_fn fn)
+{
+  m_converters.insert_or_assign(std::move(format), std::move(fn));
+}
+
+uncook_cache::buffer_type uncook_cache::get(const cp::archive& ar, uint32_t file_idx, std::string_view format)
+{
+  auto cit = m_converters.find(format);
+  if (cit == m_converters.end())
+  {
+    return nullptr;
+  }
+
+  // archives without digests: the content is read to hash it
+  std::vector<char> src;
+  bool has_src = false;
+
+  cp::sha1_digest digest = ar.file_sha1(file_idx);
+  if (is_null_digest(digest))
+  {
+    src.resize(ar.get_file_info(file_idx).size);
+    if (!ar.read_file(file_idx, src))
+    {
+      SPDLOG_ERROR("couldn't read file {} of {}", file_idx, ar.path().string());
+      return nullptr;
+    }
+    digest = cp::sha1(src.data(), src.size());
+    has_src = true;
+  }
+
+  std::string key = digest_hex(digest);
+  key.append(".").append(format);
+
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (auto buf = m_loaded[key].lock())
+    {
+      return buf;
+    }
+  }
+
+  auto result = std::make_shared<std::vector<char>>();
+
+  const std::filesystem::path result_path = dir.empty() ? std::filesystem::path() : dir / key;
+  if (result_path.empty() || !load_result(result_path, *result))
+  {
+    if (!has_src)
+    {
+      src.resize(ar.get_file_info(file_idx).size);
+      if (!ar.read_file(file_idx, src))
+      {
+        SPDLOG_ERROR("couldn't read file {} of {}", file_idx, ar.path().string());
+        return nullptr;
+      }
+    }
+
+    if (!cit->second(ar, file_idx, src, *result))
+    {
+      SPDLOG_DEBUG("file {} of {} couldn't be converted to {}", file_idx, ar.path().string(), format);
+      return nullptr;
+    }
+
+    if (!result_path.empty())
+    {
+      store_result(result_path, *result);
+    }
+  }
+
+  buffer_type ret = std::move(result);
+
+  std::lock_guard<std::mutex> lock(m_mtx);
+  // a concurrent get may have stored it meanwhile
+  auto& entry = m_loaded[key];
+  if (auto buf = entry.lock())
+  {
+    return buf;
+  }
+  entry = ret;
+
+  // drops the expired entries now and then
+  if (m_loaded.size() > 1024)
+  {
+    std::erase_if(m_loaded, [](const auto& kv) { return kv.second.expired(); });
+  }
+
+  return ret;
+}
+
+bool uncook_cache::load_result(const std::filesystem::path& p, std::vector<char>& dst) const
+{
+  std::error_code ec;
+  if (!std::filesystem::is_regular_file(p, ec))
+  {
+    return false;
+  }
+
+  cp::os::file_reader reader;
+  if (!reader.open(p))
+  {
+    return false;
+  }
+
+  dst.resize(reader.size());
+  return reader.read_at(0, dst);
+}
+
+void uncook_cache::store_result(const std::filesystem::path& p, std::span<const char> data) const
+{
+  // written aside then renamed, a result is never seen partially written
+  std::filesystem::path tmp_path = p;
+  tmp_path += ".tmp";
+
+  std::error_code ec;
+  std::filesystem::create_directories(p.parent_path(), ec);
+
+  {
+    cp::os::file_writer writer;
+    if (!writer.open(tmp_path) || !writer.write_at(0, data) || !writer.close())
+    {
+      SPDLOG_WARN("couldn't write {}", tmp_path.string());
+      std::filesystem::remove(tmp_path, ec);
+      return;
+    }
+  }
+
+  std::filesystem::rename(tmp_path, p, ec);
+  if (ec)
+  {
+    SPDLOG_WARN("couldn't rename {}: {}", tmp_path.string(), ec.message());
+    std::filesystem::remove(tmp_path, ec);
+  }
+}
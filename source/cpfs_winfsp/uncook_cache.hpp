@@ -0,0 +1,63 @@
+#pragma once
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <cpinternals/common.hpp>
+#include <cpinternals/archive/archive.hpp>
+
+// Converted ("uncooked") versions of depot files, served as the named streams
+// file:<format> of the mount. A converter turns the content of a file into a
+// format, conversions being slow their results are kept in a directory,
+// named after the sha1 of the source file and the format (<sha1>.<format>):
+// they survive remounts and are shared by the identical files of several
+// archives. The results in use by open handles are also shared in memory.
+// Converters are registered before the mount starts, get() is thread-safe
+// (concurrent first conversions of a file may both run).
+struct uncook_cache
+{
+  using buffer_type = std::shared_ptr<const std::vector<char>>;
+
+  // returns false if the file can't be converted to the format
+  using converter_fn = std::function<bool(const cp::archive& ar, uint32_t file_idx, std::span<const char> src, std::vector<char>& dst)>;
+
+  // format is the stream name, lower case
+  void register_converter(std::string format, converter_fn fn);
+
+  bool has_converter(std::string_view format) const
+  {
+    return m_converters.find(format) != m_converters.end();
+  }
+
+  template <typename Fn>
+  void for_each_format(Fn&& fn) const
+  {
+    for (const auto& [format, converter] : m_converters)
+    {
+      fn(std::string_view(format));
+    }
+  }
+
+  // nullptr if there is no converter for the format or the conversion failed
+  buffer_type get(const cp::archive& ar, uint32_t file_idx, std::string_view format);
+
+  // results are only kept in memory if empty
+  std::filesystem::path dir = "./uncooked";
+
+protected:
+  bool load_result(const std::filesystem::path& p, std::vector<char>& dst) const;
+  void store_result(const std::filesystem::path& p, std::span<const char> data) const;
+
+  std::map<std::string, converter_fn, std::less<>> m_converters;
+
+  // key: <sha1>.<format>
+  std::mutex m_mtx;
+  std::unordered_map<std::string, std::weak_ptr<const std::vector<char>>> m_loaded;
+};
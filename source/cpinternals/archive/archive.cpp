@@ -1,8 +1,12 @@
 #include <cpinternals/archive/archive.hpp>
 
+#include <algorithm>
 #include <fstream>
 #include <set>
 
+#include <cpinternals/common/parallel.hpp>
+#include <cpinternals/common/alloc_profiler.hpp>
+#include <cpinternals/common/instrumentation.hpp>
 #include <cpinternals/os/file_reader.hpp>
 #include <cpinternals/io/stdstream_wrapper.hpp>
 #include <cpinternals/io/memory_istream.hpp>
@@ -11,9 +15,30 @@
 
 namespace cp {
 
-// check_for_corruption not implemented yet
+namespace {
+
+// staging buffer for compressed reads, reused by all reads of the thread.
+// it only grows, to the largest compressed segment of the archives it read.
+std::span<char> thread_scratch_buffer(size_t size)
+{
+  static thread_local std::unique_ptr<char[]> s_buf;
+  static thread_local size_t s_capacity = 0;
+
+  if (s_capacity < size)
+  {
+    s_buf.reset(new char[size]); // uninitialized
+    s_capacity = size;
+  }
+
+  return {s_buf.get(), size};
+}
+
+} // namespace
+
+// corruption checks are done on demand, see verify_archive
 std::shared_ptr<archive> archive::load(const std::filesystem::path& path)
 {
+  scoped_alloc_tag alloc_scope(alloc_tag::archive);
   os::file_reader freader;
 
   freader.open(path);
@@ -56,36 +81,230 @@ std::shared_ptr<archive> archive::load(const std::filesystem::path& path)
     return nullptr;
   }
 
-  memory_istream stmeta(metadata_block_span);
+  cp::radr::metadata md;
+  if (!parse_metadata(metadata_block_span, md))
+  {
+    return nullptr;
+  }
+
+  return std::make_shared<archive>(path, std::move(md), std::move(freader), create_tag{});
+}
+
+std::shared_ptr<archive> archive::load_mapped(const std::filesystem::path& path)
+{
+  scoped_alloc_tag alloc_scope(alloc_tag::archive);
+  os::file_mapping fmapping;
+
+  if (!fmapping.open(path))
+  {
+    SPDLOG_ERROR("couldn't map archive file at {}", path.string());
+    return nullptr;
+  }
+
+  const auto view = fmapping.view();
+
+  cp::radr::header hdr;
+  if (view.size() < sizeof(hdr))
+  {
+    SPDLOG_ERROR("archive file is too small");
+    return nullptr;
+  }
+
+  std::memcpy(&hdr, view.data(), sizeof(hdr));
+
+  if (!hdr.is_magic_ok())
+  {
+    SPDLOG_ERROR("archive file has wrong magic");
+    return nullptr;
+  }
+
+  if (hdr.metadata_offset + hdr.metadata_size > view.size())
+  {
+    SPDLOG_ERROR("archive metadata is out of bounds");
+    return nullptr;
+  }
 
+  // parsed in place, no intermediate buffer
   cp::radr::metadata md;
-  md.serialize(stmeta, true);
+  if (!parse_metadata(view.subspan(hdr.metadata_offset, hdr.metadata_size), md))
+  {
+    return nullptr;
+  }
 
-  if (stmeta.has_error())
+  return std::make_shared<archive>(path, std::move(md), std::move(fmapping), create_tag{});
+}
+
+std::shared_ptr<archive> archive::load_with_metadata(const std::filesystem::path& path, std::span<const char> metadata_block, bool mapped)
+{
+  scoped_alloc_tag alloc_scope(alloc_tag::archive);
+  cp::radr::metadata md;
+  if (!parse_metadata(metadata_block, md))
   {
-    SPDLOG_ERROR("stream error, {}", stmeta.error());
+    return nullptr;
+  }
+
+  if (mapped)
+  {
+    os::file_mapping fmapping;
+    if (!fmapping.open(path))
+    {
+      SPDLOG_ERROR("couldn't map archive file at {}", path.string());
+      return nullptr;
+    }
+
+    return std::make_shared<archive>(path, std::move(md), std::move(fmapping), create_tag{});
+  }
+
+  os::file_reader freader;
+  freader.open(path);
+  if (!freader.is_open())
+  {
+    SPDLOG_ERROR("archive file not found at {}", path.string());
     return nullptr;
   }
 
   return std::make_shared<archive>(path, std::move(md), std::move(freader), create_tag{});
 }
 
+bool archive::read_metadata_block(std::vector<char>& dst) const
+{
+  cp::radr::header hdr;
+  if (!read(0, std::span<char>((char*)&hdr, sizeof(hdr))) || !hdr.is_magic_ok())
+  {
+    SPDLOG_ERROR("couldn't read archive header");
+    return false;
+  }
+
+  dst.resize(hdr.metadata_size);
+  if (!read(hdr.metadata_offset, dst))
+  {
+    SPDLOG_ERROR("couldn't read archive metadata");
+    return false;
+  }
+
+  return true;
+}
+
 archive::archive(const std::filesystem::path& p, radr::metadata&& md, os::file_reader&& freader, create_tag&&)
   : m_path(p)
   , m_freader(std::move(freader))
+{
+  init(std::move(md));
+}
+
+archive::archive(const std::filesystem::path& p, radr::metadata&& md, os::file_mapping&& fmapping, create_tag&&)
+  : m_path(p)
+  , m_fmapping(std::move(fmapping))
+{
+  init(std::move(md));
+}
+
+archive::~archive()
+{
+  segment_cache::get().erase_archive(this);
+}
+
+bool archive::parse_metadata(std::span<const char> block, radr::metadata& md)
+{
+  memory_istream stmeta(block);
+
+  md.serialize(stmeta, true);
+
+  if (stmeta.has_error())
+  {
+    SPDLOG_ERROR("stream error, {}", stmeta.error());
+    return false;
+  }
+
+  return true;
+}
+
+void archive::init(radr::metadata&& md)
 {
   std::swap(m_dependencies, md.dependencies);
   std::swap(m_segments, md.segments);
 
   m_records.reserve(md.records.size());
+  m_sha1s.reserve(md.records.size());
   for (auto& record: md.records)
   {
     m_records.emplace_back(record);
+    m_sha1s.emplace_back(record.sha1);
+  }
+
+  for (const auto& sd : m_segments)
+  {
+    if (sd.is_segment_compressed())
+    {
+      m_max_compressed_disk_size = std::max<size_t>(m_max_compressed_disk_size, sd.disk_size);
+    }
+  }
+
+  // sizes table, walking segments is only done here
+  const size_t records_cnt = m_records.size();
+  m_file_sizes.assign(records_cnt, 0);
+  m_file_disk_sizes.assign(records_cnt, 0);
+
+  auto compute_sizes = [this](size_t i)
+  {
+    const auto& segs_irange = m_records[i].segs_irange;
+    if (!is_valid_segments_irange(segs_irange) || segs_irange.empty())
+    {
+      return;
+    }
+
+    auto segspan = segs_irange.slice(m_segments);
+    auto segit = segspan.begin();
+
+    // first segment uncompressed, next ones are raw
+    uint64_t size = segit->size;
+    uint64_t disk_size = segit->disk_size;
+
+    while (++segit != segspan.end())
+    {
+      size += segit->disk_size;
+      disk_size += segit->disk_size;
+    }
+
+    m_file_sizes[i] = (uint32_t)std::min<uint64_t>(size, UINT32_MAX);
+    m_file_disk_sizes[i] = (uint32_t)std::min<uint64_t>(disk_size, UINT32_MAX);
+  };
+
+  // big archives (~100k records) are worth splitting
+  constexpr size_t parallel_min_records = 0x10000;
+  if (records_cnt >= parallel_min_records)
+  {
+    constexpr size_t chunk_size = 0x4000;
+    const size_t chunks_cnt = (records_cnt + chunk_size - 1) / chunk_size;
+    parallel_for(chunks_cnt, 0, [&](size_t chunk)
+    {
+      const size_t end = std::min(records_cnt, (chunk + 1) * chunk_size);
+      for (size_t i = chunk * chunk_size; i < end; ++i)
+      {
+        compute_sizes(i);
+      }
+    });
+  }
+  else
+  {
+    for (size_t i = 0; i < records_cnt; ++i)
+    {
+      compute_sizes(i);
+    }
+  }
+
+  for (size_t i = 0; i < records_cnt; ++i)
+  {
+    m_total_size += m_file_sizes[i];
+    m_total_disk_size += m_file_disk_sizes[i];
   }
 }
 
 bool archive::read_file(uint32_t idx, const std::span<char>& dst) const
 {
+  scoped_alloc_tag alloc_scope(alloc_tag::archive);
+  scoped_trace_span span("archive.read_file");
+  span.set_bytes(dst.size());
   if (idx >= m_records.size())
   {
     SPDLOG_ERROR("idx out of range");
@@ -112,9 +331,19 @@ bool archive::read_file(uint32_t idx, const std::span<char>& dst) const
     return false;
   }
 
-  if (!read_segment(sd0, dst.subspan(0, std0_size), sd0.is_segment_compressed()))
+  if (sd0.is_segment_compressed())
+  {
+    auto buf = read_segment_cached(rec.segs_irange.beg());
+    if (!buf)
+    {
+      SPDLOG_ERROR("couldn't decompress first segment");
+      return false;
+    }
+    std::memcpy(dst.data(), buf->data(), std0_size);
+  }
+  else if (!read_segment(sd0, dst.subspan(0, std0_size), false))
   {
-    SPDLOG_ERROR("couldn't decompress first segment");
+    SPDLOG_ERROR("couldn't read first segment");
     return false;
   }
 
@@ -125,6 +354,128 @@ bool archive::read_file(uint32_t idx, const std::span<char>& dst) const
   return success;
 }
 
+bool archive::read_file_range(uint32_t idx, uint64_t offset, const std::span<char>& dst) const
+{
+  scoped_alloc_tag alloc_scope(alloc_tag::archive);
+  scoped_trace_span span("archive.read_file_range");
+  span.set_bytes(dst.size());
+  if (idx >= m_records.size())
+  {
+    SPDLOG_ERROR("idx out of range");
+    return false;
+  }
+
+  const auto& rec = m_records[idx];
+
+  if (!is_valid_segments_irange(rec.segs_irange) || rec.segs_irange.empty())
+  {
+    SPDLOG_ERROR("invalid segments range");
+    return false;
+  }
+
+  if (offset + dst.size() > m_file_sizes[idx])
+  {
+    SPDLOG_ERROR("range is out of file bounds");
+    return false;
+  }
+
+  // first segment decompressed, next ones are raw
+  auto segspan = rec.segs_irange.slice(m_segments);
+
+  uint64_t seg_beg = 0;
+  size_t dst_pos = 0;
+
+  for (size_t i = 0; i < segspan.size() && dst_pos < dst.size(); ++i)
+  {
+    const auto& sd = segspan[i];
+    const uint64_t seg_size = (i == 0) ? sd.size : sd.disk_size;
+    const uint64_t pos = offset + dst_pos;
+
+    if (pos < seg_beg + seg_size)
+    {
+      const size_t local_offset = (size_t)(pos - seg_beg);
+      const size_t cnt = std::min<size_t>((size_t)seg_size - local_offset, dst.size() - dst_pos);
+      const auto sub = dst.subspan(dst_pos, cnt);
+
+      if (i == 0 && sd.is_segment_compressed())
+      {
+        auto buf = read_segment_cached(rec.segs_irange.beg());
+        if (!buf)
+        {
+          SPDLOG_ERROR("couldn't decompress first segment");
+          return false;
+        }
+        std::memcpy(sub.data(), buf->data() + local_offset, cnt);
+      }
+      else if (!read(sd.offset_in_archive + local_offset, sub))
+      {
+        SPDLOG_ERROR("couldn't read segment");
+        return false;
+      }
+
+      dst_pos += cnt;
+    }
+
+    seg_beg += seg_size;
+  }
+
+  return dst_pos == dst.size();
+}
+
+bool archive::read_file_raw_range(uint32_t idx, uint64_t offset, const std::span<char>& dst) const
+{
+  scoped_trace_span span("archive.read_file_raw_range");
+  span.set_bytes(dst.size());
+  if (idx >= m_records.size())
+  {
+    SPDLOG_ERROR("idx out of range");
+    return false;
+  }
+
+  const auto& rec = m_records[idx];
+
+  if (!is_valid_segments_irange(rec.segs_irange))
+  {
+    SPDLOG_ERROR("invalid segments range");
+    return false;
+  }
+
+  if (offset + dst.size() > m_file_disk_sizes[idx])
+  {
+    SPDLOG_ERROR("range is out of file bounds");
+    return false;
+  }
+
+  auto segspan = rec.segs_irange.slice(m_segments);
+
+  uint64_t seg_beg = 0;
+  size_t dst_pos = 0;
+
+  for (size_t i = 0; i < segspan.size() && dst_pos < dst.size(); ++i)
+  {
+    const auto& sd = segspan[i];
+    const uint64_t pos = offset + dst_pos;
+
+    if (pos < seg_beg + sd.disk_size)
+    {
+      const size_t local_offset = (size_t)(pos - seg_beg);
+      const size_t cnt = std::min<size_t>((size_t)sd.disk_size - local_offset, dst.size() - dst_pos);
+
+      if (!read(sd.offset_in_archive + local_offset, dst.subspan(dst_pos, cnt)))
+      {
+        SPDLOG_ERROR("couldn't read segment");
+        return false;
+      }
+
+      dst_pos += cnt;
+    }
+
+    seg_beg += sd.disk_size;
+  }
+
+  return dst_pos == dst.size();
+}
+
 archive::file_info archive::get_file_info(uint32_t index) const
 {
   file_info ret;
@@ -135,23 +486,12 @@ archive::file_info archive::get_file_info(uint32_t index) const
     DEBUG_BREAK();
   }
 
-  const file_record rec = m_records[index];
+  const file_record& rec = m_records[index];
   
   ret.id = rec.fid;
   ret.time = rec.ftime;
-  
-  auto segspan = rec.segs_irange.slice(m_segments);
-  auto segit = segspan.begin();
-  
-  ret.size = segit->size;
-  ret.disk_size = segit->disk_size;
-
-  while (++segit != segspan.end())
-  {
-    const size_t disk_size = segit->disk_size;
-    ret.size += disk_size;
-    ret.disk_size += disk_size;
-  }
+  ret.size = m_file_sizes[index];
+  ret.disk_size = m_file_disk_sizes[index];
 
   return ret;
 }
@@ -177,10 +517,11 @@ bool archive::read_segments_raw(u32range segs_irange, const std::span<char>& dst
 
     while (seg_it != segspan.end())
     {
-      cp::radr::segment_descriptor seg = *seg_it++;
+      const cp::radr::segment_descriptor& seg = *seg_it;
       if (seg.offset_in_archive == bulk_sd.end_offset_in_archive())
       {
         bulk_sd.disk_size += seg.disk_size;
+        ++seg_it;
       }
       else
       {
@@ -212,8 +553,233 @@ bool archive::read_segments_raw(u32range segs_irange, const std::span<char>& dst
   return true;
 }
 
+bool archive::read_files_raw(std::span<const uint32_t> file_indices, std::vector<std::vector<char>>& dsts, size_t max_gap) const
+{
+  scoped_alloc_tag alloc_scope(alloc_tag::archive);
+  scoped_trace_span span("archive.read_files_raw");
+  struct piece
+  {
+    uint64_t offset_in_archive;
+    uint32_t disk_size;
+    uint32_t dst_idx;
+    size_t   dst_offset;
+  };
+
+  dsts.clear();
+  dsts.resize(file_indices.size());
+
+  std::vector<piece> pieces;
+
+  for (uint32_t i = 0; i < (uint32_t)file_indices.size(); ++i)
+  {
+    const uint32_t file_idx = file_indices[i];
+    if (file_idx >= m_records.size())
+    {
+      SPDLOG_ERROR("index out of range");
+      return false;
+    }
+
+    const auto& segs_irange = m_records[file_idx].segs_irange;
+    if (!is_valid_segments_irange(segs_irange))
+    {
+      SPDLOG_ERROR("invalid segs_irange");
+      return false;
+    }
+
+    size_t dst_offset = 0;
+    for (const auto& sd : segs_irange.slice(m_segments))
+    {
+      if (sd.disk_size)
+      {
+        pieces.push_back(piece{sd.offset_in_archive, sd.disk_size, i, dst_offset});
+      }
+      dst_offset += sd.disk_size;
+    }
+
+    dsts[i].resize(dst_offset);
+  }
+
+  std::sort(pieces.begin(), pieces.end(), [](const piece& a, const piece& b) {
+    return a.offset_in_archive < b.offset_in_archive;
+  });
+
+  if (is_mapped())
+  {
+    // no syscalls to save, pieces are copied straight from the mapping
+    for (const auto& pc : pieces)
+    {
+      if (!read(pc.offset_in_archive, std::span<char>(dsts[pc.dst_idx].data() + pc.dst_offset, pc.disk_size)))
+      {
+        SPDLOG_ERROR("segment is out of bounds");
+        return false;
+      }
+    }
+    return true;
+  }
+
+  if (!m_freader.is_open())
+  {
+    return false;
+  }
+
+  struct run
+  {
+    uint64_t offset_in_archive;
+    size_t   buf_offset;
+    size_t   size;
+    size_t   pieces_beg;
+    size_t   pieces_end;
+  };
+
+  // runs are read by batches so that the reader can have them in flight
+  // together (io_uring, overlapped reads), a batch is limited in count and
+  // in size to bound the buffer. the pieces of a run are scattered as soon
+  // as it completes, while the next runs are still being read.
+  std::vector<run> runs;
+  std::vector<char> runbuf;
+  std::vector<os::read_request> requests;
+
+  auto scatter_run = [&](size_t run_idx, bool ok)
+  {
+    if (!ok)
+    {
+      return;
+    }
+
+    const auto& r = runs[run_idx];
+    for (size_t piece_idx = r.pieces_beg; piece_idx != r.pieces_end; ++piece_idx)
+    {
+      const auto& pc = pieces[piece_idx];
+      std::memcpy(
+        dsts[pc.dst_idx].data() + pc.dst_offset,
+        runbuf.data() + r.buf_offset + (pc.offset_in_archive - r.offset_in_archive),
+        pc.disk_size);
+    }
+  };
+
+  auto flush_batch = [&]() -> bool
+  {
+    requests.clear();
+    for (const auto& r : runs)
+    {
+      requests.push_back({r.offset_in_archive, std::span<char>(runbuf.data() + r.buf_offset, r.size)});
+    }
+
+    if (!m_freader.read_batch(requests, scatter_run))
+    {
+      SPDLOG_ERROR("couldn't read segments");
+      return false;
+    }
+
+    runs.clear();
+    return true;
+  };
+
+  size_t batch_size = 0;
+
+  for (size_t i = 0; i < pieces.size(); /**/)
+  {
+    const uint64_t run_beg = pieces[i].offset_in_archive;
+    uint64_t run_end = run_beg + pieces[i].disk_size;
+
+    size_t run_last = i + 1;
+    for (; run_last != pieces.size(); ++run_last)
+    {
+      const uint64_t piece_end = pieces[run_last].offset_in_archive + pieces[run_last].disk_size;
+      if (pieces[run_last].offset_in_archive > run_end + max_gap)
+        break;
+      // a single piece can still be bigger than the limit
+      if (piece_end - run_beg > coalesce_max_read_size)
+        break;
+      run_end = std::max(run_end, piece_end);
+    }
+
+    const size_t run_size = static_cast<size_t>(run_end - run_beg);
+    if (!runs.empty() && (runs.size() == batch_max_runs || batch_size + run_size > batch_max_size))
+    {
+      if (!flush_batch())
+      {
+        return false;
+      }
+      batch_size = 0;
+    }
+
+    runs.push_back(run{run_beg, batch_size, run_size, i, run_last});
+    batch_size += run_size;
+    if (runbuf.size() < batch_size)
+    {
+      runbuf.resize(batch_size);
+    }
+
+    i = run_last;
+  }
+
+  return runs.empty() || flush_batch();
+}
+
+bool archive::decode_file_raw(uint32_t idx, std::span<const char> raw, std::vector<char>& dst) const
+{
+  if (idx >= m_records.size())
+  {
+    SPDLOG_ERROR("idx out of range");
+    return false;
+  }
+
+  const auto& rec = m_records[idx];
+  if (rec.segs_irange.empty() || !is_valid_segments_irange(rec.segs_irange))
+  {
+    SPDLOG_ERROR("invalid segs_irange");
+    return false;
+  }
+
+  const uint32_t seg0_idx = rec.segs_irange.beg();
+  const auto& sd0 = m_segments[seg0_idx];
+  if (raw.size() < sd0.disk_size)
+  {
+    SPDLOG_ERROR("raw underflow");
+    return false;
+  }
+
+  const auto rest = raw.subspan(sd0.disk_size);
+
+  if (!sd0.is_segment_compressed())
+  {
+    dst.assign(raw.begin(), raw.end());
+    return true;
+  }
+
+  auto& cache = segment_cache::get();
+  segment_cache::buffer_type buf = cache.find(this, seg0_idx);
+  if (!buf)
+  {
+    if (!oodle::is_available())
+    {
+      SPDLOG_ERROR("can't decompress, oodle is not available");
+      return false;
+    }
+
+    auto seg0 = std::make_shared<std::vector<char>>(sd0.size);
+    if (!oodle::decompress(raw.subspan(0, sd0.disk_size), *seg0, false))
+    {
+      SPDLOG_ERROR("failed to decompress segment");
+      return false;
+    }
+
+    buf = std::move(seg0);
+    cache.insert(this, seg0_idx, buf);
+  }
+
+  dst.resize(buf->size() + rest.size());
+  std::memcpy(dst.data(), buf->data(), buf->size());
+  std::memcpy(dst.data() + buf->size(), rest.data(), rest.size());
+  return true;
+}
+
 bool archive::read_segment(const cp::radr::segment_descriptor& sd, const std::span<char>& dst, bool decompress) const
 {
+  scoped_alloc_tag alloc_scope(alloc_tag::archive);
+  scoped_trace_span span("archive.read_segment");
+  span.set_bytes(dst.size());
   decompress = decompress && sd.is_segment_compressed();
 
   size_t expected_size = sd.disk_size;
@@ -235,13 +801,39 @@ bool archive::read_segment(const cp::radr::segment_descriptor& sd, const std::sp
     return false;
   }
 
+  if (is_mapped())
+  {
+    const auto src = segment_view(sd);
+    if (src.empty() && sd.disk_size)
+    {
+      SPDLOG_ERROR("segment is out of bounds");
+      return false;
+    }
+
+    if (decompress)
+    {
+      // straight from the mapped pages
+      if (!oodle::decompress(src, dst, false))
+      {
+        SPDLOG_ERROR("failed to decompress segment");
+        return false;
+      }
+    }
+    else
+    {
+      std::memcpy(dst.data(), src.data(), src.size());
+    }
+
+    return true;
+  }
+
   std::span<char> readbuf = dst;
 
-  std::unique_ptr<char[]> intermediate_buf{};
   if (decompress)
   {
-    intermediate_buf = std::make_unique<char[]>(sd.disk_size);
-    readbuf = std::span<char>{intermediate_buf.get(), sd.disk_size};
+    // sized once for the whole archive, no allocation per read
+    const size_t scratch_size = std::max<size_t>(sd.disk_size, m_max_compressed_disk_size);
+    readbuf = thread_scratch_buffer(scratch_size).subspan(0, sd.disk_size);
   }
 
   if (!read(sd.offset_in_archive, readbuf))
@@ -262,23 +854,99 @@ bool archive::read_segment(const cp::radr::segment_descriptor& sd, const std::sp
   return true;
 }
 
+segment_cache::buffer_type archive::read_segment_cached(uint32_t seg_idx) const
+{
+  if (seg_idx >= m_segments.size())
+  {
+    SPDLOG_ERROR("seg_idx out of range");
+    return nullptr;
+  }
+
+  const auto& sd = m_segments[seg_idx];
+  const bool compressed = sd.is_segment_compressed();
+
+  auto& cache = segment_cache::get();
+  if (compressed)
+  {
+    if (auto buf = cache.find(this, seg_idx))
+    {
+      return buf;
+    }
+  }
+
+  auto buf = std::make_shared<std::vector<char>>(sd.size);
+  if (!read_segment(sd, *buf, true))
+  {
+    return nullptr;
+  }
+
+  segment_cache::buffer_type ret = std::move(buf);
+  if (compressed)
+  {
+    cache.insert(this, seg_idx, ret);
+  }
+
+  return ret;
+}
+
+std::span<const char> archive::segment_view(const cp::radr::segment_descriptor& sd) const
+{
+  if (!is_mapped())
+  {
+    return {};
+  }
+
+  const auto view = m_fmapping.view();
+  if (sd.end_offset_in_archive() > view.size())
+  {
+    return {};
+  }
+
+  return view.subspan(sd.offset_in_archive, sd.disk_size);
+}
+
+std::span<const char> archive::segments_view(u32range segs_irange) const
+{
+  if (!is_mapped() || !is_valid_segments_irange(segs_irange) || segs_irange.empty())
+  {
+    return {};
+  }
+
+  auto segspan = segs_irange.slice(m_segments);
+
+  cp::radr::segment_descriptor bulk_sd = segspan.front();
+  for (auto seg_it = segspan.begin() + 1; seg_it != segspan.end(); ++seg_it)
+  {
+    if (seg_it->offset_in_archive != bulk_sd.end_offset_in_archive())
+    {
+      return {};
+    }
+    bulk_sd.disk_size += seg_it->disk_size;
+  }
+
+  return segment_view(bulk_sd);
+}
+
 bool archive::read(size_t offset, const std::span<char>& dst) const
 {
-  std::scoped_lock<std::mutex> lk(m_freader_mtx);
-  //
-  //m_ifs.seekg(offset);
-  //m_ifs.read(dst.data(), dst.size());
+  if (is_mapped())
+  {
+    const auto view = m_fmapping.view();
+    if (offset + dst.size() > view.size())
+    {
+      return false;
+    }
+
+    std::memcpy(dst.data(), view.data() + offset, dst.size());
+    return true;
+  }
 
   if (!m_freader.is_open())
   {
     return false;
   }
 
-  bool ok = true;
-  ok &= m_freader.seek(offset);
-  ok &= m_freader.read(dst);
-
-  return ok;
+  return m_freader.read_at(offset, dst);
 }
 
 } // namespace cp
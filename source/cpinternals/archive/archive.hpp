@@ -8,12 +8,12 @@
 
 #include <cpinternals/common.hpp>
 #include <cpinternals/archive/radr.hpp>
+#include <cpinternals/archive/segment_cache.hpp>
 #include <cpinternals/os/file_reader.hpp>
+#include <cpinternals/os/file_mapping.hpp>
 
 namespace cp {
 
-//#define CACHE_FILE_SIZE
-
 // read-only, standard thread-safety
 struct archive
   : public std::enable_shared_from_this<archive>
@@ -28,7 +28,7 @@ struct archive
     size_t      size      = 0; // file size (first segment uncompressed)
   };
   
-  // same as radr::file_record without sha1 member
+  // same as radr::file_record without sha1 member (see file_sha1)
   struct file_record
   {
     file_record() = default;
@@ -47,10 +47,6 @@ struct archive
     u32range    deps_irange;
     uint32_t    inl_buffer_segs_cnt = 0;
     uint32_t    unused[1];
-#ifdef CACHE_FILE_SIZE
-    size_t      disk_size = 0;
-    size_t      file_size = 0;
-#endif
   };
 
   // file readers (stream, w2rc, ..) know what to do with it
@@ -98,14 +94,31 @@ protected:
 public:
 
   archive(const std::filesystem::path& p, radr::metadata&& md, os::file_reader&& freader, create_tag&&);
+  archive(const std::filesystem::path& p, radr::metadata&& md, os::file_mapping&& fmapping, create_tag&&);
 
-  ~archive() = default;
+  ~archive();
 
   archive(const archive&) = delete;
   archive& operator=(const archive&) = delete;
 
   static std::shared_ptr<archive> load(const std::filesystem::path& path);
 
+  // same as load but the file is memory-mapped, segments can then be
+  // accessed in place (see segment_view) and reads are plain copies.
+  static std::shared_ptr<archive> load_mapped(const std::filesystem::path& path);
+
+  // same as load/load_mapped but the metadata block is given (e.g. from a
+  // cache, see treefs::load_cache), the archive file is only opened.
+  static std::shared_ptr<archive> load_with_metadata(const std::filesystem::path& path, std::span<const char> metadata_block, bool mapped = false);
+
+  // reads the metadata block as stored in the archive file
+  bool read_metadata_block(std::vector<char>& dst) const;
+
+  inline bool is_mapped() const
+  {
+    return m_fmapping.is_open();
+  }
+
   inline const std::filesystem::path& path() const
   {
     return m_path;
@@ -134,8 +147,31 @@ public:
 
   file_info get_file_info(uint32_t index) const;
 
+  // digest of the file as read by read_file, all zeroes if the archive
+  // doesn't have one for it (see verify_archive)
+  inline const sha1_digest& file_sha1(uint32_t index) const
+  {
+    return m_sha1s[index];
+  }
+
+  // sums over all files, computed once at load
+  inline uint64_t total_size() const
+  {
+    return m_total_size;
+  }
+
+  inline uint64_t total_disk_size() const
+  {
+    return m_total_disk_size;
+  }
+
   bool read_segment(const cp::radr::segment_descriptor& sd, const std::span<char>& dst, bool decompress) const;
 
+  // reads segment seg_idx decompressed, compressed segments go through
+  // segment_cache::get() so that repeated reads don't decompress again.
+  // returns nullptr on error.
+  segment_cache::buffer_type read_segment_cached(uint32_t seg_idx) const;
+
   inline bool is_valid_segments_irange(const u32range& segs_irange) const
   {
     return segs_irange.end() <= m_segments.size();
@@ -143,8 +179,49 @@ public:
 
   bool read_segments_raw(u32range segs_irange, const std::span<char>& dst) const;
 
+  // holes up to this size between segments are read through instead of
+  // starting a new read (see read_files_raw)
+  static constexpr size_t coalesce_max_gap = 64 * 1024;
+  // coalesced reads don't grow past this size
+  static constexpr size_t coalesce_max_read_size = 16 * 1024 * 1024;
+  // coalesced reads are submitted to the file reader by batches of at most
+  // this many reads and this many bytes
+  static constexpr size_t batch_max_runs = 32;
+  static constexpr size_t batch_max_size = 4 * coalesce_max_read_size;
+
+  // reads the disk bytes of several files at once (same layout as
+  // read_segments_raw), dsts[i] receives the bytes of file_indices[i].
+  // the segments of all files are sorted by offset in the archive and
+  // merged into a few large reads, then scattered to their buffers.
+  bool read_files_raw(std::span<const uint32_t> file_indices, std::vector<std::vector<char>>& dsts, size_t max_gap = coalesce_max_gap) const;
+
+  // file bytes (as read by read_file) from its disk bytes read by
+  // read_files_raw. the compressed first segment is decompressed and put in
+  // the segment cache, later reads of the file don't decompress it again.
+  bool decode_file_raw(uint32_t idx, std::span<const char> raw, std::vector<char>& dst) const;
+
+  // disk bytes of the segment in the mapping (compressed if is_segment_compressed),
+  // empty if the archive isn't mapped or the segment is out of bounds.
+  std::span<const char> segment_view(const cp::radr::segment_descriptor& sd) const;
+
+  // disk bytes of segments that are contiguous in the archive (e.g. all the
+  // segments of a file whose first segment isn't compressed), empty if they
+  // aren't contiguous or the archive isn't mapped.
+  std::span<const char> segments_view(u32range segs_irange) const;
+
   bool read_file(uint32_t idx, const std::span<char>& dst) const;
 
+  // reads dst.size() bytes of file idx starting at offset, without any
+  // per-reader state so concurrent reads of a file don't serialize.
+  // the compressed first segment goes through read_segment_cached.
+  bool read_file_range(uint32_t idx, uint64_t offset, const std::span<char>& dst) const;
+
+  // disk bytes of file idx in the layout of read_segments_raw (its segments
+  // one after the other, as stored: the first one compressed if it is),
+  // dst.size() bytes starting at offset. nothing is decompressed, copies
+  // are straight from the mapped pages if the archive is mapped.
+  bool read_file_raw_range(uint32_t idx, uint64_t offset, const std::span<char>& dst) const;
+
   const std::vector<file_record>& records() const
   {
     return m_records;
@@ -164,6 +241,9 @@ protected:
 
   archive() = default;
 
+  static bool parse_metadata(std::span<const char> block, radr::metadata& md);
+  void init(radr::metadata&& md);
+
   bool read(size_t offset, const std::span<char>& dst) const;
 
 private:
@@ -172,11 +252,21 @@ private:
   cp::radr::version                         m_ver;
 
   std::vector<file_record>                  m_records;
+  // by record, kept apart since only verification reads them
+  std::vector<sha1_digest>                  m_sha1s;
   std::vector<cp::radr::segment_descriptor> m_segments;
   std::vector<cp::radr::dependency>         m_dependencies;
-
-  mutable os::file_reader                   m_freader;
-  mutable std::mutex                        m_freader_mtx;
+  size_t                                    m_max_compressed_disk_size = 0;
+  uint64_t                                  m_total_size = 0;
+  uint64_t                                  m_total_disk_size = 0;
+  // per-record sizes computed at load (see file_info), 0 for invalid records
+  std::vector<uint32_t>                     m_file_sizes;
+  std::vector<uint32_t>                     m_file_disk_sizes;
+
+  // only used through read_at (positional reads), no locking needed
+  os::file_reader                           m_freader;
+  // used instead of m_freader if the archive has been loaded mapped
+  os::file_mapping                          m_fmapping;
 };
 
 } // namespace cp
@@ -0,0 +1,259 @@
+#include <cpinternals/archive/archive_extractor.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+#include <cpinternals/common/parallel.hpp>
+#include <cpinternals/common/instrumentation.hpp>
+#include <cpinternals/oodle/oodle.hpp>
+
+namespace cp {
+
+bool directory_extraction_sink::on_file(const archive& ar, uint32_t file_idx, std::span<const char> data)
+{
+  std::filesystem::path rel_path;
+  if (m_path_fn)
+  {
+    rel_path = m_path_fn(ar, file_idx);
+  }
+  else
+  {
+    rel_path = fmt::format("{:016x}.bin", ar.records()[file_idx].fid.hash);
+  }
+
+  const auto path = m_root_dir / rel_path;
+
+  std::error_code ec;
+  std::filesystem::create_directories(path.parent_path(), ec);
+
+  std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+  if (!ofs)
+  {
+    SPDLOG_ERROR("couldn't create {}", path.string());
+    return false;
+  }
+
+  ofs.write(data.data(), data.size());
+  return ofs.good();
+}
+
+namespace {
+
+struct extraction_job
+{
+  uint32_t file_idx = 0;
+  std::vector<char> raw; // disk bytes of all segments
+  size_t cost = 0;       // counted in inflight bytes
+};
+
+} // namespace
+
+archive_extraction_result extract_archive(const archive& ar, extraction_sink& sink, const archive_extraction_options& options)
+{
+  archive_extraction_result res;
+
+  const auto& records = ar.records();
+  const auto& segments = ar.segments();
+
+  // on-disk order
+  std::vector<uint32_t> order;
+  order.reserve(records.size());
+  for (uint32_t i = 0; i < (uint32_t)records.size(); ++i)
+  {
+    if (ar.is_valid_segments_irange(records[i].segs_irange) && !records[i].segs_irange.empty())
+      order.push_back(i);
+    else
+      ++res.failed_cnt;
+  }
+
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return segments[records[a].segs_irange.beg()].offset_in_archive
+      < segments[records[b].segs_irange.beg()].offset_in_archive;
+  });
+
+  res.files_cnt = records.size();
+
+  std::mutex mtx;
+  std::condition_variable cv_space;  // signaled when inflight bytes decrease
+  std::deque<extraction_job> jobs;
+  size_t inflight_bytes = 0;
+  size_t active_workers = 0;
+
+  std::atomic<size_t> failed_cnt = 0;
+  std::atomic<uint64_t> file_bytes = 0;
+
+  // tasks of the scheduler, started on demand up to workers_cnt and
+  // returning once there is no queued job (they never block)
+  auto worker = [&]()
+  {
+    std::vector<char> out;
+
+    while (true)
+    {
+      extraction_job job;
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (jobs.empty())
+        {
+          --active_workers;
+          return;
+        }
+        job = std::move(jobs.front());
+        jobs.pop_front();
+      }
+
+      scoped_trace_span span("archive.extract_file");
+      span.set_bytes(job.raw.size());
+
+      const auto& rec = records[job.file_idx];
+      const auto& sd0 = segments[rec.segs_irange.beg()];
+
+      bool ok = true;
+      std::span<const char> data = job.raw;
+
+      if (sd0.is_segment_compressed())
+      {
+        // first segment decompressed, remaining ones are raw
+        const size_t rem_size = job.raw.size() - sd0.disk_size;
+        out.resize(size_t(sd0.size) + rem_size);
+
+        ok = oodle::decompress(
+          std::span<const char>(job.raw.data(), sd0.disk_size),
+          std::span<char>(out.data(), sd0.size), false);
+
+        if (ok)
+        {
+          std::copy_n(job.raw.data() + sd0.disk_size, rem_size, out.data() + sd0.size);
+          data = out;
+        }
+        else
+        {
+          SPDLOG_ERROR("failed to decompress first segment of file {}", job.file_idx);
+        }
+      }
+
+      if (ok)
+      {
+        try
+        {
+          ok = sink.on_file(ar, job.file_idx, data);
+        }
+        catch (std::exception& e)
+        {
+          SPDLOG_ERROR("sink failed on file {}: {}", job.file_idx, e.what());
+          ok = false;
+        }
+      }
+
+      if (ok)
+        file_bytes += data.size();
+      else
+        ++failed_cnt;
+
+      // big outputs aren't kept across files
+      if (out.capacity() > 0x1000000)
+        out = std::vector<char>();
+
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        inflight_bytes -= job.cost;
+      }
+      cv_space.notify_one();
+    }
+  };
+
+  const size_t workers_cnt = resolve_workers_count(options.workers_cnt, order.size());
+  task_group workers;
+
+  const bool can_decompress = oodle::is_available();
+
+  for (uint32_t file_idx : order)
+  {
+    if (options.cancel && options.cancel->load(std::memory_order_relaxed))
+    {
+      res.cancelled = true;
+      break;
+    }
+
+    const auto& rec = records[file_idx];
+    const auto& sd0 = segments[rec.segs_irange.beg()];
+
+    if (sd0.is_segment_compressed() && !can_decompress)
+    {
+      SPDLOG_ERROR("can't decompress file {}, oodle is not available", file_idx);
+      ++failed_cnt;
+      continue;
+    }
+
+    const auto info = ar.get_file_info(file_idx);
+
+    extraction_job job;
+    job.file_idx = file_idx;
+    job.cost = info.disk_size + (sd0.is_segment_compressed() ? info.size : 0);
+
+    // backpressure, a job bigger than the limit is let through alone.
+    // workers that didn't start yet are run here, the others notify
+    // when they are done with a job.
+    auto has_space = [&]() {
+      return inflight_bytes == 0 || inflight_bytes + job.cost <= options.max_inflight_bytes;
+    };
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      while (!has_space())
+      {
+        lock.unlock();
+        const bool ran_worker = workers.try_run_one();
+        lock.lock();
+        if (!ran_worker)
+        {
+          cv_space.wait(lock, has_space);
+        }
+      }
+      inflight_bytes += job.cost;
+    }
+
+    job.raw.resize(info.disk_size);
+    if (!ar.read_segments_raw(rec.segs_irange, job.raw))
+    {
+      SPDLOG_ERROR("couldn't read segments of file {}", file_idx);
+      ++failed_cnt;
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        inflight_bytes -= job.cost;
+      }
+      continue;
+    }
+
+    res.disk_bytes += info.disk_size;
+
+    bool start_worker = false;
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      jobs.emplace_back(std::move(job));
+      if (active_workers < workers_cnt)
+      {
+        ++active_workers;
+        start_worker = true;
+      }
+    }
+
+    if (start_worker)
+    {
+      workers.run(worker);
+    }
+  }
+
+  // runs the workers that didn't start yet
+  workers.wait();
+
+  res.failed_cnt += failed_cnt;
+  res.file_bytes = file_bytes;
+  return res;
+}
+
+} // namespace cp
+
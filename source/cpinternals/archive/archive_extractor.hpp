@@ -0,0 +1,66 @@
+#pragma once
+#include <inttypes.h>
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <memory>
+
+#include <cpinternals/common.hpp>
+#include <cpinternals/archive/archive.hpp>
+
+namespace cp {
+
+// receives extracted files, called concurrently from the worker threads
+struct extraction_sink
+{
+  virtual ~extraction_sink() = default;
+
+  // data is only valid during the call, returning false counts the file as failed
+  virtual bool on_file(const archive& ar, uint32_t file_idx, std::span<const char> data) = 0;
+};
+
+// writes files into a directory, paths are given by path_fn
+// (default: <fid as hex>.bin, same naming as unresolved treefs entries)
+struct directory_extraction_sink
+  : extraction_sink
+{
+  using path_fn_type = std::function<std::filesystem::path(const archive& ar, uint32_t file_idx)>;
+
+  explicit directory_extraction_sink(std::filesystem::path root_dir, path_fn_type path_fn = {})
+    : m_root_dir(std::move(root_dir)), m_path_fn(std::move(path_fn)) {}
+
+  bool on_file(const archive& ar, uint32_t file_idx, std::span<const char> data) override;
+
+protected:
+  std::filesystem::path m_root_dir;
+  path_fn_type m_path_fn;
+};
+
+struct archive_extraction_options
+{
+  // max concurrent tasks decompressing and writing (on the task_scheduler),
+  // 0 means one per hardware thread
+  size_t workers_cnt = 0;
+  // max bytes read but not yet handed to the sink (read + output buffers),
+  // the reading thread waits when it is reached
+  size_t max_inflight_bytes = size_t(512) * 1024 * 1024;
+  // optional, checked between files
+  const std::atomic<bool>* cancel = nullptr;
+};
+
+struct archive_extraction_result
+{
+  size_t files_cnt = 0;
+  size_t failed_cnt = 0;
+  uint64_t disk_bytes = 0; // read from the archive
+  uint64_t file_bytes = 0; // given to the sink
+  bool cancelled = false;
+};
+
+// Extracts all files of an archive.
+// The calling thread reads the files' segments in on-disk order (sequential
+// i/o) and worker threads decompress them (oodle) and hand them to the sink.
+archive_extraction_result extract_archive(const archive& ar, extraction_sink& sink, const archive_extraction_options& options = {});
+
+} // namespace cp
+
@@ -0,0 +1,75 @@
+#include <cpinternals/archive/archive_verifier.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+namespace cp {
+
+namespace {
+
+struct sha1_verification_sink
+  : extraction_sink
+{
+  bool on_file(const archive& ar, uint32_t file_idx, std::span<const char> data) override
+  {
+    const sha1_digest& expected = ar.file_sha1(file_idx);
+
+    if (std::all_of(std::begin(expected.parts), std::end(expected.parts), [](uint32_t x) { return x == 0; }))
+    {
+      ++unchecked_cnt;
+      return true;
+    }
+
+    const sha1_digest digest = cp::sha1(data.data(), data.size());
+    if (std::equal(std::begin(digest.parts), std::end(digest.parts), std::begin(expected.parts)))
+    {
+      ++verified_cnt;
+      return true;
+    }
+
+    SPDLOG_ERROR("file {} ({:016x}) is corrupt, sha1 mismatch", file_idx, ar.records()[file_idx].fid.hash);
+
+    std::lock_guard<std::mutex> lock(mtx);
+    corrupt_indices.push_back(file_idx);
+    return true;
+  }
+
+  std::atomic<size_t> verified_cnt = 0;
+  std::atomic<size_t> unchecked_cnt = 0;
+  std::mutex mtx;
+  std::vector<uint32_t> corrupt_indices;
+};
+
+} // namespace
+
+archive_verification_result verify_archive(const archive& ar, const archive_extraction_options& options)
+{
+  const auto start = std::chrono::steady_clock::now();
+
+  sha1_verification_sink sink;
+  const auto xres = extract_archive(ar, sink, options);
+
+  archive_verification_result res;
+  res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  res.files_cnt = xres.files_cnt;
+  res.verified_cnt = sink.verified_cnt;
+  res.unchecked_cnt = sink.unchecked_cnt;
+  res.failed_cnt = xres.failed_cnt;
+  res.corrupt_indices = std::move(sink.corrupt_indices);
+  res.disk_bytes = xres.disk_bytes;
+  res.file_bytes = xres.file_bytes;
+  res.cancelled = xres.cancelled;
+
+  std::sort(res.corrupt_indices.begin(), res.corrupt_indices.end());
+
+  SPDLOG_INFO("verified {}: {} ok, {} corrupt, {} failed, {} without digest, {:.1f}MB in {:.3f}s ({:.1f}MB/s)",
+    ar.path().filename().string(), res.verified_cnt, res.corrupt_indices.size(), res.failed_cnt, res.unchecked_cnt,
+    res.file_bytes / 1e6, res.seconds, res.throughput() / 1e6);
+
+  return res;
+}
+
+} // namespace cp
+
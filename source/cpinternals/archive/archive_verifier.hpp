@@ -0,0 +1,41 @@
+#pragma once
+#include <inttypes.h>
+#include <vector>
+
+#include <cpinternals/common.hpp>
+#include <cpinternals/archive/archive.hpp>
+#include <cpinternals/archive/archive_extractor.hpp>
+
+namespace cp {
+
+struct archive_verification_result
+{
+  size_t files_cnt = 0;
+  size_t verified_cnt = 0;  // digest matched
+  size_t unchecked_cnt = 0; // no digest in the archive
+  size_t failed_cnt = 0;    // couldn't be read or decompressed
+  std::vector<uint32_t> corrupt_indices; // digest mismatch, sorted
+  uint64_t disk_bytes = 0;  // read from the archive
+  uint64_t file_bytes = 0;  // hashed
+  double seconds = 0;
+  bool cancelled = false;
+
+  bool ok() const
+  {
+    return corrupt_indices.empty() && failed_cnt == 0 && !cancelled;
+  }
+
+  // hashed bytes per second
+  double throughput() const
+  {
+    return seconds > 0 ? file_bytes / seconds : 0;
+  }
+};
+
+// Checks the sha1 of all files of an archive against the ones of its records.
+// Files are read and decompressed as by extract_archive (same options) and
+// hashed on its worker threads, corrupt ones are logged.
+archive_verification_result verify_archive(const archive& ar, const archive_extraction_options& options = {});
+
+} // namespace cp
+
@@ -0,0 +1,744 @@
+#include <cpinternals/archive/archive_writer.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <fstream>
+#include <future>
+#include <optional>
+#include <unordered_set>
+
+#include <cpinternals/common/instrumentation.hpp>
+#include <cpinternals/common/parallel.hpp>
+#include <cpinternals/filesystem/treefs.hpp>
+#include <cpinternals/io/file_ostream.hpp>
+
+namespace cp {
+
+namespace {
+
+constexpr uint64_t header_disk_size = 0x28;
+
+// packed on-disk layout (header_disk_size bytes), radr::header has padding
+void write_header(file_ostream& st, radr::header& hdr)
+{
+  st << hdr.magic;
+  st << hdr.ver.v1;
+  st << hdr.metadata_offset;
+  st << hdr.metadata_size;
+  st << hdr.uk_offset;
+  st << hdr.uk_size;
+  st << hdr.fullsize;
+}
+
+bool load_file(const std::filesystem::path& p, std::vector<char>& data)
+{
+  std::ifstream ifs(p, std::ios::binary);
+  if (!ifs)
+  {
+    return false;
+  }
+
+  ifs.seekg(0, std::ios::end);
+  data.resize((size_t)ifs.tellg());
+  ifs.seekg(0, std::ios::beg);
+  ifs.read(data.data(), data.size());
+
+  return ifs.good() || data.empty();
+}
+
+bool stat_file(const std::filesystem::path& p, size_t& size, file_time& ftime)
+{
+  std::error_code ec;
+  size = (size_t)std::filesystem::file_size(p, ec);
+  if (ec)
+  {
+    SPDLOG_ERROR("couldn't stat {}", p.string());
+    return false;
+  }
+
+  // msvc's file_clock counts 100ns ticks since the windows epoch, as file_time does
+  const auto wtime = std::filesystem::last_write_time(p, ec);
+  ftime = ec ? file_time() : file_time((uint64_t)wtime.time_since_epoch().count());
+
+  return true;
+}
+
+std::optional<uint64_t> parse_hash_filename(const std::filesystem::path& p)
+{
+  const std::string stem = p.stem().string();
+  if (stem.size() != 16)
+  {
+    return std::nullopt;
+  }
+
+  uint64_t hash = 0;
+  auto [ptr, ec] = std::from_chars(stem.data(), stem.data() + stem.size(), hash, 16);
+  if (ec != std::errc() || ptr != stem.data() + stem.size())
+  {
+    return std::nullopt;
+  }
+
+  return hash;
+}
+
+// a file loaded and ready to be written
+struct packed_file
+{
+  std::vector<char> data; // disk bytes
+  uint32_t          size = 0;
+  sha1_digest       sha1 = {};
+  bool              compressed = false;
+  bool              ok = false;
+};
+
+// loads and compresses a file, called from worker threads
+void pack_file(uint64_t hash, const archive_writer::loader_fn& loader, oodle::compression_level level, packed_file& pf)
+{
+  std::vector<char> data;
+  if (!loader || !loader(data))
+  {
+    SPDLOG_ERROR("couldn't load file {:016x}", hash);
+    return;
+  }
+
+  if (data.size() > UINT32_MAX)
+  {
+    SPDLOG_ERROR("file {:016x} is too big", hash);
+    return;
+  }
+
+  pf.size = (uint32_t)data.size();
+  pf.sha1 = cp::sha1(data.data(), data.size());
+
+  if (level != oodle::compression_level::none && data.size())
+  {
+    std::vector<char> cdata(oodle::compressed_size_bound(data.size()));
+    const size_t csize = oodle::compress(data, cdata, level);
+    if (csize && csize < data.size())
+    {
+      cdata.resize(csize);
+      pf.data = std::move(cdata);
+      pf.compressed = true;
+    }
+  }
+
+  if (!pf.compressed)
+  {
+    pf.data = std::move(data);
+  }
+
+  pf.ok = true;
+}
+
+// bytes of the source archive copied as is
+struct copy_run
+{
+  uint64_t src_offset = 0;
+  uint64_t dst_offset = 0;
+  uint64_t size = 0;
+};
+
+// writes the runs one after the other at the stream position, in chunks of
+// coalesce_max_read_size, the next chunk being read while one is written
+bool copy_runs(const archive& ar, std::span<const copy_run> runs, file_ostream& st)
+{
+  struct chunk
+  {
+    uint64_t offset;
+    uint32_t size;
+  };
+
+  std::vector<chunk> chunks;
+  for (const auto& run : runs)
+  {
+    for (uint64_t o = 0; o < run.size; o += archive::coalesce_max_read_size)
+    {
+      const uint64_t size = std::min<uint64_t>(archive::coalesce_max_read_size, run.size - o);
+      chunks.push_back(chunk{run.src_offset + o, (uint32_t)size});
+    }
+  }
+
+  auto read_chunk = [&ar](const chunk& c, std::vector<char>& buf) {
+    // read as an uncompressed segment
+    radr::segment_descriptor sd;
+    sd.offset_in_archive = c.offset;
+    sd.disk_size = c.size;
+    sd.size = c.size;
+    buf.resize(c.size);
+    return ar.read_segment(sd, buf, false);
+  };
+
+  // declared before next, whose destructor waits for the pending read
+  std::vector<char> bufs[2];
+  std::future<bool> next;
+
+  for (size_t i = 0; i < chunks.size(); ++i)
+  {
+    if (i == 0)
+    {
+      next = std::async(std::launch::async, read_chunk, std::cref(chunks[0]), std::ref(bufs[0]));
+    }
+
+    if (!next.get())
+    {
+      return false;
+    }
+
+    if (i + 1 < chunks.size())
+    {
+      next = std::async(std::launch::async, read_chunk, std::cref(chunks[i + 1]), std::ref(bufs[(i + 1) & 1]));
+    }
+
+    auto& buf = bufs[i & 1];
+    st.serialize_bytes(buf.data(), buf.size());
+    if (st.has_error())
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+} // namespace
+
+void archive_writer::add_file(radr::file_id fid, file_time ftime, size_t size_hint, loader_fn loader)
+{
+  m_entries[fid.hash] = entry{ftime, size_hint, std::move(loader)};
+}
+
+bool archive_writer::add_file(const path& depot_path, const std::filesystem::path& src)
+{
+  size_t size = 0;
+  file_time ftime;
+  if (!stat_file(src, size, ftime))
+  {
+    return false;
+  }
+
+  add_file(radr::file_id(depot_path), ftime, size,
+    [src](std::vector<char>& data) { return load_file(src, data); });
+
+  return true;
+}
+
+size_t archive_writer::add_directory(const std::filesystem::path& dir)
+{
+  size_t cnt = 0;
+
+  std::error_code ec;
+  for (auto it = std::filesystem::recursive_directory_iterator(dir, ec); it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+  {
+    if (ec)
+    {
+      SPDLOG_ERROR("couldn't iterate {}: {}", dir.string(), ec.message());
+      break;
+    }
+
+    if (!it->is_regular_file())
+    {
+      continue;
+    }
+
+    const auto& src = it->path();
+
+    if (auto hash = parse_hash_filename(src))
+    {
+      std::error_code sec;
+      const auto size = it->file_size(sec);
+      add_file(radr::file_id(*hash), file_time(), sec ? 0 : (size_t)size,
+        [src](std::vector<char>& data) { return load_file(src, data); });
+      ++cnt;
+      continue;
+    }
+
+    bool normalized = false;
+    path depot_path(std::filesystem::relative(src, dir).string(), normalized);
+    if (!normalized)
+    {
+      SPDLOG_WARN("skipping {}, not a valid depot path", src.string());
+      continue;
+    }
+
+    if (add_file(depot_path, src))
+    {
+      ++cnt;
+    }
+  }
+
+  return cnt;
+}
+
+size_t archive_writer::add_archive(const std::shared_ptr<const archive>& ar)
+{
+  if (!ar)
+  {
+    return 0;
+  }
+
+  const auto& records = ar->records();
+  for (uint32_t i = 0; i < (uint32_t)records.size(); ++i)
+  {
+    const auto info = ar->get_file_info(i);
+    add_file(info.id, info.time, info.size, [ar, i, size = info.size](std::vector<char>& data) {
+      data.resize(size);
+      return ar->read_file(i, data);
+    });
+  }
+
+  return records.size();
+}
+
+size_t archive_writer::add_treefs(const filesystem::treefs& tfs)
+{
+  size_t cnt = 0;
+  for (const auto& ar : tfs.archives())
+  {
+    cnt += add_archive(ar);
+  }
+  return cnt;
+}
+
+bool archive_writer::write(const std::filesystem::path& dst, const options& opts, result* res) const
+{
+  result r;
+
+  const bool compress = opts.level != oodle::compression_level::none;
+  if (compress && !oodle::is_available())
+  {
+    SPDLOG_ERROR("can't compress, oodle is not available");
+    return false;
+  }
+
+  file_ostream st(dst);
+  if (!st.good())
+  {
+    SPDLOG_ERROR("couldn't create {}", dst.string());
+    return false;
+  }
+
+  radr::header hdr;
+  hdr.ver = opts.ver;
+  write_header(st, hdr);
+
+  radr::metadata md;
+  md.records.reserve(m_entries.size());
+  md.segments.reserve(m_entries.size());
+
+  std::vector<std::map<uint64_t, entry>::const_iterator> batch;
+  std::vector<packed_file> packed;
+
+  auto it = m_entries.begin();
+  while (it != m_entries.end())
+  {
+    // next batch
+    batch.clear();
+    size_t batch_bytes = 0;
+    while (it != m_entries.end() && (batch.empty() || batch_bytes + it->second.size_hint <= opts.batch_size))
+    {
+      batch_bytes += it->second.size_hint;
+      batch.push_back(it++);
+    }
+
+    packed.clear();
+    packed.resize(batch.size());
+
+    parallel_for(batch.size(), opts.workers_cnt, [&](size_t i)
+    {
+      pack_file(batch[i]->first, batch[i]->second.loader, opts.level, packed[i]);
+    });
+
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+      auto& pf = packed[i];
+      if (!pf.ok)
+      {
+        return false;
+      }
+
+      const uint32_t seg_idx = (uint32_t)md.segments.size();
+
+      auto& sd = md.segments.emplace_back();
+      sd.offset_in_archive = (uint64_t)st.tell();
+      sd.disk_size = (uint32_t)pf.data.size();
+      sd.size = pf.size;
+
+      st.serialize_bytes(pf.data.data(), pf.data.size());
+
+      radr::file_record rec = {};
+      rec.fid = radr::file_id(batch[i]->first);
+      rec.ftime = batch[i]->second.ftime;
+      rec.inl_buffer_segs_cnt = 0;
+      rec.segs_irange = u32range(seg_idx, seg_idx + 1);
+      rec.deps_irange = u32range(0, 0);
+      rec.sha1 = pf.sha1;
+      md.records.push_back(rec);
+
+      ++r.files_cnt;
+      r.compressed_cnt += pf.compressed ? 1 : 0;
+      r.file_bytes += pf.size;
+      r.disk_bytes += pf.data.size();
+
+      pf.data = std::vector<char>();
+    }
+  }
+
+  hdr.metadata_offset = (uint64_t)st.tell();
+  md.serialize(st);
+  hdr.metadata_size = (uint32_t)((uint64_t)st.tell() - hdr.metadata_offset);
+  hdr.fullsize = (uint64_t)st.tell();
+
+  st.seek(0);
+  write_header(st, hdr);
+  st.close();
+
+  if (!st.good() || st.has_error())
+  {
+    SPDLOG_ERROR("couldn't write {}", dst.string());
+    return false;
+  }
+
+  if (res)
+  {
+    *res = r;
+  }
+
+  return true;
+}
+
+archive_repacker::archive_repacker(std::shared_ptr<const archive> src)
+  : m_src(std::move(src))
+{
+}
+
+void archive_repacker::replace_file(radr::file_id fid, file_time ftime, loader_fn loader)
+{
+  m_changes[fid.hash] = change{ftime, std::move(loader)};
+}
+
+bool archive_repacker::replace_file(const path& depot_path, const std::filesystem::path& src)
+{
+  size_t size = 0;
+  file_time ftime;
+  if (!stat_file(src, size, ftime))
+  {
+    return false;
+  }
+
+  replace_file(radr::file_id(depot_path), ftime,
+    [src](std::vector<char>& data) { return load_file(src, data); });
+
+  return true;
+}
+
+void archive_repacker::remove_file(radr::file_id fid)
+{
+  m_changes[fid.hash] = change{file_time(), nullptr};
+}
+
+bool archive_repacker::write(const std::filesystem::path& dst, const options& opts, result* res) const
+{
+  scoped_trace_span span("archive.repack");
+  result r;
+
+  if (!m_src)
+  {
+    SPDLOG_ERROR("no source archive");
+    return false;
+  }
+
+  std::error_code ec;
+  if (std::filesystem::equivalent(m_src->path(), dst, ec))
+  {
+    SPDLOG_ERROR("can't repack {} onto itself", dst.string());
+    return false;
+  }
+
+  if (opts.level != oodle::compression_level::none && !m_changes.empty() && !oodle::is_available())
+  {
+    SPDLOG_ERROR("can't compress, oodle is not available");
+    return false;
+  }
+
+  const auto& src_records = m_src->records();
+  const auto& src_segments = m_src->segments();
+
+  constexpr uint32_t no_idx = UINT32_MAX;
+
+  struct out_record
+  {
+    uint64_t hash;
+    uint32_t src_idx = no_idx; // kept or replaced
+    uint32_t packed_idx = no_idx; // replaced or added
+  };
+
+  std::vector<out_record> out;
+  out.reserve(src_records.size() + m_changes.size());
+  std::vector<std::map<uint64_t, change>::const_iterator> packed_changes;
+  std::unordered_set<uint64_t> src_hashes;
+
+  uint64_t kept_bytes = 0;
+  uint64_t dropped_bytes = 0;
+
+  for (uint32_t i = 0; i < (uint32_t)src_records.size(); ++i)
+  {
+    const auto& rec = src_records[i];
+    if (!m_src->is_valid_segments_irange(rec.segs_irange))
+    {
+      SPDLOG_ERROR("invalid segments range for file {:016x}", rec.fid.hash);
+      return false;
+    }
+
+    uint64_t disk_size = 0;
+    for (const auto& sd : rec.segs_irange.slice(src_segments))
+    {
+      disk_size += sd.disk_size;
+    }
+
+    src_hashes.insert(rec.fid.hash);
+
+    auto it = m_changes.find(rec.fid.hash);
+    if (it == m_changes.end())
+    {
+      out.push_back(out_record{rec.fid.hash, i});
+      kept_bytes += disk_size;
+      continue;
+    }
+
+    dropped_bytes += disk_size;
+
+    if (it->second.loader)
+    {
+      out.push_back(out_record{rec.fid.hash, i, (uint32_t)packed_changes.size()});
+      packed_changes.push_back(it);
+    }
+  }
+
+  for (auto it = m_changes.begin(); it != m_changes.end(); ++it)
+  {
+    if (it->second.loader && !src_hashes.contains(it->first))
+    {
+      out.push_back(out_record{it->first, no_idx, (uint32_t)packed_changes.size()});
+      packed_changes.push_back(it);
+    }
+  }
+
+  std::sort(out.begin(), out.end(), [](const out_record& a, const out_record& b) {
+    return a.hash < b.hash;
+  });
+
+  // new files first, nothing is written if one of them fails
+  std::vector<packed_file> packed(packed_changes.size());
+  parallel_for(packed.size(), opts.workers_cnt, [&](size_t i)
+  {
+    pack_file(packed_changes[i]->first, packed_changes[i]->second.loader, opts.level, packed[i]);
+  });
+
+  for (const auto& pf : packed)
+  {
+    if (!pf.ok)
+    {
+      return false;
+    }
+  }
+
+  // offsets of the kept segments in the output, new files go after them
+
+  std::vector<uint64_t> seg_offsets(src_segments.size());
+  std::vector<copy_run> runs;
+  uint64_t packed_offset = header_disk_size;
+
+  r.compacted = (double)dropped_bytes > opts.max_unused_ratio * (double)(kept_bytes + dropped_bytes);
+
+  if (!r.compacted)
+  {
+    // the old metadata gets overwritten
+    for (size_t i = 0; i < src_segments.size(); ++i)
+    {
+      seg_offsets[i] = src_segments[i].offset_in_archive;
+      packed_offset = std::max(packed_offset, src_segments[i].end_offset_in_archive());
+    }
+  }
+  else
+  {
+    std::vector<uint32_t> kept_segs;
+    for (const auto& o : out)
+    {
+      if (o.packed_idx != no_idx)
+      {
+        continue;
+      }
+
+      const auto& irange = src_records[o.src_idx].segs_irange;
+      for (uint32_t s = irange.beg(); s < irange.end(); ++s)
+      {
+        kept_segs.push_back(s);
+      }
+    }
+
+    std::sort(kept_segs.begin(), kept_segs.end(), [&](uint32_t a, uint32_t b) {
+      return src_segments[a].offset_in_archive < src_segments[b].offset_in_archive;
+    });
+
+    // holes up to coalesce_max_gap are copied along to keep runs long
+    for (uint32_t s : kept_segs)
+    {
+      const auto& sd = src_segments[s];
+      if (runs.empty() || sd.offset_in_archive > runs.back().src_offset + runs.back().size + archive::coalesce_max_gap)
+      {
+        const uint64_t dst_offset = runs.empty() ? header_disk_size : runs.back().dst_offset + runs.back().size;
+        runs.push_back(copy_run{sd.offset_in_archive, dst_offset, 0});
+      }
+
+      auto& run = runs.back();
+      run.size = std::max(run.size, sd.end_offset_in_archive() - run.src_offset);
+      seg_offsets[s] = run.dst_offset + (sd.offset_in_archive - run.src_offset);
+    }
+
+    if (!runs.empty())
+    {
+      packed_offset = runs.back().dst_offset + runs.back().size;
+    }
+  }
+
+  // metadata, records stay ordered by hash
+
+  radr::metadata md;
+  md.records.reserve(out.size());
+  md.dependencies = m_src->dependencies();
+
+  uint64_t offset = packed_offset;
+  for (const auto& o : out)
+  {
+    const uint32_t seg_idx = (uint32_t)md.segments.size();
+
+    radr::file_record rec = {};
+    rec.fid = radr::file_id(o.hash);
+
+    if (o.packed_idx == no_idx)
+    {
+      const auto& src_rec = src_records[o.src_idx];
+      for (uint32_t s = src_rec.segs_irange.beg(); s < src_rec.segs_irange.end(); ++s)
+      {
+        auto& sd = md.segments.emplace_back(src_segments[s]);
+        sd.offset_in_archive = seg_offsets[s];
+        r.kept_disk_bytes += sd.disk_size;
+      }
+
+      rec.ftime = src_rec.ftime;
+      rec.inl_buffer_segs_cnt = src_rec.inl_buffer_segs_cnt;
+      rec.segs_irange = u32range(seg_idx, (uint32_t)md.segments.size());
+      rec.deps_irange = src_rec.deps_irange;
+      rec.sha1 = m_src->file_sha1(o.src_idx);
+      ++r.kept_cnt;
+    }
+    else
+    {
+      const auto& pf = packed[o.packed_idx];
+
+      auto& sd = md.segments.emplace_back();
+      sd.offset_in_archive = offset;
+      sd.disk_size = (uint32_t)pf.data.size();
+      sd.size = pf.size;
+      offset += pf.data.size();
+
+      rec.ftime = packed_changes[o.packed_idx]->second.ftime;
+      rec.inl_buffer_segs_cnt = 0;
+      rec.segs_irange = u32range(seg_idx, seg_idx + 1);
+      // a replacement keeps the dependencies of the file it replaces
+      rec.deps_irange = o.src_idx != no_idx ? src_records[o.src_idx].deps_irange : u32range(0, 0);
+      rec.sha1 = pf.sha1;
+
+      ++r.packed_cnt;
+      r.compressed_cnt += pf.compressed ? 1 : 0;
+      r.packed_disk_bytes += pf.data.size();
+    }
+
+    md.records.push_back(rec);
+  }
+
+  r.files_cnt = md.records.size();
+  r.unused_bytes = packed_offset - header_disk_size - std::min(packed_offset - header_disk_size, r.kept_disk_bytes);
+
+  // output
+
+  file_ostream st;
+  if (!r.compacted)
+  {
+    std::filesystem::copy_file(m_src->path(), dst, std::filesystem::copy_options::overwrite_existing, ec);
+    if (ec)
+    {
+      SPDLOG_ERROR("couldn't copy {} to {}: {}", m_src->path().string(), dst.string(), ec.message());
+      return false;
+    }
+
+    st.open(dst, false);
+  }
+  else
+  {
+    st.open(dst);
+  }
+
+  if (!st.good())
+  {
+    SPDLOG_ERROR("couldn't open {}", dst.string());
+    return false;
+  }
+
+  radr::header hdr;
+  hdr.ver = m_src->ver();
+  write_header(st, hdr);
+
+  if (!copy_runs(*m_src, runs, st))
+  {
+    SPDLOG_ERROR("couldn't copy segments of {}", m_src->path().string());
+    return false;
+  }
+
+  st.seek(packed_offset);
+  for (const auto& o : out)
+  {
+    if (o.packed_idx != no_idx)
+    {
+      auto& pf = packed[o.packed_idx];
+      st.serialize_bytes(pf.data.data(), pf.data.size());
+    }
+  }
+
+  hdr.metadata_offset = (uint64_t)st.tell();
+  md.serialize(st);
+  hdr.metadata_size = (uint32_t)((uint64_t)st.tell() - hdr.metadata_offset);
+  hdr.fullsize = (uint64_t)st.tell();
+
+  st.seek(0);
+  write_header(st, hdr);
+  st.close();
+
+  if (!st.good() || st.has_error())
+  {
+    SPDLOG_ERROR("couldn't write {}", dst.string());
+    return false;
+  }
+
+  // a patched copy can be longer than what was written
+  if (!r.compacted)
+  {
+    std::filesystem::resize_file(dst, hdr.fullsize, ec);
+    if (ec)
+    {
+      SPDLOG_ERROR("couldn't truncate {}: {}", dst.string(), ec.message());
+      return false;
+    }
+  }
+
+  if (res)
+  {
+    *res = r;
+  }
+
+  return true;
+}
+
+} // namespace cp
+
@@ -0,0 +1,159 @@
+#pragma once
+#include <inttypes.h>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <cpinternals/common.hpp>
+#include <cpinternals/archive/radr.hpp>
+#include <cpinternals/archive/archive.hpp>
+#include <cpinternals/oodle/oodle.hpp>
+
+namespace cp::filesystem {
+struct treefs;
+} // namespace cp::filesystem
+
+namespace cp {
+
+// Builds RADR archives (header, segments, metadata).
+// Files are added from loaders, directories, archives or a treefs; a file
+// added with the id of a previously added one overrides it (same as the
+// treefs overlay order).
+// write() loads and compresses files in batches over worker threads, then
+// writes them sequentially. Each file is stored as a single segment, kept
+// uncompressed if compression doesn't make it smaller.
+struct archive_writer
+{
+  // fills data with the file content, called from worker threads
+  using loader_fn = std::function<bool(std::vector<char>& data)>;
+
+  struct options
+  {
+    // none stores all files uncompressed
+    oodle::compression_level level = oodle::compression_level::normal;
+    // 0 means one per hardware thread
+    size_t workers_cnt = 0;
+    // files are loaded and compressed in batches of about this many bytes
+    size_t batch_size = size_t(256) * 1024 * 1024;
+    radr::version ver{12};
+  };
+
+  struct result
+  {
+    size_t   files_cnt = 0;
+    size_t   compressed_cnt = 0;
+    uint64_t file_bytes = 0;
+    uint64_t disk_bytes = 0;
+  };
+
+  archive_writer() = default;
+
+  archive_writer(const archive_writer&) = delete;
+  archive_writer& operator=(const archive_writer&) = delete;
+
+  size_t size() const
+  {
+    return m_entries.size();
+  }
+
+  // size_hint is only used to balance batches
+  void add_file(radr::file_id fid, file_time ftime, size_t size_hint, loader_fn loader);
+
+  bool add_file(const path& depot_path, const std::filesystem::path& src);
+
+  // adds the regular files under dir, their depot path being relative to dir.
+  // names made of a 16-digit hex path hash (with or without extension, see
+  // directory_extraction_sink) are added with that hash as file id.
+  // returns the number of added files.
+  size_t add_directory(const std::filesystem::path& dir);
+
+  // adds all files of an archive, which is kept alive until write() returns
+  size_t add_archive(const std::shared_ptr<const archive>& ar);
+
+  // adds the files of all archives of the tree in load order
+  size_t add_treefs(const filesystem::treefs& tfs);
+
+  bool write(const std::filesystem::path& dst, const options& opts = {}, result* res = nullptr) const;
+
+protected:
+  struct entry
+  {
+    file_time ftime;
+    size_t    size_hint = 0;
+    loader_fn loader;
+  };
+
+  // ordered by hash, as records are in archives
+  std::map<uint64_t, entry> m_entries;
+};
+
+// Rewrites an archive with some of its files replaced, added or removed.
+// Untouched files keep their segments as stored (compressed or not, inline
+// buffers included) along with their sha1 and dependencies, their disk bytes
+// are copied in large sequential runs and never decompressed. Only the
+// replaced and added files are loaded and compressed, all at once on worker
+// threads (same as archive_writer::write), before anything is written.
+// If the dropped bytes (replaced and removed files) are a small part of the
+// source, the source file is copied whole (std::filesystem::copy_file, which
+// uses CopyFile2 or copy_file_range) and patched: the new files and the
+// metadata are written where its metadata was, dropped segments are left
+// unreferenced. Otherwise the kept segments are compacted into a new file.
+struct archive_repacker
+{
+  using loader_fn = archive_writer::loader_fn;
+
+  struct options
+  {
+    // none stores the new files uncompressed
+    oodle::compression_level level = oodle::compression_level::normal;
+    // 0 means one per hardware thread
+    size_t workers_cnt = 0;
+    // the source is patched in place of being compacted if the dropped
+    // bytes are at most this ratio of its segments bytes
+    double max_unused_ratio = 0.05;
+  };
+
+  struct result
+  {
+    size_t   files_cnt = 0;
+    size_t   kept_cnt = 0;
+    size_t   packed_cnt = 0; // replaced or added
+    size_t   compressed_cnt = 0; // of packed ones
+    uint64_t kept_disk_bytes = 0;
+    uint64_t packed_disk_bytes = 0;
+    // bytes of the output not referenced by any segment (dropped segments if
+    // patched, holes read through between kept segments if compacted)
+    uint64_t unused_bytes = 0;
+    bool     compacted = false;
+  };
+
+  explicit archive_repacker(std::shared_ptr<const archive> src);
+
+  archive_repacker(const archive_repacker&) = delete;
+  archive_repacker& operator=(const archive_repacker&) = delete;
+
+  // replaces the file if the source has it, adds it otherwise
+  void replace_file(radr::file_id fid, file_time ftime, loader_fn loader);
+
+  bool replace_file(const path& depot_path, const std::filesystem::path& src);
+
+  void remove_file(radr::file_id fid);
+
+  // dst must not be the source archive file
+  bool write(const std::filesystem::path& dst, const options& opts = {}, result* res = nullptr) const;
+
+protected:
+  struct change
+  {
+    file_time ftime;
+    loader_fn loader; // empty if removed
+  };
+
+  std::shared_ptr<const archive> m_src;
+  std::map<uint64_t, change> m_changes;
+};
+
+} // namespace cp
+
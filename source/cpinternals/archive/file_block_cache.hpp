@@ -0,0 +1,84 @@
+#pragma once
+#include <inttypes.h>
+#include <atomic>
+#include <cpinternals/common/byte_lru_cache.hpp>
+
+namespace cp {
+
+struct file_block_cache_key
+{
+  const void* archive;
+  uint32_t    file_idx;
+  uint32_t    block_idx;
+
+  bool operator==(const file_block_cache_key& other) const
+  {
+    return archive == other.archive && file_idx == other.file_idx && block_idx == other.block_idx;
+  }
+};
+
+struct file_block_cache_key_hash
+{
+  size_t operator()(const file_block_cache_key& k) const
+  {
+    const uint64_t fb = (uint64_t(k.file_idx) << 32) | k.block_idx;
+    return std::hash<const void*>()(k.archive) ^ (size_t(fb) * 0x9E3779B97F4A7C15ull);
+  }
+};
+
+// Byte-budgeted LRU cache of fixed-size blocks of archive files (file
+// content, decompressed), keyed by archive, file index and block index.
+struct file_block_cache
+  : public byte_lru_cache<file_block_cache_key, file_block_cache_key_hash>
+{
+  static constexpr size_t default_budget = 128 * 1024 * 1024;
+  static constexpr size_t default_block_size = 256 * 1024;
+
+  explicit file_block_cache(size_t budget = default_budget, size_t block_size = default_block_size)
+    : byte_lru_cache(budget), m_block_size(block_size ? block_size : default_block_size) {}
+
+  bool is_enabled() const
+  {
+    return budget() > 0;
+  }
+
+  // meant to be set before use, clears the cache since cached blocks
+  // would have the old size
+  void set_block_size(size_t block_size)
+  {
+    if (block_size && block_size != m_block_size)
+    {
+      m_block_size = block_size;
+      clear();
+    }
+  }
+
+  size_t block_size() const
+  {
+    return m_block_size;
+  }
+
+  // returns nullptr on miss
+  buffer_type find(const void* archive, uint32_t file_idx, uint32_t block_idx)
+  {
+    return byte_lru_cache::find(key_type{archive, file_idx, block_idx});
+  }
+
+  // doesn't count as a hit or miss, used to skip useless readaheads
+  bool contains(const void* archive, uint32_t file_idx, uint32_t block_idx) const
+  {
+    return byte_lru_cache::contains(key_type{archive, file_idx, block_idx});
+  }
+
+  // a readahead and a read can miss the same block, the first one is kept
+  void insert(const void* archive, uint32_t file_idx, uint32_t block_idx, const buffer_type& buffer)
+  {
+    byte_lru_cache::insert(key_type{archive, file_idx, block_idx}, buffer);
+  }
+
+protected:
+  std::atomic<size_t> m_block_size;
+};
+
+} // namespace cp
+
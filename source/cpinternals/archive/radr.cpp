@@ -82,7 +82,7 @@ void metadata::serialize(streambase& st, bool check_crc)
   else // writing
   {
     auto cur_spos = st.tell();
-    tbls_size = static_cast<uint32_t>(tbls_spos - cur_spos);
+    tbls_size = static_cast<uint32_t>(cur_spos - tbls_spos);
 
     st.seek(start_spos);
     st << tbls_offset;
@@ -93,28 +93,20 @@ void metadata::serialize(streambase& st, bool check_crc)
 
 uint64_t metadata::compute_tbls_crc64()
 {
-  uint32_t cnt = 0;
-  crc64_builder b;
-
-  b.init();
-
-  cnt = static_cast<uint32_t>(records.size());
-  b.update(&cnt, 4);
-  const size_t records_size = cnt * sizeof(file_record);
-
-  cnt = static_cast<uint32_t>(segments.size());
-  b.update(&cnt, 4);
-  const size_t segments_size = cnt * sizeof(segment_descriptor);
-
-  cnt = static_cast<uint32_t>(dependencies.size());
-  b.update(&cnt, 4);
-  const size_t dependencies_size = cnt * sizeof(dependency);
-
-  b.update(records.data(), records_size);
-  b.update(segments.data(), segments_size);
-  b.update(dependencies.data(), dependencies_size);
-
-  return b.finalize();
+  const uint32_t cnts[3] = {
+    static_cast<uint32_t>(records.size()),
+    static_cast<uint32_t>(segments.size()),
+    static_cast<uint32_t>(dependencies.size()),
+  };
+
+  // the tables of big archives are hashed over worker threads, each one
+  // continuing the crc of what precedes it
+  uint64_t crc = crc64_bigdata(reinterpret_cast<const char*>(cnts), sizeof(cnts));
+  crc = crc64_parallel(reinterpret_cast<const char*>(records.data()), cnts[0] * sizeof(file_record), crc);
+  crc = crc64_parallel(reinterpret_cast<const char*>(segments.data()), cnts[1] * sizeof(segment_descriptor), crc);
+  crc = crc64_parallel(reinterpret_cast<const char*>(dependencies.data()), cnts[2] * sizeof(dependency), crc);
+
+  return crc;
 }
 
 } // namespace cp::radr
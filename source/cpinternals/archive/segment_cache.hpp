@@ -0,0 +1,62 @@
+#pragma once
+#include <inttypes.h>
+#include <cpinternals/common/byte_lru_cache.hpp>
+
+namespace cp {
+
+struct segment_cache_key
+{
+  const void* archive;
+  uint32_t    seg_idx;
+
+  bool operator==(const segment_cache_key& other) const
+  {
+    return archive == other.archive && seg_idx == other.seg_idx;
+  }
+};
+
+struct segment_cache_key_hash
+{
+  size_t operator()(const segment_cache_key& k) const
+  {
+    return std::hash<const void*>()(k.archive) ^ (size_t(k.seg_idx) * 0x9E3779B97F4A7C15ull);
+  }
+};
+
+// Byte-budgeted LRU cache of decompressed archive segments, keyed by
+// archive and segment index (see archive::read_segment_cached).
+struct segment_cache
+  : public byte_lru_cache<segment_cache_key, segment_cache_key_hash>
+{
+  static constexpr size_t default_budget = 64 * 1024 * 1024;
+
+  explicit segment_cache(size_t budget = default_budget)
+    : byte_lru_cache(budget) {}
+
+  // instance used by archives
+  static segment_cache& get()
+  {
+    static segment_cache s;
+    return s;
+  }
+
+  // returns nullptr on miss
+  buffer_type find(const void* archive, uint32_t seg_idx)
+  {
+    return byte_lru_cache::find(key_type{archive, seg_idx});
+  }
+
+  void insert(const void* archive, uint32_t seg_idx, const buffer_type& buffer)
+  {
+    byte_lru_cache::insert(key_type{archive, seg_idx}, buffer);
+  }
+
+  // must be called when an archive is destroyed (its address can be reused)
+  void erase_archive(const void* archive)
+  {
+    erase_if([archive](const key_type& k) { return k.archive == archive; });
+  }
+};
+
+} // namespace cp
+
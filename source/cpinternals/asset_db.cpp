@@ -0,0 +1,600 @@
+#include <cpinternals/asset_db.hpp>
+
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <span>
+
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+
+#include <cpinternals/os/file_mapping.hpp>
+
+namespace cp::asset_db {
+
+namespace detail {
+
+namespace {
+
+struct retained_storage
+{
+  static retained_storage& get()
+  {
+    static retained_storage s = {};
+    return s;
+  }
+
+  std::span<const char> retain(os::file_mapping&& mapping)
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_mappings.emplace_back(std::move(mapping)).view();
+  }
+
+  std::span<const char> retain(std::vector<char>&& buffer)
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_buffers.emplace_back(std::move(buffer));
+  }
+
+protected:
+  std::mutex m_mtx;
+  std::deque<os::file_mapping> m_mappings;
+  std::deque<std::vector<char>> m_buffers;
+};
+
+constexpr size_t align4(size_t x)
+{
+  return (x + 3) & ~size_t(3);
+}
+
+} // namespace
+
+std::span<const char> retain(os::file_mapping&& mapping)
+{
+  return retained_storage::get().retain(std::move(mapping));
+}
+
+std::span<const char> retain(std::vector<char>&& buffer)
+{
+  return retained_storage::get().retain(std::move(buffer));
+}
+
+bool db_view::parse(std::span<const char> data, db_kind kind)
+{
+  if (data.size() < sizeof(header))
+  {
+    return false;
+  }
+
+  std::memcpy(&hdr, data.data(), sizeof(header));
+  if (hdr.magic != magic || hdr.version != version || hdr.kind != (uint16_t)kind)
+  {
+    return false;
+  }
+
+  const size_t hashes_size = size_t(hdr.strings_cnt) * sizeof(uint64_t);
+  const size_t offsets_size = (size_t(hdr.strings_cnt) + 1) * sizeof(uint32_t);
+  const size_t chars_size = align4(hdr.chars_size);
+  const size_t words_size = size_t(hdr.words_cnt) * sizeof(uint32_t);
+  if (data.size() != sizeof(header) + hashes_size + offsets_size + chars_size + words_size)
+  {
+    return false;
+  }
+
+  // mappings and vector buffers are aligned enough for these casts
+  const char* p = data.data() + sizeof(header);
+  hashes = {reinterpret_cast<const uint64_t*>(p), hdr.strings_cnt};
+  p += hashes_size;
+  offsets = {reinterpret_cast<const uint32_t*>(p), size_t(hdr.strings_cnt) + 1};
+  p += offsets_size;
+  chars = p;
+  p += chars_size;
+  words = {reinterpret_cast<const uint32_t*>(p), hdr.words_cnt};
+
+  if (offsets[0] != 0 || offsets[hdr.strings_cnt] != hdr.chars_size)
+  {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < hdr.strings_cnt; ++i)
+  {
+    if (offsets[i + 1] <= offsets[i] || chars[offsets[i + 1] - 1] != '\0')
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+std::vector<gname> register_strings(const db_view& view)
+{
+  std::vector<std::string_view> svs;
+  svs.reserve(view.hdr.strings_cnt);
+  for (uint32_t i = 0; i < view.hdr.strings_cnt; ++i)
+  {
+    svs.emplace_back(view.string(i));
+  }
+
+  return gname::register_strings(svs, view.hashes, true);
+}
+
+} // namespace detail
+
+namespace {
+
+using detail::db_view;
+using detail::words_reader;
+using detail::register_strings;
+
+bool write_file(const std::filesystem::path& p, const std::vector<char>& data)
+{
+  std::ofstream ofs(p, std::ios::binary | std::ios::trunc);
+  if (!ofs)
+  {
+    return false;
+  }
+
+  ofs.write(data.data(), data.size());
+  return ofs.good();
+}
+
+bool parse_json_file(const std::filesystem::path& p, nlohmann::json& j)
+{
+  std::ifstream ifs(p);
+  if (!ifs.is_open())
+  {
+    SPDLOG_ERROR("couldn't open {}", p.string());
+    return false;
+  }
+
+  try
+  {
+    ifs >> j;
+  }
+  catch (std::exception& e)
+  {
+    SPDLOG_ERROR("couldn't parse {}: {}", p.string(), e.what());
+    return false;
+  }
+
+  return true;
+}
+
+bool build_names(const nlohmann::json& j, db_builder& builder)
+{
+  const auto& names = j.get_ref<const nlohmann::json::array_t&>();
+  builder.push((uint32_t)names.size());
+  for (const auto& name : names)
+  {
+    builder.push(builder.intern(name.get_ref<const std::string&>()));
+  }
+  return true;
+}
+
+bool build_enums(const nlohmann::json& j, db_builder& builder)
+{
+  builder.push((uint32_t)j.size());
+  for (auto it = j.begin(); it != j.end(); ++it)
+  {
+    const auto& members = it.value().get_ref<const nlohmann::json::array_t&>();
+    builder.push(builder.intern(it.key()));
+    builder.push((uint32_t)members.size());
+    for (const auto& member : members)
+    {
+      builder.push(builder.intern(member.get_ref<const std::string&>()));
+    }
+  }
+  return true;
+}
+
+// same order as read_class_bp in cclass.cpp: parents first
+bool build_class(const nlohmann::json& j, nlohmann::json::const_iterator j_it,
+  std::unordered_map<std::string, uint32_t>& indices, uint32_t& cnt, db_builder& builder)
+{
+  if (indices.find(j_it.key()) != indices.end())
+  {
+    return true;
+  }
+
+  const auto& cdef = j_it.value();
+
+  uint32_t parent_idx = npos;
+  auto parent_jit = cdef.find("parent");
+  if (parent_jit != cdef.end())
+  {
+    const auto& parent_name = parent_jit->get_ref<const std::string&>();
+    auto parent_it = j.find(parent_name);
+    if (parent_it == j.end())
+    {
+      SPDLOG_ERROR("incomplete db, {} is missing parent def {}", j_it.key(), parent_name);
+      return false;
+    }
+
+    // reserved to break circular dependencies
+    indices.emplace(j_it.key(), npos);
+    if (!build_class(j, parent_it, indices, cnt, builder))
+    {
+      return false;
+    }
+
+    parent_idx = indices[parent_name];
+    if (parent_idx == npos)
+    {
+      SPDLOG_ERROR("circular parent defs for {}", j_it.key());
+      return false;
+    }
+  }
+
+  const auto& props = cdef.at("props").get_ref<const nlohmann::json::array_t&>();
+  builder.push(builder.intern(j_it.key()));
+  builder.push(parent_idx);
+  builder.push((uint32_t)props.size());
+  for (const auto& prop : props)
+  {
+    builder.push(builder.intern(prop.at("name").get_ref<const std::string&>()));
+    builder.push(builder.intern(prop.at("ctypename").get_ref<const std::string&>()));
+  }
+
+  indices[j_it.key()] = cnt++;
+  return true;
+}
+
+bool build_classes(const nlohmann::json& j, db_builder& builder)
+{
+  builder.push((uint32_t)j.size());
+
+  std::unordered_map<std::string, uint32_t> indices;
+  indices.reserve(j.size());
+  uint32_t cnt = 0;
+  for (auto it = j.begin(); it != j.end(); ++it)
+  {
+    if (!build_class(j, it, indices, cnt, builder))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+using build_fn = bool (*)(const nlohmann::json&, db_builder&);
+
+// names lists can also be text files, one name per line
+bool compile_names_list(const std::filesystem::path& txt_path, std::vector<char>& out)
+{
+  std::ifstream ifs(txt_path);
+  if (!ifs.is_open())
+  {
+    SPDLOG_ERROR("couldn't open {}", txt_path.string());
+    return false;
+  }
+
+  db_builder builder(db_kind::names);
+  std::vector<uint32_t> indices;
+
+  std::string line;
+  while (std::getline(ifs, line))
+  {
+    if (line.size())
+    {
+      indices.push_back(builder.intern(line));
+    }
+  }
+
+  builder.push((uint32_t)indices.size());
+  for (uint32_t idx : indices)
+  {
+    builder.push(idx);
+  }
+
+  out = builder.serialize(source_stamp::of_file(txt_path));
+  return true;
+}
+
+bool compile_json(const std::filesystem::path& json_path, db_kind kind, build_fn build, std::vector<char>& out)
+{
+  nlohmann::json j;
+  if (!parse_json_file(json_path, j))
+  {
+    return false;
+  }
+
+  db_builder builder(kind);
+  try
+  {
+    if (!build(j, builder))
+    {
+      return false;
+    }
+  }
+  catch (std::exception& e)
+  {
+    SPDLOG_ERROR("{} has unexpected content: {}", json_path.string(), e.what());
+    return false;
+  }
+
+  out = builder.serialize(source_stamp::of_file(json_path));
+  return true;
+}
+
+bool compile_source(const std::filesystem::path& src_path, db_kind kind, build_fn build, std::vector<char>& out)
+{
+  if (kind == db_kind::names && src_path.extension() == ".txt")
+  {
+    return compile_names_list(src_path, out);
+  }
+
+  return compile_json(src_path, kind, build, out);
+}
+
+bool compile_json_to(const std::filesystem::path& json_path, const std::filesystem::path& db_path, db_kind kind, build_fn build)
+{
+  std::vector<char> data;
+  if (!compile_source(json_path, kind, build, data))
+  {
+    return false;
+  }
+
+  if (!write_file(db_path, data))
+  {
+    SPDLOG_ERROR("couldn't write {}", db_path.string());
+    return false;
+  }
+
+  return true;
+}
+
+// returns the retained data of an up-to-date db, compiling it if needed
+std::span<const char> open_db(const std::filesystem::path& json_path, db_kind kind, build_fn build, db_view& view)
+{
+  const auto db_path = db_path_of(json_path);
+  const auto stamp = source_stamp::of_file(json_path);
+  const bool has_json = stamp.size != 0;
+
+  os::file_mapping mapping;
+  if (mapping.open(db_path))
+  {
+    if (view.parse(mapping.view(), kind))
+    {
+      // dumped dbs have a null stamp and aren't replaced by a compiled json
+      const source_stamp db_stamp = {view.hdr.source_size, view.hdr.source_time};
+      if (!has_json || db_stamp.is_null() || stamp == db_stamp)
+      {
+        return detail::retain(std::move(mapping));
+      }
+    }
+    else
+    {
+      SPDLOG_WARN("{} is corrupt or from another version", db_path.string());
+    }
+    mapping.close();
+  }
+
+  if (!has_json)
+  {
+    return {};
+  }
+
+  std::vector<char> data;
+  if (!compile_source(json_path, kind, build, data) || !view.parse(data, kind))
+  {
+    return {};
+  }
+
+  if (!write_file(db_path, data))
+  {
+    SPDLOG_WARN("couldn't write {}, it will be compiled again on next load", db_path.string());
+  }
+
+  return detail::retain(std::move(data));
+}
+
+// hashes are the ones of the db, optional
+bool read_names(const std::filesystem::path& json_path, const db_view& view,
+  std::vector<gname>& out, std::vector<uint64_t>* out_hashes)
+{
+  const auto strings = register_strings(view);
+  words_reader reader(view.words, strings);
+
+  std::vector<gname> names(reader.count(1));
+  std::vector<uint64_t> hashes;
+  if (out_hashes)
+  {
+    hashes.reserve(names.size());
+  }
+
+  for (auto& name : names)
+  {
+    const uint32_t idx = reader.word();
+    if (idx >= strings.size())
+    {
+      break;
+    }
+
+    name = strings[idx];
+    if (out_hashes)
+    {
+      hashes.push_back(view.hashes[idx]);
+    }
+  }
+
+  if (!reader.ok() || !reader.at_end() || (out_hashes && hashes.size() != names.size()))
+  {
+    SPDLOG_ERROR("{} has unexpected content", db_path_of(json_path).string());
+    return false;
+  }
+
+  out = std::move(names);
+  if (out_hashes)
+  {
+    *out_hashes = std::move(hashes);
+  }
+  return true;
+}
+
+} // namespace
+
+std::filesystem::path db_path_of(const std::filesystem::path& json_path)
+{
+  auto ret = json_path;
+  ret.replace_extension(".cpdb");
+  return ret;
+}
+
+bool compile_names_json(const std::filesystem::path& json_path, const std::filesystem::path& db_path)
+{
+  return compile_json_to(json_path, db_path, db_kind::names, build_names);
+}
+
+bool compile_names_txt(const std::filesystem::path& txt_path, const std::filesystem::path& db_path)
+{
+  return compile_json_to(txt_path, db_path, db_kind::names, build_names);
+}
+
+bool compile_enums_json(const std::filesystem::path& json_path, const std::filesystem::path& db_path)
+{
+  return compile_json_to(json_path, db_path, db_kind::enums, build_enums);
+}
+
+bool compile_classes_json(const std::filesystem::path& json_path, const std::filesystem::path& db_path)
+{
+  return compile_json_to(json_path, db_path, db_kind::classes, build_classes);
+}
+
+bool load_names(const std::filesystem::path& json_path, std::vector<gname>& out)
+{
+  db_view view;
+  if (open_db(json_path, db_kind::names, build_names, view).empty())
+  {
+    return false;
+  }
+
+  return read_names(json_path, view, out, nullptr);
+}
+
+bool load_names(const std::filesystem::path& json_path, std::vector<gname>& out, std::vector<uint64_t>& out_hashes)
+{
+  db_view view;
+  if (open_db(json_path, db_kind::names, build_names, view).empty())
+  {
+    return false;
+  }
+
+  return read_names(json_path, view, out, &out_hashes);
+}
+
+bool load_enums(const std::filesystem::path& json_path, std::vector<enum_record>& out)
+{
+  db_view view;
+  if (open_db(json_path, db_kind::enums, build_enums, view).empty())
+  {
+    return false;
+  }
+
+  const auto strings = register_strings(view);
+  words_reader reader(view.words, strings);
+
+  std::vector<enum_record> enums(reader.count(2));
+  for (auto& e : enums)
+  {
+    e.name = reader.string();
+    e.members.resize(reader.count(1));
+    for (auto& member : e.members)
+    {
+      member = reader.string();
+    }
+  }
+
+  if (!reader.ok() || !reader.at_end())
+  {
+    SPDLOG_ERROR("{} has unexpected content", db_path_of(json_path).string());
+    return false;
+  }
+
+  out = std::move(enums);
+  return true;
+}
+
+bool load_classes(const std::filesystem::path& json_path, std::vector<class_record>& out)
+{
+  class_db db;
+  if (!db.open(json_path))
+  {
+    return false;
+  }
+
+  std::vector<class_record> classes(db.size());
+  for (uint32_t i = 0; i < (uint32_t)classes.size(); ++i)
+  {
+    db.read(i, classes[i]);
+  }
+
+  out = std::move(classes);
+  return true;
+}
+
+bool class_db::open(const std::filesystem::path& json_path)
+{
+  db_view view;
+  if (open_db(json_path, db_kind::classes, build_classes, view).empty())
+  {
+    return false;
+  }
+
+  m_words = view.words;
+  m_strings = register_strings(view);
+  m_offsets.clear();
+  m_indices.clear();
+
+  words_reader reader(m_words, m_strings);
+
+  const uint32_t cnt = reader.count(3);
+  m_offsets.reserve(cnt);
+  m_indices.reserve(cnt);
+
+  bool ok = reader.ok();
+  for (uint32_t i = 0; i < cnt && ok; ++i)
+  {
+    m_offsets.push_back((uint32_t)reader.pos());
+    m_indices.emplace(reader.string(), i);
+
+    const uint32_t parent_idx = reader.word();
+    ok = parent_idx == npos || parent_idx < i;
+
+    const uint32_t fields_cnt = reader.count(2);
+    for (uint32_t j = 0; j < fields_cnt * 2; ++j)
+    {
+      reader.string();
+    }
+
+    ok = ok && reader.ok();
+  }
+
+  if (!ok || !reader.at_end())
+  {
+    SPDLOG_ERROR("{} has unexpected content", db_path_of(json_path).string());
+    m_offsets.clear();
+    m_indices.clear();
+    return false;
+  }
+
+  return true;
+}
+
+void class_db::read(uint32_t idx, class_record& out) const
+{
+  words_reader reader(m_words, m_strings, m_offsets[idx]);
+
+  out.name = reader.string();
+  out.parent_idx = reader.word();
+  out.fields.resize(reader.count(2));
+  for (auto& field : out.fields)
+  {
+    field.name = reader.string();
+    field.ctypename = reader.string();
+  }
+}
+
+} // namespace cp::asset_db
+
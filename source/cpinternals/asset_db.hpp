@@ -0,0 +1,184 @@
+#pragma once
+#include <inttypes.h>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <cpinternals/common.hpp>
+#include <cpinternals/asset_db_format.hpp>
+
+namespace cp::os {
+struct file_mapping;
+} // namespace cp::os
+
+namespace cp::asset_db {
+
+// Compiled asset databases (.cpdb), binary equivalents of the json dbs
+// (names lists, CEnums.json, CObjectBPs.json) that load without parsing.
+// see asset_db_format.hpp for the layout.
+//
+// Files are memory-mapped and stay mapped: strings are registered in the
+// gname pools without copies. The header keeps the size and write time of
+// the json it was compiled from, a db that doesn't match is recompiled.
+// A db with a null stamp was written by the rtti dumper, not compiled: it
+// is loaded even if a json is next to it.
+
+struct enum_record
+{
+  gname name;
+  std::vector<gname> members;
+};
+
+struct class_field_record
+{
+  gname name;
+  gname ctypename;
+};
+
+struct class_record
+{
+  gname name;
+  uint32_t parent_idx = npos;
+  std::vector<class_field_record> fields;
+};
+
+// classes db indexed by name, records are decoded on demand.
+// the whole db is validated on open, reads can't fail.
+struct class_db
+{
+  // see load_classes
+  bool open(const std::filesystem::path& json_path);
+
+  size_t size() const
+  {
+    return m_offsets.size();
+  }
+
+  // npos if not found
+  uint32_t find(gname name) const
+  {
+    auto it = m_indices.find(name);
+    return it != m_indices.end() ? it->second : npos;
+  }
+
+  void read(uint32_t idx, class_record& out) const;
+
+protected:
+  std::span<const uint32_t> m_words; // retained
+  std::vector<gname> m_strings;
+  std::vector<uint32_t> m_offsets;   // of the records in m_words
+  std::unordered_map<gname, uint32_t> m_indices;
+};
+
+namespace detail {
+
+// validated view of a db
+struct db_view
+{
+  header hdr = {};
+  std::span<const uint64_t> hashes;
+  std::span<const uint32_t> offsets;
+  const char* chars = nullptr;
+  std::span<const uint32_t> words;
+
+  bool parse(std::span<const char> data, db_kind kind);
+
+  std::string_view string(uint32_t idx) const
+  {
+    return std::string_view(chars + offsets[idx], offsets[idx + 1] - offsets[idx] - 1);
+  }
+};
+
+// bounds-checked reader of the record words
+struct words_reader
+{
+  words_reader(std::span<const uint32_t> words, const std::vector<gname>& strings, size_t pos = 0)
+    : m_words(words), m_strings(strings), m_pos(pos) {}
+
+  size_t pos() const
+  {
+    return m_pos;
+  }
+
+  bool ok() const
+  {
+    return m_ok;
+  }
+
+  bool at_end() const
+  {
+    return m_pos == m_words.size();
+  }
+
+  uint32_t word()
+  {
+    if (m_pos >= m_words.size())
+    {
+      m_ok = false;
+      return 0;
+    }
+    return m_words[m_pos++];
+  }
+
+  gname string()
+  {
+    const uint32_t idx = word();
+    if (idx >= m_strings.size())
+    {
+      m_ok = false;
+      return gname();
+    }
+    return m_strings[idx];
+  }
+
+  // for counts, a count bigger than the remaining words is corrupt
+  uint32_t count(size_t words_per_item)
+  {
+    const uint32_t cnt = word();
+    if (size_t(cnt) * words_per_item > m_words.size() - m_pos)
+    {
+      m_ok = false;
+      return 0;
+    }
+    return cnt;
+  }
+
+protected:
+  std::span<const uint32_t> m_words;
+  const std::vector<gname>& m_strings;
+  size_t m_pos = 0;
+  bool m_ok = true;
+};
+
+// loaded dbs are never released, their strings are referenced by the pools
+std::span<const char> retain(os::file_mapping&& mapping);
+std::span<const char> retain(std::vector<char>&& buffer);
+
+// registers the strings of a retained db in the gname pool, without copies
+std::vector<gname> register_strings(const db_view& view);
+
+} // namespace detail
+
+// path of the compiled db of a json db (same stem, .cpdb)
+std::filesystem::path db_path_of(const std::filesystem::path& json_path);
+
+// compiles a json db, returns false if it can't be read or has unexpected content
+bool compile_names_json(const std::filesystem::path& json_path, const std::filesystem::path& db_path);
+bool compile_names_txt(const std::filesystem::path& txt_path, const std::filesystem::path& db_path);
+bool compile_enums_json(const std::filesystem::path& json_path, const std::filesystem::path& db_path);
+bool compile_classes_json(const std::filesystem::path& json_path, const std::filesystem::path& db_path);
+
+// loads the compiled db of a json db, compiling it first if it is missing
+// or stale (if writing it fails the compiled buffer is loaded from memory).
+// a db without its json is loaded as is.
+// returns false if neither can be loaded, callers can fallback to the json.
+bool load_names(const std::filesystem::path& json_path, std::vector<gname>& out);
+// with the fnv1a64 hashes of the names, as stored in the db
+bool load_names(const std::filesystem::path& json_path, std::vector<gname>& out, std::vector<uint64_t>& out_hashes);
+bool load_enums(const std::filesystem::path& json_path, std::vector<enum_record>& out);
+bool load_classes(const std::filesystem::path& json_path, std::vector<class_record>& out);
+
+} // namespace cp::asset_db
+
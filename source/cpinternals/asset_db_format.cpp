@@ -0,0 +1,115 @@
+#include <cpinternals/asset_db_format.hpp>
+
+#include <cstring>
+#include <fstream>
+
+#include <cpinternals/common/hashing.hpp>
+
+namespace cp::asset_db {
+
+namespace {
+
+constexpr size_t align4(size_t x)
+{
+  return (x + 3) & ~size_t(3);
+}
+
+} // namespace
+
+source_stamp source_stamp::of_file(const std::filesystem::path& p)
+{
+  source_stamp ret;
+
+  std::error_code ec;
+  const auto size = std::filesystem::file_size(p, ec);
+  if (ec)
+  {
+    return ret;
+  }
+
+  const auto wtime = std::filesystem::last_write_time(p, ec);
+  ret.size = (uint64_t)size;
+  ret.time = ec ? 0 : (uint64_t)wtime.time_since_epoch().count();
+  return ret;
+}
+
+uint32_t db_builder::intern(std::string_view s)
+{
+  auto it = m_idxmap.find(s);
+  if (it != m_idxmap.end())
+  {
+    return it->second;
+  }
+
+  const uint32_t idx = (uint32_t)m_strings.size();
+  m_idxmap.emplace(m_strings.emplace_back(s), idx);
+  return idx;
+}
+
+std::vector<char> db_builder::serialize(const source_stamp& stamp) const
+{
+  header hdr = {};
+  hdr.magic = magic;
+  hdr.version = version;
+  hdr.kind = (uint16_t)m_kind;
+  hdr.source_size = stamp.size;
+  hdr.source_time = stamp.time;
+  hdr.strings_cnt = (uint32_t)m_strings.size();
+  hdr.words_cnt = (uint32_t)m_words.size();
+
+  const std::vector<std::string_view> svs(m_strings.begin(), m_strings.end());
+  std::vector<uint64_t> hashes(svs.size());
+  fnv1a64_batch(svs, hashes);
+
+  std::vector<uint32_t> offsets;
+  offsets.reserve(m_strings.size() + 1);
+
+  uint32_t chars_size = 0;
+  for (const auto& s : m_strings)
+  {
+    offsets.push_back(chars_size);
+    chars_size += (uint32_t)s.size() + 1;
+  }
+  offsets.push_back(chars_size);
+  hdr.chars_size = chars_size;
+
+  const size_t hashes_size = hashes.size() * sizeof(uint64_t);
+  const size_t offsets_size = offsets.size() * sizeof(uint32_t);
+  const size_t words_size = m_words.size() * sizeof(uint32_t);
+
+  std::vector<char> ret(sizeof(header) + hashes_size + offsets_size + align4(chars_size) + words_size);
+
+  char* p = ret.data();
+  std::memcpy(p, &hdr, sizeof(header));
+  p += sizeof(header);
+  std::memcpy(p, hashes.data(), hashes_size);
+  p += hashes_size;
+  std::memcpy(p, offsets.data(), offsets_size);
+  p += offsets_size;
+  for (const auto& s : m_strings)
+  {
+    std::memcpy(p, s.data(), s.size());
+    p += s.size() + 1;
+  }
+  p += align4(chars_size) - chars_size;
+  std::memcpy(p, m_words.data(), words_size);
+
+  return ret;
+}
+
+bool db_builder::write(const std::filesystem::path& db_path, const source_stamp& stamp) const
+{
+  const auto data = serialize(stamp);
+
+  std::ofstream ofs(db_path, std::ios::binary | std::ios::trunc);
+  if (!ofs)
+  {
+    return false;
+  }
+
+  ofs.write(data.data(), data.size());
+  return ofs.good();
+}
+
+} // namespace cp::asset_db
+
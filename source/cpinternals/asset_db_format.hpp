@@ -0,0 +1,101 @@
+#pragma once
+#include <inttypes.h>
+#include <deque>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace cp::asset_db {
+
+// Layout of the compiled asset databases (.cpdb) and their builder.
+// This part doesn't depend on the gname pools, the rtti dumper links it to
+// write the dbs directly from the game's RTTI.
+// Names lists can also be compiled from text files (.txt, one per line).
+//
+// layout (little-endian):
+//   header
+//   uint64_t hashes[strings_cnt]       fnv1a64 of the strings (gname hashes)
+//   uint32_t offsets[strings_cnt + 1]  into chars
+//   char     chars[chars_size]         null-terminated strings, padded to 4
+//   uint32_t words[words_cnt]          records, see db_kind
+
+enum class db_kind : uint16_t
+{
+  // cnt, string_idx[cnt]
+  names   = 1,
+  // cnt, { name, members_cnt, member[members_cnt] }[cnt]
+  enums   = 2,
+  // cnt, { name, parent_class_idx (npos if none), fields_cnt, { name, ctypename }[fields_cnt] }[cnt]
+  // classes come after their parent
+  classes = 3,
+  // resolvers image, see startup_snapshot.hpp
+  snapshot = 4,
+};
+
+inline constexpr uint32_t magic = 'BDPC';
+inline constexpr uint16_t version = 1;
+inline constexpr uint32_t npos = UINT32_MAX;
+
+struct header
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t kind;
+  uint64_t source_size;
+  uint64_t source_time;
+  uint32_t strings_cnt;
+  uint32_t chars_size;
+  uint32_t words_cnt;
+  uint32_t reserved;
+};
+static_assert(sizeof(header) == 0x28);
+
+// identifies the source json, null for dumped dbs
+struct source_stamp
+{
+  uint64_t size = 0;
+  uint64_t time = 0;
+
+  bool operator==(const source_stamp& other) const
+  {
+    return size == other.size && time == other.time;
+  }
+
+  bool is_null() const
+  {
+    return size == 0 && time == 0;
+  }
+
+  // zero stamp if the file doesn't exist
+  static source_stamp of_file(const std::filesystem::path& p);
+};
+
+// interns strings and collects record words
+struct db_builder
+{
+  explicit db_builder(db_kind kind)
+    : m_kind(kind) {}
+
+  uint32_t intern(std::string_view s);
+
+  void push(uint32_t word)
+  {
+    m_words.push_back(word);
+  }
+
+  std::vector<char> serialize(const source_stamp& stamp = {}) const;
+
+  // serializes to a file, returns false if it couldn't be written
+  bool write(const std::filesystem::path& db_path, const source_stamp& stamp = {}) const;
+
+protected:
+  db_kind m_kind;
+  std::deque<std::string> m_strings; // stable, m_idxmap keys are views of them
+  std::unordered_map<std::string_view, uint32_t> m_idxmap;
+  std::vector<uint32_t> m_words;
+};
+
+} // namespace cp::asset_db
+
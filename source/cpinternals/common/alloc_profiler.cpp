@@ -0,0 +1,302 @@
+#include <cpinternals/common/alloc_profiler.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+#include <spdlog/spdlog.h>
+#include <cpinternals/os/platform_utils.hpp>
+
+namespace cp {
+
+namespace {
+
+// power of 2, samples whose stack doesn't fit are dropped
+constexpr size_t stack_slots_cnt = 4096;
+constexpr size_t max_probes = 64;
+
+struct tag_counters
+{
+  std::atomic<uint64_t> allocs = 0;
+  std::atomic<uint64_t> bytes = 0;
+  std::array<std::atomic<uint64_t>, alloc_profiler::buckets_cnt> sizes = {};
+};
+
+struct stack_slot
+{
+  uint64_t hash = 0; // 0 if empty
+  alloc_profiler::stack_sample sample;
+};
+
+// static storage, nothing here allocates
+struct profiler_state
+{
+  std::array<tag_counters, alloc_profiler::tags_cnt> tags;
+  std::atomic<uint64_t> frees = 0;
+  std::atomic<uint64_t> freed_bytes = 0;
+  std::atomic<uint64_t> dropped_samples = 0;
+  std::atomic<uint32_t> sample_interval = 4096;
+
+  std::mutex stacks_mtx;
+  std::array<stack_slot, stack_slots_cnt> stacks;
+};
+
+profiler_state g_state;
+
+thread_local uint32_t tls_sample_countdown = 0;
+// set while the profiler itself runs on this thread (its allocations aren't sampled)
+thread_local bool tls_in_profiler = false;
+
+constexpr std::string_view tag_names[alloc_profiler::tags_cnt] = {
+  "other",
+  "csav",
+  "scripting",
+  "treefs",
+  "archive",
+};
+
+size_t size_bucket(size_t size)
+{
+  size_t bucket_idx = 0;
+  for (size_t v = size; v && bucket_idx + 1 < alloc_profiler::buckets_cnt; v >>= 1)
+  {
+    ++bucket_idx;
+  }
+  return bucket_idx;
+}
+
+uint64_t hash_sample(const alloc_profiler::stack_sample& s)
+{
+  // FNV-1a over the tag and the frames
+  uint64_t h = 0xCBF29CE484222325ull ^ static_cast<uint64_t>(s.tag);
+  for (uint32_t i = 0; i < s.frames_cnt; ++i)
+  {
+    h = (h ^ reinterpret_cast<uintptr_t>(s.frames[i])) * 0x100000001B3ull;
+  }
+  return h ? h : 1;
+}
+
+} // namespace
+
+uint64_t alloc_profiler::tag_stats::size_percentile(double ratio) const
+{
+  uint64_t total = 0;
+  for (uint64_t cnt : sizes)
+  {
+    total += cnt;
+  }
+
+  if (!total)
+  {
+    return 0;
+  }
+
+  const uint64_t target = static_cast<uint64_t>(double(total) * ratio);
+  uint64_t acc = 0;
+  for (size_t i = 0; i < buckets_cnt; ++i)
+  {
+    acc += sizes[i];
+    if (acc > target)
+    {
+      return uint64_t(1) << i;
+    }
+  }
+
+  return uint64_t(1) << (buckets_cnt - 1);
+}
+
+alloc_profiler& alloc_profiler::get()
+{
+  static alloc_profiler s_instance;
+  return s_instance;
+}
+
+void alloc_profiler::set_sample_interval(uint32_t interval)
+{
+  g_state.sample_interval.store(interval, std::memory_order_relaxed);
+}
+
+void alloc_profiler::record_alloc(size_t size)
+{
+  const alloc_tag tag = alloc_detail::tls_tag;
+
+  auto& tc = g_state.tags[static_cast<size_t>(tag)];
+  tc.allocs.fetch_add(1, std::memory_order_relaxed);
+  tc.bytes.fetch_add(size, std::memory_order_relaxed);
+  tc.sizes[size_bucket(size)].fetch_add(1, std::memory_order_relaxed);
+
+  const uint32_t interval = g_state.sample_interval.load(std::memory_order_relaxed);
+  if (!interval || tls_in_profiler)
+  {
+    return;
+  }
+
+  // the first allocation of a thread is sampled
+  tls_sample_countdown = std::min(tls_sample_countdown, interval);
+  if (tls_sample_countdown > 1)
+  {
+    --tls_sample_countdown;
+    return;
+  }
+  tls_sample_countdown = interval;
+
+  tls_in_profiler = true;
+
+  stack_sample s;
+  s.tag = tag;
+  s.frames_cnt = static_cast<uint32_t>(os::capture_stack(s.frames.data(), max_frames, 1));
+  const uint64_t h = hash_sample(s);
+
+  {
+    std::lock_guard<std::mutex> lock(g_state.stacks_mtx);
+
+    bool recorded = false;
+    for (size_t i = 0; i < max_probes; ++i)
+    {
+      auto& slot = g_state.stacks[(h + i) & (stack_slots_cnt - 1)];
+      if (!slot.hash)
+      {
+        slot.hash = h;
+        slot.sample = s;
+      }
+      else if (slot.hash != h)
+      {
+        continue;
+      }
+
+      ++slot.sample.count;
+      slot.sample.bytes += size;
+      recorded = true;
+      break;
+    }
+
+    if (!recorded)
+    {
+      g_state.dropped_samples.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  tls_in_profiler = false;
+}
+
+void alloc_profiler::record_free(size_t size)
+{
+  g_state.frees.fetch_add(1, std::memory_order_relaxed);
+  g_state.freed_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+alloc_profiler::snapshot alloc_profiler::take_snapshot() const
+{
+  tls_in_profiler = true;
+
+  snapshot snap;
+  for (size_t i = 0; i < tags_cnt; ++i)
+  {
+    const auto& tc = g_state.tags[i];
+    auto& ts = snap.tags[i];
+    ts.allocs = tc.allocs.load(std::memory_order_relaxed);
+    ts.bytes = tc.bytes.load(std::memory_order_relaxed);
+    for (size_t j = 0; j < buckets_cnt; ++j)
+    {
+      ts.sizes[j] = tc.sizes[j].load(std::memory_order_relaxed);
+    }
+  }
+
+  snap.frees = g_state.frees.load(std::memory_order_relaxed);
+  snap.freed_bytes = g_state.freed_bytes.load(std::memory_order_relaxed);
+  snap.dropped_samples = g_state.dropped_samples.load(std::memory_order_relaxed);
+  snap.sample_interval = g_state.sample_interval.load(std::memory_order_relaxed);
+
+  {
+    std::lock_guard<std::mutex> lock(g_state.stacks_mtx);
+    for (const auto& slot : g_state.stacks)
+    {
+      if (slot.hash)
+      {
+        snap.stacks.push_back(slot.sample);
+      }
+    }
+  }
+
+  std::sort(snap.stacks.begin(), snap.stacks.end(), [](const auto& a, const auto& b) {
+    return a.count > b.count;
+  });
+
+  tls_in_profiler = false;
+  return snap;
+}
+
+void alloc_profiler::reset()
+{
+  for (auto& tc : g_state.tags)
+  {
+    tc.allocs.store(0, std::memory_order_relaxed);
+    tc.bytes.store(0, std::memory_order_relaxed);
+    for (auto& cnt : tc.sizes)
+    {
+      cnt.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  g_state.frees.store(0, std::memory_order_relaxed);
+  g_state.freed_bytes.store(0, std::memory_order_relaxed);
+  g_state.dropped_samples.store(0, std::memory_order_relaxed);
+
+  std::lock_guard<std::mutex> lock(g_state.stacks_mtx);
+  for (auto& slot : g_state.stacks)
+  {
+    slot = stack_slot();
+  }
+}
+
+std::string alloc_profiler::report(const snapshot& snap, size_t top_n)
+{
+  if (!alloc_profiler_compiled)
+  {
+    return "allocation profiler not compiled in (see CP_ENABLE_ALLOC_PROFILER)\n";
+  }
+
+  std::string ret;
+  auto out = std::back_inserter(ret);
+
+  fmt::format_to(out, "{:<12}{:>14}{:>16}{:>10}{:>10}{:>10}{:>10}\n",
+    "allocations", "count", "bytes", "avg", "p50", "p90", "p99");
+  for (size_t i = 0; i < tags_cnt; ++i)
+  {
+    const auto& ts = snap.tags[i];
+    fmt::format_to(out, "{:<12}{:>14}{:>16}{:>10}{:>10}{:>10}{:>10}\n",
+      tag_names[i], ts.allocs, ts.bytes, ts.allocs ? ts.bytes / ts.allocs : 0,
+      ts.size_percentile(0.5), ts.size_percentile(0.9), ts.size_percentile(0.99));
+  }
+
+  fmt::format_to(out, "\nfrees: {} ({} bytes known)\n", snap.frees, snap.freed_bytes);
+
+  if (!snap.sample_interval)
+  {
+    return ret;
+  }
+
+  fmt::format_to(out, "\nsampled stacks (1 allocation in {} per thread, {} dropped):\n",
+    snap.sample_interval, snap.dropped_samples);
+
+  const size_t cnt = std::min(top_n, snap.stacks.size());
+  for (size_t i = 0; i < cnt; ++i)
+  {
+    const auto& s = snap.stacks[i];
+    fmt::format_to(out, "\n{:>10} samples {:>14} bytes [{}]\n", s.count, s.bytes, tag_names[static_cast<size_t>(s.tag)]);
+    for (uint32_t j = 0; j < s.frames_cnt; ++j)
+    {
+      fmt::format_to(out, "    {}\n", os::describe_code_address(s.frames[j]));
+    }
+  }
+
+  return ret;
+}
+
+const char* alloc_profiler::tag_name(alloc_tag tag)
+{
+  return tag_names[static_cast<size_t>(tag)].data();
+}
+
+} // namespace cp
+
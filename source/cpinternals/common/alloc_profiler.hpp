@@ -0,0 +1,142 @@
+#pragma once
+#include <inttypes.h>
+#include <array>
+#include <string>
+#include <vector>
+
+namespace cp {
+
+// Sampling allocation profiler, compiled in with CP_ENABLE_ALLOC_PROFILER
+// (everything below is a no-op otherwise).
+// Like the allocations counter of the spans, the library doesn't hook
+// operator new: a program that does calls profile_alloc/profile_free from
+// it. Allocations are attributed to the subsystem tag of the calling thread
+// (see scoped_alloc_tag, set at the entry points of cpinternals), worker
+// threads of a tagged job only inherit it if they set it themselves.
+// Per tag: allocations count, bytes and a log2 size histogram. The stack of
+// one allocation every sample_interval (per thread) is captured, samples
+// are aggregated by stack.
+#if defined(CP_ENABLE_ALLOC_PROFILER)
+inline constexpr bool alloc_profiler_compiled = true;
+#else
+inline constexpr bool alloc_profiler_compiled = false;
+#endif
+
+enum class alloc_tag : uint8_t
+{
+  other,
+  csav,
+  scripting,
+  treefs,
+  archive,
+  count_
+};
+
+namespace alloc_detail {
+
+inline thread_local alloc_tag tls_tag = alloc_tag::other;
+
+} // namespace alloc_detail
+
+// sets the tag of the calling thread for its lifetime
+struct scoped_alloc_tag
+{
+  explicit scoped_alloc_tag(alloc_tag tag)
+  {
+    if constexpr (alloc_profiler_compiled)
+    {
+      m_prev = alloc_detail::tls_tag;
+      alloc_detail::tls_tag = tag;
+    }
+  }
+
+  ~scoped_alloc_tag()
+  {
+    if constexpr (alloc_profiler_compiled)
+    {
+      alloc_detail::tls_tag = m_prev;
+    }
+  }
+
+  scoped_alloc_tag(const scoped_alloc_tag&) = delete;
+  scoped_alloc_tag& operator=(const scoped_alloc_tag&) = delete;
+
+private:
+  alloc_tag m_prev = alloc_tag::other;
+};
+
+struct alloc_profiler
+{
+  static constexpr size_t tags_cnt = static_cast<size_t>(alloc_tag::count_);
+
+  // bucket i counts sizes in [2^(i-1), 2^i), the first one is for 0 and
+  // the last one is unbounded
+  static constexpr size_t buckets_cnt = 32;
+
+  static constexpr size_t max_frames = 16;
+
+  struct tag_stats
+  {
+    uint64_t allocs = 0;
+    uint64_t bytes = 0;
+    std::array<uint64_t, buckets_cnt> sizes = {};
+
+    // size under which ratio of the allocations are (bucket upper bound)
+    uint64_t size_percentile(double ratio) const;
+  };
+
+  struct stack_sample
+  {
+    alloc_tag tag = alloc_tag::other;
+    uint32_t frames_cnt = 0;
+    std::array<void*, max_frames> frames = {};
+    uint64_t count = 0; // sampled allocations
+    uint64_t bytes = 0;
+  };
+
+  struct snapshot
+  {
+    std::array<tag_stats, tags_cnt> tags = {};
+    uint64_t frees = 0;
+    uint64_t freed_bytes = 0; // only if the program passes the sizes to profile_free
+    uint64_t dropped_samples = 0; // the stack table was full
+    uint32_t sample_interval = 0;
+    std::vector<stack_sample> stacks; // sorted by count
+  };
+
+  static alloc_profiler& get();
+
+  // 0 disables stack capture
+  void set_sample_interval(uint32_t interval);
+
+  void record_alloc(size_t size);
+  void record_free(size_t size);
+
+  snapshot take_snapshot() const;
+  void reset();
+
+  // text report of a snapshot, with its top_n stacks
+  static std::string report(const snapshot& snap, size_t top_n = 20);
+
+  static const char* tag_name(alloc_tag tag);
+};
+
+inline void profile_alloc(size_t size)
+{
+  if constexpr (alloc_profiler_compiled)
+  {
+    alloc_profiler::get().record_alloc(size);
+  }
+}
+
+// size is 0 if unknown
+inline void profile_free(size_t size)
+{
+  if constexpr (alloc_profiler_compiled)
+  {
+    alloc_profiler::get().record_free(size);
+  }
+}
+
+} // namespace cp
+
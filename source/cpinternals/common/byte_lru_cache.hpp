@@ -0,0 +1,173 @@
+#pragma once
+#include <inttypes.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace cp {
+
+// Byte-budgeted LRU cache of shared byte buffers (see segment_cache and
+// file_block_cache for the keys).
+// Thread-safe, buffers are shared so evicted ones stay valid for readers
+// that still own them.
+template <typename Key, typename KeyHash = std::hash<Key>>
+class byte_lru_cache
+{
+public:
+  using key_type = Key;
+  using buffer_type = std::shared_ptr<const std::vector<char>>;
+
+  struct stats
+  {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t   entries_cnt = 0;
+    size_t   bytes = 0;
+  };
+
+  explicit byte_lru_cache(size_t budget)
+    : m_budget(budget) {}
+
+  byte_lru_cache(const byte_lru_cache&) = delete;
+  byte_lru_cache& operator=(const byte_lru_cache&) = delete;
+
+  // 0 disables caching
+  void set_budget(size_t budget)
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_budget = budget;
+    trim();
+  }
+
+  size_t budget() const
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_budget;
+  }
+
+  // returns nullptr on miss
+  buffer_type find(const key_type& key)
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    auto it = m_map.find(key);
+    if (it == m_map.end())
+    {
+      ++m_stats.misses;
+      return nullptr;
+    }
+
+    ++m_stats.hits;
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    return it->second->buffer;
+  }
+
+  // doesn't count as a hit or miss
+  bool contains(const key_type& key) const
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_map.find(key) != m_map.end();
+  }
+
+  // if the key is already cached (concurrent misses of the same key) the
+  // first buffer is kept
+  void insert(const key_type& key, const buffer_type& buffer)
+  {
+    if (!buffer)
+      return;
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    if (buffer->size() > m_budget)
+      return;
+
+    auto it = m_map.find(key);
+    if (it != m_map.end())
+    {
+      m_lru.splice(m_lru.begin(), m_lru, it->second);
+      return;
+    }
+
+    m_lru.push_front(entry{key, buffer});
+    m_map.emplace(key, m_lru.begin());
+    m_stats.bytes += buffer->size();
+    trim();
+  }
+
+  // erases the entries whose key matches pred, not counted as evictions
+  template <typename Pred>
+  void erase_if(Pred&& pred)
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    for (auto it = m_lru.begin(); it != m_lru.end(); /**/)
+    {
+      if (pred(it->key))
+      {
+        m_stats.bytes -= it->buffer->size();
+        m_map.erase(it->key);
+        it = m_lru.erase(it);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+  }
+
+  void clear()
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_map.clear();
+    m_lru.clear();
+    m_stats.bytes = 0;
+  }
+
+  stats get_stats() const
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    stats ret = m_stats;
+    ret.entries_cnt = m_map.size();
+    return ret;
+  }
+
+  void reset_counters()
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_stats.hits = 0;
+    m_stats.misses = 0;
+    m_stats.evictions = 0;
+  }
+
+protected:
+  struct entry
+  {
+    key_type    key;
+    buffer_type buffer;
+  };
+
+  // called with the lock held
+  void trim()
+  {
+    while (m_stats.bytes > m_budget && !m_lru.empty())
+    {
+      auto& e = m_lru.back();
+      m_stats.bytes -= e.buffer->size();
+      m_map.erase(e.key);
+      m_lru.pop_back();
+      ++m_stats.evictions;
+    }
+  }
+
+  mutable std::mutex m_mtx;
+  size_t m_budget;
+  std::list<entry> m_lru; // most recently used first
+  std::unordered_map<key_type, typename std::list<entry>::iterator, KeyHash> m_map;
+  stats m_stats;
+};
+
+} // namespace cp
+
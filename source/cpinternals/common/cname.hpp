@@ -1,12 +1,21 @@
 #pragma once
 #include <inttypes.h>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 #include <spdlog/spdlog.h>
 #include <cpinternals/common/streambase.hpp>
 #include <cpinternals/common/gstrid.hpp>
 #include <cpinternals/common/gname.hpp>
+#include <cpinternals/common/sorted_names_list.hpp>
 
 namespace cp {
 
@@ -31,9 +40,10 @@ struct cname
   
     if (ar.is_reader())
     {
-      std::string s;
+      // reused, bulk reads (e.g. tweakdb pools) don't allocate per name
+      thread_local std::string s;
       ar << s;
-      cn = cname(s);
+      cn = hash_first(s);
     }
     else
     {
@@ -52,9 +62,28 @@ struct cname
     return ar;
   }
 
+  // hash-first construction for parsers: the string is only interned if
+  // cname_db can't resolve its hash already, known names (e.g. from the
+  // compiled names db) don't write to the string pool. strings are resolved
+  // lazily by gstr() when displayed or written out.
+  static cname hash_first(std::string_view s, uint64_t hash);
+
+  static cname hash_first(std::string_view s)
+  {
+    return hash_first(s, fnv1a64(s));
+  }
+
+  // resolved by cname_db (see find)
+  std::optional<gname> gstr_opt() const;
+
+  gname gstr() const
+  {
+    return gstr_opt().value_or(gname());
+  }
+
   std::string string() const
   {
-    auto gn = gname();
+    auto gn = gstr();
 
     if (!gn)
     {
@@ -67,10 +96,96 @@ struct cname
 
 static_assert(sizeof(cname) == 8);
 
+//--------------------------------------------------------
+//  hash -> name table
+//
+// built at once from precomputed hashes (compiled names dbs), immutable
+// afterwards so that lookups don't lock.
+// open addressing (linear probing), load factor under 1/2.
+
+struct cname_table
+{
+  cname_table(const cname_table* base, std::span<const gname> names, std::span<const uint64_t> hashes)
+  {
+    size_t cnt = names.size() + (base ? base->size() : 0);
+    size_t capacity = 16;
+    while (capacity < cnt * 2)
+    {
+      capacity *= 2;
+    }
+    m_slots.resize(capacity);
+
+    if (base)
+    {
+      for (const auto& slot : base->m_slots)
+      {
+        if (slot.hash)
+          insert(slot.hash, slot.name);
+      }
+    }
+
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+      insert(hashes[i], names[i]);
+    }
+  }
+
+  size_t size() const
+  {
+    return m_cnt;
+  }
+
+  std::optional<gname> find(uint64_t hash) const
+  {
+    if (!hash)
+      return std::nullopt;
+
+    const size_t mask = m_slots.size() - 1;
+    for (size_t i = static_cast<size_t>(hash) & mask; m_slots[i].hash; i = (i + 1) & mask)
+    {
+      if (m_slots[i].hash == hash)
+        return m_slots[i].name;
+    }
+    return std::nullopt;
+  }
+
+protected:
+  struct slot
+  {
+    uint64_t hash = 0; // 0 if empty
+    gname name;
+  };
+
+  void insert(uint64_t hash, gname name)
+  {
+    if (!hash)
+      return;
+
+    const size_t mask = m_slots.size() - 1;
+    size_t i = static_cast<size_t>(hash) & mask;
+    while (m_slots[i].hash && m_slots[i].hash != hash)
+    {
+      i = (i + 1) & mask;
+    }
+
+    if (!m_slots[i].hash)
+      ++m_cnt;
+    m_slots[i] = slot{hash, name};
+  }
+
+  std::vector<slot> m_slots;
+  size_t m_cnt = 0;
+};
+
 //--------------------------------------------------------
 //  database: sorted names
 //  mainly for imgui combo boxes..
 //  can be removed when the combo box is reworked properly
+//
+// also resolves hashes, through the precomputed table first.
+// lookups are lock-free (the table, then the sharded pool), the sorted
+// list can be read while concurrent loads register names (see
+// sorted_names_list).
 
 struct cname_db
 {
@@ -95,7 +210,22 @@ struct cname_db
 
   bool is_registered(uint64_t hash) const
   {
-    return gname::find(hash).has_value();
+    return find(hash).has_value();
+  }
+
+  // lock-free for the names fed with their hashes, the global pool is
+  // searched otherwise
+  std::optional<gname> find(uint64_t hash) const
+  {
+    const cname_table* table = m_table.load(std::memory_order_acquire);
+    if (table)
+    {
+      auto name = table->find(hash);
+      if (name)
+        return name;
+    }
+
+    return gname::find(hash);
   }
 
   //bool is_registered_32(uint32_t hash) const
@@ -105,9 +235,7 @@ struct cname_db
 
   void register_str(gname name)
   {
-    auto p = insert_sorted_nodupe(m_full_list, name);
-    if (!p.second)
-      return;
+    m_full_list.insert(name);
   }
 
   void register_str(std::string_view name)
@@ -123,20 +251,60 @@ struct cname_db
   //  return gname();
   //}
 
-  const std::vector<gname>& sorted_names() const
+  // get() gives a snapshot of the list
+  const sorted_names_list& sorted_names() const
   {
     return m_full_list;
   }
 
-  void feed(const std::vector<gname>& names)
+  void reserve(size_t cnt)
   {
-    m_full_list.reserve(m_full_list.size() + names.size());
-    auto hint = m_full_list.begin(); // names must be pre-sorted
-    for (auto& name : names)
-    {
-      auto p = insert_sorted_nodupe(m_full_list, hint, name);
-      hint = p.first;
-    }
+    m_full_list.reserve(cnt);
+  }
+
+  // registers all names at once (one lock per pool shard)
+  void register_strs(std::span<const std::string_view> names)
+  {
+    feed(gname::register_strings(names));
+  }
+
+  // names don't need to be sorted
+  void feed(std::span<const gname> names)
+  {
+    // single merge instead of sorted insertions
+    m_full_list.merge(std::vector<gname>(names.begin(), names.end()));
+  }
+
+  // names with their precomputed fnv1a64 hashes (e.g. from a compiled names
+  // db), which are also added to the lock-free table
+  void feed(std::span<const gname> names, std::span<const uint64_t> hashes)
+  {
+    feed(names);
+
+    if (names.size() != hashes.size())
+      return;
+
+    // tables are retained, lookups may still use the previous one
+    std::lock_guard<std::mutex> lock(m_tables_mtx);
+    const cname_table* base = m_table.load(std::memory_order_relaxed);
+    const cname_table* table = m_tables.emplace_back(std::make_unique<cname_table>(base, names, hashes)).get();
+    m_table.store(table, std::memory_order_release);
+  }
+
+  // replaces the list with names already sorted and unique (see
+  // sorted_names and startup_snapshot.hpp), their hashes all go to the
+  // lock-free table
+  void adopt_sorted(std::vector<gname> names, std::span<const uint64_t> hashes)
+  {
+    if (names.size() != hashes.size())
+      return;
+
+    std::lock_guard<std::mutex> lock(m_tables_mtx);
+    const cname_table* base = m_table.load(std::memory_order_relaxed);
+    const cname_table* table = m_tables.emplace_back(std::make_unique<cname_table>(base, names, hashes)).get();
+    m_table.store(table, std::memory_order_release);
+
+    m_full_list.assign(std::move(names));
   }
 
 protected:
@@ -150,9 +318,29 @@ protected:
     size_t operator()(uint32_t key) const { return key; }
   };
 
-  std::vector<gname> m_full_list;
+  sorted_names_list m_full_list;
   //std::unordered_map<uint32_t, gname, identity_op_32> m_invmap_32;
+
+  std::atomic<const cname_table*> m_table = nullptr;
+  std::mutex m_tables_mtx;
+  std::deque<std::unique_ptr<cname_table>> m_tables;
 };
 
+inline cname cname::hash_first(std::string_view s, uint64_t hash)
+{
+  if (!cname_db::get().is_registered(hash))
+  {
+    // unknown names must stay resolvable, their source is transient
+    nc_gpool().register_string(s, hash);
+  }
+
+  return cname(hash);
+}
+
+inline std::optional<gname> cname::gstr_opt() const
+{
+  return cname_db::get().find(hash);
+}
+
 } // namespace cp
 
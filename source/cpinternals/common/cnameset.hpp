@@ -3,11 +3,11 @@
 #include <optional>
 #include <vector>
 #include <array>
-#include <unordered_map>
 
 #include <cpinternals/common/cname.hpp>
 #include <cpinternals/common/streambase.hpp>
 #include <cpinternals/common/hashing.hpp>
+#include <cpinternals/common/hash_index.hpp>
 #include <cpinternals/common/utils.hpp>
 #include <cpinternals/common/stringpoolsb.hpp>
 
@@ -79,7 +79,7 @@ struct cnameset
     {
       idx = static_cast<uint32_t>(m_ids.size());
       m_ids.emplace_back(cn);
-      m_idxmap.emplace(cn, idx);
+      m_idxmap.emplace(cn.hash, idx);
     }
 
     return idx;
@@ -99,13 +99,7 @@ struct cnameset
 
   uint32_t find(cname cn) const
   {
-    auto it = m_idxmap.find(cn);
-    if (it != m_idxmap.end())
-    {
-      return it->second;
-    }
-
-    return (uint32_t)-1;
+    return m_idxmap.find(cn.hash).value_or((uint32_t)-1);
   }
 
   uint32_t find(uint64_t hash) const
@@ -156,12 +150,15 @@ struct cnameset
       return;
     }
 
+    m_ids.reserve(sp.size());
+    m_idxmap.reserve(sp.size());
+
     uint32_t idx = 0;
     for (uint32_t i = 0; i < sp.size(); ++i)
     {
       cname cn(sp.at(i));
       m_ids.emplace_back(cn);
-      m_idxmap.emplace(cn, idx++);
+      m_idxmap.emplace(cn.hash, idx++);
     }
   }
 
@@ -200,11 +197,8 @@ protected:
 
   container_type m_ids;
 
-  struct identity_op {
-    size_t operator()(const cname& key) const { return key.hash; }
-  };
-
-  std::unordered_map<cname, uint32_t, identity_op> m_idxmap;
+  // key: cname hash
+  hash_index m_idxmap;
 };
 
 } // namespace cp
@@ -1,5 +1,6 @@
 #pragma once
 #include "stringpool.hpp"
+#include "stringpool_sharded.hpp"
 #include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
 
@@ -17,9 +18,9 @@ namespace detail {
 template <uint32_t PoolTag>
 struct gstringpool
 {
-  static stringpool_mt& get()
+  static stringpool_sharded& get()
   {
-    static stringpool_mt instance;
+    static stringpool_sharded instance;
     static bool once = [](){
 
       const uint32_t pooltag = PoolTag;
@@ -89,6 +90,38 @@ struct gstring
     return gstring(nc_gpool().register_string(s, hash).second);
   }
 
+  // registers all strings at once (hashes are computed in batch)
+  static std::vector<gstring> register_strings(std::span<const std::string_view> svs)
+  {
+    std::vector<uint32_t> indices(svs.size());
+    nc_gpool().register_strings(svs, indices);
+
+    std::vector<gstring> ret;
+    ret.reserve(indices.size());
+    for (uint32_t idx : indices)
+    {
+      ret.emplace_back(gstring(idx));
+    }
+    return ret;
+  }
+
+  // same with precomputed hashes, see stringpool::register_strings.
+  // strings with static storage duration must be null-terminated (see c_str).
+  static std::vector<gstring> register_strings(std::span<const std::string_view> svs,
+    std::span<const uint64_t> hashes, bool svs_have_static_storage_duration)
+  {
+    std::vector<uint32_t> indices(svs.size());
+    nc_gpool().register_strings(svs, hashes, indices, svs_have_static_storage_duration);
+
+    std::vector<gstring> ret;
+    ret.reserve(indices.size());
+    for (uint32_t idx : indices)
+    {
+      ret.emplace_back(gstring(idx));
+    }
+    return ret;
+  }
+
   // Returned string_view has static storage duration
   std::string_view strv() const
   {
@@ -125,9 +158,10 @@ struct gstring
     return std::nullopt;
   }
 
-  static void pool_reserve(size_t cnt)
+  // cnt strings, and optionally "bytes" bytes of string copies (null terminators included)
+  static void pool_reserve(size_t cnt, size_t bytes = 0)
   {
-    nc_gpool().reserve(cnt);
+    nc_gpool().reserve(cnt, bytes);
   }
 
   //static const stringpool& gpool()
@@ -143,7 +177,7 @@ private:
   explicit gstring(uint32_t idx) noexcept
     : m_idx(idx) {}
 
-  static stringpool_mt& nc_gpool()
+  static stringpool_sharded& nc_gpool()
   {
     return detail::gstringpool<pool_tag>::get();
   }
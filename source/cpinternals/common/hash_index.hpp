@@ -0,0 +1,156 @@
+#pragma once
+#include <inttypes.h>
+#include <optional>
+#include <vector>
+#include <bit>
+#include <intrin.h>
+
+namespace cp {
+
+// hash -> index flat table for containers keyed by fnv1a64 hashes.
+// the hashes are uniform enough to be used as is: low bits pick a group of
+// 16 slots, high bits are kept as a 7-bit tag per slot. a probe compares
+// the 16 tags of a group at once (sse2) and only reads the full hashes of
+// matching slots.
+// there is no erase, load factor is kept under 7/8.
+struct hash_index
+{
+  constexpr static size_t group_size = 16;
+
+  hash_index() = default;
+
+  size_t size() const
+  {
+    return m_size;
+  }
+
+  void clear()
+  {
+    m_ctrls.clear();
+    m_slots.clear();
+    m_size = 0;
+  }
+
+  void reserve(size_t cnt)
+  {
+    size_t groups_cnt = 1;
+    while (groups_cnt * group_size * 7 < cnt * 8)
+    {
+      groups_cnt *= 2;
+    }
+
+    if (groups_cnt * group_size > m_slots.size())
+    {
+      rehash(groups_cnt);
+    }
+  }
+
+  // returns false if hash was already present (its index is kept)
+  bool emplace(uint64_t hash, uint32_t idx)
+  {
+    if ((m_size + 1) * 8 > m_slots.size() * 7)
+    {
+      rehash(m_slots.size() ? m_slots.size() / group_size * 2 : 1);
+    }
+
+    if (find(hash).has_value())
+    {
+      return false;
+    }
+
+    insert_unique(hash, idx);
+    ++m_size;
+    return true;
+  }
+
+  std::optional<uint32_t> find(uint64_t hash) const
+  {
+    if (m_slots.empty())
+    {
+      return std::nullopt;
+    }
+
+    const __m128i tag = _mm_set1_epi8(static_cast<char>(tag_of(hash)));
+    const __m128i empty = _mm_set1_epi8(static_cast<char>(empty_ctrl));
+    const size_t groups_mask = m_slots.size() / group_size - 1;
+
+    for (size_t g = static_cast<size_t>(hash) & groups_mask; ; g = (g + 1) & groups_mask)
+    {
+      const __m128i ctrls = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_ctrls.data() + g * group_size));
+
+      uint32_t matches = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrls, tag)));
+      while (matches)
+      {
+        const auto& slot = m_slots[g * group_size + std::countr_zero(matches)];
+        if (slot.hash == hash)
+        {
+          return slot.idx;
+        }
+        matches &= matches - 1;
+      }
+
+      // an empty slot ends the probe sequence
+      if (_mm_movemask_epi8(_mm_cmpeq_epi8(ctrls, empty)))
+      {
+        return std::nullopt;
+      }
+    }
+  }
+
+protected:
+
+  // tags have their high bit cleared, empty slots have it set
+  constexpr static uint8_t empty_ctrl = 0x80;
+
+  struct slot
+  {
+    uint64_t hash;
+    uint32_t idx;
+  };
+
+  static uint8_t tag_of(uint64_t hash)
+  {
+    return static_cast<uint8_t>(hash >> 57);
+  }
+
+  void insert_unique(uint64_t hash, uint32_t idx)
+  {
+    const size_t groups_mask = m_slots.size() / group_size - 1;
+
+    for (size_t g = static_cast<size_t>(hash) & groups_mask; ; g = (g + 1) & groups_mask)
+    {
+      for (size_t i = g * group_size; i < (g + 1) * group_size; ++i)
+      {
+        if (m_ctrls[i] == empty_ctrl)
+        {
+          m_ctrls[i] = tag_of(hash);
+          m_slots[i] = slot{hash, idx};
+          return;
+        }
+      }
+    }
+  }
+
+  void rehash(size_t groups_cnt)
+  {
+    std::vector<uint8_t> old_ctrls(groups_cnt * group_size, empty_ctrl);
+    std::vector<slot> old_slots(groups_cnt * group_size);
+    old_ctrls.swap(m_ctrls);
+    old_slots.swap(m_slots);
+
+    for (size_t i = 0; i < old_slots.size(); ++i)
+    {
+      if (old_ctrls[i] != empty_ctrl)
+      {
+        insert_unique(old_slots[i].hash, old_slots[i].idx);
+      }
+    }
+  }
+
+  std::vector<uint8_t> m_ctrls;
+  std::vector<slot> m_slots;
+  size_t m_size = 0;
+};
+
+} // namespace cp
+
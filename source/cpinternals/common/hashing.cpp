@@ -0,0 +1,332 @@
+#include <cpinternals/common/hashing.hpp>
+#include <cassert>
+#include <intrin.h>
+#include <utility>
+#include <cpinternals/common/parallel.hpp>
+
+namespace cp::detail {
+
+// The kernels fold 16-byte blocks of the (reflected) message into 4
+// accumulators, then into 1, and finish the last 16 bytes with the tables.
+// The state is xored into the first block, what is left is the message
+// polynomial of the folded prefix (mod P) so the tables start from 0.
+// Only the folding constants depend on the polynomial.
+
+namespace {
+
+// x^n mod poly, coefficient of x^m at bit m
+template <typename T>
+constexpr T xpow_mod(size_t n, T poly)
+{
+  constexpr T top = T(1) << (sizeof(T) * 8 - 1);
+
+  T r = 1;
+  for (size_t i = 0; i < n; ++i)
+  {
+    const bool carry = (r & top) != 0;
+    r <<= 1;
+    if (carry)
+      r ^= poly;
+  }
+  return r;
+}
+
+// coefficient of x^m at bit 63 - m, as in loaded message qwords
+constexpr uint64_t reflect64(uint64_t v)
+{
+  uint64_t r = 0;
+  for (size_t i = 0; i < 64; ++i)
+  {
+    r = (r << 1) | (v & 1);
+    v >>= 1;
+  }
+  return r;
+}
+
+// a block is moved dist bits forward by multiplying its high-degree qword
+// (the low one) by x^(dist + 64) and the other by x^dist. the product of
+// two reflected qwords comes out multiplied by x, hence the - 1.
+template <typename T>
+__m128i fold_consts(size_t dist, T poly)
+{
+  return _mm_set_epi64x(
+    (int64_t)reflect64(xpow_mod<T>(dist - 1, poly)),
+    (int64_t)reflect64(xpow_mod<T>(dist + 63, poly)));
+}
+
+inline __m128i fold(__m128i x, __m128i k, __m128i next)
+{
+  const __m128i lo = _mm_clmulepi64_si128(x, k, 0x00);
+  const __m128i hi = _mm_clmulepi64_si128(x, k, 0x11);
+  return _mm_xor_si128(_mm_xor_si128(lo, hi), next);
+}
+
+inline __m128i load(const uint8_t* p)
+{
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+// len must be >= 64
+template <typename T, typename Lut>
+T crc_update_clmul(T x, const uint8_t* p, size_t len, __m128i k512, __m128i k128, const Lut& lut)
+{
+  __m128i x0 = _mm_xor_si128(load(p), _mm_cvtsi64_si128((int64_t)x));
+  __m128i x1 = load(p + 16);
+  __m128i x2 = load(p + 32);
+  __m128i x3 = load(p + 48);
+  p += 64;
+  len -= 64;
+
+  while (len >= 64)
+  {
+    x0 = fold(x0, k512, load(p));
+    x1 = fold(x1, k512, load(p + 16));
+    x2 = fold(x2, k512, load(p + 32));
+    x3 = fold(x3, k512, load(p + 48));
+    p += 64;
+    len -= 64;
+  }
+
+  x0 = fold(x0, k128, x1);
+  x0 = fold(x0, k128, x2);
+  x0 = fold(x0, k128, x3);
+
+  while (len >= 16)
+  {
+    x0 = fold(x0, k128, load(p));
+    p += 16;
+    len -= 16;
+  }
+
+  alignas(16) uint8_t folded[16];
+  _mm_store_si128(reinterpret_cast<__m128i*>(folded), x0);
+
+  T r = 0;
+  for (const uint8_t c : folded)
+  {
+    r = (r >> 8) ^ lut[static_cast<uint8_t>(r ^ c)];
+  }
+  while (len--)
+  {
+    r = (r >> 8) ^ lut[static_cast<uint8_t>(r ^ *p++)];
+  }
+  return r;
+}
+
+constexpr uint32_t crc32_poly = 0x04C11DB7;
+constexpr uint64_t crc64_poly = 0x42F0E1EBA9EA3693;
+
+} // namespace
+
+bool has_crc_clmul()
+{
+  static const bool supported = []() {
+    int regs[4] = {};
+    __cpuid(regs, 1);
+    return (regs[2] & (1 << 1)) != 0; // ecx.PCLMULQDQ
+  }();
+  return supported;
+}
+
+uint32_t crc32_update_clmul(uint32_t x, const void* data, size_t len)
+{
+  static const __m128i k512 = fold_consts<uint32_t>(512, crc32_poly);
+  static const __m128i k128 = fold_consts<uint32_t>(128, crc32_poly);
+  return crc_update_clmul<uint32_t>(x, static_cast<const uint8_t*>(data), len, k512, k128, crc32::s8lut[0]);
+}
+
+uint64_t crc64_update_clmul(uint64_t x, const void* data, size_t len)
+{
+  static const __m128i k512 = fold_consts<uint64_t>(512, crc64_poly);
+  static const __m128i k128 = fold_consts<uint64_t>(128, crc64_poly);
+  return crc_update_clmul<uint64_t>(x, static_cast<const uint8_t*>(data), len, k512, k128, crc64::s8lut[0]);
+}
+
+} // namespace cp::detail
+
+namespace cp::detail::sha1 {
+
+namespace {
+
+// one group of 4 rounds, I in [0, 20).
+// m holds the last 4 message groups, the group I is computed in place of
+// I - 4. e_prev is abcd before the previous group (e is derived from it).
+template <size_t I>
+inline void sha_ni_rounds4(__m128i& abcd, __m128i& e_prev, __m128i (&m)[4])
+{
+  if constexpr (I >= 4)
+  {
+    m[I % 4] = _mm_sha1msg2_epu32(
+      _mm_xor_si128(_mm_sha1msg1_epu32(m[I % 4], m[(I + 1) % 4]), m[(I + 2) % 4]),
+      m[(I + 3) % 4]);
+  }
+
+  const __m128i e = (I == 0)
+    ? _mm_add_epi32(e_prev, m[0])
+    : _mm_sha1nexte_epu32(e_prev, m[I % 4]);
+
+  e_prev = abcd;
+  abcd = _mm_sha1rnds4_epu32(abcd, e, I / 5);
+}
+
+template <size_t... Is>
+inline void sha_ni_rounds(__m128i& abcd, __m128i& e_prev, __m128i (&m)[4], std::index_sequence<Is...>)
+{
+  (sha_ni_rounds4<Is>(abcd, e_prev, m), ...);
+}
+
+} // namespace
+
+bool has_sha_ni()
+{
+  static const bool supported = []() {
+    int regs[4] = {};
+    __cpuid(regs, 0);
+    if (regs[0] < 7)
+      return false;
+    __cpuidex(regs, 7, 0);
+    return (regs[1] & (1 << 29)) != 0; // ebx.SHA
+  }();
+  return supported;
+}
+
+void transform_sha_ni(uint32_t digest[5], const uint8_t* blocks, size_t blocks_cnt)
+{
+  // message words are big-endian
+  const __m128i bswap_mask = _mm_set_epi64x(0x0001020304050607, 0x08090A0B0C0D0E0F);
+
+  // a in the highest lane
+  __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(digest)), 0x1B);
+  __m128i e0 = _mm_set_epi32((int)digest[4], 0, 0, 0);
+
+  for (size_t i = 0; i < blocks_cnt; ++i, blocks += 64)
+  {
+    const __m128i abcd_save = abcd;
+    const __m128i e0_save = e0;
+
+    __m128i m[4];
+    for (size_t j = 0; j < 4; ++j)
+    {
+      m[j] = _mm_shuffle_epi8(load(blocks + j * 16), bswap_mask);
+    }
+
+    __m128i e_prev = e0;
+    sha_ni_rounds(abcd, e_prev, m, std::make_index_sequence<20>());
+
+    e0 = _mm_sha1nexte_epu32(e_prev, e0_save);
+    abcd = _mm_add_epi32(abcd, abcd_save);
+  }
+
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(digest), _mm_shuffle_epi32(abcd, 0x1B));
+  digest[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+}
+
+} // namespace cp::detail::sha1
+
+namespace cp {
+
+// Batches are hashed a string at a time: the strings are independent so
+// the cpu already overlaps their multiply chains. Lane-interleaved kernels
+// (scalar or AVX2, which has no 64-bit multiply for fnv1a64) were slower on
+// names tables because of the uneven lengths. Same for crc32 (4 interleaved
+// slicing-by-8 lanes), and the crc32c instruction uses another polynomial.
+// Big batches use the threads.
+
+namespace {
+
+constexpr size_t batch_parallel_min_cnt = 0x10000;
+constexpr size_t batch_chunk_cnt = 0x4000;
+
+template <typename Fn>
+void for_each_in_batch(size_t cnt, Fn&& fn)
+{
+  if (cnt < batch_parallel_min_cnt)
+  {
+    for (size_t i = 0; i < cnt; ++i)
+    {
+      fn(i);
+    }
+    return;
+  }
+
+  const size_t chunks_cnt = (cnt + batch_chunk_cnt - 1) / batch_chunk_cnt;
+  parallel_for(chunks_cnt, 0, [&](size_t chunk)
+  {
+    const size_t end = std::min(cnt, (chunk + 1) * batch_chunk_cnt);
+    for (size_t i = chunk * batch_chunk_cnt; i < end; ++i)
+    {
+      fn(i);
+    }
+  });
+}
+
+// chunk crcs only depend on their bytes (all but the first are hashed from
+// seed 0), they are joined in order with combine. combines of long chunks
+// take the gf2 matrix path, a few microseconds each.
+template <typename UIntType, typename HashFn, typename CombineFn>
+UIntType crc_parallel(const char* const data, size_t len, UIntType seed, size_t workers_cnt, HashFn&& hash, CombineFn&& combine)
+{
+  if (len < detail::crc_parallel_min_len)
+  {
+    return hash(data, len, seed);
+  }
+
+  workers_cnt = resolve_workers_count(workers_cnt, len / detail::crc_parallel_min_chunk_len);
+  if (workers_cnt == 1)
+  {
+    return hash(data, len, seed);
+  }
+
+  // one chunk per worker, 64-byte multiples for the clmul kernels
+  const size_t chunk_len = ((len + workers_cnt - 1) / workers_cnt + 63) & ~size_t(63);
+  const size_t chunks_cnt = (len + chunk_len - 1) / chunk_len;
+
+  std::vector<UIntType> crcs(chunks_cnt);
+  parallel_for(chunks_cnt, workers_cnt, [&](size_t i)
+  {
+    const size_t offset = i * chunk_len;
+    crcs[i] = hash(data + offset, std::min(chunk_len, len - offset), i ? UIntType(0) : seed);
+  });
+
+  UIntType crc = crcs[0];
+  for (size_t i = 1; i < chunks_cnt; ++i)
+  {
+    const size_t offset = i * chunk_len;
+    crc = combine(crc, crcs[i], std::min(chunk_len, len - offset));
+  }
+
+  return crc;
+}
+
+} // namespace
+
+uint32_t crc32_parallel(const char* const data, size_t len, uint32_t seed, size_t workers_cnt)
+{
+  return crc_parallel<uint32_t>(data, len, seed, workers_cnt, crc32_bigdata, crc32_combine);
+}
+
+uint64_t crc64_parallel(const char* const data, size_t len, uint64_t seed, size_t workers_cnt)
+{
+  return crc_parallel<uint64_t>(data, len, seed, workers_cnt, crc64_bigdata, crc64_combine);
+}
+
+void fnv1a64_batch(std::span<const std::string_view> strs, std::span<uint64_t> out)
+{
+  assert(out.size() >= strs.size());
+  for_each_in_batch(strs.size(), [&](size_t i) { out[i] = fnv1a64(strs[i]); });
+}
+
+void crc32_str_batch(std::span<const std::string_view> strs, std::span<uint32_t> out, uint32_t seed)
+{
+  assert(out.size() >= strs.size());
+  for_each_in_batch(strs.size(), [&](size_t i) { out[i] = crc32_bigdata(strs[i].data(), strs[i].size(), seed); });
+}
+
+void murmur3_32_batch(std::span<const std::string_view> strs, std::span<uint32_t> out, uint32_t seed)
+{
+  assert(out.size() >= strs.size());
+  for_each_in_batch(strs.size(), [&](size_t i) { out[i] = murmur3_32(strs[i], seed); });
+}
+
+} // namespace cp
+
@@ -1,6 +1,7 @@
 #pragma once
 #include <inttypes.h>
 #include <array>
+#include <span>
 #include <string>
 #include <string_view>
 #include <cpinternals/common/utils.hpp>
@@ -8,6 +9,24 @@
 
 namespace cp {
 
+namespace detail {
+
+// carry-less multiplication (x86 PCLMULQDQ) kernels of the builders, see
+// hashing.cpp. they take and return the running state of the builder.
+bool has_crc_clmul();
+uint32_t crc32_update_clmul(uint32_t x, const void* data, size_t len);
+uint64_t crc64_update_clmul(uint64_t x, const void* data, size_t len);
+
+// shorter inputs are faster with the tables
+inline constexpr size_t crc_clmul_min_len = 64;
+
+// shorter inputs aren't worth waking threads for (see crc64_parallel),
+// chunks are at least crc_parallel_min_chunk_len long
+inline constexpr size_t crc_parallel_min_len = 0x100000;
+inline constexpr size_t crc_parallel_min_chunk_len = 0x40000;
+
+} // namespace detail
+
 //--------------------------------------------------------
 //  CRC32 (poly:0x04C11DB7, reflected:0xEDB88320)
 
@@ -23,6 +42,12 @@ struct crc32_builder
   void update(const void* data, size_t len)
   {
     using detail::crc32::s8lut;
+
+    if (len >= detail::crc_clmul_min_len && detail::has_crc_clmul())
+    {
+      m_x = detail::crc32_update_clmul(m_x, data, len);
+      return;
+    }
   
     uint32_t x = m_x;
 
@@ -90,6 +115,10 @@ constexpr uint32_t crc32_str(std::string_view s, uint32_t seed = 0)
   return crc32(s.data(), s.size(), seed);
 }
 
+// out[i] = crc32_str(strs[i], seed), same as fnv1a64_batch. hashed with the
+// slicing tables (crc32_str, being constexpr, goes a byte at a time).
+void crc32_str_batch(std::span<const std::string_view> strs, std::span<uint32_t> out, uint32_t seed = 0);
+
 constexpr uint32_t operator""_crc32(const char* const str, std::size_t len)
 {
   return crc32_str(std::string_view(str, len));
@@ -193,6 +222,11 @@ constexpr uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, size_t len2)
   return x ^ crc2;
 }
 
+// same as crc32_bigdata, inputs of at least crc_parallel_min_len bytes are
+// split into chunks hashed on worker threads whose crcs are joined with
+// crc32_combine. 0 workers means one per hardware thread.
+uint32_t crc32_parallel(const char* const data, size_t len, uint32_t seed = 0, size_t workers_cnt = 0);
+
 //--------------------------------------------------------
 //  CRC64 (poly:0x42F0E1EBA9EA3693, reflected:0xC96C5795D7870F42)
 
@@ -208,6 +242,12 @@ struct crc64_builder
   void update(const void* data, size_t len)
   {
     using detail::crc64::s8lut;
+
+    if (len >= detail::crc_clmul_min_len && detail::has_crc_clmul())
+    {
+      m_x = detail::crc64_update_clmul(m_x, data, len);
+      return;
+    }
   
     uint64_t x = m_x;
 
@@ -353,6 +393,9 @@ constexpr uint64_t crc64_combine(uint64_t crc1, uint64_t crc2, size_t len2)
   return x ^ crc2;
 }
 
+// same as crc32_parallel
+uint64_t crc64_parallel(const char* const data, size_t len, uint64_t seed = 0, size_t workers_cnt = 0);
+
 //--------------------------------------------------------
 //  FNV1A32
 
@@ -397,6 +440,16 @@ constexpr uint64_t fnv1a64_continue(uint64_t hash, std::string_view str)
   return hash;
 }
 
+constexpr uint64_t fnv1a64_continue(uint64_t hash, char c)
+{
+  constexpr uint64_t prime = 0x00000100000001B3;
+
+  hash ^= c;
+  hash *= prime;
+
+  return hash;
+}
+
 constexpr uint64_t fnv1a64(std::string_view str)
 {
   constexpr uint64_t basis = 0xCBF29CE484222325;
@@ -409,6 +462,10 @@ constexpr uint64_t operator""_fnv1a64(const char* const str, std::size_t len)
   return fnv1a64(std::string_view(str, len));
 }
 
+// out[i] = fnv1a64(strs[i]), out must be as long as strs.
+// big batches (names tables) are split over worker threads, see hashing.cpp.
+void fnv1a64_batch(std::span<const std::string_view> strs, std::span<uint64_t> out);
+
 
 
 //--------------------------------------------------------
@@ -502,6 +559,9 @@ constexpr uint32_t operator""_murmur3_32(const char* str, std::size_t len)
   return murmur3_32(std::string_view(str, len));
 }
 
+// out[i] = murmur3_32(strs[i], seed), same as fnv1a64_batch
+void murmur3_32_batch(std::span<const std::string_view> strs, std::span<uint32_t> out, uint32_t seed = 0x5EEDBA5E);
+
 //--------------------------------------------------------
 //  SHA1
 
@@ -563,6 +623,11 @@ inline void make_block(uint8_t const* pb, uint32_t block[16])
   }
 }
 
+// x86 SHA extensions kernel of the builder, see hashing.cpp.
+// processes whole 64-byte blocks of the message.
+bool has_sha_ni();
+void transform_sha_ni(uint32_t digest[5], const uint8_t* blocks, size_t blocks_cnt);
+
 } // namespace detail::sha1
 
 
@@ -586,9 +651,7 @@ struct sha1_builder
 
   void update(const char* data, size_t len)
   {
-    using namespace detail::sha1;
-
-    while (1)
+    if (m_len)
     {
       const uint32_t n = (uint32_t)std::min(len, sizeof(m_buf) - m_len);
       memcpy(m_buf + m_len, data, n);
@@ -601,12 +664,20 @@ struct sha1_builder
       data += n;
       len -= n;
       m_len = 0;
+      process_blocks(m_buf, 1);
+    }
 
-      uint32_t block[16];
-      make_block(m_buf, block);
-      transform(m_digest, block);
-      ++m_cb;
+    // whole blocks are hashed in place
+    const size_t blocks_cnt = len / 64;
+    if (blocks_cnt)
+    {
+      process_blocks(reinterpret_cast<const uint8_t*>(data), blocks_cnt);
+      data += blocks_cnt * 64;
+      len -= blocks_cnt * 64;
     }
+
+    memcpy(m_buf, data, len);
+    m_len = (uint32_t)len;
   }
 
   sha1_digest finalize()
@@ -645,6 +716,26 @@ struct sha1_builder
 
 protected:
 
+  void process_blocks(const uint8_t* blocks, size_t blocks_cnt)
+  {
+    using namespace detail::sha1;
+
+    m_cb += blocks_cnt;
+
+    if (has_sha_ni())
+    {
+      transform_sha_ni(m_digest, blocks, blocks_cnt);
+      return;
+    }
+
+    for (size_t i = 0; i < blocks_cnt; ++i)
+    {
+      uint32_t block[16];
+      make_block(blocks + i * 64, block);
+      transform(m_digest, block);
+    }
+  }
+
   void transform(uint32_t digest[5], uint32_t block[16])
   {
     using namespace detail::sha1;
@@ -0,0 +1,276 @@
+#pragma once
+#include <inttypes.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cp {
+
+// Scoped timing spans for profiling (benchmarks, headless tools).
+// Spans are reported to the sink installed on the calling thread and cost
+// a thread_local read when there is none.
+// While a trace is recorded (see trace_recorder.hpp) they are also recorded
+// as trace events, as are the trace-only spans (scoped_trace_span).
+
+struct span_record
+{
+  const char*       name;       // static string, e.g. "csav.lz4_decode"
+  std::string_view  label;      // optional detail (e.g. node name), only valid during on_span
+  uint32_t          depth;      // nesting level on the calling thread
+  double            duration_ms;
+  uint64_t          bytes;      // bytes processed, 0 if not relevant
+  uint64_t          allocs_cnt; // 0 unless an allocations counter is installed
+};
+
+struct span_sink
+{
+  virtual ~span_sink() = default;
+  virtual void on_span(const span_record& rec) = 0;
+};
+
+// returns the count of allocations made so far by the calling thread.
+// the library doesn't hook operator new, programs that do can install one.
+using allocs_counter_fn = uint64_t(*)();
+
+namespace instr_detail {
+
+inline thread_local span_sink* tls_sink = nullptr;
+inline thread_local uint32_t tls_depth = 0;
+inline std::atomic<allocs_counter_fn> allocs_counter = nullptr;
+inline std::atomic<bool> tracing = false;
+
+// defined in trace_recorder.cpp
+void trace_event(const char* name, std::string_view label,
+  std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end, uint64_t bytes);
+
+} // namespace instr_detail
+
+inline bool is_tracing()
+{
+  return instr_detail::tracing.load(std::memory_order_relaxed);
+}
+
+inline void set_allocs_counter(allocs_counter_fn fn)
+{
+  instr_detail::allocs_counter = fn;
+}
+
+inline uint64_t current_allocs_count()
+{
+  const auto fn = instr_detail::allocs_counter.load(std::memory_order_relaxed);
+  return fn ? fn() : 0;
+}
+
+inline span_sink* current_span_sink()
+{
+  return instr_detail::tls_sink;
+}
+
+inline uint32_t current_span_depth()
+{
+  return instr_detail::tls_depth;
+}
+
+// installs a sink on the calling thread for the lifetime of the object.
+// to forward spans of worker threads, pass the sink and depth of the
+// spawning thread (see current_span_sink/current_span_depth).
+struct scoped_span_sink
+{
+  explicit scoped_span_sink(span_sink* sink, uint32_t depth = 0)
+    : m_prev(instr_detail::tls_sink), m_prev_depth(instr_detail::tls_depth)
+  {
+    instr_detail::tls_sink = sink;
+    instr_detail::tls_depth = depth;
+  }
+
+  ~scoped_span_sink()
+  {
+    instr_detail::tls_sink = m_prev;
+    instr_detail::tls_depth = m_prev_depth;
+  }
+
+  scoped_span_sink(const scoped_span_sink&) = delete;
+  scoped_span_sink& operator=(const scoped_span_sink&) = delete;
+
+private:
+  span_sink* m_prev;
+  uint32_t m_prev_depth;
+};
+
+struct scoped_span
+{
+  using clock_type = std::chrono::steady_clock;
+
+  explicit scoped_span(const char* name, std::string_view label = {})
+    : m_sink(instr_detail::tls_sink), m_traced(is_tracing()), m_name(name), m_label(label)
+  {
+    if (m_sink)
+    {
+      ++instr_detail::tls_depth;
+      m_allocs_start = current_allocs_count();
+    }
+    if (m_sink || m_traced)
+    {
+      m_start = clock_type::now();
+    }
+  }
+
+  ~scoped_span()
+  {
+    if (!m_sink && !m_traced)
+    {
+      return;
+    }
+
+    const auto end = clock_type::now();
+
+    if (m_sink)
+    {
+      span_record rec;
+      rec.name = m_name;
+      rec.label = m_label;
+      rec.bytes = m_bytes;
+      rec.duration_ms = std::chrono::duration<double, std::milli>(end - m_start).count();
+      rec.allocs_cnt = current_allocs_count() - m_allocs_start;
+      rec.depth = --instr_detail::tls_depth;
+      m_sink->on_span(rec);
+    }
+
+    if (m_traced)
+    {
+      instr_detail::trace_event(m_name, m_label, m_start, end, m_bytes);
+    }
+  }
+
+  scoped_span(const scoped_span&) = delete;
+  scoped_span& operator=(const scoped_span&) = delete;
+
+  void set_bytes(uint64_t bytes)
+  {
+    m_bytes = bytes;
+  }
+
+  void add_bytes(uint64_t bytes)
+  {
+    m_bytes += bytes;
+  }
+
+private:
+  span_sink* m_sink;
+  bool m_traced;
+  const char* m_name;
+  std::string_view m_label;
+  uint64_t m_bytes = 0;
+  uint64_t m_allocs_start = 0;
+  clock_type::time_point m_start;
+};
+
+// span that is only recorded in traces, for fine-grained or frequent work
+// (per-chunk tasks, file system callbacks, worker threads) that would
+// clutter the sinks. costs an atomic load when no trace is recorded.
+struct scoped_trace_span
+{
+  using clock_type = std::chrono::steady_clock;
+
+  explicit scoped_trace_span(const char* name, std::string_view label = {})
+    : m_traced(is_tracing()), m_name(name), m_label(label)
+  {
+    if (m_traced)
+    {
+      m_start = clock_type::now();
+    }
+  }
+
+  ~scoped_trace_span()
+  {
+    if (m_traced)
+    {
+      instr_detail::trace_event(m_name, m_label, m_start, clock_type::now(), m_bytes);
+    }
+  }
+
+  scoped_trace_span(const scoped_trace_span&) = delete;
+  scoped_trace_span& operator=(const scoped_trace_span&) = delete;
+
+  void set_bytes(uint64_t bytes)
+  {
+    m_bytes = bytes;
+  }
+
+private:
+  bool m_traced;
+  const char* m_name;
+  std::string_view m_label;
+  uint64_t m_bytes = 0;
+  clock_type::time_point m_start;
+};
+
+// Thread-safe sink keeping a copy of the spans, can be read while spans
+// are still being reported (e.g. by the UI during a loading job).
+// Sibling spans with same name and label (e.g. per-chunk ones) are merged
+// into one entry.
+struct span_log
+  : span_sink
+{
+  struct entry
+  {
+    std::string name;
+    std::string label;
+    uint32_t    depth = 0;
+    uint32_t    count = 0;
+    double      duration_ms = 0;
+    uint64_t    bytes = 0;
+    uint64_t    allocs_cnt = 0;
+  };
+
+  void on_span(const span_record& rec) override
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    // siblings are the entries of same depth reported since the last
+    // shallower one (children of siblings are deeper)
+    for (auto it = m_entries.rbegin(); it != m_entries.rend() && it->depth >= rec.depth; ++it)
+    {
+      if (it->depth == rec.depth && it->name == rec.name && it->label == rec.label)
+      {
+        ++it->count;
+        it->duration_ms += rec.duration_ms;
+        it->bytes += rec.bytes;
+        it->allocs_cnt += rec.allocs_cnt;
+        return;
+      }
+    }
+
+    auto& e = m_entries.emplace_back();
+    e.name = rec.name;
+    e.label = rec.label;
+    e.depth = rec.depth;
+    e.count = 1;
+    e.duration_ms = rec.duration_ms;
+    e.bytes = rec.bytes;
+    e.allocs_cnt = rec.allocs_cnt;
+  }
+
+  // in completion order (children before their parent)
+  std::vector<entry> entries() const
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_entries;
+  }
+
+  void clear()
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_entries.clear();
+  }
+
+protected:
+  mutable std::mutex m_mtx;
+  std::vector<entry> m_entries;
+};
+
+} // namespace cp
+
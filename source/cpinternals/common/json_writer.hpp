@@ -0,0 +1,244 @@
+#pragma once
+#include <inttypes.h>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <ostream>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace cp {
+
+// Streaming JSON writer
+// tokens are appended to a fixed-size buffer that is flushed to an
+// std::ostream when full, so that the memory used doesn't depend on the size
+// of the document (unlike building a nlohmann::json tree first).
+// separators are inserted from a stack of "container has elements" flags.
+//
+//  json_writer w(ofs);
+//  w.begin_object();
+//  w.key("name").value("Items.Preset_Overture_Kerry");
+//  w.key("quantity").value(1u);
+//  w.end_object();
+//  w.end_record(); // NDJSON: one top-level value per line
+struct json_writer
+{
+  static constexpr size_t buffer_size = 0x10000;
+
+  explicit json_writer(std::ostream& os)
+    : m_os(os)
+  {
+    m_buf.reserve(buffer_size);
+  }
+
+  ~json_writer()
+  {
+    flush();
+  }
+
+  json_writer(const json_writer&) = delete;
+  json_writer& operator=(const json_writer&) = delete;
+
+  json_writer& begin_object()
+  {
+    separate();
+    put('{');
+    m_stack.push_back(false);
+    return *this;
+  }
+
+  json_writer& end_object()
+  {
+    m_stack.pop_back();
+    put('}');
+    return *this;
+  }
+
+  json_writer& begin_array()
+  {
+    separate();
+    put('[');
+    m_stack.push_back(false);
+    return *this;
+  }
+
+  json_writer& end_array()
+  {
+    m_stack.pop_back();
+    put(']');
+    return *this;
+  }
+
+  // the next token is the value of this key
+  json_writer& key(std::string_view k)
+  {
+    separate();
+    put_string(k);
+    put(':');
+    m_after_key = true;
+    return *this;
+  }
+
+  json_writer& value(std::string_view s)
+  {
+    separate();
+    put_string(s);
+    return *this;
+  }
+
+  json_writer& value(const char* s)
+  {
+    return value(std::string_view(s));
+  }
+
+  json_writer& value(bool b)
+  {
+    separate();
+    put(b ? std::string_view("true") : std::string_view("false"));
+    return *this;
+  }
+
+  template <typename T, typename = std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>>
+  json_writer& value(T v)
+  {
+    separate();
+    std::array<char, 24> tmp;
+    auto res = std::to_chars(tmp.data(), tmp.data() + tmp.size(), v);
+    put(std::string_view(tmp.data(), res.ptr - tmp.data()));
+    return *this;
+  }
+
+  // non-finite numbers have no JSON representation, they are written as null
+  json_writer& value(double v)
+  {
+    if (!std::isfinite(v))
+      return null();
+
+    separate();
+    std::array<char, 32> tmp;
+    auto res = std::to_chars(tmp.data(), tmp.data() + tmp.size(), v);
+    put(std::string_view(tmp.data(), res.ptr - tmp.data()));
+    return *this;
+  }
+
+  json_writer& null()
+  {
+    separate();
+    put(std::string_view("null"));
+    return *this;
+  }
+
+  // ends a top-level value with a newline (NDJSON)
+  json_writer& end_record()
+  {
+    put('\n');
+    m_top_level_written = false;
+    if (m_buf.size() >= buffer_size)
+      flush();
+    return *this;
+  }
+
+  void flush()
+  {
+    if (m_buf.size())
+    {
+      m_os.write(m_buf.data(), m_buf.size());
+      m_buf.clear();
+    }
+  }
+
+  bool good() const
+  {
+    return m_os.good();
+  }
+
+protected:
+  void separate()
+  {
+    if (m_after_key)
+    {
+      m_after_key = false;
+      return;
+    }
+
+    if (m_stack.empty())
+    {
+      // several top-level values on a line (shouldn't happen in NDJSON)
+      if (m_top_level_written)
+        put(' ');
+      m_top_level_written = true;
+      return;
+    }
+
+    if (m_stack.back())
+      put(',');
+    m_stack.back() = true;
+  }
+
+  void put(char c)
+  {
+    if (m_buf.size() >= buffer_size)
+      flush();
+    m_buf.push_back(c);
+  }
+
+  void put(std::string_view s)
+  {
+    if (m_buf.size() + s.size() > buffer_size)
+    {
+      flush();
+      if (s.size() > buffer_size)
+      {
+        m_os.write(s.data(), s.size());
+        return;
+      }
+    }
+    m_buf.insert(m_buf.end(), s.begin(), s.end());
+  }
+
+  // utf-8 is written as is, quotes, backslashes and control characters are
+  // escaped
+  void put_string(std::string_view s)
+  {
+    static constexpr char hex[] = "0123456789abcdef";
+
+    put('"');
+    size_t run = 0;
+    for (size_t i = 0; i < s.size(); ++i)
+    {
+      const unsigned char c = static_cast<unsigned char>(s[i]);
+      if (c >= 0x20 && c != '"' && c != '\\')
+        continue;
+
+      put(s.substr(run, i - run));
+      run = i + 1;
+
+      switch (c)
+      {
+        case '"':  put(std::string_view("\\\"")); break;
+        case '\\': put(std::string_view("\\\\")); break;
+        case '\n': put(std::string_view("\\n")); break;
+        case '\r': put(std::string_view("\\r")); break;
+        case '\t': put(std::string_view("\\t")); break;
+        default:
+        {
+          const char esc[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF] };
+          put(std::string_view(esc, 6));
+          break;
+        }
+      }
+    }
+    put(s.substr(run));
+    put('"');
+  }
+
+  std::ostream& m_os;
+  std::vector<char> m_buf;
+  std::vector<bool> m_stack;
+  bool m_after_key = false;
+  bool m_top_level_written = false;
+};
+
+} // namespace cp
+
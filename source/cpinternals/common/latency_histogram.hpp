@@ -0,0 +1,108 @@
+#pragma once
+#include <inttypes.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+
+namespace cp {
+
+// Log2 histogram of latencies, in the unit of the recorded values (e.g.
+// nanoseconds for the benches, microseconds for cpfs_stats).
+// bucket i counts values in [2^(i-1), 2^i), the first one counts zeros and
+// the last one is unbounded.
+struct latency_histogram
+{
+  static constexpr size_t buckets_cnt = 40;
+
+  std::array<uint64_t, buckets_cnt> buckets = {};
+  uint64_t count = 0;
+  uint64_t total = 0;
+  uint64_t max = 0;
+
+  static size_t bucket_of(uint64_t value)
+  {
+    size_t bucket_idx = 0;
+    for (uint64_t v = value; v && bucket_idx + 1 < buckets_cnt; v >>= 1)
+      ++bucket_idx;
+    return bucket_idx;
+  }
+
+  void record(uint64_t value)
+  {
+    ++buckets[bucket_of(value)];
+    ++count;
+    total += value;
+    max = std::max(max, value);
+  }
+
+  void merge(const latency_histogram& other)
+  {
+    for (size_t i = 0; i < buckets_cnt; ++i)
+      buckets[i] += other.buckets[i];
+    count += other.count;
+    total += other.total;
+    max = std::max(max, other.max);
+  }
+
+  // value under which ratio of the records are (bucket upper bound)
+  uint64_t percentile(double ratio) const
+  {
+    if (!count)
+      return 0;
+
+    const uint64_t target = static_cast<uint64_t>(double(count) * ratio);
+    uint64_t acc = 0;
+    for (size_t i = 0; i + 1 < buckets_cnt; ++i)
+    {
+      acc += buckets[i];
+      if (acc > target)
+        return uint64_t(1) << i;
+    }
+
+    return max;
+  }
+
+  double mean() const
+  {
+    return count ? double(total) / double(count) : 0;
+  }
+};
+
+// latency_histogram that can be recorded to concurrently (relaxed atomics),
+// read through snapshots
+struct atomic_latency_histogram
+{
+  static constexpr size_t buckets_cnt = latency_histogram::buckets_cnt;
+
+  std::array<std::atomic<uint64_t>, buckets_cnt> buckets = {};
+  std::atomic<uint64_t> count = 0;
+  std::atomic<uint64_t> total = 0;
+  std::atomic<uint64_t> max = 0;
+
+  void record(uint64_t value)
+  {
+    buckets[latency_histogram::bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t prev_max = max.load(std::memory_order_relaxed);
+    while (prev_max < value && !max.compare_exchange_weak(prev_max, value, std::memory_order_relaxed))
+    {
+    }
+  }
+
+  // the counters aren't read at once, records made meanwhile may be partially in
+  latency_histogram snapshot() const
+  {
+    latency_histogram ret;
+    for (size_t i = 0; i < buckets_cnt; ++i)
+      ret.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+    ret.count = count.load(std::memory_order_relaxed);
+    ret.total = total.load(std::memory_order_relaxed);
+    ret.max = max.load(std::memory_order_relaxed);
+    return ret;
+  }
+};
+
+} // namespace cp
+
@@ -0,0 +1,80 @@
+#pragma once
+#include <inttypes.h>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <set>
+#include <vector>
+
+namespace cp {
+
+// Estimated memory footprint of a part of a save, accumulated by the
+// accumulate_memory_usage(..) hooks of nodes, systems, objects and
+// properties.
+// Sizes are object sizes and allocated capacities, allocator overhead and
+// the shared blueprints/enum descriptors are not counted.
+struct memory_usage
+{
+  size_t node_bytes   = 0; // node_t, data and children lists
+  size_t nodes_cnt    = 0;
+  size_t object_bytes = 0; // CObject, fields and lazy decoding state
+  size_t objects_cnt  = 0;
+  size_t prop_bytes   = 0; // CProperty and their values
+  size_t props_cnt    = 0;
+  size_t string_bytes = 0; // string pools
+  size_t cache_bytes  = 0; // load data, serialization caches, indices
+
+  size_t total_bytes() const
+  {
+    return node_bytes + object_bytes + prop_bytes + string_bytes + cache_bytes;
+  }
+
+  memory_usage& operator+=(const memory_usage& other)
+  {
+    node_bytes   += other.node_bytes;
+    nodes_cnt    += other.nodes_cnt;
+    object_bytes += other.object_bytes;
+    objects_cnt  += other.objects_cnt;
+    prop_bytes   += other.prop_bytes;
+    props_cnt    += other.props_cnt;
+    string_bytes += other.string_bytes;
+    cache_bytes  += other.cache_bytes;
+    return *this;
+  }
+};
+
+// heap bytes of standard containers
+
+template <typename T, typename A>
+inline size_t heap_bytes(const std::vector<T, A>& v)
+{
+  return v.capacity() * sizeof(T);
+}
+
+inline size_t heap_bytes(const std::string& s)
+{
+  // small strings are stored inline
+  return s.capacity() >= sizeof(std::string) ? s.capacity() + 1 : 0;
+}
+
+// node based containers: buckets plus one node (value and links) per element
+template <typename K, typename V, typename H, typename E, typename A>
+inline size_t heap_bytes(const std::unordered_map<K, V, H, E, A>& m)
+{
+  return m.bucket_count() * sizeof(void*) + m.size() * (sizeof(std::pair<const K, V>) + 2 * sizeof(void*));
+}
+
+template <typename K, typename H, typename E, typename A>
+inline size_t heap_bytes(const std::unordered_set<K, H, E, A>& s)
+{
+  return s.bucket_count() * sizeof(void*) + s.size() * (sizeof(K) + 2 * sizeof(void*));
+}
+
+template <typename K, typename C, typename A>
+inline size_t heap_bytes(const std::set<K, C, A>& s)
+{
+  return s.size() * (sizeof(K) + 3 * sizeof(void*));
+}
+
+} // namespace cp
+
@@ -1,5 +1,6 @@
 #pragma once
 #include <inttypes.h>
+#include <atomic>
 #include <string>
 #include <memory>
 #include <algorithm>
@@ -89,6 +90,13 @@ struct progress_t
 {
   float value = 0.f;
   std::string comment;
+  // set by the owner of the job, polled by long operations at safe points
+  const std::atomic<bool>* cancel = nullptr;
+
+  bool cancelled() const
+  {
+    return cancel && cancel->load(std::memory_order_relaxed);
+  }
 };
 
 // To replace exceptions, return this instead of a bool !
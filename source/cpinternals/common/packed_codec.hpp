@@ -0,0 +1,179 @@
+#pragma once
+#include <inttypes.h>
+#include <cstring>
+#include <span>
+#include <string>
+#include <intrin.h>
+
+namespace cp {
+
+// Decoders for the variable-length encodings of the save format, working on
+// contiguous buffers.
+//
+// packed ints: byte 0 holds the sign (bit 7), a continuation flag (bit 6)
+// and 6 bits of value, the next bytes hold 7 bits and a continuation flag
+// (bit 7), except the 5th one that holds 8 bits of value.
+// when at least 8 bytes are readable the encoding is decoded from a single
+// 64-bit load without data-dependent branches: all fields are extracted,
+// the length is derived from the continuation bits and the value is masked.
+//
+// utf16 strings: runs of 8 ascii characters are narrowed with sse2, other
+// characters are transcoded one by one. lone surrogates become U+FFFD.
+
+namespace detail::packed_codec {
+
+inline constexpr uint8_t value_bits[5] = {6, 13, 20, 27, 35};
+
+inline size_t decode_packed_int_slow(const uint8_t* p, size_t avail, int64_t& v)
+{
+  if (!avail)
+    return 0;
+
+  uint8_t a = p[0];
+  int64_t value = a & 0x3F;
+  const bool sign = !!(a & 0x80);
+  size_t len = 1;
+  if (a & 0x40)
+  {
+    uint32_t shift = 6;
+    do
+    {
+      if (len >= avail)
+        return 0;
+      a = p[len++];
+      value |= int64_t(shift == 27 ? a : (a & 0x7F)) << shift;
+      shift += 7;
+    }
+    while ((a & 0x80) && shift <= 27);
+  }
+
+  v = sign ? -value : value;
+  return len;
+}
+
+} // namespace detail::packed_codec
+
+// decodes one packed int from [p, p + avail), returns the count of bytes
+// consumed or 0 if the encoding is truncated
+inline size_t decode_packed_int(const char* p, size_t avail, int64_t& v)
+{
+  if (avail < 8)
+  {
+    return detail::packed_codec::decode_packed_int_slow(
+      reinterpret_cast<const uint8_t*>(p), avail, v);
+  }
+
+  uint64_t w;
+  std::memcpy(&w, p, 8); // little-endian
+
+  const uint64_t c0 = (w >> 6) & 1;
+  const uint64_t c1 = c0 & (w >> 15);
+  const uint64_t c2 = c1 & (w >> 23);
+  const uint64_t c3 = c2 & (w >> 31);
+  const size_t len = static_cast<size_t>(1 + c0 + c1 + c2 + c3);
+
+  const uint64_t value =
+      ( w        & 0x3F)
+    | ((w >>  8) & 0x7F) <<  6
+    | ((w >> 16) & 0x7F) << 13
+    | ((w >> 24) & 0x7F) << 20
+    | ((w >> 32) & 0xFF) << 27;
+
+  const uint64_t mask = (uint64_t(1) << detail::packed_codec::value_bits[len - 1]) - 1;
+  const int64_t sv = static_cast<int64_t>(value & mask);
+  v = (w & 0x80) ? -sv : sv;
+  return len;
+}
+
+// decodes values.size() consecutive packed ints from src, returns the count
+// of bytes consumed or 0 if src is too short
+inline size_t decode_packed_ints(std::span<const char> src, std::span<int64_t> values)
+{
+  size_t pos = 0;
+  for (auto& v : values)
+  {
+    const size_t len = decode_packed_int(src.data() + pos, src.size() - pos, v);
+    if (!len)
+      return 0;
+    pos += len;
+  }
+  return pos;
+}
+
+// appends the utf8 transcoding of cnt little-endian utf16 code units
+inline void utf16_to_utf8(const char* src, size_t cnt, std::string& out)
+{
+  const size_t out_pos = out.size();
+  out.resize(out_pos + cnt * 3);
+  char* dst = out.data() + out_pos;
+
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(src);
+  size_t i = 0;
+
+  auto unit_at = [p](size_t j) -> uint32_t {
+    return p[2 * j] | (uint32_t(p[2 * j + 1]) << 8);
+  };
+
+  const __m128i non_ascii_mask = _mm_set1_epi16(static_cast<short>(0xFF80));
+  const __m128i zero = _mm_setzero_si128();
+
+  while (i < cnt)
+  {
+    // ascii run
+    while (i + 8 <= cnt)
+    {
+      const __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 2 * i));
+      const __m128i non_ascii = _mm_and_si128(units, non_ascii_mask);
+      if (_mm_movemask_epi8(_mm_cmpeq_epi16(non_ascii, zero)) != 0xFFFF)
+        break;
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(units, units));
+      dst += 8;
+      i += 8;
+    }
+
+    if (i >= cnt)
+      break;
+
+    uint32_t cp = unit_at(i++);
+    if (cp >= 0xD800 && cp < 0xE000)
+    {
+      if (cp < 0xDC00 && i < cnt && (unit_at(i) & 0xFC00) == 0xDC00)
+      {
+        cp = 0x10000 + ((cp - 0xD800) << 10) + (unit_at(i++) - 0xDC00);
+      }
+      else
+      {
+        cp = 0xFFFD;
+      }
+    }
+
+    if (cp < 0x80)
+    {
+      *dst++ = static_cast<char>(cp);
+    }
+    else if (cp < 0x800)
+    {
+      *dst++ = static_cast<char>(0xC0 | (cp >> 6));
+      *dst++ = static_cast<char>(0x80 | (cp & 0x3F));
+    }
+    else if (cp < 0x10000)
+    {
+      *dst++ = static_cast<char>(0xE0 | (cp >> 12));
+      *dst++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+      *dst++ = static_cast<char>(0x80 | (cp & 0x3F));
+    }
+    else
+    {
+      // a surrogate pair is 2 units for 4 bytes, within the 3 bytes per unit
+      *dst++ = static_cast<char>(0xF0 | (cp >> 18));
+      *dst++ = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+      *dst++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+      *dst++ = static_cast<char>(0x80 | (cp & 0x3F));
+    }
+  }
+
+  out.resize(static_cast<size_t>(dst - out.data()));
+}
+
+} // namespace cp
+
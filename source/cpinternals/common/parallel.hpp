@@ -0,0 +1,185 @@
+#pragma once
+#include <inttypes.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <exception>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+
+#include <cpinternals/common/instrumentation.hpp>
+#include <cpinternals/common/task_scheduler.hpp>
+
+namespace cp {
+
+// returns the number of hardware threads (at least 1)
+inline size_t hardware_workers_count()
+{
+  const size_t cnt = std::thread::hardware_concurrency();
+  return cnt ? cnt : 1;
+}
+
+// 0 means "use hardware_workers_count()"
+inline size_t resolve_workers_count(size_t workers_cnt, size_t jobs_cnt)
+{
+  if (workers_cnt == 0)
+  {
+    workers_cnt = hardware_workers_count();
+  }
+  return std::max<size_t>(1, std::min(workers_cnt, jobs_cnt));
+}
+
+// calls fn(idx) for each idx in [0, count) using up to workers_cnt threads of
+// the task_scheduler, the calling thread being one of them.
+// indices are distributed dynamically so uneven jobs are balanced.
+// the first exception thrown by a job is rethrown once all jobs are done,
+// remaining jobs are skipped.
+template <typename Fn>
+void parallel_for(size_t count, size_t workers_cnt, Fn&& fn)
+{
+  if (count == 0)
+  {
+    return;
+  }
+
+  workers_cnt = resolve_workers_count(workers_cnt, count);
+  if (workers_cnt == 1)
+  {
+    for (size_t i = 0; i < count; ++i)
+    {
+      fn(i);
+    }
+    return;
+  }
+
+  std::atomic<size_t> next_idx = 0;
+  task_group group;
+
+  auto worker = [&]()
+  {
+    scoped_trace_span worker_span("thread.parallel_for");
+    size_t idx;
+    while (!group.is_cancelled() && (idx = next_idx.fetch_add(1)) < count)
+    {
+      fn(idx);
+    }
+  };
+
+  for (size_t i = 1; i < workers_cnt; ++i)
+  {
+    group.run(worker);
+  }
+
+  group.run_and_wait(worker);
+}
+
+// fixed set of threads running submitted tasks in fifo order,
+// for work that must not block the caller (e.g. async i/o completion).
+// unlike the task_scheduler, its tasks can block (waiting for i/o)
+// without holding back cpu work.
+// tasks must not throw.
+struct task_pool
+{
+  using task_type = std::function<void()>;
+
+  task_pool() = default;
+
+  ~task_pool()
+  {
+    join();
+  }
+
+  task_pool(const task_pool&) = delete;
+  task_pool& operator=(const task_pool&) = delete;
+
+  // 0 means "use hardware_workers_count()", no-op if already started
+  void start(size_t workers_cnt = 0)
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (!m_threads.empty())
+    {
+      return;
+    }
+
+    m_stopping = false;
+    workers_cnt = resolve_workers_count(workers_cnt, SIZE_MAX);
+    m_threads.reserve(workers_cnt);
+    for (size_t i = 0; i < workers_cnt; ++i)
+    {
+      m_threads.emplace_back([this]() { worker(); });
+    }
+  }
+
+  // runs the queued tasks then stops the threads
+  void join()
+  {
+    std::vector<std::thread> threads;
+    {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      m_stopping = true;
+      threads = std::move(m_threads);
+      m_threads.clear();
+    }
+    m_cv.notify_all();
+
+    for (auto& t : threads)
+    {
+      t.join();
+    }
+  }
+
+  bool is_started() const
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return !m_threads.empty() && !m_stopping;
+  }
+
+  // returns false (and doesn't run the task) if the pool isn't started
+  bool submit(task_type task)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      if (m_threads.empty() || m_stopping)
+      {
+        return false;
+      }
+      m_tasks.emplace_back(std::move(task));
+    }
+    m_cv.notify_one();
+    return true;
+  }
+
+protected:
+
+  void worker()
+  {
+    scoped_trace_span worker_span("thread.task_pool");
+    while (true)
+    {
+      task_type task;
+      {
+        std::unique_lock<std::mutex> lock(m_mtx);
+        m_cv.wait(lock, [this]() { return !m_tasks.empty() || m_stopping; });
+        if (m_tasks.empty())
+        {
+          return;
+        }
+        task = std::move(m_tasks.front());
+        m_tasks.pop_front();
+      }
+      task();
+    }
+  }
+
+  mutable std::mutex m_mtx;
+  std::condition_variable m_cv;
+  std::deque<task_type> m_tasks;
+  std::vector<std::thread> m_threads;
+  bool m_stopping = false;
+};
+
+} // namespace cp
+
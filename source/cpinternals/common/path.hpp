@@ -506,6 +506,21 @@ struct path_id
     return *this;
   }
 
+  // same as operator/=(const path&) for an already normalized name,
+  // without building a path
+  path_id& operator/=(std::string_view normalized_name)
+  {
+    if (hash != 0)
+    {
+      if (hash != root().hash)
+      {
+        hash = fnv1a64_continue(hash, '\\');
+      }
+      hash = fnv1a64_continue(hash, normalized_name);
+    }
+    return *this;
+  }
+
   // compute the path identifier of this's path and rhs with a directory separator
   // if this path_id is invalid, an invalid path_id is returned
   // if this path_id identifies the root path, this is equivalent to path_id(rhs).
@@ -516,6 +531,17 @@ struct path_id
     return ret;
   }
 
+  // path_id of the normalized input (see path_id_hasher), success is false
+  // and the returned id is null if it can't be normalized
+  template <class InputIt>
+  static path_id from_string(InputIt first, InputIt last, bool& success);
+
+  template <class Source>
+  static path_id from_string(const Source& s, bool& success)
+  {
+    return from_string(std::begin(s), std::end(s), success);
+  }
+
   inline constexpr bool operator==(const path_id& rhs) const
   {
     return hash == rhs.hash;
@@ -529,6 +555,119 @@ struct path_id
   uint64_t hash = 0;
 };
 
+// Computes a path_id straight from the characters of a path (char or wchar_t,
+// e.g. WinFsp's UTF-16 names), normalizing them on the fly with the same rules
+// as cp::path: ascii only, lower case, '/' and '\' become one '\', no leading
+// or trailing separators. There is no allocation.
+struct path_id_hasher
+{
+  path_id_hasher() = default;
+
+  // hashes a path relative to parent, a null parent gives a null id
+  explicit path_id_hasher(path_id parent)
+    : m_hash(parent.hash), m_needs_sep(parent != path_id::root()), m_null(parent.is_null())
+  {
+  }
+
+  // returns false once a character can't be normalized
+  template <typename CharT>
+  bool push(CharT tc)
+  {
+    if (!m_success)
+    {
+      return false;
+    }
+
+    // check for forbidden characters
+    if (tc & 0xFF80)
+    {
+      m_success = false;
+      return false;
+    }
+
+    const char c = static_cast<char>(tc);
+
+    if (c == '/' || c == '\\')
+    {
+      // written only if a name follows
+      m_pending_sep = true;
+    }
+    else if (c == ':')
+    {
+      DEBUG_BREAK();
+    }
+    else
+    {
+      if (m_len ? m_pending_sep : m_needs_sep)
+      {
+        m_hash = fnv1a64_continue(m_hash, '\\');
+        ++m_len;
+      }
+      m_pending_sep = false;
+      m_hash = fnv1a64_continue(m_hash, static_cast<char>(std::tolower(c)));
+      ++m_len;
+    }
+
+    return true;
+  }
+
+  template <class InputIt>
+  bool append(InputIt first, InputIt last)
+  {
+    for (; first != last; ++first)
+    {
+      if (!push(*first))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template <class Source>
+  bool append(const Source& s)
+  {
+    return append(std::begin(s), std::end(s));
+  }
+
+  bool success() const
+  {
+    return m_success;
+  }
+
+  // count of hashed characters (separators included)
+  size_t length() const
+  {
+    return m_len;
+  }
+
+  path_id result() const
+  {
+    if (!m_success || m_null)
+    {
+      return path_id();
+    }
+    return path_id(m_hash);
+  }
+
+private:
+
+  uint64_t m_hash = path_id::root().hash;
+  size_t   m_len = 0;
+  bool     m_needs_sep = false;
+  bool     m_pending_sep = false;
+  bool     m_success = true;
+  bool     m_null = false;
+};
+
+template <class InputIt>
+path_id path_id::from_string(InputIt first, InputIt last, bool& success)
+{
+  path_id_hasher hasher;
+  success = hasher.append(first, last);
+  return hasher.result();
+}
+
 } // namespace cp
 
 namespace std {
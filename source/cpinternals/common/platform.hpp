@@ -2,6 +2,8 @@
 
 #if defined(__WIN32__) || defined(_WIN32)
 #define DEBUG_BREAK __debugbreak
+#elif defined(__unix__)
+#define DEBUG_BREAK __builtin_trap
 #else
 #error platform not supported
 #endif
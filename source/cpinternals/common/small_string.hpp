@@ -0,0 +1,144 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include <cpinternals/common/small_vector.hpp>
+
+namespace cp {
+
+// String stored inline up to N chars (heap beyond), for names that are
+// almost always short (node names, tweakdb quaternion elements..).
+// Always null-terminated, converts implicitly to std::string_view.
+template <size_t N>
+class small_string
+{
+public:
+  small_string()
+  {
+    m_chars.push_back('\0');
+  }
+
+  small_string(const char* s)
+    : small_string(std::string_view(s))
+  {
+  }
+
+  small_string(std::string_view s)
+  {
+    assign(s);
+  }
+
+  small_string& operator=(std::string_view s)
+  {
+    assign(s);
+    return *this;
+  }
+
+  small_string& operator=(const char* s)
+  {
+    assign(std::string_view(s));
+    return *this;
+  }
+
+  void assign(std::string_view s)
+  {
+    m_chars.resize(s.size() + 1);
+    std::copy(s.begin(), s.end(), m_chars.begin());
+    m_chars[s.size()] = '\0';
+  }
+
+  size_t size() const { return m_chars.size() - 1; }
+  size_t length() const { return size(); }
+  bool empty() const { return size() == 0; }
+
+  // false once the string is too long to be inline
+  bool is_inline() const { return m_chars.is_inline(); }
+
+  char* data() { return m_chars.data(); }
+  const char* data() const { return m_chars.data(); }
+  const char* c_str() const { return m_chars.data(); }
+
+  const char* begin() const { return m_chars.data(); }
+  const char* end() const { return m_chars.data() + size(); }
+
+  char operator[](size_t idx) const { return m_chars[idx]; }
+
+  void clear()
+  {
+    resize(0);
+  }
+
+  // new chars are set to c
+  void resize(size_t len, char c = '\0')
+  {
+    const size_t prev_len = size();
+    m_chars.resize(len + 1, c);
+    if (len > prev_len)
+    {
+      m_chars[prev_len] = c;
+    }
+    m_chars[len] = '\0';
+  }
+
+  std::string_view strv() const
+  {
+    return std::string_view(data(), size());
+  }
+
+  operator std::string_view() const
+  {
+    return strv();
+  }
+
+  std::string str() const
+  {
+    return std::string(strv());
+  }
+
+  friend bool operator==(const small_string& a, const small_string& b)
+  {
+    return a.strv() == b.strv();
+  }
+
+  friend bool operator!=(const small_string& a, const small_string& b)
+  {
+    return !(a == b);
+  }
+
+  friend bool operator<(const small_string& a, const small_string& b)
+  {
+    return a.strv() < b.strv();
+  }
+
+  friend bool operator==(const small_string& a, std::string_view b)
+  {
+    return a.strv() == b;
+  }
+
+  friend bool operator!=(const small_string& a, std::string_view b)
+  {
+    return a.strv() != b;
+  }
+
+  friend bool operator==(const small_string& a, const char* b)
+  {
+    return a.strv() == b;
+  }
+
+  friend bool operator!=(const small_string& a, const char* b)
+  {
+    return a.strv() != b;
+  }
+
+protected:
+  small_vector<char, N + 1> m_chars;
+};
+
+template <typename T>
+struct is_small_string : std::false_type {};
+
+template <size_t N>
+struct is_small_string<small_string<N>> : std::true_type {};
+
+} // namespace cp
@@ -0,0 +1,250 @@
+#pragma once
+#include <inttypes.h>
+#include <algorithm>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace cp {
+
+// Vector whose first N elements are stored inline, for data that is almost
+// always tiny (e.g. a node's children while lifting it): it only allocates
+// once it grows past N, then behaves like std::vector.
+// Iterators are pointers, they are invalidated by growth and by moves of
+// inline containers.
+template <typename T, size_t N>
+class small_vector
+{
+  static_assert(N > 0);
+
+public:
+  using value_type      = T;
+  using size_type       = size_t;
+  using iterator        = T*;
+  using const_iterator  = const T*;
+
+  small_vector() = default;
+
+  small_vector(std::initializer_list<T> il)
+  {
+    assign(il.begin(), il.end());
+  }
+
+  small_vector(const small_vector& other)
+  {
+    assign(other.begin(), other.end());
+  }
+
+  small_vector(small_vector&& other) noexcept(std::is_nothrow_move_constructible_v<T>)
+  {
+    take(std::move(other));
+  }
+
+  ~small_vector()
+  {
+    clear();
+    release_heap();
+  }
+
+  small_vector& operator=(const small_vector& other)
+  {
+    if (this != &other)
+    {
+      assign(other.begin(), other.end());
+    }
+    return *this;
+  }
+
+  small_vector& operator=(small_vector&& other) noexcept(std::is_nothrow_move_constructible_v<T>)
+  {
+    if (this != &other)
+    {
+      clear();
+      release_heap();
+      take(std::move(other));
+    }
+    return *this;
+  }
+
+  size_t size() const { return m_size; }
+  size_t capacity() const { return m_capacity; }
+  bool empty() const { return m_size == 0; }
+
+  // false once the elements moved to the heap
+  bool is_inline() const { return m_data == inline_data(); }
+
+  T* data() { return m_data; }
+  const T* data() const { return m_data; }
+
+  iterator begin() { return m_data; }
+  iterator end() { return m_data + m_size; }
+  const_iterator begin() const { return m_data; }
+  const_iterator end() const { return m_data + m_size; }
+
+  T& operator[](size_t idx) { return m_data[idx]; }
+  const T& operator[](size_t idx) const { return m_data[idx]; }
+
+  T& front() { return m_data[0]; }
+  T& back() { return m_data[m_size - 1]; }
+  const T& front() const { return m_data[0]; }
+  const T& back() const { return m_data[m_size - 1]; }
+
+  void reserve(size_t cnt)
+  {
+    if (cnt > m_capacity)
+    {
+      reallocate(cnt);
+    }
+  }
+
+  void clear()
+  {
+    std::destroy_n(m_data, m_size);
+    m_size = 0;
+  }
+
+  template <typename Iter>
+  void assign(Iter first, Iter last)
+  {
+    clear();
+    reserve(static_cast<size_t>(std::distance(first, last)));
+    std::uninitialized_copy(first, last, m_data);
+    m_size = static_cast<uint32_t>(std::distance(first, last));
+  }
+
+  void resize(size_t cnt)
+  {
+    if (cnt < m_size)
+    {
+      std::destroy(m_data + cnt, m_data + m_size);
+    }
+    else
+    {
+      reserve(cnt);
+      std::uninitialized_value_construct(m_data + m_size, m_data + cnt);
+    }
+    m_size = static_cast<uint32_t>(cnt);
+  }
+
+  void resize(size_t cnt, const T& value)
+  {
+    if (cnt < m_size)
+    {
+      std::destroy(m_data + cnt, m_data + m_size);
+    }
+    else
+    {
+      reserve(cnt);
+      std::uninitialized_fill(m_data + m_size, m_data + cnt, value);
+    }
+    m_size = static_cast<uint32_t>(cnt);
+  }
+
+  template <typename... Args>
+  T& emplace_back(Args&&... args)
+  {
+    if (m_size == m_capacity)
+    {
+      // args can reference an element, the new one is built first
+      const size_t new_capacity = size_t(m_capacity) * 2;
+      T* new_data = std::allocator<T>().allocate(new_capacity);
+      ::new (static_cast<void*>(new_data + m_size)) T(std::forward<Args>(args)...);
+      move_to(new_data, new_capacity);
+    }
+    else
+    {
+      ::new (static_cast<void*>(m_data + m_size)) T(std::forward<Args>(args)...);
+    }
+
+    return m_data[m_size++];
+  }
+
+  void push_back(const T& value)
+  {
+    emplace_back(value);
+  }
+
+  void push_back(T&& value)
+  {
+    emplace_back(std::move(value));
+  }
+
+  void pop_back()
+  {
+    std::destroy_at(m_data + --m_size);
+  }
+
+  friend bool operator==(const small_vector& a, const small_vector& b)
+  {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end());
+  }
+
+  friend bool operator!=(const small_vector& a, const small_vector& b)
+  {
+    return !(a == b);
+  }
+
+protected:
+  T* inline_data()
+  {
+    return std::launder(reinterpret_cast<T*>(m_inline));
+  }
+
+  const T* inline_data() const
+  {
+    return std::launder(reinterpret_cast<const T*>(m_inline));
+  }
+
+  void reallocate(size_t new_capacity)
+  {
+    move_to(std::allocator<T>().allocate(new_capacity), new_capacity);
+  }
+
+  // moves the elements to new_data (heap) and frees the previous buffer
+  void move_to(T* new_data, size_t new_capacity)
+  {
+    std::uninitialized_move(m_data, m_data + m_size, new_data);
+    std::destroy_n(m_data, m_size);
+    release_heap();
+    m_data = new_data;
+    m_capacity = static_cast<uint32_t>(new_capacity);
+  }
+
+  void release_heap()
+  {
+    if (!is_inline())
+    {
+      std::allocator<T>().deallocate(m_data, m_capacity);
+      m_data = inline_data();
+      m_capacity = N;
+    }
+  }
+
+  // this must be empty and inline
+  void take(small_vector&& other)
+  {
+    if (!other.is_inline())
+    {
+      m_data = other.m_data;
+      m_size = other.m_size;
+      m_capacity = other.m_capacity;
+      other.m_data = other.inline_data();
+      other.m_size = 0;
+      other.m_capacity = N;
+      return;
+    }
+
+    std::uninitialized_move(other.begin(), other.end(), m_data);
+    m_size = other.m_size;
+    other.clear();
+  }
+
+  T* m_data = inline_data();
+  uint32_t m_size = 0;
+  uint32_t m_capacity = N;
+  alignas(T) unsigned char m_inline[N * sizeof(T)];
+};
+
+} // namespace cp
@@ -0,0 +1,104 @@
+#pragma once
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <cpinternals/common/gname.hpp>
+
+namespace cp {
+
+// Sorted list of names (without duplicates) that can be read while names
+// are registered, e.g. by a combo drawn during a load.
+// Readers get a snapshot, it stays valid and unchanged while they hold it.
+// Writers edit the list in place unless a snapshot of it is still held,
+// then they edit a copy that later readers get.
+// The address of the list is a stable key for caches of its content (see
+// ImGui::BetterCombo), its size changes with each registration.
+class sorted_names_list
+{
+public:
+  using snapshot = std::shared_ptr<const std::vector<gname>>;
+
+  sorted_names_list() = default;
+
+  sorted_names_list(const sorted_names_list&) = delete;
+  sorted_names_list& operator=(const sorted_names_list&) = delete;
+
+  snapshot get() const
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_list;
+  }
+
+  size_t size() const
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_list->size();
+  }
+
+  bool contains(const gname& name) const
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return std::binary_search(m_list->begin(), m_list->end(), name);
+  }
+
+  // returns false if the name was already listed
+  bool insert(const gname& name)
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    auto it = std::lower_bound(m_list->begin(), m_list->end(), name);
+    if (it != m_list->end() && *it == name)
+      return false;
+
+    const size_t idx = (size_t)(it - m_list->begin());
+    auto& list = writable();
+    list.insert(list.begin() + idx, name);
+    return true;
+  }
+
+  // names don't need to be sorted
+  void merge(std::vector<gname> names)
+  {
+    std::sort(names.begin(), names.end());
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    auto& list = writable();
+    const size_t prev_size = list.size();
+    list.insert(list.end(), names.begin(), names.end());
+    std::inplace_merge(list.begin(), list.begin() + prev_size, list.end());
+    list.erase(std::unique(list.begin(), list.end()), list.end());
+  }
+
+  // names must be sorted and unique
+  void assign(std::vector<gname> names)
+  {
+    auto list = std::make_shared<std::vector<gname>>(std::move(names));
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_list = std::move(list);
+  }
+
+  void reserve(size_t cnt)
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    writable().reserve(cnt);
+  }
+
+protected:
+  // called with the lock held, the snapshots still held keep the old list
+  std::vector<gname>& writable()
+  {
+    if (m_list.use_count() > 1)
+      m_list = std::make_shared<std::vector<gname>>(*m_list);
+    return *m_list;
+  }
+
+  mutable std::mutex m_mtx;
+  std::shared_ptr<std::vector<gname>> m_list = std::make_shared<std::vector<gname>>();
+};
+
+} // namespace cp
+
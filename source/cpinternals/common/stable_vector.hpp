@@ -0,0 +1,180 @@
+#pragma once
+#include <inttypes.h>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <type_traits>
+
+namespace cp {
+
+// Contiguous storage whose elements get an id that stays the same across
+// inserts, removals and sorts (e.g. to be used as ImGui IDs while the
+// elements move around in memory).
+// Ids are unique per container, copies of a container share them.
+template <typename T>
+class stable_vector
+{
+public:
+  using value_type      = T;
+  using id_type         = uint32_t;
+  using iterator        = typename std::vector<T>::iterator;
+  using const_iterator  = typename std::vector<T>::const_iterator;
+
+  stable_vector() = default;
+
+  size_t size() const { return m_items.size(); }
+  bool empty() const { return m_items.empty(); }
+
+  iterator begin() { return m_items.begin(); }
+  iterator end() { return m_items.end(); }
+  const_iterator begin() const { return m_items.begin(); }
+  const_iterator end() const { return m_items.end(); }
+
+  T& operator[](size_t idx) { return m_items[idx]; }
+  const T& operator[](size_t idx) const { return m_items[idx]; }
+
+  T& front() { return m_items.front(); }
+  T& back() { return m_items.back(); }
+  const T& front() const { return m_items.front(); }
+  const T& back() const { return m_items.back(); }
+
+  T* data() { return m_items.data(); }
+  const T* data() const { return m_items.data(); }
+
+  id_type id(size_t idx) const { return m_ids[idx]; }
+
+  // returns size() if not found
+  size_t index_of(id_type id) const
+  {
+    return (size_t)(std::find(m_ids.begin(), m_ids.end(), id) - m_ids.begin());
+  }
+
+  void reserve(size_t cnt)
+  {
+    m_items.reserve(cnt);
+    m_ids.reserve(cnt);
+  }
+
+  void clear()
+  {
+    m_items.clear();
+    m_ids.clear();
+  }
+
+  void resize(size_t cnt)
+  {
+    const size_t old_cnt = m_ids.size();
+    m_items.resize(cnt);
+    m_ids.resize(cnt);
+    for (size_t i = old_cnt; i < cnt; ++i)
+    {
+      m_ids[i] = m_next_id++;
+    }
+  }
+
+  template <typename... Args>
+  T& emplace_back(Args&&... args)
+  {
+    m_ids.push_back(m_next_id++);
+    return m_items.emplace_back(std::forward<Args>(args)...);
+  }
+
+  void push_back(const T& value) { emplace_back(value); }
+  void push_back(T&& value) { emplace_back(std::move(value)); }
+
+  T& insert(size_t idx, T value)
+  {
+    m_ids.insert(m_ids.begin() + idx, m_next_id++);
+    return *m_items.insert(m_items.begin() + idx, std::move(value));
+  }
+
+  void push_front(T value) { insert(0, std::move(value)); }
+
+  // returns the index of the element that followed the erased one
+  size_t erase(size_t idx)
+  {
+    m_items.erase(m_items.begin() + idx);
+    m_ids.erase(m_ids.begin() + idx);
+    return idx;
+  }
+
+  // erases the elements matching pred in one pass, returns their count
+  template <typename Pred>
+  size_t erase_if(Pred pred)
+  {
+    size_t dst = 0;
+    for (size_t i = 0; i < m_items.size(); ++i)
+    {
+      if (pred(static_cast<const T&>(m_items[i])))
+        continue;
+      if (dst != i)
+      {
+        m_items[dst] = std::move(m_items[i]);
+        m_ids[dst] = m_ids[i];
+      }
+      ++dst;
+    }
+
+    const size_t erased_cnt = m_items.size() - dst;
+    m_items.erase(m_items.begin() + dst, m_items.end());
+    m_ids.resize(dst);
+    return erased_cnt;
+  }
+
+  // stable sort, ids follow their elements
+  template <typename Compare>
+  void sort(Compare cmp)
+  {
+    std::vector<size_t> order(m_items.size());
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::stable_sort(order.begin(), order.end(),
+      [&](size_t a, size_t b) { return cmp(m_items[a], m_items[b]); });
+
+    reorder(order);
+  }
+
+  // same, with keys computed once per element (e.g. resolved names)
+  template <typename KeyFn>
+  void sort_by_key(KeyFn key_fn)
+  {
+    using key_type = std::decay_t<std::invoke_result_t<KeyFn&, const T&>>;
+
+    std::vector<key_type> keys;
+    keys.reserve(m_items.size());
+    for (const auto& item : m_items)
+    {
+      keys.emplace_back(key_fn(item));
+    }
+
+    std::vector<size_t> order(m_items.size());
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::stable_sort(order.begin(), order.end(),
+      [&](size_t a, size_t b) { return keys[a] < keys[b]; });
+
+    reorder(order);
+  }
+
+private:
+  void reorder(const std::vector<size_t>& order)
+  {
+    std::vector<T> items;
+    std::vector<id_type> ids;
+    items.reserve(order.size());
+    ids.reserve(order.size());
+    for (size_t i : order)
+    {
+      items.emplace_back(std::move(m_items[i]));
+      ids.emplace_back(m_ids[i]);
+    }
+
+    m_items = std::move(items);
+    m_ids = std::move(ids);
+  }
+
+  std::vector<T> m_items;
+  std::vector<id_type> m_ids;
+  id_type m_next_id = 0;
+};
+
+} // namespace cp
+
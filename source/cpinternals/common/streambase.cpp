@@ -1,9 +1,5 @@
 #include <cpinternals/common/streambase.hpp>
-
-#ifndef _SILENCE_CXX17_CODECVT_HEADER_DEPRECATION_WARNING
-#define _SILENCE_CXX17_CODECVT_HEADER_DEPRECATION_WARNING
-#endif
-#include <codecvt>
+#include <cpinternals/common/packed_codec.hpp>
 
 namespace cp {
 
@@ -25,15 +21,11 @@ streambase& streambase::serialize_str_lpfxd(std::string& s)
     {
       const size_t len = static_cast<size_t>(-cnt);
       s.resize(len, '\0');
-      serialize_bytes(s.data(), len);
+      serialize_bytes_fast(s.data(), len);
     }
     else
     {
-      const size_t len = static_cast<size_t>(cnt);
-      std::u16string str16(len, L'\0');
-      serialize_bytes(str16.data(), len * 2);
-      std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> convert;
-      s = convert.to_bytes(str16);
+      read_str_utf16(static_cast<size_t>(cnt), s);
     }
   }
   else
@@ -42,14 +34,40 @@ streambase& streambase::serialize_str_lpfxd(std::string& s)
     const int64_t cnt = -static_cast<int64_t>(len);
     write_int_packed(cnt);
     if (len)
-      serialize_bytes(s.data(), len);
+      serialize_bytes_fast(s.data(), len);
   }
 
   return *this;
 }
 
+void streambase::read_str_utf16(size_t len, std::string& s)
+{
+  s.clear();
+  if (len * 2 <= static_cast<size_t>(m_rend - m_rcur))
+  {
+    // transcoded from the read window
+    utf16_to_utf8(m_rcur, len, s);
+    m_rcur += len * 2;
+  }
+  else
+  {
+    std::string str16(len * 2, '\0');
+    serialize_bytes_fast(str16.data(), len * 2);
+    if (!has_error())
+      utf16_to_utf8(str16.data(), len, s);
+  }
+}
+
 int64_t streambase::read_int_packed()
 {
+  // decoded in place when the read window has room for the longest encoding
+  if (m_rend - m_rcur >= 5)
+  {
+    int64_t value = 0;
+    m_rcur += decode_packed_int(m_rcur, static_cast<size_t>(m_rend - m_rcur), value);
+    return value;
+  }
+
   uint8_t a = 0;
   serialize_byte(&a);
   int64_t value = a & 0x3F;
@@ -58,15 +76,15 @@ int64_t streambase::read_int_packed()
   {
     serialize_byte(&a);
     value |= static_cast<uint64_t>(a & 0x7F) << 6;
-    if (a < 0)
+    if (a & 0x80)
     {
       serialize_byte(&a);
       value |= static_cast<uint64_t>(a & 0x7F) << 13;
-      if (a < 0)
+      if (a & 0x80)
       {
         serialize_byte(&a);
         value |= static_cast<uint64_t>(a & 0x7F) << 20;
-        if (a < 0)
+        if (a & 0x80)
         {
           serialize_byte(&a);
           value |= static_cast<uint64_t>(a & 0xFF) << 27;
@@ -4,8 +4,10 @@
 #include <vector>
 #include <array>
 #include <cmath>
+#include <cstring>
 
 #include <cpinternals/common/iserializable.hpp>
+#include <cpinternals/common/small_string.hpp>
 #include <cpinternals/common/utils.hpp>
 
 namespace cp {
@@ -44,15 +46,36 @@ struct streambase
 
   virtual streambase& serialize_bytes(void* data, size_t size) = 0;
 
+  // non-virtual path for buffer-backed streams: copies from/to their direct
+  // access window when it is large enough, serialize_bytes otherwise.
+  streambase& serialize_bytes_fast(void* data, size_t size)
+  {
+    if (size <= static_cast<size_t>(m_rend - m_rcur))
+    {
+      std::memcpy(data, m_rcur, size);
+      m_rcur += size;
+      return *this;
+    }
+
+    if (size <= static_cast<size_t>(m_wend - m_wcur))
+    {
+      std::memcpy(m_wcur, data, size);
+      m_wcur += size;
+      return *this;
+    }
+
+    return serialize_bytes(data, size);
+  }
+
   streambase& serialize_span(const std::span<char>& span)
   {
-    return serialize_bytes(span.data(), span.size());
+    return serialize_bytes_fast(span.data(), span.size());
   }
 
   template <typename T, typename = std::enable_if_t<sizeof(T) == 1>>
   streambase& serialize_byte(T* pb)
   {
-    return serialize_bytes(pb, 1);
+    return serialize_bytes_fast(pb, 1);
   }
 
   // Allows for overrides (csav serialization != others)
@@ -128,7 +151,7 @@ struct streambase
     }
 
     // To be implemented if necessary
-    serialize_bytes(value, length);
+    serialize_bytes_fast(value, length);
     return *this;
   }
 
@@ -152,7 +175,7 @@ struct streambase
     }
 
     uint8_t u8 = val ? 1 : 0;
-    serialize_bytes(&u8, 1);
+    serialize_bytes_fast(&u8, 1);
     val = !!u8;
     return *this;
   }
@@ -221,6 +244,12 @@ struct streambase
     return serialize_str_lpfxd(s);
   }
 
+  template <size_t N>
+  streambase& operator<<(small_string<N>& s)
+  {
+    return serialize_str_lpfxd(s);
+  }
+
   template <typename T>
   streambase& serialize_pod_raw(T& value)
   {
@@ -229,7 +258,7 @@ struct streambase
       return *this;
     }
 
-    serialize_bytes(&value, sizeof(T));
+    serialize_bytes_fast(&value, sizeof(T));
     return *this;
   }
 
@@ -241,7 +270,7 @@ struct streambase
       return *this;
     }
 
-    serialize_bytes(data, cnt * sizeof(T));
+    serialize_bytes_fast(data, cnt * sizeof(T));
     return *this;
   }
 
@@ -267,13 +296,60 @@ struct streambase
   // TODO: overload for std::u16string
   streambase& serialize_str_lpfxd(std::string& s);
 
+  // same encoding, utf8 strings are read in place
+  template <size_t N>
+  streambase& serialize_str_lpfxd(small_string<N>& s)
+  {
+    if (has_error())
+    {
+      return *this;
+    }
+
+    if (is_reader())
+    {
+      const int64_t cnt = read_int_packed();
+      if (cnt < 0)
+      {
+        const size_t len = static_cast<size_t>(-cnt);
+        s.resize(len);
+        serialize_bytes_fast(s.data(), len);
+      }
+      else
+      {
+        std::string str;
+        read_str_utf16(static_cast<size_t>(cnt), str);
+        s.assign(str);
+      }
+    }
+    else
+    {
+      const size_t len = s.size();
+      write_int_packed(-static_cast<int64_t>(len));
+      if (len)
+        serialize_bytes_fast(s.data(), len);
+    }
+
+    return *this;
+  }
+
 protected:
 
+  // len utf16 chars transcoded to utf8
+  void read_str_utf16(size_t len, std::string& s);
+
   int64_t read_int_packed();
   void write_int_packed(int64_t v);
 
   std::string m_error;
   flags_type m_flags = flags_type::none;
+
+  // direct access window of buffer-backed streams (see serialize_bytes_fast),
+  // readers expose [m_rcur, m_rend) and writers [m_wcur, m_wend).
+  // streams keep them empty if they have none.
+  const char* m_rcur = nullptr;
+  const char* m_rend = nullptr;
+  char* m_wcur = nullptr;
+  char* m_wend = nullptr;
 };
 
 
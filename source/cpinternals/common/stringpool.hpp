@@ -5,6 +5,9 @@
 #include <array>
 #include <unordered_map>
 #include <shared_mutex>
+#include <span>
+#include <memory>
+#include <algorithm>
 
 #include <cpinternals/common/hashing.hpp>
 #include <cpinternals/common/utils.hpp>
@@ -13,6 +16,65 @@
 
 namespace cp {
 
+namespace detail {
+
+// chained char blocks, strings never move once allocated.
+// strings larger than a default block get a block of their own.
+struct string_arena
+{
+  constexpr static size_t default_block_size = 0x40000;
+
+  string_arena() = default;
+
+  // non-copyable
+  string_arena(const string_arena&) = delete;
+  string_arena& operator=(const string_arena&) = delete;
+
+  // makes the next "bytes" bytes (null terminators included) fit in the
+  // current block. the unused end of the previous block is lost.
+  void reserve(size_t bytes)
+  {
+    if (static_cast<size_t>(m_end - m_cur) < bytes)
+    {
+      allocate_block(bytes);
+    }
+  }
+
+  // This allocates "len" bytes and a terminating null character.
+  // so that calling the returned string_view's data() is equivalent but faster than c_str().
+  std::string_view allocate_and_copy(std::string_view sv)
+  {
+    const size_t len = sv.size();
+    reserve(len + 1);
+
+    char* data = m_cur;
+    std::copy(sv.begin(), sv.end(), data);
+    data[len] = '\0';
+
+    m_cur += len + 1;
+
+    return std::string_view(data, len);
+  }
+
+protected:
+
+  void allocate_block(size_t min_size)
+  {
+    const size_t size = std::max(min_size, default_block_size);
+    m_blocks.emplace_back(new char[size]);
+    m_cur = m_blocks.back().get();
+    m_end = m_cur + size;
+  }
+
+private:
+
+  std::vector<std::unique_ptr<char[]>> m_blocks;
+  char* m_cur = nullptr;
+  char* m_end = nullptr;
+};
+
+} // namespace detail
+
 // this pool never reallocates thus string_views are valid until destruction of the pool.
 // it behaves as a set (no duplicates) and is not clearable.
 template <bool ThreadSafe>
@@ -20,13 +82,7 @@ struct stringpool
 {
   using mutex_type = std::conditional_t<ThreadSafe, std::shared_mutex, cp::nop_mutex>;
 
-  constexpr static size_t block_size = 0x40000;
-  using block_type = std::array<char, block_size>;
-
-  stringpool()
-    : m_curpos(block_size)
-  {
-  }
+  stringpool() = default;
 
   // non-copyable
   stringpool(const stringpool&) = delete;
@@ -44,11 +100,17 @@ struct stringpool
     return m_idxmap.find(fnv1a64_hash) != m_idxmap.end();
   }
 
-  void reserve(size_t cnt)
+  // reserves room for cnt strings and, optionally, a single block for the
+  // next "bytes" bytes of copied strings (null terminators included).
+  void reserve(size_t cnt, size_t bytes = 0)
   {
     std::unique_lock<mutex_type> ul(m_smtx);
     m_views.reserve(cnt);
     m_idxmap.reserve(cnt);
+    if (bytes)
+    {
+      m_arena.reserve(bytes);
+    }
   }
 
   uint32_t size() const
@@ -107,7 +169,7 @@ struct stringpool
         }
         else
         {
-          auto new_sv = allocate_and_copy(sv);
+          auto new_sv = m_arena.allocate_and_copy(sv);
           m_views.emplace_back(new_sv);
         }
 
@@ -135,6 +197,70 @@ struct stringpool
     return ret;
   }
 
+  // registers svs with the lock taken once (e.g. to load a names table),
+  // indices[i] receives the index of svs[i].
+  void register_strings(std::span<const std::string_view> svs, std::span<uint32_t> indices)
+  {
+    std::vector<uint64_t> hashes(svs.size());
+    fnv1a64_batch(svs, hashes);
+
+    register_strings(svs, hashes, indices);
+  }
+
+  // same with precomputed hashes (not verified, e.g. from a compiled db).
+  // if svs' contents have static storage duration they aren't copied.
+  void register_strings(std::span<const std::string_view> svs, std::span<const uint64_t> hashes,
+    std::span<uint32_t> indices, bool sv_contents_have_static_storage_duration = false)
+  {
+    std::unique_lock<mutex_type> ul(m_smtx);
+
+    // the missing strings are counted first to get their views, map entries
+    // and copies allocated once.
+    size_t new_cnt = 0;
+    size_t new_bytes = 0;
+    for (size_t i = 0; i < svs.size(); ++i)
+    {
+      if (m_idxmap.find(hashes[i]) == m_idxmap.end())
+      {
+        ++new_cnt;
+        new_bytes += svs[i].size() + 1;
+      }
+    }
+
+    m_views.reserve(m_views.size() + new_cnt);
+    m_idxmap.reserve(m_idxmap.size() + new_cnt);
+    if (!sv_contents_have_static_storage_duration)
+    {
+      m_arena.reserve(new_bytes);
+    }
+
+    for (size_t i = 0; i < svs.size(); ++i)
+    {
+      auto it = m_idxmap.find(hashes[i]);
+      if (it != m_idxmap.end())
+      {
+        if (m_collision_check_enabled && m_views[it->second] != svs[i])
+        {
+          SPDLOG_ERROR("string hash collision: \"{}\" vs \"{}\"", m_views[it->second], svs[i]);
+        }
+        indices[i] = it->second;
+        continue;
+      }
+
+      const uint32_t idx = static_cast<uint32_t>(m_views.size());
+      if (sv_contents_have_static_storage_duration)
+      {
+        m_views.emplace_back(svs[i]);
+      }
+      else
+      {
+        m_views.emplace_back(m_arena.allocate_and_copy(svs[i]));
+      }
+      m_idxmap.emplace(hashes[i], idx);
+      indices[i] = idx;
+    }
+  }
+
   // s must have static storage duration.
   // if s is not already present no copy is done and a string_view of s is created.
   // (any good reason to not do like this ?)
@@ -168,42 +294,11 @@ struct stringpool
     return m_views[idx];
   }
 
-protected:
-
-  // protected methods don't lock m_smtx
-
-  bool allocate_block()
-  {
-    m_blocks.emplace_back(std::make_unique<block_type>());
-    m_curpos = 0;
-    return true;
-  }
-
-  // This allocates "len" bytes and a terminating null character.
-  // so that calling the returned string_view's data() is equivalent but faster than c_str().
-  std::string_view allocate_and_copy(std::string_view sv)
-  {
-    const size_t len = sv.size();
-
-    if (m_curpos + len + 1 > block_size)
-    {
-      allocate_block();
-    }
-
-    char* data = m_blocks.back()->data() + m_curpos;
-    std::copy(sv.begin(), sv.end(), data);
-
-    m_curpos += len + 1;
-
-    return std::string_view(data, len);
-  }
-
 private:
 
   bool m_collision_check_enabled = false;
 
-  std::vector<std::unique_ptr<block_type>> m_blocks;
-  size_t m_curpos;
+  detail::string_arena m_arena;
 
   mutable mutex_type m_smtx;
 
@@ -0,0 +1,424 @@
+#pragma once
+#include <inttypes.h>
+#include <optional>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <bit>
+#include <span>
+
+#include <spdlog/spdlog.h>
+
+#include <cpinternals/common/hashing.hpp>
+#include <cpinternals/common/stringpool.hpp>
+
+namespace cp {
+
+// thread-safe pool with the same semantics as stringpool_mt (set, never
+// reallocates, not clearable) meant for the global gstring pools.
+//
+// strings are dispatched to shards by the high bits of their hash, each
+// shard owns its char blocks and its hash->index table.
+// registrations only lock their shard, at() and hits of find() and
+// register_string() don't lock at all:
+// - views live in an append-only segmented table, segments are never
+//   moved and are published with release stores,
+// - shard tables are open-addressing, slots are published with a release
+//   store of their index and grown tables replace the old ones (which are
+//   kept alive for late readers).
+struct stringpool_sharded
+{
+  constexpr static size_t shards_cnt_bits = 6;
+  constexpr static size_t shards_cnt = size_t(1) << shards_cnt_bits;
+
+  stringpool_sharded() = default;
+
+  // non-copyable
+  stringpool_sharded(const stringpool_sharded&) = delete;
+  stringpool_sharded& operator=(const stringpool_sharded&) = delete;
+
+  ~stringpool_sharded()
+  {
+    for (auto& seg : m_segments)
+    {
+      delete[] seg.load(std::memory_order_relaxed);
+    }
+  }
+
+  bool has_string(std::string_view sv) const
+  {
+    return find(fnv1a64(sv)).has_value();
+  }
+
+  bool has_hash(const uint64_t fnv1a64_hash) const
+  {
+    return find(fnv1a64_hash).has_value();
+  }
+
+  // reserves room for cnt strings and, optionally, "bytes" bytes of copied
+  // strings (null terminators included) spread over the shards.
+  void reserve(size_t cnt, size_t bytes = 0)
+  {
+    if (!cnt)
+      return;
+
+    const uint32_t last_seg = segment_of(static_cast<uint32_t>(cnt - 1)).first;
+    for (uint32_t s = 0; s <= last_seg; ++s)
+    {
+      get_or_create_segment(s);
+    }
+
+    // hashes are uniform enough for an even split (with some slack)
+    const size_t cnt_per_shard = cnt / shards_cnt + cnt / (shards_cnt * 8) + 1;
+    const size_t bytes_per_shard = bytes ? bytes / shards_cnt + bytes / (shards_cnt * 8) + 1 : 0;
+    for (auto& sh : m_shards)
+    {
+      std::lock_guard<std::mutex> lk(sh.mtx);
+      sh.reserve(cnt_per_shard);
+      if (bytes_per_shard)
+      {
+        sh.arena.reserve(bytes_per_shard);
+      }
+    }
+  }
+
+  uint32_t size() const
+  {
+    return m_size.load(std::memory_order_acquire);
+  }
+
+  // returns pair (fnv1a64_hash, index)
+  std::pair<uint64_t, uint32_t>
+  register_string(std::string_view sv)
+  {
+    const uint64_t hash = fnv1a64(sv);
+    return register_string(sv, hash);
+  }
+
+  // returns pair (fnv1a64_hash, index)
+  // the hash is not verified, use carefully
+  std::pair<uint64_t, uint32_t>
+  register_string(std::string_view sv, const uint64_t fnv1a64_hash, bool sv_content_has_static_storage_duration = false)
+  {
+    shard& sh = shard_of(fnv1a64_hash);
+
+    auto idx = sh.find(fnv1a64_hash);
+    if (!idx.has_value())
+    {
+      std::lock_guard<std::mutex> lk(sh.mtx);
+
+      // another registration could have gotten the lock before us
+      idx = sh.find(fnv1a64_hash);
+      if (!idx.has_value())
+      {
+        std::string_view new_sv = sv_content_has_static_storage_duration
+          ? sv : sh.arena.allocate_and_copy(sv);
+
+        return {fnv1a64_hash, insert_new(sh, fnv1a64_hash, new_sv)};
+      }
+    }
+
+    if (m_collision_check_enabled)
+    {
+      auto existing_sv = at(*idx);
+      if (existing_sv != sv)
+      {
+        SPDLOG_ERROR("string hash collision: \"{}\" vs \"{}\"", existing_sv, sv);
+      }
+    }
+
+    return {fnv1a64_hash, *idx};
+  }
+
+  // indices[i] receives the index of svs[i].
+  void register_strings(std::span<const std::string_view> svs, std::span<uint32_t> indices)
+  {
+    std::vector<uint64_t> hashes(svs.size());
+    fnv1a64_batch(svs, hashes);
+
+    register_strings(svs, hashes, indices);
+  }
+
+  // same with precomputed hashes (not verified, e.g. from a compiled db).
+  // if svs' contents have static storage duration they aren't copied.
+  void register_strings(std::span<const std::string_view> svs, std::span<const uint64_t> hashes,
+    std::span<uint32_t> indices, bool sv_contents_have_static_storage_duration = false)
+  {
+    // present strings are resolved without locking, the missing ones are
+    // bucketed by shard and each shard is locked once for all of its own.
+    std::array<std::vector<uint32_t>, shards_cnt> missing;
+    for (size_t i = 0; i < svs.size(); ++i)
+    {
+      const shard& sh = shard_of(hashes[i]);
+      auto idx = sh.find(hashes[i]);
+      if (idx.has_value())
+      {
+        indices[i] = *idx;
+      }
+      else
+      {
+        missing[shard_idx_of(hashes[i])].push_back(static_cast<uint32_t>(i));
+      }
+    }
+
+    size_t missing_cnt = 0;
+    for (const auto& m : missing)
+    {
+      missing_cnt += m.size();
+    }
+    if (!missing_cnt)
+      return;
+
+    // the view segments are allocated once, outside of the shard locks
+    const uint32_t last_idx = m_size.load(std::memory_order_relaxed) + static_cast<uint32_t>(missing_cnt) - 1;
+    for (uint32_t seg = 0, last_seg = segment_of(last_idx).first; seg <= last_seg; ++seg)
+    {
+      get_or_create_segment(seg);
+    }
+
+    for (size_t s = 0; s < shards_cnt; ++s)
+    {
+      const auto& m = missing[s];
+      if (m.empty())
+        continue;
+
+      shard& sh = m_shards[s];
+      std::lock_guard<std::mutex> lk(sh.mtx);
+
+      sh.reserve(sh.size() + m.size());
+      if (!sv_contents_have_static_storage_duration)
+      {
+        size_t bytes = 0;
+        for (uint32_t i : m)
+        {
+          bytes += svs[i].size() + 1;
+        }
+        sh.arena.reserve(bytes);
+      }
+
+      for (uint32_t i : m)
+      {
+        // duplicates in svs or concurrent registrations
+        auto idx = sh.find(hashes[i]);
+        if (idx.has_value())
+        {
+          indices[i] = *idx;
+          continue;
+        }
+
+        std::string_view new_sv = sv_contents_have_static_storage_duration
+          ? svs[i] : sh.arena.allocate_and_copy(svs[i]);
+
+        indices[i] = insert_new(sh, hashes[i], new_sv);
+      }
+    }
+  }
+
+  // s must have static storage duration.
+  // if s is not already present no copy is done and a string_view of s is created.
+  uint32_t register_literal(const char* const s)
+  {
+    const std::string_view sv(s);
+    const uint64_t fnv1a64_hash = fnv1a64(sv);
+    return register_string(sv, fnv1a64_hash, true).second;
+  }
+
+  std::optional<uint32_t> find(std::string_view sv) const
+  {
+    const uint64_t hash = fnv1a64(sv);
+    return find(hash);
+  }
+
+  std::optional<uint32_t> find(const uint64_t fnv1a64_hash) const
+  {
+    return shard_of(fnv1a64_hash).find(fnv1a64_hash);
+  }
+
+  // idx must come from this pool (registration or find).
+  std::string_view at(uint32_t idx) const
+  {
+    const auto [s, off] = segment_of(idx);
+    return m_segments[s].load(std::memory_order_acquire)[off];
+  }
+
+protected:
+
+  // segment s holds (first_segment_size << s) views
+  constexpr static uint32_t first_segment_bits = 10;
+  constexpr static uint32_t segments_cnt = 32 - first_segment_bits;
+
+  static std::pair<uint32_t, uint32_t> segment_of(uint32_t idx)
+  {
+    const uint64_t v = uint64_t(idx) + (uint64_t(1) << first_segment_bits);
+    const uint32_t high_bit = static_cast<uint32_t>(std::bit_width(v)) - 1;
+    const uint32_t s = high_bit - first_segment_bits;
+    return {s, static_cast<uint32_t>(v - (uint64_t(1) << high_bit))};
+  }
+
+  std::string_view* get_or_create_segment(uint32_t s)
+  {
+    std::string_view* seg = m_segments[s].load(std::memory_order_acquire);
+    if (seg)
+      return seg;
+
+    std::lock_guard<std::mutex> lk(m_segments_mtx);
+    seg = m_segments[s].load(std::memory_order_relaxed);
+    if (!seg)
+    {
+      seg = new std::string_view[size_t(1) << (first_segment_bits + s)];
+      m_segments[s].store(seg, std::memory_order_release);
+    }
+    return seg;
+  }
+
+  std::string_view& view_slot(uint32_t idx)
+  {
+    const auto [s, off] = segment_of(idx);
+    return get_or_create_segment(s)[off];
+  }
+
+  struct table
+  {
+    struct slot
+    {
+      std::atomic<uint64_t> hash = 0;
+      // index + 1, 0 for empty slots
+      std::atomic<uint32_t> idx1 = 0;
+    };
+
+    explicit table(size_t capacity)
+      : mask(capacity - 1), slots(new slot[capacity]) {}
+
+    const size_t mask;
+    size_t cnt = 0;
+    std::unique_ptr<slot[]> slots;
+  };
+
+  struct alignas(64) shard
+  {
+    std::mutex mtx;
+    std::atomic<table*> tbl = nullptr;
+    // current and retired tables, retired ones may still be probed by readers
+    std::vector<std::unique_ptr<table>> tables;
+
+    detail::string_arena arena;
+
+    std::optional<uint32_t> find(uint64_t hash) const
+    {
+      const table* t = tbl.load(std::memory_order_acquire);
+      if (!t)
+        return std::nullopt;
+
+      for (size_t i = hash & t->mask; ; i = (i + 1) & t->mask)
+      {
+        const auto& sl = t->slots[i];
+        const uint32_t idx1 = sl.idx1.load(std::memory_order_acquire);
+        if (!idx1)
+          return std::nullopt;
+        if (sl.hash.load(std::memory_order_relaxed) == hash)
+          return {idx1 - 1};
+      }
+    }
+
+    // methods below require mtx
+
+    size_t size() const
+    {
+      const table* t = tbl.load(std::memory_order_relaxed);
+      return t ? t->cnt : 0;
+    }
+
+    void reserve(size_t cnt)
+    {
+      const table* t = tbl.load(std::memory_order_relaxed);
+      if (!t || (t->mask + 1) < cnt * 2)
+      {
+        grow(std::bit_ceil(std::max<size_t>(cnt * 2, 64)));
+      }
+    }
+
+    void insert(uint64_t hash, uint32_t idx)
+    {
+      table* t = tbl.load(std::memory_order_relaxed);
+      if (!t || (t->cnt + 1) * 2 > t->mask + 1)
+      {
+        t = grow(t ? (t->mask + 1) * 2 : 64);
+      }
+      raw_insert(*t, hash, idx);
+    }
+
+    table* grow(size_t capacity)
+    {
+      auto new_tbl = std::make_unique<table>(capacity);
+      if (const table* t = tbl.load(std::memory_order_relaxed))
+      {
+        for (size_t i = 0; i <= t->mask; ++i)
+        {
+          const auto& sl = t->slots[i];
+          const uint32_t idx1 = sl.idx1.load(std::memory_order_relaxed);
+          if (idx1)
+          {
+            raw_insert(*new_tbl, sl.hash.load(std::memory_order_relaxed), idx1 - 1);
+          }
+        }
+      }
+
+      table* ret = new_tbl.get();
+      tables.emplace_back(std::move(new_tbl));
+      tbl.store(ret, std::memory_order_release);
+      return ret;
+    }
+
+    static void raw_insert(table& t, uint64_t hash, uint32_t idx)
+    {
+      size_t i = hash & t.mask;
+      while (t.slots[i].idx1.load(std::memory_order_relaxed))
+      {
+        i = (i + 1) & t.mask;
+      }
+      t.slots[i].hash.store(hash, std::memory_order_relaxed);
+      t.slots[i].idx1.store(idx + 1, std::memory_order_release);
+      ++t.cnt;
+    }
+  };
+
+  // requires sh.mtx, returns the index of the new view
+  uint32_t insert_new(shard& sh, uint64_t hash, std::string_view sv)
+  {
+    const uint32_t idx = m_size.fetch_add(1, std::memory_order_relaxed);
+    view_slot(idx) = sv;
+    // the view is published by the release store of the shard insert
+    sh.insert(hash, idx);
+    return idx;
+  }
+
+  static size_t shard_idx_of(uint64_t hash)
+  {
+    return static_cast<size_t>(hash >> (64 - shards_cnt_bits));
+  }
+
+  shard& shard_of(uint64_t hash)
+  {
+    return m_shards[shard_idx_of(hash)];
+  }
+
+  const shard& shard_of(uint64_t hash) const
+  {
+    return m_shards[shard_idx_of(hash)];
+  }
+
+private:
+
+  bool m_collision_check_enabled = false;
+
+  std::array<shard, shards_cnt> m_shards;
+
+  std::atomic<uint32_t> m_size = 0;
+  std::array<std::atomic<std::string_view*>, segments_cnt> m_segments = {};
+  std::mutex m_segments_mtx;
+};
+
+} // namespace cp
+
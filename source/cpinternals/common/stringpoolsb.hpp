@@ -3,11 +3,11 @@
 #include <optional>
 #include <vector>
 #include <array>
-#include <unordered_map>
 #include <stdexcept>
 #include <iterator>
 
 #include <cpinternals/common/hashing.hpp>
+#include <cpinternals/common/hash_index.hpp>
 #include <cpinternals/common/utils.hpp>
 #include <cpinternals/common/streambase.hpp>
 
@@ -99,12 +99,12 @@ struct stringpoolsb
 
   bool has_string(std::string_view sv) const
   {
-    return m_idxmap.find(fnv1a64(sv)) != m_idxmap.end();
+    return m_idxmap.find(fnv1a64(sv)).has_value();
   }
 
   bool has_hash(const uint64_t fnv1a64_hash) const
   {
-    return m_idxmap.find(fnv1a64_hash) != m_idxmap.end();
+    return m_idxmap.find(fnv1a64_hash).has_value();
   }
 
   uint32_t size() const
@@ -144,17 +144,17 @@ struct stringpoolsb
   {
     // todo: in debug, check that the given hash is correct
 
-    auto it = m_idxmap.find(fnv1a64_hash);
-    if (it == m_idxmap.end())
+    auto idx = m_idxmap.find(fnv1a64_hash);
+    if (!idx.has_value())
     {
       auto new_desc = allocate_and_copy(sv);
 
-      const uint32_t idx = static_cast<uint32_t>(m_descs.size());
+      idx = static_cast<uint32_t>(m_descs.size());
       m_descs.emplace_back(new_desc);
-      it = m_idxmap.emplace(fnv1a64_hash, idx).first;
+      m_idxmap.emplace(fnv1a64_hash, *idx);
     }
 
-    return *it;
+    return {fnv1a64_hash, *idx};
   }
 
   std::optional<uint32_t> find(std::string_view sv) const
@@ -165,12 +165,7 @@ struct stringpoolsb
 
   std::optional<uint32_t> find(const uint64_t fnv1a64_hash) const
   {
-    auto it = m_idxmap.find(fnv1a64_hash);
-    if (it != m_idxmap.end())
-    {
-      return { it->second };
-    }
-    return std::nullopt;
+    return m_idxmap.find(fnv1a64_hash);
   }
 
   // view can be invalidated on pool insertion (register)
@@ -245,6 +240,7 @@ struct stringpoolsb
     sb.serialize_bytes(m_block.data(), data_size);
 
     // fix desc offsets and compute idxmap
+    m_idxmap.reserve(descs_cnt);
     uint32_t idx = 0;
     for (auto& desc : m_descs)
     {
@@ -331,14 +327,8 @@ protected:
 
   std::vector<str_desc> m_descs;
 
-  // lookup
-
-  struct identity_op {
-    size_t operator()(uint64_t key) const { return key; }
-  };
-
-  // key: fnv1a64_hash
-  std::unordered_map<uint64_t, uint32_t, identity_op> m_idxmap;
+  // lookup, key: fnv1a64_hash
+  hash_index m_idxmap;
 };
 
 } // namespace cp
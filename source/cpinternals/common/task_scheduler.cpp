@@ -0,0 +1,531 @@
+#include <cpinternals/common/task_scheduler.hpp>
+
+#include <array>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+#include <cpinternals/common/parallel.hpp>
+
+namespace cp {
+
+namespace sched_detail {
+
+struct group_state
+{
+  group_state(task_priority prio, cancellation_token token)
+    : prio(prio), token(std::move(token)) {}
+
+  const task_priority prio;
+  const cancellation_token token;
+
+  std::atomic<size_t> pending = 0; // queued or running
+  std::atomic<size_t> queued = 0;
+  std::atomic<bool> failed = false;
+
+  // signaled when pending reaches 0 or a task is queued
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::exception_ptr first_exception;
+
+  bool is_cancelled() const
+  {
+    return failed.load(std::memory_order_relaxed) || token.is_cancelled();
+  }
+
+  void notify()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+    }
+    cv.notify_all();
+  }
+
+  void fail(std::exception_ptr e)
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!failed.exchange(true))
+    {
+      first_exception = std::move(e);
+    }
+  }
+};
+
+} // namespace sched_detail
+
+using sched_detail::group_state;
+
+namespace {
+
+constexpr size_t priorities_cnt = static_cast<size_t>(task_priority::count_);
+
+struct task
+{
+  task_scheduler::task_fn fn;
+  std::shared_ptr<group_state> group; // null for submit()
+  task_priority prio = task_priority::normal;
+  void* job_ctx = nullptr;
+};
+
+struct task_queue
+{
+  std::mutex mtx;
+  std::array<std::deque<task>, priorities_cnt> tasks;
+};
+
+// index of the worker running on this thread, there is a single scheduler
+thread_local size_t tls_worker_idx = SIZE_MAX;
+thread_local task_priority tls_priority = task_priority::normal;
+thread_local void* tls_job_ctx = nullptr;
+
+std::mutex s_config_mtx;
+size_t s_configured_workers_cnt = 0;
+bool s_started = false;
+
+size_t take_configured_workers_count()
+{
+  std::lock_guard<std::mutex> lock(s_config_mtx);
+  s_started = true;
+
+  if (s_configured_workers_cnt)
+  {
+    return s_configured_workers_cnt;
+  }
+
+  if (const char* env = std::getenv("CP_WORKERS"))
+  {
+    const size_t cnt = std::strtoul(env, nullptr, 10);
+    if (cnt)
+    {
+      return cnt;
+    }
+  }
+
+  return std::max<size_t>(1, hardware_workers_count() - 1);
+}
+
+} // namespace
+
+struct task_scheduler::impl
+{
+  // set before the workers start
+  size_t workers_cnt = 0;
+  // one per worker, the last one is shared by the other threads
+  std::vector<std::unique_ptr<task_queue>> queues;
+  std::vector<std::thread> threads;
+
+  std::atomic<size_t> queued_cnt = 0;
+  std::mutex sleep_mtx;
+  std::condition_variable sleep_cv;
+  bool stopping = false;
+
+  size_t workers_count() const
+  {
+    return workers_cnt;
+  }
+
+  task_queue& local_queue()
+  {
+    return tls_worker_idx < workers_count() ? *queues[tls_worker_idx] : *queues.back();
+  }
+
+  void push(task&& t)
+  {
+    const std::shared_ptr<group_state> group = t.group;
+    if (group)
+    {
+      group->pending.fetch_add(1);
+      group->queued.fetch_add(1);
+    }
+
+    {
+      auto& q = local_queue();
+      std::lock_guard<std::mutex> lock(q.mtx);
+      q.tasks[static_cast<size_t>(t.prio)].push_back(std::move(t));
+    }
+
+    queued_cnt.fetch_add(1);
+    {
+      std::lock_guard<std::mutex> lock(sleep_mtx);
+    }
+    sleep_cv.notify_one();
+
+    // a waiter of the group may run it
+    if (group)
+    {
+      group->notify();
+    }
+  }
+
+  void on_taken(task& t)
+  {
+    queued_cnt.fetch_sub(1);
+    if (t.group)
+    {
+      t.group->queued.fetch_sub(1);
+    }
+  }
+
+  bool take_back(task_queue& q, size_t prio, task& out)
+  {
+    std::lock_guard<std::mutex> lock(q.mtx);
+    auto& dq = q.tasks[prio];
+    if (dq.empty())
+    {
+      return false;
+    }
+    out = std::move(dq.back());
+    dq.pop_back();
+    return true;
+  }
+
+  bool take_front(task_queue& q, size_t prio, task& out)
+  {
+    std::lock_guard<std::mutex> lock(q.mtx);
+    auto& dq = q.tasks[prio];
+    if (dq.empty())
+    {
+      return false;
+    }
+    out = std::move(dq.front());
+    dq.pop_front();
+    return true;
+  }
+
+  // own queue first (newest task), then the shared one and the other
+  // workers' (oldest task), priority by priority
+  bool take_any(task& out)
+  {
+    const size_t self = tls_worker_idx;
+    const size_t workers_cnt = workers_count();
+
+    for (size_t prio = 0; prio < priorities_cnt; ++prio)
+    {
+      bool found = self < workers_cnt && take_back(*queues[self], prio, out);
+      found = found || take_front(*queues.back(), prio, out);
+      for (size_t i = 1; !found && i < workers_cnt; ++i)
+      {
+        found = take_front(*queues[(self + i) % workers_cnt], prio, out);
+      }
+
+      if (found)
+      {
+        on_taken(out);
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  bool take_of_group(const group_state* group, task& out)
+  {
+    if (!group->queued.load())
+    {
+      return false;
+    }
+
+    const size_t prio = static_cast<size_t>(group->prio);
+
+    // the local queue has the most recent tasks of the group
+    task_queue* const local = &local_queue();
+    auto try_queue = [&](task_queue& q, bool newest_first) -> bool
+    {
+      std::lock_guard<std::mutex> lock(q.mtx);
+      auto& dq = q.tasks[prio];
+      const size_t cnt = dq.size();
+      for (size_t i = 0; i < cnt; ++i)
+      {
+        const auto it = dq.begin() + (newest_first ? cnt - 1 - i : i);
+        if (it->group.get() == group)
+        {
+          out = std::move(*it);
+          dq.erase(it);
+          return true;
+        }
+      }
+      return false;
+    };
+
+    bool found = try_queue(*local, true);
+    for (size_t i = 0; !found && i < queues.size(); ++i)
+    {
+      found = queues[i].get() != local && try_queue(*queues[i], false);
+    }
+
+    if (found)
+    {
+      on_taken(out);
+    }
+    return found;
+  }
+
+  static void execute(task& t)
+  {
+    const task_priority prev_priority = tls_priority;
+    void* const prev_job_ctx = tls_job_ctx;
+    tls_priority = t.prio;
+    tls_job_ctx = t.job_ctx;
+
+    group_state* const group = t.group.get();
+    if (!group)
+    {
+      t.fn();
+    }
+    else
+    {
+      if (!group->is_cancelled())
+      {
+        try
+        {
+          t.fn();
+        }
+        catch (...)
+        {
+          group->fail(std::current_exception());
+        }
+      }
+
+      if (group->pending.fetch_sub(1) == 1)
+      {
+        group->notify();
+      }
+    }
+
+    tls_priority = prev_priority;
+    tls_job_ctx = prev_job_ctx;
+  }
+
+  void worker_loop(size_t idx)
+  {
+    tls_worker_idx = idx;
+
+    while (true)
+    {
+      task t;
+      if (take_any(t))
+      {
+        execute(t);
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(sleep_mtx);
+      sleep_cv.wait(lock, [this]() { return stopping || queued_cnt.load() > 0; });
+      if (stopping && queued_cnt.load() == 0)
+      {
+        return;
+      }
+    }
+  }
+};
+
+task_scheduler& task_scheduler::get()
+{
+  static task_scheduler s_instance(take_configured_workers_count());
+  return s_instance;
+}
+
+bool task_scheduler::configure(size_t workers_cnt)
+{
+  std::lock_guard<std::mutex> lock(s_config_mtx);
+  if (s_started)
+  {
+    return false;
+  }
+
+  s_configured_workers_cnt = workers_cnt;
+  return true;
+}
+
+task_priority task_scheduler::current_priority()
+{
+  return tls_priority;
+}
+
+void* task_scheduler::current_job_context()
+{
+  return tls_job_ctx;
+}
+
+task_scheduler::task_scheduler(size_t workers_cnt)
+  : m_impl(std::make_unique<impl>())
+{
+  m_impl->workers_cnt = workers_cnt;
+  for (size_t i = 0; i < workers_cnt + 1; ++i)
+  {
+    m_impl->queues.emplace_back(std::make_unique<task_queue>());
+  }
+
+  // the queues must exist before the first worker looks at them
+  m_impl->threads.reserve(workers_cnt);
+  for (size_t i = 0; i < workers_cnt; ++i)
+  {
+    m_impl->threads.emplace_back([this, i]() { m_impl->worker_loop(i); });
+  }
+
+  SPDLOG_DEBUG("task scheduler started with {} workers", workers_cnt);
+}
+
+task_scheduler::~task_scheduler()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_impl->sleep_mtx);
+    m_impl->stopping = true;
+  }
+  m_impl->sleep_cv.notify_all();
+
+  for (auto& t : m_impl->threads)
+  {
+    t.join();
+  }
+}
+
+size_t task_scheduler::workers_count() const
+{
+  return m_impl->workers_count();
+}
+
+void task_scheduler::submit(task_fn fn, task_priority prio)
+{
+  task t;
+  t.fn = std::move(fn);
+  t.prio = prio;
+  t.job_ctx = tls_job_ctx;
+  m_impl->push(std::move(t));
+}
+
+//--------------------------------------------------------
+
+task_group::task_group(task_priority prio, cancellation_token token)
+  : m_state(std::make_shared<group_state>(prio, std::move(token)))
+{
+}
+
+task_group::~task_group()
+{
+  try
+  {
+    wait();
+  }
+  catch (...)
+  {
+  }
+}
+
+void task_group::run(task_scheduler::task_fn fn)
+{
+  task t;
+  t.fn = std::move(fn);
+  t.group = m_state;
+  t.prio = m_state->prio;
+  t.job_ctx = tls_job_ctx;
+  task_scheduler::get().m_impl->push(std::move(t));
+}
+
+void task_group::run_and_wait(const task_scheduler::task_fn& fn)
+{
+  if (!is_cancelled())
+  {
+    const task_priority prev_priority = tls_priority;
+    tls_priority = m_state->prio;
+    try
+    {
+      fn();
+    }
+    catch (...)
+    {
+      m_state->fail(std::current_exception());
+    }
+    tls_priority = prev_priority;
+  }
+
+  wait();
+}
+
+void task_group::wait()
+{
+  auto& sched = *task_scheduler::get().m_impl;
+  group_state& gs = *m_state;
+
+  while (gs.pending.load())
+  {
+    task t;
+    if (sched.take_of_group(&gs, t))
+    {
+      sched.execute(t);
+      continue;
+    }
+
+    // the remaining tasks are running on other threads
+    std::unique_lock<std::mutex> lock(gs.mtx);
+    gs.cv.wait(lock, [&]() { return !gs.pending.load() || gs.queued.load(); });
+  }
+
+  std::exception_ptr e;
+  {
+    std::lock_guard<std::mutex> lock(gs.mtx);
+    e = std::move(gs.first_exception);
+    gs.first_exception = nullptr;
+    gs.failed = false;
+  }
+
+  if (e)
+  {
+    std::rethrow_exception(e);
+  }
+}
+
+bool task_group::try_run_one()
+{
+  auto& sched = *task_scheduler::get().m_impl;
+
+  task t;
+  if (!sched.take_of_group(m_state.get(), t))
+  {
+    return false;
+  }
+
+  sched.execute(t);
+  return true;
+}
+
+bool task_group::is_done() const
+{
+  return !m_state->pending.load();
+}
+
+void task_group::cancel()
+{
+  m_state->token.cancel();
+}
+
+bool task_group::is_cancelled() const
+{
+  return m_state->is_cancelled();
+}
+
+const cancellation_token& task_group::token() const
+{
+  return m_state->token;
+}
+
+//--------------------------------------------------------
+
+scoped_job_context::scoped_job_context(void* ctx)
+  : m_prev(tls_job_ctx)
+{
+  tls_job_ctx = ctx;
+}
+
+scoped_job_context::~scoped_job_context()
+{
+  tls_job_ctx = m_prev;
+}
+
+} // namespace cp
+
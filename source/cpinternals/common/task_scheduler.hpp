@@ -0,0 +1,172 @@
+#pragma once
+#include <inttypes.h>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+
+namespace cp {
+
+// Shared pool of worker threads for the cpu work of cpinternals and appbase
+// (parallel_for, archive extraction, ui jobs), so that nested and concurrent
+// parallel paths don't oversubscribe the cores.
+// Each worker has its own deque of tasks, it pushes and pops at the back
+// and idle workers steal from the front of the others; tasks submitted by
+// other threads go to a shared queue. Higher priority tasks run first, a
+// task inherits the priority and the job context (see scoped_job_context)
+// of the thread that submits it.
+// Waiting on a task_group runs its queued tasks on the waiting thread, so
+// that nested fork/join doesn't deadlock. Only tasks of that group are run
+// so that the thread-local state of the waiter (span sink, allocation tag,
+// job memory budget..) doesn't apply to unrelated tasks.
+// Blocking work (i/o waits) belongs to dedicated threads, see task_pool.
+
+enum class task_priority : uint8_t
+{
+  high,       // interactive (ui) jobs
+  normal,
+  background, // delayed by the others
+  count_
+};
+
+// cancellation flag shared by its copies
+class cancellation_token
+{
+public:
+  cancellation_token()
+    : m_flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+  void cancel() const
+  {
+    m_flag->store(true, std::memory_order_relaxed);
+  }
+
+  bool is_cancelled() const
+  {
+    return m_flag->load(std::memory_order_relaxed);
+  }
+
+  // for apis polling a flag (e.g. progress_t::cancel)
+  std::atomic<bool>* flag() const
+  {
+    return m_flag.get();
+  }
+
+private:
+  std::shared_ptr<std::atomic<bool>> m_flag;
+};
+
+namespace sched_detail {
+
+struct group_state;
+
+} // namespace sched_detail
+
+class task_scheduler
+{
+public:
+  using task_fn = std::function<void()>;
+
+  static task_scheduler& get();
+
+  // worker threads of the shared scheduler, false once it is started.
+  // 0 (default) means CP_WORKERS if set, or one less than the hardware
+  // threads (the submitting threads work too).
+  static bool configure(size_t workers_cnt);
+
+  // priority of the task running on the calling thread, normal outside of tasks
+  static task_priority current_priority();
+
+  // context of the job the calling thread works for, null outside of jobs
+  static void* current_job_context();
+
+  ~task_scheduler();
+
+  task_scheduler(const task_scheduler&) = delete;
+  task_scheduler& operator=(const task_scheduler&) = delete;
+
+  size_t workers_count() const;
+
+  // fire and forget, fn must not throw
+  void submit(task_fn fn, task_priority prio = current_priority());
+
+  // like std::async, but the future doesn't wait for the task on destruction
+  template <typename Fn>
+  std::future<std::invoke_result_t<Fn>> async(Fn&& fn, task_priority prio = current_priority())
+  {
+    using result_type = std::invoke_result_t<Fn>;
+    auto pt = std::make_shared<std::packaged_task<result_type()>>(std::forward<Fn>(fn));
+    auto ret = pt->get_future();
+    submit([pt]() { (*pt)(); }, prio);
+    return ret;
+  }
+
+protected:
+  friend class task_group;
+
+  explicit task_scheduler(size_t workers_cnt);
+
+  struct impl;
+  std::unique_ptr<impl> m_impl;
+};
+
+// Tasks that are waited for together (fork/join).
+// The first exception thrown by a task is rethrown by wait(), once a task
+// failed or the group is cancelled its tasks that didn't start are skipped
+// (running ones can poll is_cancelled).
+class task_group
+{
+public:
+  explicit task_group(task_priority prio = task_scheduler::current_priority(), cancellation_token token = {});
+
+  // waits, exceptions of the tasks are dropped
+  ~task_group();
+
+  task_group(const task_group&) = delete;
+  task_group& operator=(const task_group&) = delete;
+
+  void run(task_scheduler::task_fn fn);
+
+  // runs fn on the calling thread as a task of the group, then waits
+  void run_and_wait(const task_scheduler::task_fn& fn);
+
+  void wait();
+
+  // runs a queued task of the group on the calling thread, false if there is none
+  bool try_run_one();
+
+  // no task queued or running
+  bool is_done() const;
+
+  void cancel();
+
+  // cancelled, or a task failed
+  bool is_cancelled() const;
+
+  const cancellation_token& token() const;
+
+private:
+  std::shared_ptr<sched_detail::group_state> m_state;
+};
+
+// Sets the job context of the calling thread for its lifetime, the tasks
+// submitted meanwhile (and theirs) run with it.
+// The context is opaque to the scheduler, it is for state that follows a
+// job on the workers it fans out to (e.g. the memory budget of a
+// csav_batch job, checked by its operator new). It must outlive the tasks.
+class scoped_job_context
+{
+public:
+  explicit scoped_job_context(void* ctx);
+  ~scoped_job_context();
+
+  scoped_job_context(const scoped_job_context&) = delete;
+  scoped_job_context& operator=(const scoped_job_context&) = delete;
+
+private:
+  void* m_prev;
+};
+
+} // namespace cp
+
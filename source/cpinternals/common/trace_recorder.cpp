@@ -0,0 +1,244 @@
+#include <cpinternals/common/trace_recorder.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+#include <cpinternals/common/json_writer.hpp>
+
+namespace cp {
+
+namespace {
+
+struct trace_event_t
+{
+  const char* name;
+  std::string label;
+  trace_recorder::clock_type::time_point start;
+  trace_recorder::clock_type::time_point end;
+  uint64_t bytes;
+};
+
+struct thread_buffer
+{
+  uint32_t tid = 0;
+  uint32_t generation = 0;
+  // only contended when the trace is written
+  std::mutex mtx;
+  std::vector<trace_event_t> events;
+};
+
+struct recorder_state
+{
+  std::mutex mtx;
+  std::filesystem::path path;
+  trace_recorder::clock_type::time_point epoch;
+  // incremented by start(), buffers of previous recordings are replaced
+  std::atomic<uint32_t> generation = 0;
+  uint32_t next_tid = 1;
+  std::vector<std::shared_ptr<thread_buffer>> buffers;
+};
+
+recorder_state g_state;
+
+thread_local std::shared_ptr<thread_buffer> tls_buffer;
+
+thread_buffer& current_buffer()
+{
+  if (tls_buffer && tls_buffer->generation == g_state.generation.load(std::memory_order_relaxed))
+  {
+    return *tls_buffer;
+  }
+
+  std::lock_guard<std::mutex> lock(g_state.mtx);
+  if (!tls_buffer || tls_buffer->generation != g_state.generation)
+  {
+    tls_buffer = std::make_shared<thread_buffer>();
+    tls_buffer->tid = g_state.next_tid++;
+    tls_buffer->generation = g_state.generation;
+    g_state.buffers.push_back(tls_buffer);
+  }
+  return *tls_buffer;
+}
+
+// "csav.lz4_decode" -> "csav"
+std::string_view category_of(std::string_view name)
+{
+  const size_t pos = name.find('.');
+  return pos == std::string_view::npos ? name : name.substr(0, pos);
+}
+
+double to_us(trace_recorder::clock_type::duration d)
+{
+  return std::chrono::duration<double, std::micro>(d).count();
+}
+
+} // namespace
+
+namespace instr_detail {
+
+void trace_event(const char* name, std::string_view label,
+  std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end, uint64_t bytes)
+{
+  trace_recorder::get().record(name, label, start, end, bytes);
+}
+
+} // namespace instr_detail
+
+trace_recorder& trace_recorder::get()
+{
+  static trace_recorder s_instance;
+  return s_instance;
+}
+
+bool trace_recorder::start(const std::filesystem::path& path, bool stop_at_exit)
+{
+  {
+    std::lock_guard<std::mutex> lock(g_state.mtx);
+    if (is_tracing())
+    {
+      return false;
+    }
+
+    g_state.path = path;
+    g_state.epoch = clock_type::now();
+    ++g_state.generation;
+    g_state.next_tid = 1;
+    g_state.buffers.clear();
+
+    instr_detail::tracing = true;
+  }
+
+  SPDLOG_INFO("recording a trace to {}", path.string());
+
+  // registered after the first use of the logger, so that it still exists
+  static std::once_flag s_atexit_flag;
+  if (stop_at_exit)
+  {
+    std::call_once(s_atexit_flag, []() {
+      std::atexit([]() { trace_recorder::get().stop(); });
+    });
+  }
+
+  return true;
+}
+
+bool trace_recorder::start_from_env()
+{
+  const char* env = std::getenv(env_var);
+  return env && *env && start(env, true);
+}
+
+bool trace_recorder::stop()
+{
+  std::vector<std::shared_ptr<thread_buffer>> buffers;
+  std::filesystem::path path;
+  clock_type::time_point epoch;
+  {
+    std::lock_guard<std::mutex> lock(g_state.mtx);
+    if (!is_tracing())
+    {
+      return false;
+    }
+
+    instr_detail::tracing = false;
+    buffers = std::move(g_state.buffers);
+    g_state.buffers.clear();
+    path = std::move(g_state.path);
+    epoch = g_state.epoch;
+  }
+
+  std::ofstream ofs(path, std::ios::binary);
+  if (!ofs.is_open())
+  {
+    SPDLOG_ERROR("couldn't open {}", path.string());
+    return false;
+  }
+
+  size_t events_cnt = 0;
+  {
+    json_writer w(ofs);
+    w.begin_object();
+    w.key("displayTimeUnit").value("ms");
+    w.key("traceEvents").begin_array();
+
+    for (const auto& buf : buffers)
+    {
+      // spans still open on other threads when stopping are lost
+      std::lock_guard<std::mutex> lock(buf->mtx);
+
+      w.begin_object();
+      w.key("name").value("thread_name");
+      w.key("ph").value("M");
+      w.key("pid").value(1u);
+      w.key("tid").value(buf->tid);
+      w.key("args").begin_object();
+      w.key("name").value(fmt::format("thread {}", buf->tid));
+      w.end_object();
+      w.end_object();
+
+      for (const auto& e : buf->events)
+      {
+        w.begin_object();
+        w.key("name").value(e.name);
+        w.key("cat").value(category_of(e.name));
+        w.key("ph").value("X");
+        w.key("ts").value(to_us(e.start - epoch));
+        w.key("dur").value(to_us(e.end - e.start));
+        w.key("pid").value(1u);
+        w.key("tid").value(buf->tid);
+        if (e.label.size() || e.bytes)
+        {
+          w.key("args").begin_object();
+          if (e.label.size())
+          {
+            w.key("label").value(e.label);
+          }
+          if (e.bytes)
+          {
+            w.key("bytes").value(e.bytes);
+          }
+          w.end_object();
+        }
+        w.end_object();
+      }
+
+      events_cnt += buf->events.size();
+      buf->events.clear();
+      buf->events.shrink_to_fit();
+    }
+
+    w.end_array();
+    w.end_object();
+  }
+
+  if (!ofs)
+  {
+    SPDLOG_ERROR("couldn't write {}", path.string());
+    return false;
+  }
+
+  SPDLOG_INFO("trace of {} events written to {}", events_cnt, path.string());
+  return true;
+}
+
+void trace_recorder::record(const char* name, std::string_view label, clock_type::time_point start, clock_type::time_point end, uint64_t bytes)
+{
+  // the span may have started before the recording
+  if (!is_tracing())
+  {
+    return;
+  }
+
+  thread_buffer& buf = current_buffer();
+  std::lock_guard<std::mutex> lock(buf.mtx);
+  buf.events.push_back({name, std::string(label), start, end, bytes});
+}
+
+} // namespace cp
+
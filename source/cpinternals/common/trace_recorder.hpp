@@ -0,0 +1,46 @@
+#pragma once
+#include <inttypes.h>
+#include <chrono>
+#include <filesystem>
+#include <string_view>
+
+#include <cpinternals/common/instrumentation.hpp>
+
+namespace cp {
+
+// Records the spans of all threads as Chrome trace events, to see on a
+// timeline how the work of the parallel pipelines overlaps (load it in
+// chrome://tracing or ui.perfetto.dev).
+// Events are buffered per thread (a thread's first event allocates its
+// buffer) and written as JSON by stop(), with a thread id per recording
+// thread in order of first event.
+// Programs enable it from the CP_TRACE environment variable (path of the
+// trace file, see start_from_env) or from a command line flag.
+struct trace_recorder
+{
+  using clock_type = std::chrono::steady_clock;
+
+  static constexpr const char* env_var = "CP_TRACE";
+
+  static trace_recorder& get();
+
+  // false if already recording. with stop_at_exit, the trace is written at
+  // exit unless stop() is called before.
+  bool start(const std::filesystem::path& path, bool stop_at_exit = false);
+
+  // starts recording to the path in CP_TRACE if it is set, until exit
+  bool start_from_env();
+
+  // stops recording and writes the trace, false if it couldn't be written
+  bool stop();
+
+  bool is_recording() const
+  {
+    return is_tracing();
+  }
+
+  void record(const char* name, std::string_view label, clock_type::time_point start, clock_type::time_point end, uint64_t bytes);
+};
+
+} // namespace cp
+
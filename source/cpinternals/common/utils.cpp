@@ -143,5 +143,84 @@ std::vector<uintptr_t> sse2_strstr(uintptr_t hs, size_t m, const uint8_t* needle
   return ret;
 }
 
+void sse2_find_pattern(const uint8_t* hs, size_t m, const uint8_t* needle, size_t n, const char* mask, std::vector<size_t>& out, size_t maxcnt)
+{
+  if (n == 0 || m < n)
+    return;
+
+  if (mask && mask[0] == '\0')
+    mask = nullptr;
+
+  const auto is_solid = [mask](size_t i) { return !mask || mask[i] != '?'; };
+
+  // candidates are filtered on the first and last compared bytes
+  size_t a = 0;
+  while (a < n && !is_solid(a))
+    ++a;
+
+  const size_t last_pos = m - n;
+
+  if (a == n)
+  {
+    // wildcards only
+    for (size_t pos = 0; pos <= last_pos; ++pos)
+    {
+      out.push_back(pos);
+      if (maxcnt && out.size() == maxcnt)
+        return;
+    }
+    return;
+  }
+
+  size_t b = n - 1;
+  while (!is_solid(b))
+    --b;
+
+  const auto match_at = [=](const uint8_t* pc) -> bool
+  {
+    if (!mask)
+      return !memcmp(pc, needle, n);
+    for (size_t i = a + 1; i < b; ++i)
+    {
+      if (mask[i] != '?' && pc[i] != needle[i])
+        return false;
+    }
+    return true;
+  };
+
+  const __m128i headblk = _mm_set1_epi8((char)needle[a]);
+  const __m128i tailblk = _mm_set1_epi8((char)needle[b]);
+
+  size_t pos = 0;
+  for (; pos + 15 <= last_pos; pos += 16)
+  {
+    const uint8_t* pc = hs + pos;
+
+    uint16_t bitmask = candidates_lookup(headblk, tailblk, pc + a, pc + b);
+    while (bitmask != 0)
+    {
+      const auto match_offset = ctz(bitmask);
+      if (match_at(pc + match_offset))
+      {
+        out.push_back(pos + match_offset);
+        if (maxcnt && out.size() == maxcnt)
+          return;
+      }
+      bitmask &= bitmask - 1;
+    }
+  }
+
+  for (; pos <= last_pos; ++pos)
+  {
+    const uint8_t* pc = hs + pos;
+    if (pc[a] == needle[a] && pc[b] == needle[b] && match_at(pc))
+    {
+      out.push_back(pos);
+      if (maxcnt && out.size() == maxcnt)
+        return;
+    }
+  }
+}
+
 } // namespace cp
 
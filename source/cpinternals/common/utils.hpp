@@ -2,6 +2,8 @@
 #include <inttypes.h>
 #include <intrin.h>
 #include <vector>
+#include <memory>
+#include <new>
 #include <algorithm>
 #include <type_traits>
 
@@ -29,6 +31,24 @@ struct nop_mutex
   void unlock_shared() {}
 };
 
+// page-aligned heap buffer (file i/o buffers)
+struct page_aligned_delete
+{
+  static constexpr size_t alignment = 0x1000;
+
+  void operator()(char* p) const
+  {
+    ::operator delete[](p, std::align_val_t(alignment));
+  }
+};
+
+using page_aligned_buffer = std::unique_ptr<char[], page_aligned_delete>;
+
+inline page_aligned_buffer make_page_aligned_buffer(size_t size)
+{
+  return page_aligned_buffer(new (std::align_val_t(page_aligned_delete::alignment)) char[size]);
+}
+
 inline bool starts_with(const std::string& str, const std::string& with)
 {
   return with.length() <= str.length()
@@ -239,6 +259,12 @@ insert_sorted_nodupe(std::vector<T>& vec, typename std::vector<T>::iterator star
 std::vector<uintptr_t> sse2_strstr_masked(uintptr_t hs, size_t m, const uint8_t* needle, size_t n, const char* mask, size_t maxcnt = 0);
 std::vector<uintptr_t> sse2_strstr(uintptr_t hs, size_t m, const uint8_t* needle, size_t n, size_t maxcnt = 0);
 
+// masked search ('x': compared, '?': any byte), mask can be null or empty
+// (all bytes compared) and can start or end with wildcards.
+// handles any haystack size (tail is scanned without simd), offsets are
+// appended to out. stops at maxcnt matches if not 0.
+void sse2_find_pattern(const uint8_t* hs, size_t m, const uint8_t* needle, size_t n, const char* mask, std::vector<size_t>& out, size_t maxcnt = 0);
+
 inline std::vector<uintptr_t> sse2_strstr_masked(const void* hs, size_t m, const uint8_t* needle, size_t n, const char* mask, size_t maxcnt = 0)
 {
   return sse2_strstr_masked((uintptr_t)hs, m, needle, n, mask, maxcnt);
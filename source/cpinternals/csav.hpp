@@ -1,6 +1,7 @@
 #pragma once
 #include <cpinternals/csav/node.hpp>
 #include <cpinternals/csav/node_tree.hpp>
+#include <cpinternals/csav/node_search.hpp>
 #include <cpinternals/csav/savegame.hpp>
 
 namespace cp {
@@ -0,0 +1,331 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "cpinternals/common.hpp"
+#include "cpinternals/csav/node.hpp"
+#include "cpinternals/csav/serial_tree.hpp"
+
+namespace cp::csav {
+
+// Alternative to the node_t tree for headless tools.
+// Nodes are indices into one contiguous descriptor array and their data is a
+// view into the decompressed buffer (nodedata). Edited nodes get their own
+// copy of the data (copy-on-write), the buffer itself is never modified.
+// Layout is the same as the one lifted by serial_tree::to_tree:
+// nodes with children have their data split into blob children.
+struct flat_tree
+{
+  using node_idx = int32_t;
+
+  static constexpr node_idx null_idx = -1;
+  static constexpr node_idx root_idx = 0;
+
+  struct node
+  {
+    int32_t   cidx        = node_t::null_node_idx; // index in the csav (-2 root, -3 blob)
+    node_idx  parent      = null_idx;
+    node_idx  first_child = null_idx;
+    node_idx  next        = null_idx;
+
+    uint32_t  data_offset = 0;  // in buffer, without the u32 idx prefix
+    uint32_t  data_size   = 0;
+    int32_t   cow_idx     = -1; // index in m_cow_datas if edited
+
+    bool is_root() const { return cidx == node_t::root_node_idx; }
+    bool is_blob() const { return cidx == node_t::blob_node_idx; }
+    bool is_cnode() const { return cidx >= 0; }
+    bool has_children() const { return first_child != null_idx; }
+  };
+
+  flat_tree() = default;
+
+  flat_tree(const flat_tree&) = delete;
+  flat_tree& operator=(const flat_tree&) = delete;
+
+  flat_tree(flat_tree&&) = default;
+  flat_tree& operator=(flat_tree&&) = default;
+
+  // takes ownership of stree's buffer and descriptors.
+  // data_offset is the offset of the first chunk (see serial_tree::to_tree).
+  bool build(serial_tree&& stree, uint32_t data_offset)
+  {
+    clear();
+
+    m_buffer = std::move(stree.nodedata);
+    {
+      // interned in one batch, to_node reuses them
+      std::vector<std::string_view> names(stree.descs.size());
+      for (size_t i = 0; i < names.size(); ++i)
+      {
+        names[i] = stree.descs[i].name;
+      }
+      m_names = node_gname::register_strings(names);
+    }
+
+    // blobs roughly double the count of nodes
+    m_nodes.reserve(stree.descs.size() * 2 + 1);
+
+    if (m_buffer.size() < data_offset)
+    {
+      return false;
+    }
+
+    size_t i = 0;
+    for (auto& d : stree.descs)
+    {
+      if ((uint64_t)d.data_offset + 4 > m_buffer.size())
+        return false;
+      if (*(uint32_t*)(m_buffer.data() + d.data_offset) != i++)
+        return false;
+    }
+
+    m_data_offset = data_offset;
+    const uint32_t data_size = (uint32_t)m_buffer.size() - data_offset;
+    serial_node_desc root_desc {"root", node_t::null_node_idx, 0, data_offset, data_size};
+
+    if (read_node(stree.descs, root_desc, node_t::root_node_idx, null_idx) != root_idx)
+    {
+      clear();
+      return false;
+    }
+
+    stree.descs.clear();
+    return true;
+  }
+
+  void clear()
+  {
+    m_nodes.clear();
+    m_names.clear();
+    m_buffer.clear();
+    m_cow_datas.clear();
+    m_data_offset = 0;
+  }
+
+  bool empty() const
+  {
+    return m_nodes.empty();
+  }
+
+  size_t size() const
+  {
+    return m_nodes.size();
+  }
+
+  const node& at(node_idx idx) const
+  {
+    return m_nodes[idx];
+  }
+
+  std::string_view name(node_idx idx) const
+  {
+    const auto& n = m_nodes[idx];
+    if (n.is_root())
+      return "root";
+    if (n.is_blob())
+      return "datablob";
+    return m_names[n.cidx].strv();
+  }
+
+  std::span<const char> data(node_idx idx) const
+  {
+    const auto& n = m_nodes[idx];
+    if (n.cow_idx >= 0)
+    {
+      return m_cow_datas[n.cow_idx];
+    }
+    return { m_buffer.data() + n.data_offset, n.data_size };
+  }
+
+  // copy-on-write, the original buffer is kept intact
+  void assign_data(node_idx idx, std::span<const char> data)
+  {
+    auto& n = m_nodes[idx];
+    if (n.cow_idx < 0)
+    {
+      n.cow_idx = (int32_t)m_cow_datas.size();
+      m_cow_datas.emplace_back();
+    }
+    m_cow_datas[n.cow_idx].assign(data.begin(), data.end());
+  }
+
+  bool is_edited(node_idx idx) const
+  {
+    return m_nodes[idx].cow_idx >= 0;
+  }
+
+  // returns null_idx if not found
+  node_idx find_child(node_idx parent, std::string_view child_name) const
+  {
+    for (node_idx c = m_nodes[parent].first_child; c != null_idx; c = m_nodes[c].next)
+    {
+      if (name(c) == child_name)
+        return c;
+    }
+    return null_idx;
+  }
+
+  // depth-first search, returns null_idx if not found
+  node_idx find_node(std::string_view node_name) const
+  {
+    for (node_idx i = 0; i < (node_idx)m_nodes.size(); ++i)
+    {
+      if (m_nodes[i].is_cnode() && name(i) == node_name)
+        return i;
+    }
+    return null_idx;
+  }
+
+  // same as node_t::calcsize
+  size_t calcsize(node_idx idx = root_idx) const
+  {
+    const auto& n = m_nodes[idx];
+    size_t size = data(idx).size() + (n.is_cnode() ? 4 : 0);
+    for (node_idx c = n.first_child; c != null_idx; c = m_nodes[c].next)
+    {
+      size += calcsize(c);
+    }
+    return size;
+  }
+
+  // validates the layout from the descriptors only (no node_t is built),
+  // same check as the one done on the lifted tree in node_tree::serialize_in
+  bool validate() const
+  {
+    return !empty() && calcsize(root_idx) + m_data_offset == m_buffer.size();
+  }
+
+  using substitutes_map = std::unordered_map<node_idx, std::shared_ptr<const node_t>>;
+
+  // builds a regular node_t subtree (e.g. to use existing node_serializables)
+  std::shared_ptr<const node_t> to_node(node_idx idx = root_idx) const
+  {
+    return to_node(idx, nullptr);
+  }
+
+  // same but nodes present in substitutes are used instead of being built
+  // (e.g. subtrees that have been lifted and edited beforehand)
+  std::shared_ptr<const node_t> to_node(node_idx idx, const substitutes_map* substitutes) const
+  {
+    if (substitutes)
+    {
+      auto it = substitutes->find(idx);
+      if (it != substitutes->end())
+        return it->second;
+    }
+
+    const auto& n = m_nodes[idx];
+    auto new_node = n.is_cnode()
+      ? node_t::create_shared(n.cidx, m_names[n.cidx])
+      : node_t::create_shared(n.cidx, name(idx));
+    auto& nc = new_node->nonconst();
+
+    if (n.has_children())
+    {
+      std::vector<std::shared_ptr<const node_t>> children;
+      for (node_idx c = n.first_child; c != null_idx; c = m_nodes[c].next)
+      {
+        children.emplace_back(to_node(c, substitutes));
+      }
+      nc.assign_children(children);
+    }
+    else
+    {
+      auto d = data(idx);
+      nc.assign_data(d.begin(), d.end());
+    }
+
+    return new_node;
+  }
+
+protected:
+
+  node_idx emplace_node(int32_t cidx, node_idx parent, uint32_t offset, uint32_t size)
+  {
+    const node_idx idx = (node_idx)m_nodes.size();
+    auto& n = m_nodes.emplace_back();
+    n.cidx = cidx;
+    n.parent = parent;
+    n.data_offset = offset;
+    n.data_size = size;
+    return idx;
+  }
+
+  void link_child(node_idx parent, node_idx& last_child, node_idx child)
+  {
+    if (last_child == null_idx)
+      m_nodes[parent].first_child = child;
+    else
+      m_nodes[last_child].next = child;
+    last_child = child;
+  }
+
+  // mirrors serial_tree::read_node
+  node_idx read_node(const std::vector<serial_node_desc>& descs, const serial_node_desc& desc, int32_t cidx, node_idx parent)
+  {
+    uint32_t cur_offset = desc.data_offset + 4;
+    const uint32_t end_offset = desc.data_offset + desc.data_size;
+
+    // root node has no u32 idx
+    if (cidx == node_t::root_node_idx)
+      cur_offset = desc.data_offset;
+
+    if (end_offset > m_buffer.size() || cur_offset > end_offset)
+      return null_idx;
+
+    const node_idx idx = emplace_node(cidx, parent, cur_offset, 0);
+
+    if (desc.child_idx < 0)
+    {
+      m_nodes[idx].data_size = end_offset - cur_offset;
+      return idx;
+    }
+
+    node_idx last_child = null_idx;
+
+    int32_t i = desc.child_idx;
+    while (i >= 0)
+    {
+      if (i >= (int32_t)descs.size()) // corruption ?
+        return null_idx;
+
+      const auto& childdesc = descs[i];
+
+      if (childdesc.data_offset > cur_offset)
+      {
+        node_idx blob = emplace_node(node_t::blob_node_idx, idx, cur_offset, childdesc.data_offset - cur_offset);
+        link_child(idx, last_child, blob);
+      }
+
+      node_idx child = read_node(descs, childdesc, i, idx);
+      if (child == null_idx) // something went wrong
+        return null_idx;
+      link_child(idx, last_child, child);
+
+      cur_offset = childdesc.data_offset + childdesc.data_size;
+      i = childdesc.next_idx;
+    }
+
+    if (cur_offset < end_offset)
+    {
+      node_idx blob = emplace_node(node_t::blob_node_idx, idx, cur_offset, end_offset - cur_offset);
+      link_child(idx, last_child, blob);
+    }
+
+    return idx;
+  }
+
+private:
+
+  std::vector<node> m_nodes;
+  std::vector<node_gname> m_names;          // by csav index
+  std::vector<char> m_buffer;               // decompressed csav data
+  std::vector<std::vector<char>> m_cow_datas;
+  uint32_t m_data_offset = 0;
+};
+
+} // namespace cp::csav
+
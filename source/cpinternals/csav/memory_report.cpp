@@ -0,0 +1,105 @@
+#include "memory_report.hpp"
+
+#include <algorithm>
+
+#include <cpinternals/common/instrumentation.hpp>
+
+namespace cp::csav {
+
+namespace {
+
+std::string format_count(size_t cnt)
+{
+  if (cnt >= 1000000)
+    return fmt::format("{:.1f}M", cnt / 1e6);
+  if (cnt >= 1000)
+    return fmt::format("{:.1f}K", cnt / 1e3);
+  return fmt::format("{}", cnt);
+}
+
+std::string format_bytes(size_t bytes)
+{
+  if (bytes >= (size_t(1) << 20))
+    return fmt::format("{:.1f} MB", bytes / (1024. * 1024.));
+  if (bytes >= (size_t(1) << 10))
+    return fmt::format("{:.1f} KB", bytes / 1024.);
+  return fmt::format("{} B", bytes);
+}
+
+} // namespace
+
+memory_report memory_report::build(savegame& save)
+{
+  scoped_span span("csav.memory_report");
+
+  memory_report report;
+
+  memory_usage systems_nodes;
+  for (const auto& [name, var] : save.systems())
+  {
+    row r;
+    r.name = name;
+
+    if (auto node = save.search_node(name))
+    {
+      memory_usage node_usage;
+      node->accumulate_memory_usage(node_usage);
+      systems_nodes += node_usage;
+      r.usage += node_usage;
+    }
+
+    if (var->has_valid_data)
+    {
+      var->accumulate_memory_usage(r.usage);
+      r.system_loaded = true;
+    }
+
+    report.total += r.usage;
+    report.rows.emplace_back(std::move(r));
+  }
+
+  if (save.root)
+  {
+    memory_usage tree_usage;
+    save.root->accumulate_memory_usage(tree_usage);
+
+    auto& other = report.other_nodes;
+    other.nodes_cnt = tree_usage.nodes_cnt - std::min(tree_usage.nodes_cnt, systems_nodes.nodes_cnt);
+    other.node_bytes = tree_usage.node_bytes - std::min(tree_usage.node_bytes, systems_nodes.node_bytes);
+    report.total += other;
+  }
+
+  span.set_bytes(report.total.total_bytes());
+  return report;
+}
+
+std::string memory_report::to_string() const
+{
+  std::string ret;
+  for (const auto& r : rows)
+  {
+    ret += format_memory_usage(r.name, r.usage);
+    if (!r.system_loaded)
+      ret += " (not loaded)";
+    ret += '\n';
+  }
+  ret += format_memory_usage("other nodes", other_nodes);
+  ret += '\n';
+  ret += format_memory_usage("total", total);
+  ret += '\n';
+  return ret;
+}
+
+std::string format_memory_usage(std::string_view name, const memory_usage& mu)
+{
+  std::string ret = fmt::format("{}: {}, {} nodes", name, format_bytes(mu.total_bytes()), format_count(mu.nodes_cnt));
+  if (mu.objects_cnt)
+    ret += fmt::format(", {} objects, {} props", format_count(mu.objects_cnt), format_count(mu.props_cnt));
+  ret += fmt::format(" (nodes {}, objects {}, props {}, strings {}, caches {})",
+    format_bytes(mu.node_bytes), format_bytes(mu.object_bytes), format_bytes(mu.prop_bytes),
+    format_bytes(mu.string_bytes), format_bytes(mu.cache_bytes));
+  return ret;
+}
+
+} // namespace cp::csav
+
@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cpinternals/common/memory_usage.hpp>
+#include <cpinternals/csav/savegame.hpp>
+
+namespace cp::csav {
+
+// Memory footprint of a loaded save, per system node: its subtree plus the
+// decoded system (objects, properties, string pool, load state).
+// Nodes outside of the systems are accounted apart.
+// Building it walks all the nodes and created properties, it is meant for
+// the debug UI and headless tools, not for every frame.
+//
+//  auto report = memory_report::build(save);
+//  fmt::print("{}", report.to_string());
+struct memory_report
+{
+  struct row
+  {
+    std::string name;
+    memory_usage usage;
+    bool system_loaded = false;
+  };
+
+  std::vector<row> rows;
+  memory_usage other_nodes;
+  memory_usage total;
+
+  static memory_report build(savegame& save);
+
+  // one line per system, then the other nodes and the total, e.g. "PSData: 840.2 MB, 1.2M objects, 3.4M props"
+  std::string to_string() const;
+};
+
+std::string format_memory_usage(std::string_view name, const memory_usage& mu);
+
+} // namespace cp::csav
+
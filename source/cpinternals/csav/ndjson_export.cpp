@@ -0,0 +1,312 @@
+#include "ndjson_export.hpp"
+
+#include <atomic>
+#include <fstream>
+#include <cpinternals/common/json_writer.hpp>
+#include <cpinternals/common/parallel.hpp>
+#include <cpinternals/common/instrumentation.hpp>
+#include <cpinternals/csav/savegame.hpp>
+
+namespace cp::csav {
+
+namespace {
+
+struct property_writer
+{
+  json_writer& w;
+  bool include_defaults;
+  // objects being written, handles can point back to them
+  std::vector<const CObject*> stack;
+
+  void write_tdbid(const TweakDBID& id)
+  {
+    if (gname name = TweakDBID_resolver::get().find_name(id))
+      w.value(name.strv());
+    else
+      w.value(fmt::format("<tdbid:{:08X}:{:02X}>", id.crc, id.slen));
+  }
+
+  void write_object(const CObject* obj)
+  {
+    if (!obj)
+    {
+      w.null();
+      return;
+    }
+
+    if (std::find(stack.begin(), stack.end(), obj) != stack.end())
+    {
+      w.begin_object();
+      w.key("$cycle").value(obj->ctypename().strv());
+      w.end_object();
+      return;
+    }
+
+    stack.push_back(obj);
+    w.begin_object();
+    w.key("$type").value(obj->ctypename().strv());
+
+    obj->for_each_field([&](gname field_name, const CProperty* prop) {
+      if (!prop || (!include_defaults && prop->is_skippable_in_serialization()))
+        return;
+      w.key(field_name.strv());
+      write_prop(prop);
+    });
+
+    w.end_object();
+    stack.pop_back();
+  }
+
+  template <typename ArrayProperty>
+  void write_array(const ArrayProperty* arr)
+  {
+    w.begin_array();
+    for (const auto& elt : *arr)
+      write_prop(elt.get());
+    w.end_array();
+  }
+
+  void write_prop(const CProperty* prop)
+  {
+    switch (prop->kind())
+    {
+      case EPropertyKind::Bool:
+        w.value(static_cast<const CBoolProperty*>(prop)->value());
+        return;
+
+      case EPropertyKind::Integer:
+      {
+        auto p = static_cast<const CIntProperty*>(prop);
+        switch (p->int_kind())
+        {
+          case EIntKind::U8:  w.value(p->u8());  return;
+          case EIntKind::U16: w.value(p->u16()); return;
+          case EIntKind::U32: w.value(p->u32()); return;
+          case EIntKind::U64: w.value(p->u64()); return;
+          default:            w.value(p->i64()); return;
+        }
+      }
+
+      case EPropertyKind::Float:
+        w.value(static_cast<double>(static_cast<const CFloatProperty*>(prop)->value()));
+        return;
+
+      case EPropertyKind::Combo:
+        w.value(static_cast<const CEnumProperty*>(prop)->value_name().strv());
+        return;
+
+      case EPropertyKind::Array:
+      case EPropertyKind::DynArray:
+      {
+        if (auto arr = dynamic_cast<const CDynArrayProperty*>(prop))
+          return write_array(arr);
+        if (auto arr = dynamic_cast<const CArrayProperty*>(prop))
+          return write_array(arr);
+        break;
+      }
+
+      case EPropertyKind::Handle:
+        write_object(static_cast<const CHandleProperty*>(prop)->obj().get());
+        return;
+
+      case EPropertyKind::Object:
+        write_object(static_cast<const CObjectProperty*>(prop)->obj().get());
+        return;
+
+      case EPropertyKind::TweakDBID:
+        write_tdbid(static_cast<const CTweakDBIDProperty*>(prop)->m_id);
+        return;
+
+      case EPropertyKind::CName:
+        w.value(static_cast<const CNameProperty*>(prop)->value().string());
+        return;
+
+      case EPropertyKind::RaRef:
+        w.value(static_cast<const CRaRefProperty*>(prop)->ref());
+        return;
+
+      case EPropertyKind::CRUID:
+        w.value(static_cast<const CCRUIDProperty*>(prop)->id());
+        return;
+
+      case EPropertyKind::NodeRef:
+        w.value(static_cast<const CNodeRefProperty*>(prop)->str());
+        return;
+
+      default:
+        break;
+    }
+
+    w.begin_object();
+    w.key("$unknown").value(prop->ctypename().strv());
+    if (auto unk = dynamic_cast<const CUnknownProperty*>(prop))
+      w.key("size").value(unk->raw_data().size());
+    w.end_object();
+  }
+};
+
+} // namespace
+
+const std::vector<std::string_view>& ndjson_exporter::system_names()
+{
+  static const std::vector<std::string_view> names = {
+    "inventory",
+    "FactsDB",
+    "godModeSystem",
+    "ScriptableSystemsContainer",
+    "PSData",
+    "StatsSystem",
+    "StatPoolsSystem",
+  };
+  return names;
+}
+
+bool ndjson_exporter::write_system(std::string_view name, std::ostream& os) const
+{
+  scoped_span span("export.system", name);
+
+  json_writer w(os);
+  property_writer pw{w, include_defaults, {}};
+
+  if (name == "inventory")
+  {
+    for (const auto& subinv : m_save.inventory.m_subinvs)
+    {
+      for (const auto& item : subinv.items)
+      {
+        w.begin_object();
+        w.key("system").value(name);
+        w.key("subinventory").value(subinv.uid);
+        w.key("item");
+        pw.write_tdbid(item.iid.nameid);
+        w.key("seed").value(item.iid.uk.uk4);
+        w.key("kind").value(item.iid.uk.kind());
+        w.key("flags").value(item.flags);
+        w.key("quantity").value(item.quantity);
+        w.end_object();
+        w.end_record();
+      }
+    }
+  }
+  else if (name == "FactsDB")
+  {
+    const auto& tables = m_save.factsdb.tables();
+    auto& resolver = CFact_resolver::get();
+    for (size_t t = 0; t < tables.size(); ++t)
+    {
+      const auto& tbl = tables[t];
+      for (size_t i = 0; i < tbl.size(); ++i)
+      {
+        const uint32_t hash = tbl.hashes()[i];
+        w.begin_object();
+        w.key("system").value(name);
+        w.key("table").value(t);
+        w.key("fact");
+        if (gname fact_name = resolver.find_name(hash))
+          w.value(fact_name.strv());
+        else
+          w.null();
+        w.key("hash").value(hash);
+        w.key("value").value(tbl.values()[i]);
+        w.end_object();
+        w.end_record();
+      }
+    }
+  }
+  else
+  {
+    const CSystem* sys = nullptr;
+    if (name == "godModeSystem")
+      sys = &m_save.godmode.system();
+    else if (name == "ScriptableSystemsContainer")
+      sys = &m_save.scriptables.system();
+    else if (name == "PSData")
+      sys = &m_save.psdata.system();
+    else if (name == "StatsSystem")
+      sys = &m_save.stats.system();
+    else if (name == "StatPoolsSystem")
+      sys = &m_save.statspool.system();
+    else
+      return false;
+
+    const auto& objects = sys->objects();
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+      w.begin_object();
+      w.key("system").value(name);
+      w.key("object").value(i);
+      w.key("value");
+      pw.write_object(objects[i].get());
+      w.end_object();
+      w.end_record();
+    }
+  }
+
+  w.flush();
+  return w.good();
+}
+
+op_status ndjson_exporter::write(std::ostream& os) const
+{
+  for (const auto& name : system_names())
+  {
+    if (!write_system(name, os))
+      return op_status(fmt::format("couldn't export {}", name));
+  }
+  return {};
+}
+
+op_status ndjson_exporter::write_file(const std::filesystem::path& path, size_t workers_cnt) const
+{
+  scoped_span span("export.write_file");
+
+  const auto& names = system_names();
+
+  std::vector<std::filesystem::path> parts(names.size());
+  for (size_t i = 0; i < names.size(); ++i)
+  {
+    parts[i] = path;
+    parts[i] += fmt::format(".part{}", i);
+  }
+
+  std::atomic<bool> failed = false;
+  span_sink* const sink = current_span_sink();
+  const uint32_t depth = current_span_depth();
+
+  parallel_for(names.size(), workers_cnt, [&](size_t i)
+  {
+    scoped_span_sink job_sink(sink, depth);
+
+    std::ofstream ofs(parts[i], std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open() || !write_system(names[i], ofs))
+      failed = true;
+  });
+
+  op_status status = {};
+  if (failed)
+    status = op_status(fmt::format("couldn't write the parts of {}", path.string()));
+
+  if (status)
+  {
+    scoped_span concat_span("export.concat");
+
+    std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+    for (size_t i = 0; ofs.good() && i < parts.size(); ++i)
+    {
+      std::ifstream ifs(parts[i], std::ios::binary);
+      if (ifs.peek() != std::ifstream::traits_type::eof())
+        ofs << ifs.rdbuf();
+    }
+    if (!ofs.good())
+      status = op_status(fmt::format("couldn't write {}", path.string()));
+  }
+
+  std::error_code ec;
+  for (const auto& part : parts)
+    std::filesystem::remove(part, ec);
+
+  return status;
+}
+
+} // namespace cp::csav
+
@@ -0,0 +1,55 @@
+#pragma once
+#include <inttypes.h>
+#include <filesystem>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+#include <cpinternals/common.hpp>
+
+namespace cp::csav {
+
+struct savegame;
+
+// NDJSON export of the systems of a loaded savegame (e.g. for analytics).
+// every line is a JSON object (record):
+//   {"system":"inventory","subinventory":<uid>,"item":"Items.X","seed":..,"kind":..,"flags":..,"quantity":..}
+//   {"system":"FactsDB","table":<idx>,"fact":"name"|null,"hash":<u32>,"value":<u32>}
+//   {"system":"PSData","object":<idx>,"value":{"$type":"<ctypename>",<field>:<value>,..}}
+// objects of the CSystem based systems are walked property by property,
+// handled objects are written inline ({"$cycle":"<ctypename>"} if the handle
+// points to an object being written). unknown properties are written as
+// {"$unknown":"<ctypename>","size":<bytes>}.
+//
+// records are written token by token with a json_writer: no JSON tree is
+// built and the memory used doesn't depend on the size of the save.
+struct ndjson_exporter
+{
+  explicit ndjson_exporter(const savegame& save)
+    : m_save(save) {}
+
+  // node names of the exported systems, in output order
+  static const std::vector<std::string_view>& system_names();
+
+  // writes the records of one system, false if it isn't exported or if the
+  // stream failed
+  bool write_system(std::string_view name, std::ostream& os) const;
+
+  // all systems, sequentially
+  op_status write(std::ostream& os) const;
+
+  // systems are exported concurrently, each one into a temporary file next
+  // to path, then the temporary files are concatenated in system order.
+  // 0 means one worker per hardware thread, 1 disables threading.
+  op_status write_file(const std::filesystem::path& path, size_t workers_cnt = 0) const;
+
+  // writes the fields that have their default value too (they aren't
+  // serialized in the save)
+  bool include_defaults = false;
+
+protected:
+  const savegame& m_save;
+};
+
+} // namespace cp::csav
+
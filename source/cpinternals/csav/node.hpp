@@ -1,13 +1,20 @@
 #pragma once
+#include <array>
+#include <cstring>
 #include <memory>
 #include <functional>
 #include <string>
 #include <vector>
 #include <map>
 #include <numeric>
+#include <span>
 #include <sstream>
-#include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include "cpinternals/utils.hpp"
+#include "cpinternals/common/gstring.hpp"
+#include "cpinternals/common/packed_codec.hpp"
+#include "cpinternals/common/memory_usage.hpp"
 #include "version.hpp"
 
 namespace cp::csav {
@@ -27,12 +34,75 @@ struct node_listener_t
   virtual void on_node_event(const std::shared_ptr<const node_t>& node, node_event_e evt) = 0;
 };
 
+// Set of pointers whose first InlineCnt elements are stored inline: a node
+// has a single parent most of the time and rarely more than one listener.
+// Unordered, erase moves the last element in place of the erased one.
+template <typename T, size_t InlineCnt>
+class small_ptr_set
+{
+  std::array<T*, InlineCnt> m_inline = {};
+  std::vector<T*> m_overflow;
+  size_t m_inline_cnt = 0;
+
+public:
+  size_t size() const { return m_inline_cnt + m_overflow.size(); }
+  bool empty() const { return size() == 0; }
+
+  T* operator[](size_t i) const
+  {
+    return i < m_inline_cnt ? m_inline[i] : m_overflow[i - m_inline_cnt];
+  }
+
+  void insert(T* p)
+  {
+    for (size_t i = 0; i < size(); ++i)
+    {
+      if ((*this)[i] == p)
+        return;
+    }
+
+    if (m_inline_cnt < InlineCnt)
+      m_inline[m_inline_cnt++] = p;
+    else
+      m_overflow.push_back(p);
+  }
+
+  void erase(T* p)
+  {
+    for (size_t i = 0; i < size(); ++i)
+    {
+      if ((*this)[i] != p)
+        continue;
+
+      T* last = (*this)[size() - 1];
+      if (i < m_inline_cnt)
+        m_inline[i] = last;
+      else
+        m_overflow[i - m_inline_cnt] = last;
+
+      if (m_overflow.size())
+        m_overflow.pop_back();
+      else
+        --m_inline_cnt;
+      return;
+    }
+  }
+};
+
+// node names are interned: a savegame has a few hundred distinct names for
+// hundreds of thousands of nodes
+inline constexpr uint32_t node_gname_pool_tag = 'NODN';
+using node_gname = gstring<node_gname_pool_tag>;
+
+class node_event_batch;
+
 class node_t
   : public std::enable_shared_from_this<const node_t>
-  , public node_listener_t
 {
   struct create_tag {};
 
+  friend class node_event_batch;
+
 public:
   static const int32_t null_node_idx = -1;
   static const int32_t root_node_idx = -2;
@@ -40,12 +110,17 @@ public:
 
 private:
   int32_t           m_idx;
-  const std::string m_name;
+  const node_gname  m_name;
   std::vector<char> m_data;
+  // the data can be a view of a shared immutable buffer instead of m_data
+  // (a decompressed image, a mapped sidecar or a payload_store entry), the
+  // bytes are copied on the first edit. only its lifetime is managed here.
+  std::shared_ptr<const void> m_backing;
+  std::span<const char> m_view;
   std::vector<std::shared_ptr<const node_t>> m_children;
 
 public:
-  explicit node_t(create_tag&&, int32_t idx, std::string name)
+  explicit node_t(create_tag&&, int32_t idx, node_gname name)
     : m_name(name)
   {
     if (idx < blob_node_idx)
@@ -53,25 +128,61 @@ public:
     m_idx = idx;
   }
 
+  explicit node_t(create_tag&&, int32_t idx, node_gname name, std::vector<char>&& data)
+    : node_t(create_tag{}, idx, name)
+  {
+    m_data = std::move(data);
+  }
+
+  explicit node_t(create_tag&&, int32_t idx, node_gname name, std::shared_ptr<const void> backing, std::span<const char> view)
+    : node_t(create_tag{}, idx, name)
+  {
+    m_backing = std::move(backing);
+    m_view = view;
+  }
+
   ~node_t()
   {
     for (auto& c : m_children)
-      c->remove_listener(this);
+      c->remove_parent(this);
   }
 
   static std::shared_ptr<const node_t>
-  create_shared(int32_t idx, std::string name)
+  create_shared(int32_t idx, node_gname name)
   {
     return std::make_shared<const node_t>(create_tag{}, idx, name);
   }
 
+  static std::shared_ptr<const node_t>
+  create_shared(int32_t idx, std::string_view name)
+  {
+    return create_shared(idx, node_gname(name));
+  }
+
+  // the node takes the buffer, no event is posted (it has no listener yet)
+  static std::shared_ptr<const node_t>
+  create_shared_with_data(int32_t idx, node_gname name, std::vector<char>&& data)
+  {
+    return std::make_shared<const node_t>(create_tag{}, idx, name, std::move(data));
+  }
+
+  static const node_gname& blob_gname()
+  {
+    static const node_gname name("datablob");
+    return name;
+  }
+
   template <class Iter>
   static std::shared_ptr<const node_t>
   create_shared_blob(Iter first, Iter last)
   {
-    auto node = node_t::create_shared(node_t::blob_node_idx, "datablob");
-    node->nonconst().assign_data(first, last);
-    return node;
+    return create_shared_with_data(node_t::blob_node_idx, blob_gname(), std::vector<char>(first, last));
+  }
+
+  static std::shared_ptr<const node_t>
+  create_shared_blob(std::vector<char>&& data)
+  {
+    return create_shared_with_data(node_t::blob_node_idx, blob_gname(), std::move(data));
   }
 
   static std::shared_ptr<const node_t>
@@ -80,6 +191,14 @@ public:
     return create_shared_blob(nodedata + start_offset, nodedata + end_offset);
   }
 
+  // blob viewing [first, last) of backing without copying it,
+  // backing is kept alive by the node until its data is edited
+  static std::shared_ptr<const node_t>
+  create_shared_blob_view(std::shared_ptr<const void> backing, const char* first, const char* last)
+  {
+    return std::make_shared<const node_t>(create_tag{}, node_t::blob_node_idx, blob_gname(), std::move(backing), std::span<const char>(first, last));
+  }
+
 public:
 
   int32_t idx() const       { return m_idx; }
@@ -90,14 +209,28 @@ public:
   {
     if (!this)
       return "nullptr";
+    return std::string(m_name.strv());
+  }
+
+  // interned, the view has static storage duration
+  std::string_view name_view() const
+  {
+    return m_name.strv();
+  }
+
+  node_gname gname() const
+  {
     return m_name;
   }
 
   const std::vector<std::shared_ptr<const node_t>>&
   children() const { return m_children; }
 
-  const std::vector<char>&
-  data() const { return m_data; }
+  std::span<const char>
+  data() const { return m_backing ? m_view : std::span<const char>(m_data); }
+
+  // the data is a view of a shared buffer (see create_shared_blob_view)
+  bool is_data_shared() const { return m_backing != nullptr; }
 
   bool has_children() const { return !m_children.empty(); }
 
@@ -107,25 +240,43 @@ public:
   bool is_leaf()  const { return !has_children(); }
 
 public:
+  // results are cached, caches are invalidated by node events
+  // (which bubble up to the root through the parent links)
   size_t calcsize() const
   {
-    size_t base_size = m_data.size() + (is_cnode() ? 4 : 0);
-    return std::accumulate(
-      m_children.begin(), m_children.end(), base_size,
-      [](size_t cnt, auto& node){ return cnt + node->calcsize(); }
-    );
+    if (m_cached_size == invalid_cached_size)
+    {
+      size_t base_size = data().size() + (is_cnode() ? 4 : 0);
+      m_cached_size = std::accumulate(
+        m_children.begin(), m_children.end(), base_size,
+        [](size_t cnt, auto& node){ return cnt + node->calcsize(); }
+      );
+    }
+    return m_cached_size;
   }
 
   uint32_t treecount() const
   {
-    if (!is_blob())
+    if (is_blob())
+      return 0;
+
+    if (m_cached_count == invalid_cached_count)
     {
-      return std::accumulate(
+      m_cached_count = std::accumulate(
         m_children.begin(), m_children.end(), is_root() ? 0 : (uint32_t)1,
         [](uint32_t cnt, auto& node){ return cnt + node->treecount(); }
       );
     }
-    return 0;
+    return m_cached_count;
+  }
+
+  // memory accounting of the subtree, shared images aren't counted
+  void accumulate_memory_usage(cp::memory_usage& mu) const
+  {
+    ++mu.nodes_cnt;
+    mu.node_bytes += sizeof(node_t) + cp::heap_bytes(m_data) + cp::heap_bytes(m_children);
+    for (const auto& c : m_children)
+      c->accumulate_memory_usage(mu);
   }
 
   node_t& nonconst() const { return const_cast<node_t&>(*this); }
@@ -133,11 +284,17 @@ public:
   std::shared_ptr<const node_t> deepcopy() const
   {
     // not cycle-safe, but shouldn't happen..
-    auto new_node = create_shared(0, name());
+    auto new_node = create_shared(m_idx, m_name);
     auto& nc = new_node->nonconst();
     for (auto& c : m_children)
-      nc.m_children.push_back(c->deepcopy());
+    {
+      auto& new_child = nc.m_children.emplace_back(c->deepcopy());
+      new_child->add_parent(&nc);
+    }
     nc.m_data = m_data;
+    nc.m_backing = m_backing;
+    nc.m_view = m_view;
+    nc.invalidate_cached_sizes();
     return new_node;
   }
 
@@ -147,7 +304,9 @@ public:
   template <class Iter>
   void assign_data(Iter first, Iter last)
   {
+    // the range can be a view of the shared image, it's released after
     m_data.assign(first, last);
+    release_backing();
     post_node_event(node_event_e::data_update);
   }
 
@@ -156,14 +315,56 @@ public:
     assign_data(buf.begin(), buf.end());
   }
 
+  void assign_data(std::span<const char> buf)
+  {
+    assign_data(buf.begin(), buf.end());
+  }
+
+  void assign_data(std::vector<char>&& buf)
+  {
+    m_data = std::move(buf);
+    release_backing();
+    post_node_event(node_event_e::data_update);
+  }
+
+  // the data becomes a view of the whole buffer (e.g. a payload_store
+  // entry), copied on the first edit
+  void assign_shared_data(std::shared_ptr<const std::vector<char>> buffer)
+  {
+    m_data = {};
+    m_view = *buffer;
+    m_backing = std::move(buffer);
+    post_node_event(node_event_e::data_update);
+  }
+
+  // moves the data out, e.g. of a node that was just rebuilt
+  std::vector<char> release_data()
+  {
+    own_data();
+    std::vector<char> ret = std::move(m_data);
+    m_data.clear();
+    post_node_event(node_event_e::data_update);
+    return ret;
+  }
+
+  // in-place edit of the data (e.g. patching a few ranges),
+  // a single event is posted
+  template <class Fn>
+  void edit_data(Fn&& fn)
+  {
+    own_data();
+    fn(m_data);
+    post_node_event(node_event_e::data_update);
+  }
+
   template <class Iter>
   void assign_children(Iter first, Iter last)
   {
     for (auto& c : m_children)
-      c->remove_listener(this);
+      c->remove_parent(this);
     m_children.assign(first, last);
     for (auto& c : m_children)
-      c->add_listener(this);
+      c->add_parent(this);
     post_node_event(node_event_e::children_update);
   }
 
@@ -175,24 +376,92 @@ public:
   void children_push_back(const std::shared_ptr<const node_t>& node)
   {
     m_children.push_back(node);
-    node->add_listener(this);
+    node->add_parent(this);
     post_node_event(node_event_e::children_update);
   }
 
 protected:
-  std::set<node_listener_t*> m_listeners;
+  // copies the viewed bytes before an edit
+  void own_data()
+  {
+    if (!m_backing)
+      return;
+
+    m_data.assign(m_view.begin(), m_view.end());
+    release_backing();
+  }
+
+  void release_backing()
+  {
+    m_backing.reset();
+    m_view = {};
+  }
+
+  // parents are the nodes that have this one as child, events bubble up
+  // to them as subtree_update
+  small_ptr_set<const node_t, 1> m_parents;
+  small_ptr_set<node_listener_t, 2> m_listeners;
 
-  void post_node_event(node_event_e evt) const
+  static constexpr size_t   invalid_cached_size   = (size_t)-1;
+  static constexpr uint32_t invalid_cached_count  = (uint32_t)-1;
+
+  mutable size_t    m_cached_size   = invalid_cached_size;
+  mutable uint32_t  m_cached_count  = invalid_cached_count;
+
+  void invalidate_cached_sizes() const
+  {
+    m_cached_size = invalid_cached_size;
+    m_cached_count = invalid_cached_count;
+  }
+
+  // invalidates this node's caches and its ancestors' ones.
+  // the caches of a node are only valid if the ones of its descendants are,
+  // so the walk stops at the ancestors that are already invalid.
+  void invalidate_cached_sizes_upwards() const
+  {
+    invalidate_cached_sizes();
+    for (size_t i = 0; i < m_parents.size(); ++i)
+    {
+      const node_t* p = m_parents[i];
+      if (p->m_cached_size != invalid_cached_size || p->m_cached_count != invalid_cached_count)
+        p->invalidate_cached_sizes_upwards();
+    }
+  }
+
+  // see node_event_batch
+  void post_node_event(node_event_e evt) const;
+
+  // notifies the listeners of this node then bubbles up to its ancestors.
+  // with visited, ancestors that were already notified of a subtree_update
+  // (and so were their own ancestors) are skipped.
+  void dispatch_node_event(node_event_e evt, std::unordered_set<const node_t*>* visited) const
   {
-    std::set<node_listener_t*> listeners = m_listeners;
-    for (auto& l : listeners) {
-      l->on_node_event(shared_from_this(), evt);
+    if (!m_listeners.empty())
+    {
+      const auto self = shared_from_this();
+      // listeners don't usually unregister in their callback, indices are
+      // rechecked in case one does
+      for (size_t i = 0; i < m_listeners.size(); ++i)
+        m_listeners[i]->on_node_event(self, evt);
     }
+
+    for (size_t i = 0; i < m_parents.size(); ++i)
+    {
+      const node_t* p = m_parents[i];
+      if (visited && !visited->insert(p).second)
+        continue;
+      p->dispatch_node_event(node_event_e::subtree_update, visited);
+    }
+  }
+
+  void add_parent(const node_t* parent) const
+  {
+    nonconst().m_parents.insert(parent);
   }
 
-  void on_node_event(const std::shared_ptr<const node_t>& node, node_event_e evt) override
+  void remove_parent(const node_t* parent) const
   {
-    post_node_event(node_event_e::subtree_update);
+    nonconst().m_parents.erase(parent);
   }
 
 public:
@@ -200,24 +469,102 @@ public:
 
   void add_listener(node_listener_t* listener) const
   {
-    auto& listeners = nonconst().m_listeners;
-    listeners.insert(listener);
+    nonconst().m_listeners.insert(listener);
   }
 
   void remove_listener(node_listener_t* listener) const
   {
-    auto& listeners = nonconst().m_listeners;
-    listeners.erase(listener);
+    nonconst().m_listeners.erase(listener);
   }
 };
 
+// Coalesces the node events posted on the calling thread while it is alive,
+// for bulk edits and tree construction. Caches are still invalidated right
+// away but listeners are only notified when the outermost batch ends: once
+// per node and event, and ancestors get a single subtree_update however
+// many of their descendants changed.
+// Nodes with pending events are kept alive until then.
+class node_event_batch
+{
+  struct pending_event
+  {
+    std::shared_ptr<const node_t> node;
+    node_event_e evt;
+  };
+
+  std::vector<pending_event> m_pending;
+  // bit i set if event i is pending for the node
+  std::unordered_map<const node_t*, uint32_t> m_pending_masks;
+  node_event_batch* m_prev;
+
+  static inline thread_local node_event_batch* tls_batch = nullptr;
+
+  friend class node_t;
+
+  void push(const node_t* node, node_event_e evt)
+  {
+    const uint32_t bit = 1u << static_cast<uint32_t>(evt);
+    uint32_t& mask = m_pending_masks[node];
+    if (mask & bit)
+      return;
+    mask |= bit;
+    m_pending.push_back(pending_event{node->shared_from_this(), evt});
+  }
+
+public:
+  node_event_batch()
+    : m_prev(tls_batch)
+  {
+    // nested batches are flushed with the outer one
+    if (!m_prev)
+      tls_batch = this;
+  }
+
+  ~node_event_batch()
+  {
+    if (m_prev)
+      return;
+
+    // listeners can post events, they are dispatched right away
+    tls_batch = nullptr;
+
+    std::unordered_set<const node_t*> visited;
+    for (const auto& pe : m_pending)
+    {
+      if (pe.evt == node_event_e::subtree_update && !visited.insert(pe.node.get()).second)
+        continue;
+      pe.node->dispatch_node_event(pe.evt, &visited);
+    }
+  }
+
+  node_event_batch(const node_event_batch&) = delete;
+  node_event_batch& operator=(const node_event_batch&) = delete;
+};
+
+inline void node_t::post_node_event(node_event_e evt) const
+{
+  invalidate_cached_sizes_upwards();
+
+  // nobody to notify, e.g. nodes of a tree being built (bottom-up)
+  if (m_listeners.empty() && m_parents.empty())
+    return;
+
+  if (node_event_batch::tls_batch)
+  {
+    node_event_batch::tls_batch->push(this, evt);
+    return;
+  }
+
+  dispatch_node_event(evt, nullptr);
+}
+
 // Only to read at node level.
 // Buffer and position in the istream is only relevant between child nodes.
 class node_reader
   : public std::istream
 {
   std::shared_ptr<const node_t> m_node;
-  vector_istreambuf m_sbuf;
+  span_istreambuf m_sbuf;
   size_t m_cur_idx;
   version m_ver;
   bool m_missed_data = false;
@@ -229,7 +576,10 @@ public:
     this->exceptions(std::ios::failbit | std::ios::badbit);
     auto blob = current_blob();
     if (blob)
-      m_sbuf = vector_istreambuf(blob->data());
+    {
+      const auto data = blob->data();
+      m_sbuf = span_istreambuf(data.data(), data.data() + data.size());
+    }
   }
 
   virtual ~node_reader() = default;
@@ -290,7 +640,10 @@ public:
 
     const auto& blob = current_blob();
     if (blob)
-      m_sbuf = vector_istreambuf(blob->data());
+    {
+      const auto data = blob->data();
+      m_sbuf = span_istreambuf(data.data(), data.data() + data.size());
+    }
 
     return child_node;
   }
@@ -322,33 +675,119 @@ public:
   }
 };
 
+// Recycles node_writer buffers on the calling thread while a scope is alive
+// (e.g. for the duration of a savegame load or save), so that the thousands
+// of writers built by to_node_impl (one per item..) don't each grow a new one.
+// Without scope, writers allocate their own buffer.
+class node_buffer_pool
+{
+  std::vector<std::vector<char>> m_free_buffers;
+
+  static inline thread_local node_buffer_pool* tls_pool = nullptr;
+
+  // buffers bigger than this are released instead of being kept
+  static constexpr size_t max_kept_capacity = 0x100000;
+
+public:
+  static std::vector<char> acquire()
+  {
+    std::vector<char> buf;
+    if (tls_pool && tls_pool->m_free_buffers.size())
+    {
+      buf = std::move(tls_pool->m_free_buffers.back());
+      tls_pool->m_free_buffers.pop_back();
+    }
+    return buf;
+  }
+
+  // the content of buf for a node: buffers too big to be kept by the pool
+  // are moved out, small ones are copied and buf keeps its capacity
+  static std::vector<char> detach(std::vector<char>& buf)
+  {
+    if (buf.capacity() > max_kept_capacity)
+    {
+      std::vector<char> ret = std::move(buf);
+      buf.clear();
+      return ret;
+    }
+    return std::vector<char>(buf.begin(), buf.end());
+  }
+
+  static void release(std::vector<char>&& buf)
+  {
+    if (tls_pool && buf.capacity() <= max_kept_capacity)
+    {
+      buf.clear();
+      tls_pool->m_free_buffers.emplace_back(std::move(buf));
+    }
+  }
+
+  friend class node_buffer_pool_scope;
+};
+
+class node_buffer_pool_scope
+{
+  node_buffer_pool m_pool;
+  node_buffer_pool* m_prev;
+
+public:
+  node_buffer_pool_scope()
+    : m_prev(node_buffer_pool::tls_pool)
+  {
+    // nested scopes share the outer pool
+    if (!m_prev)
+      node_buffer_pool::tls_pool = &m_pool;
+  }
+
+  ~node_buffer_pool_scope()
+  {
+    node_buffer_pool::tls_pool = m_prev;
+  }
+
+  node_buffer_pool_scope(const node_buffer_pool_scope&) = delete;
+  node_buffer_pool_scope& operator=(const node_buffer_pool_scope&) = delete;
+};
+
 // only to write at node level
 // does not actually modify input node until finalize() is called
-// buffer and position in the ostringstream is only relevant between child nodes
+// buffer and position in the stream is only relevant between child nodes
 class node_writer
-  : public std::ostringstream
+  : public std::ostream
 {
   std::vector<std::shared_ptr<const node_t>> m_new_children;
   version m_ver;
+  std::vector<char> m_buf;
+  vector_ostreambuf m_sbuf;
 
 public:
   explicit node_writer(const version& ver)
-    : m_ver(ver) {}
+    : std::ostream(nullptr), m_ver(ver), m_buf(node_buffer_pool::acquire()), m_sbuf(m_buf)
+  {
+    rdbuf(&m_sbuf);
+  }
 
-  virtual ~node_writer() = default;
+  virtual ~node_writer()
+  {
+    node_buffer_pool::release(std::move(m_buf));
+  }
 
   const version& version() const { return m_ver; }
 
+  // e.g. with the size of the loaded data, to write big nodes without regrowth
+  void reserve(size_t size)
+  {
+    m_buf.reserve(size);
+  }
+
 protected:
   void blobize_pending_data_if_any()
   {
-    auto data = str();
-    if (data.size())
+    if (m_buf.size())
     {
       m_new_children.push_back(
-        node_t::create_shared_blob(data.begin(), data.end()));
+        node_t::create_shared_blob(node_buffer_pool::detach(m_buf)));
     }
-    str("");
+    m_sbuf.reset();
   }
   
 public:
@@ -360,11 +799,24 @@ public:
 
   void pad(size_t len)
   {
-    *this << std::string(len, 0);
+    static const char zeros[0x100] = {};
+    while (len)
+    {
+      const size_t n = std::min(len, sizeof(zeros));
+      write(zeros, n);
+      len -= n;
+    }
   }
 
-  std::shared_ptr<const node_t> finalize(std::string name)
+  std::shared_ptr<const node_t> finalize(std::string_view name)
   {
+    if (m_new_children.empty())
+    {
+      auto node = node_t::create_shared_with_data(0, node_gname(name), node_buffer_pool::detach(m_buf));
+      m_sbuf.reset();
+      return node;
+    }
+
     auto node = node_t::create_shared(0, name);
     finalize_in(node->nonconst());
     return node;
@@ -375,12 +827,338 @@ public:
     if (m_new_children.size())
       blobize_pending_data_if_any();
     // there is still pending data only if there are no children
-    auto data = str();
-    node.assign_data(data.begin(), data.end());
+    node.assign_data(node_buffer_pool::detach(m_buf));
+    m_sbuf.reset();
     node.assign_children(m_new_children.begin(), m_new_children.end());
   }
 };
 
+// Same child and blob semantics as node_reader, without the istream: blobs
+// are read through a span cursor and errors are sticky flags instead of
+// exceptions. Reads past the end of the current blob fail and leave the
+// destination untouched.
+class node_span_reader
+{
+  std::shared_ptr<const node_t> m_node;
+  const char* m_pos = nullptr;
+  const char* m_end = nullptr;
+  const char* m_beg = nullptr;
+  size_t m_cur_idx = 0;
+  version m_ver;
+  bool m_failed = false;
+  bool m_missed_data = false;
+
+public:
+  explicit node_span_reader(const std::shared_ptr<const node_t>& root, const cp::csav::version& version)
+    : m_node(root), m_ver(version)
+  {
+    set_blob(current_blob());
+  }
+
+  const cp::csav::version& version() const { return m_ver; }
+
+  // a read failed (out of bounds), reads are no-ops until clear()
+  bool failed() const { return m_failed; }
+  bool has_missed_data() const { return m_missed_data; }
+
+  void clear()
+  {
+    m_failed = false;
+    m_missed_data = false;
+  }
+
+  // bytes left in the current blob
+  size_t remaining() const { return static_cast<size_t>(m_end - m_pos); }
+  size_t tell() const { return static_cast<size_t>(m_pos - m_beg); }
+
+  bool read(void* dst, size_t len)
+  {
+    if (m_failed || len > remaining())
+    {
+      m_failed = true;
+      return false;
+    }
+    std::memcpy(dst, m_pos, len);
+    m_pos += len;
+    return true;
+  }
+
+  template <typename T>
+  bool read_pod(T& v)
+  {
+    static_assert(std::is_trivially_copyable_v<T>);
+    return read(&v, sizeof(T));
+  }
+
+  // same encoding as cp_packedint_ref
+  bool read_packed_int(int64_t& v)
+  {
+    const size_t len = m_failed ? 0 : cp::decode_packed_int(m_pos, remaining(), v);
+    if (!len)
+    {
+      m_failed = true;
+      return false;
+    }
+    m_pos += len;
+    return true;
+  }
+
+  // decodes values.size() consecutive packed ints
+  bool read_packed_ints(std::span<int64_t> values)
+  {
+    const size_t len = m_failed ? 0 : cp::decode_packed_ints({m_pos, remaining()}, values);
+    if (!len && values.size())
+    {
+      m_failed = true;
+      return false;
+    }
+    m_pos += len;
+    return true;
+  }
+
+  // same encoding as cp_plstring_ref. ascii strings are viewed in place,
+  // utf16 ones are converted into buf, which out then views.
+  bool read_plstring(std::string_view& out, std::string& buf)
+  {
+    int64_t cnt = 0;
+    if (!read_packed_int(cnt))
+      return false;
+
+    if (cnt <= 0)
+    {
+      const auto s = read_span(size_t(-cnt));
+      if (m_failed)
+        return false;
+      out = std::string_view(s.data(), s.size());
+      return true;
+    }
+
+    const auto s16 = read_span(size_t(cnt) * 2);
+    if (m_failed)
+      return false;
+    buf.clear();
+    cp::utf16_to_utf8(s16.data(), size_t(cnt), buf);
+    out = buf;
+    return true;
+  }
+
+  bool skip(size_t len)
+  {
+    if (m_failed || len > remaining())
+    {
+      m_failed = true;
+      return false;
+    }
+    m_pos += len;
+    return true;
+  }
+
+  // next len bytes of the current blob, in place (valid until the node's
+  // data is reassigned), empty on failure
+  std::span<const char> read_span(size_t len)
+  {
+    const char* const p = m_pos;
+    if (!skip(len))
+      return {};
+    return std::span<const char>(p, len);
+  }
+
+  std::shared_ptr<const node_t> read_child(std::string_view name)
+  {
+    seek_past_current_blob_if_any();
+
+    if (m_cur_idx >= m_node->children().size())
+      return nullptr;
+
+    const auto& child_node = m_node->children()[m_cur_idx];
+    if (child_node->name_view() != name)
+      return nullptr;
+    m_cur_idx++;
+
+    set_blob(current_blob());
+    return child_node;
+  }
+
+  bool at_end() const
+  {
+    if (m_failed)
+      return false;
+
+    if (m_node->is_leaf())
+      return m_cur_idx > 0 || m_pos == m_end;
+
+    const size_t childcnt = m_node->children().size();
+    if (current_blob())
+    {
+      if (m_pos != m_end)
+        return false;
+
+      if (m_cur_idx == childcnt - 1)
+        return true;
+    }
+
+    return m_cur_idx >= childcnt;
+  }
+
+protected:
+  std::shared_ptr<const node_t> current_blob() const
+  {
+    // the node is the blob (leaf)
+    if (m_node->is_leaf())
+      return m_cur_idx == 0 ? m_node : nullptr;
+
+    if (m_cur_idx >= m_node->children().size())
+      return nullptr;
+
+    const auto& cur_node = m_node->children()[m_cur_idx];
+    if (cur_node->is_blob())
+      return cur_node;
+
+    return nullptr;
+  }
+
+  void set_blob(const std::shared_ptr<const node_t>& blob)
+  {
+    if (blob)
+    {
+      m_beg = blob->data().data();
+      m_pos = m_beg;
+      m_end = m_beg + blob->data().size();
+    }
+    else
+    {
+      m_beg = m_pos = m_end = nullptr;
+    }
+  }
+
+  void seek_past_current_blob_if_any()
+  {
+    if (!current_blob())
+      return;
+
+    if (m_pos != m_end)
+      m_missed_data = true;
+
+    set_blob(nullptr);
+    m_cur_idx++;
+  }
+};
+
+// Same child and blob semantics as node_writer, without the ostream: writes
+// append to a buffer taken from node_buffer_pool and never fail.
+class node_span_writer
+{
+  std::vector<std::shared_ptr<const node_t>> m_new_children;
+  version m_ver;
+  std::vector<char> m_buf;
+
+public:
+  explicit node_span_writer(const cp::csav::version& ver)
+    : m_ver(ver), m_buf(node_buffer_pool::acquire()) {}
+
+  ~node_span_writer()
+  {
+    node_buffer_pool::release(std::move(m_buf));
+  }
+
+  node_span_writer(const node_span_writer&) = delete;
+  node_span_writer& operator=(const node_span_writer&) = delete;
+
+  const cp::csav::version& version() const { return m_ver; }
+
+  void reserve(size_t size)
+  {
+    m_buf.reserve(size);
+  }
+
+  void write(const void* src, size_t len)
+  {
+    const char* p = static_cast<const char*>(src);
+    m_buf.insert(m_buf.end(), p, p + len);
+  }
+
+  template <typename T>
+  void write_pod(const T& v)
+  {
+    static_assert(std::is_trivially_copyable_v<T>);
+    write(&v, sizeof(T));
+  }
+
+  // same encoding as cp_packedint_ref
+  void write_packed_int(int64_t v)
+  {
+    uint64_t tmp = v < 0 ? uint64_t(-v) : uint64_t(v);
+    uint8_t b = (v < 0 ? 0x80 : 0) | (tmp & 0x3F);
+    tmp >>= 6;
+    if (!tmp)
+    {
+      m_buf.push_back(static_cast<char>(b));
+      return;
+    }
+
+    m_buf.push_back(static_cast<char>(b | 0x40));
+    for (int i = 0; i < 4; ++i)
+    {
+      b = tmp & 0x7F;
+      tmp >>= 7;
+      if (tmp && i < 3)
+        b |= 0x80;
+      m_buf.push_back(static_cast<char>(b));
+      if (!(b & 0x80))
+        break;
+    }
+  }
+
+  // same encoding as cp_plstring_ref (always written as ascii/utf8)
+  void write_plstring(std::string_view s)
+  {
+    write_packed_int(-(int64_t)s.size());
+    write(s.data(), s.size());
+  }
+
+  void pad(size_t len)
+  {
+    m_buf.resize(m_buf.size() + len, 0);
+  }
+
+  void write_child(const std::shared_ptr<const node_t>& node)
+  {
+    blobize_pending_data_if_any();
+    m_new_children.push_back(node);
+  }
+
+  std::shared_ptr<const node_t> finalize(std::string_view name)
+  {
+    if (m_new_children.empty())
+      return node_t::create_shared_with_data(0, node_gname(name), node_buffer_pool::detach(m_buf));
+
+    auto node = node_t::create_shared(0, name);
+    finalize_in(node->nonconst());
+    return node;
+  }
+
+  void finalize_in(node_t& node)
+  {
+    if (m_new_children.size())
+      blobize_pending_data_if_any();
+    // there is still pending data only if there are no children
+    node.assign_data(node_buffer_pool::detach(m_buf));
+    m_buf.clear();
+    node.assign_children(m_new_children.begin(), m_new_children.end());
+  }
+
+protected:
+  void blobize_pending_data_if_any()
+  {
+    if (m_buf.size())
+    {
+      m_new_children.push_back(
+        node_t::create_shared_blob(node_buffer_pool::detach(m_buf)));
+    }
+    m_buf.clear();
+  }
+};
+
 struct node_serializable
 {
   bool has_valid_data = false;
@@ -400,6 +1178,10 @@ struct node_serializable
     return nullptr;
   }
 
+  // memory accounting of the decoded structure, its node excluded.
+  // structures without systems are only accounted by their nodes.
+  virtual void accumulate_memory_usage(cp::memory_usage& mu) const {}
+
 private:
   virtual bool from_node_impl(const std::shared_ptr<const node_t>& node, const version& version) = 0;
   virtual std::shared_ptr<const node_t> to_node_impl(const version& version) const = 0;
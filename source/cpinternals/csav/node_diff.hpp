@@ -0,0 +1,325 @@
+#pragma once
+#include <inttypes.h>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+#include "cpinternals/common.hpp"
+#include "cpinternals/common/hashing.hpp"
+#include "cpinternals/common/parallel.hpp"
+#include "cpinternals/csav/node.hpp"
+
+namespace cp::csav {
+
+// Merkle hashes of the subtrees of a node tree.
+// the hash of a node is the crc64 of its name, its data and the hashes of its
+// children (node indices aren't hashed, they shift when nodes are added).
+// hashes are stored in depth-first pre-order, along the size of each subtree
+// so that the position of any child can be found from its parent's.
+// the subtrees of the top-level nodes are hashed concurrently.
+struct subtree_hashes
+{
+  using shared_node_type = std::shared_ptr<const node_t>;
+
+  void build(const shared_node_type& root, size_t workers_cnt = 0)
+  {
+    m_hashes.clear();
+    m_counts.clear();
+    if (!root)
+      return;
+
+    count_node(root);
+    m_hashes.resize(m_counts.size());
+
+    // top-level subtrees are contiguous ranges, they are hashed in parallel
+    const auto& children = root->children();
+    std::vector<size_t> positions(children.size());
+    size_t pos = 1;
+    for (size_t i = 0; i < children.size(); ++i)
+    {
+      positions[i] = pos;
+      pos += m_counts[pos];
+    }
+
+    parallel_for(children.size(), workers_cnt, [&](size_t i) {
+      hash_node(children[i], positions[i]);
+    });
+
+    m_hashes[0] = combine(root, 0);
+  }
+
+  bool empty() const
+  {
+    return m_hashes.empty();
+  }
+
+  // pos is the pre-order position of the node, 0 for the root
+  uint64_t hash(size_t pos) const
+  {
+    return m_hashes[pos];
+  }
+
+  // nodes count of the subtree at pos (itself included)
+  size_t count(size_t pos) const
+  {
+    return m_counts[pos];
+  }
+
+protected:
+  void count_node(const shared_node_type& node)
+  {
+    const size_t pos = m_counts.size();
+    m_counts.push_back(1);
+    for (const auto& c : node->children())
+      count_node(c);
+    m_counts[pos] = static_cast<uint32_t>(m_counts.size() - pos);
+  }
+
+  void hash_node(const shared_node_type& node, size_t pos)
+  {
+    size_t child_pos = pos + 1;
+    for (const auto& c : node->children())
+    {
+      hash_node(c, child_pos);
+      child_pos += m_counts[child_pos];
+    }
+    m_hashes[pos] = combine(node, pos);
+  }
+
+  // children must be hashed
+  uint64_t combine(const shared_node_type& node, size_t pos) const
+  {
+    crc64_builder b;
+    b.init();
+
+    const auto name = node->name_view();
+    const uint64_t name_len = name.size();
+    b.update(&name_len, sizeof(name_len));
+    b.update(name.data(), name.size());
+
+    const auto& data = node->data();
+    const uint64_t data_len = data.size();
+    b.update(&data_len, sizeof(data_len));
+    if (data.size())
+      b.update(data.data(), data.size());
+
+    size_t child_pos = pos + 1;
+    for (size_t i = 0; i < node->children().size(); ++i)
+    {
+      b.update(&m_hashes[child_pos], sizeof(uint64_t));
+      child_pos += m_counts[child_pos];
+    }
+
+    return b.finalize();
+  }
+
+  std::vector<uint64_t> m_hashes;
+  std::vector<uint32_t> m_counts;
+};
+
+// Structural diff of two node trees (e.g. two saves of the same character).
+// both trees are hashed (see subtree_hashes), then walked together from the
+// roots: subtrees with equal hashes are skipped without being visited.
+// children are matched by name and occurrence (the n-th child named X of a
+// node is matched with the n-th child named X of the other node), unmatched
+// ones are reported as removed or added subtrees.
+// nodes whose data differ are reported with the changed byte ranges.
+struct node_diff
+{
+  using shared_node_type = std::shared_ptr<const node_t>;
+
+  enum class change_e
+  {
+    added,        // subtree only in b
+    removed,      // subtree only in a
+    data_changed, // see ranges
+  };
+
+  // [offset, offset + size_a) in a's data replaced by
+  // [offset, offset + size_b) in b's data
+  struct byte_range
+  {
+    size_t offset;
+    size_t size_a;
+    size_t size_b;
+  };
+
+  struct entry
+  {
+    change_e          kind;
+    shared_node_type  a; // null if added
+    shared_node_type  b; // null if removed
+    std::string       path; // names from the root, e.g. "inventory/itemData[2]"
+    std::vector<byte_range> ranges;
+  };
+
+  // changed ranges closer than this are merged
+  static constexpr size_t range_merge_gap = 8;
+
+  // entries are grouped by parent: data change, then the changes of the
+  // matched and removed children, then the added ones
+  void compute(const shared_node_type& a, const shared_node_type& b, size_t workers_cnt = 0)
+  {
+    m_entries.clear();
+    if (!a || !b)
+      return;
+
+    m_hashes_a.build(a, workers_cnt);
+    m_hashes_b.build(b, workers_cnt);
+
+    std::string path;
+    diff_node(a, 0, b, 0, path);
+  }
+
+  const std::vector<entry>& entries() const
+  {
+    return m_entries;
+  }
+
+  bool identical() const
+  {
+    return m_entries.empty();
+  }
+
+  // changed bytes of two datas, in a's offsets
+  static std::vector<byte_range> diff_bytes(std::span<const char> da, std::span<const char> db)
+  {
+    std::vector<byte_range> ranges;
+
+    if (da.size() != db.size())
+    {
+      // single range between the common prefix and suffix
+      const size_t min_size = std::min(da.size(), db.size());
+      const size_t prefix = common_prefix(da.data(), db.data(), min_size);
+      size_t suffix = 0;
+      while (suffix < min_size - prefix && da[da.size() - 1 - suffix] == db[db.size() - 1 - suffix])
+        ++suffix;
+      ranges.push_back(byte_range{prefix, da.size() - prefix - suffix, db.size() - prefix - suffix});
+      return ranges;
+    }
+
+    const size_t size = da.size();
+    size_t pos = 0;
+    while (pos < size)
+    {
+      pos += common_prefix(da.data() + pos, db.data() + pos, size - pos);
+      if (pos == size)
+        break;
+
+      size_t end = pos + 1;
+      while (end < size && da[end] != db[end])
+        ++end;
+
+      if (ranges.size() && pos - (ranges.back().offset + ranges.back().size_a) < range_merge_gap)
+      {
+        auto& r = ranges.back();
+        r.size_a = r.size_b = end - r.offset;
+      }
+      else
+        ranges.push_back(byte_range{pos, end - pos, end - pos});
+
+      pos = end;
+    }
+
+    return ranges;
+  }
+
+protected:
+  static size_t common_prefix(const char* a, const char* b, size_t len)
+  {
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+      uint64_t wa, wb;
+      std::memcpy(&wa, a + i, 8);
+      std::memcpy(&wb, b + i, 8);
+      if (wa != wb)
+        break;
+    }
+    while (i < len && a[i] == b[i])
+      ++i;
+    return i;
+  }
+
+  void diff_node(const shared_node_type& a, size_t pos_a, const shared_node_type& b, size_t pos_b, std::string& path)
+  {
+    if (m_hashes_a.hash(pos_a) == m_hashes_b.hash(pos_b))
+      return;
+
+    if (!std::ranges::equal(a->data(), b->data()))
+      m_entries.push_back(entry{change_e::data_changed, a, b, path, diff_bytes(a->data(), b->data())});
+
+    const auto& ca = a->children();
+    const auto& cb = b->children();
+
+    // positions of b's children, and b's children by name (in order)
+    std::vector<size_t> positions_b(cb.size());
+    std::unordered_map<std::string_view, std::vector<size_t>> by_name_b;
+    for (size_t i = 0, p = pos_b + 1; i < cb.size(); p += m_hashes_b.count(p), ++i)
+    {
+      positions_b[i] = p;
+      by_name_b[cb[i]->name_view()].push_back(i);
+    }
+
+    std::unordered_map<std::string_view, size_t> occurrences;
+    std::vector<char> matched_b(cb.size(), 0);
+    const size_t path_len = path.size();
+
+    for (size_t i = 0, p = pos_a + 1; i < ca.size(); p += m_hashes_a.count(p), ++i)
+    {
+      const auto name = ca[i]->name_view();
+      const size_t occurrence = occurrences[name]++;
+
+      append_path(path, name, occurrence);
+
+      auto it = by_name_b.find(name);
+      if (it != by_name_b.end() && occurrence < it->second.size())
+      {
+        const size_t j = it->second[occurrence];
+        matched_b[j] = 1;
+        diff_node(ca[i], p, cb[j], positions_b[j], path);
+      }
+      else
+        m_entries.push_back(entry{change_e::removed, ca[i], nullptr, path, {}});
+
+      path.resize(path_len);
+    }
+
+    occurrences.clear();
+    for (size_t j = 0; j < cb.size(); ++j)
+    {
+      const auto name = cb[j]->name_view();
+      const size_t occurrence = occurrences[name]++;
+      if (matched_b[j])
+        continue;
+
+      append_path(path, name, occurrence);
+      m_entries.push_back(entry{change_e::added, nullptr, cb[j], path, {}});
+      path.resize(path_len);
+    }
+  }
+
+  static void append_path(std::string& path, std::string_view name, size_t occurrence)
+  {
+    if (path.size())
+      path += '/';
+    path += name;
+    if (occurrence)
+    {
+      path += '[';
+      path += std::to_string(occurrence);
+      path += ']';
+    }
+  }
+
+  subtree_hashes m_hashes_a;
+  subtree_hashes m_hashes_b;
+  std::vector<entry> m_entries;
+};
+
+} // namespace cp::csav
+
@@ -0,0 +1,128 @@
+#pragma once
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include "node.hpp"
+
+namespace cp::csav {
+
+// Undo/redo of node edits.
+// A step keeps the previous state of the edited node only: its data and its
+// children list. The children are shared pointers, so the subtrees are shared
+// between the tree and the steps instead of being deep copied (see
+// node_t::deepcopy). Edits of a child are steps of their own.
+// Undoing a step swaps the recorded state with the current one (which
+// becomes the redo step), nodes keep their identity.
+// Nodes are weakly referenced, steps of dead nodes (e.g. closed savegame)
+// are dropped.
+class node_history
+{
+public:
+  static constexpr size_t default_max_steps = 1000;
+
+  explicit node_history(size_t max_steps = default_max_steps)
+    : m_max_steps(max_steps) {}
+
+  // to be called before editing node
+  void record(std::string label, const std::shared_ptr<const node_t>& node)
+  {
+    if (!node)
+      return;
+
+    m_redo.clear();
+    const auto data = node->data();
+    m_undo.push_back(step{std::move(label), node, {data.begin(), data.end()}, node->children()});
+    if (m_undo.size() > m_max_steps)
+      m_undo.pop_front();
+  }
+
+  bool can_undo()
+  {
+    drop_dead_steps(m_undo);
+    return !m_undo.empty();
+  }
+
+  bool can_redo()
+  {
+    drop_dead_steps(m_redo);
+    return !m_redo.empty();
+  }
+
+  // label of the next step to undo (empty if none)
+  const std::string& undo_label()
+  {
+    static const std::string empty;
+    return can_undo() ? m_undo.back().label : empty;
+  }
+
+  const std::string& redo_label()
+  {
+    static const std::string empty;
+    return can_redo() ? m_redo.back().label : empty;
+  }
+
+  bool undo()
+  {
+    return swap_step(m_undo, m_redo);
+  }
+
+  bool redo()
+  {
+    return swap_step(m_redo, m_undo);
+  }
+
+  void clear()
+  {
+    m_undo.clear();
+    m_redo.clear();
+  }
+
+protected:
+  struct step
+  {
+    std::string label;
+    std::weak_ptr<const node_t> node;
+    std::vector<char> data;
+    std::vector<std::shared_ptr<const node_t>> children;
+  };
+
+  static void drop_dead_steps(std::deque<step>& steps)
+  {
+    while (!steps.empty() && steps.back().node.expired())
+      steps.pop_back();
+  }
+
+  // restores the last step of from, the replaced state goes to to
+  static bool swap_step(std::deque<step>& from, std::deque<step>& to)
+  {
+    drop_dead_steps(from);
+    if (from.empty())
+      return false;
+
+    step st = std::move(from.back());
+    from.pop_back();
+
+    auto node = st.node.lock();
+    auto& nc = node->nonconst();
+
+    // the data is swapped, the children list is small (pointers)
+    std::vector<std::shared_ptr<const node_t>> children = node->children();
+    {
+      node_event_batch event_batch;
+      nc.edit_data([&](std::vector<char>& data) { data.swap(st.data); });
+      nc.assign_children(st.children.begin(), st.children.end());
+    }
+    st.children = std::move(children);
+
+    to.push_back(std::move(st));
+    return true;
+  }
+
+  size_t m_max_steps;
+  std::deque<step> m_undo;
+  std::deque<step> m_redo;
+};
+
+} // namespace cp::csav
+
@@ -0,0 +1,243 @@
+#pragma once
+#include <inttypes.h>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+
+#include "cpinternals/common.hpp"
+#include "cpinternals/common/parallel.hpp"
+#include "cpinternals/csav/node.hpp"
+
+namespace cp::csav {
+
+// Byte pattern search over the data of a node tree.
+// build() copies the datas of all nodes into one flat buffer, in the same
+// order as in nodedata (without the u32 idx prefixes), along a table of
+// segments used to map hit offsets back to their node.
+// The buffer is then scanned in ranges distributed over worker threads.
+// Matches never span two nodes.
+struct node_search_index
+{
+  using shared_node_type = std::shared_ptr<const node_t>;
+
+  struct match
+  {
+    shared_node_type  node;
+    size_t            offset; // in node data
+    size_t            size;
+    size_t            index_offset; // in the index buffer (tree order)
+    size_t            node_size;    // size of the node data when indexed
+  };
+
+  // scanned ranges size, a range is one job
+  static constexpr size_t range_size = 0x100000;
+
+  node_search_index() = default;
+
+  node_search_index(const node_search_index&) = delete;
+  node_search_index& operator=(const node_search_index&) = delete;
+
+  // the index is a snapshot, it must be rebuilt after edits of the tree
+  void build(const shared_node_type& root)
+  {
+    clear();
+    if (!root)
+      return;
+
+    m_buffer.reserve(root->calcsize());
+    append_node(root);
+  }
+
+  void clear()
+  {
+    m_buffer.clear();
+    m_segments.clear();
+  }
+
+  bool empty() const
+  {
+    return m_segments.empty();
+  }
+
+  size_t data_size() const
+  {
+    return m_buffer.size();
+  }
+
+  // mask uses 'x' for compared bytes and '?' for wildcards (empty: all compared).
+  // matches are returned in tree order.
+  std::vector<match> search(std::string_view needle, std::string_view mask = {}, size_t workers_cnt = 0) const
+  {
+    std::vector<match> ret;
+    search(needle, mask, workers_cnt, [&ret](std::vector<match>&& matches) {
+      std::move(matches.begin(), matches.end(), std::back_inserter(ret));
+    });
+    return ret;
+  }
+
+  // streaming version, on_matches(std::vector<match>&&) is called as soon
+  // as consecutive ranges are done, in tree order and never concurrently
+  // (but from worker threads).
+  // returns false if cancelled, remaining ranges are then skipped.
+  template <typename OnMatchesFn>
+  bool search(std::string_view needle, std::string_view mask, size_t workers_cnt, OnMatchesFn&& on_matches, const std::atomic<bool>* cancel = nullptr) const
+  {
+    if (needle.empty() || (!mask.empty() && mask.size() != needle.size()))
+      return true;
+
+    const auto cancelled = [cancel]() {
+      return cancel && cancel->load(std::memory_order_relaxed);
+    };
+
+    const std::string mask_str(mask);
+    const size_t ranges_cnt = (m_buffer.size() + range_size - 1) / range_size;
+    std::vector<std::vector<match>> range_matches(ranges_cnt);
+    std::vector<char> range_done(ranges_cnt, 0);
+    size_t next_flushed = 0;
+    std::mutex mtx;
+
+    parallel_for(ranges_cnt, workers_cnt, [&](size_t i)
+    {
+      if (cancelled())
+        return;
+
+      std::vector<match> matches;
+      search_range(i, needle, mask_str, matches);
+
+      std::lock_guard<std::mutex> lock(mtx);
+      range_matches[i] = std::move(matches);
+      range_done[i] = 1;
+      for (; next_flushed < ranges_cnt && range_done[next_flushed]; ++next_flushed)
+      {
+        if (range_matches[next_flushed].size())
+          on_matches(std::move(range_matches[next_flushed]));
+      }
+    });
+
+    return !cancelled();
+  }
+
+  // returns true if all matches of (needle, mask) are matches of (prev_needle, prev_mask),
+  // e.g. when the user typed a longer needle.
+  static bool refines(std::string_view prev_needle, std::string_view prev_mask, std::string_view needle, std::string_view mask)
+  {
+    if (prev_needle.empty() || prev_needle.size() > needle.size())
+      return false;
+
+    for (size_t i = 0; i < prev_needle.size(); ++i)
+    {
+      const bool prev_solid = prev_mask.empty() || prev_mask[i] != '?';
+      const bool solid = mask.empty() || mask[i] != '?';
+      if (prev_solid && (!solid || prev_needle[i] != needle[i]))
+        return false;
+    }
+
+    return true;
+  }
+
+  // filters matches of a previous search on this same index (see refines),
+  // much cheaper than a new search.
+  // returns false if cancelled.
+  bool refine(const std::vector<match>& prev_matches, std::string_view needle, std::string_view mask, std::vector<match>& out, const std::atomic<bool>* cancel = nullptr) const
+  {
+    if (!mask.empty() && mask.size() != needle.size())
+      return true;
+
+    size_t i = 0;
+    for (const auto& m : prev_matches)
+    {
+      if (cancel && (++i & 0xFFF) == 0 && cancel->load(std::memory_order_relaxed))
+        return false;
+
+      const size_t seg_end = m.index_offset - m.offset + m.node_size;
+      if (m.index_offset + needle.size() > seg_end)
+        continue;
+
+      if (!match_at(m.index_offset, needle, mask))
+        continue;
+
+      auto& nm = out.emplace_back(m);
+      nm.size = needle.size();
+    }
+
+    return true;
+  }
+
+protected:
+  struct segment
+  {
+    size_t            offset; // in m_buffer
+    size_t            size;
+    shared_node_type  node;
+  };
+
+  void append_node(const shared_node_type& node)
+  {
+    const auto& data = node->data();
+    if (data.size())
+    {
+      m_segments.push_back(segment{m_buffer.size(), data.size(), node});
+      m_buffer.insert(m_buffer.end(), data.begin(), data.end());
+    }
+
+    for (const auto& c : node->children())
+      append_node(c);
+  }
+
+  // scans match starts in range i, the haystack extends into the next range
+  // by needle.size() - 1 so that no match is missed at range boundaries
+  void search_range(size_t i, std::string_view needle, const std::string& mask, std::vector<match>& out) const
+  {
+    const size_t start = i * range_size;
+    const size_t end = std::min(start + range_size + needle.size() - 1, m_buffer.size());
+
+    std::vector<size_t> offsets;
+    sse2_find_pattern(
+      (const uint8_t*)m_buffer.data() + start, end - start,
+      (const uint8_t*)needle.data(), needle.size(),
+      mask.empty() ? nullptr : mask.c_str(), offsets);
+
+    // offsets are sorted, segments are walked along
+    auto seg_it = m_segments.end();
+    for (size_t off : offsets)
+    {
+      const size_t abs_off = start + off;
+      if (abs_off >= start + range_size) // belongs to next range
+        break;
+
+      if (seg_it == m_segments.end() || abs_off >= seg_it->offset + seg_it->size)
+      {
+        seg_it = std::upper_bound(m_segments.begin(), m_segments.end(), abs_off,
+          [](size_t o, const segment& s) { return o < s.offset; });
+        --seg_it; // first segment starts at 0
+      }
+
+      if (abs_off + needle.size() > seg_it->offset + seg_it->size) // spans two nodes
+        continue;
+
+      out.push_back(match{seg_it->node, abs_off - seg_it->offset, needle.size(), abs_off, seg_it->size});
+    }
+  }
+
+  bool match_at(size_t pos, std::string_view needle, std::string_view mask) const
+  {
+    const char* pc = m_buffer.data() + pos;
+    for (size_t i = 0; i < needle.size(); ++i)
+    {
+      if ((mask.empty() || mask[i] != '?') && pc[i] != needle[i])
+        return false;
+    }
+    return true;
+  }
+
+  std::vector<char> m_buffer;
+  std::vector<segment> m_segments;
+};
+
+} // namespace cp::csav
+
@@ -1,7 +1,17 @@
 #include "node_tree.hpp"
 
+#include <cstring>
+#include <atomic>
+#include <optional>
 #include <xlz4/lz4.h>
+#include <cpinternals/common/parallel.hpp>
+#include <cpinternals/common/task_scheduler.hpp>
+#include <cpinternals/common/instrumentation.hpp>
+#include <cpinternals/common/alloc_profiler.hpp>
+#include <cpinternals/common/hashing.hpp>
 #include <cpinternals/io/file_stream.hpp>
+#include <cpinternals/io/memory_istream.hpp>
+#include <cpinternals/io/mapped_file_istream.hpp>
 #include <cpinternals/csav/serial_tree.hpp>
 
 #define XLZ4_CHUNK_SIZE 0x40000
@@ -21,14 +31,118 @@ struct compressed_chunk_desc
   }
 };
 
-op_status node_tree::load(std::filesystem::path path)
+op_status node_tree::load(std::filesystem::path path, const std::atomic<bool>* cancel)
 {
+  scoped_span span("csav.load");
+  scoped_alloc_tag alloc_scope(alloc_tag::csav);
   file_istream ar(path);
-  serialize_in(ar);
+  serialize_in(ar, cancel);
 
   return op_status(ar.error());
 }
 
+op_status node_tree::load(std::span<const char> data, const std::atomic<bool>* cancel)
+{
+  scoped_span span("csav.load_memory");
+  scoped_alloc_tag alloc_scope(alloc_tag::csav);
+  memory_istream ar(data);
+  serialize_in(ar, cancel);
+
+  return op_status(ar.error());
+}
+
+op_status node_tree::load_pipelined(std::filesystem::path path, const node_ready_fn& on_node, const std::atomic<bool>* cancel)
+{
+  scoped_span span("csav.load_pipelined");
+  scoped_alloc_tag alloc_scope(alloc_tag::csav);
+  file_istream ar(path);
+  serialize_in_pipelined(ar, on_node, cancel);
+
+  return op_status(ar.error());
+}
+
+op_status node_tree::load_pipelined(std::span<const char> data, const node_ready_fn& on_node, const std::atomic<bool>* cancel)
+{
+  scoped_span span("csav.load_pipelined_memory");
+  scoped_alloc_tag alloc_scope(alloc_tag::csav);
+  memory_istream ar(data);
+  serialize_in_pipelined(ar, on_node, cancel);
+
+  return op_status(ar.error());
+}
+
+op_status node_tree::open_mapped(std::filesystem::path path)
+{
+  scoped_span span("csav.load_mapped");
+  scoped_alloc_tag alloc_scope(alloc_tag::csav);
+  mapped_file_istream ar(path);
+  if (ar.is_open())
+  {
+    serialize_in(ar);
+  }
+
+  return op_status(ar.error());
+}
+
+op_status node_tree::load_flat(std::filesystem::path path, flat_tree& out)
+{
+  scoped_span span("csav.load_flat");
+  scoped_alloc_tag alloc_scope(alloc_tag::csav);
+  file_istream ar(path);
+
+  serial_tree stree;
+  uint32_t chunks_start = 0;
+  std::span<const char> tree_src;
+
+  m_partial.reset();
+  if (read_serial_tree(ar, stree, chunks_start, tree_src))
+  {
+    original_descs = stree.descs;
+    root.reset();
+
+    if (!out.build(std::move(stree), chunks_start))
+    {
+      ar.set_error("couldn't build a flat_tree from serial_tree");
+    }
+  }
+
+  return op_status(ar.error());
+}
+
+op_status node_tree::open_partial(std::filesystem::path path)
+{
+  scoped_span span("csav.open_partial");
+  scoped_alloc_tag alloc_scope(alloc_tag::csav);
+
+  auto partial = std::make_unique<save_peek>();
+  partial->set_chunk_cache_size(m_chunk_cache_size);
+
+  op_status status = partial->open(path);
+  if (!status)
+    return status;
+
+  unbind_index();
+  root.reset();
+  m_original_chunks.clear();
+  m_loaded_root.reset();
+
+  m_ver = partial->ver();
+  original_descs = partial->descs();
+  m_partial = std::move(partial);
+
+  return {};
+}
+
+node_tree::shared_node_type node_tree::read_partial_node(std::string_view name) const
+{
+  return m_partial ? m_partial->read_node(name) : nullptr;
+}
+
+node_tree::shared_node_type node_tree::read_partial_node(uint32_t desc_idx) const
+{
+  return m_partial ? m_partial->read_node(desc_idx) : nullptr;
+}
+
 op_status node_tree::save(std::filesystem::path path)
 {
   // make a backup (when there isn't one, oldest wins for safety reasons)
@@ -40,29 +154,107 @@ op_status node_tree::save(std::filesystem::path path)
       std::filesystem::copy(path, oldpath);
   }
 
+  scoped_span span("csav.save");
+  scoped_alloc_tag alloc_scope(alloc_tag::csav);
   file_ostream ar(path);
   serialize_out(ar);
 
   return op_status(ar.error());
 }
 
-void node_tree::serialize_in(streambase& ar)
+op_status node_tree::save(memory_ostream& ar)
+{
+  scoped_span span("csav.save_memory");
+  scoped_alloc_tag alloc_scope(alloc_tag::csav);
+  ar.clear();
+  serialize_out(ar);
+
+  return op_status(ar.error());
+}
+
+struct node_tree::chunks_layout
+{
+  std::vector<compressed_chunk_desc> chunk_descs; // sorted by offset
+  uint64_t footer_start = 0;
+  uint64_t nodedata_size = 0;
+  uint32_t chunks_start = 0;
+
+  // end of the compressed chunks in the file, checks that they don't
+  // overlap the footer
+  bool cdata_end(streambase& ar, uint64_t& end) const
+  {
+    end = chunk_descs.size() ? chunk_descs[0].offset : 0;
+    for (const auto& cd : chunk_descs)
+    {
+      if (cd.size < 8)
+      {
+        ar.set_error("compressed chunk is too small");
+        return false;
+      }
+      end = std::max(end, (uint64_t)cd.offset + cd.size);
+    }
+
+    if (end > footer_start)
+    {
+      ar.set_error("compressed chunks overlap the footer");
+      return false;
+    }
+
+    return true;
+  }
+};
+
+// decompresses chunk cd (pchunk points to its 'XLZ4' header) into its slice
+// of nodedata, returns an error or nullptr
+static const char* decode_chunk(const compressed_chunk_desc& cd, const char* pchunk, char* nodedata)
+{
+  scoped_trace_span chunk_span("csav.lz4_decode_chunk");
+  chunk_span.set_bytes(cd.data_size);
+
+  uint32_t chunk_magic = 0, data_size = 0;
+  std::memcpy(&chunk_magic, pchunk, 4);
+  std::memcpy(&data_size, pchunk + 4, 4);
+
+  if (chunk_magic != 'XLZ4')
+    return "missing 'XLZ4' tag";
+
+  if (data_size != cd.data_size)
+    return "data size prefix differs from descriptor's value";
+
+  const int csize = (int)(cd.size - 8);
+  int res = LZ4_decompress_safe(pchunk + 8, nodedata + cd.data_offset, csize, cd.data_size);
+  if (res != (int)cd.data_size)
+    return "unexpected lz4 decompressed size";
+
+  return nullptr;
+}
+
+bool node_tree::read_serial_tree(streambase& ar, serial_tree& stree, uint32_t& chunks_start, std::span<const char>& tree_src,
+  const std::atomic<bool>* cancel, os::file_mapping* src_mapping)
+{
+  chunks_layout layout;
+  if (!read_layout(ar, stree, layout))
+    return false;
+
+  chunks_start = layout.chunks_start;
+  return read_chunks(ar, stree, layout, tree_src, cancel, src_mapping);
+}
+
+bool node_tree::read_layout(streambase& ar, serial_tree& stree, chunks_layout& layout)
 {
   if (!ar.is_reader())
   {
     ar.set_error("serialize_in cannot be used with output stream");
-    return;
+    return false;
   }
 
   uint32_t chunkdescs_start = 0;
   uint32_t nodedescs_start = 0;
   uint32_t magic = 0;
-  uint32_t i = 0;
 
+  auto& chunk_descs = layout.chunk_descs;
 
-  serial_tree stree;
-  std::vector<compressed_chunk_desc> chunk_descs;
-  std::vector<char>& nodedata = stree.nodedata;
+  scoped_span span("csav.read_header");
 
   // --------------------------------------------------------
   //  HEADER (magic, m_ver..)
@@ -72,7 +264,7 @@ void node_tree::serialize_in(streambase& ar)
   if (magic != 'CSAV' && magic != 'SAVE')
   {
     ar.set_error("csav file has wrong magic");
-    return;
+    return false;
   }
 
   ar << m_ver.v1;
@@ -91,7 +283,7 @@ void node_tree::serialize_in(streambase& ar)
   if (m_ver.v1 <= 168 and m_ver.v2 == 4)
   {
     ar.set_error("unsuppported csav m_ver.v1/v2");
-    return;
+    return false;
   }
 
   m_ver.v3 = 192;
@@ -101,7 +293,7 @@ void node_tree::serialize_in(streambase& ar)
     if (m_ver.v3 > 195) // will change soon i guess
     {
       ar.set_error("unsuppported csav m_ver.v3");
-      return;
+      return false;
     }
   }
 
@@ -113,172 +305,695 @@ void node_tree::serialize_in(streambase& ar)
 
   // end stuff
   ar.seek(-8, std::ios_base::end);
-  uint64_t footer_start = (uint64_t)ar.tell();
+  const uint64_t footer_start = (uint64_t)ar.tell();
+  layout.footer_start = footer_start;
   ar << nodedescs_start;
   ar << magic;
   if (magic != 'DONE')
   {
     ar.set_error("missing 'DONE' tag");
-    return;
+    return false;
   }
 
   // --------------------------------------------------------
   //  NODE DESCRIPTORS
   // --------------------------------------------------------
 
-  // check node start tag
-  ar.seek(nodedescs_start);
-  ar << magic;
-  if (magic != 'NODE')
+  // check node start tag
+  ar.seek(nodedescs_start);
+  ar << magic;
+  if (magic != 'NODE')
+  {
+    ar.set_error("missing 'NODE' tag");
+    return false;
+  }
+
+  // memory streams (e.g. mapped files) can be read in-place
+  auto* const mem_ar = dynamic_cast<memory_istream*>(&ar);
+
+  // the descriptors table ends at the footer, it is decoded from memory
+  const uint64_t nodedescs_table_start = (uint64_t)ar.tell();
+  if (ar.has_error() || nodedescs_table_start > footer_start)
+  {
+    ar.set_error("unexpected footer position");
+    return false;
+  }
+
+  const size_t nodedescs_table_size = (size_t)(footer_start - nodedescs_table_start);
+  std::vector<char> nodedescs_table_buf;
+  std::span<const char> nodedescs_table;
+  if (mem_ar)
+  {
+    nodedescs_table = mem_ar->view_array<char>(nodedescs_table_size);
+  }
+  else
+  {
+    nodedescs_table_buf.resize(nodedescs_table_size);
+    ar.serialize_bytes(nodedescs_table_buf.data(), nodedescs_table_size);
+    nodedescs_table = nodedescs_table_buf;
+  }
+
+  if (ar.has_error() || !stree.decode_descs(nodedescs_table))
+  {
+    ar.set_error("invalid node descriptors table");
+    return false;
+  }
+
+  // --------------------------------------------------------
+  //  COMPRESSED CHUNKS
+  // --------------------------------------------------------
+
+  // descriptors (padded with 0 until actual first chunk)
+
+  ar.seek(chunkdescs_start);
+  ar << magic;
+  if (magic != 'CLZF')
+  {
+    ar.set_error("missing 'CLZF' tag");
+    return false;
+  }
+
+  uint32_t cd_cnt = 0;
+  ar << cd_cnt;
+  if (cd_cnt > footer_start / compressed_chunk_desc::serialized_size)
+  {
+    ar.set_error("invalid chunk descriptors count");
+    return false;
+  }
+
+  // read at once, they are laid out as 3 dwords
+  std::vector<uint32_t> chunk_descs_raw(cd_cnt * 3);
+  ar.serialize_pods_array_raw(chunk_descs_raw.data(), chunk_descs_raw.size());
+  chunk_descs.resize(cd_cnt);
+  for (uint32_t i = 0; i < cd_cnt; ++i)
+  {
+    auto& cd = chunk_descs[i];
+    cd.offset = chunk_descs_raw[i * 3];
+    cd.size = chunk_descs_raw[i * 3 + 1];
+    cd.data_size = chunk_descs_raw[i * 3 + 2];
+  }
+
+  // actual chunks
+
+  std::sort(chunk_descs.begin(), chunk_descs.end(),
+    [](auto& a, auto& b){return a.offset < b.offset; });
+  layout.nodedata_size = 0;
+  layout.chunks_start = 0;
+  m_original_chunks.clear();
+
+  if (chunk_descs.size())
+  {
+    layout.chunks_start = chunk_descs[0].offset;
+    uint32_t data_offset = layout.chunks_start; // that's how they do, minimal offset in file..
+    for (int i = 0; i < chunk_descs.size(); ++i)
+    {
+      auto& cd = chunk_descs[i];
+      cd.data_offset = data_offset;
+      data_offset += cd.data_size;
+    }
+    layout.nodedata_size = data_offset;
+  }
+
+  m_ver.ps4w = false;
+  if (chunk_descs.size())
+  {
+    ar.seek(chunk_descs[0].offset);
+    ar << magic;
+    m_ver.ps4w = (magic != 'XLZ4');
+  }
+
+  return !ar.has_error();
+}
+
+bool node_tree::read_chunks(streambase& ar, serial_tree& stree, const chunks_layout& layout, std::span<const char>& tree_src,
+  const std::atomic<bool>* cancel, os::file_mapping* src_mapping)
+{
+  const auto cancelled = [cancel]() {
+    return cancel && cancel->load(std::memory_order_relaxed);
+  };
+
+  const auto& chunk_descs = layout.chunk_descs;
+  const uint64_t nodedata_size = layout.nodedata_size;
+  const uint32_t chunks_start = layout.chunks_start;
+  std::vector<char>& nodedata = stree.nodedata;
+
+  // --------------------------------------------------------
+  //  DECOMPRESSION from compressed chunks to nodedata
+  // --------------------------------------------------------
+
+  // uncompressed, file offsets match nodedata's ones
+  if (m_ver.ps4w && nodedata_size > layout.footer_start)
+  {
+    ar.set_error("uncompressed chunks overlap the footer");
+    return false;
+  }
+
+  auto* const mem_ar = dynamic_cast<memory_istream*>(&ar);
+  auto* const file_ar = dynamic_cast<file_istream*>(&ar);
+
+  if (m_ver.ps4w && mem_ar)
+  {
+    tree_src = std::span<const char>(mem_ar->data(), nodedata_size);
+  }
+  else if (m_ver.ps4w && src_mapping && file_ar
+    && src_mapping->open(file_ar->path()) && src_mapping->view().size() >= nodedata_size)
+  {
+    // same from a mapping of the file, big console saves aren't staged whole
+    tree_src = src_mapping->view().first(nodedata_size);
+  }
+  else
+  {
+    // we are not concerned by ram, let's decompress the whole node
+    nodedata.clear();
+    nodedata.resize(nodedata_size);
+    tree_src = nodedata;
+  }
+
+  // current phase, see instrumentation.hpp
+  std::optional<scoped_span> span;
+  span.emplace("csav.read_chunks");
+
+  if (m_ver.ps4w)
+  {
+    // nothing to read when tree_src is a view of the file
+    if (tree_src.data() == nodedata.data())
+    {
+      size_t offset = chunk_descs[0].offset;
+      ar.seek(offset);
+      ar.serialize_bytes(nodedata.data() + offset, nodedata_size - offset);
+      span->set_bytes(nodedata_size - offset);
+    }
+  }
+  else if (chunk_descs.size())
+  {
+    // read all compressed chunks in one pass (they are sorted by offset)
+    const uint64_t cdata_start = chunk_descs[0].offset;
+    uint64_t cdata_end = 0;
+    if (!layout.cdata_end(ar, cdata_end))
+    {
+      return false;
+    }
+
+    std::vector<char> cdata_buf;
+    const char* cdata = nullptr;
+    if (mem_ar)
+    {
+      cdata = mem_ar->data() + cdata_start;
+    }
+    else
+    {
+      cdata_buf.resize(cdata_end - cdata_start);
+      ar.seek(cdata_start);
+      ar.serialize_bytes(cdata_buf.data(), cdata_buf.size());
+      cdata = cdata_buf.data();
+    }
+    span->set_bytes(cdata_end - cdata_start);
+
+    if (ar.has_error())
+    {
+      return false;
+    }
+
+    if (cancelled())
+    {
+      ar.set_error("cancelled");
+      return false;
+    }
+
+    span.emplace("csav.lz4_decode");
+    span->set_bytes(nodedata_size - chunks_start);
+
+    // chunk slices in nodedata are disjoint, decompress them concurrently
+    std::vector<const char*> chunk_errors(chunk_descs.size(), nullptr);
+
+    parallel_for(chunk_descs.size(), m_workers_cnt, [&](size_t i)
+    {
+      const auto& cd = chunk_descs[i];
+
+      if (cancelled())
+      {
+        chunk_errors[i] = "cancelled";
+        return;
+      }
+
+      chunk_errors[i] = decode_chunk(cd, cdata + (cd.offset - cdata_start), nodedata.data());
+    });
+
+    for (const char* err : chunk_errors)
+    {
+      if (err)
+      {
+        ar.set_error(err);
+        return false;
+      }
+    }
+
+    if (m_incremental_save)
+    {
+      span.emplace("csav.keep_chunks");
+      keep_chunks(layout, cdata, nodedata);
+    }
+  }
+
+  return !ar.has_error();
+}
+
+void node_tree::keep_chunks(const chunks_layout& layout, const char* cdata, std::span<const char> nodedata)
+{
+  const auto& chunk_descs = layout.chunk_descs;
+  const uint64_t cdata_start = chunk_descs.size() ? chunk_descs[0].offset : 0;
+
+  // keep compressed chunks to reuse them on save if their source didn't change
+  m_original_chunks.resize(chunk_descs.size());
+  parallel_for(chunk_descs.size(), m_workers_cnt, [&](size_t i)
+  {
+    const auto& cd = chunk_descs[i];
+    auto& oc = m_original_chunks[i];
+    const char* pchunk = cdata + (cd.offset - cdata_start);
+    oc.rel_data_offset = cd.data_offset - layout.chunks_start;
+    oc.data_size = cd.data_size;
+    oc.data_hash = crc64_bigdata(nodedata.data() + cd.data_offset, cd.data_size);
+    oc.cdata.assign(pchunk, pchunk + cd.size);
+  });
+}
+
+void node_tree::serialize_in(streambase& ar, const std::atomic<bool>* cancel)
+{
+  m_partial.reset();
+
+  serial_tree stree;
+  uint32_t chunks_start = 0;
+  // view of the data the tree is lifted from
+  std::span<const char> tree_src;
+  // backs tree_src for uncompressed saves read from a file
+  os::file_mapping src_mapping;
+
+  if (!read_serial_tree(ar, stree, chunks_start, tree_src, cancel, &src_mapping))
+  {
+    return;
+  }
+
+  lift_tree(ar, stree, chunks_start, lift_source(stree, tree_src), cancel);
+}
+
+std::span<const char> node_tree::lift_source(serial_tree& stree, std::span<const char> tree_src)
+{
+  // blobs view the decompressed image instead of copying their bytes,
+  // unless the payloads are interned
+  stree.set_intern_payloads(m_shared_payloads);
+  if (!m_shared_payloads && !stree.nodedata.empty() && tree_src.data() == stree.nodedata.data())
+  {
+    tree_src = stree.share_nodedata();
+  }
+
+  return tree_src;
+}
+
+void node_tree::lift_tree(streambase& ar, serial_tree& stree, uint32_t chunks_start, std::span<const char> tree_src,
+  const std::atomic<bool>* cancel)
+{
+  if (cancel && cancel->load(std::memory_order_relaxed))
+  {
+    ar.set_error("cancelled");
+    return;
+  }
+
+  // --------------------------------------------------------
+  //  UNFLATTENING of node tree
+  // --------------------------------------------------------
+
+  {
+    scoped_span span("csav.to_tree");
+    span.set_bytes(tree_src.size() - chunks_start);
+    root = stree.to_tree(chunks_start, tree_src);
+  }
+
+  finish_load(ar, stree, chunks_start, tree_src);
+}
+
+void node_tree::finish_load(streambase& ar, serial_tree& stree, uint32_t chunks_start, std::span<const char> tree_src)
+{
+  if (!root)
+  {
+    ar.set_error("couldn't lift a tree from serial_tree");
+    return;
+  }
+
+  // Check that the unflattening worked.
+  // the descriptors layout is enough, the lifted tree is only walked if it
+  // can't be validated that way (and always in debug builds).
+  {
+    scoped_span span("csav.check_size");
+
+    const uint32_t data_size = (uint32_t)tree_src.size() - chunks_start;
+    bool check_tree = !stree.validate_layout(chunks_start, tree_src.size());
+#ifdef _DEBUG
+    check_tree = true;
+#endif
+
+    if (check_tree && root->calcsize() != data_size)
+    {
+      ar.set_error("lift tree size differs from serial_tree size");
+      return;
+    }
+  }
+
+  // --------------------------------------------------------
+  //  MISC
+  // --------------------------------------------------------
+
+  original_descs = stree.descs;
+
+  scoped_span span("csav.build_index");
+  m_index_dirty = true;
+  rebuild_index();
+
+  m_loaded_root = root;
+  m_modified = false;
+}
+
+void node_tree::serialize_in_pipelined(streambase& ar, const node_ready_fn& on_node, const std::atomic<bool>* cancel)
+{
+  m_partial.reset();
+
+  serial_tree stree;
+  chunks_layout layout;
+  if (!read_layout(ar, stree, layout))
+  {
+    return;
+  }
+
+  stree.set_intern_payloads(m_shared_payloads);
+
+  const auto& chunk_descs = layout.chunk_descs;
+  const uint32_t chunks_start = layout.chunks_start;
+
+  // uncompressed saves have nothing to decode, the nodes are handed out
+  // once the tree is lifted
+  if (m_ver.ps4w || chunk_descs.empty())
+  {
+    std::span<const char> tree_src;
+    os::file_mapping src_mapping;
+    if (!read_chunks(ar, stree, layout, tree_src, cancel, &src_mapping))
+    {
+      return;
+    }
+
+    lift_tree(ar, stree, chunks_start, tree_src, cancel);
+    if (ar.has_error())
+    {
+      return;
+    }
+
+    for (const auto& node : root->children())
+    {
+      if (!node->is_blob())
+        on_node(node);
+    }
+    return;
+  }
+
+  std::vector<uint32_t> toplevel;
+  if (!stree.toplevel_nodes(toplevel))
+  {
+    ar.set_error("couldn't lift a tree from serial_tree");
+    return;
+  }
+
+  uint64_t cdata_end = 0;
+  if (!layout.cdata_end(ar, cdata_end))
+  {
+    return;
+  }
+
+  // chunks are contiguous in nodedata (sorted by data_offset), the ones
+  // covering each top-level node are counted down by the decoding tasks
+  const size_t nodes_cnt = toplevel.size();
+  std::unique_ptr<std::atomic<uint32_t>[]> pending_chunks(new std::atomic<uint32_t>[nodes_cnt]);
+  std::vector<std::vector<uint32_t>> chunk_nodes(chunk_descs.size());
+  for (size_t k = 0; k < nodes_cnt; ++k)
+  {
+    const auto& desc = stree.descs[toplevel[k]];
+    const uint64_t start = desc.data_offset;
+    const uint64_t end = start + desc.data_size;
+    if (desc.data_size < 4 || start < chunks_start || end > layout.nodedata_size)
+    {
+      ar.set_error("couldn't lift a tree from serial_tree");
+      return;
+    }
+
+    auto it = std::upper_bound(chunk_descs.begin(), chunk_descs.end(), start,
+      [](uint64_t offset, const auto& cd) { return offset < (uint64_t)cd.data_offset + cd.data_size; });
+
+    uint32_t cnt = 0;
+    for (; it != chunk_descs.end() && it->data_offset < end; ++it, ++cnt)
+    {
+      chunk_nodes[it - chunk_descs.begin()].push_back((uint32_t)k);
+    }
+    pending_chunks[k].store(cnt, std::memory_order_relaxed);
+  }
+
+  auto* const mem_ar = dynamic_cast<memory_istream*>(&ar);
+  const uint64_t cdata_start = chunk_descs[0].offset;
+
+  std::vector<char> cdata_buf;
+  const char* cdata = nullptr;
+  if (mem_ar)
+  {
+    cdata = mem_ar->data() + cdata_start;
+  }
+  else
+  {
+    cdata_buf.resize(cdata_end - cdata_start);
+    cdata = cdata_buf.data();
+  }
+
+  auto& nodedata = stree.nodedata;
+  nodedata.clear();
+  nodedata.resize(layout.nodedata_size);
+  // decoded in place, blobs then view it (see serial_tree::share_nodedata)
+  char* const pnodedata = nodedata.data();
+  const std::span<const char> tree_src = stree.share_nodedata();
+
+  // top-level nodes by desc index
+  std::vector<shared_node_type> lifted(stree.descs.size());
+  stree.begin_lift();
+
+  std::atomic<const char*> first_error = nullptr;
+  task_group group;
+
+  const bool threaded = resolve_workers_count(m_workers_cnt, chunk_descs.size()) > 1;
+  auto spawn = [&](task_scheduler::task_fn fn)
+  {
+    if (threaded)
+      group.run(std::move(fn));
+    else
+      fn();
+  };
+
+  auto fail = [&](const char* err)
+  {
+    const char* expected = nullptr;
+    first_error.compare_exchange_strong(expected, err);
+    group.cancel();
+  };
+
+  auto lift = [&](uint32_t k)
+  {
+    const uint32_t idx = toplevel[k];
+    const auto& desc = stree.descs[idx];
+
+    scoped_trace_span lift_span("csav.lift_node", desc.name);
+    lift_span.set_bytes(desc.data_size);
+
+    auto node = stree.lift_node(idx, tree_src.subspan(desc.data_offset, desc.data_size), desc.data_offset);
+    if (!node)
+    {
+      fail("couldn't lift a tree from serial_tree");
+      return;
+    }
+
+    lifted[idx] = node;
+    on_node(node);
+  };
+
+  auto decode = [&](size_t i)
+  {
+    if (cancel && cancel->load(std::memory_order_relaxed))
+    {
+      fail("cancelled");
+      return;
+    }
+
+    const auto& cd = chunk_descs[i];
+    if (const char* err = decode_chunk(cd, cdata + (cd.offset - cdata_start), pnodedata))
+    {
+      fail(err);
+      return;
+    }
+
+    // the last decoder of a node sees the bytes of the others (acq_rel)
+    for (uint32_t k : chunk_nodes[i])
+    {
+      if (pending_chunks[k].fetch_sub(1, std::memory_order_acq_rel) == 1)
+        spawn([&lift, k]() { lift(k); });
+    }
+  };
+
+  {
+    scoped_span span("csav.pipeline");
+    span.set_bytes(layout.nodedata_size - chunks_start);
+
+    // chunks are read in order, each one is decoded as soon as it is read
+    uint64_t read_end = cdata_start;
+    if (!mem_ar)
+    {
+      ar.seek(cdata_start);
+    }
+
+    for (size_t i = 0; i < chunk_descs.size() && !first_error.load(std::memory_order_relaxed); ++i)
+    {
+      const auto& cd = chunk_descs[i];
+      const uint64_t end = (uint64_t)cd.offset + cd.size;
+      if (!mem_ar && end > read_end)
+      {
+        scoped_trace_span read_span("csav.read_chunk");
+        read_span.set_bytes(end - read_end);
+
+        ar.serialize_bytes(cdata_buf.data() + (read_end - cdata_start), end - read_end);
+        read_end = end;
+        if (ar.has_error())
+        {
+          group.cancel();
+          break;
+        }
+      }
+
+      spawn([&decode, i]() { decode(i); });
+    }
+
+    group.wait();
+  }
+
+  if (ar.has_error())
   {
-    ar.set_error("missing 'NODE' tag");
     return;
   }
 
-  // now read node descs
-  size_t nd_cnt = 0;
-  ar.serialize_int_packed(nd_cnt);
-  stree.descs.resize(nd_cnt);
-  for (size_t i = 0; i < nd_cnt; ++i)
-  {
-    ar << stree.descs[i];
-  }
-  if ((size_t)ar.tell() != footer_start)
+  if (const char* err = first_error.load())
   {
-    ar.set_error("unexpected footer position");
+    ar.set_error(err);
     return;
   }
 
-  // --------------------------------------------------------
-  //  COMPRESSED CHUNKS
-  // --------------------------------------------------------
-
-  // descriptors (padded with 0 until actual first chunk)
-
-  ar.seek(chunkdescs_start);
-  ar << magic;
-  if (magic != 'CLZF')
+  // the nodes don't cover the descriptors that aren't reachable from the root
+  if (!stree.check_node_indices(tree_src))
   {
-    ar.set_error("missing 'CLZF' tag");
+    ar.set_error("couldn't lift a tree from serial_tree");
     return;
   }
 
-  uint32_t cd_cnt = 0;
-  ar << cd_cnt;
-  chunk_descs.resize(cd_cnt);
-  for (uint32_t i = 0; i < cd_cnt; ++i)
+  if (m_incremental_save)
   {
-    ar << chunk_descs[i];
+    scoped_span span("csav.keep_chunks");
+    keep_chunks(layout, cdata, tree_src);
   }
 
-  // actual chunks
-
-  std::sort(chunk_descs.begin(), chunk_descs.end(),
-    [](auto& a, auto& b){return a.offset < b.offset; });
-  uint64_t nodedata_size = 0;
-  uint32_t chunks_start = 0;
-
-  if (chunk_descs.size())
   {
-    chunks_start = chunk_descs[0].offset;
-    uint32_t data_offset = chunks_start; // that's how they do, minimal offset in file..
-    for (int i = 0; i < chunk_descs.size(); ++i)
-    {
-      auto& cd = chunk_descs[i];
-      cd.data_offset = data_offset;
-      data_offset += cd.data_size;
-    }
-    nodedata_size = data_offset;
+    scoped_span span("csav.assemble_root");
+    root = stree.assemble_root(chunks_start, tree_src, &lifted);
+    stree.end_lift();
   }
 
-  // --------------------------------------------------------
-  //  DECOMPRESSION from compressed chunks to nodedata
-  // --------------------------------------------------------
+  finish_load(ar, stree, chunks_start, tree_src);
+}
 
-  // we are not concerned by ram nor time, let's decompress the whole node
-  std::vector<char> tmp;
-  tmp.resize(XLZ4_CHUNK_SIZE);
-  nodedata.clear();
-  nodedata.resize(nodedata_size);
+std::vector<node_tree::shared_node_type> node_tree::find_nodes(std::string_view name) const
+{
+  std::vector<shared_node_type> ret;
 
-  m_ver.ps4w = false;
-  for (int i = 0; i < chunk_descs.size(); ++i)
+  rebuild_index();
+  auto it = m_name_index.find(name);
+  if (it != m_name_index.end())
   {
-    auto& cd = chunk_descs[i];
-
-    ar.seek(cd.offset);
-    ar << magic;
-    if (magic != 'XLZ4')
-    {
-      if (i > 0)
-      {
-        ar.set_error("missing 'XLZ4' tag");
-        return;
-      }
-
-      m_ver.ps4w = true;
-      break;
-    }
-
-    uint32_t data_size = 0;
-    ar << data_size;
-    if (data_size != cd.data_size)
+    ret.reserve(it->second.size());
+    for (const auto& wn : it->second)
     {
-      ar.set_error("data size prefix differs from descriptor's value");
-      return;
+      if (auto n = wn.lock())
+        ret.emplace_back(std::move(n));
     }
+  }
 
-    size_t csize = cd.size-8;
-    if (csize > tmp.size())
-      tmp.resize(csize);
-    ar.serialize_bytes(tmp.data(), csize);
+  return ret;
+}
 
-    int res = LZ4_decompress_safe(tmp.data(), nodedata.data() + cd.data_offset, (int)csize, cd.data_size);
-    if (res != cd.data_size)
+node_tree::shared_node_type node_tree::find_node(std::string_view name) const
+{
+  rebuild_index();
+  auto it = m_name_index.find(name);
+  if (it != m_name_index.end())
+  {
+    for (const auto& wn : it->second)
     {
-      ar.set_error("unexpected lz4 decompressed size");
-      return;
+      if (auto n = wn.lock())
+        return n;
     }
   }
 
-  if (m_ver.ps4w)
+  return nullptr;
+}
+
+void node_tree::unbind_index() const
+{
+  if (auto indexed_root = m_indexed_root.lock())
   {
-    size_t offset = chunk_descs[0].offset;
-    ar.seek(offset);
-    ar.serialize_bytes(nodedata.data() + offset, nodedata_size - offset);
+    indexed_root->remove_listener(const_cast<node_tree*>(this));
   }
+  m_indexed_root.reset();
+  m_name_index.clear();
+  m_index_dirty = true;
+}
 
-  if (ar.has_error())
+void node_tree::rebuild_index() const
+{
+  auto indexed_root = m_indexed_root.lock();
+  if (!m_index_dirty && indexed_root == root)
   {
     return;
   }
 
-  // --------------------------------------------------------
-  //  UNFLATTENING of node tree
-  // --------------------------------------------------------
+  unbind_index();
 
-  root = stree.to_tree(chunks_start);
   if (!root)
   {
-    ar.set_error("couldn't lift a tree from serial_tree");
     return;
   }
 
-  const uint32_t data_size = (uint32_t)nodedata.size() - chunks_start;
-  auto tree_size = root->calcsize();
+  // names are views into nodes' names, they are only used until the next edit
+  m_name_index.reserve(original_descs.size());
 
-  // Check that the unflattening worked.
-  if (tree_size != data_size)
+  std::vector<shared_node_type> dfs_stack { root };
+  while (dfs_stack.size())
   {
-    ar.set_error("lift tree size differs from serial_tree size");
-    return;
-  }
+    auto n = std::move(dfs_stack.back());
+    dfs_stack.pop_back();
 
-  // --------------------------------------------------------
-  //  MISC
-  // --------------------------------------------------------
+    if (n->is_cnode())
+    {
+      m_name_index[n->name_view()].emplace_back(n);
+    }
 
-  original_descs = stree.descs;
+    const auto& children = n->children();
+    for (auto it = children.rbegin(); it != children.rend(); ++it)
+    {
+      dfs_stack.emplace_back(*it);
+    }
+  }
+
+  // events of the whole tree bubble up to root
+  root->add_listener(const_cast<node_tree*>(this));
+  m_indexed_root = root;
+  m_index_dirty = false;
 }
 
 void node_tree::serialize_out(streambase& ar)
@@ -302,6 +1017,10 @@ void node_tree::serialize_out(streambase& ar)
 
   std::vector<compressed_chunk_desc> chunk_descs;
 
+  // current phase, see instrumentation.hpp
+  std::optional<scoped_span> span;
+  span.emplace("csav.write_header");
+
   // --------------------------------------------------------
   //  HEADER (magic, m_ver..)
   // --------------------------------------------------------
@@ -326,6 +1045,17 @@ void node_tree::serialize_out(streambase& ar)
 
   uint32_t expected_raw_size = (uint32_t)root->calcsize();
   size_t max_chunkcnt = LZ4_compressBound(expected_raw_size) / XLZ4_CHUNK_SIZE + 2; // tbl should fit in 1 extra XLZ4_CHUNK_SIZE 
+
+  const bool incremental = m_incremental_save && !m_ver.ps4w && m_save_profile != save_profile::small;
+  const bool windowed = m_save_profile == save_profile::fast
+    || (m_parallel_compression && m_save_profile == save_profile::balanced);
+  const int acceleration = m_save_profile == save_profile::fast ? m_lz4_acceleration : 1;
+  if (incremental)
+  {
+    // reused chunks split the modified ranges, each one can end with a
+    // partial chunk
+    max_chunkcnt += 2 * m_original_chunks.size();
+  }
   size_t chunktbl_maxsize = max_chunkcnt * compressed_chunk_desc::serialized_size + 8;
 
   std::vector<char> tmp;
@@ -340,10 +1070,27 @@ void node_tree::serialize_out(streambase& ar)
   // --------------------------------------------------------
 
   serial_tree stree;
-  if (!stree.from_tree(root, chunks_start))
+  if (m_ver.ps4w)
   {
-    ar.set_error("couldn't flatten node_t tree.");
-    return;
+    // uncompressed, the nodes are written straight to ar (see write_tree)
+    // and the chunks below are only slices of what was written.
+    span.emplace("csav.write_chunks");
+    if (!stree.write_tree(root, chunks_start, ar))
+    {
+      ar.set_error("couldn't write node_t tree.");
+      return;
+    }
+    span->set_bytes(expected_raw_size);
+  }
+  else
+  {
+    span.emplace("csav.from_tree");
+    if (!stree.from_tree(root, chunks_start, m_parallel_compression ? m_workers_cnt : 1))
+    {
+      ar.set_error("couldn't flatten node_t tree.");
+      return;
+    }
+    span->set_bytes(stree.nodedata.size());
   }
 
   // --------------------------------------------------------
@@ -358,32 +1105,235 @@ void node_tree::serialize_out(streambase& ar)
   char* const pend = prealbeg + stree.nodedata.size();
   char* pcur = pbeg;
 
-  i = 1;
-  while (pcur < pend)
+  // the chunks loops below interleave compression and writes,
+  // these get per-chunk spans instead
+  span.reset();
+
+  if (m_ver.ps4w)
+  {
+    const uint32_t data_end = chunks_start + expected_raw_size;
+    for (uint32_t offset = chunks_start; offset < data_end; offset += XLZ4_CHUNK_SIZE)
+    {
+      auto& chunk_desc = chunk_descs.emplace_back();
+      chunk_desc.data_offset = offset;
+      chunk_desc.offset = offset;
+      chunk_desc.size = std::min<uint32_t>(XLZ4_CHUNK_SIZE, data_end - offset);
+      chunk_desc.data_size = chunk_desc.size;
+    }
+  }
+  else if (incremental)
+  {
+    // unmodified tree since load: every chunk can be reused without checking
+    const bool trusted = !m_modified && m_loaded_root.lock() == root;
+
+    // original chunks are keyed on their content (size and hash of their
+    // source bytes), not on their offset: they are looked for at their old
+    // offset moved by the current shift, which changes when an edit changed
+    // the size of the data before them.
+    auto& ocs = m_original_chunks;
+    const int64_t total_size = (int64_t)(pend - pbeg);
+    const int64_t old_total_size = ocs.empty() ? 0 : (int64_t)ocs.back().rel_data_offset + ocs.back().data_size;
+    // shift of the data following the last edit
+    const int64_t tail_shift = total_size - old_total_size;
+    int64_t shift = 0;
+
+    auto matches_at = [&](size_t idx, int64_t s, int64_t min_offset) {
+      const auto& oc = ocs[idx];
+      const int64_t offset = (int64_t)oc.rel_data_offset + s;
+      if (offset < min_offset || offset + oc.data_size > total_size)
+        return false;
+      if (trusted && s == 0)
+        return true;
+      return crc64_bigdata(pbeg + offset, oc.data_size) == oc.data_hash;
+    };
+
+    std::vector<original_chunk> new_chunks;
+    new_chunks.reserve(ocs.size());
+
+    auto write_chunk = [&](original_chunk& oc, uint32_t rel_offset) {
+      auto& chunk_desc = chunk_descs.emplace_back();
+      chunk_desc.data_offset = chunks_start + rel_offset;
+      chunk_desc.offset = (uint32_t)ar.tell();
+      chunk_desc.size = (uint32_t)oc.cdata.size();
+      chunk_desc.data_size = oc.data_size;
+
+      scoped_span chunk_span("csav.write_chunks");
+      chunk_span.set_bytes(oc.cdata.size());
+      ar.serialize_bytes(oc.cdata.data(), oc.cdata.size());
+
+      oc.rel_data_offset = rel_offset;
+      new_chunks.emplace_back(std::move(oc));
+    };
+
+    size_t oc_idx = 0;
+    bool resynced = false;
+    while (pcur < pend)
+    {
+      const int64_t rel_offset = (int64_t)(pcur - pbeg);
+
+      while (oc_idx < ocs.size() && (int64_t)ocs[oc_idx].rel_data_offset + shift < rel_offset)
+      {
+        ++oc_idx;
+      }
+
+      if (oc_idx < ocs.size() && (int64_t)ocs[oc_idx].rel_data_offset + shift == rel_offset
+        && (resynced || matches_at(oc_idx, shift, rel_offset)))
+      {
+        // same source bytes, copy the compressed chunk verbatim
+        const uint32_t data_size = ocs[oc_idx].data_size;
+        write_chunk(ocs[oc_idx], (uint32_t)rel_offset);
+        pcur += data_size;
+        ++oc_idx;
+        resynced = false;
+        continue;
+      }
+
+      // modified range: it ends where a following original chunk is found
+      // again, at the current shift (same size edit) or at the tail one
+      int64_t range_end = total_size;
+      for (size_t j = oc_idx; j < ocs.size(); ++j)
+      {
+        if (matches_at(j, shift, rel_offset + 1))
+        {
+          range_end = (int64_t)ocs[j].rel_data_offset + shift;
+          oc_idx = j;
+          resynced = true;
+          break;
+        }
+        if (tail_shift != shift && matches_at(j, tail_shift, rel_offset + 1))
+        {
+          shift = tail_shift;
+          range_end = (int64_t)ocs[j].rel_data_offset + shift;
+          oc_idx = j;
+          resynced = true;
+          break;
+        }
+      }
+
+      if (!resynced)
+        oc_idx = ocs.size();
+
+      // the range is compressed into new chunks
+      char* const prange_end = pbeg + range_end;
+      while (pcur < prange_end)
+      {
+        int srcsize = (int)(prange_end - pcur);
+
+        int csize = 0;
+        {
+          scoped_span chunk_span("csav.lz4_encode");
+          csize = LZ4_compress_destSize(pcur, ptmp, &srcsize, XLZ4_CHUNK_SIZE);
+          chunk_span.set_bytes(srcsize);
+        }
+
+        if (csize <= 0)
+        {
+          ar.set_error("lz4 compression failed");
+          return;
+        }
+
+        original_chunk nc;
+        nc.data_size = srcsize;
+        nc.data_hash = crc64_bigdata(pcur, srcsize);
+        nc.cdata.resize(csize + 8);
+        const uint32_t chunk_magic = 'XLZ4';
+        std::memcpy(nc.cdata.data(), &chunk_magic, 4);
+        std::memcpy(nc.cdata.data() + 4, &srcsize, 4);
+        std::memcpy(nc.cdata.data() + 8, ptmp, csize);
+
+        write_chunk(nc, (uint32_t)(pcur - pbeg));
+        pcur += srcsize;
+      }
+    }
+
+    // next save is relative to this one
+    m_original_chunks = std::move(new_chunks);
+    m_loaded_root = root;
+    m_modified = false;
+  }
+  else if (windowed)
   {
-    auto& chunk_desc = chunk_descs.emplace_back();
+    // fixed input windows, compressed independently and written in order
+    const size_t total_size = (size_t)(pend - pbeg);
+    const size_t windows_cnt = (total_size + XLZ4_CHUNK_SIZE - 1) / XLZ4_CHUNK_SIZE;
+    std::vector<std::vector<char>> cwindows(windows_cnt);
+    std::atomic<bool> failed = false;
+
+    span.emplace("csav.lz4_encode");
+    span->set_bytes(total_size);
+    parallel_for(windows_cnt, m_parallel_compression ? m_workers_cnt : 1, [&](size_t i)
+    {
+      const size_t window_offset = i * XLZ4_CHUNK_SIZE;
+      const int srcsize = (int)std::min<size_t>(XLZ4_CHUNK_SIZE, total_size - window_offset);
 
-    chunk_desc.data_offset = (uint32_t)(pcur - prealbeg);
-    chunk_desc.offset = (uint32_t)ar.tell();
+      scoped_trace_span chunk_span("csav.lz4_encode_chunk");
+      chunk_span.set_bytes(srcsize);
 
-    int srcsize = (int)(pend - pcur);
+      auto& cwindow = cwindows[i];
+      cwindow.resize(LZ4_compressBound(srcsize));
+      int csize = LZ4_compress_fast(pbeg + window_offset, cwindow.data(), srcsize, (int)cwindow.size(), acceleration);
+      if (csize <= 0)
+      {
+        failed = true;
+        return;
+      }
+      cwindow.resize(csize);
+    });
 
-    if (m_ver.ps4w)
+    if (failed)
     {
-      srcsize = std::min(srcsize, XLZ4_CHUNK_SIZE);
-      // write decompressed chunk
-      ar.serialize_bytes(pcur, srcsize);
-      chunk_desc.size = srcsize;
+      ar.set_error("lz4 compression failed");
+      return;
     }
-    else
+
+    span.emplace("csav.write_chunks");
+    for (const auto& cwindow : cwindows)
+    {
+      auto& chunk_desc = chunk_descs.emplace_back();
+
+      const int srcsize = (int)std::min<size_t>(XLZ4_CHUNK_SIZE, pend - pcur);
+      chunk_desc.data_offset = (uint32_t)(pcur - prealbeg);
+      chunk_desc.offset = (uint32_t)ar.tell();
+
+      magic = 'XLZ4';
+      ar << magic;
+      ar << srcsize;
+      ar.serialize_bytes((void*)cwindow.data(), cwindow.size());
+      span->add_bytes(cwindow.size() + 8);
+
+      chunk_desc.size = (uint32_t)cwindow.size() + 8;
+      chunk_desc.data_size = srcsize;
+      pcur += srcsize;
+    }
+    span.reset();
+  }
+  else
+  {
+    while (pcur < pend)
     {
-      int csize = LZ4_compress_destSize(pcur, ptmp, &srcsize, XLZ4_CHUNK_SIZE);
+      auto& chunk_desc = chunk_descs.emplace_back();
+
+      chunk_desc.data_offset = (uint32_t)(pcur - prealbeg);
+      chunk_desc.offset = (uint32_t)ar.tell();
+
+      int srcsize = (int)(pend - pcur);
+
+      int csize = 0;
+      {
+        scoped_span chunk_span("csav.lz4_encode");
+        csize = LZ4_compress_destSize(pcur, ptmp, &srcsize, XLZ4_CHUNK_SIZE);
+        chunk_span.set_bytes(srcsize);
+      }
+
       if (csize < 0)
       {
         ar.set_error("lz4 compression failed");
         return;
       }
 
+      scoped_span chunk_span("csav.write_chunks");
+      chunk_span.set_bytes(csize + 8);
+
       // write magic
       magic = 'XLZ4';
       ar << magic;
@@ -394,17 +1344,19 @@ void node_tree::serialize_out(streambase& ar)
       ar.serialize_bytes(ptmp, csize);
 
       chunk_desc.size = csize+8;
+      chunk_desc.data_size = srcsize;
+      pcur += srcsize;
     }
-
-    chunk_desc.data_size = srcsize;
-    pcur += srcsize;
   }
+
   if (pcur > pend)
   {
     ar.set_error("pcur > pend");
     return;
   }
 
+  span.emplace("csav.write_descs");
+
   nodedescs_start = (uint32_t)ar.tell();
 
   // descriptors
@@ -454,5 +1406,263 @@ void node_tree::serialize_out(streambase& ar)
   ar << magic;
 }
 
+// --------------------------------------------------------
+//  DECODED SIDECAR
+// --------------------------------------------------------
+// header
+// version (v1, v2, v3, uk0, uk1, suk, ps4w)
+// descriptors
+// image (tree_src, chunks_start included), page aligned
+
+struct csdc_header
+{
+  static constexpr uint32_t current_version = 1;
+  static constexpr uint64_t image_alignment = 0x1000;
+
+  uint32_t magic = 'CSDC';
+  uint32_t version = current_version;
+  uint64_t save_size = 0;
+  uint64_t save_time = 0;
+  uint64_t save_hash = 0;
+  uint32_t chunks_start = 0;
+  uint32_t descs_cnt = 0;
+  uint64_t image_offset = 0;
+  uint64_t image_size = 0;
+
+  bool is_magic_ok() const
+  {
+    return magic == 'CSDC';
+  }
+};
+
+op_status node_tree::load_cached(std::filesystem::path path, std::filesystem::path cache_path, const std::atomic<bool>* cancel)
+{
+  scoped_span span("csav.load_cached");
+  scoped_alloc_tag alloc_scope(alloc_tag::csav);
+
+  decoded_cache_key key;
+  std::error_code ec;
+  key.size = std::filesystem::file_size(path, ec);
+  if (ec)
+  {
+    return op_status(fmt::format("couldn't open {}", path.string()));
+  }
+
+  const auto time = std::filesystem::last_write_time(path, ec);
+  if (!ec)
+  {
+    key.time = static_cast<uint64_t>(time.time_since_epoch().count());
+  }
+
+  // the save is mapped on demand, to hash it or to load it, once
+  os::file_mapping save_mapping;
+  std::span<const char> save_data;
+  bool hashed = false;
+
+  auto hash_save = [&](decoded_cache_key& k)
+  {
+    if (!hashed)
+    {
+      if (!save_mapping.open(path))
+      {
+        return false;
+      }
+
+      save_data = save_mapping.view();
+      k.size = save_data.size();
+
+      scoped_span hash_span("csav.hash_save");
+      hash_span.set_bytes(save_data.size());
+      k.hash = crc64_parallel(save_data.data(), save_data.size(), 0, m_workers_cnt);
+      hashed = true;
+    }
+    return true;
+  };
+
+  if (load_decoded_cache(cache_path, key, hash_save, cancel))
+  {
+    return true;
+  }
+
+  // the hash is the key of the new sidecar
+  if (!hash_save(key))
+  {
+    return op_status(fmt::format("couldn't open {}", path.string()));
+  }
+
+  m_partial.reset();
+
+  memory_istream ar(save_data);
+  serial_tree stree;
+  uint32_t chunks_start = 0;
+  std::span<const char> tree_src;
+
+  if (!read_serial_tree(ar, stree, chunks_start, tree_src, cancel))
+  {
+    return op_status(ar.error());
+  }
+
+  // the image stays valid after the lift, shared or not (see lift_source)
+  tree_src = lift_source(stree, tree_src);
+  lift_tree(ar, stree, chunks_start, tree_src, cancel);
+  if (ar.has_error())
+  {
+    return op_status(ar.error());
+  }
+
+  save_decoded_cache(cache_path, key, stree, chunks_start, tree_src);
+  return true;
+}
+
+bool node_tree::load_decoded_cache(const std::filesystem::path& cache_path, decoded_cache_key& key,
+  const std::function<bool(decoded_cache_key&)>& hash_save, const std::atomic<bool>* cancel)
+{
+  scoped_span span("csav.load_decoded_cache");
+
+  os::file_mapping fmapping;
+  if (!fmapping.open(cache_path))
+  {
+    return false;
+  }
+
+  const auto view = fmapping.view();
+  memory_istream ar(view);
+
+  csdc_header hdr;
+  ar.serialize_pod_raw(hdr);
+  if (ar.has_error() || !hdr.is_magic_ok() || hdr.version != csdc_header::current_version)
+  {
+    SPDLOG_WARN("{} isn't a valid decoded save", cache_path.string());
+    return false;
+  }
+
+  bool outdated = (hdr.save_size != key.size);
+  if (!outdated && hdr.save_time != key.time)
+  {
+    // a save with another write time can have the same content (e.g. a copy)
+    outdated = !hash_save(key) || hdr.save_size != key.size || hdr.save_hash != key.hash;
+  }
+
+  if (outdated)
+  {
+    SPDLOG_INFO("decoded save {} is outdated", cache_path.string());
+    return false;
+  }
+
+  if (hdr.image_offset > view.size() || hdr.image_size > view.size() - hdr.image_offset
+    || hdr.chunks_start > hdr.image_size || hdr.descs_cnt > hdr.image_offset)
+  {
+    SPDLOG_WARN("{} is truncated", cache_path.string());
+    return false;
+  }
+
+  version ver;
+  uint8_t ps4w = 0;
+  ar << ver.v1 << ver.v2 << ver.v3 << ver.uk0 << ver.uk1;
+  ar.serialize_str_lpfxd(ver.suk);
+  ar << ps4w;
+  ver.ps4w = ps4w != 0;
+
+  serial_tree stree;
+  stree.descs.resize(hdr.descs_cnt);
+  for (auto& desc : stree.descs)
+  {
+    ar << desc;
+  }
+
+  if (ar.has_error() || ar.tell() > static_cast<int64_t>(hdr.image_offset))
+  {
+    SPDLOG_WARN("{} isn't a valid decoded save", cache_path.string());
+    return false;
+  }
+
+  // the image is lifted in place, the blobs viewing it keep the mapping alive
+  const auto image = view.subspan(static_cast<size_t>(hdr.image_offset), static_cast<size_t>(hdr.image_size));
+  auto image_mapping = std::make_shared<const os::file_mapping>(std::move(fmapping));
+
+  m_partial.reset();
+  m_original_chunks.clear();
+  m_ver = ver;
+
+  stree.set_intern_payloads(m_shared_payloads);
+  const auto tree_src = m_shared_payloads ? image : stree.share_image(std::move(image_mapping), image);
+  lift_tree(ar, stree, hdr.chunks_start, tree_src, cancel);
+  if (ar.has_error())
+  {
+    // a cancelled load fails again on the save, quickly
+    SPDLOG_WARN("couldn't load decoded save {}: {}", cache_path.string(), ar.error());
+    return false;
+  }
+
+  return true;
+}
+
+bool node_tree::save_decoded_cache(const std::filesystem::path& cache_path, const decoded_cache_key& key, const serial_tree& stree,
+  uint32_t chunks_start, std::span<const char> tree_src) const
+{
+  scoped_span span("csav.save_decoded_cache");
+  span.set_bytes(tree_src.size());
+
+  memory_ostream meta;
+  {
+    version ver = m_ver;
+    uint8_t ps4w = ver.ps4w ? 1 : 0;
+    meta << ver.v1 << ver.v2 << ver.v3 << ver.uk0 << ver.uk1;
+    meta.serialize_str_lpfxd(ver.suk);
+    meta << ps4w;
+
+    for (auto desc : stree.descs)
+    {
+      meta << desc;
+    }
+  }
+
+  csdc_header hdr;
+  hdr.save_size = key.size;
+  hdr.save_time = key.time;
+  hdr.save_hash = key.hash;
+  hdr.chunks_start = chunks_start;
+  hdr.descs_cnt = static_cast<uint32_t>(stree.descs.size());
+  const uint64_t meta_end = sizeof(csdc_header) + meta.size();
+  hdr.image_offset = (meta_end + csdc_header::image_alignment - 1) & ~(csdc_header::image_alignment - 1);
+  hdr.image_size = tree_src.size();
+
+  auto tmp_path = cache_path;
+  tmp_path += ".tmp";
+
+  {
+    file_ostream ofs(tmp_path);
+    if (!ofs.good())
+    {
+      SPDLOG_ERROR("couldn't create {}", tmp_path.string());
+      return false;
+    }
+
+    ofs.serialize_pod_raw(hdr);
+    const auto meta_data = meta.gather();
+    ofs.serialize_bytes(const_cast<char*>(meta_data.data()), meta_data.size());
+    std::vector<char> padding(static_cast<size_t>(hdr.image_offset - meta_end), 0);
+    ofs.serialize_bytes(padding.data(), padding.size());
+    ofs.serialize_bytes(const_cast<char*>(tree_src.data()), tree_src.size());
+
+    ofs.close();
+    if (!ofs.good() || ofs.has_error())
+    {
+      SPDLOG_ERROR("couldn't write {}", tmp_path.string());
+      return false;
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tmp_path, cache_path, ec);
+  if (ec)
+  {
+    SPDLOG_ERROR("couldn't rename {}: {}", tmp_path.string(), ec.message());
+    return false;
+  }
+
+  return true;
+}
+
 } // namespace cp::csav
 
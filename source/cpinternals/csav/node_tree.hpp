@@ -1,18 +1,41 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
 #include <filesystem>
+#include <functional>
+#include <memory>
 #include <vector>
+#include <unordered_map>
+#include <string_view>
 
+#include <cpinternals/os/file_mapping.hpp>
+#include <cpinternals/io/memory_ostream.hpp>
 #include <cpinternals/csav/node.hpp>
 #include <cpinternals/csav/version.hpp>
 #include <cpinternals/csav/serial_tree.hpp>
+#include <cpinternals/csav/flat_tree.hpp>
+#include <cpinternals/csav/save_peek.hpp>
 
 namespace cp::csav {
 
 struct node_tree
+  : node_listener_t
 {
   using node_type = node_t;
   using shared_node_type = std::shared_ptr<const node_t>;
 
+  // see load_pipelined
+  using node_ready_fn = std::function<void(const shared_node_type&)>;
+
+  node_tree() = default;
+  ~node_tree() override
+  {
+    unbind_index();
+  }
+
+  node_tree(const node_tree&) = delete;
+  node_tree& operator=(const node_tree&) = delete;
+
   version& ver()
   {
     return m_ver;
@@ -23,11 +46,183 @@ struct node_tree
     return m_ver;
   }
 
-  op_status load(std::filesystem::path path);
+  // number of threads used to (de)compress chunks.
+  // 0 means one per hardware thread, 1 disables threading.
+  size_t workers_count() const
+  {
+    return m_workers_cnt;
+  }
+
+  void set_workers_count(size_t cnt)
+  {
+    m_workers_cnt = cnt;
+  }
+
+  // when enabled, serialize_out splits nodedata into fixed XLZ4_CHUNK_SIZE
+  // windows that are compressed concurrently (chunks sizes then differ from
+  // the sequential mode but the layout stays the same).
+  // the tree is then also flattened concurrently (see serial_tree::from_tree).
+  bool parallel_compression() const
+  {
+    return m_parallel_compression;
+  }
+
+  void set_parallel_compression(bool enabled)
+  {
+    m_parallel_compression = enabled;
+  }
+
+  // compression trade-off of serialize_out, all produce chunks the game
+  // already reads (the layouts of the sequential and parallel modes):
+  //  - balanced: the modes above, default LZ4.
+  //  - fast: fixed windows (parallel mode layout, concurrent only if parallel
+  //    compression is enabled) compressed with LZ4 acceleration.
+  //  - small: sequential mode, chunks are filled up to XLZ4_CHUNK_SIZE with
+  //    LZ4_compress_destSize and never split at reused chunks boundaries
+  //    (incremental save is ignored).
+  enum class save_profile : uint8_t
+  {
+    balanced,
+    fast,
+    small,
+  };
+
+  save_profile get_save_profile() const
+  {
+    return m_save_profile;
+  }
+
+  void set_save_profile(save_profile profile)
+  {
+    m_save_profile = profile;
+  }
+
+  // acceleration of the fast profile, see LZ4_compress_fast
+  int lz4_acceleration() const
+  {
+    return m_lz4_acceleration;
+  }
+
+  void set_lz4_acceleration(int acceleration)
+  {
+    m_lz4_acceleration = std::max(acceleration, 1);
+  }
+
+  // when enabled (before load), the compressed chunks are kept in memory and
+  // serialize_out copies the ones whose source bytes didn't change verbatim
+  // instead of recompressing them. chunks are found by content: the ones
+  // after an edit that changed the data size are still reused.
+  // takes precedence over parallel compression.
+  bool incremental_save() const
+  {
+    return m_incremental_save;
+  }
+
+  void set_incremental_save(bool enabled)
+  {
+    m_incremental_save = enabled;
+    if (!enabled)
+      m_original_chunks.clear();
+  }
+
+  // when enabled (before load), the node payloads are deduplicated across
+  // the trees that enable it (see payload_store), e.g. for several saves of
+  // a playthrough open at once. otherwise blobs view the decompressed image
+  // of their own tree.
+  bool shared_payloads() const
+  {
+    return m_shared_payloads;
+  }
+
+  void set_shared_payloads(bool enabled)
+  {
+    m_shared_payloads = enabled;
+  }
+
+  // cancel can be set from another thread to abort the load, it then fails
+  // with a "cancelled" error.
+  op_status load(std::filesystem::path path, const std::atomic<bool>* cancel = nullptr);
+
+  // Same as load but from a save already in memory (e.g. received over the
+  // network), read in place like open_mapped: data only has to outlive the call.
+  op_status load(std::span<const char> data, const std::atomic<bool>* cancel = nullptr);
+
+  // Same as load but through a decoded sidecar at cache_path, keyed by the
+  // size, write time and crc64 of the save: when it matches, the version,
+  // descriptors and decompressed image are taken from it (no decompression)
+  // and only the lift remains. the save is only read (and hashed) if its
+  // write time differs from the sidecar's (e.g. a copy) or if it has to be
+  // loaded, the sidecar is then (re)written after a successful lift, failing
+  // to write it doesn't fail the load.
+  // the blobs view the mapped sidecar (unless the payloads are interned), it
+  // stays mapped until they are edited or released.
+  // with incremental_save the compressed chunks aren't cached, the first
+  // save after a cached load recompresses every chunk.
+  op_status load_cached(std::filesystem::path path, std::filesystem::path cache_path, const std::atomic<bool>* cancel = nullptr);
+
+  // Same as load but the phases overlap: chunks are read in order and each
+  // one is decompressed by a task as soon as it is read, and a top-level
+  // node (child of root) is lifted as soon as the chunks covering its range
+  // are decoded. on_node is then called with it from that task, so calls
+  // can be concurrent and must not throw. root is assembled last, the tree
+  // is the same as the one of load.
+  // the load can still fail after nodes have been handed out.
+  // uncompressed (ps4) saves are loaded like by load, on_node is then called
+  // for each top-level node at the end.
+  op_status load_pipelined(std::filesystem::path path, const node_ready_fn& on_node, const std::atomic<bool>* cancel = nullptr);
+  op_status load_pipelined(std::span<const char> data, const node_ready_fn& on_node, const std::atomic<bool>* cancel = nullptr);
+
+  // Same as load but reads from a memory-mapped view of the file,
+  // chunks are decompressed straight from the mapped pages.
+  op_status open_mapped(std::filesystem::path path);
+
+  // Loads the node tree in its flat form (see flat_tree), root stays empty.
+  // Much cheaper than load when node_serializables aren't needed.
+  op_status load_flat(std::filesystem::path path, flat_tree& out);
+
+  // Random access mode: only the version and the descriptors are read
+  // (original_descs), root stays null. Nodes are then lifted one by one by
+  // read_partial_node, which only decompresses the chunks overlapping the
+  // node (see save_peek). The file stays open until close_partial or the
+  // next load.
+  op_status open_partial(std::filesystem::path path);
+
+  void close_partial()
+  {
+    m_partial.reset();
+  }
+
+  bool is_partial() const
+  {
+    return m_partial != nullptr;
+  }
+
+  // lifts a node (and its subtree) from the file opened by open_partial,
+  // nullptr if there is none or if it couldn't be read.
+  // not thread-safe, every call lifts a new copy of the node.
+  shared_node_type read_partial_node(std::string_view name) const;
+  shared_node_type read_partial_node(uint32_t desc_idx) const;
+
+  // number of decompressed chunks kept by random access reads
+  size_t chunk_cache_size() const
+  {
+    return m_chunk_cache_size;
+  }
+
+  void set_chunk_cache_size(size_t cnt)
+  {
+    m_chunk_cache_size = cnt;
+    if (m_partial)
+      m_partial->set_chunk_cache_size(cnt);
+  }
 
   // This one makes a backup!
   op_status save(std::filesystem::path path);
 
+  // writes the save into ar, which is cleared first (it keeps its memory,
+  // one stream can be reused across saves)
+  op_status save(memory_ostream& ar);
+
   friend streambase& operator<<(streambase& ar, node_tree& x)
   {
     if (ar.is_reader())
@@ -42,15 +237,107 @@ struct node_tree
     return ar;
   }
 
+  // Name lookup, nodes are returned in depth-first order.
+  // The index is built at the end of serialize_in and rebuilt lazily
+  // after any edit of the tree (or if root has been replaced).
+  std::vector<shared_node_type> find_nodes(std::string_view name) const;
+
+  // returns the first node in depth-first order
+  shared_node_type find_node(std::string_view name) const;
+
+  // incremented by every edit of the tree once loaded, e.g. to invalidate
+  // caches built from the node datas (root replacement isn't counted)
+  uint64_t edits_count() const
+  {
+    return m_edits_cnt;
+  }
+
   std::vector<serial_node_desc> original_descs;
   shared_node_type root;
 
 protected:
 
-  void serialize_in(streambase& ar);
+  // reads header, descriptors and decompresses chunks.
+  // tree_src is set to the buffer the tree must be lifted from.
+  // cancel is polled between phases and chunks, a cancelled read fails with
+  // an error on ar.
+  // when src_mapping is set, uncompressed (ps4) chunks of a file_istream are
+  // viewed from a mapping of its file instead of being read into nodedata,
+  // tree_src is then valid as long as src_mapping is open.
+  bool read_serial_tree(streambase& ar, serial_tree& stree, uint32_t& chunks_start, std::span<const char>& tree_src,
+    const std::atomic<bool>* cancel = nullptr, os::file_mapping* src_mapping = nullptr);
+
+  // phases of read_serial_tree: header, descriptors and chunk descriptors,
+  // then the chunks themselves
+  struct chunks_layout;
+  bool read_layout(streambase& ar, serial_tree& stree, chunks_layout& layout);
+  bool read_chunks(streambase& ar, serial_tree& stree, const chunks_layout& layout, std::span<const char>& tree_src,
+    const std::atomic<bool>* cancel, os::file_mapping* src_mapping);
+  // fills m_original_chunks (incremental save)
+  void keep_chunks(const chunks_layout& layout, const char* cdata, std::span<const char> nodedata);
+
+  void serialize_in(streambase& ar, const std::atomic<bool>* cancel = nullptr);
+  // blobs view the decompressed image of stree unless the payloads are
+  // interned, returns the span to lift from
+  std::span<const char> lift_source(serial_tree& stree, std::span<const char> tree_src);
+  // key of a decoded sidecar (see load_cached)
+  struct decoded_cache_key
+  {
+    uint64_t size = 0;
+    uint64_t time = 0;
+    uint64_t hash = 0;
+  };
+  // loads the tree from the sidecar if it is valid for key, key.hash is
+  // only needed (and computed by hash_save) if the write times differ.
+  bool load_decoded_cache(const std::filesystem::path& cache_path, decoded_cache_key& key,
+    const std::function<bool(decoded_cache_key&)>& hash_save, const std::atomic<bool>* cancel);
+  bool save_decoded_cache(const std::filesystem::path& cache_path, const decoded_cache_key& key, const serial_tree& stree,
+    uint32_t chunks_start, std::span<const char> tree_src) const;
+  void serialize_in_pipelined(streambase& ar, const node_ready_fn& on_node, const std::atomic<bool>* cancel);
+  // lifts root from tree_src then finish_load
+  void lift_tree(streambase& ar, serial_tree& stree, uint32_t chunks_start, std::span<const char> tree_src,
+    const std::atomic<bool>* cancel);
+  // checks the lifted root against the descriptors and builds the index
+  void finish_load(streambase& ar, serial_tree& stree, uint32_t chunks_start, std::span<const char> tree_src);
   void serialize_out(streambase& ar);
 
+  void on_node_event(const std::shared_ptr<const node_t>& node, node_event_e evt) override
+  {
+    m_index_dirty = true;
+    m_modified = true;
+    ++m_edits_cnt;
+  }
+
+  void rebuild_index() const;
+  void unbind_index() const;
+
   version m_ver;
+  size_t m_workers_cnt = 0;
+  bool m_parallel_compression = false;
+  save_profile m_save_profile = save_profile::balanced;
+  int m_lz4_acceleration = 8;
+
+  mutable std::unordered_map<std::string_view, std::vector<std::weak_ptr<const node_t>>> m_name_index;
+  mutable std::weak_ptr<const node_t> m_indexed_root;
+  mutable bool m_index_dirty = true;
+
+  struct original_chunk
+  {
+    uint32_t rel_data_offset; // relative to first chunk's data, as of the last load or save
+    uint32_t data_size;
+    uint64_t data_hash;       // crc64 of uncompressed data
+    std::vector<char> cdata;  // with 'XLZ4' header
+  };
+
+  std::unique_ptr<save_peek> m_partial;
+  size_t m_chunk_cache_size = 4;
+
+  bool m_incremental_save = false;
+  bool m_shared_payloads = false;
+  std::vector<original_chunk> m_original_chunks;
+  std::weak_ptr<const node_t> m_loaded_root;
+  bool m_modified = false;
+  uint64_t m_edits_cnt = 0;
 };
 
 } // namespace cp::csav
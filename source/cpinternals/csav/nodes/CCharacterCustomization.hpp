@@ -1,63 +1,189 @@
 #pragma once
 #include <iostream>
-#include <list>
 #include <exception>
 
 #include "cpinternals/common.hpp"
+#include "cpinternals/common/hash_index.hpp"
+#include "cpinternals/common/stable_vector.hpp"
 #include "cpinternals/ctypes.hpp"
 #include "cpinternals/csav/node.hpp"
 #include "cpinternals/csav/serializers.hpp"
 
 namespace cp::csav {
 
+// strings of the appearance records, interned: the same names and values
+// repeat in most records. records store indices, 0 is the empty string.
+// there is no erase, edits intern the new value (other records referencing
+// the old one keep it).
+struct cetr_string_table
+{
+  cetr_string_table()
+  {
+    clear();
+  }
+
+  void clear()
+  {
+    m_strings.clear();
+    m_index.clear();
+    intern({});
+  }
+
+  void reserve(size_t cnt)
+  {
+    m_strings.reserve(cnt);
+    m_index.reserve(cnt);
+  }
+
+  size_t size() const
+  {
+    return m_strings.size();
+  }
+
+  uint32_t intern(std::string_view s)
+  {
+    const uint64_t hash = cp::fnv1a64(s);
+    if (auto idx = m_index.find(hash); idx.has_value() && m_strings[*idx] == s)
+      return *idx;
+
+    // a hash collision leaves the new string unindexed
+    const uint32_t idx = (uint32_t)m_strings.size();
+    m_strings.emplace_back(s);
+    m_index.emplace(hash, idx);
+    return idx;
+  }
+
+  const std::string& at(uint32_t idx) const
+  {
+    return m_strings.at(idx);
+  }
+
+protected:
+  std::vector<std::string> m_strings;
+  cp::hash_index m_index; // fnv1a64 -> idx
+};
+
+// reads the appearance records, strings go to the table
+struct cetr_reader
+{
+  cetr_reader(node_span_reader& reader, cetr_string_table& strings)
+    : reader(reader), strings(strings) {}
+
+  const cp::csav::version& version() const
+  {
+    return reader.version();
+  }
+
+  bool failed() const
+  {
+    return reader.failed();
+  }
+
+  bool read_str(uint32_t& idx)
+  {
+    std::string_view sv;
+    if (!read_str_view(sv))
+      return false;
+    idx = strings.intern(sv);
+    return true;
+  }
+
+  // valid until the next read
+  bool read_str_view(std::string_view& sv)
+  {
+    return reader.read_plstring(sv, m_buf);
+  }
+
+  // records are at least min_size bytes, a count that can't fit in the
+  // remaining bytes fails the read instead of reserving for it
+  bool read_cnt(uint32_t& cnt, size_t min_size)
+  {
+    cnt = 0;
+    return reader.read_pod(cnt)
+      && size_t(cnt) * min_size <= reader.remaining();
+  }
+
+  node_span_reader& reader;
+  cetr_string_table& strings;
+
+protected:
+  std::string m_buf;
+};
+
+struct cetr_writer
+{
+  cetr_writer(node_span_writer& writer, const cetr_string_table& strings)
+    : writer(writer), strings(strings) {}
+
+  const cp::csav::version& version() const
+  {
+    return writer.version();
+  }
+
+  void write_str(uint32_t idx)
+  {
+    writer.write_plstring(strings.at(idx));
+  }
+
+  node_span_writer& writer;
+  const cetr_string_table& strings;
+};
+
+// string fields are indices in CCharacterCustomization::strings
+
 struct cetr_uk_thing5
 {
-  std::string uk0;
-  std::string uk1;
-  std::string uk2;
+  uint32_t uk0 = 0;
+  uint32_t uk1 = 0;
+  uint32_t uk2 = 0;
+
+  // 3 empty strings
+  static constexpr size_t min_serial_size = 3;
 
-  friend node_reader& operator>>(node_reader& reader, cetr_uk_thing5& x)
+  template <typename Traits>
+  bool read(cetr_reader& r)
   {
-    reader >> cp_plstring_ref(x.uk0);
-    reader >> cp_plstring_ref(x.uk1);
-    reader >> cp_plstring_ref(x.uk2);
-    return reader;
+    return r.read_str(uk0)
+      && r.read_str(uk1)
+      && r.read_str(uk2);
   }
 
-  friend node_writer& operator<<(node_writer& writer, const cetr_uk_thing5& x)
+  template <typename Traits>
+  void write(cetr_writer& w) const
   {
-    writer << cp_plstring_ref(x.uk0);
-    writer << cp_plstring_ref(x.uk1);
-    writer << cp_plstring_ref(x.uk2);
-    return writer;
+    w.write_str(uk0);
+    w.write_str(uk1);
+    w.write_str(uk2);
   }
 };
 
 struct cetr_uk_thing4
 {
-  std::string uk0;
-  std::string uk1;
+  uint32_t uk0 = 0;
+  uint32_t uk1 = 0;
   uint32_t uk2 = 0;
   uint32_t uk3 = 0;
 
-  friend node_reader& operator>>(node_reader& reader, cetr_uk_thing4& x)
+  static constexpr size_t min_serial_size = 2 + 8;
+
+  template <typename Traits>
+  bool read(cetr_reader& r)
   {
-    reader >> cp_plstring_ref(x.uk0);
-    reader >> cp_plstring_ref(x.uk1);
-    // if (vmajor >= 168)
-    reader >> cbytes_ref(x.uk2);
-    reader >> cbytes_ref(x.uk3);
-    return reader;
+    return r.read_str(uk0)
+      && r.read_str(uk1)
+      // if (vmajor >= 168)
+      && r.reader.read_pod(uk2)
+      && r.reader.read_pod(uk3);
   }
 
-  friend node_writer& operator<<(node_writer& writer, const cetr_uk_thing4& x)
+  template <typename Traits>
+  void write(cetr_writer& w) const
   {
-    writer << cp_plstring_ref(x.uk0);
-    writer << cp_plstring_ref(x.uk1);
+    w.write_str(uk0);
+    w.write_str(uk1);
     // if (vmajor >= 168)
-    writer << cbytes_ref(x.uk2);
-    writer << cbytes_ref(x.uk3);
-    return writer;
+    w.writer.write_pod(uk2);
+    w.writer.write_pod(uk3);
   }
 };
 
@@ -65,125 +191,132 @@ struct cetr_uk_thing4
 struct cetr_uk_thing3
 {
   CName cn = {};
-  std::string uk0;
-  std::string uk1;
+  uint32_t uk0 = 0;
+  uint32_t uk1 = 0;
   uint32_t uk2 = 0;
   uint32_t uk3 = 0;
 
-  friend node_reader& operator>>(node_reader& reader, cetr_uk_thing3& x)
+  static constexpr size_t min_serial_size = 1 + 2 + 8;
+
+  template <typename Traits>
+  bool read(cetr_reader& r)
   {
-    if (reader.version().v3 < 195)
+    if constexpr (!Traits::hashed_cetr_names)
     {
-      std::string s;
-      reader >> cp_plstring_ref(s);
-      x.cn = CName(s);
+      std::string_view name;
+      if (!r.read_str_view(name))
+        return false;
+      cn = CName(name);
     }
-    else
+    else if (!r.reader.read_pod(cn.hash))
     {
-      reader >> cbytes_ref(x.cn.hash);
+      return false;
     }
-    reader >> cp_plstring_ref(x.uk0);
-    // if (v1 >= 168)
-    reader >> cp_plstring_ref(x.uk1);
-    reader >> cbytes_ref(x.uk2);
-    reader >> cbytes_ref(x.uk3);
-    return reader;
+
+    return r.read_str(uk0)
+      // if (v1 >= 168)
+      && r.read_str(uk1)
+      && r.reader.read_pod(uk2)
+      && r.reader.read_pod(uk3);
   }
 
-  friend node_writer& operator<<(node_writer& writer, const cetr_uk_thing3& x)
+  // false if the name of cn is needed but unknown
+  template <typename Traits>
+  bool write(cetr_writer& w) const
   {
-    if (writer.version().v3 < 195)
+    if constexpr (!Traits::hashed_cetr_names)
     {
       const auto& resolver = CName_resolver::get();
-      if (!resolver.is_registered(x.cn))
-      {
-        writer.setstate(std::ios::badbit);
-        return writer;
-      }
-      auto cns = x.cn.string();
-      writer << cp_plstring_ref(cns);
+      if (!resolver.is_registered(cn))
+        return false;
+      w.writer.write_plstring(cn.gstr().strv());
     }
     else
     {
-      writer << cbytes_ref(x.cn.hash);
+      w.writer.write_pod(cn.hash);
     }
-    writer << cp_plstring_ref(x.uk0);
+    w.write_str(uk0);
     // if (v1 >= 168)
-    writer << cp_plstring_ref(x.uk1);
-    writer << cbytes_ref(x.uk2);
-    writer << cbytes_ref(x.uk3);
-    return writer;
+    w.write_str(uk1);
+    w.writer.write_pod(uk2);
+    w.writer.write_pod(uk3);
+    return true;
   }
 };
 
+template <typename Traits, typename T>
+bool read_cetr_array(cetr_reader& r, cp::stable_vector<T>& out)
+{
+  out.clear();
+
+  uint32_t cnt = 0;
+  if (!r.read_cnt(cnt, T::min_serial_size))
+    return false;
+
+  out.reserve(cnt);
+  for (uint32_t i = 0; i < cnt; ++i)
+  {
+    if (!out.emplace_back().template read<Traits>(r))
+      return false;
+  }
+  return true;
+}
+
 struct cetr_uk_thing2
 {
-  std::string uks;
-  std::list<cetr_uk_thing3> vuk3;
-  std::list<cetr_uk_thing4> vuk4;
+  uint32_t uks = 0;
+  cp::stable_vector<cetr_uk_thing3> vuk3;
+  cp::stable_vector<cetr_uk_thing4> vuk4;
+
+  static constexpr size_t min_serial_size = 1 + 4 + 4;
 
-  friend node_reader& operator>>(node_reader& reader, cetr_uk_thing2& x)
+  template <typename Traits>
+  bool read(cetr_reader& r)
   {
-    reader >> cp_plstring_ref(x.uks);
-    // if (v1 < 168) { .. }
-    {
-      uint32_t cnt = 0;
-      reader >> cbytes_ref(cnt);
-      x.vuk3.resize(cnt);
-      for (auto& y : x.vuk3)
-        reader >> y;
-    }
-    {
-      uint32_t cnt = 0;
-      reader >> cbytes_ref(cnt);
-      x.vuk4.resize(cnt);
-      for (auto& y : x.vuk4)
-        reader >> y;
-    }
-    return reader;
+    return r.read_str(uks)
+      // if (v1 < 168) { .. }
+      && read_cetr_array<Traits>(r, vuk3)
+      && read_cetr_array<Traits>(r, vuk4);
   }
 
-  friend node_writer& operator<<(node_writer& writer, const cetr_uk_thing2& x)
+  template <typename Traits>
+  bool write(cetr_writer& w) const
   {
-    writer << cp_plstring_ref(x.uks);
+    w.write_str(uks);
     // if (v1 < 168) { .. }
+    w.writer.write_pod((uint32_t)vuk3.size());
+    for (auto& y : vuk3)
     {
-      uint32_t cnt = (uint32_t)x.vuk3.size();
-      writer << cbytes_ref(cnt);
-      for (auto& y : x.vuk3)
-        writer << y;
+      if (!y.template write<Traits>(w))
+        return false;
     }
-    {
-      uint32_t cnt = (uint32_t)x.vuk4.size();
-      writer << cbytes_ref(cnt);
-      for (auto& y : x.vuk4)
-        writer << y;
-    }
-    return writer;
+    w.writer.write_pod((uint32_t)vuk4.size());
+    for (auto& y : vuk4)
+      y.template write<Traits>(w);
+    return true;
   }
 };
 
 struct cetr_uk_thing1
 {
-  std::list<cetr_uk_thing2> vuk2;
+  cp::stable_vector<cetr_uk_thing2> vuk2;
 
-  friend node_reader& operator>>(node_reader& reader, cetr_uk_thing1& x)
+  template <typename Traits>
+  bool read(cetr_reader& r)
   {
-    uint32_t cnt = 0;
-    reader >> cbytes_ref(cnt);
-    x.vuk2.resize(cnt);
-    for (auto& y : x.vuk2)
-      reader >> y;
-    return reader;
+    return read_cetr_array<Traits>(r, vuk2);
   }
 
-  friend node_writer& operator<<(node_writer& writer, const cetr_uk_thing1& x)
+  template <typename Traits>
+  bool write(cetr_writer& w) const
   {
-    uint32_t cnt = (uint32_t)x.vuk2.size();
-    writer << cbytes_ref(cnt);
-    for (auto& y : x.vuk2)
-      writer << y;
-    return writer;
+    w.writer.write_pod((uint32_t)vuk2.size());
+    for (auto& y : vuk2)
+    {
+      if (!y.template write<Traits>(w))
+        return false;
+    }
+    return true;
   }
 };
 
@@ -202,9 +335,12 @@ struct CCharacterCustomization
   cetr_uk_thing1 ukt1;
   cetr_uk_thing1 ukt2;
 
-  std::list<cetr_uk_thing5> ukt5;
+  cp::stable_vector<cetr_uk_thing5> ukt5;
+
+  cp::stable_vector<uint32_t> uk6s;
 
-  std::list<std::string> uk6s;
+  // strings of all the records above
+  cetr_string_table strings;
 
   std::string node_name() const override { return "CharacetrCustomization_Appearances"; }
 
@@ -213,85 +349,104 @@ struct CCharacterCustomization
     if (!node)
       return false;
 
-    node_reader reader(node, version);
+    node_span_reader reader(node, version);
+
+    // the whole blob is strings for the most part, the table is sized
+    // for an average of ~16 bytes per string
+    strings.clear();
+    strings.reserve(reader.remaining() / 16);
+    cetr_reader r(reader, strings);
+
+    data_exists = 0;
+    uk6s.clear();
+    ukt5.clear();
+    for (auto* ukt : {&ukt0, &ukt1, &ukt2})
+      ukt->vuk2.clear();
+
+    return dispatch_version(version, [&](auto traits) {
+      return read_data<decltype(traits)>(r);
+    });
+  }
+
+  std::shared_ptr<const node_t> to_node_impl(const version& version) const override
+  {
+    node_span_writer writer(version);
+    cetr_writer w(writer, strings);
+
+    const bool ok = dispatch_version(version, [&](auto traits) {
+      return write_data<decltype(traits)>(w);
+    });
+    if (!ok)
+      return nullptr;
+
+    return writer.finalize(node_name());
+  }
+
+protected:
+  template <typename Traits>
+  bool read_data(cetr_reader& r)
+  {
+    auto& reader = r.reader;
+
+    reader.read_pod(data_exists);
+    reader.read_pod(uk0);
 
-    try
+    if (data_exists)
     {
-      data_exists = false;
-      reader >> cbytes_ref(data_exists);
+      reader.read_pod(uk1);
+      reader.read_pod(uk2);
+      reader.read_pod(uk3);
+
+      if (!ukt0.read<Traits>(r) || !ukt1.read<Traits>(r) || !ukt2.read<Traits>(r) || !read_cetr_array<Traits>(r, ukt5))
+        return false;
 
-      reader >> cbytes_ref(uk0);
+      int64_t uk6cnt = 0;
+      if constexpr (Traits::appearance_uk6s)
+        reader.read_packed_int(uk6cnt);
+      if (uk6cnt < 0 || size_t(uk6cnt) > reader.remaining())
+        return false;
 
-      if (data_exists)
+      uk6s.reserve(size_t(uk6cnt));
+      for (int64_t i = 0; i < uk6cnt; ++i)
       {
-        reader >> cbytes_ref(uk1);
-        reader >> cbytes_ref(uk2);
-        reader >> cbytes_ref(uk3);
-        reader >> ukt0;
-        reader >> ukt1;
-        reader >> ukt2;
-
-        uint32_t cnt = 0;
-        reader >> cbytes_ref(cnt);
-        ukt5.resize(cnt);
-        for (auto& y : ukt5)
-          reader >> y;
-
-        int64_t uk6cnt = 0;
-        if (version.v1 > 171)
-          reader >> cp_packedint_ref(uk6cnt);
-        uk6s.resize(uk6cnt);
-        for (auto& y : uk6s)
-          reader >> cp_plstring_ref(y);
+        if (!r.read_str(uk6s.emplace_back()))
+          return false;
       }
     }
-    catch (std::ios::failure&)
-    {
-      return false;
-    }
 
     return reader.at_end();
   }
 
-  std::shared_ptr<const node_t> to_node_impl(const version& version) const override
+  template <typename Traits>
+  bool write_data(cetr_writer& w) const
   {
-    node_writer writer(version);
+    auto& writer = w.writer;
+
+    writer.write_pod(data_exists);
+    writer.write_pod(uk0);
 
-    try
+    if (data_exists)
     {
-      writer << cbytes_ref(data_exists);
+      writer.write_pod(uk1);
+      writer.write_pod(uk2);
+      writer.write_pod(uk3);
 
-      writer << cbytes_ref(uk0);
+      if (!ukt0.write<Traits>(w) || !ukt1.write<Traits>(w) || !ukt2.write<Traits>(w))
+        return false;
 
-      if (data_exists)
+      writer.write_pod((uint32_t)ukt5.size());
+      for (auto& y : ukt5)
+        y.write<Traits>(w);
+
+      if constexpr (Traits::appearance_uk6s)
       {
-        writer << cbytes_ref(uk1);
-        writer << cbytes_ref(uk2);
-        writer << cbytes_ref(uk3);
-        writer << ukt0;
-        writer << ukt1;
-        writer << ukt2;
-
-        uint32_t cnt = (uint32_t)ukt5.size();
-        writer << cbytes_ref(cnt);
-        for (auto& y : ukt5)
-          writer << y;
-
-        if (version.v1 > 171)
-        {
-          int64_t uk6cnt = uk6s.size();
-          writer << cp_packedint_ref(uk6cnt);
-          for (auto& y : uk6s)
-            writer << cp_plstring_ref(y);
-        }
+        writer.write_packed_int((int64_t)uk6s.size());
+        for (auto idx : uk6s)
+          w.write_str(idx);
       }
     }
-    catch (std::ios::failure&)
-    {
-      return nullptr;
-    }
 
-    return writer.finalize(node_name());
+    return true;
   }
 };
 
@@ -24,6 +24,11 @@ public:
 
   std::string node_name() const override { return m_node_name; }
 
+  void accumulate_memory_usage(cp::memory_usage& mu) const override
+  {
+    m_sys.accumulate_memory_usage(mu);
+  }
+
   bool from_node_impl(const std::shared_ptr<const node_t>& node, const version& version) override
   {
     if (!node)
@@ -32,7 +37,8 @@ public:
     m_raw = node;
     m_node_name = node->name();
 
-    node_reader reader(node, version);
+    // the system blob is parsed in place
+    node_span_reader reader(node, version);
 
     if (!m_sys.serialize_in(reader))
       return false;
@@ -43,6 +49,7 @@ public:
   std::shared_ptr<const node_t> to_node_impl(const version& version) const override
   {
     node_writer writer(version);
+    writer.reserve(m_sys.serialized_size_hint());
 
     if (!m_sys.serialize_out(writer))
       return nullptr;
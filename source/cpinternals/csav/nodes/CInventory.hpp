@@ -1,8 +1,10 @@
 #pragma once
 #include <iostream>
-#include <list>
+#include <algorithm>
+#include <tuple>
 
 #include "cpinternals/common.hpp"
+#include "cpinternals/common/stable_vector.hpp"
 #include "cpinternals/ctypes.hpp"
 #include "cpinternals/csav/node.hpp"
 #include "cpinternals/csav/serializers.hpp"
@@ -13,21 +15,136 @@ namespace cp::csav {
 struct sub_inventory_t
 {
   uint64_t uid = 0;
-  std::list<CItemData> items;
+  stable_vector<CItemData> items;
 };
 
 struct CInventory
   : public node_serializable
 {
-  std::list<sub_inventory_t> m_subinvs;
+  stable_vector<sub_inventory_t> m_subinvs;
+
+  // position of an item, valid until the next edit of the inventory
+  struct item_pos
+  {
+    uint32_t subinv_idx;
+    uint32_t item_idx;
+  };
 
   std::string node_name() const override { return "inventory"; }
 
+  // Item index
+  // items are indexed by TweakDBID and by item id (TweakDBID, seed, unique
+  // counter and flags, see uk_thing). the index is built by from_node_impl
+  // and rebuilt on the next lookup after invalidate_index(), that editors must
+  // call after editing m_subinvs directly (the bulk operations below keep it
+  // up to date).
+
+  void invalidate_index()
+  {
+    m_index_dirty = true;
+  }
+
+  // positions of the items with that TweakDBID, in inventory order
+  std::vector<item_pos> find_items(TweakDBID id) const
+  {
+    rebuild_index();
+
+    std::vector<item_pos> ret;
+    auto range = std::equal_range(m_tdbid_index.begin(), m_tdbid_index.end(), std::make_pair(id.as_u64, item_pos{}),
+      [](const auto& a, const auto& b) { return a.first < b.first; });
+    for (auto it = range.first; it != range.second; ++it)
+      ret.push_back(it->second);
+    return ret;
+  }
+
+  // first item with that item id, nullptr if there is none
+  CItemData* find_item(const CItemID& iid)
+  {
+    rebuild_index();
+
+    const auto key = std::make_pair(iid_key(iid), item_pos{});
+    auto it = std::lower_bound(m_iid_index.begin(), m_iid_index.end(), key,
+      [](const auto& a, const auto& b) { return a.first < b.first; });
+    if (it == m_iid_index.end() || it->first != key.first)
+      return nullptr;
+    return &item_at(it->second);
+  }
+
+  CItemData& item_at(const item_pos& pos)
+  {
+    return m_subinvs[pos.subinv_idx].items[pos.item_idx];
+  }
+
+  const CItemData& item_at(const item_pos& pos) const
+  {
+    return m_subinvs[pos.subinv_idx].items[pos.item_idx];
+  }
+
+  size_t count_items(TweakDBID id) const
+  {
+    rebuild_index();
+
+    auto range = std::equal_range(m_tdbid_index.begin(), m_tdbid_index.end(), std::make_pair(id.as_u64, item_pos{}),
+      [](const auto& a, const auto& b) { return a.first < b.first; });
+    return (size_t)(range.second - range.first);
+  }
+
+  // calls fn(CItemData&) on every item with that TweakDBID, returns their count
+  template <typename Fn>
+  size_t for_each_item(TweakDBID id, Fn&& fn)
+  {
+    const auto positions = find_items(id);
+    for (const auto& pos : positions)
+      fn(item_at(pos));
+    return positions.size();
+  }
+
+  // removes every item with that TweakDBID, returns their count.
+  // one pass per sub-inventory containing some.
+  size_t remove_items(TweakDBID id)
+  {
+    const auto positions = find_items(id);
+    if (positions.empty())
+      return 0;
+
+    size_t removed_cnt = 0;
+    uint32_t last_subinv_idx = (uint32_t)-1;
+    for (const auto& pos : positions)
+    {
+      // positions are sorted
+      if (pos.subinv_idx == last_subinv_idx)
+        continue;
+      last_subinv_idx = pos.subinv_idx;
+
+      removed_cnt += m_subinvs[pos.subinv_idx].items.erase_if(
+        [&id](const CItemData& item) { return item.iid.nameid.as_u64 == id.as_u64; });
+    }
+
+    m_index_dirty = true;
+    return removed_cnt;
+  }
+
+  // sets the quantity of every item with that TweakDBID, returns their count.
+  // items of kind 2 have no quantity, they are skipped.
+  size_t set_items_quantity(TweakDBID id, uint32_t quantity)
+  {
+    size_t cnt = 0;
+    for_each_item(id, [&](CItemData& item) {
+      if (item.iid.uk.kind() == 2)
+        return;
+      item.quantity = quantity;
+      ++cnt;
+    });
+    return cnt;
+  }
+
   bool from_node_impl(const std::shared_ptr<const node_t>& node, const version& version) override
   {
     if (!node)
       return false;
 
+    m_index_dirty = true;
+
     node_reader reader(node, version);
 
     try
@@ -70,6 +187,8 @@ struct CInventory
     }
 
 
+    rebuild_index();
+
     return reader.at_end();
   }
 
@@ -100,6 +219,47 @@ struct CInventory
 
     return writer.finalize(node_name());
   }
+
+protected:
+  using iid_key_t = std::tuple<uint64_t, uint32_t, uint16_t, uint8_t>;
+
+  static iid_key_t iid_key(const CItemID& iid)
+  {
+    return { iid.nameid.as_u64, iid.uk.uk4, iid.uk.uk2, iid.uk.uk1 };
+  }
+
+  // sorted vectors of (key, position), positions in inventory order for
+  // equal keys
+  void rebuild_index() const
+  {
+    if (!m_index_dirty)
+      return;
+
+    m_tdbid_index.clear();
+    m_iid_index.clear();
+
+    for (uint32_t i = 0; i < (uint32_t)m_subinvs.size(); ++i)
+    {
+      const auto& items = m_subinvs[i].items;
+      for (uint32_t j = 0; j < (uint32_t)items.size(); ++j)
+      {
+        const item_pos pos{i, j};
+        m_tdbid_index.emplace_back(items[j].iid.nameid.as_u64, pos);
+        m_iid_index.emplace_back(iid_key(items[j].iid), pos);
+      }
+    }
+
+    std::stable_sort(m_tdbid_index.begin(), m_tdbid_index.end(),
+      [](const auto& a, const auto& b) { return a.first < b.first; });
+    std::stable_sort(m_iid_index.begin(), m_iid_index.end(),
+      [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    m_index_dirty = false;
+  }
+
+  mutable std::vector<std::pair<uint64_t, item_pos>> m_tdbid_index;
+  mutable std::vector<std::pair<iid_key_t, item_pos>> m_iid_index;
+  mutable bool m_index_dirty = true;
 };
 
 } // namespace cp::csav
@@ -3,6 +3,7 @@
 #include <iostream>
 
 #include "cpinternals/common.hpp"
+#include "cpinternals/common/stable_vector.hpp"
 #include "cpinternals/ctypes.hpp"
 #include "cpinternals/csav/node.hpp"
 #include "cpinternals/csav/serializers.hpp"
@@ -122,7 +123,7 @@ struct CItemMod // for CItemData kind 0, 2
   CItemID iid;
   char cn0[256];
   TweakDBID tdbid1;
-  std::list<CItemMod> subs;
+  stable_vector<CItemMod> subs;
   uint32_t uk2 = 0;
 
   CUk0ID uk3;
@@ -133,11 +134,14 @@ struct CItemMod // for CItemData kind 0, 2
     std::fill(cn0, cn0 + sizeof(cn0), 0);
   }
 
+  // Traits: see dispatch_version
+  template <typename Traits>
   bool serialize_in(std::istream& reader, const version& ver)
   {
     reader >> iid;
 
-    std::string s;
+    // item names fit inline
+    small_string<64> s;
     reader >> cp_plstring_ref(s);
     strcpy_s(cn0, s.c_str());
     reader >> cbytes_ref(tdbid1.as_u64);
@@ -146,32 +150,33 @@ struct CItemMod // for CItemData kind 0, 2
     reader >> cp_packedint_ref((int64_t&)cnt);
     subs.resize(cnt);
     for (auto& sub : subs)
-      sub.serialize_in(reader, ver);
+      sub.serialize_in<Traits>(reader, ver);
 
     reader >> cbytes_ref(uk2);
 
-    if (ver.v1 >= 192)
+    if constexpr (Traits::item_mod_uk3)
       uk3.serialize_in(reader, ver);
-    
+
     return true;
   }
 
+  template <typename Traits>
   bool serialize_out(std::ostream& writer, const version& ver) const
   {
     writer << iid;
 
-    std::string s = cn0;
+    small_string<64> s = cn0;
     writer << cp_plstring_ref(s);
     writer << cbytes_ref(tdbid1.as_u64);
 
     const size_t cnt = subs.size();
     writer << cp_packedint_ref((int64_t&)cnt);
     for (auto& sub : subs)
-      sub.serialize_out(writer, ver);
+      sub.serialize_out<Traits>(writer, ver);
 
     writer << cbytes_ref(uk2);
 
-    if (ver.v1 >= 192)
+    if constexpr (Traits::item_mod_uk3)
       uk3.serialize_out(writer, ver);
 
     return true;
@@ -222,8 +227,11 @@ struct CItemData
       // uk0id
       if (!uk3.serialize_in(reader, version))
         return false;
-      // recursive
-      if (!root2.serialize_in(reader, version))
+      // recursive, the version is tested once for all mods
+      const bool ok = dispatch_version(version, [&](auto traits) {
+        return root2.serialize_in<decltype(traits)>(reader, version);
+      });
+      if (!ok)
         return false;
     }
 
@@ -245,7 +253,9 @@ struct CItemData
     if (kind != 1)
     {
       uk3.serialize_out(writer, version);
-      root2.serialize_out(writer, version);
+      dispatch_version(version, [&](auto traits) {
+        return root2.serialize_out<decltype(traits)>(writer, version);
+      });
     }
 
     return writer.finalize(node_name());
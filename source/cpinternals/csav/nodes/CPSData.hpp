@@ -2,6 +2,7 @@
 #include <inttypes.h>
 
 #include "cpinternals/common.hpp"
+#include "cpinternals/common/parallel.hpp"
 #include "cpinternals/ctypes.hpp"
 #include "cpinternals/csav/node.hpp"
 #include "cpinternals/csav/serializers.hpp"
@@ -18,6 +19,10 @@ struct CPSData
   std::vector<CName> trailing_names;
   std::set<std::string> m_obj_ctypenames;
 
+  // indices in m_sys.objects() by ctypename (gname idx), in object order.
+  // rebuilt after load and after edits of the object list, see build_index.
+  std::unordered_map<uint32_t, std::vector<uint32_t>> m_objs_by_ctypename;
+
   CObjectSPtr m_vehicleGarageComponentPS;
 
   std::vector<std::string> m_vehicle_names;
@@ -50,15 +55,75 @@ public:
         auto record = obj->get_prop_cast<CTweakDBIDProperty>("spawnRecordID"_gn);
         if (!record)
           return false;
-        record->m_id = tdbid;
+        record->set_id(tdbid);
       }
 
       return true;
   }
 
 
+  // indices of the objects of class ctypename, nullptr if there is none
+  const std::vector<uint32_t>* find_objects(gname ctypename) const
+  {
+    auto it = m_objs_by_ctypename.find(ctypename.idx());
+    return it != m_objs_by_ctypename.end() ? &it->second : nullptr;
+  }
+
+  // objects are bucketed by ctypename in chunks on the system's workers,
+  // chunks are merged in order so that the indices stay sorted
+  void build_index()
+  {
+    static constexpr size_t chunk_size = 0x1000;
+
+    m_objs_by_ctypename.clear();
+    m_obj_ctypenames.clear();
+    m_vehicleGarageComponentPS = nullptr;
+
+    const auto& objects = m_sys.objects();
+    const size_t chunks_cnt = (objects.size() + chunk_size - 1) / chunk_size;
+
+    std::vector<std::unordered_map<uint32_t, std::vector<uint32_t>>> chunks(chunks_cnt);
+    parallel_for(chunks_cnt, m_sys.workers_count(), [&](size_t i) {
+      const size_t end = std::min(objects.size(), (i + 1) * chunk_size);
+      for (size_t j = i * chunk_size; j < end; ++j)
+      {
+        chunks[i][objects[j]->ctypename().idx()].push_back(static_cast<uint32_t>(j));
+      }
+    });
+
+    for (auto& chunk : chunks)
+    {
+      for (auto& [ctypename_idx, obj_indices] : chunk)
+      {
+        auto& indices = m_objs_by_ctypename[ctypename_idx];
+        indices.insert(indices.end(), obj_indices.begin(), obj_indices.end());
+      }
+    }
+
+    for (const auto& [ctypename_idx, indices] : m_objs_by_ctypename)
+    {
+      m_obj_ctypenames.emplace(objects[indices.front()]->ctypename().strv());
+    }
+
+    if (auto vgcps = find_objects("vehicleGarageComponentPS"_gn))
+      m_vehicleGarageComponentPS = objects[vgcps->front()];
+  }
+
+
   std::string node_name() const override { return "PSData"; }
 
+  void accumulate_memory_usage(cp::memory_usage& mu) const override
+  {
+    m_sys.accumulate_memory_usage(mu);
+
+    // class index
+    mu.cache_bytes += cp::heap_bytes(m_obj_ctypenames) + cp::heap_bytes(m_objs_by_ctypename);
+    for (const auto& name : m_obj_ctypenames)
+      mu.cache_bytes += cp::heap_bytes(name);
+    for (const auto& [idx, objs] : m_objs_by_ctypename)
+      mu.cache_bytes += cp::heap_bytes(objs);
+  }
+
 
   bool from_node_impl(const std::shared_ptr<const node_t>& node, const version& version) override
   {
@@ -67,26 +132,21 @@ public:
 
     m_raw = node;
 
-    node_reader reader(node, version);
+    // the system blob is parsed in place
+    node_span_reader reader(node, version);
 
     // todo: catch exception at upper level to display error
     if (!m_sys.serialize_in(reader))
       return false;
 
     uint32_t cnt = 0;
-    reader >> cbytes_ref(cnt);
+    if (!reader.read_pod(cnt))
+      return false;
     trailing_names.resize(cnt);
-    reader.read((char*)trailing_names.data(), cnt * sizeof(CName));
-
-    gname vgcps("vehicleGarageComponentPS");
+    if (!reader.read(trailing_names.data(), cnt * sizeof(CName)))
+      return false;
 
-    for (auto& obj : m_sys.objects())
-    {
-      auto cn = obj->ctypename();
-      m_obj_ctypenames.insert(cn.c_str());
-      if (cn == vgcps)
-        m_vehicleGarageComponentPS = obj;
-    }
+    build_index();
 
     return reader.at_end();
   }
@@ -94,6 +154,7 @@ public:
   std::shared_ptr<const node_t> to_node_impl(const version& version) const override
   {
     node_writer writer(version);
+    writer.reserve(m_sys.serialized_size_hint() + trailing_names.size() * sizeof(CName) + 4);
 
     try
     {
@@ -1,15 +1,90 @@
 #pragma once
 #include <inttypes.h>
+#include <unordered_set>
 
 #include "cpinternals/common.hpp"
 #include "cpinternals/ctypes.hpp"
 #include "cpinternals/csav/node.hpp"
 #include "cpinternals/csav/serializers.hpp"
 #include "cpinternals/scripting/csystem.hpp"
+#include "cpinternals/scripting/csystem_raw.hpp"
 #include "cpinternals/scripting/cproperty.hpp"
 
 namespace cp::csav {
 
+// Typed view of the stats map: one entry per stat modifier, in contiguous
+// arrays, grouped by seed (in the order of the map's values).
+// It is a snapshot of the map: scripts edit its arrays then write them back
+// at once with CStats::apply_view.
+struct CStatsView
+{
+  std::vector<uint32_t> seeds;
+  std::vector<gname>    classes;        // e.g. gameConstantStatModifierData
+  std::vector<gname>    stat_types;     // statType value
+  std::vector<gname>    modifier_types; // modifierType value, empty if none
+  std::vector<float>    values;         // value field, 0 if none
+
+  // modifiers of a seed, [first, last) range in the arrays
+  std::unordered_map<uint32_t, std::pair<uint32_t, uint32_t>> ranges;
+
+  // CStats::view() generation this view has been copied from
+  uint64_t generation = 0;
+
+  size_t size() const { return seeds.size(); }
+
+  std::pair<uint32_t, uint32_t> find(uint32_t seed) const
+  {
+    auto it = ranges.find(seed);
+    return it == ranges.end() ? std::pair<uint32_t, uint32_t>(0, 0) : it->second;
+  }
+
+  void clear()
+  {
+    seeds.clear();
+    classes.clear();
+    stat_types.clear();
+    modifier_types.clear();
+    values.clear();
+    ranges.clear();
+  }
+};
+
+// Read-only columns of the stats map, decoded straight from the serialized
+// system in one pass (see CStats::extract_columns): no CObject is built, for
+// bulk analytics over many saves. Same entries and order as CStatsView.
+// Names are dictionary encoded, the name columns hold indices in names.
+struct CStatsColumns
+{
+  static constexpr uint16_t no_name = CSystemRaw::name_dict::none;
+
+  std::vector<uint32_t> seeds;
+  std::vector<uint32_t> objects;        // modifier object (its handle)
+  std::vector<uint16_t> classes;
+  std::vector<uint16_t> stat_types;
+  std::vector<uint16_t> modifier_types; // no_name if none
+  std::vector<float>    values;         // 0 if none
+
+  std::vector<gname> names;
+
+  size_t size() const { return seeds.size(); }
+
+  gname name(uint16_t idx) const
+  {
+    return idx < names.size() ? names[idx] : gname();
+  }
+
+  void clear()
+  {
+    seeds.clear();
+    objects.clear();
+    classes.clear();
+    stat_types.clear();
+    modifier_types.clear();
+    values.clear();
+    names.clear();
+  }
+};
+
 struct CStats
   : public node_serializable
   , public CObjectListener
@@ -20,6 +95,12 @@ struct CStats
   CObjectSPtr m_mapstruct = nullptr;
   std::unordered_map<uint32_t, CObjectSPtr> m_seed_to_stats_obj_map;
 
+  // built on first use after each change of the map
+  CStatsView m_view;
+  std::vector<CObject*> m_view_objs; // modifier object of each entry
+  uint64_t m_view_generation = 0;
+  bool m_view_dirty = true;
+
 public:
   CStats() = default;
 
@@ -42,6 +123,7 @@ public:
     // this isn't editor breaking, so we return true if it fails
 
     m_seed_to_stats_obj_map.clear();
+    m_view_dirty = true;
 
     if (m_sys.objects().empty())
       return false;
@@ -94,6 +176,215 @@ public:
     return modsarray;
   }
 
+  // the map is walked once per change, then lookups by seed are O(1)
+  const CStatsView& view()
+  {
+    if (!m_view_dirty)
+      return m_view;
+
+    m_view.clear();
+    m_view_objs.clear();
+    m_view.generation = ++m_view_generation;
+    m_view_dirty = false;
+
+    auto values = m_mapstruct ? m_mapstruct->get_prop_cast<CDynArrayProperty>("values"_gn) : nullptr;
+    if (!values)
+      return m_view;
+
+    for (auto& it : *values)
+    {
+      CObjectProperty* objprop = dynamic_cast<CObjectProperty*>(it.get());
+      if (!objprop || !objprop->obj())
+        continue;
+      auto obj = objprop->obj();
+
+      auto seedprop = dynamic_cast<CIntProperty*>(obj->get_prop("seed"_gn));
+      auto mods = obj->get_prop_cast<CDynArrayProperty>("statModifiers"_gn);
+      if (!seedprop || !mods)
+        continue;
+
+      const uint32_t seed = seedprop->u32();
+      // same seed twice, the map keeps the first one
+      if (m_view.ranges.find(seed) != m_view.ranges.end())
+        continue;
+
+      const uint32_t first = (uint32_t)m_view.size();
+      for (auto& mod : *mods)
+      {
+        auto handle = dynamic_cast<CHandleProperty*>(mod.get());
+        if (!handle || !handle->obj())
+          continue;
+        auto modobj = handle->obj();
+
+        auto stat_type = modobj->get_prop_cast<CEnumProperty>("statType"_gn);
+        auto modifier_type = modobj->get_prop_cast<CEnumProperty>("modifierType"_gn);
+        auto value = modobj->get_prop_cast<CFloatProperty>("value"_gn);
+
+        m_view.seeds.push_back(seed);
+        m_view.classes.push_back(modobj->ctypename());
+        m_view.stat_types.push_back(stat_type ? stat_type->value_name() : gname());
+        m_view.modifier_types.push_back(modifier_type ? modifier_type->value_name() : gname());
+        m_view.values.push_back(value ? value->value() : 0.f);
+        m_view_objs.push_back(modobj.get());
+      }
+
+      if (m_view.size() > first)
+        m_view.ranges.emplace(seed, std::make_pair(first, (uint32_t)m_view.size()));
+    }
+
+    return m_view;
+  }
+
+  // node is the StatsSystem node, it doesn't have to be loaded
+  static bool extract_columns(const std::shared_ptr<const node_t>& node, const version& version, CStatsColumns& cols)
+  {
+    cols.clear();
+    if (!node)
+      return false;
+
+    node_span_reader reader(node, version);
+
+    CSystemRaw raw;
+    if (!raw.parse(reader) || !reader.at_end())
+      return false;
+
+    return extract_columns(raw, cols);
+  }
+
+  static bool extract_columns(const CSystemRaw& raw, CStatsColumns& cols)
+  {
+    cols.clear();
+    if (raw.objects_count() == 0)
+      return true;
+
+    const uint32_t values_idx = raw.find_string("values");
+    const uint32_t seed_idx = raw.find_string("seed");
+    const uint32_t mods_idx = raw.find_string("statModifiers");
+    const uint32_t stat_type_idx = raw.find_string("statType");
+    const uint32_t modifier_type_idx = raw.find_string("modifierType");
+    const uint32_t value_idx = raw.find_string("value");
+
+    // no map values
+    CSystemRaw::field_t values;
+    if (values_idx == CSystemRaw::npos || !raw.find_field(raw.object_blob(0), values_idx, values))
+      return true;
+
+    CSystemRaw::name_dict dict(raw, cols.names);
+    std::unordered_set<uint32_t> seeds;
+    bool ok = true;
+
+    auto add_modifier = [&](uint32_t seed, std::span<const char> handle_data) {
+      uint32_t handle = 0;
+      std::memcpy(&handle, handle_data.data(), sizeof(handle));
+      if (handle >= raw.objects_count())
+        return;
+
+      uint16_t stat_type = CStatsColumns::no_name;
+      uint16_t modifier_type = CStatsColumns::no_name;
+      float value = 0.f;
+
+      ok &= raw.for_each_field(raw.object_blob(handle), [&](const CSystemRaw::field_t& f) {
+        uint16_t name_idx = 0;
+        if (f.name_idx == stat_type_idx && CSystemRaw::read_value(f, name_idx))
+          stat_type = dict(name_idx);
+        else if (f.name_idx == modifier_type_idx && CSystemRaw::read_value(f, name_idx))
+          modifier_type = dict(name_idx);
+        else if (f.name_idx == value_idx && raw.field_ctypename(f) == "Float")
+          CSystemRaw::read_value(f, value);
+        return true;
+      });
+
+      cols.seeds.push_back(seed);
+      cols.objects.push_back(handle);
+      cols.classes.push_back(dict(raw.object_class_idx(handle)));
+      cols.stat_types.push_back(stat_type);
+      cols.modifier_types.push_back(modifier_type);
+      cols.values.push_back(value);
+    };
+
+    // gameSavedStatsData elements are inline objects
+    ok &= raw.for_each_element(values, [&](std::span<const char> elt) {
+      uint32_t seed = 0;
+      bool has_seed = false;
+      CSystemRaw::field_t mods;
+      bool has_mods = false;
+
+      ok &= raw.for_each_field(elt, [&](const CSystemRaw::field_t& f) {
+        if (f.name_idx == seed_idx)
+          has_seed = CSystemRaw::read_value(f, seed);
+        else if (f.name_idx == mods_idx)
+        {
+          mods = f;
+          has_mods = true;
+        }
+        return true;
+      });
+
+      // same seed twice, the map keeps the first one
+      if (!has_seed || !has_mods || !seeds.insert(seed).second)
+        return;
+
+      ok &= raw.for_each_element(mods, [&](std::span<const char> handle_data) {
+        if (handle_data.size() == sizeof(uint32_t))
+          add_modifier(seed, handle_data);
+      });
+    });
+
+    return ok;
+  }
+
+  // writes back the stat types, modifier types and values of edited that
+  // differ from view(), in one pass over the modified modifiers. the map
+  // posts a single event (instead of one per edited property).
+  // fails if edited isn't a copy of the current view.
+  bool apply_view(const CStatsView& edited, size_t* modified_cnt = nullptr)
+  {
+    const CStatsView& cur = view();
+    if (!m_mapstruct || edited.generation != cur.generation || edited.size() != cur.size()
+      || edited.stat_types.size() != cur.size() || edited.modifier_types.size() != cur.size()
+      || edited.values.size() != cur.size())
+    {
+      return false;
+    }
+
+    size_t cnt = 0;
+    m_mapstruct->edit_batch([&]() {
+      for (size_t i = 0; i < cur.size(); ++i)
+      {
+        CObject* modobj = m_view_objs[i];
+        bool modified = false;
+
+        if (edited.stat_types[i] != cur.stat_types[i])
+        {
+          if (auto prop = modobj->get_prop_cast<CEnumProperty>("statType"_gn))
+            modified |= prop->set_value_by_name(edited.stat_types[i]);
+        }
+
+        if (edited.modifier_types[i] != cur.modifier_types[i])
+        {
+          if (auto prop = modobj->get_prop_cast<CEnumProperty>("modifierType"_gn))
+            modified |= prop->set_value_by_name(edited.modifier_types[i]);
+        }
+
+        if (edited.values[i] != cur.values[i])
+        {
+          if (auto prop = modobj->get_prop_cast<CFloatProperty>("value"_gn))
+          {
+            prop->set_value(edited.values[i]);
+            modified = true;
+          }
+        }
+
+        cnt += modified ? 1 : 0;
+      }
+      return cnt > 0;
+    });
+
+    if (modified_cnt)
+      *modified_cnt = cnt;
+    return true;
+  }
+
 protected:
   CObjectSPtr add_new_modifier(CProperty* modifiers, gname name)
   {
@@ -103,7 +394,7 @@ protected:
     auto new_handle = dynamic_cast<CHandleProperty*>(mods->emplace(mods->begin())->get());
     if (!new_handle)
       return nullptr;//damnit
-    auto new_obj = std::make_shared<CObject>(name);
+    auto new_obj = CObject::create(name);
     new_handle->set_obj(new_obj);
     return new_obj;
   }
@@ -131,6 +422,11 @@ public:
 public:
   std::string node_name() const override { return "StatsSystem"; }
 
+  void accumulate_memory_usage(cp::memory_usage& mu) const override
+  {
+    m_sys.accumulate_memory_usage(mu);
+  }
+
   bool from_node_impl(const std::shared_ptr<const node_t>& node, const version& version) override
   {
     if (!node)
@@ -138,7 +434,8 @@ public:
 
     m_raw = node;
 
-    node_reader reader(node, version);
+    // the system blob is parsed in place
+    node_span_reader reader(node, version);
 
     // todo: catch exception at upper level to display error
     if (!m_sys.serialize_in(reader))
@@ -6,9 +6,46 @@
 #include "cpinternals/csav/node.hpp"
 #include "cpinternals/csav/serializers.hpp"
 #include "cpinternals/scripting/csystem.hpp"
+#include "cpinternals/scripting/csystem_raw.hpp"
 
 namespace cp::csav {
 
+// Read-only columns of the pool system, decoded straight from the serialized
+// system in one pass (see CStatsPool::extract_columns): no CObject is built.
+// One entry per serialized object that has a Float field: its value (the
+// "value" field, else the first Float one), the name of that field as kind
+// and the value of the first enum field as type.
+// Names are dictionary encoded, the name columns hold indices in names.
+struct CStatPoolsColumns
+{
+  static constexpr uint16_t no_name = CSystemRaw::name_dict::none;
+
+  std::vector<uint32_t> objects;      // object (its handle)
+  std::vector<uint16_t> classes;
+  std::vector<uint16_t> types;        // no_name if none
+  std::vector<uint16_t> value_kinds;  // name of the value field
+  std::vector<float>    values;
+
+  std::vector<gname> names;
+
+  size_t size() const { return objects.size(); }
+
+  gname name(uint16_t idx) const
+  {
+    return idx < names.size() ? names[idx] : gname();
+  }
+
+  void clear()
+  {
+    objects.clear();
+    classes.clear();
+    types.clear();
+    value_kinds.clear();
+    values.clear();
+    names.clear();
+  }
+};
+
 struct CStatsPool
   : public node_serializable
 {
@@ -21,8 +58,88 @@ public:
   const CSystem& system() const { return m_sys; }
   CSystem& system() { return m_sys; }
 
+  // node is the StatPoolsSystem node, it doesn't have to be loaded
+  static bool extract_columns(const std::shared_ptr<const node_t>& node, const version& version, CStatPoolsColumns& cols)
+  {
+    cols.clear();
+    if (!node)
+      return false;
+
+    node_span_reader reader(node, version);
+
+    CSystemRaw raw;
+    if (!raw.parse(reader) || !reader.at_end())
+      return false;
+
+    return extract_columns(raw, cols);
+  }
+
+  static bool extract_columns(const CSystemRaw& raw, CStatPoolsColumns& cols)
+  {
+    cols.clear();
+
+    const uint32_t value_idx = raw.find_string("value");
+    const uint32_t float_idx = raw.find_string("Float");
+    if (float_idx == CSystemRaw::npos)
+      return true;
+
+    CSystemRaw::name_dict dict(raw, cols.names);
+
+    // by field ctypename (strpool idx): 0 unknown, 1 enum, 2 other
+    std::vector<uint8_t> enum_ctypenames(raw.strpool().size(), 0);
+    auto is_enum = [&](uint16_t ctypename_idx) {
+      uint8_t& e = enum_ctypenames[ctypename_idx];
+      if (e == 0)
+        e = CEnum_resolver::get().is_registered(raw.strpool().view_from_idx(ctypename_idx)) ? 1 : 2;
+      return e == 1;
+    };
+
+    bool ok = true;
+    for (size_t i = 0, n = raw.objects_count(); i < n; ++i)
+    {
+      uint16_t type = CStatPoolsColumns::no_name;
+      uint16_t kind = CStatPoolsColumns::no_name;
+      float value = 0.f;
+
+      ok &= raw.for_each_field(raw.object_blob(i), [&](const CSystemRaw::field_t& f) {
+        if (f.ctypename_idx == float_idx)
+        {
+          // "value" wins over the other Float fields
+          if (kind == CStatPoolsColumns::no_name || f.name_idx == value_idx)
+          {
+            if (CSystemRaw::read_value(f, value))
+              kind = dict(f.name_idx);
+          }
+        }
+        else if (type == CStatPoolsColumns::no_name && is_enum(f.ctypename_idx))
+        {
+          uint16_t name_idx = 0;
+          if (CSystemRaw::read_value(f, name_idx))
+            type = dict(name_idx);
+        }
+        return true;
+      });
+
+      if (kind == CStatPoolsColumns::no_name)
+        continue;
+
+      cols.objects.push_back((uint32_t)i);
+      cols.classes.push_back(dict(raw.object_class_idx(i)));
+      cols.types.push_back(type);
+      cols.value_kinds.push_back(kind);
+      cols.values.push_back(value);
+    }
+
+    return ok;
+  }
+
   std::string node_name() const override { return "StatPoolsSystem"; }
 
+  void accumulate_memory_usage(cp::memory_usage& mu) const override
+  {
+    m_sys.accumulate_memory_usage(mu);
+  }
+
   bool from_node_impl(const std::shared_ptr<const node_t>& node, const version& version) override
   {
     if (!node)
@@ -30,7 +147,8 @@ public:
 
     m_raw = node;
 
-    node_reader reader(node, version);
+    // the system blob is parsed in place
+    node_span_reader reader(node, version);
 
     // todo: catch exception at upper level to display error
     if (!m_sys.serialize_in(reader))
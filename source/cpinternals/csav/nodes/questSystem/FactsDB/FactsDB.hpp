@@ -1,5 +1,7 @@
 #pragma once
 #include <inttypes.h>
+#include <optional>
+#include <unordered_map>
 
 #include "cpinternals/common.hpp"
 #include "cpinternals/ctypes.hpp"
@@ -20,7 +22,61 @@ struct FactsDB
   std::string node_name() const override { return "FactsDB"; }
 
   const std::vector<FactsTable>& tables() const { return m_tables; }
-  std::vector<FactsTable>& tables() { return m_tables; }
+
+  // the hash index is rebuilt on next lookup since tables may be edited
+  std::vector<FactsTable>& tables()
+  {
+    m_index_dirty = true;
+    return m_tables;
+  }
+
+  // returns npos if no table contains the fact
+  size_t find_table(uint32_t hash) const
+  {
+    const auto& index = hash_index();
+    auto it = index.find(hash);
+    if (it == index.end())
+      return npos;
+    return it->second;
+  }
+
+  std::optional<uint32_t> get_fact(uint32_t hash) const
+  {
+    const size_t tbl_idx = find_table(hash);
+    if (tbl_idx == npos)
+      return std::nullopt;
+    const auto& tbl = m_tables[tbl_idx];
+    return tbl.values()[tbl.find(hash)];
+  }
+
+  std::optional<uint32_t> get_fact(std::string_view name) const
+  {
+    return get_fact(CFact(name, 0, false).hash());
+  }
+
+  // updates the fact in the table that contains it, or inserts it in
+  // new_fact_table. returns false if there is no such table.
+  bool set_fact(uint32_t hash, uint32_t value, size_t new_fact_table = 0)
+  {
+    size_t tbl_idx = find_table(hash);
+    if (tbl_idx == npos)
+    {
+      if (new_fact_table >= m_tables.size())
+        return false;
+      tbl_idx = new_fact_table;
+      m_index.emplace(hash, tbl_idx);
+    }
+    m_tables[tbl_idx].set(hash, value);
+    return true;
+  }
+
+  // the name is registered in the CFact resolver
+  bool set_fact(std::string_view name, uint32_t value, size_t new_fact_table = 0)
+  {
+    return set_fact(CFact(name, 0).hash(), value, new_fact_table);
+  }
+
+  static constexpr size_t npos = (size_t)-1;
 
 protected:
   bool from_node_impl(const std::shared_ptr<const node_t>& node, const version& version) override
@@ -30,14 +86,16 @@ protected:
 
     m_raw = node;
 
-    node_reader reader(node, version);
+    node_span_reader reader(node, version);
 
-    size_t cnt = 0;
-    reader >> cp_packedint_ref((int64_t&)cnt);
+    int64_t cnt = 0;
+    if (!reader.read_packed_int(cnt) || cnt < 0)
+      return false;
     if (cnt > 10)
       cnt = 10;
 
     m_tables.resize(cnt);
+    m_index_dirty = true;
 
     for (auto& tbl : m_tables)
     {
@@ -54,32 +112,50 @@ protected:
 
   std::shared_ptr<const node_t> to_node_impl(const version& version) const override
   {
-    node_writer writer(version);
+    node_span_writer writer(version);
 
-    try
-    {
-      size_t cnt = m_tables.size();
-      writer << cp_packedint_ref((int64_t&)cnt);
-
-      for (auto& tbl : m_tables)
-      {
-        auto tbl_node = tbl.to_node(version);
-        if (!tbl_node)
-          return nullptr;
+    writer.write_packed_int((int64_t)m_tables.size());
 
-        writer.write_child(tbl_node);
-      }
-    }
-    catch (std::exception&)
+    for (auto& tbl : m_tables)
     {
-      return nullptr;
+      auto tbl_node = tbl.to_node(version);
+      if (!tbl_node)
+        return nullptr;
+
+      writer.write_child(tbl_node);
     }
 
     return writer.finalize(node_name());
   }
 
+  // maps fact hashes to the index of the table containing them, the slot
+  // in the table is found by binary search (facts are sorted by hash)
+  const std::unordered_map<uint32_t, size_t>& hash_index() const
+  {
+    if (m_index_dirty)
+    {
+      size_t cnt = 0;
+      for (const auto& tbl : m_tables)
+        cnt += tbl.size();
+
+      m_index.clear();
+      m_index.reserve(cnt);
+      for (size_t i = 0; i < m_tables.size(); ++i)
+      {
+        for (uint32_t hash : m_tables[i].hashes())
+          m_index.emplace(hash, i);
+      }
+
+      m_index_dirty = false;
+    }
+    return m_index;
+  }
+
   std::vector<FactsTable> m_tables;
 
+  mutable std::unordered_map<uint32_t, size_t> m_index;
+  mutable bool m_index_dirty = true;
+
   // Temporary
   std::shared_ptr<const node_t> m_raw;
 };
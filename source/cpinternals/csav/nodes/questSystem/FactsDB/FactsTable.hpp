@@ -1,5 +1,8 @@
 #pragma once
 #include <inttypes.h>
+#include <vector>
+#include <numeric>
+#include <algorithm>
 
 #include "cpinternals/common.hpp"
 #include "cpinternals/ctypes.hpp"
@@ -8,15 +11,92 @@
 
 namespace cp::csav {
 
+// Facts are kept as two arrays (hashes, values) sorted by hash, which is
+// the layout of the node: loading and saving are plain copies and lookups
+// are binary searches.
 struct FactsTable
   : public node_serializable
 {
+  static constexpr size_t npos = (size_t)-1;
+
   FactsTable() = default;
 
   std::string node_name() const override { return "FactsTable"; }
 
-  const std::vector<CFact>& facts() const { return m_facts; }
-  std::vector<CFact>& facts() { return m_facts; }
+  size_t size() const { return m_hashes.size(); }
+  bool empty() const { return m_hashes.empty(); }
+
+  // sorted ascending
+  const std::vector<uint32_t>& hashes() const { return m_hashes; }
+  const std::vector<uint32_t>& values() const { return m_values; }
+
+  CFact fact(size_t idx) const
+  {
+    return CFact(m_hashes[idx], m_values[idx]);
+  }
+
+  // returns npos if not found
+  size_t find(uint32_t hash) const
+  {
+    auto it = std::lower_bound(m_hashes.begin(), m_hashes.end(), hash);
+    if (it == m_hashes.end() || *it != hash)
+      return npos;
+    return (size_t)(it - m_hashes.begin());
+  }
+
+  bool contains(uint32_t hash) const
+  {
+    return find(hash) != npos;
+  }
+
+  void set_value(size_t idx, uint32_t value)
+  {
+    m_values[idx] = value;
+  }
+
+  // inserts the fact or updates its value, returns its index
+  size_t set(uint32_t hash, uint32_t value)
+  {
+    auto it = std::lower_bound(m_hashes.begin(), m_hashes.end(), hash);
+    const size_t idx = (size_t)(it - m_hashes.begin());
+    if (it != m_hashes.end() && *it == hash)
+    {
+      m_values[idx] = value;
+      return idx;
+    }
+    m_hashes.insert(it, hash);
+    m_values.insert(m_values.begin() + idx, value);
+    return idx;
+  }
+
+  size_t set(const CFact& fact)
+  {
+    return set(fact.hash(), fact.value());
+  }
+
+  // replaces the fact at idx (it moves if its hash changed), returns its new index
+  size_t assign(size_t idx, const CFact& fact)
+  {
+    if (m_hashes[idx] == fact.hash())
+    {
+      m_values[idx] = fact.value();
+      return idx;
+    }
+    erase(idx);
+    return set(fact);
+  }
+
+  void erase(size_t idx)
+  {
+    m_hashes.erase(m_hashes.begin() + idx);
+    m_values.erase(m_values.begin() + idx);
+  }
+
+  void clear()
+  {
+    m_hashes.clear();
+    m_values.clear();
+  }
 
 protected:
   bool from_node_impl(const std::shared_ptr<const node_t>& node, const version& version) override
@@ -26,62 +106,61 @@ protected:
 
     m_raw = node;
 
-    node_reader reader(node, version);
+    node_span_reader reader(node, version);
 
-    size_t cnt = 0;
-    reader >> cp_packedint_ref((int64_t&)cnt);
+    int64_t cnt = 0;
+    if (!reader.read_packed_int(cnt) || cnt < 0 || size_t(cnt) * 8 > reader.remaining())
+      return false;
 
-    std::vector<uint32_t> m_arr1; m_arr1.resize(cnt);
-    std::vector<uint32_t> m_arr2; m_arr2.resize(cnt);
+    m_hashes.resize(cnt);
+    m_values.resize(cnt);
 
-    reader.read((char*)m_arr1.data(), 4 * cnt);
-    reader.read((char*)m_arr2.data(), 4 * cnt);
+    reader.read(m_hashes.data(), 4 * cnt);
+    reader.read(m_values.data(), 4 * cnt);
 
-    m_facts.reserve(cnt);
-    auto it2 = m_arr2.begin();
-    for (auto& it1 : m_arr1)
-    {
-      m_facts.emplace_back(it1, *(it2++));
-    }
+    // the game writes them sorted, but let's not rely on it
+    if (!std::is_sorted(m_hashes.begin(), m_hashes.end()))
+      sort_by_hash();
 
     return reader.at_end();
   }
 
   std::shared_ptr<const node_t> to_node_impl(const version& version) const override
   {
-    node_writer writer(version);
+    node_span_writer writer(version);
 
-    try
-    {
-      size_t cnt = m_facts.size();
-      writer << cp_packedint_ref((int64_t&)cnt);
-
-      std::vector<CFact> copy = m_facts;
-      std::sort(copy.begin(), copy.end(), [](const CFact& a, const CFact& b) -> bool {
-        return a.hash() < b.hash();
-      });
-
-      std::vector<uint32_t> m_arr1; m_arr1.reserve(cnt);
-      std::vector<uint32_t> m_arr2; m_arr2.reserve(cnt);
-      
-      for (auto& f : copy)
-      {
-        m_arr1.emplace_back(f.hash());
-        m_arr2.emplace_back(f.value());
-      }
-
-      writer.write((char*)m_arr1.data(), 4 * cnt);
-      writer.write((char*)m_arr2.data(), 4 * cnt);
-    }
-    catch (std::exception&)
+    const size_t cnt = m_hashes.size();
+    writer.reserve(5 + 8 * cnt);
+    writer.write_packed_int((int64_t)cnt);
+
+    writer.write(m_hashes.data(), 4 * cnt);
+    writer.write(m_values.data(), 4 * cnt);
+
+    return writer.finalize(node_name());
+  }
+
+  void sort_by_hash()
+  {
+    std::vector<size_t> order(m_hashes.size());
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::stable_sort(order.begin(), order.end(),
+      [this](size_t a, size_t b) { return m_hashes[a] < m_hashes[b]; });
+
+    std::vector<uint32_t> hashes, values;
+    hashes.reserve(order.size());
+    values.reserve(order.size());
+    for (size_t i : order)
     {
-      return nullptr;
+      hashes.emplace_back(m_hashes[i]);
+      values.emplace_back(m_values[i]);
     }
 
-    return writer.finalize(node_name());
+    m_hashes = std::move(hashes);
+    m_values = std::move(values);
   }
 
-  std::vector<CFact> m_facts;
+  std::vector<uint32_t> m_hashes;
+  std::vector<uint32_t> m_values;
 
   // Temporary
   std::shared_ptr<const node_t> m_raw;
@@ -0,0 +1,102 @@
+#include "payload_store.hpp"
+
+#include <algorithm>
+#include <cpinternals/common/hashing.hpp>
+
+namespace cp::csav {
+
+payload_store& payload_store::get()
+{
+  static payload_store* s_instance = new payload_store();
+  return *s_instance;
+}
+
+payload_store::buffer_type payload_store::intern(std::span<const char> bytes)
+{
+  const uint64_t hash = crc64_bigdata(bytes.data(), bytes.size());
+  auto& sh = shard_of(hash);
+
+  // buffers locked while comparing: if one is the last reference, its
+  // release locks sh.mtx, so it must be dropped after the lock is
+  std::vector<buffer_type> candidates;
+
+  {
+    std::lock_guard<std::mutex> lock(sh.mtx);
+
+    auto it = sh.entries.find(hash);
+    if (it != sh.entries.end())
+    {
+      for (const auto& e : it->second)
+      {
+        if (e.size != bytes.size())
+          continue;
+
+        // expired ones are about to be released
+        auto buffer = e.buffer.lock();
+        if (!buffer)
+          continue;
+
+        if (std::equal(buffer->begin(), buffer->end(), bytes.begin()))
+        {
+          ++sh.hits;
+          return buffer;
+        }
+
+        candidates.push_back(std::move(buffer));
+      }
+    }
+
+    ++sh.misses;
+  }
+
+  // copied outside of the lock
+  auto* raw = new std::vector<char>(bytes.begin(), bytes.end());
+  buffer_type buffer(raw, [this, hash](const std::vector<char>* p) {
+    const size_t size = p->size();
+    delete p;
+    release(hash, size);
+  });
+
+  std::lock_guard<std::mutex> lock(sh.mtx);
+  sh.entries[hash].push_back(entry{buffer, bytes.size()});
+  sh.bytes += bytes.size();
+  return buffer;
+}
+
+void payload_store::release(uint64_t hash, size_t size)
+{
+  auto& sh = shard_of(hash);
+  std::lock_guard<std::mutex> lock(sh.mtx);
+
+  sh.bytes -= size;
+
+  auto it = sh.entries.find(hash);
+  if (it == sh.entries.end())
+    return;
+
+  auto& chain = it->second;
+  chain.erase(std::remove_if(chain.begin(), chain.end(), [](const entry& e) {
+    return e.buffer.expired();
+  }), chain.end());
+
+  if (chain.empty())
+    sh.entries.erase(it);
+}
+
+payload_store::stats payload_store::get_stats() const
+{
+  stats ret;
+  for (const auto& sh : m_shards)
+  {
+    std::lock_guard<std::mutex> lock(sh.mtx);
+    ret.hits += sh.hits;
+    ret.misses += sh.misses;
+    ret.bytes += sh.bytes;
+    for (const auto& [hash, chain] : sh.entries)
+      ret.entries_cnt += chain.size();
+  }
+  return ret;
+}
+
+} // namespace cp::csav
+
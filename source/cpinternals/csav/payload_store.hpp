@@ -0,0 +1,91 @@
+#pragma once
+#include <inttypes.h>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace cp::csav {
+
+// Process-wide store of immutable node payloads (leaf datas and blobs),
+// deduplicated by content: identical payloads of the saves open at the same
+// time (e.g. saves of one playthrough, or a save reloaded after an edit)
+// share one buffer. Nodes view the buffers (see node_t::assign_shared_data)
+// and copy them on their first edit. An entry is refcounted by the nodes
+// viewing it and leaves the store with the last one.
+// Thread-safe, enabled per tree (see node_tree::set_shared_payloads).
+class payload_store
+{
+public:
+  using buffer_type = std::shared_ptr<const std::vector<char>>;
+
+  struct stats
+  {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    size_t   entries_cnt = 0;
+    size_t   bytes = 0; // stored once, whatever the number of users
+  };
+
+  // smaller payloads are copied, their lookup would cost more than it saves
+  static constexpr size_t default_min_payload_size = 512;
+
+  // never destroyed, nodes can outlive the static destructors
+  static payload_store& get();
+
+  payload_store(const payload_store&) = delete;
+  payload_store& operator=(const payload_store&) = delete;
+
+  size_t min_payload_size() const
+  {
+    return m_min_payload_size;
+  }
+
+  void set_min_payload_size(size_t size)
+  {
+    m_min_payload_size = size;
+  }
+
+  // buffer with the content of bytes, shared with the other users of that
+  // content. bytes can be smaller than min_payload_size (not checked).
+  buffer_type intern(std::span<const char> bytes);
+
+  stats get_stats() const;
+
+protected:
+  payload_store() = default;
+
+  static constexpr size_t shards_cnt = 16;
+
+  struct entry
+  {
+    std::weak_ptr<const std::vector<char>> buffer;
+    size_t size = 0;
+  };
+
+  struct shard
+  {
+    mutable std::mutex mtx;
+    // content hash -> entries (collisions are chained)
+    std::unordered_map<uint64_t, std::vector<entry>> entries;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    size_t bytes = 0;
+  };
+
+  shard& shard_of(uint64_t hash)
+  {
+    return m_shards[hash % shards_cnt];
+  }
+
+  // called when the last user of a buffer releases it
+  void release(uint64_t hash, size_t size);
+
+  std::array<shard, shards_cnt> m_shards;
+  size_t m_min_payload_size = default_min_payload_size;
+};
+
+} // namespace cp::csav
+
@@ -0,0 +1,411 @@
+#include "roundtrip.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <cpinternals/common/parallel.hpp>
+#include <cpinternals/common/instrumentation.hpp>
+#include <cpinternals/init.hpp>
+#include <cpinternals/csav/savegame.hpp>
+#include <cpinternals/scripting/csystem_blob.hpp>
+
+namespace cp::csav {
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+double elapsed_ms(clock_type::time_point since)
+{
+  return std::chrono::duration<double, std::milli>(clock_type::now() - since).count();
+}
+
+// bytes of a node as written in a save (see savegame::test_reserialize)
+bool serialize_node(const std::shared_ptr<const node_t>& node, std::vector<char>& out)
+{
+  auto root = node_t::create_shared(node_t::root_node_idx, "root");
+  root->nonconst().children_push_back(node);
+
+  serial_tree stree;
+  if (!stree.from_tree(root, 4))
+    return false;
+
+  out = std::move(stree.nodedata);
+  return true;
+}
+
+struct csav_case
+  : roundtrip_case
+{
+  savegame save;
+  std::vector<std::string_view> units; // loaded systems
+
+  size_t units_count() const override
+  {
+    return units.size();
+  }
+
+  std::string unit_name(size_t idx) const override
+  {
+    return std::string(units[idx]);
+  }
+
+  op_status original_unit(size_t idx, std::vector<char>& out) override
+  {
+    if (!serialize_node(save.search_node(units[idx]), out))
+      return op_status(fmt::format("couldn't serialize node {}", units[idx]));
+    return true;
+  }
+
+  op_status reserialize_unit(size_t idx, std::vector<char>& out) override
+  {
+    for (const auto& [name, var] : save.systems())
+    {
+      if (name != units[idx])
+        continue;
+
+      auto new_node = var->to_node(save.tree.ver());
+      if (!new_node || !serialize_node(new_node, out))
+        return op_status(fmt::format("couldn't reserialize {}", name));
+      return true;
+    }
+
+    return op_status(fmt::format("unknown system {}", units[idx]));
+  }
+};
+
+struct csav_format
+  : roundtrip_format
+{
+  std::string_view name() const override
+  {
+    return "csav";
+  }
+
+  bool accepts(const std::filesystem::path& path) const override
+  {
+    return path.filename() == L"sav.dat";
+  }
+
+  std::unique_ptr<roundtrip_case> load(std::span<const char> data, op_status& status) const override
+  {
+    auto c = std::make_unique<csav_case>();
+    c->save.interactive = false;
+    // parallelism is at the input level
+    c->save.tree.set_workers_count(1);
+    c->save.systems_workers_count = 1;
+
+    progress_t progress;
+    status = c->save.open_with_progress(data, progress, false, true, false);
+    if (!status)
+      return nullptr;
+
+    for (const auto& [name, var] : c->save.systems())
+    {
+      // old saves don't have all the systems
+      if (!c->save.search_node(name))
+        continue;
+
+      if (!c->save.load_system_reencoded(name))
+      {
+        const auto& errors = c->save.load_errors;
+        status = op_status(fmt::format("couldn't load {}{}", name, errors.empty() ? "" : ": " + errors.back()));
+        return nullptr;
+      }
+
+      c->units.push_back(name);
+    }
+
+    return c;
+  }
+};
+
+struct csystem_blob_case
+  : roundtrip_case
+{
+  std::vector<char> original;
+  CSystemBlob blob;
+
+  size_t units_count() const override
+  {
+    return 1;
+  }
+
+  std::string unit_name(size_t) const override
+  {
+    return "blob";
+  }
+
+  op_status original_unit(size_t, std::vector<char>& out) override
+  {
+    out = original;
+    return true;
+  }
+
+  op_status reserialize_unit(size_t, std::vector<char>& out) override
+  {
+    if (!blob.serialize_out(out))
+      return op_status(std::string("couldn't reserialize the blob"));
+    return true;
+  }
+};
+
+struct csystem_blob_format
+  : roundtrip_format
+{
+  std::string_view name() const override
+  {
+    return "csystem_blob";
+  }
+
+  bool accepts(const std::filesystem::path& path) const override
+  {
+    const auto ext = path.extension().string();
+    return ext.rfind(".bin", 0) == 0 || ext.rfind(".buffer", 0) == 0;
+  }
+
+  std::unique_ptr<roundtrip_case> load(std::span<const char> data, op_status& status) const override
+  {
+    auto c = std::make_unique<csystem_blob_case>();
+    c->original.assign(data.begin(), data.end());
+
+    try
+    {
+      if (!c->blob.serialize_in(data))
+      {
+        status = op_status(std::string("invalid blob"));
+        return nullptr;
+      }
+    }
+    catch (std::exception& e)
+    {
+      status = op_status(fmt::format("invalid blob: {}", e.what()));
+      return nullptr;
+    }
+
+    status = true;
+    return c;
+  }
+};
+
+// differing range of a and b, false if they are equal
+bool find_differing_range(const std::vector<char>& a, const std::vector<char>& b, size_t& first, size_t& last)
+{
+  const size_t common_size = std::min(a.size(), b.size());
+  const auto it = std::mismatch(a.begin(), a.begin() + common_size, b.begin());
+  first = static_cast<size_t>(it.first - a.begin());
+
+  if (first == common_size && a.size() == b.size())
+    return false;
+
+  if (a.size() != b.size())
+  {
+    last = std::max(a.size(), b.size()) - 1;
+    return true;
+  }
+
+  last = a.size() - 1;
+  while (last > first && a[last] == b[last])
+    --last;
+  return true;
+}
+
+void dump_range(const std::filesystem::path& path, const std::vector<char>& bytes, size_t begin, size_t end)
+{
+  begin = std::min(begin, bytes.size());
+  end = std::min(end, bytes.size());
+
+  std::ofstream ofs(path, std::ios::binary);
+  ofs.write(bytes.data() + begin, end - begin);
+}
+
+} // namespace
+
+std::unique_ptr<roundtrip_format> make_csav_roundtrip_format()
+{
+  return std::make_unique<csav_format>();
+}
+
+std::unique_ptr<roundtrip_format> make_csystem_blob_roundtrip_format()
+{
+  return std::make_unique<csystem_blob_format>();
+}
+
+void roundtrip_verifier::add_default_formats()
+{
+  formats.emplace_back(make_csav_roundtrip_format());
+  formats.emplace_back(make_csystem_blob_roundtrip_format());
+}
+
+const roundtrip_format* roundtrip_verifier::format_of(const std::filesystem::path& path) const
+{
+  for (const auto& f : formats)
+  {
+    if (f->accepts(path))
+      return f.get();
+  }
+  return nullptr;
+}
+
+std::vector<std::filesystem::path> roundtrip_verifier::find_inputs(const std::filesystem::path& dir) const
+{
+  std::vector<std::filesystem::path> ret;
+
+  std::error_code ec;
+  for (auto it = std::filesystem::recursive_directory_iterator(dir, ec); it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+  {
+    if (ec)
+      break;
+    if (it->is_regular_file() && format_of(it->path()))
+      ret.emplace_back(it->path());
+  }
+
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
+roundtrip_verifier::result roundtrip_verifier::verify(const std::filesystem::path& path, size_t idx) const
+{
+  const std::string filename = path.filename().string();
+  scoped_span span("roundtrip.verify", filename);
+
+  result res;
+  res.path = path;
+
+  const roundtrip_format* format = format_of(path);
+  if (!format)
+  {
+    res.status = op_status(std::string("unknown format"));
+    return res;
+  }
+  res.format = format->name();
+
+  // read
+  std::vector<char> data;
+  auto start = clock_type::now();
+  {
+    std::ifstream ifs(path, std::ios::binary | std::ios::ate);
+    if (!ifs.is_open())
+    {
+      res.status = op_status(fmt::format("couldn't open {}", path.string()));
+      return res;
+    }
+
+    data.resize(static_cast<size_t>(ifs.tellg()));
+    ifs.seekg(0);
+    ifs.read(data.data(), data.size());
+    if (!ifs)
+    {
+      res.status = op_status(fmt::format("couldn't read {}", path.string()));
+      return res;
+    }
+  }
+  res.read_ms = elapsed_ms(start);
+  res.size = data.size();
+  span.set_bytes(data.size());
+
+  // load
+  start = clock_type::now();
+  std::unique_ptr<roundtrip_case> c;
+  {
+    scoped_span load_span("roundtrip.load");
+    c = format->load(data, res.status);
+  }
+  res.load_ms = elapsed_ms(start);
+
+  if (!c)
+  {
+    if (res.status)
+      res.status = op_status(std::string("couldn't load"));
+    return res;
+  }
+  res.units_cnt = c->units_count();
+
+  // reserialize and compare, unit by unit
+  std::vector<char> original, reserialized;
+  for (size_t i = 0; i < res.units_cnt; ++i)
+  {
+    const std::string unit = c->unit_name(i);
+
+    start = clock_type::now();
+    {
+      scoped_span reser_span("roundtrip.reserialize", unit);
+      res.status = c->reserialize_unit(i, reserialized);
+    }
+    res.reserialize_ms += elapsed_ms(start);
+
+    if (!res.status)
+      return res;
+
+    // compare_ms includes getting the original bytes
+    start = clock_type::now();
+    size_t first = 0, last = 0;
+    bool differs = false;
+    {
+      scoped_span cmp_span("roundtrip.compare", unit);
+      res.status = c->original_unit(i, original);
+      differs = res.status && find_differing_range(original, reserialized, first, last);
+    }
+    res.compare_ms += elapsed_ms(start);
+
+    if (!res.status)
+      return res;
+    if (!differs)
+      continue;
+
+    mismatch& m = res.mismatches.emplace_back();
+    m.unit = unit;
+    m.original_size = original.size();
+    m.reserialized_size = reserialized.size();
+    m.first_diff = first;
+    m.last_diff = last;
+
+    if (!dump_dir.empty())
+    {
+      std::error_code ec;
+      std::filesystem::create_directories(dump_dir, ec);
+
+      const size_t begin = first > dump_context ? first - dump_context : 0;
+      const size_t end = last + 1 + dump_context;
+      const std::string stem = fmt::format("{:04}_{}", idx, m.unit);
+      dump_range(dump_dir / (stem + ".orig.bin"), original, begin, end);
+      dump_range(dump_dir / (stem + ".reser.bin"), reserialized, begin, end);
+    }
+  }
+
+  return res;
+}
+
+std::vector<roundtrip_verifier::result> roundtrip_verifier::verify_all(const std::vector<std::filesystem::path>& paths, size_t workers_cnt) const
+{
+  scoped_span span("roundtrip.verify_all");
+
+  std::vector<result> results(paths.size());
+
+  preload_blueprints();
+
+  span_sink* const sink = current_span_sink();
+  const uint32_t depth = current_span_depth();
+
+  parallel_for(paths.size(), workers_cnt, [&](size_t i)
+  {
+    scoped_span_sink job_sink(sink, depth);
+    // pools are per thread, reserializations reuse the buffers
+    node_buffer_pool_scope pool_scope;
+
+    try
+    {
+      results[i] = verify(paths[i], i);
+    }
+    catch (std::exception& e)
+    {
+      results[i].path = paths[i];
+      results[i].status = op_status(fmt::format("exception: {}", e.what()));
+    }
+  });
+
+  return results;
+}
+
+} // namespace cp::csav
+
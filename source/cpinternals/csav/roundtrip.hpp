@@ -0,0 +1,107 @@
+#pragma once
+#include <inttypes.h>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cpinternals/common.hpp>
+
+namespace cp::csav {
+
+// input loaded by a roundtrip_format, made of units that reserialize
+// independently (e.g. the systems of a save)
+struct roundtrip_case
+{
+  virtual ~roundtrip_case() = default;
+
+  virtual size_t units_count() const = 0;
+  virtual std::string unit_name(size_t idx) const = 0;
+
+  // bytes of the unit as loaded
+  virtual op_status original_unit(size_t idx, std::vector<char>& out) = 0;
+  // bytes of the unit once reserialized
+  virtual op_status reserialize_unit(size_t idx, std::vector<char>& out) = 0;
+};
+
+// a format handled by a CSystem-style serializer
+struct roundtrip_format
+{
+  virtual ~roundtrip_format() = default;
+
+  virtual std::string_view name() const = 0;
+  virtual bool accepts(const std::filesystem::path& path) const = 0;
+
+  // nullptr and status set on error
+  virtual std::unique_ptr<roundtrip_case> load(std::span<const char> data, op_status& status) const = 0;
+};
+
+// sav.dat files, a unit per system (see savegame::systems)
+std::unique_ptr<roundtrip_format> make_csav_roundtrip_format();
+// .bin/.buffer blobs of the archives (see CSystemBlob), a single unit
+std::unique_ptr<roundtrip_format> make_csystem_blob_roundtrip_format();
+
+// Round-trip verification of many inputs: each one is read, loaded,
+// reserialized and compared byte for byte with the original, inputs being
+// processed concurrently (one input per task) and each phase timed.
+// A mismatching input is minimized to its mismatching units and, in each
+// of them, to the range of bytes that differ. These ranges (with some
+// context) are dumped if dump_dir is set.
+struct roundtrip_verifier
+{
+  struct mismatch
+  {
+    std::string unit;
+    size_t original_size = 0;
+    size_t reserialized_size = 0;
+    // differing bytes are in [first_diff, last_diff]
+    size_t first_diff = 0;
+    size_t last_diff = 0;
+  };
+
+  struct result
+  {
+    std::filesystem::path path;
+    std::string_view format;
+    op_status status; // read, load or reserialization error
+    std::vector<mismatch> mismatches;
+    size_t units_cnt = 0;
+    size_t size = 0;
+    double read_ms = 0;
+    double load_ms = 0;
+    double reserialize_ms = 0;
+    double compare_ms = 0;
+
+    bool ok() const
+    {
+      return status && mismatches.empty();
+    }
+  };
+
+  std::vector<std::unique_ptr<roundtrip_format>> formats;
+
+  // directory of the minimized mismatches, nothing is dumped if empty:
+  // <input idx>_<unit>.orig.bin and <input idx>_<unit>.reser.bin
+  std::filesystem::path dump_dir;
+  // bytes kept around the differing range in the dumps
+  size_t dump_context = 256;
+
+  // csav and CSystem blob formats
+  void add_default_formats();
+
+  const roundtrip_format* format_of(const std::filesystem::path& path) const;
+
+  // files of dir (recursively) that have a format, sorted
+  std::vector<std::filesystem::path> find_inputs(const std::filesystem::path& dir) const;
+
+  // idx is only used to name the dumps
+  result verify(const std::filesystem::path& path, size_t idx = 0) const;
+
+  // 0 means one worker per hardware thread, 1 disables threading
+  std::vector<result> verify_all(const std::vector<std::filesystem::path>& paths, size_t workers_cnt = 0) const;
+};
+
+} // namespace cp::csav
+
@@ -0,0 +1,560 @@
+#include "save_index.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <unordered_map>
+#include <cpinternals/common/parallel.hpp>
+#include <cpinternals/common/instrumentation.hpp>
+#include <cpinternals/init.hpp>
+#include <cpinternals/io/file_istream.hpp>
+#include <cpinternals/io/memory_istream.hpp>
+#include <cpinternals/io/memory_ostream.hpp>
+#include <cpinternals/csav/savegame.hpp>
+
+namespace cp::csav {
+
+namespace {
+
+constexpr uint32_t index_magic = 'CSIX';
+constexpr uint32_t index_format = 1;
+
+struct scanned_save
+{
+  std::filesystem::path full_path;
+  save_index::save_entry entry;
+};
+
+std::vector<scanned_save> scan_saves(const std::filesystem::path& dir)
+{
+  namespace fs = std::filesystem;
+  std::vector<scanned_save> ret;
+
+  std::error_code ec;
+  for (auto it = fs::recursive_directory_iterator(dir, ec); it != fs::recursive_directory_iterator(); it.increment(ec))
+  {
+    if (ec)
+      break;
+    if (!it->is_regular_file(ec) || it->path().filename() != "sav.dat")
+      continue;
+
+    scanned_save s;
+    s.full_path = it->path();
+    s.entry.path = fs::relative(it->path(), dir, ec).generic_u8string();
+    s.entry.mtime = static_cast<int64_t>(it->last_write_time(ec).time_since_epoch().count());
+    s.entry.size = static_cast<uint64_t>(it->file_size(ec));
+    ret.emplace_back(std::move(s));
+  }
+
+  std::sort(ret.begin(), ret.end(), [](const scanned_save& a, const scanned_save& b) {
+    return a.entry.path < b.entry.path;
+  });
+  return ret;
+}
+
+// sorts by key and sums the values of duplicate keys
+void merge_terms(std::vector<std::pair<uint64_t, uint32_t>>& terms)
+{
+  std::sort(terms.begin(), terms.end(), [](const auto& a, const auto& b) {
+    return a.first < b.first;
+  });
+
+  size_t out = 0;
+  for (size_t i = 0; i < terms.size(); ++i)
+  {
+    if (out && terms[out - 1].first == terms[i].first)
+      terms[out - 1].second += terms[i].second;
+    else
+      terms[out++] = terms[i];
+  }
+  terms.resize(out);
+}
+
+} // namespace
+
+op_status save_index::open(const std::filesystem::path& index_path)
+{
+  close();
+
+  file_istream ar(index_path);
+  if (ar.has_error())
+    return op_status(fmt::format("couldn't open {}", index_path.string()));
+
+  uint32_t magic = 0, format = 0;
+  ar << magic << format;
+  if (magic != index_magic || format != index_format)
+    return op_status(std::string("unsupported index file"));
+
+  uint32_t saves_cnt = 0;
+  ar << saves_cnt;
+  if (ar.has_error() || saves_cnt > ar.size() / 16)
+    return op_status(std::string("invalid index file"));
+
+  m_saves.resize(saves_cnt);
+  for (auto& s : m_saves)
+  {
+    uint8_t ok = 0;
+    ar.serialize_str_lpfxd(s.path);
+    ar << s.mtime << s.size << ok;
+    s.ok = !!ok;
+  }
+
+  uint32_t cols_cnt = 0;
+  ar << cols_cnt;
+  if (cols_cnt != columns_cnt)
+  {
+    close();
+    return op_status(std::string("invalid index file"));
+  }
+
+  for (auto& col : m_columns)
+  {
+    uint32_t keys_cnt = 0;
+    ar << keys_cnt;
+    if (ar.has_error() || keys_cnt > ar.size() / 20)
+    {
+      close();
+      return op_status(std::string("invalid index file"));
+    }
+
+    col.keys.resize(keys_cnt);
+    col.counts.resize(keys_cnt);
+    col.offsets.resize(keys_cnt);
+    ar.serialize_pods_array_raw(col.keys.data(), keys_cnt);
+    ar.serialize_pods_array_raw(col.counts.data(), keys_cnt);
+    ar.serialize_pods_array_raw(col.offsets.data(), keys_cnt);
+  }
+
+  ar << m_blobs_size;
+  m_blobs_pos = static_cast<uint64_t>(ar.tell());
+
+  if (ar.has_error() || m_blobs_pos + m_blobs_size != ar.size())
+  {
+    close();
+    return op_status(std::string("invalid index file"));
+  }
+
+  ar.close();
+
+  // posting lists are read on demand
+  if (!m_reader.open(index_path))
+  {
+    close();
+    return op_status(fmt::format("couldn't open {}", index_path.string()));
+  }
+
+  return {};
+}
+
+void save_index::close()
+{
+  if (m_reader.is_open())
+    m_reader.close();
+
+  m_saves.clear();
+  for (auto& col : m_columns)
+  {
+    col.keys.clear();
+    col.counts.clear();
+    col.offsets.clear();
+  }
+  m_blobs_pos = 0;
+  m_blobs_size = 0;
+}
+
+std::vector<save_index::posting> save_index::postings(column_e c, uint64_t key) const
+{
+  std::vector<posting> ret;
+  if (!is_open())
+    return ret;
+
+  const auto& col = m_columns[static_cast<size_t>(c)];
+  auto it = std::lower_bound(col.keys.begin(), col.keys.end(), key);
+  if (it == col.keys.end() || *it != key)
+    return ret;
+
+  const size_t i = static_cast<size_t>(it - col.keys.begin());
+  const uint64_t begin = col.offsets[i];
+  const uint64_t end = (i + 1 < col.offsets.size()) ? col.offsets[i + 1] : column_end(static_cast<size_t>(c));
+
+  std::vector<char> buf(static_cast<size_t>(end - begin));
+  if (!m_reader.read_at(static_cast<size_t>(m_blobs_pos + begin), buf))
+    return ret;
+
+  memory_istream ar(buf);
+  ret.resize(col.counts[i]);
+  uint32_t save = 0;
+  for (auto& p : ret)
+  {
+    uint32_t delta = 0;
+    ar.serialize_int_packed(delta);
+    ar.serialize_int_packed(p.value);
+    save += delta;
+    p.save = save;
+  }
+
+  if (ar.has_error())
+    ret.clear();
+
+  return ret;
+}
+
+std::vector<uint32_t> save_index::find(column_e col, uint64_t key) const
+{
+  std::vector<uint32_t> ret;
+  for (const auto& p : postings(col, key))
+    ret.push_back(p.save);
+  return ret;
+}
+
+std::vector<uint32_t> save_index::saves_with_fact(uint32_t hash, bool set_only) const
+{
+  std::vector<uint32_t> ret;
+  for (const auto& p : postings(column_e::facts, hash))
+  {
+    if (!set_only || p.value)
+      ret.push_back(p.save);
+  }
+  return ret;
+}
+
+std::vector<uint32_t> save_index::intersect(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b)
+{
+  std::vector<uint32_t> ret;
+  std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(ret));
+  return ret;
+}
+
+uint64_t save_index::column_end(size_t c) const
+{
+  // columns are laid out one after the other
+  for (size_t next = c + 1; next < columns_cnt; ++next)
+  {
+    if (m_columns[next].offsets.size())
+      return m_columns[next].offsets.front();
+  }
+  return m_blobs_size;
+}
+
+bool save_index::read_column(size_t c, std::vector<std::vector<std::pair<uint64_t, uint32_t>>>& terms_by_save) const
+{
+  const auto& col = m_columns[c];
+  if (col.keys.empty())
+    return true;
+
+  const uint64_t begin = col.offsets.front();
+  const uint64_t end = column_end(c);
+
+  std::vector<char> buf(static_cast<size_t>(end - begin));
+  if (!m_reader.read_at(static_cast<size_t>(m_blobs_pos + begin), buf))
+    return false;
+
+  memory_istream ar(buf);
+  for (size_t i = 0; i < col.keys.size(); ++i)
+  {
+    uint32_t save = 0;
+    for (uint32_t j = 0; j < col.counts[i]; ++j)
+    {
+      uint32_t delta = 0, value = 0;
+      ar.serialize_int_packed(delta);
+      ar.serialize_int_packed(value);
+      save += delta;
+      if (save >= terms_by_save.size())
+        return false;
+      // keys are ascending, so are the terms of each save
+      terms_by_save[save].emplace_back(col.keys[i], value);
+    }
+  }
+
+  return !ar.has_error();
+}
+
+bool save_index::extract_terms(const std::filesystem::path& path, save_terms& terms, std::string& error)
+{
+  scoped_span span("index.extract");
+
+  savegame save;
+  save.interactive = false;
+  // parallelism is at the file level
+  save.tree.set_workers_count(1);
+  save.systems_workers_count = 1;
+
+  // only the chunks of the 3 systems are decompressed
+  op_status status = save.open_partial(path);
+  if (!status)
+  {
+    error = status.err();
+    return false;
+  }
+
+  auto& items = terms[static_cast<size_t>(column_e::items)];
+  if (save.load_system("inventory"))
+  {
+    for (const auto& subinv : save.inventory.m_subinvs)
+    {
+      for (const auto& item : subinv.items)
+        items.emplace_back(item.iid.nameid.as_u64, item.quantity);
+    }
+  }
+
+  auto& facts = terms[static_cast<size_t>(column_e::facts)];
+  if (save.load_system("FactsDB"))
+  {
+    for (const auto& tbl : std::as_const(save.factsdb).tables())
+    {
+      for (size_t i = 0; i < tbl.size(); ++i)
+        facts.emplace_back(tbl.hashes()[i], tbl.values()[i]);
+    }
+  }
+
+  // StatsSystem: statType of every modifier
+  auto& stats = terms[static_cast<size_t>(column_e::stats)];
+  if (save.load_system("StatsSystem"))
+  {
+    const auto& view = save.stats.view();
+    for (const auto& stat_type : view.stat_types)
+    {
+      if (stat_type)
+        stats.emplace_back(stat_key(stat_type.strv()), 1);
+    }
+  }
+
+  for (auto& col_terms : terms)
+    merge_terms(col_terms);
+
+  if (save.load_errors.size())
+  {
+    error = save.load_errors.front();
+    return false;
+  }
+
+  return true;
+}
+
+op_status save_index::update(const std::filesystem::path& saves_dir, const std::filesystem::path& index_path, update_stats* stats)
+{
+  scoped_span span("index.update");
+
+  if (!std::filesystem::is_directory(saves_dir))
+    return op_status(fmt::format("{} is not a directory", saves_dir.string()));
+
+  auto scanned = scan_saves(saves_dir);
+  const size_t saves_cnt = scanned.size();
+
+  // saves of the previous index that are unchanged
+  std::unordered_map<std::string, uint32_t> previous;
+  if (open(index_path))
+  {
+    for (uint32_t i = 0; i < m_saves.size(); ++i)
+      previous.emplace(m_saves[i].path, i);
+  }
+
+  std::vector<save_terms> terms(saves_cnt);
+  std::vector<char> to_load(saves_cnt, 1);
+  size_t kept_cnt = 0;
+
+  if (!previous.empty())
+  {
+    std::array<std::vector<std::vector<std::pair<uint64_t, uint32_t>>>, columns_cnt> previous_terms;
+    bool previous_ok = true;
+    for (size_t c = 0; c < columns_cnt; ++c)
+    {
+      previous_terms[c].resize(m_saves.size());
+      previous_ok = previous_ok && read_column(c, previous_terms[c]);
+    }
+
+    for (size_t i = 0; previous_ok && i < saves_cnt; ++i)
+    {
+      auto& e = scanned[i].entry;
+      auto it = previous.find(e.path);
+      if (it == previous.end())
+        continue;
+
+      const auto& prev = m_saves[it->second];
+      if (prev.mtime != e.mtime || prev.size != e.size)
+        continue;
+
+      e.ok = prev.ok;
+      for (size_t c = 0; c < columns_cnt; ++c)
+        terms[i][c] = std::move(previous_terms[c][it->second]);
+      to_load[i] = 0;
+      ++kept_cnt;
+    }
+  }
+
+  size_t removed_cnt = previous.size();
+  for (const auto& s : scanned)
+    removed_cnt -= previous.count(s.entry.path);
+
+  close();
+
+  // --------------------------------------------------------
+  //  LOAD NEW AND MODIFIED SAVES
+  // --------------------------------------------------------
+
+  std::vector<size_t> jobs;
+  for (size_t i = 0; i < saves_cnt; ++i)
+  {
+    if (to_load[i])
+      jobs.push_back(i);
+  }
+
+  if (jobs.size())
+  {
+    preload_blueprints();
+  }
+
+  std::atomic<size_t> failed_cnt = 0;
+  span_sink* const sink = current_span_sink();
+  const uint32_t depth = current_span_depth();
+
+  parallel_for(jobs.size(), m_workers_cnt, [&](size_t j)
+  {
+    scoped_span_sink job_sink(sink, depth);
+
+    const size_t i = jobs[j];
+    std::string error;
+    bool ok = false;
+    try
+    {
+      ok = extract_terms(scanned[i].full_path, terms[i], error);
+    }
+    catch (std::exception& e)
+    {
+      error = e.what();
+    }
+
+    scanned[i].entry.ok = ok;
+    if (!ok)
+    {
+      SPDLOG_ERROR("{}: {}", scanned[i].full_path.string(), error);
+      ++failed_cnt;
+    }
+  });
+
+  // --------------------------------------------------------
+  //  COLUMNS
+  // --------------------------------------------------------
+
+  memory_ostream ar;
+  memory_ostream blobs;
+
+  uint32_t magic = index_magic;
+  uint32_t format = index_format;
+  uint32_t saves_cnt32 = static_cast<uint32_t>(saves_cnt);
+  ar << magic << format << saves_cnt32;
+
+  for (auto& s : scanned)
+  {
+    uint8_t ok = s.entry.ok ? 1 : 0;
+    ar.serialize_str_lpfxd(s.entry.path);
+    ar << s.entry.mtime << s.entry.size << ok;
+  }
+
+  uint32_t cols_cnt = static_cast<uint32_t>(columns_cnt);
+  ar << cols_cnt;
+
+  for (size_t c = 0; c < columns_cnt; ++c)
+  {
+    scoped_span col_span("index.build_column");
+
+    struct triple
+    {
+      uint64_t key;
+      uint32_t save;
+      uint32_t value;
+    };
+
+    std::vector<triple> triples;
+    size_t cnt = 0;
+    for (const auto& t : terms)
+      cnt += t[c].size();
+    triples.reserve(cnt);
+
+    // saves are visited in order, the sort keeps it for equal keys
+    for (uint32_t i = 0; i < saves_cnt; ++i)
+    {
+      for (const auto& [key, value] : terms[i][c])
+        triples.push_back(triple{key, i, value});
+      terms[i][c].clear();
+      terms[i][c].shrink_to_fit();
+    }
+
+    std::stable_sort(triples.begin(), triples.end(), [](const triple& a, const triple& b) {
+      return a.key < b.key;
+    });
+
+    column col;
+    uint32_t prev_save = 0;
+    for (const auto& t : triples)
+    {
+      if (col.keys.empty() || col.keys.back() != t.key)
+      {
+        col.keys.push_back(t.key);
+        col.counts.push_back(0);
+        col.offsets.push_back(blobs.size());
+        prev_save = 0;
+      }
+
+      uint32_t delta = t.save - prev_save;
+      uint32_t value = t.value;
+      blobs.serialize_int_packed(delta);
+      blobs.serialize_int_packed(value);
+      prev_save = t.save;
+      ++col.counts.back();
+    }
+
+    uint32_t keys_cnt = static_cast<uint32_t>(col.keys.size());
+    ar << keys_cnt;
+    ar.serialize_pods_array_raw(col.keys.data(), keys_cnt);
+    ar.serialize_pods_array_raw(col.counts.data(), keys_cnt);
+    ar.serialize_pods_array_raw(col.offsets.data(), keys_cnt);
+  }
+
+  uint64_t blobs_size = blobs.size();
+  ar << blobs_size;
+  blobs.write_to(ar);
+
+  if (ar.has_error() || blobs.has_error())
+    return op_status(std::string("couldn't build the index"));
+
+  // --------------------------------------------------------
+  //  WRITE
+  // --------------------------------------------------------
+
+  {
+    auto tmp_path = index_path;
+    tmp_path += ".tmp";
+
+    {
+      const auto data = ar.gather();
+      std::ofstream ofs(tmp_path, std::ios::binary | std::ios::trunc);
+      if (!ofs.is_open())
+        return op_status(fmt::format("couldn't write {}", tmp_path.string()));
+      ofs.write(data.data(), data.size());
+      if (!ofs.good())
+        return op_status(fmt::format("couldn't write {}", tmp_path.string()));
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, index_path, ec);
+    if (ec)
+    {
+      std::filesystem::remove(tmp_path, ec);
+      return op_status(fmt::format("couldn't replace {}", index_path.string()));
+    }
+  }
+
+  if (stats)
+  {
+    stats->saves_cnt = saves_cnt;
+    stats->loaded_cnt = jobs.size();
+    stats->failed_cnt = failed_cnt;
+    stats->removed_cnt = removed_cnt;
+  }
+
+  return open(index_path);
+}
+
+} // namespace cp::csav
+
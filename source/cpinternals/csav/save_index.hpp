@@ -0,0 +1,169 @@
+#pragma once
+#include <inttypes.h>
+#include <array>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cpinternals/common.hpp>
+#include <cpinternals/common/hashing.hpp>
+#include <cpinternals/ctypes.hpp>
+#include <cpinternals/os/file_reader.hpp>
+
+namespace cp::csav {
+
+// Persistent index of a saves directory (every sav.dat below it), to find
+// saves without loading them (e.g. "which saves contain item X").
+// for each save it keeps the TweakDBIDs of its inventory items, its facts
+// (FactsDB) and the stat types of its modifiers (StatsSystem).
+//
+// the index is one file, stored by column (items, facts, stats): each column
+// has a sorted keys directory and a posting list per key, the ascending
+// indices of the saves that have the key along a value (item quantity, fact
+// value, modifiers count). posting lists are delta and packed-int encoded.
+// open() only reads the saves table and the keys directories, the posting
+// list of a key is read from the file when queried.
+//
+// update() only loads the saves that are new or whose mtime or size changed
+// since the last update (in partial mode, only the 3 systems are read), on
+// worker threads. the postings of the other saves are taken from the previous
+// index.
+struct save_index
+{
+  enum class column_e : uint32_t
+  {
+    items, // key: TweakDBID, value: total quantity
+    facts, // key: fact hash, value: fact value
+    stats, // key: stat_key(statType), value: modifiers count
+    count,
+  };
+
+  static constexpr size_t columns_cnt = static_cast<size_t>(column_e::count);
+
+  struct save_entry
+  {
+    std::string path; // relative to the saves dir, generic format
+    int64_t     mtime = 0;
+    uint64_t    size = 0;
+    bool        ok = false; // false if the save couldn't be loaded
+  };
+
+  struct posting
+  {
+    uint32_t save; // index in saves()
+    uint32_t value;
+  };
+
+  struct update_stats
+  {
+    size_t saves_cnt = 0;
+    size_t loaded_cnt = 0; // new or modified saves
+    size_t failed_cnt = 0;
+    size_t removed_cnt = 0;
+  };
+
+  save_index() = default;
+
+  save_index(const save_index&) = delete;
+  save_index& operator=(const save_index&) = delete;
+
+  // reads the saves table and the keys directories of an index file
+  op_status open(const std::filesystem::path& index_path);
+
+  void close();
+
+  bool is_open() const
+  {
+    return m_reader.is_open();
+  }
+
+  // rescans saves_dir and rewrites the index file, then opens it.
+  // the previous index file at index_path (if any) is reused.
+  op_status update(const std::filesystem::path& saves_dir, const std::filesystem::path& index_path, update_stats* stats = nullptr);
+
+  // number of threads loading saves during update.
+  // 0 means one per hardware thread, 1 disables threading.
+  size_t workers_count() const
+  {
+    return m_workers_cnt;
+  }
+
+  void set_workers_count(size_t cnt)
+  {
+    m_workers_cnt = cnt;
+  }
+
+  // sorted by path
+  const std::vector<save_entry>& saves() const
+  {
+    return m_saves;
+  }
+
+  size_t keys_count(column_e col) const
+  {
+    return m_columns[static_cast<size_t>(col)].keys.size();
+  }
+
+  // postings of a key, sorted by save. can be called concurrently.
+  std::vector<posting> postings(column_e col, uint64_t key) const;
+
+  // indices of the saves that have the key
+  std::vector<uint32_t> find(column_e col, uint64_t key) const;
+
+  std::vector<uint32_t> saves_with_item(TweakDBID id) const
+  {
+    return find(column_e::items, id.as_u64);
+  }
+
+  // set_only: only saves in which the fact value isn't 0
+  std::vector<uint32_t> saves_with_fact(uint32_t hash, bool set_only = true) const;
+
+  std::vector<uint32_t> saves_with_fact(std::string_view name, bool set_only = true) const
+  {
+    return saves_with_fact(CFact(name, 0, false).hash(), set_only);
+  }
+
+  std::vector<uint32_t> saves_with_stat(std::string_view stat_type) const
+  {
+    return find(column_e::stats, stat_key(stat_type));
+  }
+
+  static uint64_t stat_key(std::string_view stat_type)
+  {
+    return fnv1a64(stat_type);
+  }
+
+  // sorted saves indices in both a and b
+  static std::vector<uint32_t> intersect(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b);
+
+protected:
+  // key -> value pairs of one save, sorted by key
+  using save_terms = std::array<std::vector<std::pair<uint64_t, uint32_t>>, columns_cnt>;
+
+  struct column
+  {
+    std::vector<uint64_t> keys;    // sorted
+    std::vector<uint32_t> counts;  // postings count of each key
+    std::vector<uint64_t> offsets; // posting list of each key, from m_blobs_pos
+  };
+
+  static bool extract_terms(const std::filesystem::path& path, save_terms& terms, std::string& error);
+
+  // end of the posting lists of a column, from m_blobs_pos
+  uint64_t column_end(size_t c) const;
+
+  // decodes all the postings of a column (used by update)
+  bool read_column(size_t col, std::vector<std::vector<std::pair<uint64_t, uint32_t>>>& terms_by_save) const;
+
+  std::vector<save_entry> m_saves;
+  std::array<column, columns_cnt> m_columns;
+  uint64_t m_blobs_pos = 0;
+  uint64_t m_blobs_size = 0;
+  os::file_reader m_reader;
+
+  size_t m_workers_cnt = 0;
+};
+
+} // namespace cp::csav
+
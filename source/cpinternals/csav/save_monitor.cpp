@@ -0,0 +1,349 @@
+#include "save_monitor.hpp"
+
+#include <algorithm>
+
+#include <cpinternals/csav/save_peek.hpp>
+#include <cpinternals/os/platform_utils.hpp>
+
+namespace cp::csav {
+
+namespace {
+
+std::map<std::filesystem::path, std::pair<int64_t, uint64_t>> list_saves(const std::filesystem::path& dir)
+{
+  namespace fs = std::filesystem;
+  std::map<fs::path, std::pair<int64_t, uint64_t>> ret;
+
+  std::error_code ec;
+  for (auto it = fs::recursive_directory_iterator(dir, ec); it != fs::recursive_directory_iterator(); it.increment(ec))
+  {
+    if (ec)
+      break;
+    if (!it->is_regular_file(ec) || it->path().filename() != "sav.dat")
+      continue;
+
+    const auto mtime = static_cast<int64_t>(it->last_write_time(ec).time_since_epoch().count());
+    const auto size = static_cast<uint64_t>(it->file_size(ec));
+    if (!ec)
+      ret.emplace(it->path(), std::make_pair(mtime, size));
+  }
+
+  return ret;
+}
+
+} // namespace
+
+save_monitor::~save_monitor()
+{
+  stop();
+}
+
+save_monitor::subscription_id save_monitor::subscribe(std::vector<std::string> node_names, callback_type cb)
+{
+  std::lock_guard<std::mutex> lock(m_subs_mtx);
+  const subscription_id id = m_next_id++;
+  m_subs.push_back(subscription{id, std::move(node_names), std::move(cb)});
+  return id;
+}
+
+void save_monitor::unsubscribe(subscription_id id)
+{
+  std::lock_guard<std::mutex> lock(m_subs_mtx);
+  std::erase_if(m_subs, [id](const subscription& s) {
+    return s.id == id;
+  });
+}
+
+std::vector<save_monitor::subscription> save_monitor::subscriptions() const
+{
+  std::lock_guard<std::mutex> lock(m_subs_mtx);
+  return m_subs;
+}
+
+op_status save_monitor::start(const std::filesystem::path& saves_dir, bool report_existing)
+{
+  if (is_running())
+  {
+    return op_status(std::string("already running"));
+  }
+
+  if (!m_watcher.open(saves_dir))
+  {
+    return op_status(fmt::format("couldn't watch {}", saves_dir.string()));
+  }
+
+  m_dir = saves_dir;
+  m_known.clear();
+  m_pending.clear();
+
+  if (!report_existing)
+  {
+    for (const auto& [path, st] : list_saves(m_dir))
+    {
+      m_known.emplace(path, file_state{st.first, st.second});
+    }
+  }
+
+  m_stop = false;
+  m_last_scan = clock::time_point();
+  m_thread = std::thread([this]() { run(); });
+  return {};
+}
+
+void save_monitor::stop()
+{
+  if (!is_running())
+  {
+    return;
+  }
+
+  m_stop = true;
+  m_watcher.wake();
+  m_thread.join();
+  m_watcher.close();
+}
+
+save_monitor::stats save_monitor::get_stats() const
+{
+  std::lock_guard<std::mutex> lock(m_stats_mtx);
+  return m_stats;
+}
+
+void save_monitor::run()
+{
+  if (m_background_mode)
+  {
+    os::set_thread_background_mode(true);
+  }
+
+  // first scan picks the saves changed (or all of them) since start
+  bool rescan = true;
+  clock::duration next_wait = rescan_period;
+
+  while (!m_stop)
+  {
+    if (rescan)
+    {
+      // coalesces a burst of notifications (a save being written) into one scan
+      const auto since_last = clock::now() - m_last_scan;
+      if (since_last < min_scan_interval)
+      {
+        const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(min_scan_interval - since_last);
+        if (m_watcher.wait(static_cast<uint32_t>(ms.count())) == os::watch_result::woken)
+          continue;
+      }
+
+      scan();
+      rescan = false;
+    }
+
+    next_wait = std::min<clock::duration>(process_pending(), rescan_period);
+
+    const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(next_wait).count() + 1;
+    switch (m_watcher.wait(static_cast<uint32_t>(ms)))
+    {
+      case os::watch_result::changed:
+        rescan = true;
+        break;
+      case os::watch_result::timeout:
+        // pending saves are rechecked before being parsed, and the
+        // periodic rescan catches missed notifications
+        rescan = true;
+        break;
+      case os::watch_result::woken:
+        break;
+      case os::watch_result::error:
+        // polling from now on
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        rescan = true;
+        break;
+    }
+  }
+
+  if (m_background_mode)
+  {
+    os::set_thread_background_mode(false);
+  }
+}
+
+void save_monitor::scan()
+{
+  const auto now = clock::now();
+  m_last_scan = now;
+
+  auto found = list_saves(m_dir);
+
+  {
+    std::lock_guard<std::mutex> lock(m_stats_mtx);
+    ++m_stats.scans_cnt;
+  }
+
+  // removed saves
+  std::vector<std::filesystem::path> removed;
+  for (auto it = m_known.begin(); it != m_known.end(); )
+  {
+    if (found.find(it->first) == found.end())
+    {
+      removed.push_back(it->first);
+      it = m_known.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+
+  std::erase_if(m_pending, [&](const auto& kv) {
+    return found.find(kv.first) == found.end();
+  });
+
+  // new and changed saves, their debounce restarts on each change
+  for (const auto& [path, st] : found)
+  {
+    const file_state state{st.first, st.second};
+
+    auto kit = m_known.find(path);
+    if (kit != m_known.end() && kit->second == state)
+    {
+      m_pending.erase(path);
+      continue;
+    }
+
+    auto [pit, inserted] = m_pending.try_emplace(path);
+    if (inserted || !(pit->second.state == state))
+    {
+      pit->second.state = state;
+      pit->second.stable_since = now;
+    }
+  }
+
+  if (removed.empty())
+  {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_stats_mtx);
+    m_stats.removed_cnt += removed.size();
+  }
+
+  const auto subs = subscriptions();
+  for (auto& path : removed)
+  {
+    save_update update;
+    update.path = std::move(path);
+    update.removed = true;
+    for (const auto& sub : subs)
+    {
+      sub.cb(update);
+    }
+  }
+}
+
+save_monitor::clock::duration save_monitor::process_pending()
+{
+  clock::duration next = clock::duration::max();
+
+  for (auto it = m_pending.begin(); it != m_pending.end() && !m_stop; )
+  {
+    auto& ps = it->second;
+
+    const auto stable_for = clock::now() - ps.stable_since;
+    if (stable_for < m_debounce_delay)
+    {
+      next = std::min<clock::duration>(next, m_debounce_delay - stable_for);
+      ++it;
+      continue;
+    }
+
+    if (parse(it->first, ps.state) || ++ps.attempts >= max_parse_attempts)
+    {
+      if (ps.attempts >= max_parse_attempts)
+      {
+        SPDLOG_ERROR("{}: couldn't be parsed, ignored until it changes", it->first.string());
+        std::lock_guard<std::mutex> lock(m_stats_mtx);
+        ++m_stats.failed_cnt;
+      }
+
+      m_known[it->first] = ps.state;
+      it = m_pending.erase(it);
+      continue;
+    }
+
+    // probably still being written, retried after another delay
+    ps.stable_since = clock::now();
+    next = std::min<clock::duration>(next, m_debounce_delay);
+    ++it;
+  }
+
+  return next;
+}
+
+bool save_monitor::parse(const std::filesystem::path& path, const file_state& state)
+{
+  const auto subs = subscriptions();
+
+  save_peek peek;
+  if (!peek.open(path))
+  {
+    return false;
+  }
+
+  // union of the subscribed names, read in file order
+  std::vector<std::pair<int32_t, std::string_view>> descs;
+  for (const auto& sub : subs)
+  {
+    for (const auto& name : sub.node_names)
+    {
+      descs.emplace_back(peek.find_desc(name), name);
+    }
+  }
+
+  std::sort(descs.begin(), descs.end());
+  descs.erase(std::unique(descs.begin(), descs.end()), descs.end());
+
+  std::map<std::string_view, std::shared_ptr<const node_t>> nodes;
+  size_t nodes_read_cnt = 0;
+  for (const auto& [idx, name] : descs)
+  {
+    if (m_stop)
+    {
+      return true;
+    }
+
+    auto& node = nodes[name];
+    if (idx >= 0 && !node)
+    {
+      node = peek.read_node(static_cast<uint32_t>(idx));
+      ++nodes_read_cnt;
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_stats_mtx);
+    ++m_stats.parsed_cnt;
+    m_stats.nodes_read_cnt += nodes_read_cnt;
+    m_stats.chunks_read_size += peek.chunks_read_size();
+    m_stats.decompressed_size += peek.decompressed_size();
+  }
+
+  save_update update;
+  update.path = path;
+  update.mtime = state.mtime;
+  update.size = state.size;
+  update.ver = peek.ver();
+
+  for (const auto& sub : subs)
+  {
+    update.nodes.clear();
+    for (const auto& name : sub.node_names)
+    {
+      update.nodes.push_back(nodes[name]);
+    }
+    sub.cb(update);
+  }
+
+  return true;
+}
+
+} // namespace cp::csav
@@ -0,0 +1,181 @@
+#pragma once
+#include <inttypes.h>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cpinternals/common.hpp>
+#include <cpinternals/csav/node.hpp>
+#include <cpinternals/csav/version.hpp>
+#include <cpinternals/os/dir_watcher.hpp>
+
+namespace cp::csav {
+
+// Watches a saves directory (every sav.dat below it) and hands the new or
+// changed saves to subscribers, each one getting only the nodes (systems) it
+// subscribed to. saves are read with save_peek: header, tables and the chunks
+// of the requested nodes, read in file order so that each chunk is
+// decompressed about once.
+//
+// the game writes a save in several steps: a save is parsed once its size and
+// write time didn't change for the debounce delay, and only if they differ
+// from its last parse. the monitor thread sleeps on directory change
+// notifications (with a slow periodic rescan, notifications can be missed)
+// and runs in background mode (see os::set_thread_background_mode), it
+// doesn't compete with the game for cpu and disk.
+// callbacks are called from the monitor thread.
+//
+//  save_monitor mon;
+//  mon.subscribe({"inventory", "FactsDB"}, [](const save_monitor::save_update& u) { ... });
+//  mon.start(saves_dir);
+struct save_monitor
+{
+  using clock = std::chrono::steady_clock;
+  using subscription_id = uint32_t;
+
+  struct save_update
+  {
+    std::filesystem::path path;
+    int64_t mtime = 0;
+    uint64_t size = 0;
+    bool removed = false; // the save is gone, nodes is empty
+    version ver;
+    // one per subscribed node name (same order), nullptr if the save has none
+    std::vector<std::shared_ptr<const node_t>> nodes;
+  };
+
+  using callback_type = std::function<void(const save_update&)>;
+
+  struct stats
+  {
+    size_t scans_cnt = 0;
+    size_t parsed_cnt = 0;
+    size_t failed_cnt = 0;  // given up after max_parse_attempts
+    size_t removed_cnt = 0;
+    size_t nodes_read_cnt = 0;
+    uint64_t chunks_read_size = 0;
+    uint64_t decompressed_size = 0;
+  };
+
+  static constexpr std::chrono::milliseconds default_debounce_delay{2000};
+  static constexpr std::chrono::milliseconds rescan_period{60000};
+  // notifications closer than that are handled by one scan
+  static constexpr std::chrono::milliseconds min_scan_interval{250};
+  // a save that still can't be parsed once stable is considered broken
+  // (until it changes again)
+  static constexpr uint32_t max_parse_attempts = 3;
+
+  save_monitor() = default;
+  ~save_monitor();
+
+  save_monitor(const save_monitor&) = delete;
+  save_monitor& operator=(const save_monitor&) = delete;
+
+  // node_names are names of top-level systems (e.g. "inventory"), can be
+  // empty to only be told about the saves (path, version).
+  // can be called while running, the saves already parsed aren't replayed.
+  subscription_id subscribe(std::vector<std::string> node_names, callback_type cb);
+
+  // the callback may still be running when this returns, if called from
+  // another thread than the monitor's
+  void unsubscribe(subscription_id id);
+
+  // the saves already present are only reported if report_existing is set
+  op_status start(const std::filesystem::path& saves_dir, bool report_existing = false);
+
+  void stop();
+
+  bool is_running() const
+  {
+    return m_thread.joinable();
+  }
+
+  std::chrono::milliseconds debounce_delay() const
+  {
+    return m_debounce_delay;
+  }
+
+  // to set before start
+  void set_debounce_delay(std::chrono::milliseconds delay)
+  {
+    m_debounce_delay = delay;
+  }
+
+  bool background_mode() const
+  {
+    return m_background_mode;
+  }
+
+  // to set before start (on by default)
+  void set_background_mode(bool enabled)
+  {
+    m_background_mode = enabled;
+  }
+
+  stats get_stats() const;
+
+protected:
+  struct file_state
+  {
+    int64_t mtime = 0;
+    uint64_t size = 0;
+
+    bool operator==(const file_state&) const = default;
+  };
+
+  struct pending_save
+  {
+    file_state state;
+    clock::time_point stable_since;
+    uint32_t attempts = 0;
+  };
+
+  struct subscription
+  {
+    subscription_id id = 0;
+    std::vector<std::string> node_names;
+    callback_type cb;
+  };
+
+  void run();
+
+  // lists the saves, updates m_pending and reports the removed ones
+  void scan();
+
+  // parses the pending saves that are stable, returns the time until the
+  // next one is
+  clock::duration process_pending();
+
+  // false if the save couldn't be opened
+  bool parse(const std::filesystem::path& path, const file_state& state);
+
+  std::vector<subscription> subscriptions() const;
+
+  std::filesystem::path m_dir;
+  os::dir_watcher m_watcher;
+  std::thread m_thread;
+  std::atomic<bool> m_stop = false;
+  std::chrono::milliseconds m_debounce_delay = default_debounce_delay;
+  bool m_background_mode = true;
+
+  mutable std::mutex m_subs_mtx;
+  std::vector<subscription> m_subs;
+  subscription_id m_next_id = 1;
+
+  // monitor thread only
+  std::map<std::filesystem::path, file_state> m_known; // last parsed state
+  std::map<std::filesystem::path, pending_save> m_pending;
+  clock::time_point m_last_scan;
+
+  mutable std::mutex m_stats_mtx;
+  stats m_stats;
+};
+
+} // namespace cp::csav
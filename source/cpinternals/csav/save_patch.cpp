@@ -0,0 +1,370 @@
+#include "save_patch.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <unordered_set>
+#include <nlohmann/json.hpp>
+#include <cpinternals/common/parallel.hpp>
+#include <cpinternals/common/instrumentation.hpp>
+#include <cpinternals/init.hpp>
+#include <cpinternals/csav/savegame.hpp>
+
+namespace cp::csav {
+
+namespace {
+
+bool parse_hex_bytes(std::string_view s, std::vector<char>& out)
+{
+  out.clear();
+  int hi = -1;
+  for (char c : s)
+  {
+    int v = -1;
+    if (c >= '0' && c <= '9')
+      v = c - '0';
+    else if (c >= 'a' && c <= 'f')
+      v = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+      v = c - 'A' + 10;
+    else if (c == ' ')
+      continue;
+    else
+      return false;
+
+    if (hi < 0)
+      hi = v;
+    else
+    {
+      out.push_back(static_cast<char>((hi << 4) | v));
+      hi = -1;
+    }
+  }
+  return hi < 0 && !out.empty();
+}
+
+std::vector<std::string> split_path(std::string_view path)
+{
+  std::vector<std::string> ret;
+  size_t start = 0;
+  while (start <= path.size())
+  {
+    size_t end = path.find('/', start);
+    if (end == std::string_view::npos)
+      end = path.size();
+    if (end > start)
+      ret.emplace_back(path.substr(start, end - start));
+    start = end + 1;
+  }
+  return ret;
+}
+
+} // namespace
+
+op_status save_patch::parse(std::string_view json)
+{
+  edits.clear();
+
+  auto jroot = nlohmann::json::parse(json.begin(), json.end(), nullptr, false);
+  if (jroot.is_discarded() || !jroot.is_object() || !jroot.contains("edits") || !jroot["edits"].is_array())
+    return op_status(std::string("a patch is an object with an \"edits\" array"));
+
+  try
+  {
+    const auto& jedits = jroot["edits"];
+    for (size_t i = 0; i < jedits.size(); ++i)
+    {
+      const auto& jedit = jedits[i];
+      const std::string op = jedit.at("op").get<std::string>();
+
+      // names are hashed here, the resolvers aren't thread-safe
+      edit& e = edits.emplace_back();
+      if (op == "set_fact")
+      {
+        e.op = op_e::set_fact;
+        e.name = jedit.at("fact").get<std::string>();
+        e.fact_hash = CFact(e.name, 0, false).hash();
+        e.u32_value = jedit.at("value").get<uint32_t>();
+      }
+      else if (op == "remove_item" || op == "set_item_quantity")
+      {
+        e.op = (op == "remove_item") ? op_e::remove_item : op_e::set_item_quantity;
+        e.name = jedit.at("item").get<std::string>();
+        e.item = TweakDBID(e.name, false);
+        e.has_item = true;
+        if (e.op == op_e::set_item_quantity)
+          e.u32_value = jedit.at("quantity").get<uint32_t>();
+      }
+      else if (op == "set_stat")
+      {
+        e.op = op_e::set_stat;
+        e.name = jedit.at("stat").get<std::string>();
+        e.float_value = jedit.at("value").get<float>();
+        if (jedit.contains("item"))
+        {
+          e.item = TweakDBID(jedit["item"].get<std::string>(), false);
+          e.has_item = true;
+        }
+        if (jedit.contains("modifier_type"))
+          e.modifier_type = jedit["modifier_type"].get<std::string>();
+      }
+      else if (op == "patch_node")
+      {
+        e.op = op_e::patch_node;
+        e.name = jedit.at("path").get<std::string>();
+        e.path = split_path(e.name);
+        e.offset = jedit.at("offset").get<uint32_t>();
+        if (e.path.empty())
+          return op_status(fmt::format("edit {}: empty node path", i));
+        if (!parse_hex_bytes(jedit.at("bytes").get<std::string>(), e.bytes))
+          return op_status(fmt::format("edit {}: invalid hex bytes", i));
+      }
+      else
+      {
+        return op_status(fmt::format("edit {}: unknown op \"{}\"", i, op));
+      }
+    }
+  }
+  catch (nlohmann::json::exception& ex)
+  {
+    return op_status(fmt::format("invalid patch: {}", ex.what()));
+  }
+
+  // the system would be written over the patched bytes on save
+  const auto names = systems();
+  for (const auto& e : edits)
+  {
+    if (e.op == op_e::patch_node && std::find(names.begin(), names.end(), e.path[0]) != names.end())
+      return op_status(fmt::format("node patch of {} that is also edited as a system", e.path[0]));
+  }
+
+  return {};
+}
+
+op_status save_patch::load(const std::filesystem::path& path)
+{
+  std::ifstream ifs(path, std::ios::binary);
+  if (!ifs.is_open())
+    return op_status(fmt::format("couldn't open {}", path.string()));
+
+  std::stringstream ss;
+  ss << ifs.rdbuf();
+  return parse(ss.str());
+}
+
+std::vector<std::string_view> save_patch::systems() const
+{
+  bool facts = false, inventory = false, stats = false;
+  for (const auto& e : edits)
+  {
+    switch (e.op)
+    {
+      case op_e::set_fact:
+        facts = true;
+        break;
+      case op_e::remove_item:
+      case op_e::set_item_quantity:
+        inventory = true;
+        break;
+      case op_e::set_stat:
+        stats = true;
+        inventory |= e.has_item;
+        break;
+      default:
+        break;
+    }
+  }
+
+  std::vector<std::string_view> ret;
+  if (inventory)
+    ret.emplace_back("inventory");
+  if (facts)
+    ret.emplace_back("FactsDB");
+  if (stats)
+    ret.emplace_back("StatsSystem");
+  return ret;
+}
+
+op_status save_patch::apply(savegame& save, size_t& changes_cnt) const
+{
+  changes_cnt = 0;
+
+  for (const auto& e : edits)
+  {
+    switch (e.op)
+    {
+      case op_e::set_fact:
+      {
+        if (save.factsdb.get_fact(e.fact_hash) == e.u32_value)
+          break;
+        if (!save.factsdb.set_fact(e.fact_hash, e.u32_value))
+          return op_status(fmt::format("couldn't set fact {}", e.name));
+        ++changes_cnt;
+        break;
+      }
+
+      case op_e::remove_item:
+        changes_cnt += save.inventory.remove_items(e.item);
+        break;
+
+      case op_e::set_item_quantity:
+      {
+        save.inventory.for_each_item(e.item, [&](CItemData& item) {
+          if (item.iid.uk.kind() != 2 && item.quantity != e.u32_value)
+          {
+            item.quantity = e.u32_value;
+            ++changes_cnt;
+          }
+        });
+        break;
+      }
+
+      case op_e::set_stat:
+      {
+        std::unordered_set<uint32_t> seeds;
+        if (e.has_item)
+        {
+          save.inventory.for_each_item(e.item, [&](const CItemData& item) {
+            seeds.insert(item.iid.uk.uk4);
+          });
+          if (seeds.empty())
+            break;
+        }
+
+        CStatsView view = save.stats.view();
+        for (size_t i = 0; i < view.size(); ++i)
+        {
+          if (view.stat_types[i].strv() != e.name)
+            continue;
+          if (!e.modifier_type.empty() && view.modifier_types[i].strv() != e.modifier_type)
+            continue;
+          if (e.has_item && seeds.find(view.seeds[i]) == seeds.end())
+            continue;
+          view.values[i] = e.float_value;
+        }
+
+        size_t modified_cnt = 0;
+        if (!save.stats.apply_view(view, &modified_cnt))
+          return op_status(std::string("couldn't edit the stats"));
+        changes_cnt += modified_cnt;
+        break;
+      }
+
+      case op_e::patch_node:
+      {
+        auto node = save.search_node(e.path[0]);
+        for (size_t i = 1; node && i < e.path.size(); ++i)
+        {
+          std::shared_ptr<const node_t> child;
+          for (const auto& c : node->children())
+          {
+            if (c->is_cnode() && c->name() == e.path[i])
+            {
+              child = c;
+              break;
+            }
+          }
+          node = child;
+        }
+
+        if (!node)
+          return op_status(fmt::format("node {} not found", e.name));
+
+        if ((uint64_t)e.offset + e.bytes.size() > node->data().size())
+          return op_status(fmt::format("node patch out of the data of {}", e.name));
+
+        if (std::equal(e.bytes.begin(), e.bytes.end(), node->data().begin() + e.offset))
+          break;
+
+        node->nonconst().edit_data([&](std::vector<char>& data) {
+          std::copy(e.bytes.begin(), e.bytes.end(), data.begin() + e.offset);
+        });
+        ++changes_cnt;
+        break;
+      }
+    }
+  }
+
+  return {};
+}
+
+save_patch::result save_patch::apply_to_file(const std::filesystem::path& in_path, const std::filesystem::path& out_path) const
+{
+  scoped_span span("patch.file");
+
+  result res;
+
+  savegame save;
+  save.interactive = false;
+  // parallelism is at the file level
+  save.tree.set_workers_count(1);
+  save.systems_workers_count = 1;
+  // unchanged chunks are copied on save
+  save.tree.set_incremental_save(true);
+
+  res.status = save.open_lazy(in_path);
+  if (!res.status)
+    return res;
+
+  for (const auto& name : systems())
+  {
+    if (!save.load_system(name))
+    {
+      res.status = op_status(fmt::format("couldn't load {}", name));
+      return res;
+    }
+  }
+
+  {
+    scoped_span apply_span("patch.apply");
+    res.status = apply(save, res.changes_cnt);
+  }
+  if (!res.status)
+    return res;
+
+  const bool in_place = out_path.empty();
+  if (in_place && res.changes_cnt == 0)
+    return res;
+
+  progress_t progress;
+  res.status = save.save_with_progress(in_place ? in_path : out_path, progress, false, save.tree.ver().ps4w);
+  res.saved = static_cast<bool>(res.status);
+  return res;
+}
+
+std::vector<save_patch::result> save_patch::apply_to_files(const std::vector<std::filesystem::path>& in_paths,
+  const std::vector<std::filesystem::path>& out_paths, size_t workers_cnt) const
+{
+  scoped_span span("patch.files");
+
+  std::vector<result> results(in_paths.size());
+  if (!out_paths.empty() && out_paths.size() != in_paths.size())
+  {
+    for (auto& res : results)
+      res.status = op_status(std::string("out_paths must be parallel to in_paths"));
+    return results;
+  }
+
+  preload_blueprints();
+
+  span_sink* const sink = current_span_sink();
+  const uint32_t depth = current_span_depth();
+
+  parallel_for(in_paths.size(), workers_cnt, [&](size_t i)
+  {
+    scoped_span_sink job_sink(sink, depth);
+
+    try
+    {
+      results[i] = apply_to_file(in_paths[i], out_paths.empty() ? std::filesystem::path() : out_paths[i]);
+    }
+    catch (std::exception& e)
+    {
+      results[i].status = op_status(fmt::format("exception: {}", e.what()));
+    }
+  });
+
+  return results;
+}
+
+} // namespace cp::csav
+
@@ -0,0 +1,92 @@
+#pragma once
+#include <inttypes.h>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cpinternals/common.hpp>
+#include <cpinternals/ctypes.hpp>
+
+namespace cp::csav {
+
+struct savegame;
+
+// Declarative edits applied to many saves (e.g. the same fix for every
+// save of a player).
+// a patch is a JSON document:
+//   {"edits": [
+//     {"op": "set_fact", "fact": "q001_done", "value": 1},
+//     {"op": "remove_item", "item": "Items.Preset_Ajax_Default"},
+//     {"op": "set_item_quantity", "item": "Items.money", "quantity": 10000},
+//     {"op": "set_stat", "stat": "Armor", "value": 50.0,
+//        "item": "Items.X", "modifier_type": "Additive"},
+//     {"op": "patch_node", "path": "PlayerDevelopmentData/...", "offset": 16, "bytes": "01 00 00 00"}
+//   ]}
+// set_stat sets the value of the modifiers of that statType, "item" (only
+// the modifiers of the seeds of these items) and "modifier_type" are
+// optional filters.
+// patch_node overwrites bytes of the data of a node given by its name path,
+// from a top-level node. it can't target a system edited by the same patch.
+//
+// a save is opened lazily and only the systems the edits need are loaded.
+// it is saved with the incremental chunk writer: the chunks whose bytes
+// didn't change are copied instead of being recompressed.
+struct save_patch
+{
+  enum class op_e
+  {
+    set_fact,
+    remove_item,
+    set_item_quantity,
+    set_stat,
+    patch_node,
+  };
+
+  struct edit
+  {
+    op_e op = op_e::set_fact;
+    std::string name;           // fact, item, stat or node path
+    uint32_t fact_hash = 0;
+    TweakDBID item;             // item ops, set_stat filter
+    bool has_item = false;
+    std::string modifier_type;  // set_stat filter
+    uint32_t u32_value = 0;     // fact value, quantity
+    float float_value = 0.f;    // stat value
+    std::vector<std::string> path;
+    uint32_t offset = 0;
+    std::vector<char> bytes;
+  };
+
+  struct result
+  {
+    op_status status;
+    size_t changes_cnt = 0; // edited facts, items, modifiers and nodes
+    bool saved = false;
+  };
+
+  std::vector<edit> edits;
+
+  op_status parse(std::string_view json);
+  op_status load(const std::filesystem::path& path);
+
+  // node names of the systems the edits need, in load order
+  std::vector<std::string_view> systems() const;
+
+  // applies the edits to a savegame whose systems() are loaded
+  op_status apply(savegame& save, size_t& changes_cnt) const;
+
+  // opens in_path, applies the edits and saves to out_path (in place, with a
+  // .old backup, if out_path is empty). a save that isn't changed isn't
+  // rewritten in place.
+  result apply_to_file(const std::filesystem::path& in_path, const std::filesystem::path& out_path = {}) const;
+
+  // same for many saves, concurrently (one save per task).
+  // out_paths is empty (in place) or parallel to in_paths.
+  // 0 means one worker per hardware thread, 1 disables threading.
+  std::vector<result> apply_to_files(const std::vector<std::filesystem::path>& in_paths,
+    const std::vector<std::filesystem::path>& out_paths, size_t workers_cnt = 0) const;
+};
+
+} // namespace cp::csav
+
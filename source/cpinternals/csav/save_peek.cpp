@@ -0,0 +1,307 @@
+#include "save_peek.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <xlz4/lz4.h>
+#include <cpinternals/common/instrumentation.hpp>
+#include <cpinternals/io/memory_istream.hpp>
+
+namespace cp::csav {
+
+op_status save_peek::open(const std::filesystem::path& path)
+{
+  scoped_span span("csav.peek.open");
+
+  close();
+
+  if (!m_reader.open(path))
+    return op_status(fmt::format("couldn't open {}", path.string()));
+
+  op_status status = read_tables();
+  if (!status)
+    close();
+
+  return status;
+}
+
+void save_peek::close()
+{
+  if (m_reader.is_open())
+    m_reader.close();
+
+  m_ver = {};
+  m_stree.descs.clear();
+  m_chunk_descs.clear();
+  m_nodedata_start = 0;
+  m_nodedata_end = 0;
+  m_cache.clear();
+  m_chunks_read_size = 0;
+  m_decompressed_size = 0;
+  m_cache_hits = 0;
+}
+
+// same checks as node_tree::read_serial_tree, without reading the chunks
+op_status save_peek::read_tables()
+{
+  const size_t file_size = m_reader.size();
+  if (file_size < 8)
+    return op_status(std::string("file is too small"));
+
+  // --------------------------------------------------------
+  //  HEADER (magic, m_ver..)
+  // --------------------------------------------------------
+
+  // the version string is short, the header fits in the first page
+  std::vector<char> head(std::min<size_t>(file_size, 0x1000));
+  if (!m_reader.read_at(0, head))
+    return op_status(std::string("couldn't read the header"));
+
+  memory_istream ms(head);
+
+  uint32_t magic = 0;
+  ms << magic;
+  if (magic != 'CSAV' && magic != 'SAVE')
+    return op_status(std::string("csav file has wrong magic"));
+
+  ms << m_ver.v1 << m_ver.v2;
+  ms.serialize_str_lpfxd(m_ver.suk);
+  ms << m_ver.uk0 << m_ver.uk1;
+
+  if (m_ver.v1 <= 168 and m_ver.v2 == 4)
+    return op_status(std::string("unsuppported csav m_ver.v1/v2"));
+
+  m_ver.v3 = 192;
+  if (m_ver.v1 >= 83)
+  {
+    ms << m_ver.v3;
+    if (m_ver.v3 > 195)
+      return op_status(std::string("unsuppported csav m_ver.v3"));
+  }
+
+  if (ms.has_error())
+    return op_status(std::string("couldn't read the header"));
+
+  const uint64_t chunkdescs_start = static_cast<uint64_t>(ms.tell());
+
+  // --------------------------------------------------------
+  //  FOOTER (offset of 'NODE', 'DONE' tag)
+  // --------------------------------------------------------
+
+  const uint64_t footer_start = file_size - 8;
+
+  uint32_t footer[2] = {};
+  if (!m_reader.read_at(footer_start, std::span<char>(reinterpret_cast<char*>(footer), 8)) || footer[1] != 'DONE')
+    return op_status(std::string("missing 'DONE' tag"));
+
+  const uint64_t nodedescs_start = footer[0];
+  if (nodedescs_start + 4 > footer_start)
+    return op_status(std::string("unexpected footer position"));
+
+  // --------------------------------------------------------
+  //  NODE DESCRIPTORS
+  // --------------------------------------------------------
+
+  std::vector<char> nodedescs(footer_start - nodedescs_start);
+  if (!m_reader.read_at(nodedescs_start, nodedescs))
+    return op_status(std::string("couldn't read the node descriptors"));
+
+  std::memcpy(&magic, nodedescs.data(), 4);
+  if (magic != 'NODE')
+    return op_status(std::string("missing 'NODE' tag"));
+
+  if (!m_stree.decode_descs(std::span<const char>(nodedescs).subspan(4)))
+    return op_status(std::string("invalid node descriptors table"));
+
+  // --------------------------------------------------------
+  //  COMPRESSED CHUNKS DESCRIPTORS
+  // --------------------------------------------------------
+
+  uint32_t clzf[2] = {};
+  if (chunkdescs_start + 8 > footer_start
+    || !m_reader.read_at(chunkdescs_start, std::span<char>(reinterpret_cast<char*>(clzf), 8))
+    || clzf[0] != 'CLZF')
+  {
+    return op_status(std::string("missing 'CLZF' tag"));
+  }
+
+  const uint32_t cd_cnt = clzf[1];
+  if (cd_cnt > (footer_start - chunkdescs_start - 8) / 12)
+    return op_status(std::string("invalid chunk descriptors count"));
+
+  // laid out as 3 dwords
+  std::vector<uint32_t> chunk_descs_raw(cd_cnt * 3);
+  if (!m_reader.read_at(chunkdescs_start + 8, std::span<char>(reinterpret_cast<char*>(chunk_descs_raw.data()), chunk_descs_raw.size() * 4)))
+    return op_status(std::string("couldn't read the chunk descriptors"));
+
+  m_chunk_descs.resize(cd_cnt);
+  for (uint32_t i = 0; i < cd_cnt; ++i)
+  {
+    auto& cd = m_chunk_descs[i];
+    cd.offset = chunk_descs_raw[i * 3];
+    cd.size = chunk_descs_raw[i * 3 + 1];
+    cd.data_size = chunk_descs_raw[i * 3 + 2];
+  }
+
+  std::sort(m_chunk_descs.begin(), m_chunk_descs.end(),
+    [](auto& a, auto& b){ return a.offset < b.offset; });
+
+  if (m_chunk_descs.empty())
+    return {};
+
+  // nodedata starts at the first chunk's offset (see read_serial_tree)
+  m_nodedata_start = m_chunk_descs[0].offset;
+  uint64_t data_offset = m_nodedata_start;
+  for (auto& cd : m_chunk_descs)
+  {
+    cd.data_offset = static_cast<uint32_t>(data_offset);
+    data_offset += cd.data_size;
+  }
+  m_nodedata_end = data_offset;
+
+  uint32_t chunk_magic = 0;
+  if (!m_reader.read_at(m_chunk_descs[0].offset, std::span<char>(reinterpret_cast<char*>(&chunk_magic), 4)))
+    return op_status(std::string("couldn't read the first chunk"));
+  m_ver.ps4w = (chunk_magic != 'XLZ4');
+
+  if (m_ver.ps4w)
+  {
+    // uncompressed, file offsets match nodedata's ones
+    if (m_nodedata_end > footer_start)
+      return op_status(std::string("uncompressed chunks overlap the footer"));
+  }
+  else
+  {
+    for (const auto& cd : m_chunk_descs)
+    {
+      if (cd.size < 8)
+        return op_status(std::string("compressed chunk is too small"));
+      if (static_cast<uint64_t>(cd.offset) + cd.size > footer_start)
+        return op_status(std::string("compressed chunks overlap the footer"));
+    }
+  }
+
+  return {};
+}
+
+int32_t save_peek::find_desc(std::string_view name) const
+{
+  const auto& descs = m_stree.descs;
+  for (size_t i = 0; i < descs.size(); ++i)
+  {
+    if (descs[i].name == name)
+      return static_cast<int32_t>(i);
+  }
+  return -1;
+}
+
+bool save_peek::read_range(uint32_t offset, std::span<char> dst)
+{
+  const uint64_t begin = offset;
+  const uint64_t end = begin + dst.size();
+  if (!is_open() || begin < m_nodedata_start || end > m_nodedata_end)
+    return false;
+
+  if (dst.empty())
+    return true;
+
+  if (m_ver.ps4w)
+  {
+    m_chunks_read_size += dst.size();
+    return m_reader.read_at(offset, dst);
+  }
+
+  // first chunk that ends after begin
+  auto it = std::upper_bound(m_chunk_descs.begin(), m_chunk_descs.end(), begin,
+    [](uint64_t pos, const chunk_desc& cd){ return pos < static_cast<uint64_t>(cd.data_offset) + cd.data_size; });
+
+  for (; it != m_chunk_descs.end() && it->data_offset < end; ++it)
+  {
+    const auto& cd = *it;
+
+    // decompression can stop at the end of the range
+    const uint64_t chunk_begin = cd.data_offset;
+    const uint32_t prefix_size = static_cast<uint32_t>(std::min<uint64_t>(end, chunk_begin + cd.data_size) - chunk_begin);
+    if (prefix_size == 0)
+      continue;
+
+    const char* data = decode_chunk(static_cast<size_t>(it - m_chunk_descs.begin()), prefix_size);
+    if (!data)
+      return false;
+
+    const uint64_t copy_begin = std::max(begin, chunk_begin);
+    std::memcpy(dst.data() + (copy_begin - begin), data + (copy_begin - chunk_begin),
+      static_cast<size_t>(chunk_begin + prefix_size - copy_begin));
+  }
+
+  return true;
+}
+
+const char* save_peek::decode_chunk(size_t chunk_idx, uint32_t prefix_size)
+{
+  auto it = std::find_if(m_cache.begin(), m_cache.end(),
+    [chunk_idx](const cached_chunk& c){ return c.chunk_idx == chunk_idx; });
+
+  if (it == m_cache.end())
+  {
+    // the least recently used one is evicted
+    if (m_cache.size() < std::max<size_t>(m_cache_size, 1))
+      it = m_cache.emplace(m_cache.end());
+    else
+      it = std::min_element(m_cache.begin(), m_cache.end(),
+        [](const cached_chunk& a, const cached_chunk& b){ return a.last_use < b.last_use; });
+
+    it->chunk_idx = chunk_idx;
+    it->decoded_size = 0;
+  }
+
+  it->last_use = ++m_use_cnt;
+
+  if (it->decoded_size >= prefix_size)
+  {
+    ++m_cache_hits;
+    return it->data.data();
+  }
+
+  const auto& cd = m_chunk_descs[chunk_idx];
+
+  m_cbuf.resize(cd.size);
+  if (!m_reader.read_at(cd.offset, m_cbuf))
+    return nullptr;
+  m_chunks_read_size += cd.size;
+
+  uint32_t chunk_magic = 0, data_size = 0;
+  std::memcpy(&chunk_magic, m_cbuf.data(), 4);
+  std::memcpy(&data_size, m_cbuf.data() + 4, 4);
+  if (chunk_magic != 'XLZ4' || data_size != cd.data_size)
+    return nullptr;
+
+  it->data.resize(cd.data_size);
+  const int res = LZ4_decompress_safe_partial(m_cbuf.data() + 8, it->data.data(),
+    static_cast<int>(cd.size - 8), static_cast<int>(prefix_size), static_cast<int>(cd.data_size));
+  if (res < static_cast<int>(prefix_size))
+    return nullptr;
+
+  it->decoded_size = static_cast<uint32_t>(res);
+  m_decompressed_size += res;
+  return it->data.data();
+}
+
+std::shared_ptr<const node_t> save_peek::read_node(uint32_t idx)
+{
+  if (idx >= m_stree.descs.size())
+    return nullptr;
+
+  const auto& desc = m_stree.descs[idx];
+
+  scoped_span span("csav.peek.read_node", desc.name);
+  span.set_bytes(desc.data_size);
+
+  std::vector<char> src(desc.data_size);
+  if (!read_range(desc.data_offset, src))
+    return nullptr;
+
+  return m_stree.lift_node(idx, src, desc.data_offset);
+}
+
+} // namespace cp::csav
+
@@ -0,0 +1,148 @@
+#pragma once
+#include <inttypes.h>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include <cpinternals/common.hpp>
+#include <cpinternals/csav/node.hpp>
+#include <cpinternals/csav/version.hpp>
+#include <cpinternals/csav/serial_tree.hpp>
+#include <cpinternals/os/file_reader.hpp>
+
+namespace cp::csav {
+
+// Fast peek into a save file (e.g. to fill a save picker), without loading
+// its tree.
+// open() only reads the header (version), the chunk descriptors, the footer
+// and the node descriptors table: a few small reads whatever the size of the
+// save. read_node() then lifts a single node (and its subtree): the chunks
+// overlapping its range of nodedata are the only ones read and decompressed,
+// and decompression of the last one stops at the end of the range.
+// the last used chunks are kept decompressed, nodes read in file order
+// decompress each chunk about once.
+//
+//  save_peek peek;
+//  if (peek.open(path))
+//    auto node = peek.read_node("PlayerDevelopmentData");
+struct save_peek
+{
+  save_peek() = default;
+
+  save_peek(const save_peek&) = delete;
+  save_peek& operator=(const save_peek&) = delete;
+
+  op_status open(const std::filesystem::path& path);
+
+  void close();
+
+  bool is_open() const
+  {
+    return m_reader.is_open();
+  }
+
+  const version& ver() const
+  {
+    return m_ver;
+  }
+
+  // node descriptors, in depth-first order
+  const std::vector<serial_node_desc>& descs() const
+  {
+    return m_stree.descs;
+  }
+
+  // size of the decompressed nodedata (starting at the first chunk's offset)
+  uint64_t nodedata_size() const
+  {
+    return m_nodedata_end - m_nodedata_start;
+  }
+
+  // index of the first descriptor with that name, -1 if there is none
+  int32_t find_desc(std::string_view name) const;
+
+  // nullptr if the node doesn't exist or couldn't be read.
+  // can't be called concurrently.
+  std::shared_ptr<const node_t> read_node(uint32_t idx);
+
+  std::shared_ptr<const node_t> read_node(std::string_view name)
+  {
+    const int32_t idx = find_desc(name);
+    return idx < 0 ? nullptr : read_node(static_cast<uint32_t>(idx));
+  }
+
+  // copies nodedata [offset, offset + dst.size()) into dst
+  bool read_range(uint32_t offset, std::span<char> dst);
+
+  // number of decompressed chunks kept between reads (at least 1)
+  size_t chunk_cache_size() const
+  {
+    return m_cache_size;
+  }
+
+  void set_chunk_cache_size(size_t cnt)
+  {
+    m_cache_size = cnt;
+    m_cache.clear();
+  }
+
+  // bytes read from chunks and produced by decompression since open,
+  // to compare with a full load
+  uint64_t chunks_read_size() const
+  {
+    return m_chunks_read_size;
+  }
+
+  uint64_t decompressed_size() const
+  {
+    return m_decompressed_size;
+  }
+
+  size_t chunk_cache_hits() const
+  {
+    return m_cache_hits;
+  }
+
+protected:
+  struct chunk_desc
+  {
+    // data_size is uncompressed size
+    uint32_t offset, size, data_size, data_offset;
+  };
+
+  struct cached_chunk
+  {
+    size_t chunk_idx = 0;
+    uint64_t last_use = 0;
+    uint32_t decoded_size = 0; // decompressed prefix of data
+    std::vector<char> data;
+  };
+
+  // header, footer, node descriptors and chunk descriptors
+  op_status read_tables();
+
+  // decompressed chunk, at least its first prefix_size bytes are valid.
+  // nullptr if the chunk couldn't be read.
+  const char* decode_chunk(size_t chunk_idx, uint32_t prefix_size);
+
+  version m_ver;
+  serial_tree m_stree;
+  std::vector<chunk_desc> m_chunk_descs; // sorted by offset
+  uint64_t m_nodedata_start = 0;
+  uint64_t m_nodedata_end = 0;
+  os::file_reader m_reader;
+
+  std::vector<char> m_cbuf;
+  std::vector<cached_chunk> m_cache;
+  size_t m_cache_size = 4;
+  uint64_t m_use_cnt = 0;
+
+  uint64_t m_chunks_read_size = 0;
+  uint64_t m_decompressed_size = 0;
+  size_t m_cache_hits = 0;
+};
+
+} // namespace cp::csav
+
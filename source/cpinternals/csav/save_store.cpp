@@ -0,0 +1,441 @@
+#include "save_store.hpp"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <xlz4/lz4.h>
+#include <cpinternals/common/hashing.hpp>
+#include <cpinternals/common/parallel.hpp>
+#include <cpinternals/common/instrumentation.hpp>
+#include <cpinternals/io/memory_istream.hpp>
+#include <cpinternals/io/memory_ostream.hpp>
+#include <cpinternals/csav/serial_tree.hpp>
+
+namespace cp::csav {
+
+namespace {
+
+constexpr uint32_t manifest_magic = 'CSTM';
+constexpr uint32_t manifest_format = 1;
+
+// gear table of the rolling hash, fixed so that cuts are stable across runs
+constexpr std::array<uint64_t, 256> make_gear_table()
+{
+  std::array<uint64_t, 256> table = {};
+  uint64_t x = 0x5851F42D4C957F2D;
+  for (auto& v : table)
+  {
+    // splitmix64
+    x += 0x9E3779B97F4A7C15;
+    uint64_t z = x;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+    v = z ^ (z >> 31);
+  }
+  return table;
+}
+
+constexpr auto gear_table = make_gear_table();
+
+// the high bits of the gear hash depend on the last 64 bytes
+constexpr uint64_t gear_cut_mask = uint64_t(save_store::avg_chunk_size - 1)
+  << (64 - (std::bit_width(save_store::avg_chunk_size) - 1));
+
+bool write_file_atomic(const std::filesystem::path& path, std::span<const char> data)
+{
+  static std::atomic<uint32_t> tmp_cnt = 0;
+
+  auto tmp_path = path;
+  tmp_path += fmt::format(".tmp{}", tmp_cnt++);
+
+  {
+    std::ofstream ofs(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open())
+      return false;
+    ofs.write(data.data(), data.size());
+    if (!ofs.good())
+      return false;
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tmp_path, path, ec);
+  if (ec)
+  {
+    std::filesystem::remove(tmp_path, ec);
+    // written concurrently by another put
+    return std::filesystem::exists(path, ec);
+  }
+  return true;
+}
+
+bool read_file(const std::filesystem::path& path, std::vector<char>& out)
+{
+  std::ifstream ifs(path, std::ios::binary | std::ios::ate);
+  if (!ifs.is_open())
+    return false;
+  const auto size = static_cast<size_t>(ifs.tellg());
+  out.resize(size);
+  ifs.seekg(0);
+  ifs.read(out.data(), size);
+  return ifs.good();
+}
+
+} // namespace
+
+std::vector<size_t> save_store::cut_points(std::span<const char> data, const std::vector<size_t>& forced_cuts)
+{
+  std::vector<size_t> cuts;
+  cuts.reserve(data.size() / avg_chunk_size + forced_cuts.size() + 1);
+
+  size_t forced_idx = 0;
+  size_t start = 0;
+  while (start < data.size())
+  {
+    cuts.push_back(start);
+
+    while (forced_idx < forced_cuts.size() && forced_cuts[forced_idx] <= start)
+      ++forced_idx;
+
+    size_t limit = std::min(data.size(), start + max_chunk_size);
+    if (forced_idx < forced_cuts.size())
+      limit = std::min(limit, forced_cuts[forced_idx]);
+
+    // no cut before min_chunk_size, the hash only needs its last 64 bytes
+    size_t end = limit;
+    if (start + min_chunk_size < limit)
+    {
+      uint64_t h = 0;
+      for (size_t i = start + min_chunk_size - 64; i < limit; ++i)
+      {
+        h = (h << 1) + gear_table[static_cast<uint8_t>(data[i])];
+        if ((h & gear_cut_mask) == 0 && i + 1 - start >= min_chunk_size)
+        {
+          end = i + 1;
+          break;
+        }
+      }
+    }
+
+    start = end;
+  }
+
+  return cuts;
+}
+
+bool save_store::is_valid_id(std::string_view save_id)
+{
+  if (save_id.empty() || save_id == "." || save_id == "..")
+    return false;
+
+  for (const char c : save_id)
+  {
+    const bool valid = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+      || c == '.' || c == '_' || c == '-';
+    if (!valid)
+      return false;
+  }
+  return true;
+}
+
+std::filesystem::path save_store::manifest_path(std::string_view save_id) const
+{
+  return m_dir / "saves" / (std::string(save_id) + ".manifest");
+}
+
+std::filesystem::path save_store::chunk_path(const chunk_ref& ref) const
+{
+  const auto name = fmt::format("{:016X}-{:X}", ref.hash, ref.size);
+  return m_dir / "chunks" / name.substr(0, 2) / name;
+}
+
+op_status save_store::put(const node_tree& tree, std::string_view save_id, put_stats* stats) const
+{
+  scoped_span span("store.put", save_id);
+
+  if (!is_valid_id(save_id))
+    return op_status(fmt::format("invalid save id \"{}\"", save_id));
+
+  if (!tree.root)
+    return op_status(std::string("tree has no root"));
+
+  // --------------------------------------------------------
+  //  IMAGE (descriptors table, nodedata without offset)
+  // --------------------------------------------------------
+
+  serial_tree stree;
+  if (!stree.from_tree(tree.root, 0))
+    return op_status(std::string("couldn't flatten node_t tree"));
+
+  memory_ostream descs_ar;
+  int64_t descs_cnt = static_cast<int64_t>(stree.descs.size());
+  descs_ar.serialize_int_packed(descs_cnt);
+  for (auto& d : stree.descs)
+    descs_ar << d;
+
+  const std::span<const char> descs_table = descs_ar.gather();
+  const std::span<const char> nodedata = stree.nodedata;
+
+  // top-level nodes start a chunk, their edits don't shift the cuts of the
+  // following ones
+  std::vector<size_t> node_cuts;
+  for (const auto& c : tree.root->children())
+  {
+    if (c->is_cnode() && static_cast<size_t>(c->idx()) < stree.descs.size())
+      node_cuts.push_back(stree.descs[c->idx()].data_offset);
+  }
+
+  struct chunk_job
+  {
+    std::span<const char> data;
+    chunk_ref ref = {};
+  };
+
+  std::vector<chunk_job> jobs;
+  const auto add_jobs = [&jobs](std::span<const char> part, const std::vector<size_t>& cuts)
+  {
+    for (size_t i = 0; i < cuts.size(); ++i)
+    {
+      const size_t end = (i + 1 < cuts.size()) ? cuts[i + 1] : part.size();
+      jobs.push_back(chunk_job{part.subspan(cuts[i], end - cuts[i])});
+    }
+  };
+
+  add_jobs(descs_table, cut_points(descs_table));
+  add_jobs(nodedata, cut_points(nodedata, node_cuts));
+
+  // --------------------------------------------------------
+  //  CHUNKS (hashing, compression of the new ones)
+  // --------------------------------------------------------
+
+  std::error_code ec;
+  std::filesystem::create_directories(m_dir / "saves", ec);
+  std::filesystem::create_directories(m_dir / "chunks", ec);
+
+  std::atomic<size_t> new_chunks_cnt = 0;
+  std::atomic<uint64_t> new_stored_size = 0;
+  std::atomic<bool> failed = false;
+
+  parallel_for(jobs.size(), m_workers_cnt, [&](size_t i)
+  {
+    auto& job = jobs[i];
+    job.ref.hash = crc64_bigdata(job.data.data(), job.data.size());
+    job.ref.size = static_cast<uint32_t>(job.data.size());
+
+    const auto path = chunk_path(job.ref);
+    std::error_code ec;
+    if (std::filesystem::exists(path, ec))
+      return;
+
+    // same layout as the chunks of a csav file
+    std::vector<char> cdata(8 + LZ4_compressBound(static_cast<int>(job.data.size())));
+    const uint32_t chunk_magic = 'XLZ4';
+    std::memcpy(cdata.data(), &chunk_magic, 4);
+    std::memcpy(cdata.data() + 4, &job.ref.size, 4);
+    const int csize = LZ4_compress_default(job.data.data(), cdata.data() + 8,
+      static_cast<int>(job.data.size()), static_cast<int>(cdata.size() - 8));
+    if (csize <= 0)
+    {
+      failed = true;
+      return;
+    }
+    cdata.resize(8 + csize);
+
+    std::filesystem::create_directories(path.parent_path(), ec);
+    if (!write_file_atomic(path, cdata))
+    {
+      failed = true;
+      return;
+    }
+
+    ++new_chunks_cnt;
+    new_stored_size += cdata.size();
+  });
+
+  if (failed)
+    return op_status(std::string("couldn't write chunks"));
+
+  // --------------------------------------------------------
+  //  MANIFEST
+  // --------------------------------------------------------
+
+  memory_ostream ar;
+
+  uint32_t magic = manifest_magic;
+  uint32_t format = manifest_format;
+  ar << magic << format;
+
+  version ver = tree.ver();
+  ar << ver.v1 << ver.v2 << ver.v3 << ver.uk0 << ver.uk1;
+  ar.serialize_str_lpfxd(ver.suk);
+  ar << ver.ps4w;
+
+  uint64_t descs_table_size = descs_table.size();
+  uint64_t nodedata_size = nodedata.size();
+  ar << descs_table_size << nodedata_size;
+
+  uint32_t chunks_cnt = static_cast<uint32_t>(jobs.size());
+  ar << chunks_cnt;
+  for (auto& job : jobs)
+    ar << job.ref.hash << job.ref.size;
+
+  if (!write_file_atomic(manifest_path(save_id), ar.gather()))
+    return op_status(std::string("couldn't write manifest"));
+
+  if (stats)
+  {
+    stats->chunks_cnt = jobs.size();
+    stats->new_chunks_cnt = new_chunks_cnt;
+    stats->image_size = descs_table.size() + nodedata.size();
+    stats->new_stored_size = new_stored_size;
+  }
+
+  return {};
+}
+
+op_status save_store::get(std::string_view save_id, node_tree& tree) const
+{
+  scoped_span span("store.get", save_id);
+
+  if (!is_valid_id(save_id))
+    return op_status(fmt::format("invalid save id \"{}\"", save_id));
+
+  // --------------------------------------------------------
+  //  MANIFEST
+  // --------------------------------------------------------
+
+  std::vector<char> manifest;
+  if (!read_file(manifest_path(save_id), manifest))
+    return op_status(fmt::format("save \"{}\" not found", save_id));
+
+  memory_istream ar(manifest);
+
+  uint32_t magic = 0, format = 0;
+  ar << magic << format;
+  if (magic != manifest_magic || format != manifest_format)
+    return op_status(std::string("unsupported manifest"));
+
+  version ver;
+  ar << ver.v1 << ver.v2 << ver.v3 << ver.uk0 << ver.uk1;
+  ar.serialize_str_lpfxd(ver.suk);
+  ar << ver.ps4w;
+
+  uint64_t descs_table_size = 0, nodedata_size = 0;
+  ar << descs_table_size << nodedata_size;
+
+  uint32_t chunks_cnt = 0;
+  ar << chunks_cnt;
+  if (ar.has_error() || chunks_cnt > manifest.size() / 12)
+    return op_status(std::string("invalid manifest"));
+
+  std::vector<chunk_ref> refs(chunks_cnt);
+  for (auto& ref : refs)
+    ar << ref.hash << ref.size;
+
+  if (ar.has_error())
+    return op_status(ar.error());
+
+  // --------------------------------------------------------
+  //  CHUNKS
+  // --------------------------------------------------------
+
+  // the chunks are laid out one after the other: descriptors table first,
+  // then nodedata
+  uint64_t total_size = 0;
+  std::vector<uint64_t> offsets(refs.size());
+  for (size_t i = 0; i < refs.size(); ++i)
+  {
+    offsets[i] = total_size;
+    total_size += refs[i].size;
+  }
+
+  if (total_size != descs_table_size + nodedata_size)
+    return op_status(std::string("manifest chunks don't match the image size"));
+
+  std::vector<char> image(total_size);
+  std::vector<const char*> chunk_errors(refs.size(), nullptr);
+
+  parallel_for(refs.size(), m_workers_cnt, [&](size_t i)
+  {
+    const auto& ref = refs[i];
+
+    std::vector<char> cdata;
+    if (!read_file(chunk_path(ref), cdata))
+    {
+      chunk_errors[i] = "missing chunk";
+      return;
+    }
+
+    uint32_t chunk_magic = 0, data_size = 0;
+    if (cdata.size() >= 8)
+    {
+      std::memcpy(&chunk_magic, cdata.data(), 4);
+      std::memcpy(&data_size, cdata.data() + 4, 4);
+    }
+
+    if (chunk_magic != 'XLZ4' || data_size != ref.size)
+    {
+      chunk_errors[i] = "invalid chunk";
+      return;
+    }
+
+    char* const dst = image.data() + offsets[i];
+    const int res = LZ4_decompress_safe(cdata.data() + 8, dst, static_cast<int>(cdata.size() - 8), ref.size);
+    if (res != static_cast<int>(ref.size) || crc64_bigdata(dst, ref.size) != ref.hash)
+      chunk_errors[i] = "corrupted chunk";
+  });
+
+  for (const char* err : chunk_errors)
+  {
+    if (err)
+      return op_status(std::string(err));
+  }
+
+  // --------------------------------------------------------
+  //  TREE
+  // --------------------------------------------------------
+
+  serial_tree stree;
+  const std::span<const char> descs_table(image.data(), descs_table_size);
+  if (!stree.decode_descs(descs_table))
+    return op_status(std::string("invalid node descriptors table"));
+
+  const std::span<const char> nodedata(image.data() + descs_table_size, nodedata_size);
+  auto root = stree.to_tree(0, nodedata);
+  if (!root || root->calcsize() != nodedata.size())
+    return op_status(std::string("couldn't lift a tree from the stored image"));
+
+  tree.ver() = ver;
+  tree.original_descs = std::move(stree.descs);
+  tree.root = std::move(root);
+
+  return {};
+}
+
+bool save_store::contains(std::string_view save_id) const
+{
+  std::error_code ec;
+  return is_valid_id(save_id) && std::filesystem::is_regular_file(manifest_path(save_id), ec);
+}
+
+std::vector<std::string> save_store::list() const
+{
+  std::vector<std::string> ret;
+
+  std::error_code ec;
+  for (auto it = std::filesystem::directory_iterator(m_dir / "saves", ec); it != std::filesystem::directory_iterator(); it.increment(ec))
+  {
+    if (ec)
+      break;
+    if (it->is_regular_file() && it->path().extension() == ".manifest")
+      ret.emplace_back(it->path().stem().string());
+  }
+
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
+} // namespace cp::csav
+
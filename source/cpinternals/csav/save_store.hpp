@@ -0,0 +1,96 @@
+#pragma once
+#include <inttypes.h>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cpinternals/common.hpp>
+#include <cpinternals/csav/node_tree.hpp>
+
+namespace cp::csav {
+
+// Content-addressed store of save trees (e.g. every autosave of a backup
+// history).
+// A stored save is its version, its node descriptors table and its
+// decompressed nodedata. These are split into chunks at the start of each
+// top-level node and, inside of nodes, by content-defined chunking (gear
+// rolling hash), so that an edit only changes the chunks around it.
+// Chunks are named by their crc64 and size, stored once (lz4 compressed) and
+// shared by all the saves of the store. They are hashed, compressed and
+// written concurrently.
+// get() lifts the tree back from its chunks, serialize_out of the restored
+// tree produces the same bytes as serialize_out of the stored one.
+//
+// layout:
+//   <dir>/saves/<save_id>.manifest
+//   <dir>/chunks/<first 2 hex digits>/<crc64 hex>-<size hex>
+struct save_store
+{
+  struct put_stats
+  {
+    size_t   chunks_cnt = 0;
+    size_t   new_chunks_cnt = 0;
+    uint64_t image_size = 0;      // descriptors table + nodedata
+    uint64_t new_stored_size = 0; // compressed size of the new chunks
+  };
+
+  // content-defined chunking bounds, avg_chunk_size is a power of 2
+  static constexpr size_t min_chunk_size = 0x800;
+  static constexpr size_t avg_chunk_size = 0x4000;
+  static constexpr size_t max_chunk_size = 0x10000;
+
+  explicit save_store(std::filesystem::path dir)
+    : m_dir(std::move(dir)) {}
+
+  const std::filesystem::path& dir() const
+  {
+    return m_dir;
+  }
+
+  // number of threads used to hash, (de)compress and write chunks.
+  // 0 means one per hardware thread, 1 disables threading.
+  size_t workers_count() const
+  {
+    return m_workers_cnt;
+  }
+
+  void set_workers_count(size_t cnt)
+  {
+    m_workers_cnt = cnt;
+  }
+
+  // save_id is a file name ([A-Za-z0-9._-]), an existing save is replaced.
+  op_status put(const node_tree& tree, std::string_view save_id, put_stats* stats = nullptr) const;
+
+  // restores the version, the descriptors and the root of tree.
+  op_status get(std::string_view save_id, node_tree& tree) const;
+
+  bool contains(std::string_view save_id) const;
+
+  // ids of the stored saves, sorted
+  std::vector<std::string> list() const;
+
+  // chunk start offsets of data (the first one is 0 if data isn't empty).
+  // forced_cuts are sorted offsets where a chunk must start.
+  static std::vector<size_t> cut_points(std::span<const char> data, const std::vector<size_t>& forced_cuts = {});
+
+protected:
+  struct chunk_ref
+  {
+    uint64_t hash; // crc64 of the chunk
+    uint32_t size;
+  };
+
+  static bool is_valid_id(std::string_view save_id);
+
+  std::filesystem::path manifest_path(std::string_view save_id) const;
+  std::filesystem::path chunk_path(const chunk_ref& ref) const;
+
+  std::filesystem::path m_dir;
+  size_t m_workers_cnt = 0;
+};
+
+} // namespace cp::csav
+
@@ -4,15 +4,26 @@
 #include <fstream>
 #include <numeric>
 #include <cassert>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <unordered_set>
+
+#include <cpinternals/common/parallel.hpp>
+#include <cpinternals/common/task_scheduler.hpp>
+#include <cpinternals/common/instrumentation.hpp>
+#include <cpinternals/common/alloc_profiler.hpp>
 
 #include "version.hpp"
 #include "node_tree.hpp"
+#include "flat_tree.hpp"
 #include "node.hpp"
 #include "nodes.hpp"
 
 namespace cp::csav {
 
 struct savegame
+  : public node_listener_t
 {
   using node_type = csav::node_t;
   using shared_node_type = std::shared_ptr<const node_type>;
@@ -39,20 +50,149 @@ struct savegame
 
   //CGenericSystem            scriptables;
 
+  // when false, errors are logged and kept in load_errors instead of being
+  // shown in message boxes (headless tools)
+  bool interactive = true;
+  std::vector<std::string> load_errors;
+
+  // reserialization tests dump the original and reserialized images of a
+  // mismatching system into dumps_dir (the working directory if empty),
+  // prefixed with the save's directory and name
+  bool dump_reserialize_mismatches = true;
+  std::filesystem::path dumps_dir;
+
+  // number of threads used to load systems (their subtrees are disjoint),
+  // also given to each CSystem for the decoding of its objects.
+  // 0 means one per hardware thread, 1 loads them sequentially.
+  size_t systems_workers_count = 0;
+
+  // objects of ScriptableSystemsContainer and PSData decode their fields on
+  // first access, unless testing (see CSystem::set_lazy_decoding)
+  bool lazy_systems = true;
+
+  // when set (before opening), saves only write back the systems modified
+  // since the last open or save, the nodes of the others are kept as is.
+  // a system is modified when an editor marks it (mark_system_dirty) or
+  // when its node gets an event (edited through the tree, e.g. hex editor,
+  // paste or undo): it is then written back over it, like without tracking.
+  bool track_dirty_systems = false;
+
+  savegame() = default;
+  savegame(const savegame&) = delete;
+  savegame& operator=(const savegame&) = delete;
+
+  ~savegame() override
+  {
+    unlisten_systems();
+  }
+
+  void mark_system_dirty(std::string_view nodename)
+  {
+    const size_t idx = system_index(nodename);
+    if (idx < m_dirty_systems.size())
+      m_dirty_systems[idx] = true;
+  }
+
+  // always true without tracking
+  bool is_system_dirty(std::string_view nodename) const
+  {
+    if (!track_dirty_systems)
+      return true;
+    const size_t idx = system_index(nodename);
+    return idx < m_dirty_systems.size() && m_dirty_systems[idx];
+  }
+
+  // when set, open_with_progress goes through a decoded sidecar of the save
+  // (see node_tree::load_cached): <save>.csdc next to it if decoded_cache_dir
+  // is empty, otherwise one file per save path in that directory.
+  // systems are still parsed from the lifted tree.
+  bool use_decoded_cache = false;
+  std::filesystem::path decoded_cache_dir;
+
+  std::filesystem::path decoded_cache_path(const std::filesystem::path& path) const
+  {
+    if (decoded_cache_dir.empty())
+    {
+      auto ret = path;
+      ret += ".csdc";
+      return ret;
+    }
+
+    const auto path_str = std::filesystem::absolute(path).u8string();
+    const uint64_t path_hash = crc64_bigdata(reinterpret_cast<const char*>(path_str.data()), path_str.size());
+    return decoded_cache_dir / fmt::format("{:016x}.csdc", path_hash);
+  }
+
 public:
   // reserialization test can only be done with file saved by the game
   // this is because although the order of the CProperties isn't important for the game
   // we don't want to keep the initial order for each object but rely on a standardized one (blueprint db)
   // the one the game uses
+  // progress.cancel aborts the load (the savegame must then be discarded)
   op_status open_with_progress(std::filesystem::path path, progress_t& progress, bool dump_decompressed_data=false, bool tree_only=false, bool test=true)
   {
+    scoped_span span("savegame.open");
+
+    filepath = path;
+    return open_tree_with_progress(progress, tree_only, test, [&]() {
+      if (use_decoded_cache)
+        return tree.load_cached(path, decoded_cache_path(path), progress.cancel);
+      return tree.load(path, progress.cancel);
+    });
+  }
+
+  // same from a save already in memory (e.g. an upload), read in place:
+  // data only has to outlive the call. filepath is cleared.
+  op_status open_with_progress(std::span<const char> data, progress_t& progress, bool dump_decompressed_data=false, bool tree_only=false, bool test=true)
+  {
+    scoped_span span("savegame.open_memory");
+
+    filepath.clear();
+    return open_tree_with_progress(progress, tree_only, test, [&]() {
+      return tree.load(data, progress.cancel);
+    });
+  }
+
+  // Pipelined variant of open_with_progress (see node_tree::load_pipelined):
+  // each system is parsed by a task as soon as its node is lifted, while
+  // the rest of the save is still being read and decompressed.
+  // systems_workers_count = 1 parses them one at a time.
+  op_status open_pipelined(std::filesystem::path path, progress_t& progress, bool test=true)
+  {
+    scoped_span span("savegame.open_pipelined");
+
     filepath = path;
+    return open_pipelined_with_progress(progress, test, [&](const node_tree::node_ready_fn& on_node) {
+      return tree.load_pipelined(path, on_node, progress.cancel);
+    });
+  }
+
+  op_status open_pipelined(std::span<const char> data, progress_t& progress, bool test=true)
+  {
+    scoped_span span("savegame.open_pipelined_memory");
+
+    filepath.clear();
+    return open_pipelined_with_progress(progress, test, [&](const node_tree::node_ready_fn& on_node) {
+      return tree.load_pipelined(data, on_node, progress.cancel);
+    });
+  }
+
+protected:
+  template <typename LoadTreeFn>
+  op_status open_tree_with_progress(progress_t& progress, bool tree_only, bool test, LoadTreeFn&& load_tree)
+  {
+    load_errors.clear();
+    m_lazy = false;
+    m_flat.clear();
+    m_lifted.clear();
+    m_lazy_loaded.clear();
 
     progress.value = 0.00f;
-    op_status status = tree.load(path);
+    op_status status = load_tree();
     if (!status)
       return status;
     root = tree.root;
+    listen_systems();
 
     if (tree_only)
     {
@@ -66,67 +206,456 @@ public:
     CObjectBPList::get();
     progress.value = 0.25f;
 
-    try_load_node_data_struct(inventory,    "inventory"                           , progress, 0.30f, test);
-    try_load_node_data_struct(chtrcustom,   "CharacetrCustomization_Appearances"  , progress, 0.35f, test);
+    load_systems(progress, 1.00f, test);
+    if (progress.cancelled())
+      return op_status(std::string("cancelled"));
+
+    return true;
+  }
+
+  template <typename LoadTreeFn>
+  op_status open_pipelined_with_progress(progress_t& progress, bool test, LoadTreeFn&& load_tree)
+  {
+    load_errors.clear();
+    m_lazy = false;
+    m_flat.clear();
+    m_lifted.clear();
+    m_lazy_loaded.clear();
+
+    progress.value = 0.00f;
+    progress.comment = "loading game classes definitions";
+    CObjectBPList::get();
+    configure_systems(test);
+
+    const auto jobs = system_jobs();
+    std::array<std::atomic<bool>, 8> started = {};
+
+    // the tree counts for 20%, jobs share the rest by weight
+    std::mutex progress_mtx;
+    size_t done_cnt = 0;
+    progress.comment = fmt::format("Loading systems (0/{})", jobs.size());
+
+    span_sink* const sink = current_span_sink();
+    const uint32_t depth = current_span_depth();
+    std::mutex sequential_mtx;
 
-    try_load_node_data_struct(godmode,      "godModeSystem"                       , progress, 0.40f, test);
-    try_load_node_data_struct(factsdb,      "FactsDB"                             , progress, 0.45f, test);
+    auto run_job = [&](size_t i, const shared_node_type& node)
+    {
+      if (progress.cancelled())
+        return;
+
+      std::unique_lock<std::mutex> sequential_lock(sequential_mtx, std::defer_lock);
+      if (systems_workers_count == 1)
+        sequential_lock.lock();
+
+      scoped_span_sink job_sink(sink, depth);
+      // pools are per thread, reserialization tests reuse the buffers
+      node_buffer_pool_scope pool_scope;
+
+      const auto& job = jobs[i];
+      progress_t job_progress;
+      try_load_node_data_struct(*job.var, node, job.nodename, job_progress, 1.f, test);
 
-    try_load_node_data_struct(scriptables,  "ScriptableSystemsContainer"          , progress, 0.50f, test);
-    try_load_node_data_struct(psdata,       "PSData"                              , progress, 0.80f, test);
+      std::lock_guard<std::mutex> lock(progress_mtx);
+      progress.value += job.weight * 0.80f;
+      progress.comment = fmt::format("Loading systems ({}/{})", ++done_cnt, jobs.size());
+    };
+
+    task_group systems_group;
+
+    // called by the tree's tasks with the top-level nodes
+    auto on_node = [&](const shared_node_type& node)
+    {
+      const std::string name = node->name();
+      for (size_t i = 0; i < jobs.size(); ++i)
+      {
+        if (name == jobs[i].nodename && !started[i].exchange(true))
+          systems_group.run([&run_job, i, node]() { run_job(i, node); });
+      }
+    };
 
-    try_load_node_data_struct(stats,        "StatsSystem"                         , progress, 0.90f, test);
-    try_load_node_data_struct(statspool,    "StatPoolsSystem"                     , progress, 1.00f, test);
+    op_status status = load_tree(node_tree::node_ready_fn(on_node));
+    if (!status)
+    {
+      systems_group.cancel();
+      systems_group.wait();
+      return status;
+    }
+    root = tree.root;
+
+    {
+      std::lock_guard<std::mutex> lock(progress_mtx);
+      progress.value += 0.20f;
+    }
+
+    // systems whose node isn't top-level (or is missing)
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+      if (started[i].exchange(true))
+        continue;
+
+      // searched on this thread (search_node isn't thread-safe)
+      auto node = search_node(jobs[i].nodename);
+      systems_group.run([&run_job, i, node]() { run_job(i, node); });
+    }
+
+    systems_group.wait();
+    listen_systems();
+    progress.value = 1.00f;
+
+    if (progress.cancelled())
+      return op_status(std::string("cancelled"));
 
     return true;
   }
 
+public:
+  // Reserialization test detached from the savegame: the systems' nodes
+  // are copied on creation, run() parses them into fresh systems and tests
+  // them. It can run in the background while the savegame is being edited.
+  struct reserialization_check
+  {
+    op_status run(progress_t& progress)
+    {
+      if (!shadow)
+        return op_status(std::string("no savegame to check"));
+
+      scoped_span span("savegame.reserialization_check");
+      shadow->load_systems(progress, 1.00f, true);
+      if (progress.cancelled())
+        return op_status(std::string("cancelled"));
+
+      const auto& errors = shadow->load_errors;
+      if (errors.empty())
+        return true;
+
+      return op_status(fmt::format("{} error(s), first: {}", errors.size(), errors.front()));
+    }
+
+    std::shared_ptr<savegame> shadow;
+  };
+
+  // must be called from the thread editing this savegame
+  reserialization_check make_reserialization_check()
+  {
+    reserialization_check check;
+
+    auto shadow = std::make_shared<savegame>();
+    shadow->filepath = filepath;
+    shadow->interactive = false;
+    shadow->systems_workers_count = systems_workers_count;
+    shadow->tree.ver() = tree.ver();
+
+    auto shadow_root = node_t::create_shared(node_t::root_node_idx, "root");
+    for (const auto& [name, var] : systems())
+    {
+      if (auto node = search_node(name))
+        shadow_root->nonconst().children_push_back(node->deepcopy());
+    }
+    shadow->tree.root = shadow_root;
+    shadow->root = shadow_root;
+
+    check.shadow = std::move(shadow);
+    return check;
+  }
+
+  // Lazy mode: only the flat tree is loaded, nodes are lifted on demand
+  // by search_node and systems are loaded on demand by load_system.
+  // root stays null until save_with_progress materializes the full tree.
+  op_status open_lazy(std::filesystem::path path)
+  {
+    filepath = path;
+    root = nullptr;
+    m_lifted.clear();
+    // systems of a previous open must not be written into this save
+    reset_systems();
+
+    op_status status = tree.load_flat(path, m_flat);
+    if (!status)
+      return status;
+
+    if (!m_flat.validate())
+      return op_status(std::string("flat tree size differs from serial_tree size"));
+
+    m_lazy = true;
+    return true;
+  }
+
+  // Partial mode: read-only variant of the lazy mode (e.g. analytics over
+  // many saves). Only the version and the node descriptors are read, nodes
+  // are lifted from the file by search_node (only their chunks are
+  // decompressed, see node_tree::open_partial) and systems are loaded on
+  // demand by load_system. Such a savegame can't be saved.
+  op_status open_partial(std::filesystem::path path)
+  {
+    filepath = path;
+    load_errors.clear();
+    root = nullptr;
+    m_lazy = false;
+    m_flat.clear();
+    m_lifted.clear();
+    reset_systems();
+
+    return tree.open_partial(path);
+  }
+
+  bool is_lazy() const
+  {
+    return m_lazy;
+  }
+
+  // loads a single system by its node name (e.g. "inventory")
+  bool load_system(std::string_view nodename, bool test=false)
+  {
+    auto var = system_by_node_name(nodename);
+    if (!var)
+      return false;
+
+    configure_systems(test);
+
+    progress_t dummy;
+    const bool loaded = try_load_node_data_struct(*var, nodename, dummy, 0.f, test);
+    if (loaded && m_lazy)
+      m_lazy_loaded.insert(var);
+    return loaded;
+  }
+
+  // loads a system re-encoding everything like a test, but leaves the
+  // comparison to the caller (see roundtrip_verifier)
+  bool load_system_reencoded(std::string_view nodename)
+  {
+    auto var = system_by_node_name(nodename);
+    auto node = search_node(nodename);
+    if (!var || !node)
+      return false;
+
+    configure_systems(true);
+
+    scoped_span span("sys.load", nodename);
+    scoped_alloc_tag alloc_scope(alloc_tag::scripting);
+    span.set_bytes(node->calcsize());
+    return load_node_data_struct(node, *var);
+  }
+
+  using system_entry = std::pair<std::string_view, node_serializable*>;
+
+  // node name and structure of each loaded system
+  std::array<system_entry, 8> systems()
+  {
+    return {{
+      { "inventory"                           , &inventory    },
+      { "CharacetrCustomization_Appearances"  , &chtrcustom   },
+      { "godModeSystem"                       , &godmode      },
+      { "FactsDB"                             , &factsdb      },
+      { "ScriptableSystemsContainer"          , &scriptables  },
+      { "PSData"                              , &psdata       },
+      { "StatsSystem"                         , &stats        },
+      { "StatPoolsSystem"                     , &statspool    },
+    }};
+  }
+
   bool reload_character_customization()
   {
     progress_t dummy;
     return try_load_node_data_struct(chtrcustom,   "CharacetrCustomization_Appearances"  , dummy, 0.f, true);
   }
 
-  op_status save_with_progress(std::filesystem::path path, progress_t& progress, bool dump_decompressed_data=false, bool ps4_weird_format=false)
+  op_status save_with_progress(std::filesystem::path path, progress_t& progress, bool dump_decompressed_data=false, bool ps4_weird_format=false,
+    csav::node_tree::save_profile profile=csav::node_tree::save_profile::balanced)
+  {
+    return save_tree_with_progress(progress, ps4_weird_format, profile, [&]() {
+      return tree.save(path);
+    });
+  }
+
+  // same into a memory stream (see node_tree::save), without backup
+  op_status save_with_progress(memory_ostream& out, progress_t& progress, bool ps4_weird_format=false,
+    csav::node_tree::save_profile profile=csav::node_tree::save_profile::balanced)
   {
+    return save_tree_with_progress(progress, ps4_weird_format, profile, [&]() {
+      return tree.save(out);
+    });
+  }
+
+protected:
+  template <typename SaveTreeFn>
+  op_status save_tree_with_progress(progress_t& progress, bool ps4_weird_format, csav::node_tree::save_profile profile, SaveTreeFn&& save_tree)
+  {
+    if (tree.is_partial())
+      return op_status(std::string("a savegame opened in partial mode can't be saved"));
+
+    scoped_span span("savegame.save");
+    node_buffer_pool_scope pool_scope;
+
     progress.value = 0.00f;
 
-    try_save_node_data_struct(inventory,    "inventory"                             );  progress.value = 0.10f;
-    try_save_node_data_struct(chtrcustom,   "CharacetrCustomization_Appearances"    );  progress.value = 0.15f;
+    if (m_lazy)
+    {
+      // only the systems loaded by load_system are written back, nodes
+      // that were only lifted by search_node keep their data
+      for (const auto& [name, var] : systems())
+      {
+        if (m_lazy_loaded.count(var))
+          try_save_node_data_struct(*var, name);
+      }
+      progress.value = 0.50f;
+
+      root = m_flat.to_node(flat_tree::root_idx, &m_lifted);
+      m_flat.clear();
+      m_lifted.clear();
+      m_lazy_loaded.clear();
+      m_lazy = false;
+
+      progress.value = 0.80f;
+    }
+    else
+    {
+      // clean systems keep their node (see track_dirty_systems)
+      auto save_system = [&](node_serializable& var, std::string_view nodename, float end_progress) {
+        if (is_system_dirty(nodename))
+          try_save_node_data_struct(var, nodename);
+        progress.value = end_progress;
+      };
+
+      save_system(inventory,    "inventory"                             , 0.10f);
+      save_system(chtrcustom,   "CharacetrCustomization_Appearances"    , 0.15f);
 
-    try_save_node_data_struct(godmode,      "godModeSystem"                         );  progress.value = 0.20f;
-    try_save_node_data_struct(factsdb,      "FactsDB"                               );  progress.value = 0.25f;
+      save_system(godmode,      "godModeSystem"                         , 0.20f);
+      save_system(factsdb,      "FactsDB"                               , 0.25f);
 
-    try_save_node_data_struct(scriptables,  "ScriptableSystemsContainer"            );  progress.value = 0.30f;
-    try_save_node_data_struct(psdata,       "PSData"                                );  progress.value = 0.60f;
+      save_system(scriptables,  "ScriptableSystemsContainer"            , 0.30f);
+      save_system(psdata,       "PSData"                                , 0.60f);
+
+      save_system(stats,        "StatsSystem"                           , 0.70f);
+      save_system(statspool,    "StatPoolsSystem"                       , 0.80f);
+    }
 
-    try_save_node_data_struct(stats,        "StatsSystem"                           );  progress.value = 0.70f;
-    try_save_node_data_struct(statspool,    "StatPoolsSystem"                       );  progress.value = 0.80f;
-    
     tree.ver().ps4w = ps4_weird_format;
+    tree.set_save_profile(profile);
     tree.root = root;
-    op_status status = tree.save(path);
+    op_status status = save_tree();
     progress.value = 1.00f;
 
     return status;
   }
 
-protected:
+  // tests re-encode everything: no lazy decoding, no copy of unmodified objects
+  void configure_systems(bool test)
+  {
+    for (CSystem* sys : { &scriptables.system(), &psdata.system(), &stats.system(), &statspool.system(), &godmode.system() })
+    {
+      sys->set_copy_unmodified(!test);
+      sys->set_lazy_decoding(false);
+      sys->set_workers_count(systems_workers_count);
+    }
+
+    scriptables.system().set_lazy_decoding(lazy_systems && !test);
+    psdata.system().set_lazy_decoding(lazy_systems && !test);
+  }
+
+  // loads all systems concurrently (see systems_workers_count),
+  // progress goes from its current value to end_progress.
+  // systems not started yet are skipped once progress is cancelled.
+  // share of the progress range, heaviest first so that they overlap
+  struct system_job
+  {
+    node_serializable*  var;
+    std::string_view    nodename;
+    float               weight;
+  };
+
+  std::array<system_job, 8> system_jobs()
+  {
+    return {{
+      { &psdata,      "PSData"                              , 0.30f },
+      { &scriptables, "ScriptableSystemsContainer"          , 0.30f },
+      { &stats,       "StatsSystem"                         , 0.10f },
+      { &statspool,   "StatPoolsSystem"                     , 0.10f },
+      { &inventory,   "inventory"                           , 0.05f },
+      { &chtrcustom,  "CharacetrCustomization_Appearances"  , 0.05f },
+      { &godmode,     "godModeSystem"                       , 0.05f },
+      { &factsdb,     "FactsDB"                             , 0.05f },
+    }};
+  }
+
+  void load_systems(progress_t& progress, float end_progress, bool test)
+  {
+    configure_systems(test);
+
+    const auto jobs = system_jobs();
+
+    // nodes are searched on this thread (search_node isn't thread-safe)
+    std::array<shared_node_type, 8> nodes;
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+      nodes[i] = search_node(jobs[i].nodename);
+    }
+
+    // jobs report their own progress in local progress_t objects,
+    // the shared one is only updated under lock when a job is done
+    std::mutex progress_mtx;
+    size_t done_cnt = 0;
+    const float start_progress = progress.value;
+    const float progress_range = end_progress - start_progress;
+    progress.comment = fmt::format("Loading systems (0/{})", jobs.size());
+
+    span_sink* const sink = current_span_sink();
+    const uint32_t depth = current_span_depth();
+
+    parallel_for(jobs.size(), systems_workers_count, [&](size_t i)
+    {
+      if (progress.cancelled())
+        return;
+
+      scoped_span_sink job_sink(sink, depth);
+      // pools are per thread, reserialization tests reuse the buffers
+      node_buffer_pool_scope pool_scope;
+
+      const auto& job = jobs[i];
+      progress_t job_progress;
+      try_load_node_data_struct(*job.var, nodes[i], job.nodename, job_progress, 1.f, test);
+
+      std::lock_guard<std::mutex> lock(progress_mtx);
+      progress.value += job.weight * progress_range;
+      progress.comment = fmt::format("Loading systems ({}/{})", ++done_cnt, jobs.size());
+    });
+
+    progress.value = end_progress;
+  }
+
   bool try_load_node_data_struct(cp::csav::node_serializable& var, std::string_view nodename, progress_t& progress, float end_progress, bool test=false)
   {
-    auto node = search_node(nodename);
+    return try_load_node_data_struct(var, search_node(nodename), nodename, progress, end_progress, test);
+  }
+
+  bool try_load_node_data_struct(cp::csav::node_serializable& var, const shared_node_type& node, std::string_view nodename, progress_t& progress, float end_progress, bool test=false)
+  {
     if (!node)
+    {
+      if (!interactive)
+        report_error(fmt::format("node_t {} not found", nodename));
       return false;
+    }
 
     bool ok = false;
+    bool loaded = false;
 
     progress.comment.assign(fmt::format("Loading node_t {}", node->name()));
-    if (load_node_data_struct(node, var))
+    {
+      scoped_span span("sys.load", nodename);
+      scoped_alloc_tag alloc_scope(alloc_tag::scripting);
+      span.set_bytes(node->calcsize());
+      loaded = load_node_data_struct(node, var);
+    }
+
+    if (loaded)
     {
       if (test)
       {
         progress.value = 0.5f * (end_progress + progress.value);
         progress.comment.assign(fmt::format("Testing reserialization of node_t {}", node->name()));
+
+        scoped_span span("sys.test_reserialize", nodename);
         if (test_reserialize(node, var))
           ok = true;
       }
@@ -146,29 +675,51 @@ protected:
     if (!new_node)
       return false;
 
+    constexpr uint32_t data_offset = 4;
+
+    // the reserialized bytes are compared with the original node as they are
+    // written, the serialized images are only built to dump a mismatch
+    size_t mismatch_offset = 0;
+    {
+      auto root = node_t::create_shared(node_t::root_node_idx, "root");
+      root->nonconst().children_push_back(new_node);
+
+      serial_bytes_comparator cmp(*node);
+      serial_tree stree;
+      const bool written = stree.write_tree(root, data_offset, cmp);
+      if (written && cmp.finish())
+        return true;
+
+      // in the dumps, which start with the data_offset prefix
+      mismatch_offset = data_offset + std::min(cmp.mismatch_offset(), cmp.written_size());
+      SPDLOG_DEBUG("reserialized {}: {} bytes, crc64 {:016X}, first mismatch at {}",
+        node->name(), cmp.written_size(), cmp.written_hash(), mismatch_offset);
+    }
+
     serial_tree stree1, stree2;
 
     {
       auto root = node_t::create_shared(node_t::root_node_idx, "root");
       root->nonconst().children_push_back(node);
-      stree1.from_tree(root, 4);
+      stree1.from_tree(root, data_offset);
     }
     {
       auto root = node_t::create_shared(node_t::root_node_idx, "root");
       root->nonconst().children_push_back(new_node);
-      stree2.from_tree(root, 4);
+      stree2.from_tree(root, data_offset);
     }
 
     if (stree1.nodedata.size() != stree2.nodedata.size()
       || std::memcmp(stree1.nodedata.data(), stree2.nodedata.data(), stree1.nodedata.size()))
     {
-      std::ofstream ofs;
-      ofs.open(fmt::format("dump_{}_orig.bin", node->name()));
-      ofs.write(stree1.nodedata.data(), stree1.nodedata.size());
-      ofs.close();
-      ofs.open(fmt::format("dump_{}_reserialized.bin", node->name()));
-      ofs.write(stree2.nodedata.data(), stree2.nodedata.size());
-      ofs.close();
+      if (dump_reserialize_mismatches)
+        dump_mismatch(node->name(), stree1, stree2);
+
+      if (!interactive)
+      {
+        report_error(fmt::format("reserialized \"{}\" node_t differs from original at offset {}", node->name(), mismatch_offset));
+        return false;
+      }
 
       // it's easier to call this atm than the GUI's error box
       MessageBoxA(
@@ -191,15 +742,40 @@ protected:
     return true;
   }
 
+  void dump_mismatch(const std::string& nodename, const serial_tree& orig, const serial_tree& reserialized) const
+  {
+    std::string prefix = "dump_";
+    if (!filepath.empty())
+      prefix += fmt::format("{}_{}_", filepath.parent_path().filename().string(), filepath.stem().string());
+
+    std::ofstream ofs;
+    ofs.open(dumps_dir / fmt::format("{}{}_orig.bin", prefix, nodename), std::ios::binary);
+    ofs.write(orig.nodedata.data(), orig.nodedata.size());
+    ofs.close();
+    ofs.open(dumps_dir / fmt::format("{}{}_reserialized.bin", prefix, nodename), std::ios::binary);
+    ofs.write(reserialized.nodedata.data(), reserialized.nodedata.size());
+    ofs.close();
+  }
+
   bool load_node_data_struct(const shared_node_type& node, node_serializable& var)
   {
     try
     {
       if (!var.from_node(node, tree.ver()))
+      {
+        if (!interactive)
+          report_error(fmt::format("couldn't load node_t {}", node->name()));
         return false;
+      }
     }
     catch (std::exception& e)
     {
+      if (!interactive)
+      {
+        report_error(fmt::format("couldn't load node_t {}, reason: {}", node->name(), e.what()));
+        return false;
+      }
+
       MessageBoxA(0, fmt::format("couldn't load node_t {}\nreason: {}", node->name(), e.what()).c_str(), "error", 0);
       return false;
     }
@@ -207,29 +783,155 @@ protected:
     return true;
   }
 
+  void report_error(std::string msg)
+  {
+    SPDLOG_ERROR("{}: {}", filepath.filename().string(), msg);
+    std::lock_guard<std::mutex> lock(m_errors_mtx);
+    load_errors.emplace_back(std::move(msg));
+  }
+
   bool try_save_node_data_struct(node_serializable& var, std::string_view nodename)
   {
     auto node = search_node(nodename);
     if (!node)
       return false;
+
+    scoped_span span("sys.save", nodename);
+    scoped_alloc_tag alloc_scope(alloc_tag::scripting);
     auto new_node = var.to_node(tree.ver());
     if (!new_node)
       return false;
 
     auto ncnode = std::const_pointer_cast<node_t>(node);
-    ncnode->assign_children(new_node->children());
-    ncnode->assign_data(new_node->data());
+    {
+      // our own events don't make the system dirty
+      m_writing_back = true;
+      {
+        // a single bubbling up to the root
+        node_event_batch event_batch;
+        ncnode->assign_children(new_node->children());
+        ncnode->assign_data(new_node->nonconst().release_data());
+      }
+      m_writing_back = false;
+    }
+
+    // the node matches the system again
+    const size_t idx = system_index(nodename);
+    if (idx < m_dirty_systems.size())
+      m_dirty_systems[idx] = false;
 
     return true;
   }
 
+  size_t system_index(std::string_view nodename) const
+  {
+    const auto entries = const_cast<savegame*>(this)->systems();
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+      if (entries[i].first == nodename)
+        return i;
+    }
+    return entries.size();
+  }
+
+  // systems start clean once the tree is loaded, their nodes are listened
+  // to with track_dirty_systems
+  void listen_systems()
+  {
+    unlisten_systems();
+
+    const auto entries = systems();
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+      m_dirty_systems[i] = false;
+      if (!track_dirty_systems)
+        continue;
+
+      m_system_nodes[i] = search_node(entries[i].first);
+      if (m_system_nodes[i])
+        m_system_nodes[i]->add_listener(this);
+    }
+  }
+
+  void unlisten_systems()
+  {
+    for (auto& node : m_system_nodes)
+    {
+      if (node)
+        node->remove_listener(this);
+      node.reset();
+    }
+  }
+
+  void on_node_event(const shared_node_type& node, node_event_e evt) override
+  {
+    if (m_writing_back)
+      return;
+
+    for (size_t i = 0; i < m_system_nodes.size(); ++i)
+    {
+      if (m_system_nodes[i] == node)
+        m_dirty_systems[i] = true;
+    }
+  }
+
+
+  node_serializable* system_by_node_name(std::string_view nodename)
+  {
+    for (const auto& [name, var] : systems())
+    {
+      if (name == nodename)
+        return var;
+    }
+    return nullptr;
+  }
+
+  void reset_systems()
+  {
+    for (const auto& [name, var] : systems())
+      var->has_valid_data = false;
+    m_lazy_loaded.clear();
+  }
+
+  flat_tree m_flat;
+  mutable flat_tree::substitutes_map m_lifted;
+  // systems loaded by load_system in lazy mode
+  std::unordered_set<const node_serializable*> m_lazy_loaded;
+
+  // dirty tracking, in the order of systems()
+  std::array<std::atomic<bool>, 8> m_dirty_systems = {};
+  std::array<shared_node_type, 8> m_system_nodes;
+  bool m_writing_back = false;
+  bool m_lazy = false;
+
+  std::mutex m_errors_mtx;
 
 public:
   shared_node_type search_node(std::string_view name) const
   {
+    if (root && root == tree.root)
+      return tree.find_node(name);
+
     if (root)
       return search_node(root, name);
 
+    if (tree.is_partial())
+      return tree.read_partial_node(name);
+
+    if (m_lazy)
+    {
+      auto idx = m_flat.find_node(name);
+      if (idx == flat_tree::null_idx)
+        return nullptr;
+
+      auto it = m_lifted.find(idx);
+      if (it == m_lifted.end())
+      {
+        it = m_lifted.emplace(idx, m_flat.to_node(idx)).first;
+      }
+      return it->second;
+    }
+
     return nullptr;
   }
 
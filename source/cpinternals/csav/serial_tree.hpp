@@ -1,10 +1,18 @@
 #pragma once
+#include <algorithm>
 #include <iostream>
 #include <memory>
+#include <cstring>
+#include <unordered_map>
 
 #include "cpinternals/common.hpp"
+#include "cpinternals/common/parallel.hpp"
+#include "cpinternals/common/small_string.hpp"
+#include "cpinternals/common/small_vector.hpp"
+#include "cpinternals/io/memory_istream.hpp"
 #include "cpinternals/ctypes.hpp"
 #include "cpinternals/csav/node.hpp"
+#include "cpinternals/csav/payload_store.hpp"
 
 #include "cpinternals/csav/serializers.hpp"
 
@@ -12,7 +20,7 @@ namespace cp::csav {
 
 struct serial_node_desc
 {
-  std::string name;
+  small_string<24> name; // node names are short, no allocation per desc
   int32_t next_idx, child_idx;
   uint32_t data_offset, data_size;
 
@@ -29,17 +37,54 @@ struct serial_tree
 {
   serial_tree() = default;
 
-  bool from_tree(const std::shared_ptr<const node_t>& root, uint32_t data_offset)
+  // workers_cnt: see parallel_for, 1 flattens on the calling thread.
+  // with more, the top-level children of root are written concurrently:
+  // the byte and index ranges of each subtree are known upfront from the
+  // sizes and counts cached in the nodes (calcsize, treecount).
+  bool from_tree(const std::shared_ptr<const node_t>& root, uint32_t data_offset, size_t workers_cnt = 1)
   {
     // yes that looks dumb, but cdpred use first data_offset = min_offset
-    // so before creating the node descriptors i fill the buffer to min_offset
-    nodedata.resize(data_offset);
+    // so before creating the node descriptors i fill the buffer to min_offset.
+    // the final size is known upfront, nodedata is allocated once.
+    const size_t total_size = data_offset + root->calcsize();
+    nodedata.clear();
+    nodedata.resize(total_size);
 
     uint32_t node_cnt = root->treecount();
 
     descs.resize(node_cnt);
-    uint32_t next_idx = 0;
-    write_node_children(*root, next_idx);
+
+    // ranges of the top-level children (prefix sums)
+    const auto& children = root->children();
+    std::vector<write_cursor> starts(children.size() + 1);
+    starts[0] = {data_offset, 0};
+    for (size_t i = 0; i < children.size(); ++i)
+    {
+      starts[i + 1].wpos = starts[i].wpos + children[i]->calcsize();
+      starts[i + 1].next_idx = starts[i].next_idx + children[i]->treecount();
+    }
+
+    std::atomic<bool> overflow = false;
+    parallel_for(children.size(), workers_cnt, [&](size_t i)
+    {
+      write_cursor cur = starts[i];
+      write_node_visitor(*children[i], cur);
+      if (cur.wpos != starts[i + 1].wpos || cur.next_idx != starts[i + 1].next_idx)
+        overflow = true;
+    });
+
+    if (overflow || starts.back().wpos != total_size)
+      return false;
+
+    // same as write_node_children for the last top-level node
+    for (auto it = children.rbegin(); it != children.rend(); ++it)
+    {
+      if ((*it)->idx() >= 0)
+      {
+        descs[(*it)->idx()].next_idx = node_t::null_node_idx;
+        break;
+      }
+    }
 
     // check that each blob starts with its node index (dword)
     size_t i = 0;
@@ -52,27 +97,343 @@ struct serial_tree
     return true;
   }
 
+  // variant of from_tree that writes the node bytes straight to ar instead
+  // of nodedata, for saves that store them uncompressed (ps4).
+  // ar must be positioned at data_offset, nodedata only gets the zeroed
+  // prefix [0, data_offset) so that the tree is never staged whole.
+  bool write_tree(const std::shared_ptr<const node_t>& root, uint32_t data_offset, streambase& ar)
+  {
+    nodedata.clear();
+    nodedata.resize(data_offset);
+
+    descs.resize(root->treecount());
+
+    write_cursor cur = {data_offset, 0, &ar};
+    write_node_children(*root, cur);
+
+    return !ar.has_error() && cur.next_idx == descs.size()
+      && cur.wpos == data_offset + root->calcsize();
+  }
+
   std::shared_ptr<const node_t> to_tree(uint32_t data_offset)
   {
-    // check that each blob starts with its node index (dword)
-    size_t i = 0;
+    return to_tree(data_offset, nodedata);
+  }
+
+  // variant that lifts the tree from an external buffer (e.g. a mapped file)
+  // laid out like nodedata, nodedata is then left untouched.
+  std::shared_ptr<const node_t> to_tree(uint32_t data_offset, std::span<const char> srcdata)
+  {
+    if (srcdata.size() < data_offset || !check_node_indices(srcdata))
+      return nullptr;
+
+    begin_lift();
+    auto root = assemble_root(data_offset, srcdata, nullptr);
+    end_lift();
+    return root;
+  }
+
+  // when enabled, the payloads (leaf datas and blobs) of at least
+  // payload_store::min_payload_size bytes are interned in the payload_store
+  // when lifted, smaller ones are copied (nodedata isn't viewed).
+  void set_intern_payloads(bool enabled)
+  {
+    m_intern_payloads = enabled;
+  }
+
+  // moves nodedata into a shared immutable image, the blobs lifted from it
+  // then view it instead of copying their bytes (see
+  // node_t::create_shared_blob_view) and keep it alive. returns the image,
+  // nodedata is left empty.
+  std::span<const char> share_nodedata()
+  {
+    auto image = std::make_shared<const std::vector<char>>(std::move(nodedata));
+    nodedata.clear();
+    const std::span<const char> ret = *image;
+    return share_image(std::move(image), ret);
+  }
+
+  // same with an image laid out like nodedata that owner keeps alive (e.g.
+  // a mapped decoded sidecar), returns image
+  std::span<const char> share_image(std::shared_ptr<const void> owner, std::span<const char> image)
+  {
+    m_image_owner = std::move(owner);
+    m_image = image;
+    return m_image;
+  }
+
+  // checks that each node's bytes in srcdata (laid out like nodedata) start
+  // with its index (dword)
+  bool check_node_indices(std::span<const char> srcdata) const
+  {
+    uint32_t i = 0;
     for (auto& nd : descs)
     {
-      if (*(uint32_t*)(nodedata.data() + nd.data_offset) != i++)
-        return nullptr;
+      if ((uint64_t)nd.data_offset + 4 > srcdata.size())
+        return false;
+      if (*(const uint32_t*)(srcdata.data() + nd.data_offset) != i++)
+        return false;
+    }
+    return true;
+  }
+
+  // Incremental lifting (see node_tree::load_pipelined): between begin_lift
+  // and end_lift, lift_node can be called concurrently for the top-level
+  // nodes as their bytes become available, then assemble_root builds the
+  // root from the lifted ones.
+  void begin_lift()
+  {
+    // names are interned in one batch instead of once per node
+    std::vector<std::string_view> names(descs.size());
+    for (size_t j = 0; j < descs.size(); ++j)
+      names[j] = descs[j].name;
+    m_gnames = node_gname::register_strings(names);
+  }
+
+  void end_lift()
+  {
+    m_gnames.clear();
+  }
+
+  // descs indices of the children of the root in order, false if the chain
+  // is corrupted
+  bool toplevel_nodes(std::vector<uint32_t>& out) const
+  {
+    out.clear();
+    for (int32_t i = descs.empty() ? node_t::null_node_idx : 0; i >= 0; i = descs[i].next_idx)
+    {
+      if ((size_t)i >= descs.size() || out.size() == descs.size())
+        return false;
+      out.push_back((uint32_t)i);
     }
+    return true;
+  }
+
+  // root of the whole srcdata (laid out like nodedata), lifted[i] is used as
+  // the top-level node of descs[i] when set (lifted is indexed like descs),
+  // the others are lifted from srcdata.
+  std::shared_ptr<const node_t> assemble_root(uint32_t data_offset, std::span<const char> srcdata,
+    const std::vector<std::shared_ptr<const node_t>>* lifted) const
+  {
+    if (srcdata.size() < data_offset)
+      return nullptr;
 
     // fake descriptor, our buffer should be prefixed with zeroes so the *data==idx will pass..
-    const uint32_t data_size = (uint32_t)nodedata.size() - data_offset;
+    const uint32_t data_size = (uint32_t)srcdata.size() - data_offset;
     serial_node_desc root_desc {"root", node_t::null_node_idx, 0, data_offset, data_size};
-    return read_node(root_desc, node_t::root_node_idx);
+    return read_node(make_src(srcdata, 0), root_desc, node_t::root_node_idx, lifted);
+  }
+
+  // checks in one pass over descs that the tree lifted by to_tree from
+  // nodedata offsets [data_offset, data_end) covers that range exactly:
+  // nodes are at least their index dword, contained in their parent (the
+  // root covers the whole range) and siblings are ordered without overlaps.
+  // blobs fill the gaps so the lifted size is then data_end - data_offset.
+  // links must point forward (the order from_tree and the game write), false
+  // otherwise even if the layout is fine: callers fall back to calcsize.
+  bool validate_layout(uint32_t data_offset, size_t data_end) const
+  {
+    const size_t cnt = descs.size();
+    if (cnt == 0)
+      return true;
+
+    // end offset of the parent and start offset of the next sibling of each
+    // node, set when its parent or previous sibling is visited
+    std::vector<uint64_t> parent_ends(cnt, 0);
+    std::vector<uint64_t> min_starts(cnt, 0);
+    std::vector<uint8_t> reached(cnt, 0);
+
+    parent_ends[0] = data_end;
+    min_starts[0] = data_offset;
+    reached[0] = 1;
+
+    for (size_t i = 0; i < cnt; ++i)
+    {
+      const auto& d = descs[i];
+      const uint64_t start = d.data_offset;
+      const uint64_t end = start + d.data_size;
+
+      if (!reached[i] || d.data_size < 4 || start < min_starts[i] || end > parent_ends[i])
+        return false;
+
+      if (d.child_idx >= 0)
+      {
+        const size_t c = (size_t)d.child_idx;
+        if (c <= i || c >= cnt || reached[c])
+          return false;
+        reached[c] = 1;
+        parent_ends[c] = end;
+        min_starts[c] = start + 4;
+      }
+
+      if (d.next_idx >= 0)
+      {
+        const size_t n = (size_t)d.next_idx;
+        if (n <= i || n >= cnt || reached[n])
+          return false;
+        reached[n] = 1;
+        parent_ends[n] = parent_ends[i];
+        min_starts[n] = end;
+      }
+    }
+
+    return true;
+  }
+
+  // lifts the subtree of descs[idx] only, from src: a slice of nodedata that
+  // starts at nodedata offset src_offset and covers the node's range.
+  // reentrant, nodes get the interned names between begin_lift and end_lift.
+  std::shared_ptr<const node_t> lift_node(uint32_t idx, std::span<const char> src, uint32_t src_offset) const
+  {
+    if (idx >= descs.size())
+      return nullptr;
+
+    return read_node(make_src(src, src_offset), descs[idx], (int32_t)idx);
+  }
+
+  // decodes the whole node descriptors table (the 'NODE' block after its
+  // tag: packed count then descriptors) in one pass.
+  // names repeat a lot, each distinct encoded name is decoded once and
+  // copied for its other occurrences.
+  // fails if block isn't exactly the table.
+  bool decode_descs(std::span<const char> block)
+  {
+    descs.clear();
+
+    memory_istream ms(block);
+
+    int64_t cnt = 0;
+    ms.serialize_int_packed(cnt);
+    // a descriptor takes 17 bytes at least
+    if (ms.has_error() || cnt < 0 || static_cast<uint64_t>(cnt) > block.size() / 17)
+      return false;
+
+    descs.resize(static_cast<size_t>(cnt));
+
+    // encoded name (length prefix included) -> index of its first descriptor
+    std::unordered_map<std::string_view, uint32_t> first_descs;
+
+    struct fields_t
+    {
+      int32_t next_idx, child_idx;
+      uint32_t data_offset, data_size;
+    };
+    static_assert(sizeof(fields_t) == 16);
+
+    for (uint32_t i = 0; i < descs.size(); ++i)
+    {
+      auto& d = descs[i];
+
+      const size_t name_start = static_cast<size_t>(ms.tell());
+      int64_t len = 0;
+      ms.serialize_int_packed(len);
+      const size_t name_end = static_cast<size_t>(ms.tell()) + static_cast<size_t>(len < 0 ? -len : len * 2);
+      if (ms.has_error() || name_end > block.size())
+        return false;
+
+      const std::string_view encoded(block.data() + name_start, name_end - name_start);
+      const auto [it, inserted] = first_descs.emplace(encoded, i);
+      if (inserted)
+      {
+        ms.seek(static_cast<streambase::pos_type>(name_start));
+        ms.serialize_str_lpfxd(d.name);
+      }
+      else
+      {
+        d.name = descs[it->second].name;
+        ms.seek(static_cast<streambase::pos_type>(name_end));
+      }
+
+      fields_t f;
+      ms.serialize_pod_raw(f);
+      d.next_idx = f.next_idx;
+      d.child_idx = f.child_idx;
+      d.data_offset = f.data_offset;
+      d.data_size = f.data_size;
+    }
+
+    return !ms.has_error() && static_cast<size_t>(ms.tell()) == block.size();
   }
 
   std::vector<serial_node_desc> descs;
   std::vector<char> nodedata;
 
 protected:
-  std::shared_ptr<const node_t> read_node(serial_node_desc& desc, int32_t idx)
+  // bytes a tree is lifted from, data covers nodedata offsets
+  // [base, base + data.size())
+  struct lift_src
+  {
+    std::span<const char> data;
+    uint32_t base = 0;
+    // owner of the shared image, set if data is in it
+    const std::shared_ptr<const void>* image = nullptr;
+    bool intern = false;
+
+    const char* at(uint32_t offset) const
+    {
+      return data.data() + (offset - base);
+    }
+
+    // payload_store entry of the range, nullptr if it isn't interned
+    payload_store::buffer_type interned(uint32_t begin_offset, uint32_t end_offset) const
+    {
+      auto& store = payload_store::get();
+      if (!intern || end_offset < begin_offset || end_offset - begin_offset < store.min_payload_size())
+        return nullptr;
+      return store.intern({at(begin_offset), end_offset - begin_offset});
+    }
+
+    std::shared_ptr<const node_t> blob(uint32_t begin_offset, uint32_t end_offset) const
+    {
+      if (auto buffer = interned(begin_offset, end_offset))
+        return node_t::create_shared_blob_view(buffer, buffer->data(), buffer->data() + buffer->size());
+      if (image)
+        return node_t::create_shared_blob_view(*image, at(begin_offset), at(end_offset));
+      return node_t::create_shared_blob(at(begin_offset), at(end_offset));
+    }
+  };
+
+  lift_src make_src(std::span<const char> data, uint32_t base) const
+  {
+    lift_src src{data, base};
+    src.intern = m_intern_payloads;
+    if (!m_intern_payloads && m_image_owner && data.data() >= m_image.data()
+      && data.data() + data.size() <= m_image.data() + m_image.size())
+    {
+      src.image = &m_image_owner;
+    }
+    return src;
+  }
+
+  // see share_nodedata and share_image
+  std::shared_ptr<const void> m_image_owner;
+  std::span<const char> m_image;
+  bool m_intern_payloads = false;
+
+  // interned descs names while lifting a whole tree
+  std::vector<node_gname> m_gnames;
+
+  // position of a writer in nodedata and descs, one per concurrent subtree.
+  // bytes go to sink instead of nodedata when set (see write_tree).
+  struct write_cursor
+  {
+    size_t wpos = 0;
+    uint32_t next_idx = 0;
+    streambase* sink = nullptr;
+  };
+
+  void write_bytes(write_cursor& cur, const char* data, size_t size)
+  {
+    if (cur.sink)
+      cur.sink->serialize_bytes_fast((void*)data, size);
+    else
+      std::memcpy(nodedata.data() + cur.wpos, data, size);
+    cur.wpos += size;
+  }
+
+  // lifted: see assemble_root
+  std::shared_ptr<const node_t> read_node(const lift_src& src, const serial_node_desc& desc, int32_t idx,
+    const std::vector<std::shared_ptr<const node_t>>* lifted = nullptr) const
   {
     uint32_t cur_offset = desc.data_offset + 4;
     uint32_t end_offset = desc.data_offset + desc.data_size;
@@ -81,16 +442,19 @@ protected:
     if (idx == node_t::root_node_idx)
       cur_offset = desc.data_offset;
 
-    if (end_offset > nodedata.size())
+    if (desc.data_offset < src.base || end_offset - src.base > src.data.size())
       return nullptr;
 
-    if (*(uint32_t*)(nodedata.data() + desc.data_offset) != idx && idx != node_t::root_node_idx)
+    if (*(const uint32_t*)src.at(desc.data_offset) != idx && idx != node_t::root_node_idx)
       return nullptr;
 
-    auto node = node_t::create_shared(idx, desc.name);
+    auto node = (idx >= 0 && (size_t)idx < m_gnames.size())
+      ? node_t::create_shared(idx, m_gnames[idx])
+      : node_t::create_shared(idx, desc.name.strv());
     auto& nc_node = node->nonconst();
 
-    std::vector<std::shared_ptr<const node_t>> children;
+    // most nodes have a few children (blobs included)
+    small_vector<std::shared_ptr<const node_t>, 8> children;
 
     if (desc.child_idx >= 0)
     {
@@ -103,12 +467,10 @@ protected:
         auto& childdesc = descs[i];
 
         if (childdesc.data_offset > cur_offset) {
-          children.push_back(
-            node_t::create_shared_blob(nodedata.data(), cur_offset, childdesc.data_offset)
-          );
+          children.push_back(src.blob(cur_offset, childdesc.data_offset));
         }
 
-        auto childnode = read_node(childdesc, i);
+        auto childnode = (lifted && (*lifted)[i]) ? (*lifted)[i] : read_node(src, childdesc, i);
         if (!childnode) // something went wrong
           return nullptr;
         children.push_back(childnode);
@@ -118,60 +480,63 @@ protected:
       }
 
       if (cur_offset < end_offset) {
-        children.push_back(
-          node_t::create_shared_blob(nodedata.data(), cur_offset, end_offset)
-        );
+        children.push_back(src.blob(cur_offset, end_offset));
       }
 
       nc_node.assign_children(children.begin(), children.end());
     }
+    else if (auto buffer = src.interned(cur_offset, end_offset))
+    {
+      nc_node.assign_shared_data(std::move(buffer));
+    }
     else if (cur_offset < end_offset)
     {
       nc_node.assign_data(
-        nodedata.begin() + cur_offset,
-        nodedata.begin() + end_offset
+        src.at(cur_offset),
+        src.at(end_offset)
       );
     }
 
     return node;
   }
 
-  serial_node_desc* write_node_visitor(const node_t& node, uint32_t& next_idx)
+  serial_node_desc* write_node_visitor(const node_t& node, write_cursor& cur)
   {
     if (node.idx() >= 0)
     {
-      const uint32_t idx = next_idx++;
+      const uint32_t idx = cur.next_idx++;
+      if (idx >= descs.size())
+        return nullptr;
       node.nonconst().idx(idx);
 
       auto& nd = descs[idx];
-      nd.name = node.name();
-      nd.data_offset = (uint32_t)nodedata.size();
-      nd.child_idx = node.has_children() ? next_idx : node_t::null_node_idx;
+      nd.name = node.name_view();
+      nd.data_offset = (uint32_t)cur.wpos;
+      nd.child_idx = node.has_children() ? cur.next_idx : node_t::null_node_idx;
 
-      char* pIdx = (char*)&idx;
-      std::copy(pIdx, pIdx + 4, std::back_inserter(nodedata));
-      std::copy(node.data().begin(), node.data().end(), std::back_inserter(nodedata));
+      write_bytes(cur, (const char*)&idx, 4);
+      write_bytes(cur, node.data().data(), node.data().size());
 
-      write_node_children(node, next_idx);
+      write_node_children(node, cur);
 
-      nd.next_idx = (next_idx < descs.size()) ? next_idx : node_t::null_node_idx;
-      nd.data_size = (uint32_t)nodedata.size() - nd.data_offset;
+      nd.next_idx = (cur.next_idx < descs.size()) ? cur.next_idx : node_t::null_node_idx;
+      nd.data_size = (uint32_t)cur.wpos - nd.data_offset;
       return &nd;
     }
     else
     {
       // data blob
-      std::copy(node.data().begin(), node.data().end(), std::back_inserter(nodedata));
+      write_bytes(cur, node.data().data(), node.data().size());
     }
     return nullptr;
   }
 
-  void write_node_children(const node_t& node, uint32_t& next_idx)
+  void write_node_children(const node_t& node, write_cursor& cur)
   {
     serial_node_desc* last_child_desc = nullptr;
     for (auto& c : node.children())
     {
-      auto cnd = write_node_visitor(*c, next_idx);
+      auto cnd = write_node_visitor(*c, cur);
       if (cnd != nullptr)
         last_child_desc = cnd;
     }
@@ -180,5 +545,167 @@ protected:
   }
 };
 
+// Sink for serial_tree::write_tree that compares the bytes written to it with
+// the serial bytes of an expected node (as the top-level child of the root),
+// walked lazily in write order: neither side is staged in a buffer. The
+// written bytes are hashed on the way (crc64).
+// Node indices of the expected side are numbered as write_tree numbers them,
+// its nodes aren't modified.
+struct serial_bytes_comparator
+  : streambase
+{
+  static constexpr size_t no_mismatch = size_t(-1);
+
+  explicit serial_bytes_comparator(const node_t& expected)
+  {
+    m_hash.init();
+    m_frames.push_back(frame{&expected});
+  }
+
+  bool is_reader() const override
+  {
+    return false;
+  }
+
+  pos_type tell() const override
+  {
+    return static_cast<pos_type>(m_written);
+  }
+
+  // write_tree only appends
+  streambase& seek(pos_type pos) override
+  {
+    set_error("serial_bytes_comparator: seek not supported");
+    return *this;
+  }
+
+  streambase& seek(off_type off, seekdir dir) override
+  {
+    set_error("serial_bytes_comparator: seek not supported");
+    return *this;
+  }
+
+  streambase& serialize_bytes(void* data, size_t size) override
+  {
+    const char* src = static_cast<const char*>(data);
+    m_hash.update(src, size);
+
+    size_t pos = 0;
+    while (m_mismatch == no_mismatch && pos < size)
+    {
+      if (m_expected.empty())
+      {
+        m_expected = next_expected();
+        if (m_expected.empty())
+        {
+          // longer than expected
+          m_mismatch = m_written + pos;
+          break;
+        }
+      }
+
+      const size_t n = std::min(size - pos, m_expected.size());
+      if (std::memcmp(src + pos, m_expected.data(), n))
+      {
+        const auto it = std::mismatch(src + pos, src + pos + n, m_expected.data());
+        m_mismatch = m_written + (it.first - src);
+        break;
+      }
+
+      pos += n;
+      m_expected = m_expected.subspan(n);
+    }
+
+    m_written += size;
+    return *this;
+  }
+
+  // once everything has been written: true if the expected bytes have all
+  // been matched, otherwise mismatch_offset() is set
+  bool finish()
+  {
+    if (m_mismatch == no_mismatch && (m_expected.size() || next_expected().size()))
+    {
+      // shorter than expected
+      m_mismatch = m_written;
+    }
+    return m_mismatch == no_mismatch;
+  }
+
+  // offset of the first differing byte in the written bytes
+  size_t mismatch_offset() const
+  {
+    return m_mismatch;
+  }
+
+  size_t written_size() const
+  {
+    return m_written;
+  }
+
+  uint64_t written_hash() const
+  {
+    auto b = m_hash;
+    return b.finalize();
+  }
+
+protected:
+  struct frame
+  {
+    const node_t* node;
+    uint32_t stage = 0; // 0: index, 1: data, 2: children
+    size_t next_child = 0;
+  };
+
+  // next non-empty piece of the expected bytes, empty at the end
+  // (same order as write_node_visitor)
+  std::span<const char> next_expected()
+  {
+    while (!m_frames.empty())
+    {
+      auto& f = m_frames.back();
+
+      if (f.stage == 0)
+      {
+        f.stage = 1;
+        m_idx = m_next_idx++;
+        return std::span<const char>(reinterpret_cast<const char*>(&m_idx), 4);
+      }
+
+      if (f.stage == 1)
+      {
+        f.stage = 2;
+        if (f.node->data().size())
+          return f.node->data();
+        continue;
+      }
+
+      const auto& children = f.node->children();
+      if (f.next_child == children.size())
+      {
+        m_frames.pop_back();
+        continue;
+      }
+
+      const node_t& c = *children[f.next_child++];
+      if (c.idx() >= 0)
+        m_frames.push_back(frame{&c});
+      else if (c.data().size())
+        return c.data();
+    }
+
+    return {};
+  }
+
+  std::vector<frame> m_frames;
+  std::span<const char> m_expected;
+  uint32_t m_idx = 0;
+  uint32_t m_next_idx = 0;
+
+  crc64_builder m_hash;
+  size_t m_written = 0;
+  size_t m_mismatch = no_mismatch;
+};
+
 } // namespace cp::csav
 
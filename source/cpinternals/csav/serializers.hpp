@@ -3,7 +3,10 @@
 #include <iostream>
 #include <vector>
 #include <array>
-#include <codecvt>
+#include <string>
+
+#include <cpinternals/common/packed_codec.hpp>
+#include <cpinternals/common/small_string.hpp>
 
 #pragma message("serializers.hpp must disappear")
 
@@ -84,33 +87,22 @@ public:
   //template <typename U = T, std::enable_if_t<std::is_same_v<U, T> && !std::is_const_v<T>, int> = 0>
   friend std::istream& operator>>(std::istream& is, cp_packedint_ref&& v)
   {
-    char a = 0;
-    is.read(&a, 1);
-    int64_t value = a & 0x3F;
-    const bool sign = !!(a & 0x80);
-    if (a & 0x40) {
-      is.read(&a, 1);
-      value |= (a & 0x7F) << 6;
-      if (a < 0) {
-        is.read(&a, 1);
-        value |= (a & 0x7F) << 13;
-        if (a < 0) {
-          is.read(&a, 1);
-          value |= (a & 0x7F) << 20;
-          if (a < 0) {
-            is.read(&a, 1);
-            value |= (a & 0xFF) << 27;
-          }
-        }
-      }
+    // gather the encoding, then decode it at once
+    std::array<char, 5> packed {};
+    size_t cnt = 0;
+    if (is.read(&packed[cnt], 1) && (packed[cnt++] & 0x40))
+    {
+      while (cnt < 5 && is.read(&packed[cnt], 1) && (packed[cnt++] & 0x80));
     }
-    v.ref = sign ? -value : value;
+    int64_t value = 0;
+    cp::decode_packed_int(packed.data(), cnt, value);
+    v.ref = value;
     return is;
   }
 };
 
 
-template <typename T, std::enable_if_t<std::is_same_v<std::remove_const_t<T>, std::string>, int> = 0>
+template <typename T, std::enable_if_t<std::is_same_v<std::remove_const_t<T>, std::string> || cp::is_small_string<std::remove_const_t<T>>::value, int> = 0>
 class cp_plstring_ref
 {
   T& ref;
@@ -149,10 +141,11 @@ public:
     }
     else
     {
-      std::u16string str16(cnt, L'\0');
-      is.read((char*)str16.data(), cnt*2);
-      std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> convert;
-      v.ref = convert.to_bytes(str16);
+      std::string str16(cnt * 2, '\0');
+      is.read(str16.data(), cnt * 2);
+      std::string str;
+      cp::utf16_to_utf8(str16.data(), cnt, str);
+      v.ref = std::move(str);
     }
     return is;
   }
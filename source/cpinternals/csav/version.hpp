@@ -31,5 +31,44 @@ inline bool operator!=(const version& a, const version& b)
   return !(a == b);
 }
 
+// format differences between versions as compile-time flags: parsers of
+// repeated records (items, appearances) are templates over them, so that the
+// version is tested once per node instead of once per record
+template <bool AppearanceUk6s, bool ItemModUk3, bool HashedCetrNames>
+struct version_traits
+{
+  // v1 > 171: CCharacterCustomization ends with an array of strings
+  static constexpr bool appearance_uk6s = AppearanceUk6s;
+  // v1 >= 192: CItemMod ends with a CUk0ID
+  static constexpr bool item_mod_uk3 = ItemModUk3;
+  // v3 >= 195: cetr names are stored as hashes instead of strings
+  static constexpr bool hashed_cetr_names = HashedCetrNames;
+};
+
+// returns fn(version_traits<..>{}) with the traits of ver
+template <typename Fn>
+decltype(auto) dispatch_version(const version& ver, Fn&& fn)
+{
+  const bool hashed_cetr_names = ver.v3 >= 195;
+
+  if (ver.v1 >= 192)
+  {
+    if (hashed_cetr_names)
+      return fn(version_traits<true, true, true>{});
+    return fn(version_traits<true, true, false>{});
+  }
+
+  if (ver.v1 > 171)
+  {
+    if (hashed_cetr_names)
+      return fn(version_traits<true, false, true>{});
+    return fn(version_traits<true, false, false>{});
+  }
+
+  if (hashed_cetr_names)
+    return fn(version_traits<false, false, true>{});
+  return fn(version_traits<false, false, false>{});
+}
+
 } // namespace cp::csav
 
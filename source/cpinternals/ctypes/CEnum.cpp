@@ -32,6 +32,12 @@ void from_json(const nlohmann::json& j, CEnum_desc& x)
   //x.m_name = gname(j["name"].get<std::string>());
   //x.m_members = j["members"].get<std::vector<CEnum_member>>();
   j.get_to(x.m_members);
+  // the json db only lists the names, values are the indices
+  for (uint32_t i = 0; i < (uint32_t)x.m_members.size(); ++i)
+  {
+    x.m_members[i] = CEnum_member(x.m_members[i].name(), i);
+  }
+  x.index_members();
 }
 
 void to_json(nlohmann::json& j, const CEnum_resolver& x)
@@ -4,6 +4,7 @@
 #include <map>
 #include <unordered_map>
 #include <algorithm>
+#include <mutex>
 #include <spdlog/spdlog.h>
 #include <nlohmann/json.hpp>
 #include "cpinternals/common.hpp"
@@ -34,12 +35,36 @@ struct CEnum_member
 
 protected:
   gname m_name;
-  uint32_t m_value;
+  uint32_t m_value = 0;
 };
 
 
+// members are looked up with binary searches in two sorted arrays built
+// once the members are loaded: fnv1a64 of the name -> index and
+// value -> index. the arrays are never modified afterwards, lookups are
+// lock-free while systems are decoded in parallel.
+// values of saves that are missing from the db are appended with
+// add_unknown_member, under a lock, and aren't in the arrays.
 struct CEnum_desc
 {
+  static constexpr uint32_t npos = (uint32_t)-1;
+
+  struct member_ref
+  {
+    uint32_t idx = npos;
+    gname name;
+
+    explicit operator bool() const { return idx != npos; }
+  };
+
+  CEnum_desc() = default;
+
+  CEnum_desc(gname name, std::vector<CEnum_member> members)
+    : m_name(name), m_members(std::move(members))
+  {
+    index_members();
+  }
+
   gname name() const
   {
     return m_name;
@@ -50,12 +75,96 @@ struct CEnum_desc
     return m_members;
   }
 
+  const std::vector<CEnum_member>& members() const
+  {
+    return m_members;
+  }
+
+  // hash is fnv1a64(name), string pools already have it.
+  // the name of the ref doesn't read members(), which can grow meanwhile.
+  member_ref find_member(std::string_view name, uint64_t hash) const
+  {
+    auto it = std::lower_bound(m_name_index.begin(), m_name_index.end(), hash,
+      [](const name_entry& e, uint64_t h) { return e.hash < h; });
+
+    for (; it != m_name_index.end() && it->hash == hash; ++it)
+    {
+      if (it->name.strv() == name)
+        return {it->idx, it->name};
+    }
+    return {};
+  }
+
+  member_ref find_member(gname name) const
+  {
+    return find_member(name.strv(), cp::fnv1a64(name.strv()));
+  }
+
+  // index of the first member of that value, npos if there is none
+  uint32_t find_value(uint32_t value) const
+  {
+    auto it = std::lower_bound(m_value_index.begin(), m_value_index.end(), value,
+      [](const std::pair<uint32_t, uint32_t>& e, uint32_t v) { return e.first < v; });
+
+    if (it != m_value_index.end() && it->first == value)
+      return it->second;
+    return npos;
+  }
+
+  // returns the index of the member, appended if it isn't there yet
+  uint32_t add_unknown_member(gname name)
+  {
+    std::lock_guard<std::mutex> lock(m_unknown_mtx);
+    for (size_t i = m_indexed_cnt; i < m_members.size(); ++i)
+    {
+      if (m_members[i].name() == name)
+        return (uint32_t)i;
+    }
+    m_members.emplace_back(name, 0);
+    return (uint32_t)m_members.size() - 1;
+  }
+
   friend void to_json(nlohmann::json& j, const CEnum_desc& x);
   friend void from_json(const nlohmann::json& j, CEnum_desc& x);
 
 protected:
+  struct name_entry
+  {
+    uint64_t hash;
+    uint32_t idx;
+    gname name;
+  };
+
+  void index_members()
+  {
+    m_indexed_cnt = m_members.size();
+
+    m_name_index.clear();
+    m_name_index.reserve(m_members.size());
+    m_value_index.clear();
+    m_value_index.reserve(m_members.size());
+
+    for (uint32_t i = 0; i < (uint32_t)m_members.size(); ++i)
+    {
+      const auto& m = m_members[i];
+      m_name_index.push_back({cp::fnv1a64(m.name().strv()), i, m.name()});
+      m_value_index.emplace_back(m.value(), i);
+    }
+
+    // stable: duplicates resolve to the first member, like the old linear searches
+    std::stable_sort(m_name_index.begin(), m_name_index.end(),
+      [](const name_entry& a, const name_entry& b) { return a.hash < b.hash; });
+    std::stable_sort(m_value_index.begin(), m_value_index.end(),
+      [](const auto& a, const auto& b) { return a.first < b.first; });
+  }
+
   gname m_name;
   std::vector<CEnum_member> m_members;
+
+  std::vector<name_entry> m_name_index;                   // sorted by hash
+  std::vector<std::pair<uint32_t, uint32_t>> m_value_index; // sorted by value
+  size_t m_indexed_cnt = 0;
+  std::mutex m_unknown_mtx;
 };
 
 
@@ -77,6 +186,14 @@ struct CEnum_resolver
     return m_enums_map.find(enum_name) != m_enums_map.end();
   }
 
+  // doesn't intern enum_name (e.g. a ctypename read from a blob), a name
+  // that isn't in the pool can't be registered
+  bool is_registered(std::string_view enum_name) const
+  {
+    const auto name = gname::find(fnv1a64(enum_name));
+    return name && is_registered(*name);
+  }
+
   enum_desc_sptr get_enum(gname enum_name) const
   {
     auto it = m_enums_map.find(enum_name);
@@ -85,6 +202,27 @@ struct CEnum_resolver
     return nullptr;
   }
 
+  void clear()
+  {
+    m_enums_map.clear();
+  }
+
+  void reserve(size_t cnt)
+  {
+    m_enums_map.reserve(cnt);
+  }
+
+  // replaces an already registered enum of the same name
+  void register_enum(gname enum_name, const enum_desc_sptr& desc)
+  {
+    m_enums_map[enum_name] = desc;
+  }
+
+  const std::unordered_map<gname, enum_desc_sptr>& enums() const
+  {
+    return m_enums_map;
+  }
+
   friend void to_json(nlohmann::json& j, const CEnum_resolver& x);
   friend void from_json(const nlohmann::json& j, CEnum_resolver& x);
 
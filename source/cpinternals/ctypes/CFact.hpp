@@ -1,4 +1,6 @@
 #pragma once
+#include <atomic>
+#include <shared_mutex>
 #include <string>
 #include <vector>
 #include <map>
@@ -6,6 +8,7 @@
 #include <algorithm>
 #include <spdlog/spdlog.h>
 #include "cpinternals/common.hpp"
+#include "cpinternals/common/sorted_names_list.hpp"
 
 namespace cp {
 
@@ -79,6 +82,8 @@ inline bool operator!=(const CFact& a, const CFact& b)
 // resolver
 /////////////////////////////////////////
 
+// frozen by init_cpinternals like TweakDBID_resolver: lock-free lookups,
+// later names go to a guarded overflow and are listed like the others.
 struct CFact_resolver
 {
   static CFact_resolver& get()
@@ -103,17 +108,34 @@ struct CFact_resolver
 
   bool is_registered(uint32_t hash) const
   {
-    return m_invmap.find(hash) != m_invmap.end();
+    return !!find_name(hash);
   }
 
   void register_name(gname name)
   {
     CFact fact(name, 0, false);
 
+    if (is_frozen())
+    {
+      if (m_invmap.find(fact.hash()) != m_invmap.end())
+        return;
+
+      {
+        std::unique_lock<std::shared_mutex> ul(m_overflow_mtx);
+        if (!m_overflow_invmap.emplace(fact.hash(), name).second)
+          return;
+        m_has_overflow.store(true, std::memory_order_release);
+      }
+
+      // offered by the combos like the names fed at startup
+      m_list.insert(name);
+      return;
+    }
+
     auto it = m_invmap.emplace(fact.hash(), name);
     if (it.second)
     {
-      insert_sorted(m_list, name);
+      m_list.insert(name);
     }
   }
 
@@ -128,23 +150,68 @@ struct CFact_resolver
   }
 
   gname resolve(uint32_t hash) const
+  {
+    if (gname name = find_name(hash))
+      return name;
+    return gname(fmt::format("<unknown_fact:{:08X}>", hash));
+  }
+
+  // null if the hash isn't registered (unlike resolve, no placeholder name is created)
+  gname find_name(uint32_t hash) const
   {
     auto it = m_invmap.find(hash);
     if (it != m_invmap.end())
       return it->second;
-    return gname(fmt::format("<unknown_fact:{:08X}>", hash));
+
+    if (!m_has_overflow.load(std::memory_order_acquire))
+      return gname();
+
+    std::shared_lock<std::shared_mutex> sl(m_overflow_mtx);
+    auto oit = m_overflow_invmap.find(hash);
+    return oit != m_overflow_invmap.end() ? oit->second : gname();
   }
 
-  const std::vector<gname>& sorted_names() const { return m_list; }
+  void freeze()
+  {
+    m_frozen.store(true, std::memory_order_release);
+  }
+
+  bool is_frozen() const
+  {
+    return m_frozen.load(std::memory_order_acquire);
+  }
+
+  // get() gives a snapshot of the list
+  const sorted_names_list& sorted_names() const { return m_list; }
 
   void feed(const std::vector<gname>& names);
 
+  // replaces the registered names, names must be sorted and have unique
+  // hashes (see sorted_names and startup_snapshot.hpp)
+  void adopt_sorted_names(std::vector<gname> names)
+  {
+    m_invmap.clear();
+    m_invmap.reserve(names.size());
+    for (const auto& name : names)
+    {
+      m_invmap.emplace(fnv1a32(name.strv()), name);
+    }
+    m_list.assign(std::move(names));
+  }
+
 protected:
   CFact_resolver() = default;
   ~CFact_resolver() = default;
 
-  std::vector<gname> m_list;
+  sorted_names_list m_list;
   std::unordered_map<uint32_t, gname> m_invmap;
+
+  std::atomic<bool> m_frozen = false;
+
+  // names registered after freeze
+  mutable std::shared_mutex m_overflow_mtx;
+  std::unordered_map<uint32_t, gname> m_overflow_invmap;
+  std::atomic<bool> m_has_overflow = false;
 };
 
 
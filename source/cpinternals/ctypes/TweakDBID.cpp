@@ -1,6 +1,10 @@
 #include "TweakDBID.hpp"
 
+#include <algorithm>
+#include <cassert>
+
 #include "cpinternals/common.hpp"
+#include "cpinternals/common/parallel.hpp"
 
 namespace cp {
 
@@ -19,58 +23,294 @@ TweakDBID::TweakDBID(std::string_view name, bool add_to_resolver)
   }
 }
 
-void TweakDBID_resolver::register_name(gname name)
+void TweakDBID::from_names(std::span<const std::string_view> names, std::span<TweakDBID> out, bool add_to_resolver)
 {
-  auto sv = name.strv();
+  assert(out.size() >= names.size());
 
-  auto p = insert_sorted_nodupe(m_full_list, name);
-  if (!p.second)
-    return;
+  for (const auto& name : names)
+  {
+    if (name.size() > 0xFF)
+      throw std::length_error("TweakDBID's length overflow");
+  }
+
+  std::vector<uint32_t> crcs(names.size());
+  crc32_str_batch(names, crcs);
+
+  for (size_t i = 0; i < names.size(); ++i)
+  {
+    out[i] = TweakDBID(crcs[i], names[i].size());
+  }
+
+  if (add_to_resolver)
+  {
+    TweakDBID_resolver::get().feed(gname::register_strings(names));
+  }
+}
+
+namespace {
+
+constexpr std::string_view rarity_suffixes[] = {"_Rare", "_Epic", "_Legendary"};
+
+// items and attachments also get their rarity variants in the full list
+TweakDBID_category categorize(std::string_view sv, bool& has_variants)
+{
+  has_variants = false;
 
   if (sv.rfind("Ammo.", 0) == 0)
   {
-    insert_sorted(m_item_list, name);
+    return TweakDBID_category::Item;
   }
   else if (sv.rfind("Items.", 0) == 0)
   {
-    insert_sorted(m_item_list, name);
-    std::string s(sv);
-    insert_sorted_nodupe(m_full_list, gname(s + "_Rare"));
-    insert_sorted_nodupe(m_full_list, gname(s + "_Epic"));
-    insert_sorted_nodupe(m_full_list, gname(s + "_Legendary"));
+    has_variants = true;
+    return TweakDBID_category::Item;
   }
   else if (sv.rfind("AttachmentSlots.", 0) == 0)
   {
-    insert_sorted(m_attachment_list, name);
-    std::string s(sv); 
-    insert_sorted_nodupe(m_full_list, gname(s + "_Rare"));
-    insert_sorted_nodupe(m_full_list, gname(s + "_Epic"));
-    insert_sorted_nodupe(m_full_list, gname(s + "_Legendary"));
+    has_variants = true;
+    return TweakDBID_category::Attachment;
   }
   else if (sv.rfind("Vehicle.v_", 0) == 0)
   {
-    insert_sorted(m_vehicle_list, name);
+    return TweakDBID_category::Vehicle;
   }
   else if (sv.rfind("Vehicle.av_", 0) == 0)
   {
-    insert_sorted(m_vehicle_list, name);
+    return TweakDBID_category::Vehicle;
   }
-  else
+
+  return TweakDBID_category::Unknown;
+}
+
+} // namespace
+
+sorted_names_list& TweakDBID_resolver::category_list(TweakDBID_category cat)
+{
+  switch (cat)
   {
-    insert_sorted(m_unknown_list, name);
+    case TweakDBID_category::Item:         return m_item_list;
+    case TweakDBID_category::Attachment:   return m_attachment_list;
+    case TweakDBID_category::Vehicle:      return m_vehicle_list;
+    default: break;
   }
+  return m_unknown_list;
+}
+
+void TweakDBID_resolver::register_name(gname name)
+{
+  if (is_frozen())
+  {
+    // offered by the combos like the names fed at startup
+    if (register_overflow_name(name))
+      list_name(name);
+    return;
+  }
+
+  if (!list_name(name))
+    return;
 
   TweakDBID id(name, false);
-  m_tdbid_invmap[id.as_u64] = name;
-  m_crc32_invmap[id.crc] = name;
+  m_tdbid_invmap.assign(id.as_u64, name);
+  m_crc32_invmap.assign(id.crc, name);
+}
+
+bool TweakDBID_resolver::list_name(gname name)
+{
+  auto sv = name.strv();
+
+  if (!m_full_list.insert(name))
+    return false;
+
+  bool has_variants = false;
+  category_list(categorize(sv, has_variants)).insert(name);
+
+  if (has_variants)
+  {
+    std::string s(sv);
+    for (auto suffix : rarity_suffixes)
+    {
+      m_full_list.insert(gname(s + std::string(suffix)));
+    }
+  }
+
+  return true;
+}
+
+bool TweakDBID_resolver::register_overflow_name(gname name)
+{
+  TweakDBID id(name, false);
+  if (!name || m_tdbid_invmap.find(id.as_u64))
+    return false;
+
+  std::unique_lock<std::shared_mutex> ul(m_overflow_mtx);
+  if (m_overflow_invmap.find(id.as_u64))
+    return false;
+
+  m_overflow_invmap.assign(id.as_u64, name);
+  m_has_overflow.store(true, std::memory_order_release);
+  return true;
 }
 
 void TweakDBID_resolver::feed(const std::vector<gname>& names)
 {
-  m_full_list.reserve(m_full_list.size() + names.size());
-  for (auto& name : names)
+  if (is_frozen())
+  {
+    for (const auto& name : names)
+      register_name(name);
+    return;
+  }
+
+  // bulk version of register_name: lists are appended to, then sorted and
+  // deduplicated once instead of an insertion per name.
+
+  // new names, sorted by string like the lists
+  std::vector<gname> new_names(names);
+  std::sort(new_names.begin(), new_names.end());
+  new_names.erase(std::unique(new_names.begin(), new_names.end()), new_names.end());
+  new_names.erase(
+    std::remove_if(new_names.begin(), new_names.end(), [this](const gname& name) {
+      return m_full_list.contains(name);
+    }),
+    new_names.end());
+
+  const size_t new_cnt = new_names.size();
+  if (!new_cnt)
+  {
+    return;
+  }
+
+  // categories computed in parallel
+  std::vector<TweakDBID_category> cats(new_cnt);
+  std::vector<uint8_t> has_variants(new_cnt);
+  std::vector<std::string_view> new_svs(new_cnt);
+
+  constexpr size_t chunk_size = 0x2000;
+  parallel_for((new_cnt + chunk_size - 1) / chunk_size, 0, [&](size_t chunk)
+  {
+    const size_t end = std::min(new_cnt, (chunk + 1) * chunk_size);
+    for (size_t i = chunk * chunk_size; i < end; ++i)
+    {
+      const auto sv = new_names[i].strv();
+      bool hv = false;
+      cats[i] = categorize(sv, hv);
+      has_variants[i] = hv;
+      new_svs[i] = sv;
+    }
+  });
+
+  std::vector<TweakDBID> ids(new_cnt);
+  TweakDBID::from_names(new_svs, ids, false);
+
+  // rarity variants, registered in the string pool at once
+  std::vector<std::string> variant_strs;
+  for (size_t i = 0; i < new_cnt; ++i)
+  {
+    if (has_variants[i])
+    {
+      const auto sv = new_names[i].strv();
+      for (auto suffix : rarity_suffixes)
+      {
+        std::string s;
+        s.reserve(sv.size() + suffix.size());
+        s.append(sv).append(suffix);
+        variant_strs.emplace_back(std::move(s));
+      }
+    }
+  }
+
+  std::vector<std::string_view> variant_svs(variant_strs.begin(), variant_strs.end());
+  std::vector<gname> full_additions = gname::register_strings(variant_svs);
+  full_additions.insert(full_additions.end(), new_names.begin(), new_names.end());
+
+  // categories ("new_names" order is sorted so each addition list is too)
+  std::vector<gname> cat_additions[5];
+  for (size_t i = 0; i < new_cnt; ++i)
+  {
+    cat_additions[static_cast<size_t>(cats[i])].push_back(new_names[i]);
+  }
+
+  for (auto cat : {TweakDBID_category::Item, TweakDBID_category::Attachment, TweakDBID_category::Vehicle, TweakDBID_category::Unknown})
+  {
+    auto& additions = cat_additions[static_cast<size_t>(cat)];
+    if (additions.size())
+    {
+      category_list(cat).merge(std::move(additions));
+    }
+  }
+
+  m_full_list.merge(std::move(full_additions));
+
+  m_tdbid_invmap.reserve(m_tdbid_invmap.size() + new_cnt);
+  m_crc32_invmap.reserve(m_crc32_invmap.size() + new_cnt);
+  for (size_t i = 0; i < new_cnt; ++i)
+  {
+    m_tdbid_invmap.assign(ids[i].as_u64, new_names[i]);
+    m_crc32_invmap.assign(ids[i].crc, new_names[i]);
+  }
+}
+
+void TweakDBID_resolver::find_names(std::span<const TweakDBID> ids, std::span<gname> out) const
+{
+  assert(out.size() >= ids.size());
+
+  m_tdbid_invmap.find_batch(ids, out, [](const TweakDBID& id) {
+    return id.as_u64;
+  });
+
+  if (!m_has_overflow.load(std::memory_order_acquire))
+    return;
+
+  for (size_t i = 0; i < ids.size(); ++i)
+  {
+    if (!out[i])
+      out[i] = find_overflow_name(ids[i]);
+  }
+}
+
+void TweakDBID_resolver::resolve(std::span<const TweakDBID> ids, std::span<gname> out) const
+{
+  find_names(ids, out);
+
+  for (size_t i = 0; i < ids.size(); ++i)
+  {
+    if (!out[i])
+      out[i] = resolve(ids[i]);
+  }
+}
+
+TweakDBID_resolver::image TweakDBID_resolver::make_image() const
+{
+  image img;
+  img.full_list = *m_full_list.get();
+  img.item_list = *m_item_list.get();
+  img.attachment_list = *m_attachment_list.get();
+  img.vehicle_list = *m_vehicle_list.get();
+  img.unknown_list = *m_unknown_list.get();
+
+  img.ids.reserve(m_tdbid_invmap.size());
+  m_tdbid_invmap.for_each([&](uint64_t key, gname name) {
+    img.ids.emplace_back(TweakDBID(key), name);
+  });
+
+  return img;
+}
+
+void TweakDBID_resolver::adopt_image(image&& img)
+{
+  m_full_list.assign(std::move(img.full_list));
+  m_item_list.assign(std::move(img.item_list));
+  m_attachment_list.assign(std::move(img.attachment_list));
+  m_vehicle_list.assign(std::move(img.vehicle_list));
+  m_unknown_list.assign(std::move(img.unknown_list));
+
+  m_tdbid_invmap = {};
+  m_crc32_invmap = {};
+  m_tdbid_invmap.reserve(img.ids.size());
+  m_crc32_invmap.reserve(img.ids.size());
+  for (const auto& [id, name] : img.ids)
   {
-    register_name(name);
+    m_tdbid_invmap.assign(id.as_u64, name);
+    m_crc32_invmap.assign(id.crc, name);
   }
 }
 
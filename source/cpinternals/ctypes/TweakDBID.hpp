@@ -1,10 +1,16 @@
 #pragma once
 #include <inttypes.h>
+#include <intrin.h>
+#include <algorithm>
+#include <atomic>
+#include <shared_mutex>
+#include <span>
 #include <string>
 #include <vector>
 #include <unordered_map>
 #include <spdlog/spdlog.h>
 #include "cpinternals/common.hpp"
+#include "cpinternals/common/sorted_names_list.hpp"
 
 namespace cp {
 
@@ -45,6 +51,11 @@ struct TweakDBID
 
   TweakDBID& operator=(const TweakDBID&) = default;
 
+  // ids of many names (e.g. a names table), crcs are computed with
+  // crc32_str_batch. out must be as long as names, throws like the
+  // constructor.
+  static void from_names(std::span<const std::string_view> names, std::span<TweakDBID> out, bool add_to_resolver = true);
+
   TweakDBID& operator+=(const TweakDBID& rhs)
   {
     crc = crc32_combine(crc, rhs.crc, rhs.slen);
@@ -117,6 +128,167 @@ enum class TweakDBID_category
 // resolver
 /////////////////////////////////////////
 
+namespace detail {
+
+// id -> name, flat open-addressing table (linear probing).
+// ids are crc based so their low bits are used as is to pick slots,
+// null names mark empty slots. there is no erase.
+template <typename Key>
+struct tdbid_invmap
+{
+  struct slot
+  {
+    Key   key = 0;
+    gname name;
+  };
+
+  size_t size() const
+  {
+    return m_size;
+  }
+
+  void reserve(size_t cnt)
+  {
+    // load factor kept under 1/2
+    size_t capacity = 16;
+    while (capacity < cnt * 2)
+    {
+      capacity *= 2;
+    }
+
+    if (capacity > m_slots.size())
+    {
+      rehash(capacity);
+    }
+  }
+
+  // replaces the name if key is already present
+  void assign(Key key, gname name)
+  {
+    if (!name)
+    {
+      return;
+    }
+
+    if ((m_size + 1) * 2 > m_slots.size())
+    {
+      rehash(m_slots.size() ? m_slots.size() * 2 : 16);
+    }
+
+    auto& s = m_slots[find_slot_idx(key)];
+    if (!s.name)
+    {
+      s.key = key;
+      ++m_size;
+    }
+    s.name = name;
+  }
+
+  // returns a null name if not found
+  gname find(Key key) const
+  {
+    if (m_slots.empty())
+    {
+      return gname();
+    }
+
+    return m_slots[find_slot_idx(key)].name;
+  }
+
+  // out[i] = find(key_of(items[i])). the home slots of the keys
+  // prefetch_distance items ahead are prefetched meanwhile, so that the
+  // cache misses of consecutive lookups overlap.
+  template <typename T, typename KeyFn>
+  void find_batch(std::span<const T> items, std::span<gname> out, KeyFn&& key_of) const
+  {
+    constexpr size_t prefetch_distance = 8;
+
+    if (m_slots.empty())
+    {
+      std::fill_n(out.begin(), items.size(), gname());
+      return;
+    }
+
+    const size_t mask = m_slots.size() - 1;
+    const size_t cnt = items.size();
+
+    for (size_t i = 0; i < std::min(prefetch_distance, cnt); ++i)
+    {
+      prefetch_slot(static_cast<size_t>(key_of(items[i])) & mask);
+    }
+
+    for (size_t i = 0; i < cnt; ++i)
+    {
+      if (i + prefetch_distance < cnt)
+      {
+        prefetch_slot(static_cast<size_t>(key_of(items[i + prefetch_distance])) & mask);
+      }
+
+      out[i] = m_slots[find_slot_idx(static_cast<Key>(key_of(items[i])))].name;
+    }
+  }
+
+  template <typename Fn>
+  void for_each(Fn&& fn) const
+  {
+    for (const auto& s : m_slots)
+    {
+      if (s.name)
+      {
+        fn(s.key, s.name);
+      }
+    }
+  }
+
+protected:
+
+  void prefetch_slot(size_t idx) const
+  {
+    _mm_prefetch(reinterpret_cast<const char*>(m_slots.data() + idx), _MM_HINT_T0);
+  }
+
+  // returns the slot of key if present, otherwise the empty slot where it would go
+  size_t find_slot_idx(Key key) const
+  {
+    const size_t mask = m_slots.size() - 1;
+    size_t idx = static_cast<size_t>(key) & mask;
+    while (true)
+    {
+      const auto& s = m_slots[idx];
+      if (!s.name || s.key == key)
+      {
+        return idx;
+      }
+      idx = (idx + 1) & mask;
+    }
+  }
+
+  void rehash(size_t capacity)
+  {
+    std::vector<slot> old_slots(capacity);
+    std::swap(old_slots, m_slots);
+
+    for (const auto& s : old_slots)
+    {
+      if (s.name)
+      {
+        m_slots[find_slot_idx(s.key)] = s;
+      }
+    }
+  }
+
+  std::vector<slot> m_slots; // size is a power of 2
+  size_t m_size = 0;
+};
+
+} // namespace detail
+
+// Registered once at startup (feed), then frozen by init_cpinternals: the
+// maps are read-only from then on and lookups are lock-free, so saves can
+// be loaded concurrently. Names registered after freeze go to an
+// append-only overflow guarded by a shared_mutex, and are listed like the
+// others (sorted lists can be read while names are registered, see
+// sorted_names_list).
 struct TweakDBID_resolver
 {
   static TweakDBID_resolver& get()
@@ -135,7 +307,7 @@ struct TweakDBID_resolver
 
   bool is_registered(const TweakDBID& id) const
   {
-    return m_tdbid_invmap.find(id.as_u64) != m_tdbid_invmap.end();
+    return !!find_name(id);
   }
 
   void register_name(gname name);
@@ -147,13 +319,39 @@ struct TweakDBID_resolver
 
   gname resolve(const TweakDBID& id) const
   {
-    auto it = m_tdbid_invmap.find(id.as_u64);
-    if (it != m_tdbid_invmap.end())
-      return it->second;
+    if (gname name = find_name(id))
+      return name;
     return gname(fmt::format("<tdbid:{:08X}:{:02X}>", id.crc, id.slen));
   }
 
-  const std::vector<gname>& sorted_names(TweakDBID_category cat = TweakDBID_category::Unknown) const
+  // null if the id isn't registered (unlike resolve, no placeholder name is created)
+  gname find_name(const TweakDBID& id) const
+  {
+    if (gname name = m_tdbid_invmap.find(id.as_u64))
+      return name;
+    return find_overflow_name(id);
+  }
+
+  // find_name of each id, out must be as long as ids. for big spans of ids
+  // (exports, indexing of many saves): the lookups are random accesses in a
+  // table bigger than the caches, they are prefetched a few ids ahead.
+  void find_names(std::span<const TweakDBID> ids, std::span<gname> out) const;
+
+  // resolve of each id, same as find_names
+  void resolve(std::span<const TweakDBID> ids, std::span<gname> out) const;
+
+  void freeze()
+  {
+    m_frozen.store(true, std::memory_order_release);
+  }
+
+  bool is_frozen() const
+  {
+    return m_frozen.load(std::memory_order_acquire);
+  }
+
+  // get() gives a snapshot of the list
+  const sorted_names_list& sorted_names(TweakDBID_category cat = TweakDBID_category::Unknown) const
   {
     switch (cat)
     {
@@ -166,23 +364,66 @@ struct TweakDBID_resolver
     return m_unknown_list;
   }
 
+  // bulk registration, same lists as calling register_name for each name
+  // but each list is sorted once
   void feed(const std::vector<gname>& names);
 
+  // whole state of the resolver, see startup_snapshot.hpp
+  struct image
+  {
+    std::vector<gname> full_list;
+    std::vector<gname> item_list;
+    std::vector<gname> attachment_list;
+    std::vector<gname> vehicle_list;
+    std::vector<gname> unknown_list;
+    // registered names (rarity variants are only in the full list)
+    std::vector<std::pair<TweakDBID, gname>> ids;
+  };
+
+  image make_image() const;
+
+  // replaces the state, lists of img are already sorted
+  void adopt_image(image&& img);
+
 protected:
   TweakDBID_resolver() = default;
   ~TweakDBID_resolver() = default;
 
-  std::vector<gname> m_full_list;
+  sorted_names_list& category_list(TweakDBID_category cat);
+
+  // adds name to the sorted lists, returns false if it was already listed
+  bool list_name(gname name);
+
+  // returns false if the name was already registered
+  bool register_overflow_name(gname name);
+
+  gname find_overflow_name(const TweakDBID& id) const
+  {
+    if (!m_has_overflow.load(std::memory_order_acquire))
+      return gname();
+
+    std::shared_lock<std::shared_mutex> sl(m_overflow_mtx);
+    return m_overflow_invmap.find(id.as_u64);
+  }
 
-  std::unordered_map<uint64_t, gname> m_tdbid_invmap;
-  std::unordered_map<uint32_t, gname> m_crc32_invmap;
+  sorted_names_list m_full_list;
+
+  detail::tdbid_invmap<uint64_t> m_tdbid_invmap;
+  detail::tdbid_invmap<uint32_t> m_crc32_invmap;
 
   // filtered lists
 
-  std::vector<gname> m_item_list;
-  std::vector<gname> m_attachment_list;
-  std::vector<gname> m_vehicle_list;
-  std::vector<gname> m_unknown_list;
+  sorted_names_list m_item_list;
+  sorted_names_list m_attachment_list;
+  sorted_names_list m_vehicle_list;
+  sorted_names_list m_unknown_list;
+
+  std::atomic<bool> m_frozen = false;
+
+  // names registered after freeze
+  mutable std::shared_mutex m_overflow_mtx;
+  detail::tdbid_invmap<uint64_t> m_overflow_invmap;
+  std::atomic<bool> m_has_overflow = false;
 };
 
 
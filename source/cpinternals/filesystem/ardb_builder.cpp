@@ -0,0 +1,332 @@
+#include <cpinternals/filesystem/ardb_builder.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <unordered_map>
+
+#include <cpinternals/common/instrumentation.hpp>
+#include <cpinternals/common/parallel.hpp>
+#include <cpinternals/common/path.hpp>
+#include <cpinternals/io/file_ostream.hpp>
+
+namespace cp::filesystem {
+
+namespace {
+
+// candidates hashed per job
+constexpr size_t match_chunk_size = 0x4000;
+
+struct fid_ref
+{
+  uint64_t hash;
+  uint32_t archive_idx;
+};
+
+struct match_ref
+{
+  uint32_t archive_idx;
+  uint32_t candidate_idx;
+};
+
+struct build_node
+{
+  std::string_view name;
+  int32_t parent; // node index, ardb_root_idx for top-level ones
+  bool is_file;
+};
+
+} // namespace
+
+void ardb_builder::add_archive(const std::shared_ptr<const archive>& ar)
+{
+  auto& res = m_results.emplace_back();
+  res.ar = ar;
+  res.files_cnt = ar->size();
+}
+
+void ardb_builder::add_candidates(std::vector<std::string>&& candidates)
+{
+  if (m_candidates.empty())
+  {
+    m_candidates = std::move(candidates);
+    return;
+  }
+
+  m_candidates.reserve(m_candidates.size() + candidates.size());
+  std::move(candidates.begin(), candidates.end(), std::back_inserter(m_candidates));
+}
+
+bool ardb_builder::add_candidates_file(const std::filesystem::path& list_path)
+{
+  std::ifstream ifs(list_path);
+  if (!ifs.is_open())
+  {
+    SPDLOG_ERROR("couldn't open {}", list_path.string());
+    return false;
+  }
+
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline(ifs, line))
+  {
+    if (!line.empty() && line.back() == '\r')
+    {
+      line.pop_back();
+    }
+    if (line.size())
+    {
+      lines.emplace_back(std::move(line));
+    }
+  }
+
+  add_candidates(std::move(lines));
+  return true;
+}
+
+void ardb_builder::match(size_t workers_cnt)
+{
+  scoped_span span("fs.ardb_match");
+
+  span_sink* const sink = current_span_sink();
+  const uint32_t depth = current_span_depth();
+
+  // every archive's file ids in one sorted index
+  std::vector<fid_ref> index;
+  {
+    size_t records_cnt = 0;
+    for (const auto& res : m_results)
+    {
+      records_cnt += res.ar->records().size();
+    }
+    index.reserve(records_cnt);
+
+    for (uint32_t ar_idx = 0; ar_idx < m_results.size(); ++ar_idx)
+    {
+      for (const auto& rec : m_results[ar_idx].ar->records())
+      {
+        index.push_back({rec.fid.hash, ar_idx});
+      }
+    }
+
+    std::sort(index.begin(), index.end(), [](const fid_ref& a, const fid_ref& b) {
+      return a.hash < b.hash || (a.hash == b.hash && a.archive_idx < b.archive_idx);
+    });
+  }
+
+  // candidates are hashed without being normalized into strings, only
+  // matching ones are
+  const size_t chunks_cnt = (m_candidates.size() + match_chunk_size - 1) / match_chunk_size;
+  std::vector<std::vector<match_ref>> chunk_matches(chunks_cnt);
+
+  parallel_for(chunks_cnt, workers_cnt, [&](size_t chunk_idx)
+  {
+    scoped_span_sink job_sink(sink, depth);
+
+    const size_t beg = chunk_idx * match_chunk_size;
+    const size_t end = std::min(beg + match_chunk_size, m_candidates.size());
+
+    auto& matches = chunk_matches[chunk_idx];
+    for (size_t i = beg; i < end; ++i)
+    {
+      bool success = false;
+      const path_id pid = path_id::from_string(m_candidates[i], success);
+      if (!success)
+      {
+        continue;
+      }
+
+      auto it = std::lower_bound(index.begin(), index.end(), pid.hash, [](const fid_ref& ref, uint64_t hash) {
+        return ref.hash < hash;
+      });
+      for (; it != index.end() && it->hash == pid.hash; ++it)
+      {
+        matches.push_back({it->archive_idx, static_cast<uint32_t>(i)});
+      }
+    }
+  });
+
+  std::vector<std::vector<uint32_t>> candidates_by_archive(m_results.size());
+  for (const auto& matches : chunk_matches)
+  {
+    for (const auto& m : matches)
+    {
+      candidates_by_archive[m.archive_idx].push_back(m.candidate_idx);
+    }
+  }
+  chunk_matches.clear();
+
+  parallel_for(m_results.size(), workers_cnt, [&](size_t ar_idx)
+  {
+    scoped_span_sink job_sink(sink, depth);
+
+    auto& paths = m_results[ar_idx].paths;
+    paths.clear();
+    paths.reserve(candidates_by_archive[ar_idx].size());
+
+    for (uint32_t candidate_idx : candidates_by_archive[ar_idx])
+    {
+      bool success = false;
+      path p(m_candidates[candidate_idx], success);
+      if (success)
+      {
+        paths.emplace_back(p.strv());
+      }
+    }
+
+    // the same path can be listed with different spellings
+    std::sort(paths.begin(), paths.end());
+    paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+  });
+}
+
+bool ardb_builder::write_all(const std::filesystem::path& out_dir, size_t workers_cnt) const
+{
+  scoped_span span("fs.ardb_write");
+
+  std::error_code ec;
+  std::filesystem::create_directories(out_dir, ec);
+
+  span_sink* const sink = current_span_sink();
+  const uint32_t depth = current_span_depth();
+
+  std::vector<char> oks(m_results.size(), 0);
+
+  parallel_for(m_results.size(), workers_cnt, [&](size_t ar_idx)
+  {
+    scoped_span_sink job_sink(sink, depth);
+
+    const auto& res = m_results[ar_idx];
+    const auto ardb_path = out_dir / res.ar->path().filename().replace_extension("ardb");
+    oks[ar_idx] = write_ardb(ardb_path, res.paths) ? 1 : 0;
+    if (!oks[ar_idx])
+    {
+      SPDLOG_ERROR("couldn't write {}", ardb_path.string());
+    }
+  });
+
+  return std::all_of(oks.begin(), oks.end(), [](char ok) { return ok != 0; });
+}
+
+bool ardb_builder::write_ardb(const std::filesystem::path& ardb_path, std::span<const std::string> paths)
+{
+  // hierarchy, directories are keyed by their full path
+
+  std::vector<build_node> nodes;
+  std::unordered_map<std::string_view, int32_t> dir_nodes;
+  nodes.reserve(paths.size() * 2);
+  dir_nodes.reserve(paths.size());
+
+  for (const auto& p : paths)
+  {
+    const std::string_view sv = p;
+    int32_t parent = ardb_root_idx;
+
+    size_t name_beg = 0;
+    for (size_t sep = sv.find('\\'); sep != std::string_view::npos; sep = sv.find('\\', name_beg))
+    {
+      auto [it, inserted] = dir_nodes.try_emplace(sv.substr(0, sep), static_cast<int32_t>(nodes.size()));
+      if (inserted)
+      {
+        nodes.push_back({sv.substr(name_beg, sep - name_beg), parent, false});
+      }
+      parent = it->second;
+      name_beg = sep + 1;
+    }
+
+    nodes.push_back({sv.substr(name_beg), parent, true});
+  }
+
+  // breadth-first order, siblings sorted by name (directories first)
+
+  std::vector<std::vector<int32_t>> children(nodes.size());
+  std::vector<int32_t> order;
+  order.reserve(nodes.size());
+
+  for (int32_t i = 0; i < static_cast<int32_t>(nodes.size()); ++i)
+  {
+    if (nodes[i].parent == ardb_root_idx)
+    {
+      order.push_back(i);
+    }
+    else
+    {
+      children[nodes[i].parent].push_back(i);
+    }
+  }
+
+  const auto sibling_less = [&](int32_t a, int32_t b) {
+    if (nodes[a].is_file != nodes[b].is_file)
+    {
+      return !nodes[a].is_file;
+    }
+    return nodes[a].name < nodes[b].name;
+  };
+
+  std::sort(order.begin(), order.end(), sibling_less);
+  for (size_t k = 0; k < order.size(); ++k)
+  {
+    auto& c = children[order[k]];
+    std::sort(c.begin(), c.end(), sibling_less);
+    order.insert(order.end(), c.begin(), c.end());
+  }
+
+  // names, directory names first
+
+  std::vector<std::string_view> dirnames, filenames;
+  for (const auto& node : nodes)
+  {
+    (node.is_file ? filenames : dirnames).push_back(node.name);
+  }
+
+  for (auto* names : {&dirnames, &filenames})
+  {
+    std::sort(names->begin(), names->end());
+    names->erase(std::unique(names->begin(), names->end()), names->end());
+  }
+
+  const auto name_idx = [&](const build_node& node) {
+    const auto& names = node.is_file ? filenames : dirnames;
+    const size_t idx = std::lower_bound(names.begin(), names.end(), node.name) - names.begin();
+    return static_cast<uint32_t>(node.is_file ? dirnames.size() + idx : idx);
+  };
+
+  // records, parents are written before their children
+
+  std::vector<int32_t> record_indices(nodes.size());
+  std::vector<ardb_record> recs;
+  recs.reserve(order.size());
+
+  for (int32_t node_idx : order)
+  {
+    const auto& node = nodes[node_idx];
+    record_indices[node_idx] = static_cast<int32_t>(recs.size());
+    recs.push_back({name_idx(node), node.parent == ardb_root_idx ? ardb_root_idx : record_indices[node.parent]});
+  }
+
+  ardb_header hdr;
+  hdr.names_cnt = static_cast<uint32_t>(dirnames.size() + filenames.size());
+  hdr.dirnames_cnt = static_cast<uint32_t>(dirnames.size());
+  hdr.entries_cnt = static_cast<uint32_t>(recs.size());
+
+  file_ostream ofs(ardb_path);
+  if (!ofs.good())
+  {
+    return false;
+  }
+
+  ofs.serialize_pod_raw(hdr);
+  for (auto* names : {&dirnames, &filenames})
+  {
+    for (const auto& name : *names)
+    {
+      std::string s(name);
+      ofs.serialize_str_lpfxd(s);
+    }
+  }
+  ofs.serialize_pods_array_raw(recs.data(), recs.size());
+
+  ofs.close();
+  return !ofs.has_error();
+}
+
+} // namespace cp::filesystem
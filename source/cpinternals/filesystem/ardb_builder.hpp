@@ -0,0 +1,88 @@
+#pragma once
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cpinternals/common.hpp>
+#include <cpinternals/archive/archive.hpp>
+
+namespace cp::filesystem {
+
+// ardb format (custom thing, not cdpr's), see treefs::load_ardb
+struct ardb_header
+{
+  uint32_t magic = 'ARDB';
+  uint32_t names_cnt;
+  uint32_t dirnames_cnt;
+  uint32_t entries_cnt;
+
+  bool is_magic_ok() const
+  {
+    return magic == 'ARDB';
+  }
+};
+
+struct ardb_record
+{
+  uint32_t name_idx;
+  int32_t parent_idx;
+};
+
+constexpr int32_t ardb_root_idx = -1;
+
+// Generates the ardbs of a set of archives from lists of candidate paths
+// (e.g. internal_names.txt, archive_names.txt).
+// Candidates are hashed in parallel and joined with the file ids of every
+// archive (one sorted index of all of them), then each archive's ardb is
+// built from the paths of its identified files.
+// Written ardbs are breadth-first with siblings sorted by name, and names
+// are sorted too, so load_ardb reads its levels as contiguous runs.
+struct ardb_builder
+{
+  struct archive_result
+  {
+    std::shared_ptr<const archive> ar;
+    std::vector<std::string> paths; // normalized, sorted, unique
+    size_t files_cnt = 0;
+  };
+
+  ardb_builder() = default;
+
+  void add_archive(const std::shared_ptr<const archive>& ar);
+
+  // candidate paths, they are normalized when matched
+  void add_candidates(std::vector<std::string>&& candidates);
+
+  // one candidate per line, empty lines are skipped
+  bool add_candidates_file(const std::filesystem::path& list_path);
+
+  size_t candidates_cnt() const
+  {
+    return m_candidates.size();
+  }
+
+  // workers_cnt: 0 means one per hardware thread, 1 disables threading
+  void match(size_t workers_cnt = 0);
+
+  // by archive, in add_archive order
+  const std::vector<archive_result>& results() const
+  {
+    return m_results;
+  }
+
+  // writes <out_dir>/<archive stem>.ardb for each archive (the name
+  // treefs::mount_archive looks for), returns false if any write failed
+  bool write_all(const std::filesystem::path& out_dir, size_t workers_cnt = 0) const;
+
+  // paths must be normalized (see cp::path)
+  static bool write_ardb(const std::filesystem::path& ardb_path, std::span<const std::string> paths);
+
+protected:
+  std::vector<std::string> m_candidates;
+  std::vector<archive_result> m_results;
+};
+
+} // namespace cp::filesystem
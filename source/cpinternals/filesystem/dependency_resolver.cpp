@@ -0,0 +1,151 @@
+#include <cpinternals/filesystem/dependency_resolver.hpp>
+
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <cpinternals/common/instrumentation.hpp>
+#include <cpinternals/common/parallel.hpp>
+
+namespace cp::filesystem {
+
+std::vector<path_id> dependency_resolver::dependencies(path_id pid, size_t* missing_cnt) const
+{
+  std::vector<path_id> ret;
+
+  const file_handle fh = m_tfs.get_file_handle(pid);
+  if (!fh.is_valid())
+  {
+    return ret;
+  }
+
+  const auto& ar = fh.source_archive();
+  const auto& deps_irange = ar->records()[fh.file_index()].deps_irange;
+  if (deps_irange.end() > ar->dependencies().size())
+  {
+    SPDLOG_ERROR("invalid deps_irange");
+    return ret;
+  }
+
+  for (const auto& dep : deps_irange.slice(ar->dependencies()))
+  {
+    const path_id dep_pid(dep.hpath);
+    if (m_tfs.get_file_handle(dep_pid).is_valid())
+    {
+      ret.push_back(dep_pid);
+    }
+    else if (missing_cnt)
+    {
+      ++*missing_cnt;
+    }
+  }
+
+  return ret;
+}
+
+std::vector<path_id> dependency_resolver::closure(std::span<const path_id> pids, size_t max_depth, size_t* missing_cnt) const
+{
+  std::vector<path_id> ret;
+  std::unordered_set<path_id> visited;
+
+  for (const auto& pid : pids)
+  {
+    if (m_tfs.get_file_handle(pid).is_valid() && visited.insert(pid).second)
+    {
+      ret.push_back(pid);
+    }
+  }
+
+  // ret is the queue, [level_beg, level_end) are the files of the current depth
+  size_t level_beg = 0;
+  for (size_t depth = 0; depth < max_depth && level_beg < ret.size(); ++depth)
+  {
+    const size_t level_end = ret.size();
+    for (size_t i = level_beg; i < level_end; ++i)
+    {
+      for (const auto& dep_pid : dependencies(ret[i], missing_cnt))
+      {
+        if (visited.insert(dep_pid).second)
+        {
+          ret.push_back(dep_pid);
+        }
+      }
+    }
+    level_beg = level_end;
+  }
+
+  return ret;
+}
+
+bool dependency_resolver::prefetch(std::span<const path_id> pids, std::vector<prefetched_file>& out,
+  size_t max_depth, size_t workers_cnt) const
+{
+  scoped_span span("fs.prefetch");
+
+  const auto files = closure(pids, max_depth);
+
+  out.clear();
+  out.resize(files.size());
+
+  // files are grouped by archive, each group is a single batched read
+  struct group
+  {
+    std::vector<uint32_t> file_indices;
+    std::vector<size_t> out_indices;
+  };
+
+  std::unordered_map<const archive*, group> groups;
+  for (size_t i = 0; i < files.size(); ++i)
+  {
+    out[i].pid = files[i];
+    out[i].handle = m_tfs.get_file_handle(files[i]);
+
+    auto& grp = groups[out[i].handle.source_archive().get()];
+    grp.file_indices.push_back(out[i].handle.file_index());
+    grp.out_indices.push_back(i);
+  }
+
+  // disk bytes of out[i], decoded afterwards
+  std::vector<std::vector<char>> raws(files.size());
+  uint64_t read_size = 0;
+
+  for (auto& [ar, grp] : groups)
+  {
+    std::vector<std::vector<char>> dsts;
+    if (!ar->read_files_raw(grp.file_indices, dsts))
+    {
+      SPDLOG_ERROR("couldn't read the files from {}", ar->path().string());
+      return false;
+    }
+
+    for (size_t j = 0; j < dsts.size(); ++j)
+    {
+      read_size += dsts[j].size();
+      raws[grp.out_indices[j]] = std::move(dsts[j]);
+    }
+  }
+
+  span.set_bytes(read_size);
+
+  std::atomic<bool> failed = false;
+  span_sink* const sink = current_span_sink();
+  const uint32_t depth = current_span_depth();
+
+  parallel_for(files.size(), workers_cnt, [&](size_t i)
+  {
+    scoped_span_sink job_sink(sink, depth);
+
+    auto& file = out[i];
+    const auto& ar = file.handle.source_archive();
+    if (!ar->decode_file_raw(file.handle.file_index(), raws[i], file.data))
+    {
+      failed = true;
+    }
+    raws[i] = {};
+  });
+
+  return !failed;
+}
+
+} // namespace cp::filesystem
+
@@ -0,0 +1,60 @@
+#pragma once
+#include <vector>
+
+#include <cpinternals/common.hpp>
+#include <cpinternals/filesystem/treefs.hpp>
+
+namespace cp::filesystem {
+
+// Dependency graph of the files of a treefs.
+// Archive records list the resources a file references (radr::dependency,
+// their path hashes), these are the pids of the tree. The dependencies of a
+// file are the ones of the record that is mounted (the last override).
+// Dependencies that aren't in the tree (not loaded archives) are skipped.
+//
+// prefetch() reads a file and its transitive dependencies with one batched
+// read per archive (see archive::read_files_raw) instead of one blocking
+// read per file, e.g. a mesh with its materials and textures.
+struct dependency_resolver
+{
+  struct prefetched_file
+  {
+    path_id pid;
+    file_handle handle;
+    std::vector<char> data; // as read by archive::read_file
+  };
+
+  explicit dependency_resolver(const treefs& tfs)
+    : m_tfs(tfs) {}
+
+  // direct dependencies of a file, in record order.
+  // empty if pid isn't a file, missing_cnt counts the ones not in the tree.
+  std::vector<path_id> dependencies(path_id pid, size_t* missing_cnt = nullptr) const;
+
+  // files reachable from pids (themselves included) in breadth-first order,
+  // each once. max_depth 0 only returns the files of pids.
+  std::vector<path_id> closure(std::span<const path_id> pids, size_t max_depth = SIZE_MAX, size_t* missing_cnt = nullptr) const;
+
+  std::vector<path_id> closure(path_id pid, size_t max_depth = SIZE_MAX, size_t* missing_cnt = nullptr) const
+  {
+    return closure(std::span<const path_id>(&pid, 1), max_depth, missing_cnt);
+  }
+
+  // reads the files of closure(pids, max_depth), in that order.
+  // first segments are decompressed over workers_cnt threads (0 means one
+  // per hardware thread, 1 disables threading) and kept in the segment cache.
+  bool prefetch(std::span<const path_id> pids, std::vector<prefetched_file>& out,
+    size_t max_depth = SIZE_MAX, size_t workers_cnt = 0) const;
+
+  bool prefetch(path_id pid, std::vector<prefetched_file>& out,
+    size_t max_depth = SIZE_MAX, size_t workers_cnt = 0) const
+  {
+    return prefetch(std::span<const path_id>(&pid, 1), out, max_depth, workers_cnt);
+  }
+
+protected:
+  const treefs& m_tfs;
+};
+
+} // namespace cp::filesystem
+
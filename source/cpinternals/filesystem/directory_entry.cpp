@@ -5,10 +5,12 @@ namespace cp::filesystem {
 void directory_entry::assign_entry(int32_t entry_idx, bool refresh_tfs_path)
 {
   m_ar = nullptr;
+  m_entry_idx = -1;
 
   if (!m_tfs || !m_tfs->is_valid_entry_index(entry_idx))
   {
     m_entry = treefs::entry();
+    m_name = {};
     m_info.id = {};
     if (refresh_tfs_path)
     {
@@ -20,6 +22,8 @@ void directory_entry::assign_entry(int32_t entry_idx, bool refresh_tfs_path)
     const treefs::entry& e = m_tfs->m_entries[entry_idx];
 
     m_entry = e;
+    m_name = m_tfs->get_name(e);
+    m_entry_idx = entry_idx;
 
     if (e.is_file())
     {
@@ -62,6 +62,58 @@ struct directory_entry
     refresh();
   }
 
+  // pid of a path given as characters (e.g. WinFsp's UTF-16 names), computed
+  // without building the path (see path_id_hasher). pid strings are handled as
+  // in assign(const path_type&), by_pid is then set.
+  // success is false if the path can't be normalized.
+  template <class CharT>
+  static path_id lookup_pid(std::basic_string_view<CharT> s, bool& by_pid, bool& success)
+  {
+    path_id_hasher hasher;
+    success = hasher.append(s);
+    by_pid = false;
+
+    if (success && hasher.length() == 16)
+    {
+      uint64_t hash = 0;
+      size_t digits_cnt = 0;
+      for (const CharT tc : s)
+      {
+        const char c = static_cast<char>(std::tolower(static_cast<char>(tc)));
+        if (c == '/' || c == '\\')
+        {
+          continue;
+        }
+
+        uint64_t digit = 0;
+        if (c >= '0' && c <= '9')
+        {
+          digit = c - '0';
+        }
+        else if (c >= 'a' && c <= 'f')
+        {
+          digit = c - 'a' + 10;
+        }
+        else
+        {
+          digits_cnt = 0;
+          break;
+        }
+
+        hash = (hash << 4) | digit;
+        ++digits_cnt;
+      }
+
+      if (digits_cnt == 16)
+      {
+        by_pid = true;
+        return path_id(hash);
+      }
+    }
+
+    return hasher.result();
+  }
+
   void assign(path_id pid)
   {
     m_by_pid = true;
@@ -112,12 +164,13 @@ struct directory_entry
 
   inline path_type filename() const
   {
-    return path_type(m_entry.name.strv(), path_type::already_normalized_tag{});
+    return path_type(m_name.strv(), path_type::already_normalized_tag{});
   }
 
+  // views this directory_entry's name buffer for unidentified files
   inline std::string_view filename_strv() const
   {
-    return m_entry.name.strv();
+    return m_name.strv();
   }
 
   std::optional<path_type> depot_path() const
@@ -168,6 +221,18 @@ struct directory_entry
     return m_info;
   }
 
+  // size of a file or total size of the files below a directory,
+  // with files' first segment decompressed (no scan, kept by the tree)
+  inline uint64_t tree_size() const
+  {
+    return exists() ? m_tfs->get_sizes(m_entry_idx).size : 0;
+  }
+
+  inline uint64_t tree_disk_size() const
+  {
+    return exists() ? m_tfs->get_sizes(m_entry_idx).disk_size : 0;
+  }
+
   // only root should have no parent..
   inline bool has_parent() const
   {
@@ -218,17 +283,31 @@ struct directory_entry
 
   void assign_first_child()
   {
-    assign_entry(m_entry.first_child_entry_idx, false);
+    assign_child_entry(m_entry.first_child_entry_idx);
+  }
+
+  // assigns the first child whose name starts with prefix (lower case),
+  // a range scan of the sorted children if the tree is compact
+  void assign_first_child_with_prefix(std::string_view prefix)
+  {
+    assign_child_entry(m_tfs ? m_tfs->find_first_child_with_prefix(m_entry_idx, prefix) : -1);
+  }
+
+  // same as assign_next but skips siblings whose name doesn't start with prefix
+  bool assign_next_with_prefix(std::string_view prefix)
+  {
+    assign_entry(m_tfs ? m_tfs->find_next_with_prefix(m_entry_idx, prefix) : -1, false);
     if (exists())
     {
-      m_tfs_parent_path.append(m_entry.name.strv(), path::already_normalized_tag());
       m_path = tfs_path();
       m_pid = path_id(m_path);
+      return true;
     }
     else
     {
       *this = directory_entry();
     }
+    return false;
   }
 
   file_handle get_file_handle() const
@@ -240,6 +319,24 @@ protected:
 
   void assign_entry(int32_t entry_idx, bool refresh_tfs_path = true);
 
+  // child_entry_idx must be a child of the current entry (or -1)
+  void assign_child_entry(int32_t child_entry_idx)
+  {
+    // this entry's path becomes the parent path
+    path_type parent_path = tfs_path();
+    assign_entry(child_entry_idx, false);
+    if (exists())
+    {
+      m_tfs_parent_path = std::move(parent_path);
+      m_path = tfs_path();
+      m_pid = path_id(m_path);
+    }
+    else
+    {
+      *this = directory_entry();
+    }
+  }
+
 private:
 
   const treefs* m_tfs = nullptr;
@@ -249,6 +346,8 @@ private:
 
   path_type     m_tfs_parent_path; // the path of the entry's directory in the tree
   treefs::entry m_entry;
+  detail::treefs::entry_name m_name;
+  int32_t       m_entry_idx = -1;
   file_info     m_info;
   const archive* m_ar;
 };
@@ -0,0 +1,203 @@
+#include <cpinternals/filesystem/override_table.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+#include <cpinternals/common/instrumentation.hpp>
+#include <cpinternals/common/parallel.hpp>
+
+namespace cp::filesystem {
+
+namespace {
+
+constexpr size_t partitions_cnt = 64;
+
+inline size_t partition_of(path_id pid)
+{
+  return static_cast<size_t>(pid.hash ^ (pid.hash >> 32)) & (partitions_cnt - 1);
+}
+
+struct record_ref
+{
+  path_id pid;
+  override_table::source src;
+};
+
+} // namespace
+
+void override_table::build(const treefs& tfs, size_t workers_cnt)
+{
+  scoped_span span("fs.overrides");
+
+  clear();
+
+  const auto& archives = tfs.archives();
+
+  span_sink* const sink = current_span_sink();
+  const uint32_t depth = current_span_depth();
+
+  // partitioning: parts[archive][partition]
+  std::vector<std::vector<std::vector<record_ref>>> parts(archives.size());
+
+  parallel_for(archives.size(), workers_cnt, [&](size_t ar_idx)
+  {
+    scoped_span_sink job_sink(sink, depth);
+
+    auto& ar_parts = parts[ar_idx];
+    ar_parts.resize(partitions_cnt);
+
+    const auto& records = archives[ar_idx]->records();
+    for (auto& part : ar_parts)
+    {
+      part.reserve(records.size() / partitions_cnt + 1);
+    }
+
+    for (uint32_t file_idx = 0; file_idx < records.size(); ++file_idx)
+    {
+      const path_id pid(records[file_idx].fid);
+      ar_parts[partition_of(pid)].push_back({pid, {static_cast<uint32_t>(ar_idx), file_idx}});
+    }
+  });
+
+  // join: each partition is built from the archives in mount order, so the
+  // sources of an override are in mount order too
+  std::vector<std::vector<file_override>> joined(partitions_cnt);
+
+  parallel_for(partitions_cnt, workers_cnt, [&](size_t part_idx)
+  {
+    scoped_span_sink job_sink(sink, depth);
+
+    // pid -> index in overrides, or -1 - (packed source) for a pid seen once
+    std::unordered_map<path_id, int64_t> slots;
+    auto& overrides = joined[part_idx];
+
+    size_t refs_cnt = 0;
+    for (const auto& ar_parts : parts)
+    {
+      refs_cnt += ar_parts[part_idx].size();
+    }
+    slots.reserve(refs_cnt);
+
+    for (const auto& ar_parts : parts)
+    {
+      for (const auto& ref : ar_parts[part_idx])
+      {
+        const int64_t packed_src = (int64_t(ref.src.archive_idx) << 32) | ref.src.file_idx;
+
+        auto [it, inserted] = slots.try_emplace(ref.pid, -1 - packed_src);
+        if (inserted)
+        {
+          continue;
+        }
+
+        if (it->second < 0)
+        {
+          const int64_t first_src = -1 - it->second;
+          auto& ov = overrides.emplace_back();
+          ov.pid = ref.pid;
+          ov.sources.push_back({static_cast<uint32_t>(first_src >> 32), static_cast<uint32_t>(first_src)});
+          it->second = static_cast<int64_t>(overrides.size() - 1);
+        }
+
+        overrides[it->second].sources.push_back(ref.src);
+      }
+    }
+
+    for (auto& ov : overrides)
+    {
+      const auto& first = ov.sources.front();
+      const sha1_digest& first_sha1 = archives[first.archive_idx]->file_sha1(first.file_idx);
+
+      for (size_t i = 1; i < ov.sources.size() && ov.identical; ++i)
+      {
+        const auto& src = ov.sources[i];
+        const sha1_digest& sha1 = archives[src.archive_idx]->file_sha1(src.file_idx);
+        ov.identical = std::memcmp(&sha1, &first_sha1, sizeof(sha1_digest)) == 0;
+      }
+    }
+  });
+
+  parts.clear();
+
+  size_t overrides_cnt = 0;
+  for (const auto& overrides : joined)
+  {
+    overrides_cnt += overrides.size();
+  }
+
+  m_overrides.reserve(overrides_cnt);
+  for (auto& overrides : joined)
+  {
+    for (auto& ov : overrides)
+    {
+      m_identical_cnt += ov.identical ? 1 : 0;
+      m_overrides.emplace_back(std::move(ov));
+    }
+  }
+
+  std::sort(m_overrides.begin(), m_overrides.end(), [](const file_override& a, const file_override& b) {
+    return a.pid.hash < b.pid.hash;
+  });
+
+  SPDLOG_INFO("{} overridden files over {} archives, {} identical, {} different",
+    m_overrides.size(), archives.size(), m_identical_cnt, conflicts_cnt());
+}
+
+void override_table::clear()
+{
+  m_overrides.clear();
+  m_identical_cnt = 0;
+}
+
+const override_table::file_override* override_table::find(path_id pid) const
+{
+  auto it = std::lower_bound(m_overrides.begin(), m_overrides.end(), pid.hash, [](const file_override& ov, uint64_t hash) {
+    return ov.pid.hash < hash;
+  });
+
+  if (it != m_overrides.end() && it->pid == pid)
+  {
+    return &*it;
+  }
+
+  return nullptr;
+}
+
+bool override_table::write_report(const std::filesystem::path& report_path, const treefs& tfs) const
+{
+  std::ofstream ofs(report_path, std::ios::binary | std::ios::trunc);
+  if (!ofs.is_open())
+  {
+    SPDLOG_ERROR("couldn't open {}", report_path.string());
+    return false;
+  }
+
+  const auto& archives = tfs.archives();
+
+  std::string line;
+  for (const auto& ov : m_overrides)
+  {
+    const auto p = tfs.get_path(ov.pid);
+    line = p ? std::string(p->strv()) : fmt::format("{:016x}", ov.pid.hash);
+
+    line += ov.identical ? "\tidentical" : "\tdifferent";
+
+    for (const auto& src : ov.sources)
+    {
+      line += '\t';
+      line += src.archive_idx < archives.size()
+        ? archives[src.archive_idx]->path().filename().string()
+        : fmt::format("#{}", src.archive_idx);
+    }
+
+    line += '\n';
+    ofs.write(line.data(), line.size());
+  }
+
+  return ofs.good();
+}
+
+} // namespace cp::filesystem
+
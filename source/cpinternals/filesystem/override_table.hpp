@@ -0,0 +1,67 @@
+#pragma once
+#include <filesystem>
+#include <vector>
+
+#include <cpinternals/common.hpp>
+#include <cpinternals/filesystem/treefs.hpp>
+
+namespace cp::filesystem {
+
+// Files that more than one loaded archive contains, with the archives that
+// contain them. The mounted record is the one of the last archive.
+// Built with a parallel hash join over the records of all the archives of
+// a treefs: records are partitioned by pid per archive, then each partition
+// is joined on its own.
+struct override_table
+{
+  struct source
+  {
+    uint32_t archive_idx; // in treefs::archives()
+    uint32_t file_idx;
+  };
+
+  struct file_override
+  {
+    path_id pid;
+    std::vector<source> sources; // in mount order
+    bool identical = true; // all sources have the same sha1 digest
+  };
+
+  override_table() = default;
+
+  // workers_cnt: 0 means one per hardware thread, 1 disables threading
+  void build(const treefs& tfs, size_t workers_cnt = 0);
+
+  void clear();
+
+  // sorted by pid
+  const std::vector<file_override>& overrides() const
+  {
+    return m_overrides;
+  }
+
+  // nullptr if the file isn't overridden
+  const file_override* find(path_id pid) const;
+
+  size_t identical_cnt() const
+  {
+    return m_identical_cnt;
+  }
+
+  size_t conflicts_cnt() const
+  {
+    return m_overrides.size() - m_identical_cnt;
+  }
+
+  // tab-separated lines: path, "identical" or "different", then the
+  // archive filenames in mount order.
+  // tfs must be the tree the table was built from.
+  bool write_report(const std::filesystem::path& report_path, const treefs& tfs) const;
+
+protected:
+  std::vector<file_override> m_overrides;
+  size_t m_identical_cnt = 0;
+};
+
+} // namespace cp::filesystem
+
@@ -0,0 +1,432 @@
+#include <cpinternals/filesystem/packed_treefs.hpp>
+
+#include <algorithm>
+#include <numeric>
+
+#include <cpinternals/common/instrumentation.hpp>
+
+namespace cp::filesystem {
+
+namespace {
+
+void write_varint(std::vector<uint8_t>& out, size_t v)
+{
+  while (v >= 0x80)
+  {
+    out.push_back(static_cast<uint8_t>(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(v));
+}
+
+size_t read_varint(const uint8_t*& p)
+{
+  size_t v = 0;
+  for (uint32_t shift = 0;; shift += 7)
+  {
+    const uint8_t b = *p++;
+    v |= size_t(b & 0x7F) << shift;
+    if (!(b & 0x80))
+    {
+      return v;
+    }
+  }
+}
+
+} // namespace
+
+namespace detail::packed_treefs {
+
+void name_table::build(const std::vector<std::string_view>& sorted_names)
+{
+  clear();
+
+  m_size = sorted_names.size();
+  m_bucket_offsets.reserve((m_size + bucket_size - 1) / bucket_size);
+
+  std::string_view prev;
+  for (size_t i = 0; i < sorted_names.size(); ++i)
+  {
+    const std::string_view name = sorted_names[i];
+
+    if (i % bucket_size == 0)
+    {
+      m_bucket_offsets.push_back(static_cast<uint32_t>(m_data.size()));
+      write_varint(m_data, name.size());
+      m_data.insert(m_data.end(), name.begin(), name.end());
+    }
+    else
+    {
+      const size_t max_shared = std::min(prev.size(), name.size());
+      size_t shared = 0;
+      while (shared < max_shared && prev[shared] == name[shared])
+      {
+        ++shared;
+      }
+
+      write_varint(m_data, shared);
+      write_varint(m_data, name.size() - shared);
+      m_data.insert(m_data.end(), name.begin() + shared, name.end());
+    }
+
+    prev = name;
+  }
+
+  m_data.shrink_to_fit();
+}
+
+void name_table::clear()
+{
+  m_data.clear();
+  m_bucket_offsets.clear();
+  m_size = 0;
+}
+
+std::string_view name_table::bucket_head(uint32_t bucket_idx, const uint8_t*& p) const
+{
+  p = m_data.data() + m_bucket_offsets[bucket_idx];
+  const size_t len = read_varint(p);
+  const std::string_view head(reinterpret_cast<const char*>(p), len);
+  p += len;
+  return head;
+}
+
+void name_table::get(uint32_t id, std::string& out) const
+{
+  assert(id < m_size);
+
+  const uint8_t* p = nullptr;
+  const size_t out_pos = out.size();
+  out.append(bucket_head(id / bucket_size, p));
+
+  for (uint32_t k = id % bucket_size; k; --k)
+  {
+    const size_t shared = read_varint(p);
+    const size_t suffix_len = read_varint(p);
+    out.resize(out_pos + shared);
+    out.append(reinterpret_cast<const char*>(p), suffix_len);
+    p += suffix_len;
+  }
+}
+
+uint32_t name_table::find(std::string_view name) const
+{
+  if (m_bucket_offsets.empty())
+  {
+    return npos;
+  }
+
+  // last bucket whose head is <= name
+  const uint8_t* p = nullptr;
+  uint32_t lo = 0, hi = static_cast<uint32_t>(m_bucket_offsets.size());
+  while (hi - lo > 1)
+  {
+    const uint32_t mid = lo + (hi - lo) / 2;
+    if (bucket_head(mid, p) <= name)
+    {
+      lo = mid;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+
+  std::string cur(bucket_head(lo, p));
+  if (cur == name)
+  {
+    return lo * bucket_size;
+  }
+
+  const uint32_t end = std::min<uint32_t>((lo + 1) * bucket_size, static_cast<uint32_t>(m_size));
+  for (uint32_t id = lo * bucket_size + 1; id < end; ++id)
+  {
+    const size_t shared = read_varint(p);
+    const size_t suffix_len = read_varint(p);
+    cur.resize(shared);
+    cur.append(reinterpret_cast<const char*>(p), suffix_len);
+    p += suffix_len;
+
+    if (cur == name)
+    {
+      return id;
+    }
+
+    if (cur > name)
+    {
+      break;
+    }
+  }
+
+  return npos;
+}
+
+} // namespace detail::packed_treefs
+
+bool packed_treefs::build(const treefs& tfs)
+{
+  scoped_span span("fs.pack");
+
+  clear();
+
+  if (!tfs.is_compact())
+  {
+    SPDLOG_ERROR("packed_treefs: the tree must be compact");
+    return false;
+  }
+
+  const auto& entries = tfs.m_entries;
+  const size_t entries_cnt = entries.size();
+
+  if (tfs.m_archives.size() > max_u24)
+  {
+    SPDLOG_ERROR("packed_treefs: too many archives ({})", tfs.m_archives.size());
+    return false;
+  }
+
+  // names
+  std::vector<std::string_view> names;
+  names.reserve(entries_cnt);
+  for (const auto& e : entries)
+  {
+    if (!(e.flags & treefs::entry::flag::synthetic_name))
+    {
+      names.push_back(e.name.strv());
+    }
+  }
+  std::sort(names.begin(), names.end());
+  names.erase(std::unique(names.begin(), names.end()), names.end());
+  m_names.build(names);
+
+  // entry columns
+  m_pids.resize(entries_cnt);
+  m_parents.resize(entries_cnt);
+  m_name_ids.resize(entries_cnt);
+  m_kinds.resize(entries_cnt);
+  m_locs.resize(entries_cnt * loc_size);
+
+  for (size_t i = 0; i < entries_cnt; ++i)
+  {
+    const auto& e = entries[i];
+    const int32_t idx = static_cast<int32_t>(i);
+
+    m_pids[i] = e.pid;
+    m_parents[i] = e.parent_entry_idx;
+    m_kinds[i] = static_cast<uint8_t>(e.kind) | ((e.flags & treefs::entry::flag::has_depot_path) ? depot_path_bit : 0);
+
+    if (e.flags & treefs::entry::flag::synthetic_name)
+    {
+      m_kinds[i] |= synthetic_name_bit;
+      m_name_ids[i] = detail::packed_treefs::name_table::npos;
+    }
+    else
+    {
+      m_name_ids[i] = static_cast<uint32_t>(std::lower_bound(names.begin(), names.end(), e.name.strv()) - names.begin());
+    }
+
+    if (e.is_directory())
+    {
+      const size_t dir_idx = m_first_children.size();
+      if (dir_idx > max_u24)
+      {
+        SPDLOG_ERROR("packed_treefs: too many directories");
+        clear();
+        return false;
+      }
+
+      set_loc(idx, static_cast<uint32_t>(dir_idx), 0);
+      m_first_children.push_back(e.first_child_entry_idx);
+      m_children_cnts.push_back(tfs.m_children_cnts[i]);
+      m_dir_sizes.push_back(tfs.m_sizes[i]);
+    }
+    else if (e.is_file())
+    {
+      if (static_cast<uint32_t>(e.file_idx) > max_u24)
+      {
+        SPDLOG_ERROR("packed_treefs: file index {} doesn't fit 24 bits", e.file_idx);
+        clear();
+        return false;
+      }
+
+      set_loc(idx, static_cast<uint32_t>(e.archive_idx), static_cast<uint32_t>(e.file_idx));
+    }
+  }
+
+  m_first_children.shrink_to_fit();
+  m_children_cnts.shrink_to_fit();
+  m_dir_sizes.shrink_to_fit();
+
+  // pid index
+  m_pid_index.resize(entries_cnt);
+  std::iota(m_pid_index.begin(), m_pid_index.end(), 0);
+  std::sort(m_pid_index.begin(), m_pid_index.end(), [this](uint32_t a, uint32_t b) {
+    return m_pids[a].hash < m_pids[b].hash;
+  });
+
+  tfs.m_pidlinks.for_each([&](const auto& pl) {
+    if (m_pids[pl.entry_idx] != pl.pid)
+    {
+      m_extra_pidlinks.emplace_back(pl.pid, pl.entry_idx);
+    }
+  });
+  std::sort(m_extra_pidlinks.begin(), m_extra_pidlinks.end(), [](const auto& a, const auto& b) {
+    return a.first.hash < b.first.hash;
+  });
+  m_extra_pidlinks.shrink_to_fit();
+
+  m_archives = tfs.m_archives;
+
+  span.set_bytes(memory_usage());
+  SPDLOG_INFO("packed_treefs: {} entries, {} names, {} bytes", entries_cnt, m_names.size(), memory_usage());
+
+  return true;
+}
+
+void packed_treefs::clear()
+{
+  m_pids.clear();
+  m_parents.clear();
+  m_name_ids.clear();
+  m_kinds.clear();
+  m_locs.clear();
+  m_pid_index.clear();
+  m_extra_pidlinks.clear();
+  m_first_children.clear();
+  m_children_cnts.clear();
+  m_dir_sizes.clear();
+  m_names.clear();
+  m_archives.clear();
+}
+
+size_t packed_treefs::memory_usage() const
+{
+  return m_pids.capacity() * sizeof(path_id)
+    + m_parents.capacity() * sizeof(int32_t)
+    + m_name_ids.capacity() * sizeof(uint32_t)
+    + m_kinds.capacity()
+    + m_locs.capacity()
+    + m_pid_index.capacity() * sizeof(uint32_t)
+    + m_extra_pidlinks.capacity() * sizeof(std::pair<path_id, int32_t>)
+    + m_first_children.capacity() * sizeof(int32_t)
+    + m_children_cnts.capacity() * sizeof(uint32_t)
+    + m_dir_sizes.capacity() * sizeof(size_info)
+    + m_names.memory_usage();
+}
+
+int32_t packed_treefs::find_entry_idx(path_id pid) const
+{
+  auto it = std::lower_bound(m_pid_index.begin(), m_pid_index.end(), pid.hash, [this](uint32_t idx, uint64_t hash) {
+    return m_pids[idx].hash < hash;
+  });
+
+  if (it != m_pid_index.end() && m_pids[*it].hash == pid.hash)
+  {
+    return static_cast<int32_t>(*it);
+  }
+
+  auto extra_it = std::lower_bound(m_extra_pidlinks.begin(), m_extra_pidlinks.end(), pid.hash, [](const auto& pl, uint64_t hash) {
+    return pl.first.hash < hash;
+  });
+
+  if (extra_it != m_extra_pidlinks.end() && extra_it->first == pid)
+  {
+    return extra_it->second;
+  }
+
+  return -1;
+}
+
+void packed_treefs::append_name(std::string& out, int32_t idx) const
+{
+  if (m_kinds[idx] & synthetic_name_bit)
+  {
+    const auto& rec = m_archives[loc_lo(idx)]->records()[loc_hi(idx)];
+    out.append(detail::treefs::entry_name(path_id(rec.fid)).strv());
+  }
+  else
+  {
+    m_names.get(m_name_ids[idx], out);
+  }
+}
+
+void packed_treefs::append_path(path& p, int32_t idx, std::string& name_buf) const
+{
+  const auto k = kind(idx);
+  if (k != entry_kind::root && k != entry_kind::none)
+  {
+    assert(m_parents[idx] >= 0); // only root has no parent
+    append_path(p, m_parents[idx], name_buf);
+
+    name_buf.clear();
+    append_name(name_buf, idx);
+    p /= path(name_buf, path::already_normalized_tag{});
+  }
+}
+
+path packed_treefs::get_path(int32_t idx) const
+{
+  path p;
+  std::string name_buf;
+  append_path(p, idx, name_buf);
+  return p;
+}
+
+file_handle packed_treefs::get_file_handle(int32_t idx) const
+{
+  if (idx >= 0 && is_file(idx))
+  {
+    return m_archives[loc_lo(idx)]->get_file_handle(loc_hi(idx));
+  }
+  return file_handle();
+}
+
+std::pair<int32_t, uint32_t> packed_treefs::children_range(int32_t idx) const
+{
+  if (!is_directory(idx))
+  {
+    return {-1, 0};
+  }
+
+  const uint32_t dir_idx = loc_lo(idx);
+  return {m_first_children[dir_idx], m_children_cnts[dir_idx]};
+}
+
+int32_t packed_treefs::find_child_entry_idx(int32_t parent_idx, std::string_view name) const
+{
+  const auto [first, cnt] = children_range(parent_idx);
+  if (first < 0 || cnt == 0)
+  {
+    return -1;
+  }
+
+  // the pid of the child is known without decoding any name
+  path_id child_pid = m_pids[parent_idx];
+  child_pid /= name;
+
+  const int32_t idx = find_entry_idx(child_pid);
+  if (idx >= first && idx < first + static_cast<int32_t>(cnt))
+  {
+    return idx;
+  }
+
+  return -1;
+}
+
+packed_treefs::size_info packed_treefs::get_sizes(int32_t idx) const
+{
+  if (is_directory(idx))
+  {
+    return m_dir_sizes[loc_lo(idx)];
+  }
+
+  if (is_file(idx))
+  {
+    const auto finfo = m_archives[loc_lo(idx)]->get_file_info(loc_hi(idx));
+    return {finfo.size, finfo.disk_size};
+  }
+
+  return {};
+}
+
+} // namespace cp::filesystem
+
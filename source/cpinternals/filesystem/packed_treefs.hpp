@@ -0,0 +1,239 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cpinternals/common.hpp>
+#include <cpinternals/filesystem/treefs.hpp>
+
+namespace cp::filesystem {
+
+namespace detail::packed_treefs {
+
+// Sorted set of unique names, front-coded by buckets of bucket_size names:
+// the first name of a bucket is stored whole, the next ones as the length
+// of the prefix they share with the previous name and their suffix.
+// Lengths are LEB128 varints. Name ids are the ranks of the names.
+struct name_table
+{
+  static constexpr uint32_t bucket_size = 16;
+  static constexpr uint32_t npos = uint32_t(-1);
+
+  // names must be sorted and unique
+  void build(const std::vector<std::string_view>& sorted_names);
+
+  void clear();
+
+  size_t size() const
+  {
+    return m_size;
+  }
+
+  // appends the name of id to out
+  void get(uint32_t id, std::string& out) const;
+
+  // id of name, npos if the name isn't in the table
+  uint32_t find(std::string_view name) const;
+
+  size_t memory_usage() const
+  {
+    return m_data.capacity() + m_bucket_offsets.capacity() * sizeof(uint32_t);
+  }
+
+protected:
+  std::string_view bucket_head(uint32_t bucket_idx, const uint8_t*& p) const;
+
+  std::vector<uint8_t> m_data;
+  std::vector<uint32_t> m_bucket_offsets;
+  size_t m_size = 0;
+};
+
+} // namespace detail::packed_treefs
+
+// Read-only, memory-lean copy of a mounted treefs for long-lived mounts.
+// Built once mounting is done from a compact tree (see treefs::compact),
+// with the same entry indices, so the children of a directory are still a
+// contiguous range sorted by name.
+// Entries are stored as columns (structure of arrays):
+//  - pid, parent index and name id,
+//  - kind and depot path flag in one byte,
+//  - archive and file indices of files as two 24-bit integers, the same
+//    6 bytes hold the directory index of directories,
+// names are deduplicated in a front-coded table (synthetic names of
+// unidentified files are still formatted on demand), pids are found with a
+// binary search over an index sorted by pid, and sizes are only stored for
+// directories (the ones of files are in the archive records).
+// That is about 27 bytes per entry plus the names, against ~90 for treefs
+// (entry, pidlink slots, sizes and pooled names).
+struct packed_treefs
+{
+  using entry_kind = detail::treefs::entry_kind;
+  using size_info  = detail::treefs::size_info;
+
+  static constexpr int32_t root_idx = 0;
+  static constexpr uint32_t max_u24 = (1u << 24) - 1;
+
+  packed_treefs() = default;
+
+  // false if tfs isn't compact or doesn't fit the 24-bit indices,
+  // this is then left empty
+  bool build(const treefs& tfs);
+
+  void clear();
+
+  size_t size() const
+  {
+    return m_pids.size();
+  }
+
+  bool empty() const
+  {
+    return m_pids.empty();
+  }
+
+  // bytes used by the columns and tables
+  size_t memory_usage() const;
+
+  const std::vector<std::shared_ptr<archive>>& archives() const
+  {
+    return m_archives;
+  }
+
+  // -1 if not found
+  int32_t find_entry_idx(path_id pid) const;
+
+  bool has_entry(path_id pid) const
+  {
+    return find_entry_idx(pid) >= 0;
+  }
+
+  // entry_kind::none if there is no entry
+  entry_kind get_entry_kind(path_id pid) const
+  {
+    const int32_t idx = find_entry_idx(pid);
+    return idx >= 0 ? kind(idx) : entry_kind::none;
+  }
+
+  file_handle get_file_handle(path_id pid) const
+  {
+    return get_file_handle(find_entry_idx(pid));
+  }
+
+  std::optional<path> get_path(path_id pid) const
+  {
+    const int32_t idx = find_entry_idx(pid);
+    if (idx >= 0)
+    {
+      return get_path(idx);
+    }
+    return std::nullopt;
+  }
+
+  // accessors by entry index, idx must be valid
+
+  path_id pid(int32_t idx) const
+  {
+    return m_pids[idx];
+  }
+
+  int32_t parent(int32_t idx) const
+  {
+    return m_parents[idx];
+  }
+
+  entry_kind kind(int32_t idx) const
+  {
+    return static_cast<entry_kind>(m_kinds[idx] & kind_mask);
+  }
+
+  bool has_depot_path(int32_t idx) const
+  {
+    return (m_kinds[idx] & depot_path_bit) != 0;
+  }
+
+  bool is_directory(int32_t idx) const
+  {
+    const auto k = kind(idx);
+    return k == entry_kind::directory || k == entry_kind::root;
+  }
+
+  bool is_file(int32_t idx) const
+  {
+    return kind(idx) == entry_kind::file;
+  }
+
+  std::string name(int32_t idx) const
+  {
+    std::string ret;
+    append_name(ret, idx);
+    return ret;
+  }
+
+  path get_path(int32_t idx) const;
+
+  // invalid handle if idx isn't a file
+  file_handle get_file_handle(int32_t idx) const;
+
+  // children of a directory are [first, first + cnt)
+  std::pair<int32_t, uint32_t> children_range(int32_t idx) const;
+
+  // -1 if not found
+  int32_t find_child_entry_idx(int32_t parent_idx, std::string_view name) const;
+
+  size_info get_sizes(int32_t idx) const;
+
+protected:
+  static constexpr uint8_t kind_mask          = 0x3F;
+  static constexpr uint8_t synthetic_name_bit = 0x40;
+  static constexpr uint8_t depot_path_bit     = 0x80;
+
+  // two 24-bit integers per entry, little-endian
+  static constexpr size_t loc_size = 6;
+
+  uint32_t loc_lo(int32_t idx) const
+  {
+    const uint8_t* p = &m_locs[idx * loc_size];
+    return p[0] | (p[1] << 8) | (p[2] << 16);
+  }
+
+  uint32_t loc_hi(int32_t idx) const
+  {
+    const uint8_t* p = &m_locs[idx * loc_size + 3];
+    return p[0] | (p[1] << 8) | (p[2] << 16);
+  }
+
+  void set_loc(int32_t idx, uint32_t lo, uint32_t hi)
+  {
+    uint8_t* p = &m_locs[idx * loc_size];
+    p[0] = uint8_t(lo); p[1] = uint8_t(lo >> 8); p[2] = uint8_t(lo >> 16);
+    p[3] = uint8_t(hi); p[4] = uint8_t(hi >> 8); p[5] = uint8_t(hi >> 16);
+  }
+
+  void append_name(std::string& out, int32_t idx) const;
+  void append_path(path& p, int32_t idx, std::string& name_buf) const;
+
+  // entry columns
+  std::vector<path_id> m_pids;
+  std::vector<int32_t> m_parents;
+  std::vector<uint32_t> m_name_ids;
+  std::vector<uint8_t> m_kinds;
+  std::vector<uint8_t> m_locs; // files: archive idx, file idx; directories: directory idx
+
+  // entry indices sorted by pid
+  std::vector<uint32_t> m_pid_index;
+  // pids linked to entries that have another pid (the record pids of
+  // unidentified files), sorted by pid
+  std::vector<std::pair<path_id, int32_t>> m_extra_pidlinks;
+
+  // directory columns
+  std::vector<int32_t> m_first_children;
+  std::vector<uint32_t> m_children_cnts;
+  std::vector<size_info> m_dir_sizes;
+
+  detail::packed_treefs::name_table m_names;
+
+  std::vector<std::shared_ptr<archive>> m_archives;
+};
+
+} // namespace cp::filesystem
+
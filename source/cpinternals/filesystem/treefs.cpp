@@ -1,10 +1,30 @@
 #include <cpinternals/filesystem/treefs.hpp>
-#include <cpinternals/io/file_stream.hpp>
+#include <cpinternals/filesystem/ardb_builder.hpp>
+#include <cpinternals/io/file_ostream.hpp>
+#include <cpinternals/io/memory_istream.hpp>
+#include <cpinternals/os/file_mapping.hpp>
+#include <cpinternals/os/file_reader.hpp>
+#include <cpinternals/common/parallel.hpp>
+#include <cpinternals/common/instrumentation.hpp>
+#include <cpinternals/common/alloc_profiler.hpp>
+#include <algorithm>
+#include <atomic>
 #include <filesystem>
+#include <mutex>
+#include <unordered_map>
 
 namespace cp::filesystem {
 
-bool treefs::load_archive(const std::filesystem::path& path)
+namespace {
+
+std::filesystem::path get_ardb_path(const std::filesystem::path& archive_path)
+{
+  return std::filesystem::path("./ardbs/") / archive_path.filename().replace_extension("ardb");
+}
+
+} // namespace
+
+bool treefs::can_load_archive(const std::filesystem::path& path) const
 {
   if (m_full)
   {
@@ -27,13 +47,65 @@ bool treefs::load_archive(const std::filesystem::path& path)
     }
   }
 
-  auto ar = cp::archive::load(path);
+  return true;
+}
+
+bool treefs::load_archive(const std::filesystem::path& path, bool mapped)
+{
+  scoped_alloc_tag alloc_scope(alloc_tag::treefs);
+  if (!can_load_archive(path))
+  {
+    return false;
+  }
+
+  auto ar = mapped ? cp::archive::load_mapped(path) : cp::archive::load(path);
   if (!ar)
   {
     SPDLOG_ERROR("couldn't load archive");
     return false;
   }
 
+  return mount_archive(ar);
+}
+
+size_t treefs::load_archives(std::span<const std::filesystem::path> paths, bool mapped)
+{
+  scoped_alloc_tag alloc_scope(alloc_tag::treefs);
+  // opening and parsing metadata doesn't touch the tree, done concurrently
+  std::vector<std::shared_ptr<archive>> archives(paths.size());
+  parallel_for(paths.size(), 0, [&](size_t i)
+  {
+    archives[i] = mapped ? cp::archive::load_mapped(paths[i]) : cp::archive::load(paths[i]);
+  });
+
+  // mounted in the given order so that overrides are the same as with load_archive
+  size_t cnt = 0;
+  for (size_t i = 0; i < paths.size(); ++i)
+  {
+    if (!archives[i])
+    {
+      SPDLOG_ERROR("couldn't load archive {}", paths[i].string());
+      continue;
+    }
+
+    if (!can_load_archive(paths[i]))
+    {
+      continue;
+    }
+
+    if (mount_archive(archives[i]))
+    {
+      ++cnt;
+    }
+  }
+
+  return cnt;
+}
+
+bool treefs::mount_archive(const std::shared_ptr<archive>& ar)
+{
+  const auto& path = ar->path();
+
   uint16_t ar_idx = static_cast<uint16_t>(m_archives.size());
   if (ar_idx == std::numeric_limits<uint16_t>::max())
   {
@@ -41,7 +113,7 @@ bool treefs::load_archive(const std::filesystem::path& path)
   }
   m_archives.emplace_back(ar);
 
-  auto ardb_path = std::filesystem::path("./ardbs/") / path.filename().replace_extension("ardb");
+  auto ardb_path = get_ardb_path(path);
   if (!std::filesystem::is_regular_file(ardb_path))
   {
     SPDLOG_WARN("{} is missing, all files from loaded archive will only be accessible by file_id", ardb_path.string());
@@ -64,13 +136,18 @@ bool treefs::load_archive(const std::filesystem::path& path)
 
     if (entry_idx < 0)
     {
-      entry_idx = insert_child_entry(unids_idx, fs_gname(fmt::format("{:016x}.bin", pid.hash)), entry_kind::file, false).first;
+      // the name is only formatted to hash the path, it isn't interned
+      const detail::treefs::entry_name name(pid);
+      const path_id path_pid = m_entries[m_unids_idx].pid / path(name.strv(), path::already_normalized_tag{});
+      entry_idx = insert_child_entry(m_unids_idx, fs_gname(), path_pid, entry_kind::file, false).first;
       if (entry_idx < 0)
       {
         // collision, already logged by insert
         continue;
       }
 
+      m_entries[entry_idx].flags |= entry::flag::synthetic_name;
+
       // also add the real pid
       m_pidlinks.emplace(pid, entry_idx);
       is_override = false;
@@ -96,48 +173,389 @@ bool treefs::load_archive(const std::filesystem::path& path)
 
     e.file_idx = file_idx;
     e.archive_idx = ar_idx;
+
+    const auto finfo = ar->get_file_info(file_idx);
+    set_file_sizes(entry_idx, {finfo.size, finfo.disk_size});
   }
 
-  m_cached_info_dirty = true;
   return true;
 }
 
 
-struct ardb_header
+// tfsc format (treefs cache)
+// header
+// archives (path, stamps, metadata block)
+// names (unique entry names)
+// entries
+// pidlinks
+
+struct tfsc_header
 {
-  uint32_t magic = 'ARDB';
-  uint32_t names_cnt;
-  uint32_t dirnames_cnt;
-  uint32_t entries_cnt;
+  static constexpr uint32_t current_version = 2;
+
+  enum flag : uint32_t
+  {
+    none = 0,
+    compact = 1, // see treefs::compact
+  };
+
+  uint32_t magic = 'TFSC';
+  uint32_t version = current_version;
+  uint32_t archives_cnt = 0;
+  uint32_t names_cnt = 0;
+  uint32_t entries_cnt = 0;
+  uint32_t pidlinks_cnt = 0;
+  uint32_t flags = flag::none;
 
   bool is_magic_ok() const
   {
-    return magic == 'ARDB';
+    return magic == 'TFSC';
   }
 };
 
-struct ardb_record
+// size and write time, all zero for missing files
+struct tfsc_file_stamp
 {
-  uint32_t name_idx;
-  int32_t parent_idx;
+  uint64_t size = 0;
+  uint64_t time = 0;
+
+  static tfsc_file_stamp get(const std::filesystem::path& p)
+  {
+    tfsc_file_stamp ret;
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(p, ec);
+    if (!ec)
+    {
+      const auto time = std::filesystem::last_write_time(p, ec);
+      if (!ec)
+      {
+        ret.size = size;
+        ret.time = static_cast<uint64_t>(time.time_since_epoch().count());
+      }
+    }
+    return ret;
+  }
+
+  bool operator==(const tfsc_file_stamp& other) const
+  {
+    return size == other.size && time == other.time;
+  }
 };
 
-constexpr int32_t ardb_root_idx = -1;
+struct tfsc_entry
+{
+  uint64_t    pid;
+  int32_t     parent_entry_idx;
+  int32_t     next_entry_idx;
+  uint32_t    name_idx;
+  int32_t     child_or_file_idx;
+  int16_t     archive_idx;
+  uint8_t     kind;
+  uint8_t     override_cnt;
+  uint8_t     flags;
+  uint8_t     unused[3];
+};
+
+static_assert(sizeof(tfsc_entry) == 0x20);
+
+struct tfsc_pidlink
+{
+  uint64_t    pid;
+  int32_t     entry_idx;
+  uint32_t    unused;
+};
+
+bool treefs::save_cache(const std::filesystem::path& cache_path) const
+{
+  auto tmp_path = cache_path;
+  tmp_path += ".tmp";
+
+  {
+    file_ostream ofs(tmp_path);
+    if (!ofs.good())
+    {
+      SPDLOG_ERROR("couldn't create {}", tmp_path.string());
+      return false;
+    }
+
+    // names
+
+    std::vector<std::string_view> names;
+    std::unordered_map<std::string_view, uint32_t> name_indices;
+    std::vector<tfsc_entry> entries;
+    entries.reserve(m_entries.size());
+
+    for (const auto& e : m_entries)
+    {
+      // synthetic names are saved empty, the flags tell them apart
+      const auto name = e.name.strv();
+      auto it = name_indices.find(name);
+      if (it == name_indices.end())
+      {
+        it = name_indices.emplace(name, static_cast<uint32_t>(names.size())).first;
+        names.push_back(name);
+      }
+
+      auto& ce = entries.emplace_back();
+      ce = {};
+      ce.pid = e.pid.hash;
+      ce.parent_entry_idx = e.parent_entry_idx;
+      ce.next_entry_idx = e.next_entry_idx;
+      ce.name_idx = it->second;
+      ce.child_or_file_idx = e.is_file() ? e.file_idx : e.first_child_entry_idx;
+      ce.archive_idx = e.archive_idx;
+      ce.kind = static_cast<uint8_t>(e.kind);
+      ce.override_cnt = e.override_cnt;
+      ce.flags = e.flags;
+    }
+
+    std::vector<tfsc_pidlink> pidlinks;
+    pidlinks.reserve(m_pidlinks.size());
+    m_pidlinks.for_each([&](const auto& pl) {
+      pidlinks.push_back(tfsc_pidlink{pl.pid.hash, pl.entry_idx, 0});
+    });
+
+    tfsc_header hdr;
+    hdr.archives_cnt = static_cast<uint32_t>(m_archives.size());
+    hdr.names_cnt = static_cast<uint32_t>(names.size());
+    hdr.entries_cnt = static_cast<uint32_t>(entries.size());
+    hdr.pidlinks_cnt = static_cast<uint32_t>(pidlinks.size());
+    hdr.flags = m_compact ? tfsc_header::flag::compact : tfsc_header::flag::none;
+    ofs.serialize_pod_raw(hdr);
+
+    std::vector<char> metadata_block;
+    for (const auto& ar : m_archives)
+    {
+      if (!ar->read_metadata_block(metadata_block))
+      {
+        return false;
+      }
+
+      std::string path_str = ar->path().u8string();
+      ofs.serialize_str_lpfxd(path_str);
+
+      auto ar_stamp = tfsc_file_stamp::get(ar->path());
+      auto ardb_stamp = tfsc_file_stamp::get(get_ardb_path(ar->path()));
+      ofs.serialize_pod_raw(ar_stamp);
+      ofs.serialize_pod_raw(ardb_stamp);
+
+      uint32_t metadata_size = static_cast<uint32_t>(metadata_block.size());
+      ofs << metadata_size;
+      ofs.serialize_bytes(metadata_block.data(), metadata_block.size());
+    }
+
+    for (const auto& name : names)
+    {
+      std::string name_str(name);
+      ofs.serialize_str_lpfxd(name_str);
+    }
+
+    ofs.serialize_pods_array_raw(entries.data(), entries.size());
+    ofs.serialize_pods_array_raw(pidlinks.data(), pidlinks.size());
+
+    ofs.close();
+    if (!ofs.good() || ofs.has_error())
+    {
+      SPDLOG_ERROR("couldn't write {}", tmp_path.string());
+      return false;
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tmp_path, cache_path, ec);
+  if (ec)
+  {
+    SPDLOG_ERROR("couldn't rename {}: {}", tmp_path.string(), ec.message());
+    return false;
+  }
+
+  return true;
+}
+
+bool treefs::load_cache(const std::filesystem::path& cache_path, const std::vector<std::filesystem::path>& archive_paths, bool mapped)
+{
+  scoped_alloc_tag alloc_scope(alloc_tag::treefs);
+  if (m_archives.size() || m_entries.size() != 2)
+  {
+    SPDLOG_ERROR("the tree must be empty");
+    return false;
+  }
+
+  os::file_mapping fmapping;
+  if (!fmapping.open(cache_path))
+  {
+    return false;
+  }
+
+  const auto view = fmapping.view();
+  memory_istream ifs(view);
+
+  tfsc_header hdr;
+  ifs.serialize_pod_raw(hdr);
+  if (ifs.has_error() || !hdr.is_magic_ok() || hdr.version != tfsc_header::current_version)
+  {
+    SPDLOG_WARN("{} isn't a valid cache", cache_path.string());
+    return false;
+  }
+
+  if (hdr.archives_cnt != archive_paths.size())
+  {
+    SPDLOG_INFO("cache is outdated (archives count)");
+    return false;
+  }
+
+  // validate everything before loading anything
+
+  struct cached_archive
+  {
+    std::span<const char> metadata_block;
+  };
+
+  std::vector<cached_archive> cached_archives(hdr.archives_cnt);
+
+  std::string str;
+  for (uint32_t i = 0; i < hdr.archives_cnt; ++i)
+  {
+    const auto& path = archive_paths[i];
+
+    tfsc_file_stamp ar_stamp, ardb_stamp;
+    uint32_t metadata_size = 0;
+
+    ifs.serialize_str_lpfxd(str);
+    ifs.serialize_pod_raw(ar_stamp);
+    ifs.serialize_pod_raw(ardb_stamp);
+    ifs << metadata_size;
+
+    const size_t metadata_pos = static_cast<size_t>(ifs.tell());
+    ifs.seek(static_cast<streambase::pos_type>(metadata_pos + metadata_size));
+
+    if (ifs.has_error() || metadata_pos + metadata_size > view.size())
+    {
+      SPDLOG_WARN("{} is corrupted", cache_path.string());
+      return false;
+    }
+
+    if (str != path.u8string()
+      || !(ar_stamp == tfsc_file_stamp::get(path))
+      || !(ardb_stamp == tfsc_file_stamp::get(get_ardb_path(path))))
+    {
+      SPDLOG_INFO("cache is outdated ({})", path.string());
+      return false;
+    }
+
+    cached_archives[i].metadata_block = view.subspan(metadata_pos, metadata_size);
+  }
+
+  std::vector<fs_gname> names;
+  names.reserve(hdr.names_cnt);
+  for (uint32_t i = 0; i < hdr.names_cnt && !ifs.has_error(); ++i)
+  {
+    ifs.serialize_str_lpfxd(str);
+    names.emplace_back(str);
+  }
+
+  std::vector<tfsc_entry> centries(hdr.entries_cnt);
+  ifs.serialize_pods_array_raw(centries.data(), centries.size());
+
+  std::vector<tfsc_pidlink> cpidlinks(hdr.pidlinks_cnt);
+  ifs.serialize_pods_array_raw(cpidlinks.data(), cpidlinks.size());
+
+  if (ifs.has_error())
+  {
+    SPDLOG_WARN("{} is corrupted", cache_path.string());
+    return false;
+  }
+
+  std::vector<std::shared_ptr<archive>> archives;
+  archives.reserve(hdr.archives_cnt);
+  for (uint32_t i = 0; i < hdr.archives_cnt; ++i)
+  {
+    auto ar = archive::load_with_metadata(archive_paths[i], cached_archives[i].metadata_block, mapped);
+    if (!ar)
+    {
+      return false;
+    }
+    archives.emplace_back(std::move(ar));
+  }
 
-// ardb format (custom thing, not cdpr's)
+  std::vector<entry> entries;
+  entries.reserve(centries.size());
+  for (const auto& ce : centries)
+  {
+    if (ce.name_idx >= names.size()
+      || (ce.archive_idx >= 0 && static_cast<size_t>(ce.archive_idx) >= archives.size()))
+    {
+      SPDLOG_WARN("{} is corrupted", cache_path.string());
+      return false;
+    }
+
+    auto& e = entries.emplace_back(path_id(ce.pid), names[ce.name_idx], static_cast<entry_kind>(ce.kind), false);
+    e.flags = ce.flags;
+    e.parent_entry_idx = ce.parent_entry_idx;
+    e.next_entry_idx = ce.next_entry_idx;
+    e.archive_idx = ce.archive_idx;
+    e.override_cnt = ce.override_cnt;
+    if (e.is_file())
+    {
+      e.file_idx = ce.child_or_file_idx;
+    }
+    else
+    {
+      e.first_child_entry_idx = ce.child_or_file_idx;
+    }
+  }
+
+  decltype(m_pidlinks) pidlinks;
+  pidlinks.reserve(cpidlinks.size());
+  for (const auto& cpl : cpidlinks)
+  {
+    pidlinks.emplace(path_id(cpl.pid), cpl.entry_idx);
+  }
+
+  m_entries = std::move(entries);
+  m_pidlinks = std::move(pidlinks);
+  m_archives = std::move(archives);
+  m_full = m_archives.size() >= std::numeric_limits<uint16_t>::max();
+
+  rebuild_sizes();
+
+  m_unids_idx = find_entry_idx(path_id::root() / path(unidentified_files_directory_name, path::already_normalized_tag{}));
+
+  m_compact = (hdr.flags & tfsc_header::flag::compact) != 0;
+  if (m_compact)
+  {
+    rebuild_children_counts();
+  }
+
+  return true;
+}
+
+// ardb format (see ardb_builder.hpp)
 // string  fnames (path components)
 // array of (dirs/files fhash (optional), idx parent, idx fname) = one u64 per file/ folder = 5MB
 bool treefs::load_ardb(const std::filesystem::path& arpath)
 {
-  cp::file_istream ifs;
-  ifs.open(arpath);
-
-  if (!ifs.is_open())
+  scoped_alloc_tag alloc_scope(alloc_tag::treefs);
+  // the whole file in one read
+  std::vector<char> block;
   {
-    SPDLOG_ERROR("ardb file not found at {}", arpath.string());
-    return false;
+    os::file_reader freader;
+    if (!freader.open(arpath))
+    {
+      SPDLOG_ERROR("ardb file not found at {}", arpath.string());
+      return false;
+    }
+
+    block.resize(freader.size());
+    if (!freader.read_at(0, block))
+    {
+      SPDLOG_ERROR("couldn't read {}", arpath.string());
+      return false;
+    }
   }
 
+  memory_istream ifs(block);
+
   ardb_header hdr;
   ifs.serialize_pod_raw(hdr);
 
@@ -147,106 +565,529 @@ bool treefs::load_ardb(const std::filesystem::path& arpath)
     return false;
   }
 
-  std::vector<fs_gname> names; // directory names are first
-  names.reserve(hdr.names_cnt);
-
-  std::string name;
-  for (size_t i = 0; i < hdr.names_cnt; ++i)
+  std::vector<std::string> names_str(hdr.names_cnt); // directory names are first
+  for (auto& name : names_str)
   {
     ifs.serialize_str_lpfxd(name);
-    names.emplace_back(name);
   }
 
   std::vector<ardb_record> recs(hdr.entries_cnt);
   ifs.serialize_pods_array_raw(recs.data(), hdr.entries_cnt);
 
-  std::vector<int32_t> entry_indices;
+  if (ifs.has_error())
+  {
+    SPDLOG_ERROR("ardb file is corrupted: {}", ifs.error());
+    return false;
+  }
+
+  // validation and depths (parents come first)
+
+  std::vector<std::vector<uint32_t>> levels;
+  std::vector<uint32_t> depths(hdr.entries_cnt);
 
-  for (size_t i = 0; i < hdr.entries_cnt; ++i)
+  for (uint32_t i = 0; i < hdr.entries_cnt; ++i)
   {
     const ardb_record& rec = recs[i];
-    const bool is_file = (rec.name_idx >= hdr.dirnames_cnt);
 
-    int32_t parent_entry_idx;
-    if (rec.parent_idx == ardb_root_idx)
+    if (rec.name_idx >= hdr.names_cnt)
+    {
+      SPDLOG_ERROR("invalid name index found");
+      return false;
+    }
+
+    uint32_t depth = 0;
+    if (rec.parent_idx != ardb_root_idx)
     {
-      parent_entry_idx = root_idx;
+      if (rec.parent_idx < 0 || static_cast<uint32_t>(rec.parent_idx) >= i)
+      {
+        SPDLOG_ERROR("unordered record found");
+        return false;
+      }
+      depth = depths[rec.parent_idx] + 1;
     }
-    else if (rec.parent_idx >= i)
+
+    depths[i] = depth;
+    if (depth >= levels.size())
     {
-      SPDLOG_ERROR("unordered record found");
-      return false;
+      levels.resize(depth + 1);
+    }
+    levels[depth].push_back(i);
+  }
+
+  // names are interned in one go
+
+  const std::vector<std::string_view> names_sv(names_str.begin(), names_str.end());
+  const std::vector<fs_gname> names = fs_gname::register_strings(names_sv);
+
+  // path ids, a level at a time since they derive from their parent's one
+
+  std::vector<path_id> pids(hdr.entries_cnt);
+
+  const auto compute_pid = [&](uint32_t i)
+  {
+    const ardb_record& rec = recs[i];
+    const path_id parent_pid = (rec.parent_idx == ardb_root_idx) ? path_id::root() : pids[rec.parent_idx];
+    const auto name = names_sv[rec.name_idx];
+
+    // temporary, ardbs have the root entry for some reason..
+    pids[i] = name.empty() ? parent_pid : parent_pid / path(name, path::already_normalized_tag{});
+  };
+
+  constexpr size_t parallel_level_min_size = 0x1000;
+  for (const auto& level : levels)
+  {
+    if (level.size() >= parallel_level_min_size)
+    {
+      parallel_for(level.size(), 0, [&](size_t k) { compute_pid(level[k]); });
     }
     else
     {
-      parent_entry_idx = entry_indices[rec.parent_idx];
+      for (uint32_t i : level)
+      {
+        compute_pid(i);
+      }
     }
+  }
 
-    fs_gname name = names[rec.name_idx];
+  // entries and links in one pass, in record order
+
+  m_entries.reserve(m_entries.size() + hdr.entries_cnt);
+  m_pidlinks.reserve(m_pidlinks.size() + hdr.entries_cnt);
+
+  std::vector<int32_t> entry_indices(hdr.entries_cnt);
+
+  for (uint32_t i = 0; i < hdr.entries_cnt; ++i)
+  {
+    const ardb_record& rec = recs[i];
+    const bool is_file = (rec.name_idx >= hdr.dirnames_cnt);
+
+    const int32_t parent_entry_idx = (rec.parent_idx == ardb_root_idx) ? root_idx : entry_indices[rec.parent_idx];
+
+    const fs_gname name = names[rec.name_idx];
 
     // temporary, ardbs have the root entry for some reason..
-    if (name.strv() == "")
+    if (names_sv[rec.name_idx].empty())
     {
       assert(parent_entry_idx == root_idx);
-      entry_indices.emplace_back(root_idx);
+      entry_indices[i] = root_idx;
       continue;
     }
 
-    int32_t entry_index = insert_child_entry(parent_entry_idx, name, is_file ? entry_kind::reserved_for_file : entry_kind::directory, true).first;
+    int32_t entry_index = insert_child_entry(parent_entry_idx, name, pids[i], is_file ? entry_kind::reserved_for_file : entry_kind::directory, true).first;
     if (entry_index < 0)
     {
       SPDLOG_ERROR("failed to insert entry for {}", name.strv());
       return false;
     }
 
-    entry_indices.emplace_back(entry_index);
+    entry_indices[i] = entry_index;
   }
 
   return true;
 }
 
-void treefs::debug_check()
+void treefs::compact()
 {
-  for (int32_t idx = 0; idx < m_entries.size(); ++idx)
+  scoped_alloc_tag alloc_scope(alloc_tag::treefs);
+  // breadth-first, each directory's children appended sorted by name
+  std::vector<int32_t> order; // new idx -> old idx
+  order.reserve(m_entries.size());
+  order.push_back(root_idx);
+
+  std::vector<int32_t> children;
+  std::vector<std::pair<int32_t, uint32_t>> children_ranges(m_entries.size(), {-1, 0}); // old idx -> (new first child idx, cnt)
+
+  for (size_t k = 0; k < order.size(); ++k)
   {
-    const auto& e = m_entries[idx];
-    if (e.pid.is_null())
+    const int32_t old_idx = order[k];
+    const auto& e = m_entries[old_idx];
+    if (!e.is_directory())
     {
-      SPDLOG_ERROR("treefs's entry {} has null pid", get_path(e).strv());
+      continue;
     }
 
-    SPDLOG_DEBUG("checking [{}] {}, parent:{}, next:{}, child:{}",
-      idx, get_path(e).strv(), e.parent_entry_idx, e.next_entry_idx, e.first_child_entry_idx);
+    children.clear();
+    for (int32_t c = e.first_child_entry_idx; c >= 0; c = m_entries[c].next_entry_idx)
+    {
+      children.push_back(c);
+    }
+
+    std::sort(children.begin(), children.end(), [this](int32_t a, int32_t b) {
+      return name_less(m_entries[a], m_entries[b]);
+    });
 
-    int32_t parent_idx = e.parent_entry_idx;
-    if (!is_valid_entry_index(parent_idx) && e.kind != entry_kind::root)
+    if (children.size())
+    {
+      children_ranges[old_idx] = {static_cast<int32_t>(order.size()), static_cast<uint32_t>(children.size())};
+      order.insert(order.end(), children.begin(), children.end());
+    }
+  }
+
+  if (order.size() != m_entries.size())
+  {
+    SPDLOG_ERROR("{} entries aren't reachable from root, tree not compacted", m_entries.size() - order.size());
+    return;
+  }
+
+  std::vector<int32_t> new_indices(m_entries.size());
+  for (int32_t i = 0; i < static_cast<int32_t>(order.size()); ++i)
+  {
+    new_indices[order[i]] = i;
+  }
+
+  std::vector<entry> entries;
+  entries.reserve(m_entries.size());
+  std::vector<detail::treefs::size_info> sizes;
+  sizes.reserve(m_sizes.size());
+  m_children_cnts.assign(m_entries.size(), 0);
+
+  for (int32_t i = 0; i < static_cast<int32_t>(order.size()); ++i)
+  {
+    const int32_t old_idx = order[i];
+    auto& e = entries.emplace_back(m_entries[old_idx]);
+    sizes.emplace_back(m_sizes[old_idx]);
+
+    if (e.parent_entry_idx >= 0)
+    {
+      e.parent_entry_idx = new_indices[e.parent_entry_idx];
+      // siblings are contiguous, last one is the end of the parent's range
+      const auto& parent_range = children_ranges[order[e.parent_entry_idx]];
+      e.next_entry_idx = (i + 1 < parent_range.first + static_cast<int32_t>(parent_range.second)) ? i + 1 : -1;
+    }
+
+    if (e.is_directory())
+    {
+      e.first_child_entry_idx = children_ranges[old_idx].first;
+      m_children_cnts[i] = children_ranges[old_idx].second;
+    }
+  }
+
+  detail::treefs::pidlink_table pidlinks;
+  pidlinks.reserve(m_pidlinks.size());
+  m_pidlinks.for_each([&](const auto& pl) {
+    pidlinks.emplace(pl.pid, new_indices[pl.entry_idx]);
+  });
+
+  m_entries = std::move(entries);
+  m_sizes = std::move(sizes);
+  m_pidlinks = std::move(pidlinks);
+  m_unids_idx = new_indices[m_unids_idx];
+  m_compact = true;
+}
+
+void treefs::rebuild_sizes()
+{
+  m_sizes.assign(m_entries.size(), {});
+
+  for (int32_t i = 0; i < static_cast<int32_t>(m_entries.size()); ++i)
+  {
+    const auto& e = m_entries[i];
+    if (e.is_file())
+    {
+      const auto finfo = m_archives[e.archive_idx]->get_file_info(e.file_idx);
+      set_file_sizes(i, {finfo.size, finfo.disk_size});
+    }
+  }
+}
+
+void treefs::rebuild_children_counts()
+{
+  m_children_cnts.assign(m_entries.size(), 0);
+  for (size_t i = 0; i < m_entries.size(); ++i)
+  {
+    const auto& e = m_entries[i];
+    if (e.parent_entry_idx >= 0)
+    {
+      ++m_children_cnts[e.parent_entry_idx];
+    }
+  }
+}
+
+int32_t treefs::find_child_entry_idx(int32_t parent_entry_idx, std::string_view name) const
+{
+  if (!is_valid_entry_index(parent_entry_idx))
+  {
+    return -1;
+  }
+
+  const auto& parent = m_entries[parent_entry_idx];
+  if (!parent.is_directory() || parent.first_child_entry_idx < 0)
+  {
+    return -1;
+  }
+
+  if (m_compact)
+  {
+    const auto first = m_entries.begin() + parent.first_child_entry_idx;
+    const auto last = first + m_children_cnts[parent_entry_idx];
+    auto it = std::lower_bound(first, last, name, [this](const entry& e, std::string_view n) {
+      return get_name(e).strv() < n;
+    });
+    if (it != last && get_name(*it).strv() == name)
+    {
+      return static_cast<int32_t>(it - m_entries.begin());
+    }
+    return -1;
+  }
+
+  for (int32_t c = parent.first_child_entry_idx; c >= 0; c = m_entries[c].next_entry_idx)
+  {
+    if (get_name(m_entries[c]).strv() == name)
+    {
+      return c;
+    }
+  }
+
+  return -1;
+}
+
+namespace {
+
+inline bool name_starts_with(std::string_view name, std::string_view prefix)
+{
+  return name.size() >= prefix.size() && name.compare(0, prefix.size(), prefix) == 0;
+}
+
+} // namespace
+
+int32_t treefs::find_first_child_with_prefix(int32_t parent_entry_idx, std::string_view prefix) const
+{
+  if (!is_valid_entry_index(parent_entry_idx))
+  {
+    return -1;
+  }
+
+  const auto& parent = m_entries[parent_entry_idx];
+  if (!parent.is_directory() || parent.first_child_entry_idx < 0)
+  {
+    return -1;
+  }
+
+  if (m_compact)
+  {
+    const auto first = m_entries.begin() + parent.first_child_entry_idx;
+    const auto last = first + m_children_cnts[parent_entry_idx];
+    auto it = std::lower_bound(first, last, prefix, [this](const entry& e, std::string_view n) {
+      return get_name(e).strv() < n;
+    });
+    if (it != last && name_starts_with(get_name(*it).strv(), prefix))
+    {
+      return static_cast<int32_t>(it - m_entries.begin());
+    }
+    return -1;
+  }
+
+  for (int32_t c = parent.first_child_entry_idx; c >= 0; c = m_entries[c].next_entry_idx)
+  {
+    if (name_starts_with(get_name(m_entries[c]).strv(), prefix))
+    {
+      return c;
+    }
+  }
+
+  return -1;
+}
+
+int32_t treefs::find_next_with_prefix(int32_t entry_idx, std::string_view prefix) const
+{
+  if (!is_valid_entry_index(entry_idx))
+  {
+    return -1;
+  }
+
+  for (int32_t c = m_entries[entry_idx].next_entry_idx; c >= 0; c = m_entries[c].next_entry_idx)
+  {
+    if (name_starts_with(get_name(m_entries[c]).strv(), prefix))
+    {
+      return c;
+    }
+
+    if (m_compact)
+    {
+      // sorted siblings, no match after this one
+      break;
+    }
+  }
+
+  return -1;
+}
+
+treefs::integrity_report& treefs::integrity_report::operator+=(const integrity_report& other)
+{
+  entries_cnt     += other.entries_cnt;
+  null_pids       += other.null_pids;
+  bad_parents     += other.bad_parents;
+  orphans         += other.orphans;
+  multi_chained   += other.multi_chained;
+  broken_chains   += other.broken_chains;
+  pid_mismatches  += other.pid_mismatches;
+  unlinked_pids   += other.unlinked_pids;
+  bad_files       += other.bad_files;
+  unsorted_chains += other.unsorted_chains;
+  return *this;
+}
+
+treefs::integrity_report treefs::check_integrity(size_t workers_cnt, size_t max_logged) const
+{
+  scoped_span span("fs.check_integrity");
+
+  const int32_t entries_cnt = static_cast<int32_t>(m_entries.size());
+
+  integrity_report report;
+  report.entries_cnt = entries_cnt;
+
+  std::atomic<size_t> logged_cnt = 0;
+  auto log_entry = [&](int32_t idx, const char* what)
+  {
+    if (logged_cnt++ < max_logged)
+    {
+      SPDLOG_ERROR("treefs's entry [{}] {} {}", idx, get_path(m_entries[idx]).strv(), what);
+    }
+  };
+
+  // parent of each entry according to the chains, -1 if it isn't in any.
+  // a chain longer than the entries count has a cycle.
+  std::vector<int32_t> chain_parents(entries_cnt, -1);
+  for (int32_t idx = 0; idx < entries_cnt; ++idx)
+  {
+    const auto& e = m_entries[idx];
+    if (!e.is_directory())
     {
-      SPDLOG_ERROR("treefs's entry {} isn't root but has no parent", e.name.strv());
       continue;
     }
 
-    if (e.kind != entry_kind::root)
+    bool sorted = true;
+    int32_t prev_idx = -1;
+    int32_t steps = 0;
+    for (int32_t child_idx = e.first_child_entry_idx; child_idx >= 0; child_idx = m_entries[child_idx].next_entry_idx)
+    {
+      if (child_idx >= entries_cnt || ++steps > entries_cnt)
+      {
+        ++report.broken_chains;
+        log_entry(idx, "has a broken children chain");
+        break;
+      }
+
+      if (chain_parents[child_idx] >= 0)
+      {
+        ++report.multi_chained;
+        log_entry(child_idx, "is in several children chains");
+        break;
+      }
+
+      chain_parents[child_idx] = idx;
+
+      if (prev_idx >= 0 && name_less(m_entries[child_idx], m_entries[prev_idx]))
+      {
+        sorted = false;
+      }
+      prev_idx = child_idx;
+    }
+
+    if (m_compact && !sorted)
     {
-      const auto& parent = m_entries[parent_idx];
-      int32_t search_idx = parent.first_child_entry_idx;
-      bool found = false;
-      while (!found && search_idx > 0)
+      ++report.unsorted_chains;
+      log_entry(idx, "has unsorted children in a compact tree");
+    }
+  }
+
+  // entries are checked by blocks, each block has its report
+  constexpr int32_t block_size = 0x4000;
+  const size_t blocks_cnt = (entries_cnt + block_size - 1) / block_size;
+
+  std::mutex report_mtx;
+  span_sink* const sink = current_span_sink();
+  const uint32_t depth = current_span_depth();
+
+  parallel_for(blocks_cnt, workers_cnt, [&](size_t block_idx)
+  {
+    scoped_span_sink job_sink(sink, depth);
+
+    integrity_report block_report;
+
+    const int32_t beg = static_cast<int32_t>(block_idx) * block_size;
+    const int32_t end = std::min(beg + block_size, entries_cnt);
+    for (int32_t idx = beg; idx < end; ++idx)
+    {
+      const auto& e = m_entries[idx];
+
+      if (e.pid.is_null())
       {
-        if (search_idx == idx)
+        ++block_report.null_pids;
+        log_entry(idx, "has a null pid");
+      }
+      else if (m_pidlinks.find(e.pid) != idx)
+      {
+        ++block_report.unlinked_pids;
+        log_entry(idx, "isn't linked to its pid");
+      }
+
+      if (e.is_file())
+      {
+        if (e.archive_idx < 0 || e.archive_idx >= static_cast<int32_t>(m_archives.size())
+          || e.file_idx < 0 || static_cast<size_t>(e.file_idx) >= m_archives[e.archive_idx]->size())
+        {
+          ++block_report.bad_files;
+          log_entry(idx, "has an invalid archive or file index");
+        }
+      }
+
+      if (e.kind == entry_kind::root)
+      {
+        if (e.pid != path_id::root())
         {
-          found = true;
-          break;
+          ++block_report.pid_mismatches;
+          log_entry(idx, "isn't the root pid");
         }
-        search_idx = m_entries[search_idx].next_entry_idx;
+        continue;
       }
 
-      if (!found)
+      const int32_t parent_idx = e.parent_entry_idx;
+      if (!is_valid_entry_index(parent_idx) || !m_entries[parent_idx].is_directory())
       {
-        SPDLOG_ERROR("treefs's entry {} isn't in its parent's children chain", get_path(e).strv());
+        ++block_report.bad_parents;
+        log_entry(idx, "has an invalid parent");
         continue;
       }
+
+      if (chain_parents[idx] != parent_idx)
+      {
+        ++block_report.orphans;
+        log_entry(idx, "isn't in its parent's children chain");
+      }
+
+      path_id expected_pid = m_entries[parent_idx].pid;
+      expected_pid /= get_name(e).strv();
+      if (!e.pid.is_null() && e.pid != expected_pid)
+      {
+        ++block_report.pid_mismatches;
+        log_entry(idx, "has a pid that doesn't match its path");
+      }
     }
+
+    std::lock_guard<std::mutex> lock(report_mtx);
+    block_report.entries_cnt = 0; // already counted
+    report += block_report;
+  });
+
+  return report;
+}
+
+void treefs::debug_check() const
+{
+  const auto report = check_integrity();
+
+  if (report.ok())
+  {
+    SPDLOG_INFO("treefs: {} entries checked, no error", report.entries_cnt);
+    return;
   }
+
+  SPDLOG_ERROR("treefs: {} entries checked, {} errors (null pids:{} bad parents:{} orphans:{} multi-chained:{} "
+    "broken chains:{} pid mismatches:{} unlinked pids:{} bad files:{} unsorted chains:{})",
+    report.entries_cnt, report.errors_cnt(), report.null_pids, report.bad_parents, report.orphans,
+    report.multi_chained, report.broken_chains, report.pid_mismatches, report.unlinked_pids,
+    report.bad_files, report.unsorted_chains);
 }
 
 std::pair<int32_t, bool> treefs::insert_child_entry(int32_t parent_entry_idx, fs_gname name, entry_kind type, bool is_depot_path)
@@ -257,6 +1098,18 @@ std::pair<int32_t, bool> treefs::insert_child_entry(int32_t parent_entry_idx, fs
     return {-1, false};
   }
 
+  const path_id pid = m_entries[parent_entry_idx].pid / path(name.strv(), path::already_normalized_tag{});
+  return insert_child_entry(parent_entry_idx, name, pid, type, is_depot_path);
+}
+
+std::pair<int32_t, bool> treefs::insert_child_entry(int32_t parent_entry_idx, fs_gname name, path_id pid, entry_kind type, bool is_depot_path)
+{
+  if (!is_valid_entry_index(parent_entry_idx))
+  {
+    SPDLOG_ERROR("parent_idx is invalid");
+    return {-1, false};
+  }
+
   // must do a copy here !
   entry parent_copy = m_entries[parent_entry_idx];
   if (parent_copy.kind != entry_kind::directory && parent_copy.kind != entry_kind::root)
@@ -266,7 +1119,6 @@ std::pair<int32_t, bool> treefs::insert_child_entry(int32_t parent_entry_idx, fs
   }
 
   const auto name_strv = name.strv();
-  path_id pid = parent_copy.pid / path(name_strv, path::already_normalized_tag{});
 
   int32_t entry_idx = find_entry_idx(pid);
   if (entry_idx >= 0)
@@ -293,8 +1145,15 @@ std::pair<int32_t, bool> treefs::insert_child_entry(int32_t parent_entry_idx, fs
     return {-1, false};
   }
 
+  if (m_compact)
+  {
+    m_compact = false;
+    m_children_cnts.clear();
+  }
+
   entry_idx = static_cast<int32_t>(m_entries.size());
   auto& new_entry = m_entries.emplace_back(pid, name, type, is_depot_path);
+  m_sizes.emplace_back();
 
   new_entry.parent_entry_idx = parent_entry_idx;
 
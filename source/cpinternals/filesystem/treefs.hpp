@@ -2,7 +2,6 @@
 #include <filesystem>
 #include <vector>
 #include <shared_mutex>
-#include <unordered_set>
 #include <stack>
 
 #include <cpinternals/common.hpp>
@@ -24,6 +23,7 @@ struct treefs;
 struct directory_entry;
 struct directory_iterator;
 struct recursive_directory_iterator;
+struct packed_treefs;
 
 // fse: file system entry
 
@@ -53,6 +53,7 @@ struct entry
   {
     none = 0,
     has_depot_path = 1,
+    synthetic_name = 2, // name isn't interned, see entry_name
   };
 
   //entry() : first_child() {}
@@ -110,6 +111,208 @@ struct entry
 static_assert(sizeof(entry) <= 0x20);
 static_assert(std::is_default_constructible_v<entry>);
 
+// name of an entry as a value.
+// unidentified files are named after their pid ("{:016x}.bin"), these names
+// aren't interned in the gname pool (entry::flag::synthetic_name), they are
+// formatted in the inline buffer when asked for.
+struct entry_name
+{
+  static constexpr size_t synthetic_len = 20;
+
+  entry_name() = default;
+
+  explicit entry_name(fs_gname name)
+    : m_interned(name.strv()) {}
+
+  explicit entry_name(path_id file_pid)
+    : m_synthetic(true)
+  {
+    fmt::format_to_n(m_buf, synthetic_len, "{:016x}.bin", file_pid.hash);
+  }
+
+  std::string_view strv() const
+  {
+    return m_synthetic ? std::string_view(m_buf, synthetic_len) : m_interned;
+  }
+
+private:
+  std::string_view m_interned;
+  char m_buf[synthetic_len] = {};
+  bool m_synthetic = false;
+};
+
+// sizes of a file, or sums over the files below a directory
+struct size_info
+{
+  uint64_t size      = 0; // with files' first segment decompressed
+  uint64_t disk_size = 0;
+};
+
+// pid -> entry index, flat open-addressing table (linear probing).
+// pids are fnv1a64 hashes so they are used as is to pick slots.
+// there is no erase, a tree only grows.
+// a blocked bloom filter (a 64-bit word per pid with 4 bits set, a word
+// per 8 slots so 16+ bits per pid) is checked before the slots: most
+// missing pids (desktop.ini, thumbs.db..) are rejected without probing.
+struct pidlink_table
+{
+  struct pidlink
+  {
+    path_id pid;
+    int32_t entry_idx = -1; // -1 for empty slots
+  };
+
+  pidlink_table() = default;
+
+  size_t size() const
+  {
+    return m_size;
+  }
+
+  void clear()
+  {
+    m_slots.clear();
+    m_filter.clear();
+    m_size = 0;
+  }
+
+  void reserve(size_t cnt)
+  {
+    // load factor kept under 1/2
+    size_t capacity = 16;
+    while (capacity < cnt * 2)
+    {
+      capacity *= 2;
+    }
+
+    if (capacity > m_slots.size())
+    {
+      rehash(capacity);
+    }
+  }
+
+  // returns false if pid was already present (its entry index is kept)
+  bool emplace(path_id pid, int32_t entry_idx)
+  {
+    if ((m_size + 1) * 2 > m_slots.size())
+    {
+      rehash(m_slots.size() ? m_slots.size() * 2 : 16);
+    }
+
+    auto& slot = m_slots[find_slot_idx(pid.hash)];
+    if (slot.entry_idx >= 0)
+    {
+      return false;
+    }
+
+    slot.pid = pid;
+    slot.entry_idx = entry_idx;
+    filter_add(pid.hash);
+    ++m_size;
+    return true;
+  }
+
+  // false if pid isn't in the table, true if it may be
+  bool may_contain(path_id pid) const
+  {
+    if (m_filter.empty())
+    {
+      return false;
+    }
+
+    const uint64_t fh = filter_hash(pid.hash);
+    const uint64_t mask = filter_mask(fh);
+    return (m_filter[filter_word_idx(fh)] & mask) == mask;
+  }
+
+  // returns -1 if not found
+  int32_t find(path_id pid) const
+  {
+    if (!may_contain(pid))
+    {
+      return -1;
+    }
+
+    return m_slots[find_slot_idx(pid.hash)].entry_idx;
+  }
+
+  template <typename Fn>
+  void for_each(Fn&& fn) const
+  {
+    for (const auto& slot : m_slots)
+    {
+      if (slot.entry_idx >= 0)
+      {
+        fn(slot);
+      }
+    }
+  }
+
+protected:
+
+  // returns the slot of hash if present, otherwise the empty slot where it would go
+  size_t find_slot_idx(uint64_t hash) const
+  {
+    const size_t mask = m_slots.size() - 1;
+    size_t idx = static_cast<size_t>(hash) & mask;
+    while (true)
+    {
+      const auto& slot = m_slots[idx];
+      if (slot.entry_idx < 0 || slot.pid.hash == hash)
+      {
+        return idx;
+      }
+      idx = (idx + 1) & mask;
+    }
+  }
+
+  void rehash(size_t capacity)
+  {
+    std::vector<pidlink> old_slots(capacity);
+    std::swap(old_slots, m_slots);
+    m_filter.assign(capacity / 8, 0);
+
+    for (const auto& slot : old_slots)
+    {
+      if (slot.entry_idx >= 0)
+      {
+        m_slots[find_slot_idx(slot.pid.hash)] = slot;
+        filter_add(slot.pid.hash);
+      }
+    }
+  }
+
+  // remixed so that the filter doesn't use the bits that pick the slots
+  static uint64_t filter_hash(uint64_t hash)
+  {
+    hash *= 0x9E3779B97F4A7C15ull;
+    return hash ^ (hash >> 29);
+  }
+
+  static uint64_t filter_mask(uint64_t fh)
+  {
+    return (uint64_t(1) << (fh & 63))
+      | (uint64_t(1) << ((fh >> 6) & 63))
+      | (uint64_t(1) << ((fh >> 12) & 63))
+      | (uint64_t(1) << ((fh >> 18) & 63));
+  }
+
+  size_t filter_word_idx(uint64_t fh) const
+  {
+    return static_cast<size_t>(fh >> 32) & (m_filter.size() - 1);
+  }
+
+  void filter_add(uint64_t hash)
+  {
+    const uint64_t fh = filter_hash(hash);
+    m_filter[filter_word_idx(fh)] |= filter_mask(fh);
+  }
+
+  std::vector<pidlink> m_slots; // size is a power of 2
+  std::vector<uint64_t> m_filter; // size is a power of 2 (slots / 8)
+  size_t m_size = 0;
+};
+
 } // namespace detail::treefs
 
 // read-only tree file system.
@@ -123,12 +326,12 @@ protected:
   friend struct directory_entry;
   friend struct directory_iterator;
   friend struct recursive_directory_iterator;
+  friend struct packed_treefs;
 
   using entry_kind  = detail::treefs::entry_kind;
   using entry       = detail::treefs::entry;
   
   static constexpr int32_t root_idx       = 0;
-  static constexpr int32_t unids_idx      = 1;
 
 public:
 
@@ -138,15 +341,15 @@ public:
 
     m_pidlinks.reserve(0x20000);
     m_entries.reserve(0x20000);
+    m_sizes.reserve(0x20000);
 
     auto& root = m_entries.emplace_back(path_id::root(), fs_gname(""), entry_kind::root, true);
+    m_sizes.emplace_back();
     m_pidlinks.emplace(path_id::root(), root_idx);
 
-    int32_t idx = insert_child_entry(
+    m_unids_idx = insert_child_entry(
       root_idx, fs_gname(unidentified_files_directory_name), entry_kind::directory, false
     ).first;
-
-    assert(idx == unids_idx);
   }
 
   ~treefs() = default;
@@ -154,22 +357,36 @@ public:
   // load paths from custom format
   bool load_ardb(const std::filesystem::path& arpath);
 
-  bool load_archive(const std::filesystem::path& path);
+  // mapped: see archive::load_mapped
+  bool load_archive(const std::filesystem::path& path, bool mapped = false);
+
+  // same as calling load_archive for each path, in order, but archives are
+  // opened and their metadata parsed concurrently.
+  // returns the number of loaded archives.
+  size_t load_archives(std::span<const std::filesystem::path> paths, bool mapped = false);
+
+  // The cache holds the tree and the metadata blocks of the loaded archives,
+  // it is valid as long as the same archives are loaded in the same order
+  // and neither they nor their ardbs changed (sizes and write times).
+  bool save_cache(const std::filesystem::path& cache_path) const;
+
+  // replaces this tree, which must not have loaded anything yet, with the
+  // cached one if the cache is valid for archive_paths.
+  // returns false otherwise, the tree is then left untouched.
+  bool load_cache(const std::filesystem::path& cache_path, const std::vector<std::filesystem::path>& archive_paths, bool mapped = false);
 
   // returns total size with files' first segment decompressed
   size_t get_total_size() const
   {
-    compute_info();
-    return m_total_size;
+    return m_sizes[root_idx].size;
   }
 
   size_t get_total_compressed_size() const
   {
-    compute_info();
-    return m_total_compressed_size;
+    return m_sizes[root_idx].disk_size;
   }
 
-  file_handle get_file_handle(path_id pid)
+  file_handle get_file_handle(path_id pid) const
   {
     auto idx = find_entry_idx(pid);
     if (idx >= 0)
@@ -203,33 +420,123 @@ public:
     return std::nullopt;
   }
 
+  // missing pids are mostly answered by the pid filter alone
   bool has_entry(path_id pid) const
   {
     return find_entry_idx(pid) >= 0;
   }
 
+  // entry_kind::none if there is no entry, for existence checks that don't
+  // need a directory_entry
+  entry_kind get_entry_kind(path_id pid) const
+  {
+    auto idx = find_entry_idx(pid);
+    return idx >= 0 ? m_entries[idx].kind : entry_kind::none;
+  }
+
+  // Renumbers entries so that the children of each directory are contiguous
+  // and sorted by name (breadth-first order), to be called once mounting is
+  // done. Listing a directory then walks adjacent entries and children can
+  // be found by name with a binary search (see find_child_entry_idx).
+  // Inserting entries afterwards is fine but loses the sorted layout.
+  void compact();
+
+  bool is_compact() const
+  {
+    return m_compact;
+  }
+
   const std::vector<std::shared_ptr<archive>>& archives() const
   {
     return m_archives;
   }
 
-  void debug_check();
+  // counts of the faulty entries found by check_integrity
+  struct integrity_report
+  {
+    size_t entries_cnt      = 0;
+    size_t null_pids        = 0;
+    size_t bad_parents      = 0; // invalid parent index or the parent isn't a directory
+    size_t orphans          = 0; // not in their parent's children chain
+    size_t multi_chained    = 0; // in several chains, or twice in one
+    size_t broken_chains    = 0; // with an invalid index or a cycle
+    size_t pid_mismatches   = 0; // pid isn't the parent's pid / name
+    size_t unlinked_pids    = 0; // pid isn't linked to the entry
+    size_t bad_files        = 0; // invalid archive or file index
+    size_t unsorted_chains  = 0; // compact trees only
+
+    size_t errors_cnt() const
+    {
+      return null_pids + bad_parents + orphans + multi_chained + broken_chains
+        + pid_mismatches + unlinked_pids + bad_files + unsorted_chains;
+    }
+
+    bool ok() const
+    {
+      return errors_cnt() == 0;
+    }
+
+    integrity_report& operator+=(const integrity_report& other);
+  };
+
+  // Validation pass over the whole tree: the children chains are walked
+  // once to index the parent of each entry, then the entries are checked
+  // concurrently (0 means one worker per hardware thread, 1 disables
+  // threading). The first max_logged faulty entries are logged.
+  integrity_report check_integrity(size_t workers_cnt = 0, size_t max_logged = 16) const;
+
+  // logs the report of check_integrity
+  void debug_check() const;
 
 protected:
 
   int32_t find_entry_idx(path_id pid) const
   {
-    auto it = m_pidlinks.find(pidlink{pid, 0});
-    if (it != m_pidlinks.end())
-    {
-      return it->entry_idx;
-    }
-    return -1;
+    return m_pidlinks.find(pid);
+  }
+
+  const detail::treefs::size_info& get_sizes(int32_t entry_idx) const
+  {
+    return m_sizes[entry_idx];
   }
 
+  // returns -1 if not found, binary search if the tree is compact
+  int32_t find_child_entry_idx(int32_t parent_entry_idx, std::string_view name) const;
+
+  // first child whose name starts with prefix, -1 if none.
+  // binary search if the tree is compact, matching children are then adjacent.
+  int32_t find_first_child_with_prefix(int32_t parent_entry_idx, std::string_view prefix) const;
+
+  // next sibling whose name starts with prefix, -1 if none.
+  // if the tree is compact it stops at the first sibling that doesn't match.
+  int32_t find_next_with_prefix(int32_t entry_idx, std::string_view prefix) const;
+
+  // children counts of directories, valid if compact
+  void rebuild_children_counts();
+
   // using an entry from another tree would be a mistake
   // so (const entry& e) variants are protected
 
+  detail::treefs::entry_name get_name(const entry& e) const
+  {
+    if (e.flags & entry::flag::synthetic_name)
+    {
+      return detail::treefs::entry_name(path_id(m_archives[e.archive_idx]->records()[e.file_idx].fid));
+    }
+    return detail::treefs::entry_name(e.name);
+  }
+
+  // order of the children of compact directories
+  bool name_less(const entry& a, const entry& b) const
+  {
+    if ((a.flags & b.flags) & entry::flag::synthetic_name)
+    {
+      // fixed-width hex names sort like the pids
+      return m_archives[a.archive_idx]->records()[a.file_idx].fid.hash < m_archives[b.archive_idx]->records()[b.file_idx].fid.hash;
+    }
+    return get_name(a).strv() < get_name(b).strv();
+  }
+
   std::optional<path> get_depot_path(const entry& e) const
   {
     if (e.flags & entry::flag::has_depot_path)
@@ -262,33 +569,39 @@ protected:
     {
       assert(e.parent_entry_idx >= 0); // only root has no parent
       append_path(p, m_entries[e.parent_entry_idx]);
-      p /= path(e.name.strv(), path::already_normalized_tag{});
+      p /= path(get_name(e).strv(), path::already_normalized_tag{});
     }
   }
 
+  bool can_load_archive(const std::filesystem::path& path) const;
+
+  // adds the archive and maps its records into the tree
+  bool mount_archive(const std::shared_ptr<archive>& ar);
+
   // pair's second is set to true if insertion happened
   std::pair<int32_t, bool> insert_child_entry(int32_t parent_entry_idx, fs_gname name, entry_kind type, bool is_depot_path);
 
-  void compute_info() const
+  // same with the pid of the entry already computed (parent's pid / name)
+  std::pair<int32_t, bool> insert_child_entry(int32_t parent_entry_idx, fs_gname name, path_id pid, entry_kind type, bool is_depot_path);
+
+  // sets the sizes of a file entry and updates its ancestors' ones
+  void set_file_sizes(int32_t entry_idx, const detail::treefs::size_info& sizes)
   {
-    if (m_cached_info_dirty)
-    {
-      m_total_compressed_size = 0;
-      m_total_size = 0;
-      for (const auto& e : m_entries)
-      {
-        if (e.kind == entry_kind::file)
-        {
-          auto finfo = m_archives[e.archive_idx]->get_file_info(e.file_idx);
-          m_total_compressed_size += finfo.disk_size;
-          m_total_size += finfo.size;
-        }
-      }
+    const auto old_sizes = m_sizes[entry_idx];
+    // unsigned wrap-around gives the right sums for shrinking deltas
+    const uint64_t dsize = sizes.size - old_sizes.size;
+    const uint64_t ddisk_size = sizes.disk_size - old_sizes.disk_size;
 
-      m_cached_info_dirty = false;
+    for (int32_t idx = entry_idx; idx >= 0; idx = m_entries[idx].parent_entry_idx)
+    {
+      m_sizes[idx].size += dsize;
+      m_sizes[idx].disk_size += ddisk_size;
     }
   }
 
+  // recomputes all sizes from the files
+  void rebuild_sizes();
+
   bool is_valid_entry_index(int32_t idx) const
   {
     return idx >= 0 && idx < m_entries.size();
@@ -298,31 +611,18 @@ private:
 
   std::vector<entry> m_entries;
 
-  struct pidlink
-  {
-    pidlink(path_id pid, int32_t entry_idx)
-      : pid(pid), entry_idx(entry_idx) {}
-
-    path_id pid;
-    int32_t entry_idx;
-  };
-
-  struct pidlink_hash {
-    size_t operator()(const pidlink& x) const { return x.pid.hash; }
-  };
-
-  struct pidlink_eq {
-    size_t operator()(const pidlink& a, const pidlink& b) const { return a.pid.hash == b.pid.hash; }
-  };
-
-  std::unordered_set<pidlink, pidlink_hash, pidlink_eq> m_pidlinks;
+  detail::treefs::pidlink_table m_pidlinks;
 
   std::vector<std::shared_ptr<archive>> m_archives;
   bool m_full = false;
 
-  mutable size_t m_total_compressed_size = 0;
-  mutable size_t m_total_size = 0; // with files' first segment decompressed
-  mutable bool m_cached_info_dirty = true;
+  int32_t m_unids_idx = -1;
+
+  bool m_compact = false;
+  std::vector<uint32_t> m_children_cnts; // per entry, only if compact
+
+  // per entry, kept up to date while mounting
+  std::vector<detail::treefs::size_info> m_sizes;
 };
 
 } // namespace cp::filesystem
@@ -7,6 +7,10 @@
 #include <spdlog/spdlog.h>
 #include "common.hpp"
 #include "ctypes.hpp"
+#include "asset_db.hpp"
+#include "scripting/cclass.hpp"
+#include "startup_snapshot.hpp"
+#include "common/trace_recorder.hpp"
 
 namespace cp {
 
@@ -39,6 +43,14 @@ bool load_from_json(std::filesystem::path path, T& out)
   return true;
 }
 
+// interns strs in bulk (one allocation and one lock per pool shard)
+void register_names(const std::vector<std::string>& strs, std::vector<gname>& out)
+{
+  const std::vector<std::string_view> svs(strs.begin(), strs.end());
+  const std::vector<gname> names = gname::register_strings(svs);
+  out.insert(out.end(), names.begin(), names.end());
+}
+
 bool load_names_from_txt(std::filesystem::path path, std::vector<gname>& out)
 {
   auto relpath = std::filesystem::relative(path);
@@ -48,14 +60,16 @@ bool load_names_from_txt(std::filesystem::path path, std::vector<gname>& out)
   {
     try
     {
+      std::vector<std::string> lines;
       std::string line;
       while (std::getline(ifs, line))
       {
           if (line.size())
           {
-            out.emplace_back(line);
+            lines.emplace_back(std::move(line));
           }
       }
+      register_names(lines, out);
     }
     catch (std::exception&)
     {
@@ -72,18 +86,100 @@ bool load_names_from_txt(std::filesystem::path path, std::vector<gname>& out)
   return true;
 }
 
+// compiled db first (see asset_db.hpp), json if it can't be loaded
+bool load_names_from_db(std::filesystem::path json_path, std::vector<gname>& out)
+{
+  if (asset_db::load_names(json_path, out))
+  {
+    return true;
+  }
+
+  std::vector<std::string> strs;
+  if (!load_from_json(json_path, strs))
+  {
+    return false;
+  }
+
+  register_names(strs, out);
+  return true;
+}
+
+bool load_enums_from_db(std::filesystem::path json_path, CEnum_resolver& out)
+{
+  std::vector<asset_db::enum_record> enums;
+  if (!asset_db::load_enums(json_path, enums))
+  {
+    return load_from_json(json_path, out);
+  }
+
+  out.clear();
+  out.reserve(enums.size());
+  for (auto& e : enums)
+  {
+    std::vector<CEnum_member> members;
+    members.reserve(e.members.size());
+    for (uint32_t i = 0; i < (uint32_t)e.members.size(); ++i)
+    {
+      members.emplace_back(e.members[i], i);
+    }
+    out.register_enum(e.name, std::make_shared<CEnum_desc>(e.name, std::move(members)));
+  }
+
+  return true;
+}
+
+// dbs of the resolvers, a change in one of them invalidates the snapshot
+const std::filesystem::path resolver_sources[] = {
+  "./db/TweakDBIDs.json",
+  "./db/internal_names.txt",
+  "./db/CFacts.json",
+  "./db/CEnums.json",
+};
+
+const std::filesystem::path resolvers_snapshot_path = "./db/resolvers_snapshot.cpdb";
+
 // TODO: rename this an add progress param
+// the resolvers are read-only from then on, see TweakDBID_resolver
+void freeze_resolvers()
+{
+  TweakDBID_resolver::get().freeze();
+  CFact_resolver::get().freeze();
+}
+
 op_status init_cpinternals(bool with_archive_names)
 {
+  // CP_TRACE, so that any program can be traced (no-op if already recording)
+  trace_recorder::get().start_from_env();
+
+  if (load_startup_snapshot(resolvers_snapshot_path, resolver_sources))
+  {
+    freeze_resolvers();
+    return true;
+  }
+
   {
     std::vector<gname> names;
-    load_from_json("./db/TweakDBIDs.json", names);
+    load_names_from_db("./db/TweakDBIDs.json", names);
     TweakDBID_resolver::get().feed(names);
   }
 
+  // with the hashes of its compiled db, CNames resolve without locking
+  {
+    std::vector<gname> names;
+    std::vector<uint64_t> hashes;
+    if (asset_db::load_names("./db/internal_names.txt", names, hashes))
+    {
+      CName_resolver::get().feed(names, hashes);
+    }
+    else
+    {
+      load_names_from_txt("./db/internal_names.txt", names);
+      CName_resolver::get().feed(names);
+    }
+  }
+
   {
     std::vector<gname> names;
-    load_names_from_txt("./db/internal_names.txt", names);
 
     if (0 && with_archive_names)
     {
@@ -100,16 +196,24 @@ op_status init_cpinternals(bool with_archive_names)
 
   {
     std::vector<gname> names;
-    load_from_json("./db/CFacts.json", names);
+    load_names_from_db("./db/CFacts.json", names);
     CFact_resolver::get().feed(names);
   }
 
   {
-    load_from_json("./db/CEnums.json", CEnum_resolver::get());
+    load_enums_from_db("./db/CEnums.json", CEnum_resolver::get());
   }
 
+  write_startup_snapshot(resolvers_snapshot_path, resolver_sources);
+  freeze_resolvers();
+
   return true;
 }
 
+void preload_blueprints()
+{
+  CObjectBPList::get();
+}
+
 } // namespace cp
 
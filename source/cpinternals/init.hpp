@@ -5,5 +5,9 @@ namespace cp {
 
 op_status init_cpinternals(bool with_archive_names = true);
 
+// loads the blueprints db (CObjectBPList) before fanning out, so that the
+// workers don't wait on its first use
+void preload_blueprints();
+
 }
 
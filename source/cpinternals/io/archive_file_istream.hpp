@@ -1,8 +1,10 @@
 #pragma once
 #include <fstream>
 #include <filesystem>
+#include <memory>
 #include <cpinternals/common.hpp>
 #include <cpinternals/archive/archive.hpp>
+#include <cpinternals/oodle/oodle.hpp>
 
 namespace cp {
 
@@ -14,11 +16,23 @@ struct archive_file_istream
   {
     none = 0,
     //minimize_buffering = 1, // skips buffering for whole segment or file reads
+    // a compressed first segment of at least streaming_min_size is decoded
+    // incrementally (see oodle::stream_decoder) instead of whole: memory is
+    // bounded by streaming_window_size. reads of it are expected to be
+    // sequential, reading backward restarts its decoding.
+    streaming = 4,
   };
 
+  static constexpr size_t streaming_min_size = 64 * 1024 * 1024;
+  static constexpr size_t streaming_window_size = 16 * 1024 * 1024;
+
   archive_file_istream() = default;
   ~archive_file_istream() override = default;
 
+  // move-only (streaming decoder), reset() relies on the move assignment
+  archive_file_istream(archive_file_istream&&) = default;
+  archive_file_istream& operator=(archive_file_istream&&) = default;
+
   archive_file_istream(const archive::file_handle& handle, option options = option::none)
   {
     open(handle, options);
@@ -29,8 +43,7 @@ struct archive_file_istream
     return true;
   }
 
-  // in sequential_reading mode segments are released once fully read
-  // otherwise loaded segments stay in memory (todo: limit the number of segments..)
+  // loaded segments stay in memory (todo: limit the number of segments..)
   bool open(const archive::file_handle& handle, option options = option::none)
   {
     if (is_open())
@@ -56,6 +69,7 @@ struct archive_file_istream
     auto segs = frec.segs_irange.slice(m_archive->segments());
 
     m_segment_descs = std::vector<radr::segment_descriptor>(segs.begin(), segs.end());
+    m_first_seg_idx = frec.segs_irange.beg();
 
     // here we could merge descriptors to tweak the buffering if desired
     // the game seems to buffer "inline buffers" with the first segment
@@ -132,7 +146,10 @@ struct archive_file_istream
 
   size_t buffered_size() const
   {
-    return m_buffer.size();
+    size_t ret = m_buffer.size();
+    if (m_stream)
+      ret += m_stream->buffers_size();
+    return ret;
   }
 
   bool buffer_all()
@@ -185,16 +202,25 @@ struct archive_file_istream
 
     // special behavior for first segment (decompression required)
     const auto& sd0 = m_segment_descs[0];
+    if (pos < sd0.size && is_sd0_streamed())
+    {
+      return read_some_streamed(dst, pos, end);
+    }
+
     if (pos < sd0.size)
     {
+      // decompressed segments are shared through the archive's segment cache
+      const auto sd0_buf = m_archive->read_segment_cached(m_first_seg_idx);
+      if (!sd0_buf)
+      {
+        set_error("couldn't read and decompress first segment");
+        return 0;
+      }
+
       if (pos == 0 && end >= sd0.size)
       {
         // skip buffering
-        if (!m_archive->read_segment(sd0, dst.subspan(0, sd0.size), true))
-        {
-          set_error("couldn't read and decompress first segment");
-          return 0;
-        }
+        std::copy(sd0_buf->begin(), sd0_buf->end(), dst.begin());
 
         SPDLOG_DEBUG("read full sd0");
         m_pos += sd0.size;
@@ -203,13 +229,7 @@ struct archive_file_istream
       else
       {
         m_buffer_pos = 0;
-        m_buffer.resize(sd0.size);
-        if (!m_archive->read_segment(sd0, m_buffer, true))
-        {
-          m_buffer.clear();
-          set_error("couldn't read and decompress first segment");
-          return 0;
-        }
+        m_buffer.assign(sd0_buf->begin(), sd0_buf->end());
 
         const size_t read_end = std::min(size_t(sd0.size), end);
         const size_t read_size = read_end - pos;
@@ -388,6 +408,63 @@ protected:
     *this = archive_file_istream();
   }
 
+  // streaming mode
+
+  bool is_sd0_streamed() const
+  {
+    const auto& sd0 = m_segment_descs[0];
+    return (m_options & option::streaming) && sd0.is_segment_compressed()
+      && sd0.size >= streaming_min_size && oodle::stream_decoder::is_available();
+  }
+
+  size_t read_some_streamed(const std::span<char>& dst, size_t pos, size_t end)
+  {
+    const auto& sd0 = m_segment_descs[0];
+
+    if (!m_stream || pos < m_stream->tell())
+    {
+      auto source = [ar = m_archive, sd0](uint64_t offset, std::span<char> dst) -> bool {
+        radr::segment_descriptor part = sd0;
+        part.offset_in_archive += offset;
+        part.disk_size = static_cast<uint32_t>(dst.size());
+        part.size = 0;
+        return ar->read_segment(part, dst, false);
+      };
+
+      m_stream = std::make_unique<oodle::stream_decoder>();
+      if (!m_stream->open(sd0.disk_size, sd0.size, streaming_window_size, std::move(source)))
+      {
+        m_stream.reset();
+        set_error("couldn't open the first segment's stream");
+        return 0;
+      }
+    }
+
+    if (pos > m_stream->tell() && !m_stream->skip(pos - m_stream->tell()))
+    {
+      m_stream.reset();
+      set_error("couldn't decompress first segment");
+      return 0;
+    }
+
+    const size_t read_size = std::min(size_t(sd0.size), end) - pos;
+    if (!m_stream->read(dst.subspan(0, read_size)))
+    {
+      m_stream.reset();
+      set_error("couldn't decompress first segment");
+      return 0;
+    }
+
+    if (m_stream->tell() == sd0.size)
+    {
+      m_stream.reset();
+    }
+
+    SPDLOG_DEBUG("read {:08X} bytes of streamed sd0", read_size);
+    m_pos += read_size;
+    return read_size;
+  }
+
 private:
 
   std::shared_ptr<const archive> m_archive;
@@ -396,10 +473,13 @@ private:
   archive::file_info m_finfo;
 
   std::vector<radr::segment_descriptor> m_segment_descs;
+  uint32_t m_first_seg_idx = 0;
 
   std::vector<char> m_buffer;
   size_t m_buffer_pos = 0;
 
+  std::unique_ptr<oodle::stream_decoder> m_stream;
+
   pos_type m_pos = 0;
 };
 
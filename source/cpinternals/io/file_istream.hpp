@@ -1,35 +1,54 @@
 #pragma once
-#include <fstream>
 #include <filesystem>
+#include <cstring>
 #include <cpinternals/common.hpp>
+#include <cpinternals/os/file_reader.hpp>
 
 namespace cp {
 
 // Input binary file stream
+// reads go through a single buffer filled with positional reads of an
+// os::file_reader. the unread part of the buffer is the direct access
+// window of streambase (small reads are inlined copies), larger reads bypass
+// the buffer. seeking within the buffered range keeps it.
 struct file_istream
   : streambase
 {
+  static constexpr size_t buffer_size = 0x100000;
+
   file_istream() = default;
   ~file_istream() override = default;
 
   file_istream(std::filesystem::path path)
-    : m_ifs(path, std::ios_base::binary)
   {
+    open(path);
   }
 
   file_istream(const char* filename)
-    : m_ifs(filename, std::ios_base::binary)
   {
+    open(filename);
   }
 
   file_istream(file_istream&& other)
-    : m_ifs(std::move(other.m_ifs))
   {
+    *this = std::move(other);
   }
 
   file_istream& operator=(file_istream&& rhs)
   {
-    m_ifs = std::move(rhs.m_ifs);
+    if (this != &rhs)
+    {
+      streambase::operator=(rhs);
+      m_reader = std::move(rhs.m_reader);
+      m_path = std::move(rhs.m_path);
+      m_file_size = rhs.m_file_size;
+      m_buf = std::move(rhs.m_buf);
+      m_buf_pos = rhs.m_buf_pos;
+      rhs.m_rcur = nullptr;
+      rhs.m_rend = nullptr;
+      rhs.m_file_size = 0;
+      rhs.m_buf_pos = 0;
+    }
     return *this;
   }
 
@@ -37,28 +56,60 @@ struct file_istream
   {
     if (this != &other)
     {
-        m_ifs.swap(other.m_ifs);
+      std::swap(*this, other);
     }
   }
 
   void open(std::filesystem::path path)
   {
-    m_ifs.open(path, std::ios_base::binary);
+    close();
+
+    if (!m_reader.open(path))
+    {
+      set_error("file_istream: couldn't open file");
+      return;
+    }
+
+    m_path = path;
+    m_file_size = m_reader.size();
+    if (!m_buf)
+    {
+      m_buf = make_page_aligned_buffer(buffer_size);
+    }
+    reset_buffer(0);
   }
 
   void open(const char* filename)
   {
-    m_ifs.open(filename, std::ios_base::binary);
+    open(std::filesystem::path(filename));
   }
 
   bool is_open() const
   {
-    return m_ifs.is_open();
+    return m_reader.is_open();
   }
 
   void close()
   {
-    m_ifs.close();
+    if (is_open())
+    {
+      m_reader.close();
+    }
+
+    m_path.clear();
+    m_file_size = 0;
+    reset_buffer(0);
+  }
+
+  size_t size() const
+  {
+    return m_file_size;
+  }
+
+  // path of the opened file, e.g. to map it for in-place reads
+  const std::filesystem::path& path() const
+  {
+    return m_path;
   }
 
   bool is_reader() const override
@@ -68,35 +119,112 @@ struct file_istream
 
   pos_type tell() const override
   {
-    return m_ifs.tellg();
+    return static_cast<pos_type>(m_buf_pos + (m_rcur - m_buf.get()));
   }
 
   streambase& seek(pos_type pos) override
   {
-    m_ifs.seekg(pos);
+    const size_t upos = static_cast<size_t>(pos);
+    if (upos >= m_buf_pos && upos <= m_buf_pos + buf_len())
+    {
+      m_rcur = m_buf.get() + (upos - m_buf_pos);
+    }
+    else
+    {
+      reset_buffer(upos);
+    }
     return *this;
   }
 
   streambase& seek(off_type off, seekdir dir) override
   {
-    m_ifs.seekg(off, dir);
+    switch (dir)
+    {
+      case beg: return seek(static_cast<pos_type>(off));
+      case cur: return seek(tell() + static_cast<pos_type>(off));
+      case end: return seek(static_cast<pos_type>(m_file_size) + static_cast<pos_type>(off));
+      default: break;
+    }
     return *this;
   }
 
   streambase& serialize_bytes(void* data, size_t size) override
   {
-    m_ifs.read(static_cast<char*>(data), size);
-    return *this;
+    if (size <= static_cast<size_t>(m_rend - m_rcur))
+    {
+      std::memcpy(data, m_rcur, size);
+      m_rcur += size;
+      return *this;
+    }
+
+    return read_slow(static_cast<char*>(data), size);
   }
 
-  void swap_underlying_stream(std::ifstream& other)
+protected:
+
+  size_t buf_len() const
   {
-    m_ifs.swap(other);
+    return static_cast<size_t>(m_rend - m_buf.get());
   }
 
-protected:
+  // empties the buffer, pos becomes its file offset
+  void reset_buffer(size_t pos)
+  {
+    m_buf_pos = pos;
+    m_rcur = m_buf.get();
+    m_rend = m_buf.get();
+  }
+
+  streambase& read_slow(char* dst, size_t size)
+  {
+    // buffered remainder first
+    const size_t avail = static_cast<size_t>(m_rend - m_rcur);
+    if (avail)
+    {
+      std::memcpy(dst, m_rcur, avail);
+      dst += avail;
+      size -= avail;
+    }
+
+    const size_t pos = m_buf_pos + buf_len();
+    reset_buffer(pos);
+
+    if (!is_open() || pos > m_file_size || size > m_file_size - pos)
+    {
+      set_error("file_istream: read past end of file");
+      return *this;
+    }
+
+    if (size >= buffer_size)
+    {
+      if (!m_reader.read_at(pos, std::span<char>(dst, size)))
+      {
+        set_error("file_istream: read failed");
+        return *this;
+      }
+      reset_buffer(pos + size);
+      return *this;
+    }
+
+    const size_t fill_size = std::min(buffer_size, m_file_size - pos);
+    if (!m_reader.read_at(pos, std::span<char>(m_buf.get(), fill_size)))
+    {
+      set_error("file_istream: read failed");
+      return *this;
+    }
+
+    std::memcpy(dst, m_buf.get(), size);
+    m_rcur = m_buf.get() + size;
+    m_rend = m_buf.get() + fill_size;
+    return *this;
+  }
+
+  os::file_reader m_reader;
+  std::filesystem::path m_path;
+  size_t m_file_size = 0;
 
-  mutable std::ifstream m_ifs;
+  page_aligned_buffer m_buf;
+  size_t m_buf_pos = 0; // file offset of m_buf[0]
 };
 
 } // namespace cp
@@ -1,41 +1,80 @@
 #pragma once
-#include <fstream>
 #include <filesystem>
+#include <cstring>
 #include <cpinternals/common.hpp>
+#include <cpinternals/os/file_writer.hpp>
 
 namespace cp {
 
 // Output binary file stream
+// writes are appended to a single buffer that is flushed with a positional
+// write of an os::file_writer when full, on seek and on close.
+// the free part of the buffer is the direct access window of streambase
+// (small writes are inlined copies), writes larger than the buffer bypass it.
 struct file_ostream
   : streambase
 {
+  static constexpr size_t buffer_size = 0x100000;
+
   file_ostream() = default;
 
   file_ostream(std::filesystem::path path)
-    : m_ofs(path, std::ios_base::binary)
   {
+    open(path);
   }
 
   file_ostream(const char* filename)
-    : m_ofs(filename, std::ios_base::binary)
   {
+    open(filename);
   }
 
-  ~file_ostream() override = default;
+  ~file_ostream() override
+  {
+    close();
+  }
 
-  void open(std::filesystem::path path)
+  // with truncate false the existing content is kept, writes start at 0
+  // (seek past it to append)
+  void open(std::filesystem::path path, bool truncate = true)
   {
-    m_ofs.open(path, std::ios_base::binary);
+    close();
+
+    m_good = m_writer.open(path, truncate);
+    if (!m_good)
+    {
+      return;
+    }
+
+    if (!m_buf)
+    {
+      m_buf = make_page_aligned_buffer(buffer_size);
+    }
+    reset_buffer(0);
   }
 
   void open(const char* filename)
   {
-    m_ofs.open(filename, std::ios_base::binary);
+    open(std::filesystem::path(filename));
   }
 
   void close()
   {
-    m_ofs.close();
+    if (!m_writer.is_open())
+    {
+      return;
+    }
+
+    flush();
+    m_writer.close();
+    m_buf.reset();
+
+    reset_buffer(0);
+    m_file_size = 0;
+  }
+
+  bool good() const
+  {
+    return m_good;
   }
 
   bool is_reader() const override
@@ -45,30 +84,112 @@ struct file_ostream
 
   virtual pos_type tell() const override
   {
-    return m_ofs.tellp();
+    return static_cast<pos_type>(m_buf_pos + buf_len());
   }
 
   virtual streambase& seek(pos_type pos) override
   {
-    m_ofs.seekp(pos);
+    flush();
+    reset_buffer(static_cast<size_t>(pos));
     return *this;
   }
 
   virtual streambase& seek(off_type off, seekdir dir) override
   {
-    m_ofs.seekp(off, dir);
+    switch (dir)
+    {
+      case beg: return seek(static_cast<pos_type>(off));
+      case cur: return seek(tell() + static_cast<pos_type>(off));
+      case end: return seek(static_cast<pos_type>(file_size()) + static_cast<pos_type>(off));
+      default: break;
+    }
     return *this;
   }
 
   virtual streambase& serialize_bytes(void* data, size_t size) override
   {
-    m_ofs.write(static_cast<char*>(data), size);
-    return *this;
+    if (m_buf && size <= static_cast<size_t>(m_wend - m_wcur))
+    {
+      std::memcpy(m_wcur, data, size);
+      m_wcur += size;
+      return *this;
+    }
+
+    return write_slow(static_cast<const char*>(data), size);
   }
 
 protected:
 
-  mutable std::ofstream m_ofs;
+  size_t buf_len() const
+  {
+    return static_cast<size_t>(m_wcur - m_buf.get());
+  }
+
+  size_t file_size() const
+  {
+    return std::max(m_file_size, m_buf_pos + buf_len());
+  }
+
+  // empties the buffer, pos becomes its file offset
+  void reset_buffer(size_t pos)
+  {
+    m_buf_pos = pos;
+    m_wcur = m_buf.get();
+    m_wend = m_buf ? m_buf.get() + buffer_size : nullptr;
+  }
+
+  void flush()
+  {
+    const size_t len = buf_len();
+    if (!len)
+    {
+      return;
+    }
+
+    if (!m_writer.write_at(m_buf_pos, std::span<const char>(m_buf.get(), len)))
+    {
+      m_good = false;
+      set_error("file_ostream: write failed");
+    }
+
+    reset_buffer(m_buf_pos + len);
+    m_file_size = std::max(m_file_size, m_buf_pos);
+  }
+
+  streambase& write_slow(const char* src, size_t size)
+  {
+    if (!m_writer.is_open())
+    {
+      m_good = false;
+      set_error("file_ostream: file is not open");
+      return *this;
+    }
+
+    flush();
+
+    if (size >= buffer_size)
+    {
+      if (!m_writer.write_at(m_buf_pos, std::span<const char>(src, size)))
+      {
+        m_good = false;
+        set_error("file_ostream: write failed");
+      }
+      reset_buffer(m_buf_pos + size);
+      m_file_size = std::max(m_file_size, m_buf_pos);
+      return *this;
+    }
+
+    std::memcpy(m_wcur, src, size);
+    m_wcur += size;
+    return *this;
+  }
+
+  os::file_writer m_writer;
+  bool m_good = false;
+
+  page_aligned_buffer m_buf;
+  size_t m_buf_pos = 0; // file offset of m_buf[0]
+  size_t m_file_size = 0; // flushed extent
 };
 
 } // namespace cp
@@ -0,0 +1,58 @@
+#pragma once
+#include <filesystem>
+#include <cpinternals/common.hpp>
+#include <cpinternals/os/file_mapping.hpp>
+#include <cpinternals/io/memory_istream.hpp>
+
+namespace cp {
+
+// Input stream over a memory-mapped file.
+// Being a memory_istream, consumers can view() the mapped pages directly.
+struct mapped_file_istream
+  : memory_istream
+{
+  mapped_file_istream()
+    : memory_istream(nullptr, 0) {}
+
+  mapped_file_istream(const std::filesystem::path& path)
+    : memory_istream(nullptr, 0)
+  {
+    open(path);
+  }
+
+  ~mapped_file_istream() override = default;
+
+  bool open(const std::filesystem::path& path)
+  {
+    close();
+
+    if (!m_mapping.open(path))
+    {
+      set_error("mapped_file_istream: couldn't map file");
+      return false;
+    }
+
+    m_span = m_mapping.view();
+    set_pos(0);
+    return true;
+  }
+
+  bool is_open() const
+  {
+    return m_mapping.is_open();
+  }
+
+  void close()
+  {
+    m_mapping.close();
+    m_span = {};
+    set_pos(0);
+  }
+
+protected:
+
+  os::file_mapping m_mapping;
+};
+
+} // namespace cp
+
@@ -12,10 +12,16 @@ struct memory_istream
   ~memory_istream() override = default;
 
   memory_istream(std::span<const char> span)
-    : m_span(span), m_pos(0) {}
+    : m_span(span)
+  {
+    set_pos(0);
+  }
 
   memory_istream(const char* data, size_t size)
-    : m_span(data, size), m_pos(0) {}
+    : m_span(data, size)
+  {
+    set_pos(0);
+  }
 
   bool is_reader() const override
   {
@@ -24,12 +30,12 @@ struct memory_istream
 
   pos_type tell() const override
   {
-    return m_pos;
+    return pos();
   }
 
   streambase& seek(pos_type pos) override
   {
-    m_pos = pos;
+    set_pos(pos);
     return *this;
   }
 
@@ -38,13 +44,13 @@ struct memory_istream
     switch (dir)
     {
       case beg:
-        m_pos = off;
+        set_pos(off);
         break;
       case cur:
-        m_pos += off;
+        set_pos(pos() + off);
         break;
       case end:
-        m_pos = m_span.size() + off;
+        set_pos(m_span.size() + off);
         break;
     }
     return *this;
@@ -52,10 +58,10 @@ struct memory_istream
 
   streambase& serialize_bytes(void* data, size_t size) override
   {
-    if (m_pos >= 0 && m_pos + size <= m_span.size())
+    if (size <= static_cast<size_t>(m_rend - m_rcur))
     {
-      memcpy(data, m_span.data() + m_pos, size);
-      m_pos += size;
+      memcpy(data, m_rcur, size);
+      m_rcur += size;
     }
     else
     {
@@ -70,10 +76,10 @@ struct memory_istream
   {
     const T* ret = nullptr;
 
-    if (m_pos >= 0 && m_pos + sizeof(T) <= m_span.size())
+    if (sizeof(T) <= static_cast<size_t>(m_rend - m_rcur))
     {
-      ret = reinterpret_cast<T*>(m_span.data() + m_pos);
-      m_pos += sizeof(T);
+      ret = reinterpret_cast<const T*>(m_rcur);
+      m_rcur += sizeof(T);
     }
     else
     {
@@ -90,10 +96,10 @@ struct memory_istream
 
     const size_t size = cnt * sizeof(T);
 
-    if (m_pos >= 0 && m_pos + size <= m_span.size())
+    if (size <= static_cast<size_t>(m_rend - m_rcur))
     {
-      ret = std::span<T>(m_span.data() + m_pos, cnt);
-      m_pos += size;
+      ret = std::span<const T>(reinterpret_cast<const T*>(m_rcur), cnt);
+      m_rcur += size;
     }
     else
     {
@@ -115,6 +121,28 @@ struct memory_istream
 
 protected:
 
+  // the read window is [data() + pos, data() + size()) when pos is in
+  // bounds, empty otherwise (reads then fail, m_pos keeps the position).
+  void set_pos(pos_type pos)
+  {
+    m_pos = pos;
+    if (pos >= 0 && static_cast<size_t>(pos) <= m_span.size())
+    {
+      m_rcur = m_span.data() + pos;
+      m_rend = m_span.data() + m_span.size();
+    }
+    else
+    {
+      m_rcur = nullptr;
+      m_rend = nullptr;
+    }
+  }
+
+  pos_type pos() const
+  {
+    return m_rend ? static_cast<pos_type>(m_rcur - m_span.data()) : m_pos;
+  }
+
   std::span<const char> m_span;
   pos_type m_pos = 0;
 };
@@ -0,0 +1,294 @@
+#pragma once
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <vector>
+#include <cpinternals/common.hpp>
+
+namespace cp {
+
+// Output memory stream
+// data is written into a list of chunks that are never reallocated: growing
+// appends a new chunk (sized like the current capacity, so growth stays
+// geometric) instead of copying what was already written.
+// the free part of the current chunk is the direct access window of
+// streambase. seeking back to patch written data is supported, seeking past
+// the end pads with zeros.
+// gather() returns the data as one contiguous span, it only copies if the
+// data spans several chunks (then keeps the merged chunk for reuse).
+// clear() keeps the chunks, a stream can be reused for repeated saves.
+struct memory_ostream
+  : streambase
+{
+  static constexpr size_t min_chunk_size = 0x10000;
+  static constexpr size_t max_chunk_size = 0x4000000;
+
+  memory_ostream() = default;
+  ~memory_ostream() override = default;
+
+  explicit memory_ostream(size_t reserved_size)
+  {
+    reserve(reserved_size);
+  }
+
+  memory_ostream(const memory_ostream&) = delete;
+  memory_ostream& operator=(const memory_ostream&) = delete;
+
+  bool is_reader() const override
+  {
+    return false;
+  }
+
+  pos_type tell() const override
+  {
+    if (m_chunks.empty())
+    {
+      return 0;
+    }
+
+    const auto& c = m_chunks[m_cur];
+    return static_cast<pos_type>(c.offset + (m_wcur - c.data.get()));
+  }
+
+  streambase& seek(pos_type pos) override
+  {
+    if (pos < 0)
+    {
+      set_error("memory_ostream: negative seek");
+      return *this;
+    }
+
+    sync_size();
+
+    const size_t upos = static_cast<size_t>(pos);
+    if (upos > m_size)
+    {
+      // zero padding up to pos
+      set_window(m_size);
+      write_zeros(upos - m_size);
+      return *this;
+    }
+
+    set_window(upos);
+    return *this;
+  }
+
+  streambase& seek(off_type off, seekdir dir) override
+  {
+    switch (dir)
+    {
+      case beg: return seek(static_cast<pos_type>(off));
+      case cur: return seek(tell() + static_cast<pos_type>(off));
+      case end: return seek(static_cast<pos_type>(size()) + static_cast<pos_type>(off));
+      default: break;
+    }
+    return *this;
+  }
+
+  streambase& serialize_bytes(void* data, size_t size) override
+  {
+    if (size <= static_cast<size_t>(m_wend - m_wcur))
+    {
+      std::memcpy(m_wcur, data, size);
+      m_wcur += size;
+      return *this;
+    }
+
+    write_slow(static_cast<const char*>(data), size);
+    return *this;
+  }
+
+  // written size (the end of the furthest write)
+  size_t size() const
+  {
+    return std::max(m_size, static_cast<size_t>(tell()));
+  }
+
+  size_t capacity() const
+  {
+    return m_chunks.empty() ? 0 : m_chunks.back().offset + m_chunks.back().capacity;
+  }
+
+  // makes room for cnt bytes in total, in a single chunk if nothing has been
+  // written yet
+  void reserve(size_t cnt)
+  {
+    if (cnt <= capacity())
+    {
+      return;
+    }
+
+    if (size() == 0)
+    {
+      m_chunks.clear();
+      m_chunks.emplace_back(0, cnt);
+      m_cur = 0;
+      set_window(0);
+      return;
+    }
+
+    const size_t pos = static_cast<size_t>(tell());
+    m_chunks.emplace_back(capacity(), cnt - capacity());
+    set_window(pos);
+  }
+
+  // empties the stream without releasing its memory
+  void clear()
+  {
+    clear_error();
+    m_size = 0;
+    m_cur = 0;
+    set_window(0);
+  }
+
+  // the written data as a contiguous span (e.g. for compression), valid
+  // until the next write
+  std::span<const char> gather()
+  {
+    sync_size();
+
+    if (m_chunks.empty())
+    {
+      return {};
+    }
+
+    if (m_size > m_chunks[0].capacity)
+    {
+      const size_t pos = static_cast<size_t>(tell());
+
+      chunk merged(0, capacity());
+      for (const auto& c : m_chunks)
+      {
+        if (c.offset >= m_size)
+        {
+          break;
+        }
+        std::memcpy(merged.data.get() + c.offset, c.data.get(), std::min(c.capacity, m_size - c.offset));
+      }
+
+      m_chunks.clear();
+      m_chunks.emplace_back(std::move(merged));
+      m_cur = 0;
+      set_window(pos);
+    }
+
+    return std::span<const char>(m_chunks[0].data.get(), m_size);
+  }
+
+  // writes the data to ar chunk by chunk, without gathering it
+  void write_to(streambase& ar) const
+  {
+    const size_t total_size = size();
+    for (const auto& c : m_chunks)
+    {
+      if (c.offset >= total_size)
+      {
+        break;
+      }
+      ar.serialize_bytes(c.data.get(), std::min(c.capacity, total_size - c.offset));
+    }
+  }
+
+protected:
+
+  struct chunk
+  {
+    chunk(size_t offset, size_t capacity)
+      : data(std::make_unique_for_overwrite<char[]>(capacity))
+      , offset(offset), capacity(capacity) {}
+
+    std::unique_ptr<char[]> data;
+    size_t offset; // in the stream
+    size_t capacity;
+  };
+
+  void sync_size()
+  {
+    m_size = size();
+  }
+
+  // pos must be <= capacity()
+  void set_window(size_t pos)
+  {
+    if (m_chunks.empty())
+    {
+      m_wcur = nullptr;
+      m_wend = nullptr;
+      return;
+    }
+
+    // last chunk that starts at or before pos
+    auto it = std::upper_bound(m_chunks.begin(), m_chunks.end(), pos,
+      [](size_t p, const chunk& c) { return p < c.offset; });
+
+    m_cur = static_cast<size_t>(it - m_chunks.begin()) - 1;
+    auto& c = m_chunks[m_cur];
+    m_wcur = c.data.get() + (pos - c.offset);
+    m_wend = c.data.get() + c.capacity;
+  }
+
+  // moves the window to the start of the next chunk, appends one if needed
+  void next_chunk(size_t min_size)
+  {
+    sync_size();
+
+    const size_t next = m_chunks.empty() ? 0 : m_cur + 1;
+    if (next == m_chunks.size())
+    {
+      const size_t chunk_size = std::max(min_size, std::clamp(capacity(), min_chunk_size, max_chunk_size));
+      m_chunks.emplace_back(capacity(), chunk_size);
+    }
+
+    set_window(m_chunks[next].offset);
+  }
+
+  void write_slow(const char* src, size_t size)
+  {
+    while (true)
+    {
+      const size_t n = std::min(size, static_cast<size_t>(m_wend - m_wcur));
+      if (n)
+      {
+        std::memcpy(m_wcur, src, n);
+        m_wcur += n;
+        src += n;
+        size -= n;
+      }
+
+      if (!size)
+      {
+        break;
+      }
+
+      next_chunk(size);
+    }
+  }
+
+  void write_zeros(size_t size)
+  {
+    while (true)
+    {
+      const size_t n = std::min(size, static_cast<size_t>(m_wend - m_wcur));
+      if (n)
+      {
+        std::memset(m_wcur, 0, n);
+        m_wcur += n;
+        size -= n;
+      }
+
+      if (!size)
+      {
+        break;
+      }
+
+      next_chunk(size);
+    }
+  }
+
+  std::vector<chunk> m_chunks;
+  size_t m_cur = 0;  // chunk of the window
+  size_t m_size = 0; // written size, up to the last window move
+};
+
+} // namespace cp
@@ -0,0 +1,130 @@
+#pragma once
+#include <cstring>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace cp {
+
+// Non-virtual binary cursors over contiguous memory, for the hot paths
+// that don't need a streambase (e.g. scripting objects of a CSystem).
+// Little-endian, values are copied byte-wise (no alignment requirement).
+
+// Reading past the end sets a sticky error, the read value is left as is.
+struct span_reader
+{
+  span_reader() = default;
+
+  span_reader(std::span<const char> span)
+    : m_span(span) {}
+
+  size_t size() const { return m_span.size(); }
+  size_t tell() const { return m_pos; }
+  size_t remaining() const { return m_span.size() - m_pos; }
+  bool at_end() const { return m_pos == m_span.size(); }
+
+  bool good() const { return !m_error; }
+  bool has_error() const { return m_error; }
+  void set_error() { m_error = true; }
+
+  // from the start of the span
+  bool seek(size_t pos)
+  {
+    if (pos > m_span.size())
+    {
+      m_error = true;
+      return false;
+    }
+    m_pos = pos;
+    return true;
+  }
+
+  bool skip(size_t cnt)
+  {
+    return seek(m_pos + cnt);
+  }
+
+  bool read_bytes(void* dst, size_t cnt)
+  {
+    if (m_error || cnt > remaining())
+    {
+      m_error = true;
+      return false;
+    }
+    std::memcpy(dst, m_span.data() + m_pos, cnt);
+    m_pos += cnt;
+    return true;
+  }
+
+  template <typename T>
+  bool read(T& val)
+  {
+    static_assert(std::is_trivially_copyable_v<T>);
+    return read_bytes(&val, sizeof(T));
+  }
+
+  // bytes from the cursor to the end
+  std::span<const char> remaining_span() const
+  {
+    return m_span.subspan(m_pos);
+  }
+
+  // reader of [pos, pos + cnt), an erroneous reader if out of bounds
+  span_reader subreader(size_t pos, size_t cnt) const
+  {
+    if (pos > m_span.size() || cnt > m_span.size() - pos)
+    {
+      span_reader ret;
+      ret.m_error = true;
+      return ret;
+    }
+    return span_reader(m_span.subspan(pos, cnt));
+  }
+
+protected:
+  std::span<const char> m_span;
+  size_t m_pos = 0;
+  bool m_error = false;
+};
+
+// Appends to a byte vector, written data can be patched afterwards
+// (e.g. offsets that are only known once the following data is written).
+struct vector_writer
+{
+  vector_writer() = default;
+
+  size_t tell() const { return m_buf.size(); }
+
+  void reserve(size_t cnt)
+  {
+    m_buf.reserve(cnt);
+  }
+
+  void write_bytes(const void* src, size_t cnt)
+  {
+    const auto p = static_cast<const char*>(src);
+    m_buf.insert(m_buf.end(), p, p + cnt);
+  }
+
+  template <typename T>
+  void write(const T& val)
+  {
+    static_assert(std::is_trivially_copyable_v<T>);
+    write_bytes(&val, sizeof(T));
+  }
+
+  // overwrites already written bytes at pos
+  void patch_bytes(size_t pos, const void* src, size_t cnt)
+  {
+    std::memcpy(m_buf.data() + pos, src, cnt);
+  }
+
+  const std::vector<char>& buffer() const { return m_buf; }
+  std::vector<char>& buffer() { return m_buf; }
+
+protected:
+  std::vector<char> m_buf;
+};
+
+} // namespace cp
+
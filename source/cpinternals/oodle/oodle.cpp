@@ -1,6 +1,6 @@
 #include <cpinternals/oodle/oodle.hpp>
 
-// windows-only
+#if defined(_WIN32)
 
 #ifndef WIN32_LEAN_AND_MEAN
   #define WIN32_LEAN_AND_MEAN
@@ -10,15 +10,33 @@
 #endif
 #include <windows.h>
 
-#include <cpinternals/os/platform_utils.hpp>
-
 #define LIBNAME "oo2ext_7_win64.dll"
 
+#else
+
+#include <dlfcn.h>
+
+// the game's dll can't be loaded by a native process, the linux build of
+// the oodle core library exports the same functions
+#define LIBNAME "liboo2corelinux64.so.9"
+
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include <cpinternals/os/platform_utils.hpp>
+#include <cpinternals/common/parallel.hpp>
+#include <cpinternals/common/instrumentation.hpp>
+
 namespace cp::oodle {
 
 struct proc_pointer
 {
-  explicit proc_pointer(FARPROC ptr)
+  explicit proc_pointer(void* ptr)
     : ptr(ptr) {}
 
   template <typename T, typename = std::enable_if_t<std::is_function_v<T>>>
@@ -27,18 +45,60 @@ struct proc_pointer
     return reinterpret_cast<T *>(ptr);
   }
 
-  FARPROC ptr;
+  void* ptr;
 };
 
-proc_pointer get_proc_address(HMODULE module, LPCSTR proc_name)
+#if defined(_WIN32)
+
+void* load_library(const std::filesystem::path& p)
+{
+  return (void*)LoadLibraryW(p.c_str());
+}
+
+void free_library(void* handle)
+{
+  FreeLibrary((HMODULE)handle);
+}
+
+proc_pointer get_proc_address(void* handle, const char* proc_name)
+{
+  return proc_pointer((void*)GetProcAddress((HMODULE)handle, proc_name));
+}
+
+#else
+
+void* load_library(const std::filesystem::path& p)
+{
+  return dlopen(p.c_str(), RTLD_NOW | RTLD_LOCAL);
+}
+
+void free_library(void* handle)
 {
-  return proc_pointer(GetProcAddress(module, proc_name));
+  dlclose(handle);
 }
 
+proc_pointer get_proc_address(void* handle, const char* proc_name)
+{
+  return proc_pointer(dlsym(handle, proc_name));
+}
+
+#endif
+
+// CP_OODLE_LIB is the path of the library to load, otherwise it is searched
+// in the library path then next to the game's executable
 library::library()
 {
-  // todo: could use global settins and try to load it from different locations, e.g. game folder
-  HMODULE handle = LoadLibraryA(LIBNAME);
+  void* handle = nullptr;
+
+  if (const char* env = std::getenv("CP_OODLE_LIB"))
+  {
+    handle = load_library(env);
+  }
+
+  if (!handle)
+  {
+    handle = load_library(LIBNAME);
+  }
 
   if (!handle)
   {
@@ -46,7 +106,7 @@ library::library()
     if (game_path_opt.has_value())
     {
       auto dll_path = game_path_opt.value().replace_filename(LIBNAME);
-      handle = LoadLibraryW(dll_path.c_str());
+      handle = load_library(dll_path);
     }
   }
 
@@ -55,16 +115,20 @@ library::library()
     pfn_OodleLZ_Decompress = get_proc_address(handle, "OodleLZ_Decompress");
     pfn_OodleLZ_Compress = get_proc_address(handle, "OodleLZ_Compress");
     pfn_OodleLZ_GetCompressedBufferSizeNeeded = get_proc_address(handle, "OodleLZ_GetCompressedBufferSizeNeeded");
+    pfn_OodleLZDecoder_MemorySizeNeeded = get_proc_address(handle, "OodleLZDecoder_MemorySizeNeeded");
+    pfn_OodleLZDecoder_Create = get_proc_address(handle, "OodleLZDecoder_Create");
+    pfn_OodleLZDecoder_Destroy = get_proc_address(handle, "OodleLZDecoder_Destroy");
+    pfn_OodleLZDecoder_DecodeSome = get_proc_address(handle, "OodleLZDecoder_DecodeSome");
   }
 
-  m_handle = (void*)handle;
+  m_handle = handle;
 }
 
 library::~library()
 {
   if (m_handle != nullptr)
   {
-    FreeLibrary((HMODULE)m_handle);
+    free_library(m_handle);
   }
 }
 
@@ -80,8 +144,8 @@ struct header
   }
 };
 
-
-bool decompress(std::span<const char> src, std::span<char> dst, bool check_crc)
+// objects with destructors aren't allowed next to the __try below
+bool decompress_on_current_thread(std::span<const char> src, std::span<char> dst, bool check_crc)
 {
   auto& lib = library::get();
 
@@ -107,6 +171,9 @@ bool decompress(std::span<const char> src, std::span<char> dst, bool check_crc)
   }
 
   const size_t decoder_mem_size = library::OODLELZ_BLOCK_LEN * 2;
+
+#if defined(_WIN32)
+
   char* decoder_mem = nullptr;
   bool decoder_mem_is_on_stack = true;
 
@@ -121,6 +188,14 @@ bool decompress(std::span<const char> src, std::span<char> dst, bool check_crc)
     decoder_mem = reinterpret_cast<char*>(malloc(decoder_mem_size));
   };
 
+#else
+
+  // no stack probing here, the default thread stacks are too small anyway
+  std::unique_ptr<char[]> decoder_mem_ptr(new char[decoder_mem_size]);
+  char* decoder_mem = decoder_mem_ptr.get();
+
+#endif
+
   //std::array<char, library::OODLELZ_BLOCK_LEN * 2> decoder_mem;
 
   size_t decompressed = lib.pfn_OodleLZ_Decompress(
@@ -130,6 +205,8 @@ bool decompress(std::span<const char> src, std::span<char> dst, bool check_crc)
     decoder_mem, decoder_mem_size,
     library::OodleLZ_Decode_Thread::Current);
 
+#if defined(_WIN32)
+
   if (decoder_mem_is_on_stack)
   {
     _freea(decoder_mem);
@@ -139,6 +216,8 @@ bool decompress(std::span<const char> src, std::span<char> dst, bool check_crc)
     free(decoder_mem);
   }
 
+#endif
+
   if (hdr.size != decompressed)
   {
     SPDLOG_ERROR("decompressed size doesn't match header info");
@@ -148,14 +227,303 @@ bool decompress(std::span<const char> src, std::span<char> dst, bool check_crc)
   return true;
 }
 
-size_t compress(std::span<const char> src, std::span<char> dst, compression_level level)
+bool decompress(std::span<const char> src, std::span<char> dst, bool check_crc)
+{
+  scoped_trace_span span("oodle.decode");
+  span.set_bytes(dst.size());
+  return decompress_on_current_thread(src, dst, check_crc);
+}
+
+bool decompress_batch(std::span<decompress_job> jobs, const batch_options& options)
+{
+  // biggest first so that the tail of the batch is made of small jobs
+  std::vector<size_t> order(jobs.size());
+  std::iota(order.begin(), order.end(), size_t(0));
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return jobs[a].dst.size() > jobs[b].dst.size();
+  });
+
+  std::atomic<size_t> failed_cnt = 0;
+
+  parallel_for(order.size(), options.workers_cnt, [&](size_t i)
+  {
+    auto& job = jobs[order[i]];
+
+    job.ok = decompress(job.src, job.dst, options.check_crc);
+
+    if (!job.ok)
+    {
+      ++failed_cnt;
+    }
+  });
+
+  return failed_cnt == 0;
+}
+
+bool stream_decoder::is_available()
+{
+  auto& lib = library::get();
+  return lib.pfn_OodleLZDecoder_Create && lib.pfn_OodleLZDecoder_DecodeSome && lib.pfn_OodleLZDecoder_MemorySizeNeeded;
+}
+
+bool stream_decoder::open(uint64_t comp_size, uint64_t raw_size, size_t window_size, source_fn source)
+{
+  reset();
+
+  if (!is_available())
+  {
+    SPDLOG_ERROR("OodleLZDecoder functions aren't available");
+    return false;
+  }
+
+  header hdr;
+  if (comp_size < sizeof(header) || !source(0, std::span<char>(reinterpret_cast<char*>(&hdr), sizeof(header))))
+  {
+    SPDLOG_ERROR("couldn't read the header");
+    return false;
+  }
+
+  if (!hdr.is_magic_ok())
+  {
+    SPDLOG_ERROR("wrong magic");
+    return false;
+  }
+
+  if (hdr.size != raw_size)
+  {
+    SPDLOG_ERROR("raw_size doesn't match uncompressed size");
+    return false;
+  }
+
+  auto& lib = library::get();
+
+  m_decoder_mem.resize(lib.pfn_OodleLZDecoder_MemorySizeNeeded(-1, (int64_t)raw_size));
+  m_decoder = lib.pfn_OodleLZDecoder_Create(-1, (int64_t)raw_size, m_decoder_mem.data(), (int64_t)m_decoder_mem.size());
+  if (!m_decoder)
+  {
+    SPDLOG_ERROR("OodleLZDecoder_Create failed");
+    reset();
+    return false;
+  }
+
+  // quanta don't straddle the end of the circular buffer if its size is a
+  // multiple of the block size, one block is being decoded past the window
+  constexpr size_t block_len = library::OODLELZ_BLOCK_LEN;
+  const uint64_t ring_size = (window_size + block_len - 1) / block_len * block_len + block_len;
+  m_ring.resize(static_cast<size_t>(std::min(ring_size, raw_size)));
+
+  m_source = std::move(source);
+  m_raw_size = raw_size;
+  m_comp_size = comp_size;
+  m_comp_offset = sizeof(header);
+
+  return true;
+}
+
+void stream_decoder::reset()
+{
+  auto& lib = library::get();
+  if (m_decoder && lib.pfn_OodleLZDecoder_Destroy)
+  {
+    lib.pfn_OodleLZDecoder_Destroy(m_decoder);
+  }
+
+  m_source = nullptr;
+  m_decoder = nullptr;
+  m_decoder_mem = {};
+  m_ring = {};
+  m_raw_size = 0;
+  m_decoded = 0;
+  m_consumed = 0;
+  m_comp = {};
+  m_comp_beg = 0;
+  m_comp_end = 0;
+  m_comp_size = 0;
+  m_comp_offset = 0;
+}
+
+bool stream_decoder::refill(size_t min_cnt)
+{
+  // keeps the buffered bytes at the front
+  if (m_comp_beg)
+  {
+    std::copy(m_comp.begin() + m_comp_beg, m_comp.begin() + m_comp_end, m_comp.begin());
+    m_comp_end -= m_comp_beg;
+    m_comp_beg = 0;
+  }
+
+  const uint64_t remaining = m_comp_size - m_comp_offset;
+  if (remaining == 0)
+  {
+    return false;
+  }
+
+  const size_t capacity = std::max(min_cnt, chunk_size);
+  if (m_comp.size() < capacity)
+  {
+    m_comp.resize(capacity);
+  }
+
+  const size_t cnt = static_cast<size_t>(std::min<uint64_t>(m_comp.size() - m_comp_end, remaining));
+  if (!m_source(m_comp_offset, std::span<char>(m_comp.data() + m_comp_end, cnt)))
+  {
+    SPDLOG_ERROR("couldn't read compressed bytes");
+    return false;
+  }
+
+  m_comp_end += cnt;
+  m_comp_offset += cnt;
+  return true;
+}
+
+bool stream_decoder::decode_more()
 {
   auto& lib = library::get();
 
-  SPDLOG_ERROR("not implemented yet");
+  const size_t ring_size = m_ring.size();
+  const size_t ring_pos = static_cast<size_t>(m_decoded % ring_size);
+  // decoded bytes that aren't consumed yet can't be overwritten
+  const size_t avail = std::min(ring_size - ring_pos, static_cast<size_t>(ring_size - (m_decoded - m_consumed)));
+
+  while (m_decoded < m_raw_size)
+  {
+    library::OodleLZ_DecodeSome_Out out = {};
+    const bool ok = lib.pfn_OodleLZDecoder_DecodeSome(
+      m_decoder, &out,
+      m_ring.data(), (int64_t)ring_pos, (int64_t)ring_size, (int64_t)avail,
+      m_comp.data() + m_comp_beg, (int64_t)(m_comp_end - m_comp_beg),
+      library::OodleLZ_FuzzSafe::Yes, false, 0,
+      library::OodleLZ_Decode_Thread::Current);
+
+    if (!ok)
+    {
+      SPDLOG_ERROR("OodleLZDecoder_DecodeSome failed");
+      return false;
+    }
+
+    m_comp_beg += out.comp_used;
+
+    if (out.decoded_cnt > 0)
+    {
+      m_decoded += out.decoded_cnt;
+      return true;
+    }
+
+    if (out.comp_used > 0)
+    {
+      continue;
+    }
+
+    // the current quantum isn't fully buffered
+    const size_t needed = std::max<size_t>(out.quantum_comp_size, m_comp_end - m_comp_beg + 1);
+    if (!refill(needed))
+    {
+      SPDLOG_ERROR("compressed stream ended before its raw size was decoded");
+      return false;
+    }
+  }
 
   return false;
 }
 
+bool stream_decoder::consume(char* dst, uint64_t cnt)
+{
+  if (!is_open() || m_consumed + cnt > m_raw_size)
+  {
+    return false;
+  }
+
+  const size_t ring_size = m_ring.size();
+
+  while (cnt)
+  {
+    if (m_consumed == m_decoded && !decode_more())
+    {
+      return false;
+    }
+
+    const size_t ring_pos = static_cast<size_t>(m_consumed % ring_size);
+    const size_t n = static_cast<size_t>(std::min<uint64_t>({cnt, m_decoded - m_consumed, ring_size - ring_pos}));
+
+    if (dst)
+    {
+      std::copy_n(m_ring.data() + ring_pos, n, dst);
+      dst += n;
+    }
+
+    m_consumed += n;
+    cnt -= n;
+  }
+
+  return true;
+}
+
+bool stream_decoder::read(std::span<char> dst)
+{
+  return consume(dst.data(), dst.size());
+}
+
+bool stream_decoder::skip(uint64_t cnt)
+{
+  return consume(nullptr, cnt);
+}
+
+size_t compressed_size_bound(size_t src_size)
+{
+  auto& lib = library::get();
+
+  if (lib.pfn_OodleLZ_GetCompressedBufferSizeNeeded == nullptr)
+  {
+    return 0;
+  }
+
+  return sizeof(header) + lib.pfn_OodleLZ_GetCompressedBufferSizeNeeded(src_size);
+}
+
+size_t compress(std::span<const char> src, std::span<char> dst, compression_level level)
+{
+  auto& lib = library::get();
+
+  if (lib.pfn_OodleLZ_Compress == nullptr)
+  {
+    SPDLOG_ERROR("OodleLZ_Compress isn't available; either the oodle library is not present or versions mistmatch.");
+    return 0;
+  }
+
+  if (src.size() > UINT32_MAX)
+  {
+    SPDLOG_ERROR("src is too big");
+    return 0;
+  }
+
+  const size_t hdr_size = sizeof(header);
+  const size_t required_size = compressed_size_bound(src.size());
+  if (dst.size() < required_size)
+  {
+    SPDLOG_ERROR("dst is too small, {} bytes are required", required_size);
+    return 0;
+  }
+
+  const size_t compressed = lib.pfn_OodleLZ_Compress(
+    library::OodleLZ_Compressor::Kraken,
+    src.data(), src.size(),
+    dst.data() + hdr_size,
+    level,
+    0, 0, 0,
+    nullptr, 0);
+
+  if (compressed == 0)
+  {
+    SPDLOG_ERROR("OodleLZ_Compress failed");
+    return 0;
+  }
+
+  header hdr;
+  hdr.size = static_cast<uint32_t>(src.size());
+  std::memcpy(dst.data(), &hdr, hdr_size);
+
+  return hdr_size + compressed;
+}
+
 } // namespace cp::oodle
 
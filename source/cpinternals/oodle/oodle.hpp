@@ -1,6 +1,8 @@
 #pragma once
 #include <cpinternals/common.hpp>
 #include <filesystem>
+#include <functional>
+#include <vector>
 
 namespace cp::oodle {
 
@@ -67,6 +69,14 @@ struct library
     Current = 3,
   };
 
+  struct OodleLZ_DecodeSome_Out
+  {
+    int32_t decoded_cnt;       // raw bytes decoded by the call
+    int32_t comp_used;         // compressed bytes consumed by the call
+    int32_t quantum_raw_size;  // of the current quantum
+    int32_t quantum_comp_size; // compressed bytes needed to decode the current quantum
+  };
+
   //bool try_load_from_dir(const std::filesystem::path& p);
 
   size_t (*
@@ -103,6 +113,45 @@ struct library
     size_t src_size
   ) = nullptr;
 
+  // compressor -1 and raw_size -1 gives the size needed for any stream
+  size_t (*
+  pfn_OodleLZDecoder_MemorySizeNeeded)(
+    int64_t compressor,
+    int64_t raw_size
+  ) = nullptr;
+
+  // compressor -1 detects it from the stream
+  void* (*
+  pfn_OodleLZDecoder_Create)(
+    int64_t compressor,
+    int64_t raw_size,
+    void* memory,
+    int64_t memory_size
+  ) = nullptr;
+
+  void (*
+  pfn_OodleLZDecoder_Destroy)(
+    void* decoder
+  ) = nullptr;
+
+  // decodes at most one quantum at dec_buf + dec_buf_pos, dec_buf is
+  // circular if dec_buf_size is smaller than the raw size
+  int32_t (*
+  pfn_OodleLZDecoder_DecodeSome)(
+    void* decoder,
+    OodleLZ_DecodeSome_Out* out,
+    void* dec_buf,
+    int64_t dec_buf_pos,
+    int64_t dec_buf_size,
+    int64_t dec_buf_avail,
+    const void* comp,
+    int64_t comp_avail,
+    OodleLZ_FuzzSafe fuzz_safe,
+    bool check_crc,
+    uint32_t log_level,
+    OodleLZ_Decode_Thread thread
+  ) = nullptr;
+
   // OodlePlugins_SetAllocators(NULL,NULL);
   // OodlePlugins_SetAssertion(NULL);
   // OodlePlugins_SetPrintf(NULL);
@@ -122,6 +171,117 @@ inline bool is_available()
 }
 
 bool decompress(std::span<const char> src, std::span<char> dst, bool check_crc);
+
+struct decompress_job
+{
+  std::span<const char> src;
+  std::span<char>       dst;
+  bool                  ok = false; // set by decompress_batch
+};
+
+struct batch_options
+{
+  // 0 means one per hardware thread
+  size_t workers_cnt = 0;
+  bool   check_crc = false;
+};
+
+// decompresses all jobs over worker threads (the calling thread being one of
+// them), biggest jobs first. returns true if all jobs succeeded.
+bool decompress_batch(std::span<decompress_job> jobs, const batch_options& options = {});
+
+// Incremental decoding of one compressed stream (header included) for
+// sequential consumers of streams too big to be decompressed at once.
+// Quanta (OODLELZ_BLOCK_LEN) are decoded on demand into a circular buffer
+// of window_size + OODLELZ_BLOCK_LEN bytes and compressed bytes are pulled
+// from the source by chunks, so memory doesn't depend on the raw size.
+// The stream must not reference data further back than window_size, which
+// is the dictionary size it was compressed with.
+struct stream_decoder
+{
+  // reads size(dst) compressed bytes at offset in the stream
+  using source_fn = std::function<bool(uint64_t offset, std::span<char> dst)>;
+
+  // compressed bytes pulled at once
+  static constexpr size_t chunk_size = library::OODLELZ_BLOCK_LEN * 4;
+
+  stream_decoder() = default;
+
+  ~stream_decoder()
+  {
+    reset();
+  }
+
+  stream_decoder(const stream_decoder&) = delete;
+  stream_decoder& operator=(const stream_decoder&) = delete;
+
+  // false if the library doesn't export the incremental decoding functions
+  static bool is_available();
+
+  bool open(uint64_t comp_size, uint64_t raw_size, size_t window_size, source_fn source);
+
+  void reset();
+
+  bool is_open() const
+  {
+    return m_decoder != nullptr;
+  }
+
+  // raw position of the next read
+  uint64_t tell() const
+  {
+    return m_consumed;
+  }
+
+  uint64_t raw_size() const
+  {
+    return m_raw_size;
+  }
+
+  // reads the next size(dst) raw bytes
+  bool read(std::span<char> dst);
+
+  // discards the next cnt raw bytes
+  bool skip(uint64_t cnt);
+
+  // bytes allocated by the decoder
+  size_t buffers_size() const
+  {
+    return m_ring.size() + m_comp.size() + m_decoder_mem.size();
+  }
+
+protected:
+  // decodes the next quantum
+  bool decode_more();
+
+  // pulls compressed bytes so that at least min_cnt are buffered
+  bool refill(size_t min_cnt);
+
+  // copies or skips the next cnt raw bytes
+  bool consume(char* dst, uint64_t cnt);
+
+  source_fn m_source;
+  void* m_decoder = nullptr;
+  std::vector<char> m_decoder_mem;
+
+  std::vector<char> m_ring;
+  uint64_t m_raw_size = 0;
+  uint64_t m_decoded = 0;  // raw bytes decoded
+  uint64_t m_consumed = 0; // raw bytes read or skipped
+
+  std::vector<char> m_comp;
+  size_t m_comp_beg = 0;   // [m_comp_beg, m_comp_end) are buffered compressed bytes
+  size_t m_comp_end = 0;
+  uint64_t m_comp_size = 0;
+  uint64_t m_comp_offset = 0; // offset of the next compressed byte to pull
+};
+
+// size dst must have for compress(src) to always succeed (header included),
+// 0 if the library isn't available
+size_t compressed_size_bound(size_t src_size);
+
+// compresses src with Kraken into dst, prefixed with the header expected by
+// decompress(). returns the written size, 0 on error.
 size_t compress(std::span<const char> src, std::span<char> dst, compression_level level = compression_level::normal);
 
 } // namespace cp::oodle
@@ -0,0 +1,70 @@
+#pragma once
+#include <inttypes.h>
+#include <filesystem>
+#include <memory>
+
+namespace cp::os {
+
+enum class watch_result
+{
+  changed,  // something below the directory changed (what isn't said)
+  timeout,
+  woken,    // wake() was called
+  error,
+};
+
+// change notifications for a directory tree (file and directory names, sizes
+// and write times). notifications are coalesced: wait() returns once for any
+// number of changes since the previous call, the caller rescans what it
+// cares about.
+struct dir_watcher_impl
+{
+  virtual ~dir_watcher_impl() = default;
+
+  virtual bool open(const std::filesystem::path& dir) = 0;
+  virtual bool is_open() const = 0;
+  virtual watch_result wait(uint32_t timeout_ms) = 0;
+  // makes a pending or the next wait() return woken, can be called from any thread
+  virtual void wake() = 0;
+  virtual bool close() = 0;
+};
+
+struct dir_watcher
+{
+  dir_watcher();
+  ~dir_watcher();
+
+  dir_watcher(dir_watcher&&) = default;
+  dir_watcher& operator=(dir_watcher&&) = default;
+
+  inline bool open(const std::filesystem::path& dir)
+  {
+    return m_impl->open(dir);
+  }
+
+  inline bool is_open() const
+  {
+    return m_impl->is_open();
+  }
+
+  inline watch_result wait(uint32_t timeout_ms)
+  {
+    return m_impl->wait(timeout_ms);
+  }
+
+  inline void wake()
+  {
+    m_impl->wake();
+  }
+
+  inline bool close()
+  {
+    return m_impl->close();
+  }
+
+private:
+
+  std::unique_ptr<dir_watcher_impl> m_impl;
+};
+
+} // namespace cp::os
@@ -0,0 +1,53 @@
+#pragma once
+#include <filesystem>
+#include <memory>
+#include <span>
+
+namespace cp::os {
+
+// read-only view of a whole file mapped in memory
+struct file_mapping_impl
+{
+  virtual ~file_mapping_impl() = default;
+
+  virtual bool open(const std::filesystem::path& p) = 0;
+  virtual bool is_open() const = 0;
+  virtual std::span<const char> view() const = 0;
+  virtual bool close() = 0;
+};
+
+struct file_mapping
+{
+  file_mapping();
+  ~file_mapping();
+
+  file_mapping(file_mapping&&) = default;
+  file_mapping& operator=(file_mapping&&) = default;
+
+  inline bool open(const std::filesystem::path& p)
+  {
+    return m_impl->open(p);
+  }
+
+  inline bool is_open() const
+  {
+    return m_impl->is_open();
+  }
+
+  inline std::span<const char> view() const
+  {
+    return m_impl->view();
+  }
+
+  inline bool close()
+  {
+    return m_impl->close();
+  }
+
+private:
+
+  std::unique_ptr<file_mapping_impl> m_impl;
+};
+
+} // namespace cp::os
+
@@ -1,19 +1,54 @@
 #pragma once
 #include <filesystem>
+#include <functional>
 #include <memory>
-
-#include <cpinternals/common.hpp>
+#include <span>
 
 namespace cp::os {
 
+struct read_request
+{
+  size_t offset;
+  std::span<char> dst;
+};
+
+// called once per request of a batch when its read is done, with the index
+// of the request in the batch and whether it succeeded.
+// called from the thread that submitted the batch, in completion order.
+// once a request failed, the ones that weren't started yet may be skipped
+// without a call.
+using read_completion_fn = std::function<void(size_t request_idx, bool ok)>;
+
 struct file_reader_impl
 {
   virtual ~file_reader_impl() = default;
 
   virtual bool open(const std::filesystem::path& p) = 0;
   virtual bool is_open() const = 0;
+  // 0 if the file isn't open
+  virtual size_t size() const = 0;
   virtual bool seek(size_t offset) = 0;
   virtual bool read(std::span<char> dst) = 0;
+  // positional read, doesn't use nor move the file pointer.
+  // can be called concurrently (with other read_at calls).
+  virtual bool read_at(size_t offset, std::span<char> dst) const = 0;
+  // positional reads that the implementation may have in flight together,
+  // same guarantees as read_at. returns once all of them completed, false
+  // if any of them failed. on_completion can be empty.
+  virtual bool read_batch(std::span<const read_request> requests, const read_completion_fn& on_completion) const
+  {
+    bool ok = true;
+    for (size_t i = 0; i < requests.size(); ++i)
+    {
+      const bool req_ok = read_at(requests[i].offset, requests[i].dst);
+      if (on_completion)
+      {
+        on_completion(i, req_ok);
+      }
+      ok = ok && req_ok;
+    }
+    return ok;
+  }
   virtual bool close() = 0;
 };
 
@@ -23,6 +58,7 @@ struct file_reader
   ~file_reader();
 
   file_reader(file_reader&&) = default;
+  file_reader& operator=(file_reader&&) = default;
 
   inline bool open(const std::filesystem::path& p)
   {
@@ -31,7 +67,12 @@ struct file_reader
 
   inline bool is_open() const
   {
-    return m_impl->is_open();
+    return m_impl && m_impl->is_open();
+  }
+
+  inline size_t size() const
+  {
+    return m_impl->size();
   }
 
   inline bool seek(size_t offset) 
@@ -44,6 +85,21 @@ struct file_reader
     return m_impl->read(dst);
   }
 
+  inline bool read_at(size_t offset, const std::span<char>& dst) const
+  {
+    return m_impl->read_at(offset, dst);
+  }
+
+  inline bool read_batch(std::span<const read_request> requests) const
+  {
+    return m_impl->read_batch(requests, {});
+  }
+
+  inline bool read_batch(std::span<const read_request> requests, const read_completion_fn& on_completion) const
+  {
+    return m_impl->read_batch(requests, on_completion);
+  }
+
   inline bool close()
   {
     return m_impl->close();
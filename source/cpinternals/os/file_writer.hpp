@@ -0,0 +1,55 @@
+#pragma once
+#include <filesystem>
+#include <memory>
+#include <span>
+
+namespace cp::os {
+
+// write-only file, created or truncated on open (kept as is if truncate is
+// false, e.g. to patch a copy in place).
+// there is no file pointer, writes are positional.
+struct file_writer_impl
+{
+  virtual ~file_writer_impl() = default;
+
+  virtual bool open(const std::filesystem::path& p, bool truncate) = 0;
+  virtual bool is_open() const = 0;
+  virtual bool write_at(size_t offset, std::span<const char> src) = 0;
+  virtual bool close() = 0;
+};
+
+struct file_writer
+{
+  file_writer();
+  ~file_writer();
+
+  file_writer(file_writer&&) = default;
+  file_writer& operator=(file_writer&&) = default;
+
+  inline bool open(const std::filesystem::path& p, bool truncate = true)
+  {
+    return m_impl->open(p, truncate);
+  }
+
+  inline bool is_open() const
+  {
+    return m_impl && m_impl->is_open();
+  }
+
+  inline bool write_at(size_t offset, std::span<const char> src)
+  {
+    return m_impl->write_at(offset, src);
+  }
+
+  inline bool close()
+  {
+    return m_impl->close();
+  }
+
+private:
+
+  std::unique_ptr<file_writer_impl> m_impl;
+};
+
+} // namespace cp::os
+
@@ -6,14 +6,30 @@
 
 namespace cp::os {
 
-// windows only atm
+// GetLastError codes on windows, errno values elsewhere
 using error_type = uint32_t;
 
+// on posix systems (wine prefixes, proton), the game isn't registered
+// anywhere: the CP2077_EXE environment variable gives its path
 std::optional<std::filesystem::path> get_cp_executable_path();
 
 std::string last_error_string();
 
 std::string format_error(error_type id);
 
+// return addresses of the calling thread's stack, skipping the skip_cnt
+// innermost frames (besides this function's). doesn't allocate on windows,
+// backtrace may on its first call.
+size_t capture_stack(void** frames, size_t max_frames, size_t skip_cnt = 0);
+
+// module!+offset of a code address (symbols can be resolved from that)
+std::string describe_code_address(void* addr);
+
+// lowers (or restores) the cpu and io priorities of the calling thread, for
+// background work that must not compete with the game (or a foreground app).
+// on posix systems the io class becomes idle and the thread is niced, which
+// unprivileged threads can't undo: restoring only resets the io class.
+bool set_thread_background_mode(bool enabled);
+
 } // namespace cp::os
 
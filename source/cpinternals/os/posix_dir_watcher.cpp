@@ -0,0 +1,213 @@
+#include <cpinternals/os/dir_watcher.hpp>
+#include <cpinternals/os/platform_utils.hpp>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+namespace cp::os {
+
+// inotify isn't recursive: every directory of the tree gets a watch, those
+// created later are added when their creation is read
+struct posix_dir_watcher
+  : dir_watcher_impl
+{
+  static constexpr uint32_t watch_mask =
+    IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_MODIFY | IN_DELETE_SELF;
+
+  ~posix_dir_watcher() override
+  {
+    close();
+  }
+
+  bool open(const std::filesystem::path& dir) override
+  {
+    if (is_open())
+    {
+      return false;
+    }
+
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0)
+    {
+      SPDLOG_ERROR("inotify_init1 failed: {}", os::last_error_string());
+      return false;
+    }
+
+    if (pipe2(m_wake_fds, O_NONBLOCK | O_CLOEXEC) != 0)
+    {
+      SPDLOG_ERROR("pipe2 failed: {}", os::last_error_string());
+      close();
+      return false;
+    }
+
+    if (!add_tree(dir))
+    {
+      close();
+      return false;
+    }
+
+    return true;
+  }
+
+  bool is_open() const override
+  {
+    return m_fd >= 0;
+  }
+
+  watch_result wait(uint32_t timeout_ms) override
+  {
+    if (!is_open())
+    {
+      return watch_result::error;
+    }
+
+    pollfd fds[2] = {{m_wake_fds[0], POLLIN, 0}, {m_fd, POLLIN, 0}};
+    const int res = poll(fds, 2, static_cast<int>(timeout_ms));
+    if (res < 0)
+    {
+      if (errno == EINTR)
+      {
+        return watch_result::timeout;
+      }
+      SPDLOG_ERROR("poll failed: {}", os::last_error_string());
+      return watch_result::error;
+    }
+
+    if (fds[0].revents & POLLIN)
+    {
+      char buf[64];
+      while (::read(m_wake_fds[0], buf, sizeof(buf)) > 0) {}
+      return watch_result::woken;
+    }
+
+    if (fds[1].revents & POLLIN)
+    {
+      drain();
+      return watch_result::changed;
+    }
+
+    return watch_result::timeout;
+  }
+
+  void wake() override
+  {
+    if (m_wake_fds[1] >= 0)
+    {
+      const char c = 0;
+      [[maybe_unused]] auto res = ::write(m_wake_fds[1], &c, 1);
+    }
+  }
+
+  bool close() override
+  {
+    for (int& fd : m_wake_fds)
+    {
+      if (fd >= 0)
+      {
+        ::close(fd);
+        fd = -1;
+      }
+    }
+
+    if (m_fd >= 0)
+    {
+      // closing the descriptor removes its watches
+      ::close(m_fd);
+      m_fd = -1;
+      m_wd_paths.clear();
+    }
+
+    return true;
+  }
+
+protected:
+  bool add_watch(const std::filesystem::path& dir)
+  {
+    const int wd = inotify_add_watch(m_fd, dir.c_str(), watch_mask);
+    if (wd < 0)
+    {
+      SPDLOG_ERROR("inotify_add_watch failed: {}", os::last_error_string());
+      return false;
+    }
+
+    m_wd_paths[wd] = dir;
+    return true;
+  }
+
+  bool add_tree(const std::filesystem::path& dir)
+  {
+    if (!add_watch(dir))
+    {
+      return false;
+    }
+
+    std::error_code ec;
+    for (auto it = std::filesystem::recursive_directory_iterator(dir, ec); it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+    {
+      if (ec)
+        break;
+      if (it->is_directory(ec))
+        add_watch(it->path());
+    }
+
+    return true;
+  }
+
+  // reads the pending events, watching the new directories
+  void drain()
+  {
+    alignas(inotify_event) char buf[4096];
+    std::vector<std::pair<int, std::string>> new_dirs;
+    for (;;)
+    {
+      const ssize_t len = ::read(m_fd, buf, sizeof(buf));
+      if (len <= 0)
+        break;
+
+      for (ssize_t pos = 0; pos < len; )
+      {
+        const auto* ev = reinterpret_cast<const inotify_event*>(buf + pos);
+        pos += sizeof(inotify_event) + ev->len;
+
+        if (ev->mask & IN_IGNORED)
+          m_wd_paths.erase(ev->wd);
+        else if ((ev->mask & IN_ISDIR) && (ev->mask & (IN_CREATE | IN_MOVED_TO)) && ev->len)
+          new_dirs.emplace_back(ev->wd, ev->name);
+      }
+    }
+
+    // the path of a watch descriptor isn't given back by inotify
+    for (const auto& [wd, name] : new_dirs)
+    {
+      auto it = m_wd_paths.find(wd);
+      if (it != m_wd_paths.end())
+        add_tree(it->second / name);
+    }
+  }
+
+  int m_fd = -1;
+  int m_wake_fds[2] = {-1, -1};
+  std::unordered_map<int, std::filesystem::path> m_wd_paths;
+};
+
+dir_watcher::dir_watcher()
+{
+  m_impl = std::make_unique<posix_dir_watcher>();
+}
+
+dir_watcher::~dir_watcher()
+{
+}
+
+} // namespace cp::os
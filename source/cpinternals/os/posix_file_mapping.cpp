@@ -0,0 +1,121 @@
+#include <cpinternals/os/file_mapping.hpp>
+#include <cpinternals/os/platform_utils.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <memory>
+
+#include <spdlog/spdlog.h>
+
+namespace cp::os {
+
+// the descriptor is closed once mapped, the mapping keeps the file alive
+struct posix_file_mapping
+  : file_mapping_impl
+{
+  ~posix_file_mapping() override
+  {
+    close();
+  }
+
+  bool open(const std::filesystem::path& p) override
+  {
+    if (is_open())
+    {
+      return false;
+    }
+
+    const int fd = ::open(p.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+      SPDLOG_ERROR("open failed: {}", os::last_error_string());
+      return false;
+    }
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0)
+    {
+      SPDLOG_ERROR("fstat failed: {}", os::last_error_string());
+      ::close(fd);
+      return false;
+    }
+
+    m_size = static_cast<size_t>(st.st_size);
+    m_is_open = true;
+
+    // empty files can't be mapped, view() is then an empty span
+    if (m_size == 0)
+    {
+      ::close(fd);
+      return true;
+    }
+
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (data == MAP_FAILED)
+    {
+      SPDLOG_ERROR("mmap failed: {}", os::last_error_string());
+      close();
+      return false;
+    }
+
+    m_data = static_cast<const char*>(data);
+    return true;
+  }
+
+  bool is_open() const override
+  {
+    return m_is_open;
+  }
+
+  std::span<const char> view() const override
+  {
+    if (!m_data)
+    {
+      return {};
+    }
+    return { m_data, m_size };
+  }
+
+  bool close() override
+  {
+    if (!is_open())
+    {
+      return false;
+    }
+
+    if (m_data)
+    {
+      munmap(const_cast<char*>(m_data), m_size);
+      m_data = nullptr;
+    }
+
+    m_is_open = false;
+    m_size = 0;
+    return true;
+  }
+
+private:
+
+  bool m_is_open = false;
+  const char* m_data = nullptr;
+  size_t m_size = 0;
+};
+
+
+file_mapping::file_mapping()
+{
+  m_impl = std::make_unique<posix_file_mapping>();
+}
+
+file_mapping::~file_mapping()
+{
+}
+
+} // namespace cp::os
+
@@ -0,0 +1,386 @@
+#include <cpinternals/os/file_reader.hpp>
+#include <cpinternals/os/platform_utils.hpp>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(CP_HAS_LIBURING)
+#include <liburing.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <memory>
+
+#include <spdlog/spdlog.h>
+
+namespace cp::os {
+
+// pread doesn't use the file descriptor's offset, concurrent read_at calls
+// are fine. seek/read emulate the file pointer with m_offset.
+// with liburing (CP_HAS_LIBURING), read_batch keeps its reads in flight in
+// a per thread io_uring, otherwise the kernel is told about all of them with
+// posix_fadvise before they are read one by one.
+struct posix_file_reader
+  : file_reader_impl
+{
+  ~posix_file_reader() override
+  {
+    close();
+  }
+
+  bool open(const std::filesystem::path& p) override
+  {
+    if (is_open())
+    {
+      return false;
+    }
+
+    m_fd = ::open(p.c_str(), O_RDONLY | O_CLOEXEC);
+    if (m_fd < 0)
+    {
+      return false;
+    }
+
+    m_offset = 0;
+    return true;
+  }
+
+  bool is_open() const override
+  {
+    return m_fd >= 0;
+  }
+
+  size_t size() const override
+  {
+    struct stat st{};
+    if (!is_open() || fstat(m_fd, &st) != 0)
+    {
+      return 0;
+    }
+
+    return static_cast<size_t>(st.st_size);
+  }
+
+  bool seek(size_t offset) override
+  {
+    if (!is_open())
+    {
+      return false;
+    }
+
+    m_offset = offset;
+    return true;
+  }
+
+  bool read(std::span<char> dst) override
+  {
+    if (!read_at(m_offset, dst))
+    {
+      return false;
+    }
+
+    m_offset += dst.size();
+    return true;
+  }
+
+  bool read_at(size_t offset, std::span<char> dst) const override
+  {
+    if (!is_open())
+    {
+      SPDLOG_ERROR("!is_open()");
+      return false;
+    }
+
+    while (dst.size())
+    {
+      const ssize_t read_cnt = pread(m_fd, dst.data(), dst.size(), static_cast<off_t>(offset));
+      if (read_cnt < 0)
+      {
+        if (errno == EINTR)
+        {
+          continue;
+        }
+
+        SPDLOG_ERROR("pread failed: {}", os::last_error_string());
+        return false;
+      }
+
+      if (read_cnt == 0)
+      {
+        SPDLOG_ERROR("pread EOF");
+        return false;
+      }
+
+      dst = dst.subspan(static_cast<size_t>(read_cnt));
+      offset += static_cast<size_t>(read_cnt);
+    }
+
+    return true;
+  }
+
+  bool read_batch(std::span<const read_request> requests, const read_completion_fn& on_completion) const override
+  {
+    if (!is_open())
+    {
+      SPDLOG_ERROR("!is_open()");
+      return false;
+    }
+
+#if defined(CP_HAS_LIBURING)
+
+    if (auto* ring = thread_ring())
+    {
+      return read_batch_uring(*ring, requests, on_completion);
+    }
+
+#endif
+
+    // the reads are queued by the kernel while the first ones complete
+    for (const auto& req : requests)
+    {
+      posix_fadvise(m_fd, static_cast<off_t>(req.offset), static_cast<off_t>(req.dst.size()), POSIX_FADV_WILLNEED);
+    }
+
+    return file_reader_impl::read_batch(requests, on_completion);
+  }
+
+  bool close() override
+  {
+    if (is_open())
+    {
+      ::close(m_fd);
+      m_fd = -1;
+      return true;
+    }
+
+    return false;
+  }
+
+private:
+
+#if defined(CP_HAS_LIBURING)
+
+  static constexpr unsigned ring_depth = 64;
+  // reads are capped to this size (a sqe has a 32-bit length), the rest of
+  // a larger request is completed with read_at like a short read
+  static constexpr size_t max_read_size = size_t(1) << 30;
+
+  // user data of the sqes that aren't reads
+  static constexpr uint64_t cancel_tag = UINT64_MAX;
+  static constexpr uint64_t nop_tag = UINT64_MAX - 1;
+
+  struct ring_holder
+  {
+    io_uring ring{};
+    bool ok = io_uring_queue_init(ring_depth, &ring, 0) == 0;
+    // set when sqes couldn't be submitted nor withdrawn, the ring isn't
+    // used anymore so that they are never submitted
+    bool retired = false;
+    ~ring_holder() { if (ok) io_uring_queue_exit(&ring); }
+  };
+
+  static ring_holder& thread_ring_holder()
+  {
+    static thread_local ring_holder tls_ring;
+    return tls_ring;
+  }
+
+  // one ring per thread, nullptr if io_uring isn't supported by the kernel
+  static io_uring* thread_ring()
+  {
+    auto& holder = thread_ring_holder();
+    return holder.ok && !holder.retired ? &holder.ring : nullptr;
+  }
+
+  // submits the queued sqes, interrupted and short submits are retried.
+  // on failure queued_cnt is the count of sqes left in the ring (the last
+  // ones queued)
+  static bool submit_queued(io_uring& ring, size_t& queued_cnt, size_t& submitted_cnt)
+  {
+    while (queued_cnt)
+    {
+      const int res = io_uring_submit(&ring);
+      if (res == -EINTR)
+      {
+        continue;
+      }
+
+      if (res <= 0)
+      {
+        SPDLOG_ERROR("io_uring_submit failed: {}", res ? os::format_error(static_cast<error_type>(-res)) : "no sqe submitted");
+        return false;
+      }
+
+      const size_t cnt = std::min(queued_cnt, static_cast<size_t>(res));
+      queued_cnt -= cnt;
+      submitted_cnt += cnt;
+    }
+
+    return true;
+  }
+
+  // retries interrupted waits, nullptr on failure
+  static io_uring_cqe* wait_cqe(io_uring& ring)
+  {
+    io_uring_cqe* cqe = nullptr;
+    int res = 0;
+    do
+    {
+      res = io_uring_wait_cqe(&ring, &cqe);
+    }
+    while (res == -EINTR);
+
+    if (res < 0)
+    {
+      SPDLOG_ERROR("io_uring_wait_cqe failed: {}", os::format_error(static_cast<error_type>(-res)));
+      return nullptr;
+    }
+
+    return cqe;
+  }
+
+  // the kernel can still write to the buffers of the reads in flight, they
+  // are cancelled and reaped before read_batch returns (like CancelIoEx and
+  // the drain of win_file_reader). the sqes that weren't submitted are made
+  // no-ops and reaped too, the ring is retired if that fails.
+  static void abort_batch(io_uring& ring, std::span<io_uring_sqe* const> unsubmitted, size_t in_flight)
+  {
+    for (io_uring_sqe* sqe : unsubmitted)
+    {
+      io_uring_prep_nop(sqe);
+      io_uring_sqe_set_data64(sqe, nop_tag);
+    }
+
+    size_t queued_cnt = unsubmitted.size();
+    if (in_flight)
+    {
+      if (io_uring_sqe* sqe = io_uring_get_sqe(&ring))
+      {
+        io_uring_prep_cancel64(sqe, 0, IORING_ASYNC_CANCEL_ANY);
+        io_uring_sqe_set_data64(sqe, cancel_tag);
+        ++queued_cnt;
+      }
+    }
+
+    // the cancel is queued last, if it isn't submitted the reads are
+    // waited for as they are
+    size_t reaped_cnt = in_flight;
+    if (!submit_queued(ring, queued_cnt, reaped_cnt))
+    {
+      thread_ring_holder().retired = true;
+    }
+
+    while (reaped_cnt)
+    {
+      io_uring_cqe* cqe = wait_cqe(ring);
+      if (!cqe)
+      {
+        // nothing else can be done, the ring isn't reused at least
+        thread_ring_holder().retired = true;
+        return;
+      }
+
+      io_uring_cqe_seen(&ring, cqe);
+      --reaped_cnt;
+    }
+  }
+
+  // keeps up to ring_depth requests in flight, a slot is refilled as soon
+  // as its read completes. short reads are completed with read_at.
+  bool read_batch_uring(io_uring& ring, std::span<const read_request> requests, const read_completion_fn& on_completion) const
+  {
+    size_t next_idx = 0;
+    size_t in_flight = 0;
+    bool ok = true;
+
+    // sqes of the last submit, to withdraw the ones it left in the ring
+    std::array<io_uring_sqe*, ring_depth> queued_sqes = {};
+
+    while (next_idx < requests.size() || in_flight)
+    {
+      size_t queued_cnt = 0;
+      while (ok && next_idx < requests.size() && in_flight + queued_cnt < ring_depth)
+      {
+        const auto& req = requests[next_idx];
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+        if (!sqe)
+        {
+          break;
+        }
+
+        const size_t size = std::min(req.dst.size(), max_read_size);
+        io_uring_prep_read(sqe, m_fd, req.dst.data(), static_cast<unsigned>(size), req.offset);
+        io_uring_sqe_set_data64(sqe, next_idx);
+        queued_sqes[queued_cnt++] = sqe;
+        ++next_idx;
+      }
+
+      const size_t round_cnt = queued_cnt;
+      if (!submit_queued(ring, queued_cnt, in_flight))
+      {
+        abort_batch(ring, std::span(queued_sqes).subspan(round_cnt - queued_cnt, queued_cnt), in_flight);
+        return false;
+      }
+
+      if (!in_flight)
+      {
+        // a failed read stopped the queueing (or no sqe was available)
+        return ok && next_idx == requests.size();
+      }
+
+      io_uring_cqe* cqe = wait_cqe(ring);
+      if (!cqe)
+      {
+        abort_batch(ring, {}, in_flight);
+        return false;
+      }
+
+      const size_t req_idx = static_cast<size_t>(io_uring_cqe_get_data64(cqe));
+      const auto& req = requests[req_idx];
+      const int read_cnt = cqe->res;
+      io_uring_cqe_seen(&ring, cqe);
+      --in_flight;
+
+      bool req_ok = true;
+      if (read_cnt < 0)
+      {
+        SPDLOG_ERROR("io_uring read failed: {}", os::format_error(static_cast<error_type>(-read_cnt)));
+        req_ok = false;
+      }
+      else if (static_cast<size_t>(read_cnt) < req.dst.size())
+      {
+        req_ok = read_at(req.offset + read_cnt, req.dst.subspan(read_cnt));
+      }
+
+      if (on_completion)
+      {
+        on_completion(req_idx, req_ok);
+      }
+      ok = ok && req_ok;
+    }
+
+    return ok;
+  }
+
+#endif
+
+  int m_fd = -1;
+  size_t m_offset = 0;
+};
+
+
+file_reader::file_reader()
+{
+  m_impl = std::make_unique<posix_file_reader>();
+}
+
+file_reader::~file_reader()
+{
+}
+
+} // namespace cp::os
+
@@ -0,0 +1,103 @@
+#include <cpinternals/os/file_writer.hpp>
+#include <cpinternals/os/platform_utils.hpp>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <memory>
+
+#include <spdlog/spdlog.h>
+
+namespace cp::os {
+
+// pwrite is given the offset, the descriptor's offset isn't used
+struct posix_file_writer
+  : file_writer_impl
+{
+  ~posix_file_writer() override
+  {
+    close();
+  }
+
+  bool open(const std::filesystem::path& p, bool truncate) override
+  {
+    if (is_open())
+    {
+      return false;
+    }
+
+    m_fd = ::open(p.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (truncate ? O_TRUNC : 0), 0644);
+    if (m_fd < 0)
+    {
+      SPDLOG_ERROR("open failed: {}", os::last_error_string());
+      return false;
+    }
+
+    return true;
+  }
+
+  bool is_open() const override
+  {
+    return m_fd >= 0;
+  }
+
+  bool write_at(size_t offset, std::span<const char> src) override
+  {
+    if (!is_open())
+    {
+      SPDLOG_ERROR("!is_open()");
+      return false;
+    }
+
+    while (src.size())
+    {
+      const ssize_t written_cnt = pwrite(m_fd, src.data(), src.size(), static_cast<off_t>(offset));
+      if (written_cnt < 0)
+      {
+        if (errno == EINTR)
+        {
+          continue;
+        }
+
+        SPDLOG_ERROR("pwrite failed: {}", os::last_error_string());
+        return false;
+      }
+
+      src = src.subspan(static_cast<size_t>(written_cnt));
+      offset += static_cast<size_t>(written_cnt);
+    }
+
+    return true;
+  }
+
+  bool close() override
+  {
+    if (is_open())
+    {
+      ::close(m_fd);
+      m_fd = -1;
+      return true;
+    }
+
+    return false;
+  }
+
+private:
+
+  int m_fd = -1;
+};
+
+
+file_writer::file_writer()
+{
+  m_impl = std::make_unique<posix_file_writer>();
+}
+
+file_writer::~file_writer()
+{
+}
+
+} // namespace cp::os
+
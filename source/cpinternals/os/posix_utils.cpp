@@ -0,0 +1,100 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <optional>
+#include <filesystem>
+
+#include <cpinternals/os/platform_utils.hpp>
+#include <spdlog/spdlog.h>
+
+namespace cp::os {
+
+std::optional<std::filesystem::path> get_cp_executable_path()
+{
+  static std::optional<std::filesystem::path> s_path = []() -> std::optional<std::filesystem::path> {
+    const char* env = std::getenv("CP2077_EXE");
+    if (env && std::filesystem::exists(env))
+    {
+      return std::filesystem::path(env);
+    }
+    return std::nullopt;
+  }();
+
+  return s_path;
+}
+
+std::string last_error_string()
+{
+  return format_error(static_cast<error_type>(errno));
+}
+
+std::string format_error(error_type id)
+{
+  if (id != 0)
+  {
+    return fmt::format("{} ({})", std::strerror(static_cast<int>(id)), id);
+  }
+
+  return "";
+}
+
+size_t capture_stack(void** frames, size_t max_frames, size_t skip_cnt)
+{
+  void* buf[64];
+  const int cnt = backtrace(buf, static_cast<int>(std::min<size_t>(max_frames + skip_cnt + 1, 64)));
+  const size_t first = std::min<size_t>(skip_cnt + 1, static_cast<size_t>(cnt));
+
+  std::memcpy(frames, buf + first, (cnt - first) * sizeof(void*));
+  return cnt - first;
+}
+
+std::string describe_code_address(void* addr)
+{
+  Dl_info info{};
+  if (!dladdr(addr, &info) || !info.dli_fname)
+  {
+    return fmt::format("{}", addr);
+  }
+
+  return fmt::format("{}!+{:#x}", std::filesystem::path(info.dli_fname).filename().string(),
+    reinterpret_cast<uintptr_t>(addr) - reinterpret_cast<uintptr_t>(info.dli_fbase));
+}
+
+bool set_thread_background_mode(bool enabled)
+{
+#if defined(__linux__)
+  // no glibc wrappers: ioprio_set(IOPRIO_WHO_PROCESS, 0 = calling thread, ...)
+  constexpr int ioprio_who_process = 1;
+  constexpr int ioprio_class_shift = 13;
+  constexpr int ioprio_class_idle = 3;
+
+  const int ioprio = enabled ? (ioprio_class_idle << ioprio_class_shift) : 0;
+  if (syscall(SYS_ioprio_set, ioprio_who_process, 0, ioprio) != 0)
+  {
+    SPDLOG_ERROR("ioprio_set failed: {}", last_error_string());
+    return false;
+  }
+
+  // linux applies a tid's nice value to that thread only
+  if (enabled && setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19) != 0)
+  {
+    SPDLOG_ERROR("setpriority failed: {}", last_error_string());
+    return false;
+  }
+
+  return true;
+#else
+  // nice values are per process there
+  return !enabled;
+#endif
+}
+
+} // namespace cp::os
+
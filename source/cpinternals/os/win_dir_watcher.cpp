@@ -0,0 +1,127 @@
+#include <cpinternals/os/dir_watcher.hpp>
+#include <cpinternals/os/platform_utils.hpp>
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+
+#include <filesystem>
+#include <memory>
+
+#include <cpinternals/common.hpp>
+
+namespace cp::os {
+
+// change notification handle: no buffer of changes to drain, it's rearmed
+// with FindNextChangeNotification after each signal
+struct win_dir_watcher
+  : dir_watcher_impl
+{
+  ~win_dir_watcher() override
+  {
+    close();
+  }
+
+  bool open(const std::filesystem::path& dir) override
+  {
+    if (is_open())
+    {
+      return false;
+    }
+
+    m_hchange = FindFirstChangeNotificationW(
+      dir.c_str(), TRUE,
+      FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
+      FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
+
+    if (m_hchange == INVALID_HANDLE_VALUE)
+    {
+      SPDLOG_ERROR("FindFirstChangeNotificationW failed: {}", os::last_error_string());
+      return false;
+    }
+
+    m_hwake = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    if (!m_hwake)
+    {
+      SPDLOG_ERROR("CreateEventW failed: {}", os::last_error_string());
+      close();
+      return false;
+    }
+
+    return true;
+  }
+
+  bool is_open() const override
+  {
+    return m_hchange != INVALID_HANDLE_VALUE;
+  }
+
+  watch_result wait(uint32_t timeout_ms) override
+  {
+    if (!is_open())
+    {
+      return watch_result::error;
+    }
+
+    const HANDLE handles[2] = {m_hwake, m_hchange};
+    const DWORD res = WaitForMultipleObjects(2, handles, FALSE, timeout_ms);
+
+    switch (res)
+    {
+      case WAIT_OBJECT_0:
+        return watch_result::woken;
+      case WAIT_OBJECT_0 + 1:
+        if (!FindNextChangeNotification(m_hchange))
+        {
+          SPDLOG_ERROR("FindNextChangeNotification failed: {}", os::last_error_string());
+          return watch_result::error;
+        }
+        return watch_result::changed;
+      case WAIT_TIMEOUT:
+        return watch_result::timeout;
+      default:
+        SPDLOG_ERROR("WaitForMultipleObjects failed: {}", os::last_error_string());
+        return watch_result::error;
+    }
+  }
+
+  void wake() override
+  {
+    if (m_hwake)
+    {
+      SetEvent(m_hwake);
+    }
+  }
+
+  bool close() override
+  {
+    if (m_hwake)
+    {
+      CloseHandle(m_hwake);
+      m_hwake = nullptr;
+    }
+
+    if (m_hchange != INVALID_HANDLE_VALUE)
+    {
+      FindCloseChangeNotification(m_hchange);
+      m_hchange = INVALID_HANDLE_VALUE;
+    }
+
+    return true;
+  }
+
+protected:
+  HANDLE m_hchange = INVALID_HANDLE_VALUE;
+  HANDLE m_hwake = nullptr;
+};
+
+dir_watcher::dir_watcher()
+{
+  m_impl = std::make_unique<win_dir_watcher>();
+}
+
+dir_watcher::~dir_watcher()
+{
+}
+
+} // namespace cp::os
@@ -0,0 +1,133 @@
+#include <cpinternals/os/file_mapping.hpp>
+#include <cpinternals/os/platform_utils.hpp>
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+
+#include <filesystem>
+#include <memory>
+
+#include <cpinternals/common.hpp>
+
+namespace cp::os {
+
+struct win_file_mapping
+  : file_mapping_impl
+{
+  ~win_file_mapping() override
+  {
+    close();
+  }
+
+  bool open(const std::filesystem::path& p) override
+  {
+    if (is_open())
+    {
+      return false;
+    }
+
+    m_hfile = CreateFileW(
+      p.c_str(), FILE_GENERIC_READ, FILE_SHARE_READ, nullptr,
+      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+    if (m_hfile == INVALID_HANDLE_VALUE)
+    {
+      SPDLOG_ERROR("CreateFileW failed: {}", os::last_error_string());
+      return false;
+    }
+
+    LARGE_INTEGER lisize{};
+    if (!GetFileSizeEx(m_hfile, &lisize))
+    {
+      SPDLOG_ERROR("GetFileSizeEx failed: {}", os::last_error_string());
+      close();
+      return false;
+    }
+
+    m_size = static_cast<size_t>(lisize.QuadPart);
+
+    // empty files can't be mapped, view() is then an empty span
+    if (m_size == 0)
+    {
+      return true;
+    }
+
+    m_hmap = CreateFileMappingW(m_hfile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_hmap)
+    {
+      SPDLOG_ERROR("CreateFileMappingW failed: {}", os::last_error_string());
+      close();
+      return false;
+    }
+
+    m_data = static_cast<const char*>(MapViewOfFile(m_hmap, FILE_MAP_READ, 0, 0, 0));
+    if (!m_data)
+    {
+      SPDLOG_ERROR("MapViewOfFile failed: {}", os::last_error_string());
+      close();
+      return false;
+    }
+
+    return true;
+  }
+
+  bool is_open() const override
+  {
+    return m_hfile != INVALID_HANDLE_VALUE;
+  }
+
+  std::span<const char> view() const override
+  {
+    if (!m_data)
+    {
+      return {};
+    }
+    return { m_data, m_size };
+  }
+
+  bool close() override
+  {
+    if (!is_open())
+    {
+      return false;
+    }
+
+    if (m_data)
+    {
+      UnmapViewOfFile(m_data);
+      m_data = nullptr;
+    }
+
+    if (m_hmap)
+    {
+      CloseHandle(m_hmap);
+      m_hmap = nullptr;
+    }
+
+    CloseHandle(m_hfile);
+    m_hfile = INVALID_HANDLE_VALUE;
+    m_size = 0;
+    return true;
+  }
+
+private:
+
+  HANDLE m_hfile = INVALID_HANDLE_VALUE;
+  HANDLE m_hmap = nullptr;
+  const char* m_data = nullptr;
+  size_t m_size = 0;
+};
+
+
+file_mapping::file_mapping()
+{
+  m_impl = std::make_unique<win_file_mapping>();
+}
+
+file_mapping::~file_mapping()
+{
+}
+
+} // namespace cp::os
+
@@ -3,6 +3,7 @@
 
 #include <fileapi.h>
 
+#include <array>
 #include <filesystem>
 #include <memory>
 
@@ -10,6 +11,13 @@
 
 namespace cp::os {
 
+// the handle is opened for overlapped i/o: synchronous handles serialize
+// all i/o on the file object, even ReadFile calls given an offset.
+// seek/read emulate the file pointer with m_offset.
+// read_batch keeps up to batch_depth overlapped reads in flight, each with
+// its own event. a completion port would be bound to the handle for good
+// and shared by all the threads reading the archive, events keep batches
+// of different threads apart for the same queue depth.
 struct win_file_reader
   : file_reader_impl
 {
@@ -27,8 +35,9 @@ struct win_file_reader
 
     m_h = CreateFileW(
       p.c_str(), FILE_GENERIC_READ, FILE_SHARE_READ, nullptr,
-      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, nullptr);
 
+    m_offset = 0;
     return is_open();
   }
 
@@ -37,6 +46,17 @@ struct win_file_reader
     return m_h != INVALID_HANDLE_VALUE;
   }
 
+  size_t size() const override
+  {
+    LARGE_INTEGER li{};
+    if (!is_open() || !GetFileSizeEx(m_h, &li))
+    {
+      return 0;
+    }
+
+    return static_cast<size_t>(li.QuadPart);
+  }
+
   bool seek(size_t offset) override
   {
     if (!is_open())
@@ -44,19 +64,22 @@ struct win_file_reader
       return false;
     }
 
-    LARGE_INTEGER lioff{}, out_lioff{};
-    lioff.QuadPart = offset;
-    bool ok = SetFilePointerEx(m_h, lioff, &out_lioff, FILE_BEGIN);
+    m_offset = offset;
+    return true;
+  }
 
-    if (!ok)
+  bool read(std::span<char> dst) override
+  {
+    if (!read_at(m_offset, dst))
     {
-      SPDLOG_ERROR("SetFilePointerEx failed: {}", os::last_error_string());
+      return false;
     }
 
-    return ok && (lioff.QuadPart == out_lioff.QuadPart);
+    m_offset += dst.size();
+    return true;
   }
 
-  bool read(std::span<char> dst) override
+  bool read_at(size_t offset, std::span<char> dst) const override
   {
     if (!is_open())
     {
@@ -66,16 +89,44 @@ struct win_file_reader
 
     constexpr size_t max_size = std::numeric_limits<DWORD>::max();
 
-    DWORD read_cnt = 0;
+    // one event per thread, reset by ReadFile
+    static thread_local struct event_holder
+    {
+      HANDLE h = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+      ~event_holder() { if (h) CloseHandle(h); }
+    } tls_event;
+
+    if (!tls_event.h)
+    {
+      SPDLOG_ERROR("CreateEventW failed: {}", os::last_error_string());
+      return false;
+    }
 
     while (dst.size())
     {
       DWORD read_size = static_cast<DWORD>(std::min(dst.size(), max_size));
+      DWORD read_cnt = 0;
+
+      OVERLAPPED ov{};
+      ov.Offset = static_cast<DWORD>(offset);
+      ov.OffsetHigh = static_cast<DWORD>(static_cast<uint64_t>(offset) >> 32);
+      ov.hEvent = tls_event.h;
 
       size_t retries = 10;
-      while (!ReadFile(m_h, dst.data(), read_size, &read_cnt, 0) && --retries)
+      while (!ReadFile(m_h, dst.data(), read_size, nullptr, &ov) && --retries)
       {
         DWORD dwErr = GetLastError();
+        if (dwErr == ERROR_IO_PENDING)
+        {
+          break;
+        }
+
+        if (dwErr == ERROR_HANDLE_EOF)
+        {
+          SPDLOG_ERROR("ReadFile EOF");
+          return false;
+        }
+
         if (dwErr != ERROR_NOT_ENOUGH_MEMORY)
         {
           SPDLOG_ERROR("ReadFile failed: {}", os::format_error(dwErr));
@@ -91,6 +142,20 @@ struct win_file_reader
         return false;
       }
 
+      if (!GetOverlappedResult(m_h, &ov, &read_cnt, TRUE))
+      {
+        DWORD dwErr = GetLastError();
+        if (dwErr == ERROR_HANDLE_EOF)
+        {
+          SPDLOG_ERROR("ReadFile EOF");
+        }
+        else
+        {
+          SPDLOG_ERROR("GetOverlappedResult failed: {}", os::format_error(dwErr));
+        }
+        return false;
+      }
+
       if (read_cnt != read_size)
       {
         SPDLOG_ERROR("ReadFile EOF");
@@ -98,11 +163,186 @@ struct win_file_reader
       }
 
       dst = dst.subspan(read_size);
+      offset += read_size;
     }
 
     return true;
   }
 
+  bool read_batch(std::span<const read_request> requests, const read_completion_fn& on_completion) const override
+  {
+    if (!is_open())
+    {
+      SPDLOG_ERROR("!is_open()");
+      return false;
+    }
+
+    struct slot
+    {
+      OVERLAPPED ov;
+      size_t req_idx;
+    };
+
+    // one set of events per thread, reset by ReadFile
+    static thread_local struct events_holder
+    {
+      std::array<HANDLE, batch_depth> hs{};
+      bool ok = init();
+
+      bool init()
+      {
+        for (auto& h : hs)
+        {
+          h = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+          if (!h)
+          {
+            return false;
+          }
+        }
+        return true;
+      }
+
+      ~events_holder()
+      {
+        for (auto h : hs)
+        {
+          if (h) CloseHandle(h);
+        }
+      }
+    } tls_events;
+
+    if (!tls_events.ok)
+    {
+      SPDLOG_ERROR("CreateEventW failed: {}", os::last_error_string());
+      return false;
+    }
+
+    constexpr size_t max_size = std::numeric_limits<DWORD>::max();
+
+    std::array<slot, batch_depth> slots{};
+    std::array<HANDLE, batch_depth> waited{};
+    std::array<size_t, batch_depth> waited_slots{};
+    std::array<bool, batch_depth> busy{};
+
+    size_t next_idx = 0;
+    size_t in_flight = 0;
+    bool ok = true;
+
+    auto complete = [&](size_t req_idx, bool req_ok)
+    {
+      if (on_completion)
+      {
+        on_completion(req_idx, req_ok);
+      }
+      ok = ok && req_ok;
+    };
+
+    while ((ok && next_idx < requests.size()) || in_flight)
+    {
+      // fill the free slots
+      for (size_t s = 0; s < batch_depth && ok && next_idx < requests.size(); ++s)
+      {
+        if (busy[s])
+        {
+          continue;
+        }
+
+        const size_t req_idx = next_idx++;
+        const auto& req = requests[req_idx];
+
+        // too big for one ReadFile
+        if (req.dst.size() > max_size)
+        {
+          complete(req_idx, read_at(req.offset, req.dst));
+          continue;
+        }
+
+        auto& sl = slots[s];
+        sl = {};
+        sl.req_idx = req_idx;
+        sl.ov.Offset = static_cast<DWORD>(req.offset);
+        sl.ov.OffsetHigh = static_cast<DWORD>(static_cast<uint64_t>(req.offset) >> 32);
+        sl.ov.hEvent = tls_events.hs[s];
+
+        if (!ReadFile(m_h, req.dst.data(), static_cast<DWORD>(req.dst.size()), nullptr, &sl.ov))
+        {
+          DWORD dwErr = GetLastError();
+          if (dwErr != ERROR_IO_PENDING)
+          {
+            // ERROR_NOT_ENOUGH_MEMORY and the like, read_at retries
+            complete(req_idx, read_at(req.offset, req.dst));
+            continue;
+          }
+        }
+
+        busy[s] = true;
+        ++in_flight;
+      }
+
+      if (!in_flight)
+      {
+        continue;
+      }
+
+      DWORD waited_cnt = 0;
+      for (size_t s = 0; s < batch_depth; ++s)
+      {
+        if (busy[s])
+        {
+          waited[waited_cnt] = tls_events.hs[s];
+          waited_slots[waited_cnt] = s;
+          ++waited_cnt;
+        }
+      }
+
+      const DWORD res = WaitForMultipleObjects(waited_cnt, waited.data(), FALSE, INFINITE);
+      if (res >= WAIT_OBJECT_0 + waited_cnt)
+      {
+        SPDLOG_ERROR("WaitForMultipleObjects failed: {}", os::last_error_string());
+        // the buffers can't be released with reads in flight
+        CancelIoEx(m_h, nullptr);
+        for (size_t s = 0; s < batch_depth; ++s)
+        {
+          DWORD read_cnt = 0;
+          if (busy[s])
+          {
+            GetOverlappedResult(m_h, &slots[s].ov, &read_cnt, TRUE);
+          }
+        }
+        return false;
+      }
+
+      const size_t s = waited_slots[res - WAIT_OBJECT_0];
+      const auto& req = requests[slots[s].req_idx];
+      busy[s] = false;
+      --in_flight;
+
+      DWORD read_cnt = 0;
+      bool req_ok = true;
+      if (!GetOverlappedResult(m_h, &slots[s].ov, &read_cnt, FALSE))
+      {
+        DWORD dwErr = GetLastError();
+        if (dwErr == ERROR_HANDLE_EOF)
+        {
+          SPDLOG_ERROR("ReadFile EOF");
+        }
+        else
+        {
+          SPDLOG_ERROR("GetOverlappedResult failed: {}", os::format_error(dwErr));
+        }
+        req_ok = false;
+      }
+      else if (read_cnt < req.dst.size())
+      {
+        req_ok = read_at(req.offset + read_cnt, req.dst.subspan(read_cnt));
+      }
+
+      complete(slots[s].req_idx, req_ok);
+    }
+
+    return ok;
+  }
+
   bool close() override
   {
     if (is_open())
@@ -117,7 +357,11 @@ struct win_file_reader
 
 private:
 
+  // at most MAXIMUM_WAIT_OBJECTS
+  static constexpr size_t batch_depth = 32;
+
   HANDLE m_h = INVALID_HANDLE_VALUE;
+  size_t m_offset = 0;
 };
 
 
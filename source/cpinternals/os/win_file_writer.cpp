@@ -0,0 +1,116 @@
+#include <cpinternals/os/file_writer.hpp>
+#include <cpinternals/os/platform_utils.hpp>
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+
+#include <filesystem>
+#include <memory>
+
+#include <cpinternals/common.hpp>
+
+namespace cp::os {
+
+// synchronous handle, WriteFile is given the offset through an OVERLAPPED
+// structure (it still completes before returning).
+struct win_file_writer
+  : file_writer_impl
+{
+  ~win_file_writer() override
+  {
+    close();
+  }
+
+  bool open(const std::filesystem::path& p, bool truncate) override
+  {
+    if (is_open())
+    {
+      return false;
+    }
+
+    m_h = CreateFileW(
+      p.c_str(), FILE_GENERIC_WRITE, 0, nullptr,
+      truncate ? CREATE_ALWAYS : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+    if (m_h == INVALID_HANDLE_VALUE)
+    {
+      SPDLOG_ERROR("CreateFileW failed: {}", os::last_error_string());
+      return false;
+    }
+
+    return true;
+  }
+
+  bool is_open() const override
+  {
+    return m_h != INVALID_HANDLE_VALUE;
+  }
+
+  bool write_at(size_t offset, std::span<const char> src) override
+  {
+    if (!is_open())
+    {
+      SPDLOG_ERROR("!is_open()");
+      return false;
+    }
+
+    constexpr size_t max_size = std::numeric_limits<DWORD>::max();
+
+    while (src.size())
+    {
+      const DWORD write_size = static_cast<DWORD>(std::min(src.size(), max_size));
+      DWORD written_cnt = 0;
+
+      OVERLAPPED ov{};
+      ov.Offset = static_cast<DWORD>(offset);
+      ov.OffsetHigh = static_cast<DWORD>(static_cast<uint64_t>(offset) >> 32);
+
+      if (!WriteFile(m_h, src.data(), write_size, &written_cnt, &ov))
+      {
+        SPDLOG_ERROR("WriteFile failed: {}", os::last_error_string());
+        return false;
+      }
+
+      if (written_cnt != write_size)
+      {
+        SPDLOG_ERROR("WriteFile wrote {} bytes out of {}", written_cnt, write_size);
+        return false;
+      }
+
+      src = src.subspan(write_size);
+      offset += write_size;
+    }
+
+    return true;
+  }
+
+  bool close() override
+  {
+    if (is_open())
+    {
+      CloseHandle(m_h);
+      m_h = INVALID_HANDLE_VALUE;
+      return true;
+    }
+
+    return false;
+  }
+
+private:
+
+  HANDLE m_h = INVALID_HANDLE_VALUE;
+};
+
+
+file_writer::file_writer()
+{
+  m_impl = std::make_unique<win_file_writer>();
+}
+
+file_writer::~file_writer()
+{
+}
+
+} // namespace cp::os
+
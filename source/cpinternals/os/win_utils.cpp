@@ -87,6 +87,38 @@ std::string format_error(error_type id)
   return "";
 }
 
+size_t capture_stack(void** frames, size_t max_frames, size_t skip_cnt)
+{
+  return CaptureStackBackTrace(static_cast<DWORD>(skip_cnt + 1), static_cast<DWORD>(max_frames), frames, nullptr);
+}
+
+std::string describe_code_address(void* addr)
+{
+  HMODULE module = nullptr;
+  if (!GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+    static_cast<LPCWSTR>(addr), &module))
+  {
+    return fmt::format("{}", addr);
+  }
+
+  char module_path[MAX_PATH] = {};
+  GetModuleFileNameA(module, module_path, MAX_PATH);
+
+  return fmt::format("{}!+{:#x}", std::filesystem::path(module_path).filename().string(),
+    reinterpret_cast<uintptr_t>(addr) - reinterpret_cast<uintptr_t>(module));
+}
+
+bool set_thread_background_mode(bool enabled)
+{
+  // background mode also lowers the io and memory priorities
+  if (!SetThreadPriority(GetCurrentThread(), enabled ? THREAD_MODE_BACKGROUND_BEGIN : THREAD_MODE_BACKGROUND_END))
+  {
+    SPDLOG_ERROR("SetThreadPriority failed: {}", last_error_string());
+    return false;
+  }
+  return true;
+}
+
 } // namespace cp::os
 
 
@@ -0,0 +1,78 @@
+#include "class_type.hpp"
+
+#include <cpinternals/scripting/cclass.hpp>
+
+namespace cp::rtdt {
+
+types_mgr::types_mgr()
+{
+  // same names as the basic properties (see CPropertyFactory)
+  auto add_native = [this]<typename T>(std::string_view name, T*)
+  {
+    const gname gn(name);
+    m_types.emplace(gn, std::make_unique<native_type<T>>(gn, typekind::fundamental));
+  };
+
+  add_native("Bool",      (bool*)nullptr);
+  add_native("Uint8",     (uint8_t*)nullptr);
+  add_native("Int8",      (int8_t*)nullptr);
+  add_native("Uint16",    (uint16_t*)nullptr);
+  add_native("Int16",     (int16_t*)nullptr);
+  add_native("Uint32",    (uint32_t*)nullptr);
+  add_native("Int32",     (int32_t*)nullptr);
+  add_native("Uint64",    (uint64_t*)nullptr);
+  add_native("Int64",     (int64_t*)nullptr);
+  add_native("Float",     (float*)nullptr);
+  add_native("Double",    (double*)nullptr);
+  add_native("TweakDBID", (TweakDBID*)nullptr);
+  add_native("CName",     (CName*)nullptr);
+  add_native("CRUID",     (uint64_t*)nullptr);
+}
+
+namespace {
+
+// embedded classes can't contain themselves, the depth only guards against
+// bad blueprints
+constexpr size_t max_class_depth = 32;
+
+const class_type* build_class_type(gname ctypename, size_t depth)
+{
+  auto& mgr = types_mgr::instance();
+
+  if (const itype* t = mgr.find(ctypename))
+    return t->kind() == typekind::Class ? static_cast<const class_type*>(t) : nullptr;
+
+  if (depth >= max_class_depth)
+    return nullptr;
+
+  const auto bp = CObjectBPList::get().get_or_make_bp(ctypename);
+  const auto& field_bps = bp->field_bps();
+  // classes missing from the db have no fields until learned
+  if (field_bps.empty() && bp->is_learnable())
+    return nullptr;
+
+  std::vector<std::pair<gname, const itype*>> fields;
+  fields.reserve(field_bps.size());
+  for (const auto& field_bp : field_bps)
+  {
+    const itype* t = mgr.find(field_bp.ctypename());
+    if (!t)
+      t = build_class_type(field_bp.ctypename(), depth + 1);
+    if (!t)
+      return nullptr;
+    fields.emplace_back(field_bp.name(), t);
+  }
+
+  const itype* t = mgr.add(std::make_unique<class_type>(ctypename, fields));
+  return t->kind() == typekind::Class ? static_cast<const class_type*>(t) : nullptr;
+}
+
+} // namespace
+
+const class_type* get_class_type(gname ctypename)
+{
+  return build_class_type(ctypename, 0);
+}
+
+} // namespace cp::rtdt
+
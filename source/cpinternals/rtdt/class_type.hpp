@@ -0,0 +1,219 @@
+#pragma once
+#include <memory>
+#include <new>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "itype.hpp"
+#include "native.hpp"
+
+namespace cp::rtdt {
+
+// Class whose fields are stored inline: an instance is a single block in
+// which each field is constructed in place at an offset computed once per
+// class (fields in declaration order, each one aligned on its type).
+// Field types must be flat themselves: natives or other class_types
+// (embedded, not pointed to).
+// Serialization writes the fields in order with their type's serializer,
+// it isn't the CSystem object format (no field descriptors, no string pool).
+struct class_type
+  : itype
+{
+  struct field_t
+  {
+    gname name;
+    const itype* type;
+    size_t offset;
+  };
+
+  class_type(gname name, const std::vector<std::pair<gname, const itype*>>& fields)
+    : itype(name)
+  {
+    m_fields.reserve(fields.size());
+    size_t offset = 0;
+    for (const auto& [field_name, type] : fields)
+    {
+      const size_t align = type->alignment();
+      offset = (offset + align - 1) & ~(align - 1);
+      m_field_indices.emplace(field_name.idx(), static_cast<uint32_t>(m_fields.size()));
+      m_fields.push_back({field_name, type, offset});
+      offset += type->size();
+      m_alignment = std::max(m_alignment, align);
+    }
+    m_size = (offset + m_alignment - 1) & ~(m_alignment - 1);
+  }
+
+  ~class_type() override = default;
+
+  typekind kind() const override
+  {
+    return typekind::Class;
+  }
+
+  size_t size() const override
+  {
+    return m_size;
+  }
+
+  size_t alignment() const override
+  {
+    return m_alignment;
+  }
+
+  void construct(void* p) const override
+  {
+    char* base = static_cast<char*>(p);
+    size_t i = 0;
+    try
+    {
+      for (; i < m_fields.size(); ++i)
+        m_fields[i].type->construct(base + m_fields[i].offset);
+    }
+    catch (...)
+    {
+      while (i--)
+        m_fields[i].type->destroy(base + m_fields[i].offset);
+      throw;
+    }
+  }
+
+  void destroy(void* p) const override
+  {
+    char* base = static_cast<char*>(p);
+    for (size_t i = m_fields.size(); i--;)
+      m_fields[i].type->destroy(base + m_fields[i].offset);
+  }
+
+  // to be released with deallocate
+  void* allocate() const override
+  {
+    void* p = ::operator new(std::max<size_t>(m_size, 1), std::align_val_t(m_alignment));
+    try
+    {
+      construct(p);
+    }
+    catch (...)
+    {
+      ::operator delete(p, std::align_val_t(m_alignment));
+      throw;
+    }
+    return p;
+  }
+
+  void deallocate(void* p) const
+  {
+    if (!p)
+      return;
+    destroy(p);
+    ::operator delete(p, std::align_val_t(m_alignment));
+  }
+
+  bool serialize(streambase& ar, void* p) const override
+  {
+    char* base = static_cast<char*>(p);
+    for (const auto& f : m_fields)
+    {
+      if (!f.type->serialize(ar, base + f.offset))
+        return false;
+    }
+    return true;
+  }
+
+  const std::vector<field_t>& fields() const
+  {
+    return m_fields;
+  }
+
+  static constexpr uint32_t npos = uint32_t(-1);
+
+  uint32_t field_index(gname name) const
+  {
+    auto it = m_field_indices.find(name.idx());
+    return it != m_field_indices.end() ? it->second : npos;
+  }
+
+  // plain offset access, null if there is no such field or if it isn't a T
+  template <typename T>
+  T* field_ptr(void* p, gname name) const
+  {
+    const uint32_t idx = field_index(name);
+    if (idx == npos || !dynamic_cast<const native_type<T>*>(m_fields[idx].type))
+      return nullptr;
+    return reinterpret_cast<T*>(static_cast<char*>(p) + m_fields[idx].offset);
+  }
+
+protected:
+  std::vector<field_t> m_fields;
+  std::unordered_map<uint32_t, uint32_t> m_field_indices; // name idx -> field idx
+  size_t m_size = 0;
+  size_t m_alignment = 1;
+};
+
+// flat class type built from the blueprint of ctypename (registered once),
+// null if one of its fields has a type that can't be stored inline
+// (arrays, handles, enums, unknown types..)
+const class_type* get_class_type(gname ctypename);
+
+// owning instance of a class_type
+class instance
+{
+  const class_type* m_type = nullptr;
+  void* m_data = nullptr;
+
+public:
+  instance() = default;
+
+  explicit instance(const class_type* type)
+    : m_type(type), m_data(type->allocate()) {}
+
+  ~instance()
+  {
+    reset();
+  }
+
+  instance(const instance&) = delete;
+  instance& operator=(const instance&) = delete;
+
+  instance(instance&& other) noexcept
+    : m_type(std::exchange(other.m_type, nullptr))
+    , m_data(std::exchange(other.m_data, nullptr)) {}
+
+  instance& operator=(instance&& other) noexcept
+  {
+    if (this != &other)
+    {
+      reset();
+      m_type = std::exchange(other.m_type, nullptr);
+      m_data = std::exchange(other.m_data, nullptr);
+    }
+    return *this;
+  }
+
+  void reset()
+  {
+    if (m_type)
+      m_type->deallocate(m_data);
+    m_type = nullptr;
+    m_data = nullptr;
+  }
+
+  explicit operator bool() const { return m_data != nullptr; }
+
+  const class_type* type() const { return m_type; }
+  void* data() const { return m_data; }
+
+  template <typename T>
+  T* field(gname name) const
+  {
+    return m_type ? m_type->field_ptr<T>(m_data, name) : nullptr;
+  }
+
+  bool serialize(streambase& ar) const
+  {
+    return m_type && m_type->serialize(ar, m_data);
+  }
+};
+
+} // namespace cp::rtdt
+
@@ -1,26 +1,129 @@
 #pragma once
 #include "itype.hpp"
 
+#include <string_view>
+#include <tuple>
 #include <vector>
+
+// rttr is only needed by tooling (e.g. dumping the registered types), define
+// CP_RTDT_WITH_RTTR to enable it on the scriptables.
+#ifdef CP_RTDT_WITH_RTTR
 #include <rttr/type>
+#define CP_RTDT_RTTR_ENABLE(...) RTTR_ENABLE(__VA_ARGS__)
+#else
+#define CP_RTDT_RTTR_ENABLE(...)
+#endif
 
 namespace cp::rtdt {
 
+// Compile-time property descriptor of a native scriptable: name and member
+// pointer, the member's type and owner are part of the descriptor's type.
+template <typename Class, typename T>
+struct prop_desc
+{
+  using class_type = Class;
+  using value_type = T;
+
+  std::string_view name;
+  T Class::* member;
+
+  constexpr T& get(Class& obj) const { return obj.*member; }
+  constexpr const T& get(const Class& obj) const { return obj.*member; }
+};
+
+template <typename Class, typename T>
+constexpr prop_desc<Class, T> prop(std::string_view name, T Class::* member)
+{
+  return {name, member};
+}
+
+// Native scriptables declare their properties as a constexpr tuple:
+//
+//  struct foo : scriptable<foo>
+//  {
+//    int a;
+//    float b;
+//    static constexpr auto properties = std::make_tuple(
+//      prop("a", &foo::a), prop("b", &foo::b));
+//  };
+template <typename T>
+struct prop_table
+{
+  static constexpr auto& descs = T::properties;
+  static constexpr size_t size = std::tuple_size_v<std::remove_cv_t<std::remove_reference_t<decltype(T::properties)>>>;
+
+  // calls fn(desc) for each property descriptor, in declaration order
+  template <typename Fn>
+  static constexpr void for_each(Fn&& fn)
+  {
+    std::apply([&](const auto&... d) { (fn(d), ...); }, descs);
+  }
+
+  // index of the property named name, size if none
+  static constexpr size_t index_of(std::string_view name)
+  {
+    size_t idx = 0, found = size;
+    for_each([&](const auto& d) {
+      if (found == size && d.name == name)
+        found = idx;
+      ++idx;
+    });
+    return found;
+  }
+};
+
 struct iscriptable
   : iserializable
 {
-  RTTR_ENABLE();
+  CP_RTDT_RTTR_ENABLE();
 
 public:
   ~iscriptable() override = default;
-  iscriptable()
+
+  size_t props_count() const
   {
-    prop_default_states.resize(get_type().get_properties().size(), true);
+    return prop_default_states.size();
+  }
+
+  bool has_default_value(size_t prop_idx) const
+  {
+    return prop_default_states[prop_idx];
   }
 
 protected:
+  // the count comes from the compile-time table of the final type, see
+  // scriptable
+  explicit iscriptable(size_t props_cnt)
+    : prop_default_states(props_cnt, true)
+  {
+  }
+
   std::vector<bool> prop_default_states;
+};
+
+// base of the native scriptables, sized from their property table
+template <typename Derived>
+struct scriptable
+  : iscriptable
+{
+  CP_RTDT_RTTR_ENABLE(iscriptable);
 
+public:
+  ~scriptable() override = default;
+
+protected:
+  scriptable()
+    : iscriptable(prop_table<Derived>::size)
+  {
+  }
+
+  // serializes the properties in declaration order
+  bool serialize_props(streambase& ar)
+  {
+    auto& self = static_cast<Derived&>(*this);
+    prop_table<Derived>::for_each([&](const auto& d) { ar << d.get(self); });
+    return !ar.has_error();
+  }
 };
 
 } // namespace cp::rtdt
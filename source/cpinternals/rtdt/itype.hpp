@@ -1,4 +1,8 @@
 #pragma once
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+
 #include "cpinternals/common.hpp"
 
 // We don't need to exactly match the game rtti system since we only work on serialized data
@@ -55,13 +59,13 @@ struct itype
 
   virtual bool serialize(streambase& ar, void* p) const = 0;
 
-  virtual bool hash(void* p) const = 0;
-
 protected:
   gname m_name;
   CName m_cname;
 };
 
+// registry of the types by name, natives are registered on construction
+// (see class_type.cpp), classes when first built (see get_class_type).
 struct types_mgr
 {
   static types_mgr& instance()
@@ -73,10 +77,28 @@ struct types_mgr
   types_mgr(const types_mgr&) = delete;
   types_mgr& operator=(const types_mgr&) = delete;
 
+  // null if unknown
+  const itype* find(gname name) const
+  {
+    std::shared_lock<std::shared_mutex> sl(m_smtx);
+    auto it = m_types.find(name);
+    return it != m_types.end() ? it->second.get() : nullptr;
+  }
+
+  // the type already registered with that name wins
+  const itype* add(std::unique_ptr<itype>&& t)
+  {
+    std::unique_lock<std::shared_mutex> ul(m_smtx);
+    const gname name = t->name();
+    auto it = m_types.emplace(name, std::move(t)).first;
+    return it->second.get();
+  }
+
 private:
-  types_mgr() {}
+  types_mgr();
   ~types_mgr() {}
 
+  mutable std::shared_mutex m_smtx;
   std::unordered_map<gname, std::unique_ptr<itype>> m_types;
 };
 
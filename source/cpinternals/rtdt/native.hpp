@@ -49,7 +49,12 @@ struct native_type
 
   bool serialize(streambase& ar, void* p) const override
   {
-    ar << *static_cast<T*>(p);
+    T& value = *static_cast<T*>(p);
+    if constexpr (std::is_arithmetic_v<T>)
+      ar << value;
+    else
+      ar.serialize_pod_raw(value);
+    return !ar.has_error();
   }
 
 protected:
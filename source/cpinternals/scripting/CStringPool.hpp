@@ -4,12 +4,13 @@
 #include <exception>
 #include <stdexcept>
 #include <algorithm>
-#include <numeric>
 
 #include "cpinternals/common.hpp"
+#include "cpinternals/common/memory_usage.hpp"
 #include "cpinternals/ctypes.hpp"
 #include "cpinternals/csav/node.hpp"
 #include "cpinternals/csav/serializers.hpp"
+#include "cpinternals/io/span_reader.hpp"
 
 
 class CRangeDesc
@@ -59,26 +60,13 @@ protected:
   std::vector<CRangeDesc> m_descs;
   std::vector<char> m_buffer;
   
-  // accelerated search
+  // accelerated search: fnv1a64 -> idx, open addressing (linear probing).
+  // hashes are verified against the strings, duplicates resolve to the first.
 
-  std::vector<size_t> m_sorted_desc_indices;
+  static constexpr uint32_t npos = (uint32_t)-1;
 
-  struct search_value_t
-  {
-    const CStringPool* sp;
-    std::string_view s;
-
-    bool operator>(const size_t& idx) const {
-      const auto& desc = sp->m_descs[idx];
-      std::string_view other(sp->m_buffer.data() + desc.offset(), desc.len() - 1);
-      const bool ret = s > other;
-      return ret;
-    }
-
-    friend bool operator<(const size_t& idx, const search_value_t& sv) {
-      return sv.operator>(idx);
-    }
-  };
+  std::vector<uint64_t> m_hashes; // by idx
+  std::vector<uint32_t> m_slots;  // indices, npos if empty
 
 
 public:
@@ -100,25 +88,21 @@ public:
 
   uint32_t size() const { return (uint32_t)m_descs.size(); }
 
-  uint32_t to_idx(std::string_view s, bool create_if_not_present=true)
+  // heap bytes of the strings and of the index
+  size_t memory_usage() const
   {
-    size_t ssize = s.size();
-    const char* const pdata = m_buffer.data();
+    return cp::heap_bytes(m_descs) + cp::heap_bytes(m_buffer) + cp::heap_bytes(m_hashes) + cp::heap_bytes(m_slots);
+  }
 
-    uint32_t idx = 0;
-    auto it = lower_bound_idx(s);
-    if (it != m_sorted_desc_indices.end())
-    {
-      idx = (uint32_t)*it;
-      auto lbound_str = view_from_idx(idx);
-      if (s == lbound_str)
-        return idx;
-    }
+  uint32_t to_idx(std::string_view s, bool create_if_not_present=true)
+  {
+    const uint64_t hash = cp::fnv1a64(s);
 
-    if (!create_if_not_present)
-      return (uint32_t)-1;
+    uint32_t idx = find_idx(s, hash);
+    if (idx != npos || !create_if_not_present)
+      return idx;
 
-    ssize = s.size() + 1;
+    const size_t ssize = s.size() + 1;
     if (ssize > 0xFF)
       throw std::length_error("CStringPool: string is too big");
 
@@ -127,7 +111,7 @@ public:
     m_buffer.insert(m_buffer.end(), s.begin(), s.end());
     m_buffer.push_back('\0');
 
-    m_sorted_desc_indices.insert(it, idx);
+    index_string(hash);
     return idx;
   }
 
@@ -148,14 +132,69 @@ public:
     return std::string_view(m_buffer.data() + desc.offset()/*, desc.len()*/); // should include null character
   }
 
+  // fnv1a64 of the string at idx
+  uint64_t hash_from_idx(uint32_t idx) const
+  {
+    if (idx >= m_hashes.size())
+      throw std::out_of_range("CStringPool: out of range idx");
+    return m_hashes[idx];
+  }
+
 protected:
-  std::vector<size_t>::const_iterator lower_bound_idx(std::string_view s) const
+  uint32_t find_idx(std::string_view s, uint64_t hash) const
+  {
+    if (m_slots.empty())
+      return npos;
+
+    const size_t mask = m_slots.size() - 1;
+    size_t i = static_cast<size_t>(hash) & mask;
+    while (true)
+    {
+      const uint32_t idx = m_slots[i];
+      if (idx == npos)
+        return npos;
+      if (m_hashes[idx] == hash && view_from_idx(idx) == s)
+        return idx;
+      i = (i + 1) & mask;
+    }
+  }
+
+  void place(uint32_t idx)
+  {
+    const size_t mask = m_slots.size() - 1;
+    size_t i = static_cast<size_t>(m_hashes[idx]) & mask;
+    while (m_slots[i] != npos)
+      i = (i + 1) & mask;
+    m_slots[i] = idx;
+  }
+
+  void rehash(size_t capacity)
+  {
+    m_slots.assign(capacity, npos);
+    for (uint32_t idx = 0; idx < (uint32_t)m_hashes.size(); ++idx)
+      place(idx);
+  }
+
+  // indexes the last string, load factor is kept under 1/2
+  void index_string(uint64_t hash)
+  {
+    if ((m_hashes.size() + 1) * 2 > m_slots.size())
+      rehash(m_slots.size() ? m_slots.size() * 2 : 0x100);
+
+    m_hashes.push_back(hash);
+    place((uint32_t)m_hashes.size() - 1);
+  }
+
+  void reindex()
   {
-    return std::lower_bound(
-      m_sorted_desc_indices.begin(),
-      m_sorted_desc_indices.end(),
-      search_value_t{this, s}
-    );
+    m_hashes.resize(m_descs.size());
+    for (uint32_t idx = 0; idx < (uint32_t)m_descs.size(); ++idx)
+      m_hashes[idx] = cp::fnv1a64(view_from_idx(idx));
+
+    size_t capacity = 0x100;
+    while (capacity < m_hashes.size() * 2)
+      capacity *= 2;
+    rehash(capacity);
   }
 
 public:
@@ -191,11 +230,46 @@ public:
     reader.read(m_buffer.data(), data_size);
 
     // fill acceleration structure
-    m_sorted_desc_indices.resize(m_descs.size());
-    std::iota(m_sorted_desc_indices.begin(), m_sorted_desc_indices.end(), 0);
+    reindex();
+
+    return true;
+  }
+
+  // same as the stream version, from a span (e.g. a CSystem blob)
+  bool serialize_in(cp::span_reader& reader, uint32_t descs_size, uint32_t data_size, uint32_t descs_offset = 0)
+  {
+    if (descs_size % sizeof(CRangeDesc) != 0)
+      return false;
+
+    const uint32_t data_offset = descs_offset + descs_size;
+
+    const size_t descs_cnt = descs_size / sizeof(CRangeDesc);
+    if (descs_cnt == 0)
+      return data_size == 0;
+
+    m_descs.resize(descs_cnt);
+    if (!reader.read_bytes(m_descs.data(), descs_size))
+      return false;
+
+    uint32_t max_offset = 0;
+    // reoffset offsets
+    for (auto& desc : m_descs)
+    {
+      desc.offset(desc.offset() - data_offset);
+      const uint32_t end_offset = desc.end_offset();
+      if (end_offset > max_offset)
+        max_offset = end_offset;
+    }
+
+    const uint32_t real_end_offset = descs_size + data_size;
+    if (max_offset > real_end_offset)
+      return false;
+
+    m_buffer.resize(data_size);
+    if (!reader.read_bytes(m_buffer.data(), data_size))
+      return false;
 
-    std::stable_sort(m_sorted_desc_indices.begin(), m_sorted_desc_indices.end(),
-      [this](size_t i1, size_t i2){ return view_from_idx((uint32_t)i1) < view_from_idx((uint32_t)i2); });
+    reindex();
 
     return true;
   }
@@ -2,10 +2,12 @@
 #include "cclass.hpp"
 
 #include <Windows.h>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
+#include <cpinternals/asset_db.hpp>
 
 void to_json(nlohmann::json& j, const CFieldDesc& p)
 {
@@ -81,6 +83,14 @@ CObjectBPSPtr read_class_bp(std::unordered_map<gname, CObjectBPSPtr>& classmap,
 
 CObjectBPList::CObjectBPList()
 {
+  auto class_db = std::make_unique<cp::asset_db::class_db>();
+  if (class_db->open("db/CObjectBPs.json"))
+  {
+    m_class_db = std::move(class_db);
+    load_learned();
+    return;
+  }
+
   std::ifstream ifs;
   ifs.open("db/CObjectBPs.json");
   if (ifs.is_open())
@@ -106,8 +116,233 @@ CObjectBPList::CObjectBPList()
   {
     MessageBox(0, L"db/CEnums.json is missing", L"couldn't open resource file", 0);
   }
+
+  load_learned();
 }
 
 CObjectBPList::~CObjectBPList()
 {
 }
+
+// parents are built first, recursion is bounded since db records come
+// after their parent
+CObjectBPSPtr CObjectBPList::build_bp_from_db(uint32_t class_idx)
+{
+  cp::asset_db::class_record rec;
+  m_class_db->read(class_idx, rec);
+
+  auto it = m_classmap.find(rec.name);
+  if (it != m_classmap.end())
+    return it->second;
+
+  CObjectBPSPtr parent = nullptr;
+  if (rec.parent_idx != cp::asset_db::npos)
+    parent = build_bp_from_db(rec.parent_idx);
+
+  std::vector<CFieldDesc> fdescs;
+  fdescs.reserve(rec.fields.size());
+  for (const auto& f : rec.fields)
+    fdescs.emplace_back(f.name, f.ctypename);
+
+  auto new_bp = std::make_shared<CObjectBP>(rec.name, parent, fdescs);
+  if (parent)
+    parent->add_child(new_bp);
+
+  m_classmap.emplace(rec.name, new_bp);
+
+  return new_bp;
+}
+
+bool CObjectBPList::is_in_db(gname objtype) const
+{
+  if (m_class_db)
+    return m_class_db->find(objtype) != cp::asset_db::npos;
+
+  // json mode: the map only holds db classes until learned ones are added
+  auto it = m_classmap.find(objtype);
+  return it != m_classmap.end() && !it->second->is_learnable();
+}
+
+CObjectBPSPtr CObjectBPList::learn_fields(const CObjectBPSPtr& bp, const std::vector<CFieldDesc>& fdescs)
+{
+  if (!bp->is_learnable())
+    return bp;
+
+  // usual case, without locking
+  const bool has_all = std::all_of(fdescs.begin(), fdescs.end(),
+    [&](const CFieldDesc& fdesc) { return bp->field_index(fdesc.name) != CObjectBP::npos; });
+  if (has_all)
+    return bp;
+
+  const gname ctypename = bp->ctypename();
+
+  std::unique_lock<std::shared_mutex> ul(m_smtx);
+
+  // another object of the class may have learned some already
+  CObjectBPSPtr cur = bp;
+  auto it = m_classmap.find(ctypename);
+  if (it != m_classmap.end() && it->second)
+    cur = it->second;
+
+  std::vector<CFieldDesc> new_fdescs;
+  new_fdescs.reserve(cur->field_bps().size() + fdescs.size());
+  for (const auto& field_bp : cur->field_bps())
+    new_fdescs.push_back(field_bp.desc());
+
+  const size_t known_cnt = new_fdescs.size();
+  for (const auto& fdesc : fdescs)
+  {
+    if (cur->field_index(fdesc.name) != CObjectBP::npos)
+      continue;
+
+    // serialized twice
+    const bool already_added = std::any_of(new_fdescs.begin() + known_cnt, new_fdescs.end(),
+      [&](const CFieldDesc& added) { return added.name == fdesc.name; });
+    if (!already_added)
+      new_fdescs.push_back(fdesc);
+  }
+
+  if (new_fdescs.size() == known_cnt)
+    return cur;
+
+  auto new_bp = std::make_shared<CObjectBP>(ctypename, nullptr, new_fdescs, true);
+  m_classmap[ctypename] = new_bp;
+
+  SPDLOG_INFO("CObjectBPList: learned {} field(s) of {}", new_fdescs.size() - known_cnt, ctypename.strv());
+  append_learned(*new_bp);
+
+  return new_bp;
+}
+
+/* learned layouts file, append-only (little-endian):
+  uint32_t magic ('BLPC'), uint32_t version
+  records: uint32_t size (of the rest of the record)
+           str ctypename, uint32_t fields_cnt, { str name, str ctypename }[fields_cnt]
+  str: uint16_t len, char[len]
+a later record of a class replaces the previous ones, a truncated last
+record (interrupted write) is ignored.
+*/
+
+namespace {
+
+constexpr uint32_t learned_magic = 'BLPC';
+constexpr uint32_t learned_version = 1;
+
+void write_learned_str(std::string& out, std::string_view s)
+{
+  const uint16_t len = (uint16_t)std::min<size_t>(s.size(), UINT16_MAX);
+  out.append((const char*)&len, sizeof(len));
+  out.append(s.data(), len);
+}
+
+bool read_learned_str(std::string_view& in, std::string_view& s)
+{
+  uint16_t len = 0;
+  if (in.size() < sizeof(len))
+    return false;
+  std::memcpy(&len, in.data(), sizeof(len));
+  in.remove_prefix(sizeof(len));
+  if (in.size() < len)
+    return false;
+  s = in.substr(0, len);
+  in.remove_prefix(len);
+  return true;
+}
+
+} // namespace
+
+void CObjectBPList::load_learned()
+{
+  std::ifstream ifs(m_learned_path, std::ios::binary);
+  if (!ifs.is_open())
+    return;
+
+  const std::string data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+  std::string_view in(data);
+
+  uint32_t header[2] = {};
+  if (in.size() < sizeof(header))
+    return;
+  std::memcpy(header, in.data(), sizeof(header));
+  in.remove_prefix(sizeof(header));
+  if (header[0] != learned_magic || header[1] != learned_version)
+  {
+    SPDLOG_WARN("CObjectBPList: {} has an unknown format, ignored", m_learned_path.string());
+    return;
+  }
+
+  size_t records_cnt = 0;
+  while (in.size() >= sizeof(uint32_t))
+  {
+    uint32_t record_size = 0;
+    std::memcpy(&record_size, in.data(), sizeof(record_size));
+    in.remove_prefix(sizeof(record_size));
+    if (in.size() < record_size)
+      break;
+
+    std::string_view rec = in.substr(0, record_size);
+    in.remove_prefix(record_size);
+
+    std::string_view ctypename_str;
+    uint32_t fields_cnt = 0;
+    if (!read_learned_str(rec, ctypename_str) || rec.size() < sizeof(fields_cnt))
+      continue;
+    std::memcpy(&fields_cnt, rec.data(), sizeof(fields_cnt));
+    rec.remove_prefix(sizeof(fields_cnt));
+
+    std::vector<CFieldDesc> fdescs;
+    fdescs.reserve(fields_cnt);
+    bool ok = true;
+    for (uint32_t i = 0; i < fields_cnt && ok; ++i)
+    {
+      std::string_view name, field_ctypename;
+      ok = read_learned_str(rec, name) && read_learned_str(rec, field_ctypename);
+      if (ok)
+        fdescs.emplace_back(gname(name), gname(field_ctypename));
+    }
+
+    // the class may have been added to the db since
+    const gname ctypename(ctypename_str);
+    if (!ok || is_in_db(ctypename))
+      continue;
+
+    m_classmap[ctypename] = std::make_shared<CObjectBP>(ctypename, nullptr, fdescs, true);
+    ++records_cnt;
+  }
+
+  SPDLOG_INFO("CObjectBPList: {} learned class layouts loaded", records_cnt);
+}
+
+// called with the unique lock held
+void CObjectBPList::append_learned(const CObjectBP& bp) const
+{
+  std::string rec;
+  write_learned_str(rec, bp.ctypename().strv());
+  const uint32_t fields_cnt = (uint32_t)bp.field_bps().size();
+  rec.append((const char*)&fields_cnt, sizeof(fields_cnt));
+  for (const auto& field_bp : bp.field_bps())
+  {
+    write_learned_str(rec, field_bp.name().strv());
+    write_learned_str(rec, field_bp.ctypename().strv());
+  }
+
+  std::error_code ec;
+  const bool is_new = !std::filesystem::exists(m_learned_path, ec) || std::filesystem::file_size(m_learned_path, ec) == 0;
+
+  std::ofstream ofs(m_learned_path, std::ios::binary | std::ios::app);
+  if (!ofs.is_open())
+  {
+    SPDLOG_WARN("CObjectBPList: couldn't open {}", m_learned_path.string());
+    return;
+  }
+
+  if (is_new)
+  {
+    const uint32_t header[2] = {learned_magic, learned_version};
+    ofs.write((const char*)header, sizeof(header));
+  }
+
+  const uint32_t record_size = (uint32_t)rec.size();
+  ofs.write((const char*)&record_size, sizeof(record_size));
+  ofs.write(rec.data(), rec.size());
+}
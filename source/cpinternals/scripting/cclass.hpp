@@ -8,6 +8,9 @@
 #include <set>
 #include <unordered_map>
 #include <algorithm>
+#include <filesystem>
+#include <shared_mutex>
+#include <memory>
 
 #include <spdlog/spdlog.h>
 #include <nlohmann/json.hpp>
@@ -17,6 +20,7 @@
 #include "iproperty.hpp"
 #include "cproperty_factory.hpp"
 #include "CStringPool.hpp"
+#include "cpinternals/asset_db.hpp"
 
 
 struct CFieldDesc
@@ -58,17 +62,31 @@ public:
 
 class CObjectBP
 {
+public:
+  static constexpr uint32_t npos = UINT32_MAX;
+
+private:
+  // field name (gname index) -> field index, open addressing (linear probing)
+  struct field_slot
+  {
+    uint32_t name_idx = npos;
+    uint32_t field_idx = npos;
+  };
+
   gname m_ctypename;
   std::vector<CFieldBP> m_field_bps;
   CObjectBPSPtr m_parent;
   std::vector<std::weak_ptr<CObjectBP>> m_children;
+  std::vector<field_slot> m_field_slots;
+  bool m_learnable = false;
 
 public:
+  // class missing from the db, see is_learnable
   explicit CObjectBP(gname ctypename)
-    : m_ctypename(ctypename) {}
+    : m_ctypename(ctypename), m_learnable(true) {}
 
-  CObjectBP(gname ctypename, CObjectBPSPtr parent, const std::vector<CFieldDesc>& fdescs)
-    : m_ctypename(ctypename), m_parent(parent)
+  CObjectBP(gname ctypename, CObjectBPSPtr parent, const std::vector<CFieldDesc>& fdescs, bool learnable = false)
+    : m_ctypename(ctypename), m_parent(parent), m_learnable(learnable)
   {
     if (m_parent)
     {
@@ -77,34 +95,111 @@ public:
     }
     for (const auto& fdesc : fdescs)
       m_field_bps.emplace_back(fdesc);
+
+    index_fields();
   }
 
 
   gname ctypename() const { return m_ctypename; }
   CObjectBPSPtr parent() const { return m_parent; }
 
+  // classes missing from the db get their fields from the serial field
+  // descriptors of the loaded objects, see CObjectBPList::learn_fields
+  bool is_learnable() const { return m_learnable; }
+
   const std::vector<std::weak_ptr<CObjectBP>>& children() const { return m_children; }
 
   const std::vector<CFieldBP>& field_bps() const { return m_field_bps; }
 
+  // index of the first field bp with that name, npos if none
+  uint32_t field_index(gname name) const
+  {
+    if (m_field_slots.empty())
+      return npos;
+
+    const uint32_t name_idx = name.idx();
+    const size_t mask = m_field_slots.size() - 1;
+    size_t i = slot_of(name_idx) & mask;
+    while (true)
+    {
+      const auto& slot = m_field_slots[i];
+      if (slot.name_idx == name_idx)
+        return slot.field_idx;
+      if (slot.name_idx == npos)
+        return npos;
+      i = (i + 1) & mask;
+    }
+  }
+
   void add_child(const CObjectBPSPtr& child)
   {
     m_children.emplace_back(child);
   }
 
+protected:
+  // gname indices are sequential, this spreads them
+  static size_t slot_of(uint32_t name_idx)
+  {
+    return (size_t)(name_idx * 0x9E3779B1u);
+  }
+
+  void index_fields()
+  {
+    m_field_slots.clear();
+    if (m_field_bps.empty())
+      return;
+
+    // load factor kept under 1/2
+    size_t capacity = 8;
+    while (capacity < m_field_bps.size() * 2)
+      capacity *= 2;
+    m_field_slots.resize(capacity);
+
+    const size_t mask = capacity - 1;
+    for (uint32_t field_idx = 0; field_idx < (uint32_t)m_field_bps.size(); ++field_idx)
+    {
+      const uint32_t name_idx = m_field_bps[field_idx].name().idx();
+      size_t i = slot_of(name_idx) & mask;
+      while (m_field_slots[i].name_idx != npos && m_field_slots[i].name_idx != name_idx)
+        i = (i + 1) & mask;
+      // a shadowed field keeps the parent's index (first one)
+      if (m_field_slots[i].name_idx == npos)
+        m_field_slots[i] = {name_idx, field_idx};
+    }
+  }
 };
 
 
+// Blueprints are built lazily from the compiled classes db when it loads
+// (see asset_db.hpp): a class and its parents are only built the first time
+// they're asked for, so children lists only contain classes built so far.
+// When loaded from the json all classes are built upfront.
 class CObjectBPList
 {
 private:
   std::unordered_map<gname, CObjectBPSPtr> m_classmap;
+  // systems can be loaded concurrently
+  mutable std::shared_mutex m_smtx;
+
+  // set in lazy mode
+  std::unique_ptr<cp::asset_db::class_db> m_class_db;
+
+  // field layouts of the classes missing from the db, learned from the
+  // loaded saves. appended to on each learn, loaded on construction.
+  std::filesystem::path m_learned_path = "db/CObjectBPs.learned.bin";
 
   // filtered lists
 
   CObjectBPList();
   ~CObjectBPList();
 
+  // called with the unique lock held
+  CObjectBPSPtr build_bp_from_db(uint32_t class_idx);
+
+  bool is_in_db(gname objtype) const;
+  void load_learned();
+  void append_learned(const CObjectBP& bp) const;
+
 public:
   CObjectBPList(const CObjectBPList&) = delete;
   CObjectBPList& operator=(const CObjectBPList&) = delete;
@@ -119,11 +214,44 @@ public:
   // always returns a class, so that unknown ones can be configured
   CObjectBPSPtr get_or_make_bp(gname objtype)
   {
-    auto it = m_classmap.find(objtype);
-    if (it != m_classmap.end())
-      return it->second;
-    it = m_classmap.emplace(objtype, std::make_shared<CObjectBP>(objtype)).first;
+    {
+      std::shared_lock<std::shared_mutex> sl(m_smtx);
+      auto it = m_classmap.find(objtype);
+      if (it != m_classmap.end())
+        return it->second;
+    }
+
+    std::unique_lock<std::shared_mutex> ul(m_smtx);
+    if (m_class_db)
+    {
+      auto it = m_classmap.find(objtype);
+      if (it != m_classmap.end())
+        return it->second;
+
+      const uint32_t class_idx = m_class_db->find(objtype);
+      if (class_idx != cp::asset_db::npos)
+        return build_bp_from_db(class_idx);
+    }
+
+    // emplace doesn't insert if another thread did it in between
+    auto it = m_classmap.emplace(objtype, nullptr).first;
+    if (!it->second)
+      it->second = std::make_shared<CObjectBP>(objtype);
     return it->second;
   }
+
+  // returns the bp of the class of bp with all the fields of fdescs, the
+  // missing ones appended in their order. bp itself if it has them all or
+  // isn't learnable. blueprints are immutable: objects already built keep
+  // the previous one. learned layouts are persisted (see m_learned_path)
+  // so that the next loads decode those classes with typed properties.
+  CObjectBPSPtr learn_fields(const CObjectBPSPtr& bp, const std::vector<CFieldDesc>& fdescs);
+
+  // number of blueprints built so far
+  size_t built_count() const
+  {
+    std::shared_lock<std::shared_mutex> sl(m_smtx);
+    return m_classmap.size();
+  }
 };
 
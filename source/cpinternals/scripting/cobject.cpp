@@ -5,9 +5,9 @@ bool CObject::imgui_widget_wpos(const char* label, bool editable)
 {
   bool modified = false;
 
-  auto fxx = (CIntProperty*)((CObjectProperty*)m_fields[0].prop.get())->obj()->get_prop("Bits"_gn);
-  auto fxy = (CIntProperty*)((CObjectProperty*)m_fields[1].prop.get())->obj()->get_prop("Bits"_gn);
-  auto fxz = (CIntProperty*)((CObjectProperty*)m_fields[2].prop.get())->obj()->get_prop("Bits"_gn);
+  auto fxx = (CIntProperty*)((CObjectProperty*)field_prop(m_fields[0]))->obj()->get_prop("Bits"_gn);
+  auto fxy = (CIntProperty*)((CObjectProperty*)field_prop(m_fields[1]))->obj()->get_prop("Bits"_gn);
+  auto fxz = (CIntProperty*)((CObjectProperty*)field_prop(m_fields[2]))->obj()->get_prop("Bits"_gn);
 
   constexpr float exponent = 1.f / (2 << 16);
 
@@ -35,10 +35,10 @@ bool CObject::imgui_widget_quat(const char* label, bool editable)
 {
   bool modified = false;
 
-  auto pffi = (CFloatProperty*)m_fields[0].prop.get();
-  auto pffj = (CFloatProperty*)m_fields[1].prop.get();
-  auto pffk = (CFloatProperty*)m_fields[2].prop.get();
-  auto pffr = (CFloatProperty*)m_fields[3].prop.get();
+  auto pffi = (CFloatProperty*)field_prop(m_fields[0]);
+  auto pffj = (CFloatProperty*)field_prop(m_fields[1]);
+  auto pffk = (CFloatProperty*)field_prop(m_fields[2]);
+  auto pffr = (CFloatProperty*)field_prop(m_fields[3]);
 
   constexpr float exponent = 1.f / (2 << 16);
 
@@ -3,6 +3,7 @@
 #include <list>
 #include <array>
 #include <set>
+#include <mutex>
 #include <exception>
 #include <stdexcept>
 
@@ -13,6 +14,7 @@
 #include "fwd.hpp"
 #include "CStringPool.hpp"
 #include "csystem_serctx.hpp"
+#include "csystem_loaddata.hpp"
 #include "cclass.hpp"
 #include "iproperty.hpp"
 #include "cproperty_factory.hpp"
@@ -48,7 +50,10 @@ class CObject
       : name(name), prop(std::move(prop)) {}
 
     gname name;
+    // null until first accessed or deserialized, see field_prop
     CPropertyUPtr prop;
+    // index in m_lazy->fields while not decoded, see serialize_in_lazy
+    uint32_t pending = CObjectBP::npos;
 
     void fallback_to_unknown_prop()
     {
@@ -57,10 +62,35 @@ class CObject
     }
   };
 
+  // serialized field of a lazily decoded object
+  struct lazy_field_t
+  {
+    uint32_t field_idx;
+    uint32_t data_offset; // in the blob
+    uint32_t data_size;
+    bool failed = false;  // stays pending, not retried
+  };
+
+  struct lazy_state_t
+  {
+    std::shared_ptr<CSystemLoadData> loaddata;
+    std::span<const char> blob; // in loaddata->objdata
+    std::vector<lazy_field_t> fields;
+    size_t pending_cnt = 0;
+    bool materialized = false; // m_fields built from the bp
+  };
+
 protected:
-  std::vector<field_t> m_fields;
+  std::vector<field_t, CSystemArenaAllocator<field_t>> m_fields;
   CObjectBPSPtr m_blueprint;
 
+  // null unless some fields are still pending
+  std::unique_ptr<lazy_state_t> m_lazy;
+  // property events of lazily decoded fields aren't modifications
+  bool m_lazy_decoding = false;
+  // set during edit_batch
+  bool m_events_muted = false;
+
 public:
   CObject(gname ctypename, bool delay_fields_init=false)
   {
@@ -75,30 +105,70 @@ public:
     clear_fields();
   }
 
+  // the object is allocated from the arena of the current scope if any (see CSystemArena)
+  static CObjectSPtr create(gname ctypename, bool delay_fields_init=false)
+  {
+    return std::allocate_shared<CObject>(CSystemArenaAllocator<CObject>(), ctypename, delay_fields_init);
+  }
+
 public:
   gname ctypename() const { return m_blueprint->ctypename(); }
 
+  // O(1), see CObjectBP::field_index
+  // a pending field is decoded first, see serialize_in_lazy
   CProperty* get_prop(gname field_name) const
   {
-    // fast enough
-    for (auto& field : m_fields)
-    {
-      if (field.name == field_name)
-        return field.prop.get();
-    }
-    return nullptr;
+    if (m_lazy)
+      const_cast<CObject*>(this)->materialize_lazy_fields();
+
+    const uint32_t idx = field_index(field_name);
+    if (idx == CObjectBP::npos)
+      return nullptr;
+
+    auto& field = const_cast<CObject*>(this)->m_fields[idx];
+    if (field.pending != CObjectBP::npos)
+      std::ignore = const_cast<CObject*>(this)->decode_lazy_field(field);
+
+    return const_cast<CObject*>(this)->field_prop(field);
   }
 
   template <typename T>
   T* get_prop_cast(gname field_name) const
   {
-    // fast enough
-    for (auto& field : m_fields)
+    return dynamic_cast<T*>(get_prop(field_name));
+  }
+
+  // calls fn(gname field_name, const CProperty* prop) for each field, in bp
+  // order. pending fields are decoded first (see get_prop).
+  template <typename Fn>
+  void for_each_field(Fn&& fn) const
+  {
+    auto nc_this = const_cast<CObject*>(this);
+    if (m_lazy)
+      nc_this->materialize_lazy_fields();
+
+    for (auto& field : nc_this->m_fields)
     {
-      if (field.name == field_name)
-        return dynamic_cast<T*>(field.prop.get());
+      if (field.pending != CObjectBP::npos)
+        std::ignore = nc_this->decode_lazy_field(field);
+      fn(field.name, static_cast<const CProperty*>(nc_this->field_prop(field)));
+    }
+  }
+
+  // memory accounting of the object and of its created props, pending
+  // fields aren't decoded (their bytes are in the load data)
+  void accumulate_memory_usage(cp::memory_usage& mu) const
+  {
+    ++mu.objects_cnt;
+    mu.object_bytes += sizeof(CObject) + cp::heap_bytes(m_fields) + cp::heap_bytes(m_listeners);
+    if (m_lazy)
+      mu.object_bytes += sizeof(lazy_state_t) + cp::heap_bytes(m_lazy->fields);
+
+    for (const auto& field : m_fields)
+    {
+      if (field.prop)
+        field.prop->accumulate_memory_usage(mu);
     }
-    return nullptr;
   }
 
 protected:
@@ -107,15 +177,34 @@ protected:
     m_fields.clear();
   }
 
+  // props aren't created here: most objects only serialize a few of their
+  // bp's fields, the others are created on first access (see field_prop)
   void reset_fields_from_bp()
   {
     clear_fields();
-    for (auto& field_desc : m_blueprint->field_bps())
+    const auto& field_bps = m_blueprint->field_bps();
+    m_fields.reserve(field_bps.size());
+    for (auto& field_desc : field_bps)
     {
-      m_fields.emplace_back(field_desc.name(), std::move(field_desc.create_prop(this)));
+      m_fields.emplace_back(field_desc.name(), nullptr);
     }
   }
 
+  // creates the prop of field if it doesn't exist yet.
+  // a prop that was never created has its construction value, which is
+  // skipped in serialization.
+  CProperty* field_prop(field_t& field)
+  {
+    if (!field.prop)
+      field.prop = m_blueprint->field_bps()[&field - m_fields.data()].create_prop(this);
+    return field.prop.get();
+  }
+
+  gname field_ctypename(const field_t& field) const
+  {
+    return m_blueprint->field_bps()[&field - m_fields.data()].ctypename();
+  }
+
   struct serial_field_desc_t
   {
     serial_field_desc_t() = default;
@@ -129,6 +218,7 @@ protected:
   };
 
   static inline std::set<std::string> to_implement_ctypenames;
+  static inline std::mutex to_implement_ctypenames_mtx;
 
   // todo move inside field struct
   [[nodiscard]] bool serialize_field(field_t& field, std::istream& is, CSystemSerCtx& serctx, bool eof_is_end_of_prop = false)
@@ -158,7 +248,10 @@ protected:
       is.setstate(std::ios_base::badbit);
     }
 
-    to_implement_ctypenames.emplace(std::string(prop->ctypename().c_str()));
+    {
+      std::lock_guard<std::mutex> lock(to_implement_ctypenames_mtx);
+      to_implement_ctypenames.emplace(std::string(prop->ctypename().c_str()));
+    }
 
     // try fall-back
     if (!is_unknown_prop && eof_is_end_of_prop)
@@ -173,59 +266,66 @@ protected:
     return false;
   }
 
-public:
-  [[nodiscard]] bool serialize_in(const std::span<char>& blob, CSystemSerCtx& serctx)
+  [[nodiscard]] bool serialize_field(field_t& field, span_reader& reader, CSystemSerCtx& serctx, bool eof_is_end_of_prop = false)
   {
-    span_istreambuf sbuf(blob);
-    std::istream is(&sbuf);
-
-    if (!serialize_in(is, serctx, true))
-      return false;
-    if (!is.good())
+    if (!reader.good())
       return false;
 
-    if (is.eof()) // tellg would fail if eofbit is set
-      is.seekg(0, std::ios_base::end);
-    const size_t read = (size_t)is.tellg();
+    auto prop = field.prop.get();
+    const bool is_unknown_prop = prop->kind() == EPropertyKind::Unknown;
 
-    if (read != blob.size())
+    if (!eof_is_end_of_prop && is_unknown_prop)
       return false;
 
-    return true;
-  }
-
-  // eof_is_end_of_object allows for last property to be an unknown one (greedy read)
-  // callers should check if object has been serialized completely ! (array props, system..)
-  [[nodiscard]] bool serialize_in(std::istream& is, CSystemSerCtx& serctx, bool eof_is_end_of_object=false)
-  {
-    uint32_t start_pos = (uint32_t)is.tellg();
+    const span_reader start_reader = reader;
 
-    // m_fields cnt
-    uint16_t serial_fields_cnt = 0;
-    is >> cbytes_ref(serial_fields_cnt);
-    if (serial_fields_cnt < 1)
-      return true;
+    try
+    {
+      if (prop->serialize_in(reader, serctx) && reader.good())
+      {
+        // if end of prop is known, return property only if it serialized completely
+        if (!eof_is_end_of_prop || reader.at_end())
+          return true;
+      }
+    }
+    catch (std::exception&)
+    {
+      reader.set_error();
+    }
 
-    // field descriptors
-    std::vector<serial_field_desc_t> serial_descs(serial_fields_cnt);
-    is.read((char*)serial_descs.data(), serial_fields_cnt * sizeof(serial_field_desc_t));
-    if (!is.good())
-      return false;
+    {
+      std::lock_guard<std::mutex> lock(to_implement_ctypenames_mtx);
+      to_implement_ctypenames.emplace(std::string(prop->ctypename().c_str()));
+    }
 
-    uint32_t data_pos = (uint32_t)is.tellg();
+    // try fall-back
+    if (!is_unknown_prop && eof_is_end_of_prop)
+    {
+      reader = start_reader;
+      field.fallback_to_unknown_prop();
+      if (field.prop->serialize_in(reader, serctx))
+        return true;
+    }
 
-    auto& strpool = serctx.strpool;
+    return false;
+  }
 
-    auto& bpdescs = m_blueprint->field_bps();
+  struct serial_data_desc_t
+  {
+    uint32_t data_offset;
+    uint32_t data_size = 0;
+  };
 
-    struct data_desc_t
-    {
-      uint32_t data_offset;
-      uint32_t data_size = 0;
-    };
+  // validates the serialized field descriptors, descs_end is the offset of
+  // the first byte after them (from the start of the object)
+  [[nodiscard]] bool decode_serial_descs(
+    const std::vector<serial_field_desc_t>& serial_descs, uint32_t descs_end, CSystemSerCtx& serctx,
+    std::vector<CFieldDesc>& field_descs, std::vector<serial_data_desc_t>& data_descs) const
+  {
+    auto& strpool = serctx.strpool;
 
-    std::vector<CFieldDesc> field_descs(serial_descs.size());
-    std::vector<data_desc_t> data_descs(serial_descs.size());
+    field_descs.resize(serial_descs.size());
+    data_descs.resize(serial_descs.size());
 
     uint32_t prev_offset = 0;
     for (size_t i = 0, n = serial_descs.size(); i < n; ++i)
@@ -239,7 +339,7 @@ public:
         return false;
       if (sdesc.ctypename_idx >= strpool.size())
         return false;
-      if (sdesc.data_offset < data_pos - start_pos)
+      if (sdesc.data_offset < descs_end)
         return false;
       if (sdesc.data_offset < prev_offset)
         return false;
@@ -258,119 +358,409 @@ public:
       }
     }
 
-    //if (!m_blueprint->register_partial_field_descs(field_descs))
-    //  return false;
+    return true;
+  }
+
+  // classes missing from the db take the fields they are serialized with
+  // (see CObjectBPList::learn_fields), fields must then be reset
+  void learn_serial_fields(const std::vector<CFieldDesc>& field_descs)
+  {
+    if (m_blueprint->is_learnable())
+      m_blueprint = CObjectBPList::get().learn_fields(m_blueprint, field_descs);
+  }
+
+  // index of the field in m_fields (built from the bp), npos if none
+  uint32_t field_index(gname field_name) const
+  {
+    const uint32_t idx = m_blueprint->field_index(field_name);
+    if (idx < m_fields.size() && m_fields[idx].name == field_name)
+      return idx;
+    return CObjectBP::npos;
+  }
+
+  // finds the field index of the i-th serialized field, serialized fields are
+  // expected in the order of the bp's (prev_field_idx is the last one found).
+  // throws if there is none.
+  uint32_t find_serial_field_idx(size_t i, const CFieldDesc& fdesc, size_t& prev_field_idx, CSystemSerCtx& serctx) const
+  {
+    const uint32_t field_idx = m_blueprint->field_index(fdesc.name);
+
+    // (allow for unordered, but the reserialization tests will fail)
+    if (field_idx != CObjectBP::npos)
+    {
+      if (field_idx < prev_field_idx)
+        serctx.trace(ESerTraceEvent::field_in_out_of_order, this->ctypename(), 0, fdesc.name, fdesc.ctypename, (uint32_t)i);
+      else
+        prev_field_idx = field_idx;
+    }
+
+    if (field_idx == CObjectBP::npos)
+    {
+      // todo: replace with logging
+      throw std::runtime_error(
+        fmt::format(
+          "CObject::serialize_in: serial field {}::{} is missing from bp fields",
+          this->ctypename().c_str(), fdesc.name.c_str())
+      );
+    }
+
+    return field_idx;
+  }
+
+  // same, throws if the field has another type. its prop is created.
+  field_t& find_serial_field(size_t i, const CFieldDesc& fdesc, size_t& prev_field_idx, CSystemSerCtx& serctx)
+  {
+    auto& field = m_fields[find_serial_field_idx(i, fdesc, prev_field_idx, serctx)];
+    if (field_ctypename(field) != fdesc.ctypename)
+    {
+      // todo: replace with logging
+      throw std::runtime_error(
+        fmt::format(
+          "CObject::serialize_in: serial field {} has different type ({}) than bp's ({})",
+          fdesc.name.c_str(), fdesc.ctypename.c_str(), field_ctypename(field).c_str())
+      );
+    }
+
+    field_prop(field);
+    return field;
+  }
+
+  uint16_t serialized_fields_count() const
+  {
+    uint16_t fields_cnt = 0;
+
+    for (auto& field : m_fields)
+    {
+      // pending ones are written back as they were read
+      if (field.pending != CObjectBP::npos)
+      {
+        fields_cnt++;
+        continue;
+      }
+
+      // the magical thingy (never created props are skippable)
+      if (!field.prop || field.prop->is_skippable_in_serialization())
+        continue;
+
+      fields_cnt++;
+    }
+
+    return fields_cnt;
+  }
+
+public:
+  // blobs are read through the span_reader path, without streams
+  [[nodiscard]] bool serialize_in(std::span<const char> blob, CSystemSerCtx& serctx)
+  {
+    span_reader reader(blob);
+
+    if (!serialize_in(reader, serctx, true))
+      return false;
+
+    return reader.good() && reader.at_end();
+  }
+
+  // eof_is_end_of_object allows for last property to be an unknown one (greedy read)
+  // callers should check if object has been serialized completely ! (array props, system..)
+  [[nodiscard]] bool serialize_in(std::istream& is, CSystemSerCtx& serctx, bool eof_is_end_of_object=false)
+  {
+    m_lazy.reset();
+
+    uint32_t start_pos = (uint32_t)is.tellg();
+
+    // m_fields cnt
+    uint16_t serial_fields_cnt = 0;
+    is >> cbytes_ref(serial_fields_cnt);
+    if (serial_fields_cnt < 1)
+      return true;
+
+    // field descriptors
+    std::vector<serial_field_desc_t> serial_descs(serial_fields_cnt);
+    is.read((char*)serial_descs.data(), serial_fields_cnt * sizeof(serial_field_desc_t));
+    if (!is.good())
+      return false;
+
+    uint32_t data_pos = (uint32_t)is.tellg();
+
+    std::vector<CFieldDesc> field_descs;
+    std::vector<serial_data_desc_t> data_descs;
+    if (!decode_serial_descs(serial_descs, data_pos - start_pos, serctx, field_descs, data_descs))
+      return false;
+
+    learn_serial_fields(field_descs);
 
     reset_fields_from_bp();
 
     // ideally doing it in reverse order would catch failures earlier (unknown prop with unknown end)
     // but it would also reverse the order of appearance in the log
 
-    //auto field_it = m_fields.begin();
-    auto prev_field_it = m_fields.begin();
+    size_t prev_field_idx = 0;
     for (size_t i = 0; i < serial_fields_cnt; ++i)
     {
       auto& fdesc = field_descs[i];
       auto& ddesc = data_descs[i];
 
-      // search for field
-      auto field_it(prev_field_it);
-      while (field_it != m_fields.end() && field_it->name != fdesc.name)
-        ++field_it;
+      auto& field = find_serial_field(i, fdesc, prev_field_idx, serctx);
 
-      // (allow for unordered, but the reserialization tests will fail)
-      if (field_it == m_fields.end())
+      if (i + 1 < serial_fields_cnt)
       {
-        field_it = m_fields.begin();
-        while (field_it != m_fields.end() && field_it->name != fdesc.name)
-          ++field_it;
-        if (field_it != m_fields.end())
-        {
-          serctx.log(fmt::format(
-            "serialized_in ({}) out of order {}::{} (ctype:{})",
-            i, this->ctypename().c_str(), fdesc.name.c_str(), fdesc.ctypename.c_str()));
-        }
+        isubstreambuf sbuf(is.rdbuf(), start_pos + ddesc.data_offset, ddesc.data_size);
+        std::istream isubs(&sbuf);
+
+        if (!serialize_field(field, isubs, serctx, true))
+          return false;
       }
-      else
+      else 
       {
-        prev_field_it = field_it;
+        is.seekg(start_pos + ddesc.data_offset);
+        if (!serialize_field(field, is, serctx, eof_is_end_of_object))
+          return false;
+        break;
       }
 
-      if (field_it == m_fields.end())
+      serctx.trace(ESerTraceEvent::field_in, this->ctypename(), ddesc.data_size, fdesc.name, fdesc.ctypename, (uint32_t)i);
+    }
+
+    if (serctx.is_tracing())
+    {
+      if (is.eof()) // tellg would fail if eofbit is set
+        is.seekg(0, std::ios_base::end);
+      uint32_t end_pos = (uint32_t)is.tellg();
+
+      serctx.trace(ESerTraceEvent::object_in, this->ctypename(), end_pos - start_pos);
+    }
+
+    post_cobject_event(EObjectEvent::data_modified);
+    return true;
+  }
+
+  // same as the stream version, fields are read from subreaders of the blob
+  [[nodiscard]] bool serialize_in(span_reader& reader, CSystemSerCtx& serctx, bool eof_is_end_of_object=false)
+  {
+    m_lazy.reset();
+
+    const size_t start_pos = reader.tell();
+
+    // m_fields cnt
+    uint16_t serial_fields_cnt = 0;
+    reader.read(serial_fields_cnt);
+    if (serial_fields_cnt < 1)
+      return true;
+
+    // field descriptors
+    std::vector<serial_field_desc_t> serial_descs(serial_fields_cnt);
+    if (!reader.read_bytes(serial_descs.data(), serial_fields_cnt * sizeof(serial_field_desc_t)))
+      return false;
+
+    std::vector<CFieldDesc> field_descs;
+    std::vector<serial_data_desc_t> data_descs;
+    if (!decode_serial_descs(serial_descs, (uint32_t)(reader.tell() - start_pos), serctx, field_descs, data_descs))
+      return false;
+
+    learn_serial_fields(field_descs);
+    reset_fields_from_bp();
+
+    size_t prev_field_idx = 0;
+    for (size_t i = 0; i < serial_fields_cnt; ++i)
+    {
+      auto& fdesc = field_descs[i];
+      auto& ddesc = data_descs[i];
+
+      auto& field = find_serial_field(i, fdesc, prev_field_idx, serctx);
+
+      if (i + 1 < serial_fields_cnt)
       {
-        bool a = false;
-        // todo: replace with logging
-        throw std::runtime_error(
-          fmt::format(
-            "CObject::serialize_in: serial field {}::{} is missing from bp fields",
-            this->ctypename().c_str(), fdesc.name.c_str())
-        );
-        return false;
+        span_reader subreader = reader.subreader(start_pos + ddesc.data_offset, ddesc.data_size);
+        if (!serialize_field(field, subreader, serctx, true))
+          return false;
+      }
+      else
+      {
+        if (!reader.seek(start_pos + ddesc.data_offset))
+          return false;
+        if (!serialize_field(field, reader, serctx, eof_is_end_of_object))
+          return false;
+        break;
       }
 
-      if (field_it->prop->ctypename() != fdesc.ctypename)
+      serctx.trace(ESerTraceEvent::field_in, this->ctypename(), ddesc.data_size, fdesc.name, fdesc.ctypename, (uint32_t)i);
+    }
+
+    serctx.trace(ESerTraceEvent::object_in, this->ctypename(), reader.tell() - start_pos);
+
+    post_cobject_event(EObjectEvent::data_modified);
+    return true;
+  }
+
+  // lazy mode: only the field descriptors are read, fields are decoded when
+  // first accessed (get_prop, widgets) and the ones never accessed are
+  // written back raw. the blob must be the whole serialized object, in
+  // loaddata->objdata. throws like serialize_in on unexpected fields.
+  [[nodiscard]] bool serialize_in_lazy(std::span<const char> blob, CSystemSerCtx& serctx, const std::shared_ptr<CSystemLoadData>& loaddata)
+  {
+    m_lazy.reset();
+
+    span_reader reader(blob);
+
+    // m_fields cnt
+    uint16_t serial_fields_cnt = 0;
+    reader.read(serial_fields_cnt);
+    if (serial_fields_cnt < 1)
+      return reader.good() && reader.at_end();
+
+    // field descriptors
+    std::vector<serial_field_desc_t> serial_descs(serial_fields_cnt);
+    if (!reader.read_bytes(serial_descs.data(), serial_fields_cnt * sizeof(serial_field_desc_t)))
+      return false;
+
+    std::vector<CFieldDesc> field_descs;
+    std::vector<serial_data_desc_t> data_descs;
+    if (!decode_serial_descs(serial_descs, (uint32_t)reader.tell(), serctx, field_descs, data_descs))
+      return false;
+
+    learn_serial_fields(field_descs);
+
+    // the last field extends to the end of the blob (offsets are ordered)
+    auto& last_ddesc = data_descs.back();
+    if (last_ddesc.data_offset > blob.size())
+      return false;
+    last_ddesc.data_size = (uint32_t)(blob.size() - last_ddesc.data_offset);
+
+    auto lazy = std::make_unique<lazy_state_t>();
+    lazy->loaddata = loaddata;
+    lazy->blob = blob;
+    lazy->fields.reserve(serial_fields_cnt);
+
+    const auto& field_bps = m_blueprint->field_bps();
+    size_t prev_field_idx = 0;
+    for (size_t i = 0; i < serial_fields_cnt; ++i)
+    {
+      auto& fdesc = field_descs[i];
+      auto& ddesc = data_descs[i];
+
+      const uint32_t field_idx = find_serial_field_idx(i, fdesc, prev_field_idx, serctx);
+      if (field_bps[field_idx].ctypename() != fdesc.ctypename)
       {
         // todo: replace with logging
         throw std::runtime_error(
           fmt::format(
             "CObject::serialize_in: serial field {} has different type ({}) than bp's ({})",
-            fdesc.name.c_str(), fdesc.ctypename.c_str(), field_it->prop->ctypename().c_str())
+            fdesc.name.c_str(), fdesc.ctypename.c_str(), field_bps[field_idx].ctypename().c_str())
         );
-        return false;
       }
 
-      if (i + 1 < serial_fields_cnt)
-      {
-        isubstreambuf sbuf(is.rdbuf(), start_pos + ddesc.data_offset, ddesc.data_size);
-        std::istream isubs(&sbuf);
+      lazy->fields.push_back({field_idx, ddesc.data_offset, ddesc.data_size});
+    }
 
-        if (!serialize_field(*field_it, isubs, serctx, true))
-          return false;
-      }
-      else 
-      {
-        is.seekg(start_pos + ddesc.data_offset);
-        if (!serialize_field(*field_it, is, serctx, eof_is_end_of_object))
-          return false;
-        break;
-      }
+    clear_fields();
+    m_lazy = std::move(lazy);
+
+    serctx.trace(ESerTraceEvent::object_in_lazy, this->ctypename(), blob.size());
+    return true;
+  }
+
+  bool has_pending_fields() const { return m_lazy != nullptr; }
+
+  // decodes the pending fields, false if some couldn't be
+  bool decode_lazy_fields() const
+  {
+    if (!m_lazy)
+      return true;
+
+    auto nc_this = const_cast<CObject*>(this);
+    nc_this->materialize_lazy_fields();
 
-      serctx.log(fmt::format(
-        "serialized_in ({}) {}::{} (ctype:{}) in {} bytes",
-        i, this->ctypename().c_str(), fdesc.name.c_str(), fdesc.ctypename.c_str(), ddesc.data_size));
+    bool success = true;
+    for (auto& field : nc_this->m_fields)
+    {
+      if (field.pending != CObjectBP::npos)
+        success &= nc_this->decode_lazy_field(field);
     }
+    return success;
+  }
 
-    if (is.eof()) // tellg would fail if eofbit is set
-      is.seekg(0, std::ios_base::end);
-    uint32_t end_pos = (uint32_t)is.tellg();
+protected:
+  // builds the fields from the bp, serialized ones are pending
+  void materialize_lazy_fields()
+  {
+    if (!m_lazy || m_lazy->materialized)
+      return;
 
-    serctx.log(fmt::format("serialized_in CObject {} in {} bytes", this->ctypename().c_str(), (size_t)(end_pos - start_pos)));
+    reset_fields_from_bp();
 
-    post_cobject_event(EObjectEvent::data_modified);
+    auto& lazy = *m_lazy;
+    for (uint32_t i = 0; i < (uint32_t)lazy.fields.size(); ++i)
+    {
+      // a field serialized twice is decoded from its last occurrence
+      auto& field = m_fields[lazy.fields[i].field_idx];
+      if (field.pending == CObjectBP::npos)
+        lazy.pending_cnt++;
+      field.pending = i;
+    }
+
+    lazy.materialized = true;
+  }
+
+  [[nodiscard]] bool decode_lazy_field(field_t& field)
+  {
+    auto& lazy = *m_lazy;
+    auto& lfield = lazy.fields[field.pending];
+    if (lfield.failed)
+      return false;
+
+    const uint32_t serial_idx = field.pending;
+    field_prop(field);
+    const bool decoded = lazy.loaddata->with_serctx([&](CSystemSerCtx& serctx) {
+      span_reader reader(lazy.blob.subspan(lfield.data_offset, lfield.data_size));
+
+      m_lazy_decoding = true;
+      const bool success = serialize_field(field, reader, serctx, true);
+      m_lazy_decoding = false;
+
+      if (success)
+        serctx.trace(ESerTraceEvent::field_in, this->ctypename(), lfield.data_size, field.name, field.prop->ctypename(), serial_idx);
+      return success;
+    });
+
+    if (!decoded)
+    {
+      // the raw data is kept, the prop could have been partially read
+      lfield.failed = true;
+      field.prop = m_blueprint->field_bps()[lfield.field_idx].create_prop(this);
+      return false;
+    }
+
+    field.pending = CObjectBP::npos;
+    if (--lazy.pending_cnt == 0)
+      m_lazy.reset();
     return true;
   }
 
+  std::span<const char> pending_field_data(const field_t& field) const
+  {
+    const auto& lfield = m_lazy->fields[field.pending];
+    return m_lazy->blob.subspan(lfield.data_offset, lfield.data_size);
+  }
+
+public:
+
   [[nodiscard]] bool serialize_out(std::ostream& os, CSystemSerCtx& serctx) const
   {
     auto& strpool = serctx.strpool;
 
     auto start_pos = os.tellp();
 
-    // m_fields cnt
-    uint16_t fields_cnt = 0;
-
-    for (auto& field : m_fields)
+    // never accessed since serialize_in_lazy
+    if (m_lazy && !m_lazy->materialized)
     {
-      if (!field.prop)
-        throw std::runtime_error("null property field");
-
-      // the magical thingy
-      if (field.prop->is_skippable_in_serialization())
-        continue;
-
-      fields_cnt++;
+      os.write(m_lazy->blob.data(), m_lazy->blob.size());
+      serctx.trace(ESerTraceEvent::object_out, this->ctypename(), m_lazy->blob.size());
+      return true;
     }
 
+    // m_fields cnt
+    uint16_t fields_cnt = serialized_fields_count();
+
     os << cbytes_ref(fields_cnt);
     if (!fields_cnt)
       return true;
@@ -389,7 +779,8 @@ public:
     for (auto& field : m_fields)
     {
       // the magical thingy again
-      if (field.prop->is_skippable_in_serialization())
+      const bool is_pending = field.pending != CObjectBP::npos;
+      if (!is_pending && (!field.prop || field.prop->is_skippable_in_serialization()))
         continue;
 
       size_t prop_start_pos = (size_t)os.tellp();
@@ -397,19 +788,26 @@ public:
       const uint32_t data_offset = (uint32_t)(prop_start_pos - start_pos);
       descs.emplace_back(
         strpool.to_idx(field.name.c_str()),
-        strpool.to_idx(field.prop->ctypename().c_str()),
+        strpool.to_idx(field_ctypename(field).c_str()),
         data_offset
       );
 
-      if (!field.prop->serialize_out(os, serctx))
+      if (is_pending)
       {
-        serctx.log(fmt::format("couldn't serialize_out {}::{}", this->ctypename().c_str(), field.name.c_str()));
+        const auto data = pending_field_data(field);
+        os.write(data.data(), data.size());
+      }
+      else if (!field.prop->serialize_out(os, serctx))
+      {
+        serctx.trace(ESerTraceEvent::field_out_failed, this->ctypename(), 0, field.name, field.prop->ctypename());
         return false;
       }
 
-      size_t prop_end_pos = (size_t)os.tellp();
-
-      serctx.log(fmt::format("serialized_out {}::{} in {} bytes", this->ctypename().c_str(), field.name.c_str(), prop_end_pos - prop_start_pos));
+      if (serctx.is_tracing())
+      {
+        size_t prop_end_pos = (size_t)os.tellp();
+        serctx.trace(ESerTraceEvent::field_out, this->ctypename(), prop_end_pos - prop_start_pos, field.name, field_ctypename(field));
+      }
     }
 
     auto end_pos = os.tellp();
@@ -418,12 +816,78 @@ public:
     os.seekp(descs_pos);
     os.write((char*)descs.data(), descs.size() * sizeof(serial_field_desc_t));
 
-    serctx.log(fmt::format("serialized_out CObject {} in {} bytes", this->ctypename().c_str(), (size_t)(end_pos - start_pos)));
+    serctx.trace(ESerTraceEvent::object_out, this->ctypename(), (size_t)(end_pos - start_pos));
 
     os.seekp(end_pos);
     return true;
   }
 
+  [[nodiscard]] bool serialize_out(vector_writer& writer, CSystemSerCtx& serctx) const
+  {
+    auto& strpool = serctx.strpool;
+
+    const size_t start_pos = writer.tell();
+
+    // never accessed since serialize_in_lazy
+    if (m_lazy && !m_lazy->materialized)
+    {
+      writer.write_bytes(m_lazy->blob.data(), m_lazy->blob.size());
+      serctx.trace(ESerTraceEvent::object_out, this->ctypename(), m_lazy->blob.size());
+      return true;
+    }
+
+    // m_fields cnt
+    const uint16_t fields_cnt = serialized_fields_count();
+
+    writer.write(fields_cnt);
+    if (!fields_cnt)
+      return true;
+
+    // descriptors are patched once the data offsets are known
+    const size_t descs_pos = writer.tell();
+
+    serial_field_desc_t empty_desc {};
+    for (size_t i = 0; i < fields_cnt; ++i)
+      writer.write(empty_desc);
+
+    // m_fields (named props)
+    std::vector<serial_field_desc_t> descs;
+    descs.reserve(fields_cnt);
+    for (auto& field : m_fields)
+    {
+      const bool is_pending = field.pending != CObjectBP::npos;
+      if (!is_pending && (!field.prop || field.prop->is_skippable_in_serialization()))
+        continue;
+
+      const size_t prop_start_pos = writer.tell();
+
+      descs.emplace_back(
+        strpool.to_idx(field.name.c_str()),
+        strpool.to_idx(field_ctypename(field).c_str()),
+        (uint32_t)(prop_start_pos - start_pos)
+      );
+
+      if (is_pending)
+      {
+        const auto data = pending_field_data(field);
+        writer.write_bytes(data.data(), data.size());
+      }
+      else if (!field.prop->serialize_out(writer, serctx))
+      {
+        serctx.trace(ESerTraceEvent::field_out_failed, this->ctypename(), 0, field.name, field.prop->ctypename());
+        return false;
+      }
+
+      serctx.trace(ESerTraceEvent::field_out, this->ctypename(), writer.tell() - prop_start_pos, field.name, field_ctypename(field));
+    }
+
+    writer.patch_bytes(descs_pos, descs.data(), descs.size() * sizeof(serial_field_desc_t));
+
+    serctx.trace(ESerTraceEvent::object_out, this->ctypename(), writer.tell() - start_pos);
+
+    return true;
+  }
+
   // gui
 
 #ifndef DISABLE_CP_IMGUI_WIDGETS
@@ -449,6 +913,9 @@ public:
 
     bool modified = false;
 
+    // shows what is decodable, the rest stays pending
+    std::ignore = decode_lazy_fields();
+
     if (ctypename() == "WorldPosition"_gn)
     {
       return imgui_widget_wpos(label, editable);
@@ -480,9 +947,11 @@ public:
         ImGui::TableNextRow();
         ImGui::TableNextColumn();
 
+        auto prop = field_prop(field);
+
         if (show_field_types)
         {
-          auto field_type = field.prop->ctypename();
+          auto field_type = prop->ctypename();
           ImGui::Text(field_type.c_str());
 
           ImGui::TableNextColumn();
@@ -499,7 +968,6 @@ public:
 
         ImGui::TableNextColumn();
 
-        auto prop = field.prop.get();
         if (!prop->imgui_is_one_liner())
         {
           if (ImGui::TreeNodeEx((void*)prop, 0, "view value"))
@@ -514,7 +982,7 @@ public:
             ImGui::PushItemWidth(-FLT_MIN);
           else
             ImGui::PushItemWidth(ImGui::GetContentRegionAvailWidth() - 50);
-          modified |= field.prop->imgui_widget(field_name.c_str(), editable);
+          modified |= prop->imgui_widget(field_name.c_str(), editable);
         }
 
         ++i;
@@ -598,10 +1066,27 @@ protected:
 
   void on_cproperty_event(const CProperty& prop, EPropertyEvent evt) override
   {
+    if (m_lazy_decoding || m_events_muted)
+      return;
     post_cobject_event(EObjectEvent::data_modified);
   }
 
 public:
+  // runs fn, that edits fields of this object or of its sub-objects, without
+  // forwarding their events to the listeners of this object.
+  // a single data_modified event is posted after it if fn returns true.
+  template <class Fn>
+  void edit_batch(Fn&& fn)
+  {
+    const bool was_muted = m_events_muted;
+    m_events_muted = true;
+    const bool modified = fn();
+    m_events_muted = was_muted;
+
+    if (modified && !was_muted)
+      post_cobject_event(EObjectEvent::data_modified);
+  }
+
   // provided as const for ease of use
 
   void add_listener(CObjectListener* listener) const
@@ -50,6 +50,11 @@ public:
     return sname;
   };
 
+  void accumulate_memory_usage(cp::memory_usage& mu) const override
+  {
+    count_prop(mu, sizeof(*this));
+  }
+
   bool serialize_in_impl(std::istream& is, CSystemSerCtx& serctx) override
   {
     char val = 0;
@@ -58,6 +63,14 @@ public:
     return is.good();
   }
 
+  bool serialize_in_impl(span_reader& reader, CSystemSerCtx& serctx) override
+  {
+    char val = 0;
+    reader.read(val);
+    m_value = !!val;
+    return reader.good();
+  }
+
   virtual bool serialize_out(std::ostream& os, CSystemSerCtx& serctx) const
   {
     char val = m_value ? 1 : 0;
@@ -65,6 +78,12 @@ public:
     return true;
   }
 
+  bool serialize_out(vector_writer& writer, CSystemSerCtx& serctx) const override
+  {
+    writer.write<char>(m_value ? 1 : 0);
+    return true;
+  }
+
   bool value() const { return m_value; }
 
   void value(bool value)
@@ -186,6 +205,26 @@ public:
   uint16_t u16() const { return m_value.u16; }
   uint8_t u8() const { return m_value.u8; }
 
+  // sign-extended value of signed kinds
+  int64_t i64() const
+  {
+    switch (m_int_kind)
+    {
+      case EIntKind::I8: return m_value.i8;
+      case EIntKind::I16: return m_value.i16;
+      case EIntKind::I32: return m_value.i32;
+      case EIntKind::I64: return m_value.i64;
+      default: break;
+    }
+    return static_cast<int64_t>(u64());
+  }
+
+  bool is_signed() const
+  {
+    return m_int_kind == EIntKind::I8 || m_int_kind == EIntKind::I16
+      || m_int_kind == EIntKind::I32 || m_int_kind == EIntKind::I64;
+  }
+
   // todo: template this class..
 
   void u64(uint64_t value)
@@ -224,18 +263,34 @@ public:
     return m_ctypename;
   }
 
+  void accumulate_memory_usage(cp::memory_usage& mu) const override
+  {
+    count_prop(mu, sizeof(*this));
+  }
+
   bool serialize_in_impl(std::istream& is, CSystemSerCtx& serctx) override
   {
     is.read((char*)&m_value.u64, m_int_size);
     return is.good();
   }
 
+  bool serialize_in_impl(span_reader& reader, CSystemSerCtx& serctx) override
+  {
+    return reader.read_bytes(&m_value.u64, m_int_size);
+  }
+
   virtual bool serialize_out(std::ostream& os, CSystemSerCtx& serctx) const
   {
     os.write((char*)&m_value.u64, m_int_size);
     return true;
   }
 
+  bool serialize_out(vector_writer& writer, CSystemSerCtx& serctx) const override
+  {
+    writer.write_bytes(&m_value.u64, m_int_size);
+    return true;
+  }
+
 #ifndef DISABLE_CP_IMGUI_WIDGETS
 
   [[nodiscard]] bool imgui_widget_impl(const char* label, bool editable) override
@@ -293,6 +348,11 @@ public:
     return sname;
   };
 
+  void accumulate_memory_usage(cp::memory_usage& mu) const override
+  {
+    count_prop(mu, sizeof(*this));
+  }
+
   float value() const { return m_value; }
 
   void set_value(float value)
@@ -308,12 +368,23 @@ public:
     return is.good();
   }
 
+  bool serialize_in_impl(span_reader& reader, CSystemSerCtx& serctx) override
+  {
+    return reader.read(m_value);
+  }
+
   virtual bool serialize_out(std::ostream& os, CSystemSerCtx& serctx) const
   {
     os << cbytes_ref(m_value);
     return true;
   }
 
+  bool serialize_out(vector_writer& writer, CSystemSerCtx& serctx) const override
+  {
+    writer.write(m_value);
+    return true;
+  }
+
 #ifndef DISABLE_CP_IMGUI_WIDGETS
 
   [[nodiscard]] bool imgui_widget_impl(const char* label, bool editable) override
@@ -354,13 +425,20 @@ protected:
 
 public:
   CArrayProperty(CPropertyOwner* owner, gname elt_ctypename, size_t size)
+    : CArrayProperty(owner, elt_ctypename, size,
+        gname(fmt::format("[{}]{}", size, elt_ctypename.strv())),
+        CPropertyFactory::get().get_creator(elt_ctypename))
+  {
+  }
+
+  // used by the factory, which resolves the type names once per ctypename
+  CArrayProperty(CPropertyOwner* owner, gname elt_ctypename, size_t size, gname ctypename, std::function<CPropertyUPtr(CPropertyOwner*)> elt_create_fn)
     : CProperty(owner, EPropertyKind::DynArray)
     , m_elt_ctypename(elt_ctypename)
-    , m_typename(fmt::format("[{}]{}", size, elt_ctypename.strv()))
+    , m_typename(ctypename)
+    , m_elt_create_fn(std::move(elt_create_fn))
   {
     m_elts.resize(size);
-    auto& factory = CPropertyFactory::get();
-    m_elt_create_fn = factory.get_creator(elt_ctypename);
     for (auto& elt : m_elts)
     {
       // todo: use clone on first instance..
@@ -384,6 +462,13 @@ public:
 
   gname ctypename() const override { return m_typename; };
 
+  void accumulate_memory_usage(cp::memory_usage& mu) const override
+  {
+    count_prop(mu, sizeof(*this) + cp::heap_bytes(m_elts));
+    for (const auto& elt : m_elts)
+      elt->accumulate_memory_usage(mu);
+  }
+
   bool serialize_in_impl(std::istream& is, CSystemSerCtx& serctx) override
   {
     size_t start_pos = is.tellg();
@@ -401,12 +486,37 @@ public:
         return false;
     }
 
-    size_t end_pos = is.tellg();
-    serctx.log(fmt::format("serialized_in {} in {} bytes", this->ctypename().strv(), (size_t)(end_pos - start_pos)));
+    if (serctx.is_tracing())
+    {
+      size_t end_pos = is.tellg();
+      serctx.trace(ESerTraceEvent::prop_in, this->ctypename(), end_pos - start_pos);
+    }
 
     return is.good();
   }
 
+  bool serialize_in_impl(span_reader& reader, CSystemSerCtx& serctx) override
+  {
+    size_t start_pos = reader.tell();
+
+    uint32_t uk = 0;
+    reader.read(uk);
+    if (uk != m_elts.size())
+      throw std::logic_error("CArrayProperty: false assumption #1. please open an issue");
+
+    for (auto& elt : m_elts)
+    {
+      if (elt->kind() == EPropertyKind::Unknown)
+        return false;
+      if (!elt->serialize_in(reader, serctx))
+        return false;
+    }
+
+    serctx.trace(ESerTraceEvent::prop_in, this->ctypename(), reader.tell() - start_pos);
+
+    return reader.good();
+  }
+
   virtual [[nodiscard]] bool serialize_out(std::ostream& os, CSystemSerCtx& serctx) const
   {
     size_t start_pos = os.tellp();
@@ -420,8 +530,28 @@ public:
         return false;
     }
 
-    size_t end_pos = os.tellp();
-    serctx.log(fmt::format("serialized_in {} in {} bytes", this->ctypename().c_str(), (size_t)(end_pos - start_pos)));
+    if (serctx.is_tracing())
+    {
+      size_t end_pos = os.tellp();
+      serctx.trace(ESerTraceEvent::prop_out, this->ctypename(), end_pos - start_pos);
+    }
+
+    return true;
+  }
+
+  [[nodiscard]] bool serialize_out(vector_writer& writer, CSystemSerCtx& serctx) const override
+  {
+    size_t start_pos = writer.tell();
+
+    writer.write((uint32_t)m_elts.size());
+
+    for (auto& elt : m_elts)
+    {
+      if (!elt->serialize_out(writer, serctx))
+        return false;
+    }
+
+    serctx.trace(ESerTraceEvent::prop_out, this->ctypename(), writer.tell() - start_pos);
 
     return true;
   }
@@ -518,12 +648,19 @@ protected:
 
 public:
   CDynArrayProperty(CPropertyOwner* owner, gname elt_ctypename)
+    : CDynArrayProperty(owner, elt_ctypename,
+        gname(std::string("array:") + elt_ctypename.c_str()),
+        CPropertyFactory::get().get_creator(elt_ctypename))
+  {
+  }
+
+  // used by the factory, which resolves the type names once per ctypename
+  CDynArrayProperty(CPropertyOwner* owner, gname elt_ctypename, gname ctypename, std::function<CPropertyUPtr(CPropertyOwner*)> elt_create_fn)
     : CProperty(owner, EPropertyKind::DynArray)
     , m_elt_ctypename(elt_ctypename)
-    , m_ctypename(std::string("array:") + elt_ctypename.c_str())
+    , m_ctypename(ctypename)
+    , m_elt_create_fn(std::move(elt_create_fn))
   {
-    auto& factory = CPropertyFactory::get();
-    m_elt_create_fn = factory.get_creator(elt_ctypename);
   }
 
 public:
@@ -549,6 +686,13 @@ public:
 
   gname ctypename() const override { return m_ctypename; };
 
+  void accumulate_memory_usage(cp::memory_usage& mu) const override
+  {
+    count_prop(mu, sizeof(*this) + cp::heap_bytes(m_elts));
+    for (const auto& elt : m_elts)
+      elt->accumulate_memory_usage(mu);
+  }
+
   bool serialize_in_impl(std::istream& is, CSystemSerCtx& serctx) override
   {
     m_elts.clear();
@@ -571,6 +715,28 @@ public:
     return is.good();
   }
 
+  bool serialize_in_impl(span_reader& reader, CSystemSerCtx& serctx) override
+  {
+    m_elts.clear();
+
+    uint32_t cnt = 0;
+    if (!reader.read(cnt))
+      return false;
+
+    m_elts.resize(cnt);
+
+    for (auto& elt : m_elts)
+    {
+      elt = m_elt_create_fn(this);
+      if (elt->kind() == EPropertyKind::Unknown)
+        return false;
+      if (!elt->serialize_in(reader, serctx))
+        return false;
+    }
+
+    return reader.good();
+  }
+
   virtual bool serialize_out(std::ostream& os, CSystemSerCtx& serctx) const
   {
     uint32_t cnt = (uint32_t)m_elts.size();
@@ -585,6 +751,19 @@ public:
     return true;
   }
 
+  bool serialize_out(vector_writer& writer, CSystemSerCtx& serctx) const override
+  {
+    writer.write((uint32_t)m_elts.size());
+
+    for (auto& elt : m_elts)
+    {
+      if (!elt->serialize_out(writer, serctx))
+        return false;
+    }
+
+    return true;
+  }
+
 #ifndef DISABLE_CP_IMGUI_WIDGETS
 
   [[nodiscard]] bool imgui_widget_impl(const char* label, bool editable) override
@@ -711,7 +890,7 @@ public:
   CObjectProperty(CPropertyOwner* owner, gname obj_ctypename)
     : CProperty(owner, EPropertyKind::Object), m_obj_ctypename(obj_ctypename)
   {
-    m_object = std::make_shared<CObject>(m_obj_ctypename);
+    m_object = CObject::create(m_obj_ctypename);
     m_object->add_listener(this);
   }
 
@@ -727,16 +906,33 @@ public:
 
   gname ctypename() const override { return m_obj_ctypename; };
 
+  void accumulate_memory_usage(cp::memory_usage& mu) const override
+  {
+    count_prop(mu, sizeof(*this));
+    if (m_object)
+      m_object->accumulate_memory_usage(mu);
+  }
+
   bool serialize_in_impl(std::istream& is, CSystemSerCtx& serctx) override
   {
     return m_object->serialize_in(is, serctx) && is.good();
   }
 
+  bool serialize_in_impl(span_reader& reader, CSystemSerCtx& serctx) override
+  {
+    return m_object->serialize_in(reader, serctx) && reader.good();
+  }
+
   virtual bool serialize_out(std::ostream& os, CSystemSerCtx& serctx) const
   {
     return m_object->serialize_out(os, serctx);
   }
 
+  bool serialize_out(vector_writer& writer, CSystemSerCtx& serctx) const override
+  {
+    return m_object->serialize_out(writer, serctx);
+  }
+
 #ifndef DISABLE_CP_IMGUI_WIDGETS
 
   [[nodiscard]] bool imgui_widget_impl(const char* label, bool editable) override
@@ -803,16 +999,11 @@ public:
     bool success = false;
     if (name != m_val_name)
     {
-      auto& enum_members = m_enum_desc->members();
-      for (size_t i = 0; i < enum_members.size(); ++i)
+      if (auto ref = m_enum_desc->find_member(name))
       {
-        if (enum_members[i].name() == name)
-        {
-          m_bp_index = (uint32_t)i;
-          m_val_name = name;
-          success = true;
-          break;
-        }
+        m_bp_index = ref.idx;
+        m_val_name = name;
+        success = true;
       }
     }
     // whatever happens.. because we don't really know the default values
@@ -839,42 +1030,69 @@ public:
 
   gname ctypename() const override { return m_enum_name; };
 
+  void accumulate_memory_usage(cp::memory_usage& mu) const override
+  {
+    count_prop(mu, sizeof(*this));
+  }
+
   bool serialize_in_impl(std::istream& is, CSystemSerCtx& serctx) override
   {
     uint16_t strpool_idx = 0;
     is >> cbytes_ref(strpool_idx);
+    return set_value_from_strpool(strpool_idx, serctx) && is.good();
+  }
+
+  bool serialize_in_impl(span_reader& reader, CSystemSerCtx& serctx) override
+  {
+    uint16_t strpool_idx = 0;
+    reader.read(strpool_idx);
+    return set_value_from_strpool(strpool_idx, serctx) && reader.good();
+  }
+
+  virtual bool serialize_out(std::ostream& os, CSystemSerCtx& serctx) const
+  {
+    uint16_t strpool_idx = value_strpool_idx(serctx);
+    os << cbytes_ref(strpool_idx);
+    return true;
+  }
+
+  bool serialize_out(vector_writer& writer, CSystemSerCtx& serctx) const override
+  {
+    writer.write(value_strpool_idx(serctx));
+    return true;
+  }
+
+protected:
+  bool set_value_from_strpool(uint16_t strpool_idx, CSystemSerCtx& serctx)
+  {
     if (strpool_idx >= serctx.strpool.size())
       return false;
-    m_val_name = gname(serctx.strpool.from_idx(strpool_idx));
-    auto& enum_members = m_enum_desc->members();
-    m_bp_index = (uint32_t)enum_members.size();
-    for (size_t i = 0; i < enum_members.size(); ++i)
-    {
-      if (enum_members[i].name() == m_val_name)
-      {
-        m_bp_index = (uint32_t)i;
-        break;
-      }
-    }
-    if (m_bp_index == enum_members.size())
+
+    // the pool already has the hash, known values don't touch the global gname pool
+    const auto sv = serctx.strpool.view_from_idx(strpool_idx);
+    if (auto ref = m_enum_desc->find_member(sv, serctx.strpool.hash_from_idx(strpool_idx)))
     {
-      // TODO: Ensure the db is correct to avoid this. The value is unknown..
-      enum_members.emplace_back(m_val_name, 0);
+      m_bp_index = ref.idx;
+      m_val_name = ref.name;
+      return true;
     }
 
-    return is.good();
+    // TODO: Ensure the db is correct to avoid this. The value is unknown..
+    m_val_name = gname(sv);
+    m_bp_index = m_enum_desc->add_unknown_member(m_val_name);
+    return true;
   }
 
-  virtual bool serialize_out(std::ostream& os, CSystemSerCtx& serctx) const
+  uint16_t value_strpool_idx(CSystemSerCtx& serctx) const
   {
     if (m_val_name == "<no_zero_name>"_gn)
       throw std::logic_error("enum value must be skipped, 0 has no gname");
 
-    uint16_t strpool_idx = serctx.strpool.to_idx(m_val_name.strv());
-    os << cbytes_ref(strpool_idx);
-    return true;
+    return serctx.strpool.to_idx(m_val_name.strv());
   }
 
+public:
+
 #ifndef DISABLE_CP_IMGUI_WIDGETS
 
   static bool enum_name_getter(void* data, int idx, const char** out_str)
@@ -932,6 +1150,12 @@ public:
   ~CTweakDBIDProperty() override = default;
 
 public:
+  void set_id(TweakDBID id)
+  {
+    post_cproperty_event(EPropertyEvent::data_edited);
+    m_id = id;
+  }
+
   // overrides
 
   gname ctypename() const override
@@ -940,18 +1164,34 @@ public:
     return sname;
   };
 
+  void accumulate_memory_usage(cp::memory_usage& mu) const override
+  {
+    count_prop(mu, sizeof(*this));
+  }
+
   bool serialize_in_impl(std::istream& is, CSystemSerCtx& serctx) override
   {
     is >> cbytes_ref(m_id.as_u64);
     return is.good();
   }
 
+  bool serialize_in_impl(span_reader& reader, CSystemSerCtx& serctx) override
+  {
+    return reader.read(m_id.as_u64);
+  }
+
   virtual bool serialize_out(std::ostream& os, CSystemSerCtx& serctx) const
   {
     os << cbytes_ref(m_id.as_u64);
     return true;
   }
 
+  bool serialize_out(vector_writer& writer, CSystemSerCtx& serctx) const override
+  {
+    writer.write(m_id.as_u64);
+    return true;
+  }
+
 #ifndef DISABLE_CP_IMGUI_WIDGETS
 
   [[nodiscard]] bool imgui_widget_impl(const char* label, bool editable) override
@@ -981,6 +1221,8 @@ public:
   ~CNameProperty() override = default;
 
 public:
+  CName value() const { return m_id; }
+
   // overrides
 
   gname ctypename() const override
@@ -989,6 +1231,11 @@ public:
     return sname;
   };
 
+  void accumulate_memory_usage(cp::memory_usage& mu) const override
+  {
+    count_prop(mu, sizeof(*this));
+  }
+
   bool serialize_in_impl(std::istream& is, CSystemSerCtx& serctx) override
   {
     uint16_t strpool_idx = 0;
@@ -996,7 +1243,17 @@ public:
     if (!is.good() || strpool_idx >= serctx.strpool.size())
       return false;
 
-    m_id = CName(serctx.strpool.from_idx(strpool_idx));
+    m_id = CName::hash_first(serctx.strpool.view_from_idx(strpool_idx), serctx.strpool.hash_from_idx(strpool_idx));
+    return true;
+  }
+
+  bool serialize_in_impl(span_reader& reader, CSystemSerCtx& serctx) override
+  {
+    uint16_t strpool_idx = 0;
+    if (!reader.read(strpool_idx) || strpool_idx >= serctx.strpool.size())
+      return false;
+
+    m_id = CName::hash_first(serctx.strpool.view_from_idx(strpool_idx), serctx.strpool.hash_from_idx(strpool_idx));
     return true;
   }
 
@@ -1007,6 +1264,12 @@ public:
     return true;
   }
 
+  bool serialize_out(vector_writer& writer, CSystemSerCtx& serctx) const override
+  {
+    writer.write(serctx.strpool.to_idx(m_id.gstr().strv()));
+    return true;
+  }
+
 #ifndef DISABLE_CP_IMGUI_WIDGETS
 
   [[nodiscard]] bool imgui_widget_impl(const char* label, bool editable) override
@@ -1031,31 +1294,55 @@ protected:
 
 public:
   CRaRefProperty(CPropertyOwner* owner, gname sub_ctypename)
+    : CRaRefProperty(owner, sub_ctypename, gname(std::string("raRef:") + sub_ctypename.c_str()))
+  {
+  }
+
+  CRaRefProperty(CPropertyOwner* owner, gname sub_ctypename, gname ctypename)
     : CProperty(owner, EPropertyKind::RaRef)
     , m_base_ctypename(sub_ctypename)
-    , m_ctypename(std::string("raRef:") + m_base_ctypename.c_str())
+    , m_ctypename(ctypename)
   {
   }
 
   ~CRaRefProperty() override = default;
 
 public:
+  uint16_t ref() const { return m_ref; }
+
   // overrides
 
   gname ctypename() const override { return m_ctypename; }
 
+  void accumulate_memory_usage(cp::memory_usage& mu) const override
+  {
+    count_prop(mu, sizeof(*this));
+  }
+
   bool serialize_in_impl(std::istream& is, CSystemSerCtx& serctx) override
   {
     is >> cbytes_ref(m_ref);
     return true;
   }
 
+  bool serialize_in_impl(span_reader& reader, CSystemSerCtx& serctx) override
+  {
+    reader.read(m_ref);
+    return true;
+  }
+
   virtual bool serialize_out(std::ostream& os, CSystemSerCtx& serctx) const
   {
     os << cbytes_ref(m_ref);
     return true;
   }
 
+  bool serialize_out(vector_writer& writer, CSystemSerCtx& serctx) const override
+  {
+    writer.write(m_ref);
+    return true;
+  }
+
 #ifndef DISABLE_CP_IMGUI_WIDGETS
 
   [[nodiscard]] bool imgui_widget_impl(const char* label, bool editable) override
@@ -1086,6 +1373,8 @@ public:
   ~CCRUIDProperty() override = default;
 
 public:
+  uint64_t id() const { return m_id; }
+
   // overrides
 
   gname ctypename() const override
@@ -1094,18 +1383,34 @@ public:
     return sname;
   };
 
+  void accumulate_memory_usage(cp::memory_usage& mu) const override
+  {
+    count_prop(mu, sizeof(*this));
+  }
+
   bool serialize_in_impl(std::istream& is, CSystemSerCtx& serctx) override
   {
     is >> cbytes_ref(m_id);
     return is.good();
   }
 
+  bool serialize_in_impl(span_reader& reader, CSystemSerCtx& serctx) override
+  {
+    return reader.read(m_id);
+  }
+
   virtual bool serialize_out(std::ostream& os, CSystemSerCtx& serctx) const
   {
     os << cbytes_ref(m_id);
     return true;
   }
 
+  bool serialize_out(vector_writer& writer, CSystemSerCtx& serctx) const override
+  {
+    writer.write(m_id);
+    return true;
+  }
+
 #ifndef DISABLE_CP_IMGUI_WIDGETS
 
   [[nodiscard]] bool imgui_widget_impl(const char* label, bool editable) override
@@ -1141,9 +1446,14 @@ protected:
 
 public:
   CHandleProperty(CPropertyOwner* owner, gname sub_ctypename)
+    : CHandleProperty(owner, sub_ctypename, gname(std::string("handle:") + sub_ctypename.c_str()))
+  {
+  }
+
+  CHandleProperty(CPropertyOwner* owner, gname sub_ctypename, gname ctypename)
     : CProperty(owner, EPropertyKind::Handle)
     , m_base_ctypename(sub_ctypename)
-    , m_ctypename(std::string("handle:") + m_base_ctypename.c_str())
+    , m_ctypename(ctypename)
   {
     // let's not infinite loop...
     m_obj = nullptr; //std::make_shared<CObject>(m_base_ctypename);
@@ -1170,27 +1480,68 @@ public:
 
   gname ctypename() const override { return m_ctypename; }
 
+  // the pointed object is accounted by its system (handle objects)
+  void accumulate_memory_usage(cp::memory_usage& mu) const override
+  {
+    count_prop(mu, sizeof(*this));
+  }
+
   bool serialize_in_impl(std::istream& is, CSystemSerCtx& serctx) override
   {
     m_original_handle = 0;
     is >> cbytes_ref(m_original_handle);
+    return link_original_handle(serctx) && is.good();
+  }
+
+  bool serialize_in_impl(span_reader& reader, CSystemSerCtx& serctx) override
+  {
+    m_original_handle = 0;
+    reader.read(m_original_handle);
+    return link_original_handle(serctx) && reader.good();
+  }
+
+  virtual bool serialize_out(std::ostream& os, CSystemSerCtx& serctx) const
+  {
+    uint32_t handle = update_original_handle(serctx);
+    os << cbytes_ref(handle);
+    return true;
+  }
+
+  bool serialize_out(vector_writer& writer, CSystemSerCtx& serctx) const override
+  {
+    writer.write(update_original_handle(serctx));
+    return true;
+  }
+
+protected:
+  // links are deferred during parallel serialization (see CSystemSerCtx)
+  bool link_original_handle(CSystemSerCtx& serctx)
+  {
+    if (serctx.defers_handles())
+    {
+      if (!serctx.is_valid_handle(m_original_handle))
+        return false;
+      serctx.defer_handle(this, m_original_handle);
+      return true;
+    }
 
     auto new_obj = serctx.from_handle(m_original_handle);
     set_obj(new_obj);
 
-    return new_obj && is.good();
+    return !!new_obj;
   }
 
-  virtual bool serialize_out(std::ostream& os, CSystemSerCtx& serctx) const
+  uint32_t update_original_handle(CSystemSerCtx& serctx) const
   {
     if (!m_obj)
       throw std::runtime_error("can't serialize_out a null handle");
 
     const_cast<CHandleProperty*>(this)->m_original_handle = serctx.to_handle(m_obj);
-    os << cbytes_ref(m_original_handle);
-    return true;
+    return m_original_handle;
   }
 
+public:
+
 #ifndef DISABLE_CP_IMGUI_WIDGETS
 
   [[nodiscard]] bool imgui_widget_impl(const char* label, bool editable) override
@@ -1235,6 +1586,8 @@ public:
   ~CNodeRefProperty() override = default;
 
 public:
+  const std::string& str() const { return m_str; }
+
   // overrides
 
   gname ctypename() const override
@@ -1243,6 +1596,11 @@ public:
     return sname;
   };
 
+  void accumulate_memory_usage(cp::memory_usage& mu) const override
+  {
+    count_prop(mu, sizeof(*this) + cp::heap_bytes(m_str));
+  }
+
   bool serialize_in_impl(std::istream& is, CSystemSerCtx& serctx) override
   {
     uint16_t cnt = 0;
@@ -1253,6 +1611,16 @@ public:
     return is.good();
   }
 
+  bool serialize_in_impl(span_reader& reader, CSystemSerCtx& serctx) override
+  {
+    uint16_t cnt = 0;
+    m_str.clear();
+    if (!reader.read(cnt))
+      return false;
+    m_str.resize(cnt, '\0');
+    return reader.read_bytes(m_str.data(), cnt);
+  }
+
   virtual bool serialize_out(std::ostream& os, CSystemSerCtx& serctx) const
   {
     uint16_t cnt = (uint16_t)m_str.size();
@@ -1261,6 +1629,14 @@ public:
     return true;
   }
 
+  bool serialize_out(vector_writer& writer, CSystemSerCtx& serctx) const override
+  {
+    const uint16_t cnt = (uint16_t)m_str.size();
+    writer.write(cnt);
+    writer.write_bytes(m_str.data(), cnt);
+    return true;
+  }
+
 #ifndef DISABLE_CP_IMGUI_WIDGETS
 
   [[nodiscard]] bool imgui_widget_impl(const char* label, bool editable) override
@@ -1,10 +1,14 @@
 #include "cproperty_factory.hpp"
 
+#include <array>
 #include <string>
 #include <functional>
+#include <mutex>
 
+#include "cpinternals/common.hpp"
 #include "cpinternals/ctypes.hpp"
 #include "cproperty.hpp"
+#include "cproperty_packed.hpp"
 
 
 template <typename CPropType, typename ...Args>
@@ -15,9 +19,152 @@ std::function<CPropertyUPtr(CPropertyOwner*)> build_prop_creator(Args&& ...args)
   };
 }
 
+namespace {
+
+enum class EBasicType : uint8_t
+{
+  Bool,
+  U8, I8,
+  U16, I16,
+  U32, I32,
+  U64, I64,
+  Float,
+  TweakDBID,
+  CName,
+  CRUID,
+  NodeRef,
+  SavedStatsData,
+};
+
+struct basic_type_desc
+{
+  std::string_view name;
+  EBasicType type;
+};
+
+constexpr basic_type_desc basic_types[] = {
+  { "Bool",               EBasicType::Bool           },
+  { "Uint8",              EBasicType::U8             },
+  { "Int8",               EBasicType::I8             },
+  { "Uint16",             EBasicType::U16            },
+  { "Int16",              EBasicType::I16            },
+  { "Uint32",             EBasicType::U32            },
+  { "Int32",              EBasicType::I32            },
+  { "Uint64",             EBasicType::U64            },
+  { "Int64",              EBasicType::I64            },
+  { "Float",              EBasicType::Float          },
+  { "TweakDBID",          EBasicType::TweakDBID      },
+  { "CName",              EBasicType::CName          },
+  { "CRUID",              EBasicType::CRUID          },
+  { "NodeRef",            EBasicType::NodeRef        },
+  { "gameSavedStatsData", EBasicType::SavedStatsData },
+};
+
+constexpr size_t basic_types_cnt = sizeof(basic_types) / sizeof(basic_types[0]);
+
+// perfect hash: slot = (fnv1a64(name) >> basic_slot_shift) & (basic_slots_cnt - 1),
+// the shift is searched at compile time.
+constexpr size_t basic_slots_cnt = 64;
+constexpr uint8_t basic_slot_empty = 0xFF;
+
+constexpr size_t basic_slot(uint64_t hash, uint32_t shift)
+{
+  return static_cast<size_t>(hash >> shift) & (basic_slots_cnt - 1);
+}
+
+constexpr uint32_t find_basic_slot_shift()
+{
+  for (uint32_t shift = 0; shift <= 64 - 6; ++shift)
+  {
+    bool used[basic_slots_cnt] = {};
+    bool collision = false;
+    for (size_t i = 0; i < basic_types_cnt && !collision; ++i)
+    {
+      const size_t slot = basic_slot(cp::fnv1a64(basic_types[i].name), shift);
+      collision = used[slot];
+      used[slot] = true;
+    }
+    if (!collision)
+      return shift;
+  }
+  return 64;
+}
+
+constexpr uint32_t basic_slot_shift = find_basic_slot_shift();
+static_assert(basic_slot_shift < 64, "no perfect hash for the basic types, grow basic_slots_cnt");
+
+constexpr std::array<uint8_t, basic_slots_cnt> build_basic_slots()
+{
+  std::array<uint8_t, basic_slots_cnt> slots = {};
+  for (auto& slot : slots)
+    slot = basic_slot_empty;
+  for (size_t i = 0; i < basic_types_cnt; ++i)
+    slots[basic_slot(cp::fnv1a64(basic_types[i].name), basic_slot_shift)] = static_cast<uint8_t>(i);
+  return slots;
+}
+
+constexpr std::array<uint8_t, basic_slots_cnt> basic_slots = build_basic_slots();
+
+const basic_type_desc* find_basic_type(std::string_view name)
+{
+  const uint8_t i = basic_slots[basic_slot(cp::fnv1a64(name), basic_slot_shift)];
+  if (i == basic_slot_empty || basic_types[i].name != name)
+    return nullptr;
+  return &basic_types[i];
+}
+
+std::function<CPropertyUPtr(CPropertyOwner*)> build_basic_creator(EBasicType type, gname ctypename)
+{
+  switch (type)
+  {
+    case EBasicType::Bool:           return build_prop_creator<CBoolProperty>();
+    case EBasicType::U8:             return build_prop_creator<CIntProperty>(EIntKind::U8);
+    case EBasicType::I8:             return build_prop_creator<CIntProperty>(EIntKind::I8);
+    case EBasicType::U16:            return build_prop_creator<CIntProperty>(EIntKind::U16);
+    case EBasicType::I16:            return build_prop_creator<CIntProperty>(EIntKind::I16);
+    case EBasicType::U32:            return build_prop_creator<CIntProperty>(EIntKind::U32);
+    case EBasicType::I32:            return build_prop_creator<CIntProperty>(EIntKind::I32);
+    case EBasicType::U64:            return build_prop_creator<CIntProperty>(EIntKind::U64);
+    case EBasicType::I64:            return build_prop_creator<CIntProperty>(EIntKind::I64);
+    case EBasicType::Float:          return build_prop_creator<CFloatProperty>();
+    case EBasicType::TweakDBID:      return build_prop_creator<CTweakDBIDProperty>();
+    case EBasicType::CName:          return build_prop_creator<CNameProperty>();
+    case EBasicType::CRUID:          return build_prop_creator<CCRUIDProperty>();
+    case EBasicType::NodeRef:        return build_prop_creator<CNodeRefProperty>();
+    case EBasicType::SavedStatsData: return build_prop_creator<CObjectProperty>(ctypename);
+    default: break;
+  }
+  return build_prop_creator<CUnknownProperty>(ctypename);
+}
+
+bool starts_with(std::string_view s, std::string_view prefix)
+{
+  return s.substr(0, prefix.size()) == prefix;
+}
+
+} // namespace
+
 std::function<CPropertyUPtr(CPropertyOwner*)> CPropertyFactory::get_creator(gname ctypename)
 {
-  std::string str_ctypename = ctypename.c_str();
+  auto& factory = get();
+
+  {
+    std::shared_lock<std::shared_mutex> lock(factory.m_mtx);
+    auto it = factory.m_creators.find(ctypename.idx());
+    if (it != factory.m_creators.end())
+      return it->second;
+  }
+
+  // built unlocked: array creators resolve their element's creator
+  auto creator = build_creator(ctypename);
+
+  std::unique_lock<std::shared_mutex> lock(factory.m_mtx);
+  return factory.m_creators.emplace(ctypename.idx(), std::move(creator)).first->second;
+}
+
+std::function<CPropertyUPtr(CPropertyOwner*)> CPropertyFactory::build_creator(gname ctypename)
+{
+  const std::string_view str_ctypename = ctypename.strv();
 
   if (str_ctypename.size() && str_ctypename[0] == '[')
   {
@@ -29,7 +176,10 @@ std::function<CPropertyUPtr(CPropertyOwner*)> CPropertyFactory::get_creator(gnam
         size_t array_size = std::stoul(std::string(str_ctypename.substr(1, pos - 1)));
         gname elt_type(str_ctypename.substr(pos + 1));
 
-        return build_prop_creator<CArrayProperty>(elt_type, array_size);
+        if (auto packed_creator = make_packed_array_creator(ctypename, elt_type, array_size))
+          return packed_creator;
+
+        return build_prop_creator<CArrayProperty>(elt_type, array_size, ctypename, get_creator(elt_type));
       }
       catch (std::exception&)
       {
@@ -38,49 +188,34 @@ std::function<CPropertyUPtr(CPropertyOwner*)> CPropertyFactory::get_creator(gnam
     }
     return build_prop_creator<CUnknownProperty>(ctypename);
   }
-  else if (str_ctypename.rfind("array:", 0) == 0)
+  else if (starts_with(str_ctypename, "array:"))
   {
     gname sub_ctypename(str_ctypename.substr(sizeof("array:") - 1));
-    return build_prop_creator<CDynArrayProperty>(sub_ctypename);
+
+    // primitive elements are stored packed
+    if (auto packed_creator = make_packed_array_creator(ctypename, sub_ctypename, packed_dyn_array))
+      return packed_creator;
+
+    return build_prop_creator<CDynArrayProperty>(sub_ctypename, ctypename, get_creator(sub_ctypename));
   }
-  else if (str_ctypename.rfind("handle:", 0) == 0)
+  else if (starts_with(str_ctypename, "handle:"))
   {
     gname sub_ctypename(str_ctypename.substr(sizeof("handle:") - 1));
-    return build_prop_creator<CHandleProperty>(sub_ctypename);
+    return build_prop_creator<CHandleProperty>(sub_ctypename, ctypename);
   }
-  else if (str_ctypename.rfind("raRef:", 0) == 0)
+  else if (starts_with(str_ctypename, "raRef:"))
   {
     gname sub_ctypename(str_ctypename.substr(sizeof("raRef:") - 1));
-    return build_prop_creator<CRaRefProperty>(sub_ctypename);
-  }
-  else if (str_ctypename == "Bool")
-  {
-    return build_prop_creator<CBoolProperty>();
+    return build_prop_creator<CRaRefProperty>(sub_ctypename, ctypename);
   }
-  else if (str_ctypename == "Uint8")      { return build_prop_creator<CIntProperty>(EIntKind::U8);  }
-  else if (str_ctypename == "Int8")       { return build_prop_creator<CIntProperty>(EIntKind::I8);  }
-  else if (str_ctypename == "Uint16")     { return build_prop_creator<CIntProperty>(EIntKind::U16); }
-  else if (str_ctypename == "Int16")      { return build_prop_creator<CIntProperty>(EIntKind::I16); }
-  else if (str_ctypename == "Uint32")     { return build_prop_creator<CIntProperty>(EIntKind::U32); }
-  else if (str_ctypename == "Int32")      { return build_prop_creator<CIntProperty>(EIntKind::I32); }
-  else if (str_ctypename == "Uint64")     { return build_prop_creator<CIntProperty>(EIntKind::U64); }
-  else if (str_ctypename == "Int64")      { return build_prop_creator<CIntProperty>(EIntKind::I64); }
-  else if (str_ctypename == "Float")      { return build_prop_creator<CFloatProperty>();            }
-  else if (str_ctypename == "TweakDBID")  { return build_prop_creator<CTweakDBIDProperty>();        }
-  else if (str_ctypename == "CName")      { return build_prop_creator<CNameProperty>();             }
-  else if (str_ctypename == "CRUID")      { return build_prop_creator<CCRUIDProperty>();             }
-  else if (str_ctypename == "NodeRef")
+  else if (auto basic_type = find_basic_type(str_ctypename))
   {
-    return build_prop_creator<CNodeRefProperty>();
+    return build_basic_creator(basic_type->type, ctypename);
   }
-  else if (CEnum_resolver::get().is_registered(gname(str_ctypename)))
+  else if (CEnum_resolver::get().is_registered(ctypename))
   {
     return build_prop_creator<CEnumProperty>(ctypename);
   }
-  else if (str_ctypename == "gameSavedStatsData")
-  {
-    return build_prop_creator<CObjectProperty>(ctypename);
-  }
 
   if (str_ctypename.find(':') == std::string::npos)
   {
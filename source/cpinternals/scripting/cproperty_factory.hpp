@@ -1,12 +1,22 @@
 #pragma once
 #include <string>
+#include <functional>
+#include <shared_mutex>
+#include <unordered_map>
 
 #include "fwd.hpp"
 #include "iproperty.hpp"
 #include "CStringPool.hpp"
 
+// Creators are resolved once per ctypename and cached by gname index, so
+// creating a property (and the elements of an array) never parses type
+// names. Basic types are dispatched on the fnv1a64 of their name with a
+// perfect hash table built at compile time.
 class CPropertyFactory
 {
+public:
+  using creator_fn = std::function<CPropertyUPtr(CPropertyOwner*)>;
+
 private:
   CPropertyFactory()
   {
@@ -26,6 +36,12 @@ public:
   }
 
 public:
-  static std::function<CPropertyUPtr(CPropertyOwner*)> get_creator(gname ctypename);
+  static creator_fn get_creator(gname ctypename);
+
+protected:
+  static creator_fn build_creator(gname ctypename);
+
+  std::shared_mutex m_mtx;
+  std::unordered_map<uint32_t, creator_fn> m_creators; // by gname idx
 };
 
@@ -0,0 +1,462 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+
+#include "cpinternals/common.hpp"
+#include "cpinternals/ctypes.hpp"
+
+#include "fwd.hpp"
+#include "iproperty.hpp"
+
+#ifndef DISABLE_CP_IMGUI_WIDGETS
+#include "appbase/widgets/cpinternals.hpp"
+#endif
+
+//------------------------------------------------------------------------------
+// PACKED ARRAYS
+//------------------------------------------------------------------------------
+
+// Arrays of primitive elements (ints, floats..) without a property per
+// element: values are stored contiguously and (de)serialized with one copy.
+// Same layout and ctypename as CArrayProperty/CDynArrayProperty, the
+// factory uses them for the element types that have traits below.
+//
+// Elements are serialized as serial_type, value_type is what's stored
+// (e.g. CName values are serialized as string pool indices).
+
+// fixed size of dynamic arrays
+inline constexpr size_t packed_dyn_array = SIZE_MAX;
+
+template <typename T>
+struct packed_elt_traits_base
+{
+  using value_type = T;
+  using serial_type = T;
+};
+
+struct packed_bool_traits
+  : packed_elt_traits_base<uint8_t>
+{
+#ifndef DISABLE_CP_IMGUI_WIDGETS
+  [[nodiscard]] static bool imgui_widget(const char* label, value_type& v, bool editable)
+  {
+    if (!editable)
+    {
+      ImGui::Text(v ? "true" : "false");
+      return false;
+    }
+
+    bool b = !!v;
+    if (!ImGui::Checkbox(label, &b))
+      return false;
+    v = b ? 1 : 0;
+    return true;
+  }
+#endif
+};
+
+template <typename IntT>
+struct packed_int_traits
+  : packed_elt_traits_base<IntT>
+{
+#ifndef DISABLE_CP_IMGUI_WIDGETS
+  // hex, as CIntProperty
+  [[nodiscard]] static bool imgui_widget(const char* label, IntT& v, bool editable)
+  {
+    ImGuiDataType dtype = ImGuiDataType_U64;
+    auto dfmt = "%016llX";
+
+    if constexpr (sizeof(IntT) == 1) { dtype = ImGuiDataType_U8;  dfmt = "%02X"; }
+    if constexpr (sizeof(IntT) == 2) { dtype = ImGuiDataType_U16; dfmt = "%04X"; }
+    if constexpr (sizeof(IntT) == 4) { dtype = ImGuiDataType_U32; dfmt = "%08X"; }
+
+    return ImGui::InputScalar(label, dtype, &v, 0, 0, dfmt,
+      ImGuiInputTextFlags_CharsHexadecimal | (editable ? 0 : ImGuiInputTextFlags_ReadOnly));
+  }
+#endif
+};
+
+struct packed_float_traits
+  : packed_elt_traits_base<float>
+{
+#ifndef DISABLE_CP_IMGUI_WIDGETS
+  [[nodiscard]] static bool imgui_widget(const char* label, value_type& v, bool editable)
+  {
+    return ImGui::InputFloat(label, &v, 0, 0, "%.3f", editable ? 0 : ImGuiInputTextFlags_ReadOnly);
+  }
+#endif
+};
+
+struct packed_tweakdbid_traits
+  : packed_elt_traits_base<TweakDBID>
+{
+#ifndef DISABLE_CP_IMGUI_WIDGETS
+  [[nodiscard]] static bool imgui_widget(const char* label, value_type& v, bool editable)
+  {
+    return TweakDBID_widget::draw(v, label);
+  }
+#endif
+};
+
+struct packed_cruid_traits
+  : packed_int_traits<uint64_t>
+{
+};
+
+struct packed_cname_traits
+{
+  using value_type = CName;
+  using serial_type = uint16_t;
+
+  static bool from_serial(serial_type strpool_idx, value_type& v, CSystemSerCtx& serctx)
+  {
+    if (strpool_idx >= serctx.strpool.size())
+      return false;
+    v = CName::hash_first(serctx.strpool.view_from_idx(strpool_idx), serctx.strpool.hash_from_idx(strpool_idx));
+    return true;
+  }
+
+  static serial_type to_serial(const value_type& v, CSystemSerCtx& serctx)
+  {
+    return serctx.strpool.to_idx(v.gstr().strv());
+  }
+
+#ifndef DISABLE_CP_IMGUI_WIDGETS
+  [[nodiscard]] static bool imgui_widget(const char* label, value_type& v, bool editable)
+  {
+    return CName_widget::draw(v, label);
+  }
+#endif
+};
+
+
+template <typename Traits>
+class CPackedArrayProperty
+  : public CProperty
+{
+public:
+  using value_type = typename Traits::value_type;
+  using serial_type = typename Traits::serial_type;
+  using container_type = std::vector<value_type>;
+
+  static constexpr size_t npos = packed_dyn_array;
+
+  // values are copied as is
+  static constexpr bool is_verbatim = std::is_same_v<value_type, serial_type>;
+
+  static_assert(std::is_trivially_copyable_v<serial_type>);
+
+protected:
+  container_type m_values;
+  gname m_elt_ctypename;
+  gname m_ctypename;
+  size_t m_fixed_size; // npos for dynamic arrays
+
+public:
+  // dynamic array (array:elt_ctypename)
+  CPackedArrayProperty(CPropertyOwner* owner, gname elt_ctypename)
+    : CProperty(owner, EPropertyKind::DynArray)
+    , m_elt_ctypename(elt_ctypename)
+    , m_ctypename(std::string("array:") + elt_ctypename.c_str())
+    , m_fixed_size(npos)
+  {
+  }
+
+  // fixed length array ([size]elt_ctypename)
+  CPackedArrayProperty(CPropertyOwner* owner, gname elt_ctypename, size_t size)
+    : CProperty(owner, EPropertyKind::DynArray)
+    , m_elt_ctypename(elt_ctypename)
+    , m_ctypename(fmt::format("[{}]{}", size, elt_ctypename.strv()))
+    , m_fixed_size(size)
+  {
+    m_values.resize(size);
+  }
+
+  // used by the factory, ctypename is resolved once per ctypename
+  // (size: npos for dynamic arrays)
+  CPackedArrayProperty(CPropertyOwner* owner, gname elt_ctypename, gname ctypename, size_t size)
+    : CProperty(owner, EPropertyKind::DynArray)
+    , m_elt_ctypename(elt_ctypename)
+    , m_ctypename(ctypename)
+    , m_fixed_size(size)
+  {
+    if (size != npos)
+      m_values.resize(size);
+  }
+
+  ~CPackedArrayProperty() override = default;
+
+public:
+  gname elt_ctypename() const { return m_elt_ctypename; }
+  bool is_fixed_size() const { return m_fixed_size != npos; }
+
+  const container_type& values() const { return m_values; }
+  size_t size() const { return m_values.size(); }
+
+  const value_type& at(size_t idx) const { return m_values[idx]; }
+
+  void set(size_t idx, const value_type& value)
+  {
+    m_values[idx] = value;
+    post_cproperty_event(EPropertyEvent::data_edited);
+  }
+
+  // dynamic arrays only
+  void insert(size_t idx, const value_type& value = {})
+  {
+    if (is_fixed_size())
+      return;
+    m_values.insert(m_values.begin() + idx, value);
+    post_cproperty_event(EPropertyEvent::data_edited);
+  }
+
+  void erase(size_t idx)
+  {
+    if (is_fixed_size())
+      return;
+    m_values.erase(m_values.begin() + idx);
+    post_cproperty_event(EPropertyEvent::data_edited);
+  }
+
+  // overrides
+
+  gname ctypename() const override { return m_ctypename; };
+
+  void accumulate_memory_usage(cp::memory_usage& mu) const override
+  {
+    count_prop(mu, sizeof(*this) + cp::heap_bytes(m_values));
+  }
+
+  bool serialize_in_impl(std::istream& is, CSystemSerCtx& serctx) override
+  {
+    uint32_t cnt = 0;
+    is >> cbytes_ref(cnt);
+    if (!is.good() || !check_count(cnt))
+      return false;
+
+    if constexpr (is_verbatim)
+    {
+      m_values.resize(cnt);
+      is.read((char*)m_values.data(), cnt * sizeof(serial_type));
+      return is.good();
+    }
+    else
+    {
+      std::vector<serial_type> serial(cnt);
+      is.read((char*)serial.data(), cnt * sizeof(serial_type));
+      return is.good() && from_serial(serial, serctx);
+    }
+  }
+
+  bool serialize_in_impl(span_reader& reader, CSystemSerCtx& serctx) override
+  {
+    uint32_t cnt = 0;
+    if (!reader.read(cnt) || !check_count(cnt))
+      return false;
+
+    // don't allocate for a corrupted count
+    if (size_t(cnt) * sizeof(serial_type) > reader.remaining())
+    {
+      reader.set_error();
+      return false;
+    }
+
+    if constexpr (is_verbatim)
+    {
+      m_values.resize(cnt);
+      return reader.read_bytes(m_values.data(), cnt * sizeof(serial_type));
+    }
+    else
+    {
+      std::vector<serial_type> serial(cnt);
+      return reader.read_bytes(serial.data(), cnt * sizeof(serial_type)) && from_serial(serial, serctx);
+    }
+  }
+
+  virtual bool serialize_out(std::ostream& os, CSystemSerCtx& serctx) const
+  {
+    uint32_t cnt = (uint32_t)m_values.size();
+    os << cbytes_ref(cnt);
+
+    if constexpr (is_verbatim)
+    {
+      os.write((const char*)m_values.data(), cnt * sizeof(serial_type));
+    }
+    else
+    {
+      const auto serial = to_serial(serctx);
+      os.write((const char*)serial.data(), cnt * sizeof(serial_type));
+    }
+
+    return true;
+  }
+
+  bool serialize_out(vector_writer& writer, CSystemSerCtx& serctx) const override
+  {
+    writer.write((uint32_t)m_values.size());
+
+    if constexpr (is_verbatim)
+    {
+      writer.write_bytes(m_values.data(), m_values.size() * sizeof(serial_type));
+    }
+    else
+    {
+      const auto serial = to_serial(serctx);
+      writer.write_bytes(serial.data(), serial.size() * sizeof(serial_type));
+    }
+
+    return true;
+  }
+
+protected:
+  bool check_count(uint32_t cnt) const
+  {
+    if (is_fixed_size() && cnt != m_fixed_size)
+      throw std::logic_error("CArrayProperty: false assumption #1. please open an issue");
+    return true;
+  }
+
+  bool from_serial(const std::vector<serial_type>& serial, CSystemSerCtx& serctx)
+  {
+    m_values.resize(serial.size());
+    for (size_t i = 0; i < serial.size(); ++i)
+    {
+      if (!Traits::from_serial(serial[i], m_values[i], serctx))
+        return false;
+    }
+    return true;
+  }
+
+  std::vector<serial_type> to_serial(CSystemSerCtx& serctx) const
+  {
+    std::vector<serial_type> serial(m_values.size());
+    for (size_t i = 0; i < m_values.size(); ++i)
+    {
+      serial[i] = Traits::to_serial(m_values[i], serctx);
+    }
+    return serial;
+  }
+
+public:
+
+#ifndef DISABLE_CP_IMGUI_WIDGETS
+
+  // only visible rows are drawn
+  [[nodiscard]] bool imgui_widget_impl(const char* label, bool editable) override
+  {
+    ImGuiWindow* window = ImGui::GetCurrentWindow();
+    if (window->SkipItems)
+      return false;
+
+    bool modified = false;
+    const bool resizable = editable && !is_fixed_size();
+
+    static ImGuiTableFlags tbl_flags = ImGuiTableFlags_BordersOuter | ImGuiTableFlags_BordersV | ImGuiTableFlags_ScrollY;
+
+    ImVec2 size = ImVec2(-FLT_MIN, std::min(400.f, ImGui::GetContentRegionAvail().y));
+    if (ImGui::BeginTable(label, 2, tbl_flags, size))
+    {
+      ImGui::TableSetupScrollFreeze(0, 1);
+      ImGui::TableSetupColumn("idx", ImGuiTableColumnFlags_WidthFixed, resizable ? 68.f : 28.f);
+      ImGui::TableSetupColumn("value", ImGuiTableColumnFlags_WidthStretch);
+      ImGui::TableHeadersRow();
+
+      int to_rem = -1;
+      int to_ins = -1;
+
+      ImGuiListClipper clipper;
+      clipper.Begin((int)m_values.size());
+      while (clipper.Step())
+      {
+        for (int idx = clipper.DisplayStart; idx < clipper.DisplayEnd; ++idx)
+        {
+          scoped_imgui_id _sii(idx);
+
+          auto lbl = fmt::format("{:03d}", idx);
+
+          ImGui::TableNextRow();
+          ImGui::TableNextColumn();
+
+          ImGui::Text(lbl.c_str());
+          if (resizable)
+          {
+            ImGui::SameLine();
+            if (ImGui::SmallButton("delete"))
+              to_rem = idx;
+            ImGui::SameLine();
+            if (ImGui::SmallButton("insert"))
+              to_ins = idx;
+          }
+
+          ImGui::TableNextColumn();
+          ImGui::SetNextItemWidth(-FLT_MIN);
+          modified |= Traits::imgui_widget(("##" + lbl).c_str(), m_values[idx], editable);
+        }
+      }
+
+      if (m_values.empty() && resizable)
+      {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        if (ImGui::SmallButton("insert"))
+          to_ins = 0;
+      }
+
+      ImGui::EndTable();
+
+      if (to_rem >= 0)
+      {
+        m_values.erase(m_values.begin() + to_rem);
+        modified = true;
+      }
+
+      if (to_ins >= 0)
+      {
+        m_values.insert(m_values.begin() + to_ins, value_type{});
+        modified = true;
+      }
+    }
+
+    return modified;
+  }
+
+  bool imgui_is_one_liner() override { return false; }
+
+#endif
+};
+
+
+// returns an empty creator if elt_ctypename has no packed array
+// (fixed_size: packed_dyn_array for dynamic arrays, ctypename is the
+// array's one)
+inline std::function<CPropertyUPtr(CPropertyOwner*)>
+make_packed_array_creator(gname ctypename, gname elt_ctypename, size_t fixed_size)
+{
+  auto creator = [&](auto traits_tag) -> std::function<CPropertyUPtr(CPropertyOwner*)> {
+    using prop_type = CPackedArrayProperty<decltype(traits_tag)>;
+    return [ctypename, elt_ctypename, fixed_size](CPropertyOwner* owner) -> CPropertyUPtr {
+      return CPropertyUPtr(new prop_type(owner, elt_ctypename, ctypename, fixed_size));
+    };
+  };
+
+  const std::string_view name = elt_ctypename.strv();
+
+  if (name == "Bool")      return creator(packed_bool_traits());
+  if (name == "Uint8")     return creator(packed_int_traits<uint8_t>());
+  if (name == "Int8")      return creator(packed_int_traits<int8_t>());
+  if (name == "Uint16")    return creator(packed_int_traits<uint16_t>());
+  if (name == "Int16")     return creator(packed_int_traits<int16_t>());
+  if (name == "Uint32")    return creator(packed_int_traits<uint32_t>());
+  if (name == "Int32")     return creator(packed_int_traits<int32_t>());
+  if (name == "Uint64")    return creator(packed_int_traits<uint64_t>());
+  if (name == "Int64")     return creator(packed_int_traits<int64_t>());
+  if (name == "Float")     return creator(packed_float_traits());
+  if (name == "TweakDBID") return creator(packed_tweakdbid_traits());
+  if (name == "CRUID")     return creator(packed_cruid_traits());
+  if (name == "CName")     return creator(packed_cname_traits());
+
+  return {};
+}
+
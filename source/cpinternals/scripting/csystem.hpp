@@ -5,11 +5,14 @@
 #include <exception>
 
 #include "cpinternals/common.hpp"
+#include "cpinternals/common/parallel.hpp"
 #include "cpinternals/ctypes.hpp"
 #include "cpinternals/csav/node.hpp"
 #include "cpinternals/csav/serializers.hpp"
 #include "CStringPool.hpp"
 #include "cobject.hpp"
+#include "cproperty.hpp"
+#include "csystem_sercache.hpp"
 
 enum class ESystemKind : uint8_t
 {
@@ -35,6 +38,9 @@ enum class ESystemKind : uint8_t
 
 class CSystem
 {
+  // reads the blob layout without loading it
+  friend class CSystemRaw;
+
 private:
   struct header_t
   {
@@ -72,9 +78,79 @@ private:
   // since we don't handle all types..
   CSystemSerCtx m_serctx;
 
+  // objects and properties of the last load, see CSystemArena
+  CSystemArenaRef m_arena;
+
+  // object data of the last load, pending fields of lazy objects decode from it
+  std::shared_ptr<CSystemLoadData> m_loaddata;
+
+  // unmodified objects are written back from there, see serialize_out
+  // (heap allocated: it is registered as listener of the objects)
+  std::unique_ptr<CSystemSerCache> m_sercache;
+
+  // size of the last loaded blob, see serialized_size_hint
+  size_t m_loaded_size = 0;
+
+  size_t m_workers_cnt = 0;
+  bool m_lazy_decoding = false;
+  bool m_copy_unmodified = true;
+
 public:
+  // systems with fewer objects are decoded on the calling thread
+  static constexpr size_t parallel_min_objects = 256;
+
   CSystem() = default;
-  ~CSystem() = default;
+
+  ~CSystem()
+  {
+    detach_loaddata();
+  }
+
+  // 0 means one per hardware thread, 1 disables parallel decoding
+  void set_workers_count(size_t workers_cnt)
+  {
+    m_workers_cnt = workers_cnt;
+  }
+
+  size_t workers_count() const { return m_workers_cnt; }
+
+  // objects of the next loads decode their fields on first access
+  // (see CObject::serialize_in_lazy), for systems that are mostly not viewed
+  void set_lazy_decoding(bool lazy_decoding)
+  {
+    m_lazy_decoding = lazy_decoding;
+  }
+
+  // when false, serialize_out re-encodes every object (reserialization tests)
+  void set_copy_unmodified(bool copy_unmodified)
+  {
+    m_copy_unmodified = copy_unmodified;
+  }
+
+  // e.g. to enable the serialization trace
+  CSystemSerCtx& serctx() { return m_serctx; }
+
+  // size of the loaded blob (size prefix included), the next serialize_out
+  // output is usually close to it
+  size_t serialized_size_hint() const { return m_loaded_size; }
+
+  // memory accounting of the objects (fields are not decoded), string pool
+  // and load state
+  void accumulate_memory_usage(cp::memory_usage& mu) const
+  {
+    mu.object_bytes += cp::heap_bytes(m_objects) + cp::heap_bytes(m_handle_objects);
+    for (const auto& obj : m_objects)
+      obj->accumulate_memory_usage(mu);
+    for (const auto& obj : m_handle_objects)
+      obj->accumulate_memory_usage(mu);
+
+    mu.string_bytes += m_serctx.strpool.memory_usage();
+    mu.cache_bytes += m_serctx.memory_usage();
+    if (m_loaddata)
+      mu.cache_bytes += sizeof(CSystemLoadData) + cp::heap_bytes(m_loaddata->storage);
+    if (m_sercache)
+      mu.cache_bytes += m_sercache->memory_usage();
+  }
 
 public:
   const std::vector<CName>& subsys_names() const { return m_subsys_names; }
@@ -93,16 +169,74 @@ public:
     return serialize_in_sized(reader, blob_size, true);
   }
 
+  // the blob is parsed in place, see serialize_in_sized(std::span)
+  bool serialize_in(cp::csav::node_span_reader& reader)
+  {
+    uint32_t blob_size = 0;
+    if (!reader.read_pod(blob_size))
+      return false;
+
+    const auto blob = reader.read_span(blob_size);
+    if (reader.failed())
+      return false;
+
+    return serialize_in_sized(blob, true);
+  }
+
+  // the blob is read whole once, the load data then keeps it without
+  // another copy of the object region
   bool serialize_in_sized(std::istream& reader, uint32_t blob_size, bool do_cnames=false)
   {
+    std::vector<char> blob(blob_size);
+    reader.read(blob.data(), blob_size);
+    if ((size_t)reader.gcount() != blob_size)
+      return false;
+
+    const std::span<const char> blob_span(blob);
+    return serialize_in_blob(blob_span, &blob, do_cnames);
+  }
+
+  // blob isn't kept: the object region is copied only if the objects need
+  // it after the load (lazy decoding, copy of unmodified objects)
+  bool serialize_in_sized(std::span<const char> blob, bool do_cnames=false)
+  {
+    return serialize_in_blob(blob, nullptr, do_cnames);
+  }
+
+protected:
+  // reused by the loads of a thread
+  struct load_scratch_t
+  {
+    std::vector<std::span<const char>> objblobs;
+
+    static load_scratch_t& get()
+    {
+      static thread_local load_scratch_t s;
+      return s;
+    }
+  };
+
+  // storage: if not null, the vector blob is a span of, it is moved into the
+  // load data if that one is needed
+  bool serialize_in_blob(std::span<const char> blob, std::vector<char>* storage, bool do_cnames)
+  {
+    const size_t blob_size = blob.size();
+
     m_subsys_names.clear();
     m_objects.clear();
     m_handle_objects.clear();
+    m_sercache.reset();
+    detach_loaddata();
+    m_loaded_size = blob_size + sizeof(uint32_t);
+
+    // the previous arena is released once its objects are all gone
+    m_arena = CSystemArenaRef::create();
+    CSystemArena::scope arena_scope(m_arena.get());
 
-    // let's get our header start position
-    auto blob_spos = reader.tellg();
+    span_reader reader(blob);
 
-    reader >> cbytes_ref(m_header);
+    if (!reader.read(m_header))
+      return false;
 
     // check header
     if (m_header.obj_descs_offset < m_header.strpool_data_offset)
@@ -113,21 +247,21 @@ public:
     m_subsys_names.clear();
     if (m_header.cnames_cnt > 1 && do_cnames)
     {
-
       uint32_t cnames_cnt = 0;
-      reader >> cbytes_ref(cnames_cnt);
-      
+      reader.read(cnames_cnt);
+
       if (cnames_cnt != m_header.cnames_cnt)
         return false;
 
       static_assert(sizeof(CName) == 8);
 
       m_subsys_names.resize(cnames_cnt);
-      reader.read((char*)m_subsys_names.data(), m_header.cnames_cnt * sizeof(CName));
+      if (!reader.read_bytes(m_subsys_names.data(), m_header.cnames_cnt * sizeof(CName)))
+        return false;
     }
 
     // end of header
-    const size_t base_offset = (reader.tellg() - blob_spos);
+    const size_t base_offset = reader.tell();
     if (base_offset + m_header.objdata_offset > blob_size)
       return false;
 
@@ -136,7 +270,6 @@ public:
     const uint32_t strpool_descs_size = m_header.strpool_data_offset;
     const uint32_t strpool_data_size = m_header.obj_descs_offset - strpool_descs_size;
 
-    //CStringPool strpool;
     CStringPool& strpool = m_serctx.strpool;
     if (!strpool.serialize_in(reader, strpool_descs_size, strpool_data_size))
       return false;
@@ -156,56 +289,76 @@ public:
     if (obj_descs_cnt == 0)
       return m_header.objdata_offset + base_offset == blob_size; // could be empty
 
-    std::vector<obj_desc_t> obj_descs(obj_descs_cnt);
-    reader.read((char*)obj_descs.data(), obj_descs_size);
+    if (base_offset + obj_descs_offset != reader.tell())
+      return false;
 
-    // read objdata
-    const size_t objdata_size = blob_size - (base_offset + m_header.objdata_offset); 
+    // descriptors are read in place
+    const char* const pobj_descs = blob.data() + reader.tell();
+    auto obj_desc = [pobj_descs](size_t i) {
+      obj_desc_t desc;
+      std::memcpy(&desc, pobj_descs + i * sizeof(obj_desc_t), sizeof(obj_desc_t));
+      return desc;
+    };
 
-    if (base_offset + m_header.objdata_offset != (reader.tellg() - blob_spos))
-      return false;
+    // objdata
+    const std::span<const char> objdata = blob.subspan(base_offset + m_header.objdata_offset);
+    const size_t objdata_size = objdata.size();
 
-    std::vector<char> objdata(objdata_size);
-    reader.read((char*)objdata.data(), objdata_size);
+    // kept for lazy fields and unmodified objects, see CSystemLoadData
+    if (m_lazy_decoding || m_copy_unmodified)
+    {
+      if (storage)
+        m_loaddata = std::make_shared<CSystemLoadData>(std::move(*storage), objdata, &m_serctx);
+      else
+        m_loaddata = std::make_shared<CSystemLoadData>(objdata, &m_serctx);
+    }
 
-    if (blob_size != (reader.tellg() - blob_spos))
-      return false;
+    const char* const pobjdata = m_loaddata ? m_loaddata->objdata.data() : objdata.data();
 
     // prepare default initialized objects
     m_serctx.m_objects.clear();
-    m_serctx.m_objects.reserve(obj_descs.size());
-    for (auto it = obj_descs.begin(); it != obj_descs.end(); ++it)
+    m_serctx.m_objects.reserve(obj_descs_cnt);
+    for (size_t i = 0; i < obj_descs_cnt; ++i)
     {
-      const auto& desc = *it;
+      const auto desc = obj_desc(i);
 
       // check desc is valid
       if (desc.data_offset < m_header.objdata_offset)
         return false;
 
-      auto obj_ctypename = gname(strpool.from_idx(desc.name_idx));
-      auto new_obj = std::make_shared<CObject>(obj_ctypename, true); // todo: static create method
+      auto obj_ctypename = gname(strpool.view_from_idx(desc.name_idx));
+      auto new_obj = CObject::create(obj_ctypename, true);
       m_serctx.m_objects.push_back(new_obj);
     }
 
     // here the offsets relative to base_offset are converted to offsets relative to objdata
+    auto& objblobs = load_scratch_t::get().objblobs;
+    objblobs.resize(obj_descs_cnt);
     size_t next_obj_offset = objdata_size;
-    auto obj_it = m_serctx.m_objects.rbegin();
-    for (auto it = obj_descs.rbegin(); it != obj_descs.rend(); ++it, ++obj_it)
+    for (size_t i = obj_descs_cnt; i-- > 0;)
     {
-      const auto& desc = *it;
+      const auto desc = obj_desc(i);
 
       const size_t offset = desc.data_offset - m_header.objdata_offset;
       if (offset > next_obj_offset)
         throw std::logic_error("CSystem: false assumption #2. please open an issue.");
 
-      std::span<char> objblob((char*)objdata.data() + offset, next_obj_offset - offset);
-      if (!(*obj_it)->serialize_in(objblob, m_serctx))
-        return false;
-
+      objblobs[i] = std::span<const char>(pobjdata + offset, next_obj_offset - offset);
       next_obj_offset = offset;
     }
 
+    if (!serialize_in_objects(objblobs))
+      return false;
+
     const auto& serobjs = m_serctx.m_objects;
+
+    // after serialization, the objects posted their serialized_in events
+    if (m_loaddata)
+    {
+      m_sercache = std::make_unique<CSystemSerCache>();
+      m_sercache->assign(serobjs, m_loaddata, objblobs);
+    }
+
     size_t root_obj_cnt = m_subsys_names.size();
     if (root_obj_cnt == 0)
       root_obj_cnt = 1;
@@ -215,6 +368,75 @@ public:
     return true;
   }
 
+  void detach_loaddata()
+  {
+    if (m_loaddata)
+      m_loaddata->detach();
+    m_loaddata.reset();
+  }
+
+  bool serialize_in_object(size_t i, std::span<const char> objblob)
+  {
+    auto& obj = m_serctx.m_objects[i];
+    if (m_lazy_decoding)
+      return obj->serialize_in_lazy(objblob, m_serctx, m_loaddata);
+    return obj->serialize_in(objblob, m_serctx);
+  }
+
+  // objects are independent: their handles only need the indices of the
+  // objects, which all exist already.
+  // in parallel, the string pool is only read and handles are linked after
+  // decoding (see CSystemSerCtx::defer_handle).
+  bool serialize_in_objects(const std::vector<std::span<const char>>& objblobs)
+  {
+    auto& objects = m_serctx.m_objects;
+
+    if (m_workers_cnt == 1 || objects.size() < parallel_min_objects)
+    {
+      // reverse order catches unknown props with unknown end earlier
+      for (size_t i = objects.size(); i-- > 0;)
+      {
+        if (!serialize_in_object(i, objblobs[i]))
+          return false;
+      }
+      return true;
+    }
+
+    m_serctx.m_defer_handles = true;
+    m_serctx.m_deferred_handles.clear();
+
+    std::atomic<bool> failed = false;
+    try
+    {
+      cp::parallel_for(objects.size(), m_workers_cnt, [&](size_t i) {
+        CSystemArena::scope arena_scope(m_arena.get());
+        if (!failed.load(std::memory_order_relaxed) && !serialize_in_object(i, objblobs[i]))
+          failed = true;
+      });
+    }
+    catch (...)
+    {
+      m_serctx.m_defer_handles = false;
+      m_serctx.m_deferred_handles.clear();
+      throw;
+    }
+
+    m_serctx.m_defer_handles = false;
+
+    if (!failed)
+    {
+      for (const auto& [prop, handle] : m_serctx.m_deferred_handles)
+      {
+        prop->set_obj(m_serctx.from_handle(handle));
+      }
+    }
+
+    m_serctx.m_deferred_handles.clear();
+    m_serctx.m_deferred_handles.shrink_to_fit();
+    return !failed;
+  }
+
+public:
   bool serialize_out(std::ostream& writer) const
   {
     // let's not do too many copies
@@ -245,11 +467,27 @@ public:
     //CStringPool strpool;
     CSystemSerCtx& serctx = const_cast<CSystemSerCtx&>(m_serctx);
     // here we can't really remove handle-objects because there might be hidden handles in unsupported types
-    serctx.m_objects.assign(m_objects.begin(), m_objects.end());
-    serctx.m_objects.insert(serctx.m_objects.end(), m_handle_objects.begin(), m_handle_objects.end());
+    std::vector<CObjectSPtr> objects(m_objects.begin(), m_objects.end());
+    objects.insert(objects.end(), m_handle_objects.begin(), m_handle_objects.end());
+
+    // unmodified objects are copied from their loaded blob, their handles
+    // are only valid if the loaded objects didn't move (e.g. root removed)
+    const bool use_sercache = m_copy_unmodified && m_sercache && m_sercache->matches(objects);
+
+    // same for pending fields, they must be decoded while serctx.m_objects
+    // is still the loaded list (it is then updated on each save)
+    if (!use_sercache)
+    {
+      for (const auto& obj : serctx.m_objects)
+        std::ignore = obj->decode_lazy_fields();
+    }
+
+    serctx.m_objects = std::move(objects);
     serctx.rebuild_handlemap();
 
-    std::ostringstream ss;
+    vector_writer objdata;
+    if (m_loaddata)
+      objdata.reserve(m_loaddata->objdata.size());
     std::vector<obj_desc_t> obj_descs;
     obj_descs.reserve(serctx.m_objects.size()); // ends up higher in the presence of handles
 
@@ -257,10 +495,19 @@ public:
     for (size_t i = 0; i < serctx.m_objects.size(); ++i)
     {
       auto& obj = serctx.m_objects[i];
-      const uint32_t tmp_offset = (uint32_t)ss.tellp();
+      const uint32_t tmp_offset = (uint32_t)objdata.tell();
       const uint16_t name_idx = serctx.strpool.to_idx(obj->ctypename().c_str());
       obj_descs.emplace_back(name_idx, tmp_offset);
-      if (!obj->serialize_out(ss, serctx))
+
+      std::span<const char> blob;
+      if (use_sercache && m_sercache->find_clean_blob(i, blob))
+      {
+        objdata.write_bytes(blob.data(), blob.size());
+        serctx.trace(ESerTraceEvent::object_copied, obj->ctypename(), blob.size());
+        continue;
+      }
+
+      if (!obj->serialize_out(objdata, serctx))
         return false;
     }
 
@@ -283,8 +530,7 @@ public:
 
     // write obj descs + data
     writer.write((char*)obj_descs.data(), obj_descs_size);
-    auto objdata = ss.str(); // not optimal but didn't want to depend on boost and no time to dev a mem stream for now
-    writer.write(objdata.data(), objdata.size());
+    writer.write(objdata.buffer().data(), objdata.buffer().size());
     auto end_spos = writer.tellp();
 
     // at this point data should be correct except blob_size and header
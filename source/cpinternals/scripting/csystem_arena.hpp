@@ -0,0 +1,271 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+// Slab allocator for the objects and properties of a CSystem.
+//
+// Allocations are served from 64KB chunks in 16-byte size classes, freed
+// ones are reused by later allocations of the same class. Chunks are only
+// released all at once, when the system dropped the arena and the last of
+// its allocations is freed (CSystem creates a new one for each load).
+//
+// CProperty and CObject use it through CSystemArena::allocate, which takes
+// the arena of the current thread's scope (heap if none). Every allocation
+// has a header with its shard so that it can be freed without a scope.
+// Threads are spread over shards, each with its own lock.
+class CSystemArena
+{
+public:
+  static constexpr size_t alignment = 16;
+  static constexpr size_t max_class_size = 512; // header included, larger ones use the heap
+  static constexpr size_t chunk_size = 0x10000;
+  static constexpr size_t shards_cnt = 8;
+
+  CSystemArena(const CSystemArena&) = delete;
+  CSystemArena& operator=(const CSystemArena&) = delete;
+
+  // arena used by allocate() on the current thread while alive
+  class scope
+  {
+    CSystemArena* m_prev;
+
+  public:
+    explicit scope(CSystemArena* arena)
+      : m_prev(t_current)
+    {
+      t_current = arena;
+    }
+
+    ~scope()
+    {
+      t_current = m_prev;
+    }
+
+    scope(const scope&) = delete;
+    scope& operator=(const scope&) = delete;
+  };
+
+  static void* allocate(size_t size)
+  {
+    const size_t full_size = size + sizeof(header);
+    CSystemArena* arena = t_current;
+
+    if (!arena || full_size > max_class_size)
+    {
+      auto h = static_cast<header*>(::operator new(full_size));
+      h->owner = nullptr;
+      h->class_idx = 0;
+      return h + 1;
+    }
+
+    return arena->shard_of_this_thread().allocate(*arena, class_of(full_size));
+  }
+
+  static void deallocate(void* p)
+  {
+    if (!p)
+      return;
+
+    auto h = static_cast<header*>(p) - 1;
+    shard* owner = h->owner;
+    if (!owner)
+    {
+      ::operator delete(h);
+      return;
+    }
+
+    owner->deallocate(h);
+    owner->arena->release();
+  }
+
+protected:
+  struct shard;
+
+  struct alignas(alignment) header
+  {
+    shard* owner; // null for heap allocations
+    uint32_t class_idx;
+  };
+
+  struct free_slot
+  {
+    free_slot* next;
+  };
+
+  static constexpr size_t classes_cnt = max_class_size / alignment;
+
+  static size_t class_of(size_t full_size)
+  {
+    return (full_size + alignment - 1) / alignment - 1;
+  }
+
+  struct alignas(64) shard
+  {
+    CSystemArena* arena = nullptr;
+    std::mutex mtx;
+    std::array<free_slot*, classes_cnt> free_lists = {};
+    char* cur = nullptr;
+    size_t cur_remaining = 0;
+    std::vector<std::unique_ptr<char[]>> chunks;
+
+    void* allocate(CSystemArena& arena, size_t class_idx)
+    {
+      const size_t slot_size = (class_idx + 1) * alignment;
+      arena.m_refs.fetch_add(1, std::memory_order_relaxed);
+
+      header* h = nullptr;
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (auto slot = free_lists[class_idx])
+        {
+          free_lists[class_idx] = slot->next;
+          h = reinterpret_cast<header*>(slot);
+        }
+        else
+        {
+          if (cur_remaining < slot_size)
+          {
+            // the tail of the previous chunk is lost, it is smaller than the largest class
+            chunks.emplace_back(new char[chunk_size]);
+            cur = chunks.back().get();
+            cur_remaining = chunk_size;
+          }
+          h = reinterpret_cast<header*>(cur);
+          cur += slot_size;
+          cur_remaining -= slot_size;
+        }
+      }
+
+      h->owner = this;
+      h->class_idx = (uint32_t)class_idx;
+      return h + 1;
+    }
+
+    void deallocate(header* h)
+    {
+      const size_t class_idx = h->class_idx;
+      auto slot = reinterpret_cast<free_slot*>(h);
+      std::lock_guard<std::mutex> lock(mtx);
+      slot->next = free_lists[class_idx];
+      free_lists[class_idx] = slot;
+    }
+  };
+
+  static_assert(sizeof(header) == alignment);
+  static_assert(__STDCPP_DEFAULT_NEW_ALIGNMENT__ >= alignment);
+
+  CSystemArena()
+  {
+    for (auto& s : m_shards)
+      s.arena = this;
+  }
+
+  ~CSystemArena() = default;
+
+  shard& shard_of_this_thread()
+  {
+    static thread_local const size_t shard_idx = std::hash<std::thread::id>()(std::this_thread::get_id()) % shards_cnt;
+    return m_shards[shard_idx];
+  }
+
+  void release()
+  {
+    if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      delete this;
+  }
+
+  friend class CSystemArenaRef;
+
+  static inline thread_local CSystemArena* t_current = nullptr;
+
+  // owner + live allocations
+  std::atomic<size_t> m_refs = 1;
+  std::array<shard, shards_cnt> m_shards;
+};
+
+// Owning reference of a CSystem to its arena, the arena outlives it until
+// its allocations are all freed.
+class CSystemArenaRef
+{
+  CSystemArena* m_arena = nullptr;
+
+public:
+  CSystemArenaRef() = default;
+
+  CSystemArenaRef(const CSystemArenaRef&) = delete;
+  CSystemArenaRef& operator=(const CSystemArenaRef&) = delete;
+
+  CSystemArenaRef(CSystemArenaRef&& other) noexcept
+    : m_arena(other.m_arena)
+  {
+    other.m_arena = nullptr;
+  }
+
+  CSystemArenaRef& operator=(CSystemArenaRef&& other) noexcept
+  {
+    if (this != &other)
+    {
+      reset();
+      m_arena = other.m_arena;
+      other.m_arena = nullptr;
+    }
+    return *this;
+  }
+
+  ~CSystemArenaRef()
+  {
+    reset();
+  }
+
+  static CSystemArenaRef create()
+  {
+    CSystemArenaRef ret;
+    ret.m_arena = new CSystemArena();
+    return ret;
+  }
+
+  void reset()
+  {
+    if (m_arena)
+      m_arena->release();
+    m_arena = nullptr;
+  }
+
+  CSystemArena* get() const { return m_arena; }
+};
+
+// stateless std allocator over CSystemArena::allocate (e.g. allocate_shared)
+template <typename T>
+struct CSystemArenaAllocator
+{
+  using value_type = T;
+
+  CSystemArenaAllocator() = default;
+
+  template <typename U>
+  CSystemArenaAllocator(const CSystemArenaAllocator<U>&) noexcept {}
+
+  T* allocate(size_t n)
+  {
+    return static_cast<T*>(CSystemArena::allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, size_t) noexcept
+  {
+    CSystemArena::deallocate(p);
+  }
+
+  template <typename U>
+  bool operator==(const CSystemArenaAllocator<U>&) const noexcept { return true; }
+
+  template <typename U>
+  bool operator!=(const CSystemArenaAllocator<U>&) const noexcept { return false; }
+};
+
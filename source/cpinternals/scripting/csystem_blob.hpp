@@ -0,0 +1,387 @@
+#pragma once
+#include <list>
+#include <span>
+#include <vector>
+#include <sstream>
+#include <exception>
+
+#include "cpinternals/common.hpp"
+#include "cpinternals/utils.hpp"
+#include "cpinternals/io/stdstream_wrapper.hpp"
+#include "CStringPool.hpp"
+#include "cobject.hpp"
+#include "csystem_serctx.hpp"
+
+// Standalone CSystem-style blob (.bin/.buffer files of the archives):
+// header, embedded cruids, pooled rarefs, string pool and objects.
+// Serialization only, see archive_test for its editor.
+class CSystemBlob
+{
+public:
+  struct header_t
+  {
+    uint16_t uk1                    = 0;
+    uint16_t uk2                    = 0; // sections count apparently
+    uint32_t ids_cnt                = 0;
+    // test file has 7 sections
+    uint32_t rarefpool_descs_offset = 0;
+    uint32_t rarefpool_data_offset  = 0;
+    uint32_t strpool_descs_offset   = 0;
+    uint32_t strpool_data_offset    = 0;
+    uint32_t obj_descs_offset       = 0;
+    // tricky: obj offsets are relative to the strpool base
+    uint32_t objdata_offset         = 0; 
+  };
+
+  struct obj_desc_t
+  {
+    obj_desc_t() = default;
+
+    obj_desc_t(uint32_t name_idx, uint32_t data_offset)
+      : name_idx(name_idx), data_offset(data_offset) {}
+
+    uint32_t name_idx     = 0;
+    uint32_t data_offset  = 0;// relative to the end of the header in stream
+  };
+
+protected:
+  header_t m_header;
+  uint16_t m_uk1;
+
+  std::vector<uint64_t> m_ids;
+
+  std::list<cname> m_rarefs;
+
+  CSystemSerCtx m_serctx; // strpool + handles
+
+  std::vector<CObjectSPtr> m_objects;
+  std::vector<CObjectSPtr> m_handle_objects;
+
+public:
+  uint16_t uk1() const { return m_uk1; }
+
+  const std::vector<uint64_t>& ids() const { return m_ids; }
+
+  const std::list<cname>& rarefs() const { return m_rarefs; }
+  std::list<cname>& rarefs()       { return m_rarefs; }
+
+  const std::vector<CObjectSPtr>& objects() const { return m_objects; }
+  std::vector<CObjectSPtr>& objects()       { return m_objects; }
+
+  bool serialize_in(std::span<const char> blob)
+  {
+    span_istreambuf sbuf(blob.data(), blob.data() + blob.size());
+    std::istream is(&sbuf);
+    return serialize_in(is, blob.size());
+  }
+
+  bool serialize_out(std::vector<char>& blob) const
+  {
+    blob.clear();
+    vector_ostreambuf sbuf(blob);
+    std::ostream os(&sbuf);
+    return serialize_out(os);
+  }
+
+  bool serialize_in(std::istream& reader, size_t blob_size)
+  {
+    size_t start_pos = (size_t)reader.tellg();
+
+    m_ids.clear();
+    m_rarefs.clear();
+    m_objects.clear();
+    m_handle_objects.clear();
+
+    // let's get our header start position
+    auto blob_spos = reader.tellg();
+
+    reader >> cbytes_ref(m_header);
+
+    // check header
+    if (m_header.rarefpool_descs_offset > m_header.rarefpool_data_offset)
+      return false;
+    if (m_header.rarefpool_data_offset > m_header.strpool_descs_offset)
+      return false;
+    if (m_header.strpool_descs_offset > m_header.strpool_data_offset)
+      return false;
+    if (m_header.strpool_data_offset > m_header.obj_descs_offset)
+      return false;
+    if (m_header.obj_descs_offset > m_header.objdata_offset)
+      return false;
+
+    if (m_header.rarefpool_descs_offset != 0)
+      throw std::exception("m_header.u32arr_offset != 0, not cool :(");
+
+
+    reader >> cbytes_ref(m_uk1);
+    //if (uk1 != 0)
+    //  throw std::exception("uk1 != 0, cool :)");
+
+    uint16_t ids_cnt = 0;
+    reader >> cbytes_ref(ids_cnt);
+
+    if (ids_cnt != m_header.ids_cnt)
+      throw std::exception("ids_cnt != m_header.ids_cnt, not cool :(");
+
+    m_ids.resize(ids_cnt);
+    reader.read((char*)m_ids.data(), m_header.ids_cnt * 8);
+
+    // end of header
+    const size_t base_offset = (size_t)reader.tellg() - start_pos;
+
+    // rarefs
+    
+    const uint32_t rarefpool_descs_size = m_header.rarefpool_data_offset - m_header.rarefpool_descs_offset;
+    const uint32_t rarefpool_data_size = m_header.strpool_descs_offset - m_header.rarefpool_data_offset;
+
+    cp::stdstream_wrapper<std::istream> ar(reader);
+
+    // std::vector<std::string> m_rarefs_strs;
+    // std::vector<CName> m_rarefs_hashes;
+
+    if (m_uk1 == 0) // cname as strings
+    {
+      cnameset np;
+      np.serialize_in<9>(ar, m_header.rarefpool_descs_offset, rarefpool_descs_size, rarefpool_data_size);
+
+      //m_rarefs.reserve(np.size());
+      for (auto& cn : np)
+      {
+        m_rarefs.emplace_back(cn);
+      }
+    }
+    else // cname as hashes (but pooled.. lol)
+    {
+      const size_t descs_cnt = rarefpool_descs_size / 4;
+      std::vector<uint32_t> descs(descs_cnt);
+      ar.serialize_pods_array_raw(descs.data(), descs_cnt);
+
+      std::vector<uint64_t> hashes(descs_cnt);
+      ar.serialize_pods_array_raw(hashes.data(), descs_cnt);
+
+      for (auto& hash : hashes)
+      {
+        cname cn(hash);
+        m_rarefs.emplace_back(hash);
+      }
+    }
+
+    // section 3+4: string pool
+    const uint32_t strpool_descs_size = m_header.strpool_data_offset - m_header.strpool_descs_offset;
+    const uint32_t strpool_data_size = m_header.obj_descs_offset - m_header.strpool_data_offset;
+
+    //CStringPool strpool;
+    CStringPool& strpool = m_serctx.strpool;
+    if (!strpool.serialize_in(reader, strpool_descs_size, strpool_data_size, m_header.strpool_descs_offset))
+      return false;
+
+    // now let's read objects
+
+    // we don't have the impl for all props
+    // so we'll use the assumption that everything is serialized in
+    // order and use the offset of next item as end of blob
+
+    const size_t obj_descs_offset = m_header.obj_descs_offset;
+    const size_t obj_descs_size = m_header.objdata_offset - obj_descs_offset;
+    if (obj_descs_size % sizeof(obj_desc_t) != 0)
+      return false;
+
+    const size_t obj_descs_cnt = obj_descs_size / sizeof(obj_desc_t);
+    if (obj_descs_cnt == 0)
+      return m_header.objdata_offset + base_offset == blob_size; // could be empty
+
+    //std::vector<obj_desc_t> obj_descs(obj_descs_cnt);
+    std::vector<obj_desc_t> obj_descs(obj_descs_cnt);
+
+    reader.read((char*)obj_descs.data(), obj_descs_size);
+
+    // read objdata
+    const size_t objdata_size = blob_size - (base_offset + m_header.objdata_offset); 
+
+    if (base_offset + m_header.objdata_offset != (reader.tellg() - blob_spos))
+      return false;
+
+    std::vector<char> objdata(objdata_size);
+    reader.read((char*)objdata.data(), objdata_size);
+
+    if (blob_size != (reader.tellg() - blob_spos))
+      return false;
+
+    // prepare default initialized objects
+    m_serctx.m_objects.clear();
+    m_serctx.m_objects.reserve(obj_descs.size());
+    for (auto it = obj_descs.begin(); it != obj_descs.end(); ++it)
+    {
+      const auto& desc = *it;
+
+      // check desc is valid
+      if (desc.data_offset < m_header.objdata_offset)
+        return false;
+
+      auto obj_ctypename = gname(strpool.from_idx(desc.name_idx));
+      auto new_obj = std::make_shared<CObject>(obj_ctypename, true); // todo: static create method
+      m_serctx.m_objects.push_back(new_obj);
+    }
+
+    // here the offsets relative to base_offset are converted to offsets relative to objdata
+    size_t next_obj_offset = objdata_size;
+    auto obj_it = m_serctx.m_objects.rbegin();
+    for (auto it = obj_descs.rbegin(); it != obj_descs.rend(); ++it, ++obj_it)
+    {
+      const auto& desc = *it;
+
+      const size_t offset = desc.data_offset - m_header.objdata_offset;
+      if (offset > next_obj_offset)
+        throw std::logic_error("CSystem: false assumption #2. please open an issue.");
+
+      std::span<char> objblob((char*)objdata.data() + offset, next_obj_offset - offset);
+      if (!(*obj_it)->serialize_in(objblob, m_serctx))
+        return false;
+
+      next_obj_offset = offset;
+    }
+
+    const auto& serobjs = m_serctx.m_objects;
+    m_objects.assign(serobjs.begin(), serobjs.end());
+
+    return true;
+  }
+
+  bool serialize_out(std::ostream& writer) const
+  {
+    // let's not do too many copies
+
+    auto start_spos = writer.tellp();
+    uint32_t blob_size = 0; // we don't know it yet
+    
+    writer << cbytes_ref(m_header); 
+
+    header_t new_header = m_header;
+
+    // ----------------------------------------------
+
+    writer << cbytes_ref(m_uk1);
+
+    uint16_t ids_cnt = (uint16_t)m_ids.size();
+    writer << cbytes_ref(ids_cnt);
+    writer.write((char*)m_ids.data(), ids_cnt * 8);
+
+    new_header.ids_cnt = ids_cnt;
+
+    // end of header
+
+    const size_t base_spos = (size_t)writer.tellp();
+    const size_t base_offset = (size_t)writer.tellp() - start_spos;
+
+    // rarefs
+
+    new_header.rarefpool_descs_offset = 0;
+
+    cp::stdstream_wrapper<std::ostream> ar(writer);
+
+    uint32_t rarefpool_descs_size = 0;
+    uint32_t rarefpool_data_size = 0;
+
+    cnameset np;
+
+    for (auto& cn : m_rarefs)
+    {
+      np.insert(cn);
+    }
+
+    if (m_uk1 == 0)
+    {
+      np.serialize_out<9>(ar, new_header.rarefpool_descs_offset, rarefpool_descs_size, rarefpool_data_size);
+    }
+    else // cname as hashes (but pooled.. lol)
+    {
+      const uint32_t descs_cnt = static_cast<uint32_t>(m_rarefs.size());
+      rarefpool_descs_size = descs_cnt * 4;
+      rarefpool_data_size = descs_cnt * 8;
+
+      std::vector<uint32_t> descs; descs.reserve(descs_cnt);
+      std::vector<uint64_t> hashes; hashes.reserve(descs_cnt);
+
+      uint32_t off = new_header.rarefpool_descs_offset + rarefpool_descs_size;
+
+      for (auto& cn : m_rarefs)
+      {
+        constexpr uint32_t desc_size_component = (8 << (32 - 9));
+        descs.emplace_back(desc_size_component | off);
+        off += 8;
+        hashes.emplace_back(cn.hash);
+      }
+
+      ar.serialize_pods_array_raw(descs.data(), descs_cnt);
+      ar.serialize_pods_array_raw(hashes.data(), descs_cnt);
+    }
+
+    new_header.rarefpool_data_offset = new_header.rarefpool_descs_offset + rarefpool_descs_size;
+
+    // section 3+4: string pool
+    const uint32_t strpool_descs_offset = (uint32_t)((size_t)writer.tellp() - base_spos);
+    new_header.strpool_descs_offset = (uint32_t)strpool_descs_offset;
+
+    // ----------------------------------------------
+
+    //CStringPool strpool;
+    CSystemSerCtx& serctx = const_cast<CSystemSerCtx&>(m_serctx);
+    // here we can't really remove handle-objects because there might be hidden handles in unsupported types
+    serctx.m_objects.assign(m_objects.begin(), m_objects.end());
+    serctx.m_objects.insert(serctx.m_objects.end(), m_handle_objects.begin(), m_handle_objects.end());
+    serctx.rebuild_handlemap();
+
+    std::ostringstream ss;
+    std::vector<obj_desc_t> obj_descs;
+    obj_descs.reserve(serctx.m_objects.size()); // ends up higher in the presence of handles
+
+    // serctx.m_objects is extended during object serialization (handles)
+    for (size_t i = 0; i < serctx.m_objects.size(); ++i)
+    {
+      auto& obj = serctx.m_objects[i];
+      const uint32_t tmp_offset = (uint32_t)ss.tellp();
+      const uint16_t name_idx = serctx.strpool.to_idx(obj->ctypename().c_str());
+      obj_descs.emplace_back(name_idx, tmp_offset);
+      if (!obj->serialize_out(ss, serctx))
+        return false;
+    }
+
+    // time to write strpool
+    uint32_t strpool_data_size = 0;
+    uint32_t strpool_descs_size = 0;
+    if (!serctx.strpool.serialize_out(writer, strpool_descs_size, strpool_data_size, strpool_descs_offset))
+      return false;
+
+    new_header.strpool_data_offset = strpool_descs_offset + strpool_descs_size;
+
+    new_header.obj_descs_offset = new_header.strpool_data_offset + strpool_data_size;
+
+    // reoffset offsets
+    const uint32_t obj_descs_size = (uint32_t)(obj_descs.size() * sizeof(obj_desc_t));
+    const uint32_t objdata_offset = new_header.obj_descs_offset + obj_descs_size;
+
+    new_header.objdata_offset = objdata_offset;
+
+    // reoffset offsets
+    for (auto& desc : obj_descs)
+      desc.data_offset += objdata_offset;
+
+    // write obj descs + data
+    writer.write((char*)obj_descs.data(), obj_descs_size);
+    auto objdata = ss.str(); // not optimal but didn't want to depend on boost and no time to dev a mem stream for now
+    writer.write(objdata.data(), objdata.size());
+    auto end_spos = writer.tellp();
+
+    // at this point data should be correct except blob_size and header
+    // so let's rewrite them
+
+    writer.seekp(start_spos);
+    writer << cbytes_ref(new_header); 
+
+    // return to end of data
+    writer.seekp(end_spos);
+
+    return true;
+  }
+};
+
@@ -0,0 +1,56 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include "csystem_serctx.hpp"
+
+// Object data of a CSystem load, shared with its lazily decoded objects
+// (see CObject::serialize_in_lazy) and its CSystemSerCache.
+//
+// Pending fields are decoded with the serialization context of the system:
+// its string pool and its objects list, which keeps the loaded objects at
+// their positions while any of them has pending fields (handles).
+// The system detaches itself when it reloads or is destroyed, fields still
+// pending then can't be decoded anymore and are only written back raw.
+//
+// The object data is a span of storage: either the whole blob the system
+// was read into (stream loads, no copy) or a copy of the object region of
+// a blob the system doesn't own (e.g. node data, which can be reassigned).
+class CSystemLoadData
+{
+  std::recursive_mutex m_mtx;
+  CSystemSerCtx* m_serctx;
+
+public:
+  // objdata must be in storage
+  CSystemLoadData(std::vector<char>&& storage, std::span<const char> objdata, CSystemSerCtx* serctx)
+    : m_serctx(serctx), storage(std::move(storage)), objdata(objdata) {}
+
+  CSystemLoadData(std::span<const char> objdata, CSystemSerCtx* serctx)
+    : m_serctx(serctx), storage(objdata.begin(), objdata.end()), objdata(storage) {}
+
+  CSystemLoadData(const CSystemLoadData&) = delete;
+  CSystemLoadData& operator=(const CSystemLoadData&) = delete;
+
+  const std::vector<char> storage;
+  const std::span<const char> objdata;
+
+  // calls fn with the context if still attached, returns false otherwise
+  template <typename Fn>
+  bool with_serctx(Fn&& fn)
+  {
+    std::lock_guard<std::recursive_mutex> lock(m_mtx);
+    if (!m_serctx)
+      return false;
+    return fn(*m_serctx);
+  }
+
+  void detach()
+  {
+    std::lock_guard<std::recursive_mutex> lock(m_mtx);
+    m_serctx = nullptr;
+  }
+};
+
@@ -0,0 +1,411 @@
+#pragma once
+#include <inttypes.h>
+#include <algorithm>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "cpinternals/common.hpp"
+#include "cpinternals/ctypes.hpp"
+#include "cpinternals/io/span_reader.hpp"
+#include "CStringPool.hpp"
+#include "csystem.hpp"
+
+// Read-only scan of a system blob, for bulk reads that don't need the
+// editable objects (e.g. CStats::extract_columns).
+// The string pool is read and the objects are located, nothing else is
+// decoded: no CObject or property is built, fields are found by their
+// serialized name and their values are read in place.
+// The blob must outlive this.
+class CSystemRaw
+{
+public:
+  static constexpr uint32_t npos = (uint32_t)-1;
+  // nesting of inline objects and arrays skip_value goes through
+  static constexpr uint32_t max_depth = 64;
+
+  struct field_t
+  {
+    uint16_t name_idx       = 0;
+    uint16_t ctypename_idx  = 0;
+    // from the start of the value to the end of the object (the value of
+    // the last field of an inline object has no known end)
+    std::span<const char> data;
+  };
+
+protected:
+  // same layout as CObject's
+  struct serial_field_desc_t
+  {
+    uint16_t name_idx       = 0;
+    uint16_t ctypename_idx  = 0;
+    uint32_t data_offset    = 0;
+  };
+
+  static_assert(sizeof(serial_field_desc_t) == 8);
+
+  struct object_t
+  {
+    uint32_t class_idx = 0;
+    std::span<const char> blob;
+  };
+
+  CStringPool m_strpool;
+  std::vector<object_t> m_objects;
+  size_t m_root_objects_cnt = 0;
+
+public:
+  CSystemRaw() = default;
+
+  // blob with its size prefix, same as CSystem::serialize_in
+  bool parse(cp::csav::node_span_reader& reader)
+  {
+    uint32_t blob_size = 0;
+    if (!reader.read_pod(blob_size))
+      return false;
+
+    const auto blob = reader.read_span(blob_size);
+    if (reader.failed())
+      return false;
+
+    return parse_sized(blob);
+  }
+
+  // same checks as CSystem::serialize_in_blob
+  bool parse_sized(std::span<const char> blob)
+  {
+    m_strpool = CStringPool();
+    m_objects.clear();
+    m_root_objects_cnt = 0;
+
+    cp::span_reader reader(blob);
+
+    CSystem::header_t header;
+    if (!reader.read(header))
+      return false;
+
+    if (header.obj_descs_offset < header.strpool_data_offset)
+      return false;
+    if (header.objdata_offset < header.obj_descs_offset)
+      return false;
+
+    size_t subsys_cnt = 0;
+    if (header.cnames_cnt > 1)
+    {
+      uint32_t cnames_cnt = 0;
+      if (!reader.read(cnames_cnt) || cnames_cnt != header.cnames_cnt)
+        return false;
+      if (!reader.skip(cnames_cnt * sizeof(CName)))
+        return false;
+      subsys_cnt = cnames_cnt;
+    }
+
+    const size_t base_offset = reader.tell();
+    if (base_offset + header.objdata_offset > blob.size())
+      return false;
+
+    const uint32_t strpool_descs_size = header.strpool_data_offset;
+    const uint32_t strpool_data_size = header.obj_descs_offset - strpool_descs_size;
+    if (!m_strpool.serialize_in(reader, strpool_descs_size, strpool_data_size))
+      return false;
+
+    const size_t obj_descs_size = header.objdata_offset - header.obj_descs_offset;
+    if (obj_descs_size % sizeof(CSystem::obj_desc_t) != 0)
+      return false;
+
+    const size_t obj_descs_cnt = obj_descs_size / sizeof(CSystem::obj_desc_t);
+    if (obj_descs_cnt == 0)
+      return base_offset + header.objdata_offset == blob.size();
+
+    if (base_offset + header.obj_descs_offset != reader.tell())
+      return false;
+
+    const char* const pobj_descs = blob.data() + reader.tell();
+    const std::span<const char> objdata = blob.subspan(base_offset + header.objdata_offset);
+
+    // objects end where the next one starts
+    m_objects.resize(obj_descs_cnt);
+    size_t next_obj_offset = objdata.size();
+    for (size_t i = obj_descs_cnt; i-- > 0;)
+    {
+      CSystem::obj_desc_t desc;
+      std::memcpy(&desc, pobj_descs + i * sizeof(desc), sizeof(desc));
+
+      if (desc.data_offset < header.objdata_offset || desc.name_idx >= m_strpool.size())
+        return false;
+
+      const size_t offset = desc.data_offset - header.objdata_offset;
+      if (offset > next_obj_offset)
+        return false;
+
+      m_objects[i] = object_t{desc.name_idx, objdata.subspan(offset, next_obj_offset - offset)};
+      next_obj_offset = offset;
+    }
+
+    m_root_objects_cnt = std::min(std::max(subsys_cnt, (size_t)1), obj_descs_cnt);
+    return true;
+  }
+
+  const CStringPool& strpool() const { return m_strpool; }
+
+  // all the serialized objects, handles are indices in this list
+  size_t objects_count() const { return m_objects.size(); }
+  size_t root_objects_count() const { return m_root_objects_cnt; }
+
+  uint32_t object_class_idx(size_t i) const { return m_objects[i].class_idx; }
+  std::span<const char> object_blob(size_t i) const { return m_objects[i].blob; }
+
+  // strpool idx of s, npos if the blob doesn't use that string (then no
+  // field has that name)
+  uint32_t find_string(std::string_view s) const
+  {
+    return const_cast<CStringPool&>(m_strpool).to_idx(s, false);
+  }
+
+  // calls fn(const field_t&) for each field of an object (serialized or
+  // inline), stops early if fn returns false
+  template <typename Fn>
+  bool for_each_field(std::span<const char> obj, Fn&& fn) const
+  {
+    cp::span_reader reader(obj);
+
+    uint16_t fields_cnt = 0;
+    if (!reader.read(fields_cnt))
+      return false;
+
+    for (uint16_t i = 0; i < fields_cnt; ++i)
+    {
+      serial_field_desc_t desc;
+      if (!reader.read(desc))
+        return false;
+      if (desc.name_idx >= m_strpool.size() || desc.ctypename_idx >= m_strpool.size())
+        return false;
+      if (desc.data_offset > obj.size())
+        return false;
+
+      if (!fn(field_t{desc.name_idx, desc.ctypename_idx, obj.subspan(desc.data_offset)}))
+        break;
+    }
+
+    return true;
+  }
+
+  bool find_field(std::span<const char> obj, uint32_t name_idx, field_t& field) const
+  {
+    bool found = false;
+    const bool ok = for_each_field(obj, [&](const field_t& f) {
+      if (f.name_idx != name_idx)
+        return true;
+      field = f;
+      found = true;
+      return false;
+    });
+    return ok && found;
+  }
+
+  // dictionary encoding of strpool strings into names (the name columns
+  // of extracted tables), strings are converted once
+  class name_dict
+  {
+  public:
+    static constexpr uint16_t none = 0xFFFF;
+
+    name_dict(const CSystemRaw& raw, std::vector<gname>& names)
+      : m_raw(raw), m_names(names), m_map(raw.strpool().size(), none) {}
+
+    uint16_t operator()(uint32_t strpool_idx)
+    {
+      if (strpool_idx >= m_map.size())
+        return none;
+
+      uint16_t& idx = m_map[strpool_idx];
+      if (idx == none)
+      {
+        idx = (uint16_t)m_names.size();
+        m_names.emplace_back(m_raw.strpool().view_from_idx(strpool_idx));
+      }
+      return idx;
+    }
+
+  protected:
+    const CSystemRaw& m_raw;
+    std::vector<gname>& m_names;
+    std::vector<uint16_t> m_map;
+  };
+
+  std::string_view field_ctypename(const field_t& field) const
+  {
+    return m_strpool.view_from_idx(field.ctypename_idx);
+  }
+
+  // pod at the start of a value, e.g. Float, Uint32, a handle (u32) or the
+  // strpool idx (u16) of a CName or enum value
+  template <typename T>
+  static bool read_value(const field_t& field, T& val)
+  {
+    if (field.data.size() < sizeof(T))
+      return false;
+    std::memcpy(&val, field.data.data(), sizeof(T));
+    return true;
+  }
+
+  // calls fn(std::span<const char> elt) for each element of a dynamic array
+  // value, elements are delimited by the size of their type (elements
+  // without bytes, e.g. [0]Int32, fail)
+  template <typename Fn>
+  bool for_each_element(const field_t& field, Fn&& fn) const
+  {
+    constexpr std::string_view prefix = "array:";
+    const std::string_view ctypename = field_ctypename(field);
+    if (ctypename.substr(0, prefix.size()) != prefix)
+      return false;
+
+    const std::string_view elt_ctypename = ctypename.substr(prefix.size());
+
+    cp::span_reader reader(field.data);
+    uint32_t cnt = 0;
+    if (!reader.read(cnt))
+      return false;
+
+    for (uint32_t i = 0; i < cnt; ++i)
+    {
+      const size_t start = reader.tell();
+      if (!skip_value(reader, elt_ctypename, 1) || reader.tell() == start)
+        return false;
+      fn(field.data.subspan(start, reader.tell() - start));
+    }
+
+    return true;
+  }
+
+  // moves reader past a value of type ctypename, fails on the types whose
+  // size isn't known (same as CUnknownProperty, these only work as last
+  // field of a serialized object), past max_depth and on array elements
+  // without bytes (their count can't be checked against the blob)
+  bool skip_value(cp::span_reader& reader, std::string_view ctypename, uint32_t depth = 0) const
+  {
+    if (depth > max_depth)
+      return false;
+
+    if (const size_t size = fixed_size(ctypename))
+      return reader.skip(size);
+
+    if (ctypename == "NodeRef")
+    {
+      uint16_t cnt = 0;
+      return reader.read(cnt) && reader.skip(cnt);
+    }
+
+    constexpr std::string_view array_prefix = "array:";
+    if (ctypename.substr(0, array_prefix.size()) == array_prefix)
+    {
+      const std::string_view elt_ctypename = ctypename.substr(array_prefix.size());
+      uint32_t cnt = 0;
+      if (!reader.read(cnt))
+        return false;
+      return skip_elements(reader, elt_ctypename, cnt, depth + 1);
+    }
+
+    if (ctypename.size() && ctypename[0] == '[')
+    {
+      const size_t pos = ctypename.find(']');
+      if (pos == std::string_view::npos)
+        return false;
+
+      size_t cnt = 0;
+      for (char c : ctypename.substr(1, pos - 1))
+      {
+        if (c < '0' || c > '9')
+          return false;
+        cnt = cnt * 10 + (c - '0');
+      }
+
+      return skip_elements(reader, ctypename.substr(pos + 1), cnt, depth + 1);
+    }
+
+    if (ctypename.find(':') != std::string_view::npos)
+      return false;
+
+    // enum (strpool idx) or inline object
+    if (CEnum_resolver::get().is_registered(ctypename))
+      return reader.skip(sizeof(uint16_t));
+
+    return skip_object(reader, depth + 1);
+  }
+
+  // an inline object ends with the value of its last field
+  bool skip_object(cp::span_reader& reader, uint32_t depth = 0) const
+  {
+    const size_t start = reader.tell();
+
+    uint16_t fields_cnt = 0;
+    if (!reader.read(fields_cnt))
+      return false;
+    if (fields_cnt == 0)
+      return true;
+
+    serial_field_desc_t last;
+    if (!reader.skip((fields_cnt - 1) * sizeof(serial_field_desc_t)) || !reader.read(last))
+      return false;
+    if (last.ctypename_idx >= m_strpool.size())
+      return false;
+
+    // values are after the descriptors
+    if (last.data_offset < sizeof(uint16_t) + fields_cnt * sizeof(serial_field_desc_t))
+      return false;
+
+    return reader.seek(start + last.data_offset)
+      && skip_value(reader, m_strpool.view_from_idx(last.ctypename_idx), depth);
+  }
+
+protected:
+  bool skip_elements(cp::span_reader& reader, std::string_view elt_ctypename, size_t cnt, uint32_t depth) const
+  {
+    for (size_t i = 0; i < cnt; ++i)
+    {
+      const size_t start = reader.tell();
+      if (!skip_value(reader, elt_ctypename, depth) || reader.tell() == start)
+        return false;
+    }
+    return true;
+  }
+
+  // 0 if not fixed
+  static size_t fixed_size(std::string_view ctypename)
+  {
+    constexpr std::string_view handle_prefix = "handle:";
+    if (ctypename.substr(0, handle_prefix.size()) == handle_prefix)
+      return sizeof(uint32_t);
+
+    struct fixed_type_t
+    {
+      std::string_view ctypename;
+      size_t size;
+    };
+
+    static constexpr fixed_type_t fixed_types[] = {
+      { "Bool",       1 },
+      { "Uint8",      1 },
+      { "Int8",       1 },
+      { "Uint16",     2 },
+      { "Int16",      2 },
+      { "CName",      2 }, // strpool idx
+      { "Uint32",     4 },
+      { "Int32",      4 },
+      { "Float",      4 },
+      { "Uint64",     8 },
+      { "Int64",      8 },
+      { "TweakDBID",  8 },
+      { "CRUID",      8 },
+    };
+
+    for (const auto& t : fixed_types)
+    {
+      if (t.ctypename == ctypename)
+        return t.size;
+    }
+    return 0;
+  }
+};
+
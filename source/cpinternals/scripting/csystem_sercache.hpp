@@ -0,0 +1,110 @@
+#pragma once
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "cobject.hpp"
+#include "csystem_loaddata.hpp"
+
+// Serialized bytes of the objects of the last CSystem load.
+//
+// Objects are marked dirty by their events (any EObjectEvent, nested and
+// handled objects included), clean ones can be written back verbatim.
+// Their blobs contain string pool indices and handles (indices in the
+// serialized objects list): the pool is only appended to on save, and the
+// handles stay valid as long as the loaded objects keep their positions,
+// see matches().
+class CSystemSerCache
+  : public CObjectListener
+{
+  struct entry_t
+  {
+    CObjectSPtr obj;
+    size_t offset = 0; // in m_loaddata->objdata
+    size_t size = 0;
+    bool dirty = false;
+  };
+
+  std::shared_ptr<const CSystemLoadData> m_loaddata;
+  std::vector<entry_t> m_entries;
+  std::unordered_map<const CObject*, size_t> m_indices;
+
+public:
+  CSystemSerCache() = default;
+
+  CSystemSerCache(const CSystemSerCache&) = delete;
+  CSystemSerCache& operator=(const CSystemSerCache&) = delete;
+
+  ~CSystemSerCache() override
+  {
+    for (auto& entry : m_entries)
+      entry.obj->remove_listener(this);
+  }
+
+  // blobs are spans of loaddata->objdata, one per object
+  void assign(const std::vector<CObjectSPtr>& objects, const std::shared_ptr<const CSystemLoadData>& loaddata, const std::vector<std::span<const char>>& blobs)
+  {
+    m_loaddata = loaddata;
+    const char* const objdata = m_loaddata->objdata.data();
+
+    m_entries.resize(objects.size());
+    m_indices.reserve(objects.size());
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+      auto& entry = m_entries[i];
+      entry.obj = objects[i];
+      entry.offset = blobs[i].data() - objdata;
+      entry.size = blobs[i].size();
+      m_indices.emplace(entry.obj.get(), i);
+      entry.obj->add_listener(this);
+    }
+  }
+
+  // true if the loaded objects are still the first ones, at the same positions
+  bool matches(const std::vector<CObjectSPtr>& objects) const
+  {
+    if (objects.size() < m_entries.size())
+      return false;
+
+    for (size_t i = 0; i < m_entries.size(); ++i)
+    {
+      if (objects[i] != m_entries[i].obj)
+        return false;
+    }
+    return true;
+  }
+
+  // false if the object at idx has been modified since the load
+  bool find_clean_blob(size_t idx, std::span<const char>& out) const
+  {
+    if (idx >= m_entries.size() || m_entries[idx].dirty)
+      return false;
+
+    const auto& entry = m_entries[idx];
+    out = std::span<const char>(m_loaddata->objdata.data() + entry.offset, entry.size);
+    return true;
+  }
+
+  // bytes of the entries and of their index (load data excluded)
+  size_t memory_usage() const
+  {
+    return sizeof(CSystemSerCache) + cp::heap_bytes(m_entries) + cp::heap_bytes(m_indices);
+  }
+
+  size_t dirty_count() const
+  {
+    size_t cnt = 0;
+    for (const auto& entry : m_entries)
+      cnt += entry.dirty ? 1 : 0;
+    return cnt;
+  }
+
+protected:
+  void on_cobject_event(const CObject& obj, EObjectEvent evt) override
+  {
+    auto it = m_indices.find(&obj);
+    if (it != m_indices.end())
+      m_entries[it->second].dirty = true;
+  }
+};
+
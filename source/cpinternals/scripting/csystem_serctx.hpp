@@ -1,62 +1,134 @@
 #pragma once
 #include <vector>
 #include <memory>
-#include <fstream>
+#include <mutex>
 #include <spdlog/spdlog.h>
 
 #include "fwd.hpp"
 #include "CStringPool.hpp"
+#include "csystem_sertrace.hpp"
+
+// define CP_DISABLE_SERCTX_TRACE to compile the trace calls out
+#ifdef CP_DISABLE_SERCTX_TRACE
+inline constexpr bool serctx_trace_compiled = false;
+#else
+inline constexpr bool serctx_trace_compiled = true;
+#endif
 
 class CSystemSerCtx
 {
   friend class CSystem;
-  friend class archive_test;
+  friend class CSystemBlob;
 
 protected:
   std::vector<CObjectSPtr> m_objects;
-  std::unordered_map<uintptr_t, uint32_t> m_ptrmap;
 
-  std::ofstream m_logfile;
+  // object pointer -> handle, open addressing (linear probing), load < 1/2
+  struct handle_slot
+  {
+    const CObject* obj = nullptr;
+    uint32_t handle = 0;
+  };
+
+  std::vector<handle_slot> m_handle_slots;
+  size_t m_handle_slots_used = 0;
+
+  // objects decoded in parallel can't link handles (it registers listeners
+  // on the pointed objects), CSystem links them once all are decoded.
+  bool m_defer_handles = false;
+  std::mutex m_deferred_mtx;
+  std::vector<std::pair<CHandleProperty*, uint32_t>> m_deferred_handles;
+
+  // null unless enabled
+  std::unique_ptr<CSystemSerTrace> m_trace;
 
 public:
-  // TODO: include a logging lib!!
+  CSystemSerCtx() = default;
+  ~CSystemSerCtx() = default;
+
+  CStringPool strpool;
 
-  CSystemSerCtx()
+public:
+  // tracing is disabled by default, a disabled trace costs a branch per call
+  void enable_trace(size_t capacity = 0x10000)
   {
-    //m_logfile.open(fmt::format("CSystemSerLOG_{:08X}.txt", (uint32_t)(uint64_t)this));
+    m_trace = std::make_unique<CSystemSerTrace>(capacity);
   }
 
-  ~CSystemSerCtx()
+  void disable_trace()
   {
-    //m_logfile.close();
+    m_trace.reset();
   }
 
-  void log(std::string_view s)
+  // heap bytes of the object list and handle tables (string pool excluded)
+  size_t memory_usage() const
   {
-    //m_logfile << s << std::endl;
+    return cp::heap_bytes(m_objects) + cp::heap_bytes(m_handle_slots) + cp::heap_bytes(m_deferred_handles);
   }
 
-  CStringPool strpool;
+  bool is_tracing() const
+  {
+    return serctx_trace_compiled && m_trace;
+  }
+
+  // null if disabled
+  CSystemSerTrace* trace_buffer() const
+  {
+    return m_trace.get();
+  }
+
+  void trace(ESerTraceEvent evt, gname ctypename, uint64_t size = 0,
+    gname field_name = {}, gname field_ctypename = {}, uint32_t field_idx = 0)
+  {
+    if (!is_tracing())
+      return;
+
+    CSerTraceRecord rec;
+    rec.evt = evt;
+    rec.field_idx = field_idx;
+    rec.size = size;
+    rec.ctypename = ctypename;
+    rec.field_name = field_name;
+    rec.field_ctypename = field_ctypename;
+    m_trace->push(rec);
+  }
 
 public:
+  // one pass over m_objects, the table is reused between saves
   void rebuild_handlemap()
   {
-    m_ptrmap.clear();
+    size_t capacity = 0x100;
+    while (capacity < m_objects.size() * 2)
+      capacity *= 2;
+
+    m_handle_slots.assign(capacity, handle_slot{});
+    m_handle_slots_used = 0;
     for (size_t i = 0; i < m_objects.size(); ++i)
     {
-      const uintptr_t key = (uintptr_t)m_objects[i].get();
-      m_ptrmap.emplace(key, (uint32_t)i);
+      // duplicates keep their first handle
+      handle_slot& slot = find_handle_slot(m_objects[i].get());
+      if (!slot.obj)
+        fill_handle_slot(slot, m_objects[i].get(), (uint32_t)i);
     }
   }
 
   uint32_t to_handle(const CObjectSPtr& obj)
   {
-    const uintptr_t key = (uintptr_t)obj.get();
-    auto it = m_ptrmap.find(key);
-    if (it != m_ptrmap.end())
-      return it->second;
+    if (m_handle_slots.empty())
+      rebuild_handlemap();
+
+    handle_slot* slot = &find_handle_slot(obj.get());
+    if (slot->obj)
+      return slot->handle;
+
+    if ((m_handle_slots_used + 1) * 2 > m_handle_slots.size())
+    {
+      grow_handlemap();
+      slot = &find_handle_slot(obj.get());
+    }
+
     uint32_t idx = (uint32_t)m_objects.size();
-    m_ptrmap.emplace(key, idx);
+    fill_handle_slot(*slot, obj.get(), idx);
     m_objects.push_back(obj);
     return idx;
   }
@@ -67,5 +139,53 @@ public:
       return nullptr;
     return m_objects[handle];
   }
+
+  bool is_valid_handle(uint32_t handle) const
+  {
+    return handle < m_objects.size() && m_objects[handle];
+  }
+
+  bool defers_handles() const
+  {
+    return m_defer_handles;
+  }
+
+  // thread-safe
+  void defer_handle(CHandleProperty* prop, uint32_t handle)
+  {
+    std::lock_guard<std::mutex> lock(m_deferred_mtx);
+    m_deferred_handles.emplace_back(prop, handle);
+  }
+
+protected:
+  // slot of obj, or the empty slot where it would go
+  handle_slot& find_handle_slot(const CObject* obj)
+  {
+    const size_t mask = m_handle_slots.size() - 1;
+    // low bits of pointers are alignment
+    size_t i = (size_t)(((uint64_t)(uintptr_t)obj >> 4) * 0x9E3779B97F4A7C15ull >> 32) & mask;
+    while (m_handle_slots[i].obj && m_handle_slots[i].obj != obj)
+      i = (i + 1) & mask;
+    return m_handle_slots[i];
+  }
+
+  void fill_handle_slot(handle_slot& slot, const CObject* obj, uint32_t handle)
+  {
+    slot.obj = obj;
+    slot.handle = handle;
+    m_handle_slots_used++;
+  }
+
+  void grow_handlemap()
+  {
+    std::vector<handle_slot> old_slots(m_handle_slots.size() * 2);
+    old_slots.swap(m_handle_slots);
+    m_handle_slots_used = 0;
+    for (const auto& old_slot : old_slots)
+    {
+      if (old_slot.obj)
+        fill_handle_slot(find_handle_slot(old_slot.obj), old_slot.obj, old_slot.handle);
+    }
+  }
 };
 
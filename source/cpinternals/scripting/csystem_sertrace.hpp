@@ -0,0 +1,135 @@
+#pragma once
+#include <vector>
+#include <mutex>
+#include <ostream>
+#include <spdlog/spdlog.h>
+
+#include "cpinternals/common.hpp"
+
+// Serialization trace of a CSystem, for debugging new or broken types.
+//
+// Records are binary (names are gnames), nothing is formatted until the
+// trace is dumped. The last capacity records are kept (ring buffer).
+
+enum class ESerTraceEvent : uint8_t
+{
+  object_in,
+  object_in_lazy, // fields are decoded on access (field_in events)
+  object_out,
+  object_copied, // unmodified, written from its loaded blob
+  field_in,
+  field_in_out_of_order,
+  field_out,
+  field_out_failed,
+  prop_in,
+  prop_out,
+};
+
+struct CSerTraceRecord
+{
+  ESerTraceEvent evt = ESerTraceEvent::object_in;
+  uint32_t field_idx = 0; // serial index, field_in events only
+  uint64_t size = 0;      // bytes, if any
+  gname ctypename;        // of the object (field events) or property
+  gname field_name;
+  gname field_ctypename;
+};
+
+class CSystemSerTrace
+{
+  std::mutex m_mtx;
+  std::vector<CSerTraceRecord> m_records;
+  size_t m_capacity;
+  size_t m_head = 0; // next slot once full
+  size_t m_dropped = 0;
+
+public:
+  explicit CSystemSerTrace(size_t capacity)
+    : m_capacity(capacity ? capacity : 1)
+  {
+    m_records.reserve(m_capacity);
+  }
+
+  // thread-safe
+  void push(const CSerTraceRecord& rec)
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (m_records.size() < m_capacity)
+    {
+      m_records.push_back(rec);
+      return;
+    }
+    m_records[m_head] = rec;
+    m_head = (m_head + 1) % m_capacity;
+    m_dropped++;
+  }
+
+  void clear()
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_records.clear();
+    m_head = 0;
+    m_dropped = 0;
+  }
+
+  // oldest first
+  std::vector<CSerTraceRecord> records()
+  {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    std::vector<CSerTraceRecord> ret;
+    ret.reserve(m_records.size());
+    ret.insert(ret.end(), m_records.begin() + m_head, m_records.end());
+    ret.insert(ret.end(), m_records.begin(), m_records.begin() + m_head);
+    return ret;
+  }
+
+  void dump(std::ostream& os)
+  {
+    size_t dropped = 0;
+    {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      dropped = m_dropped;
+    }
+
+    if (dropped)
+      os << fmt::format("({} older records dropped)\n", dropped);
+
+    for (const auto& rec : records())
+    {
+      os << format(rec) << '\n';
+    }
+  }
+
+  static std::string format(const CSerTraceRecord& rec)
+  {
+    switch (rec.evt)
+    {
+      case ESerTraceEvent::object_in:
+        return fmt::format("serialized_in CObject {} in {} bytes", rec.ctypename.c_str(), rec.size);
+      case ESerTraceEvent::object_in_lazy:
+        return fmt::format("serialized_in CObject {} lazily in {} bytes", rec.ctypename.c_str(), rec.size);
+      case ESerTraceEvent::object_out:
+        return fmt::format("serialized_out CObject {} in {} bytes", rec.ctypename.c_str(), rec.size);
+      case ESerTraceEvent::object_copied:
+        return fmt::format("copied unmodified CObject {} in {} bytes", rec.ctypename.c_str(), rec.size);
+      case ESerTraceEvent::field_in:
+        return fmt::format("serialized_in ({}) {}::{} (ctype:{}) in {} bytes",
+          rec.field_idx, rec.ctypename.c_str(), rec.field_name.c_str(), rec.field_ctypename.c_str(), rec.size);
+      case ESerTraceEvent::field_in_out_of_order:
+        return fmt::format("serialized_in ({}) out of order {}::{} (ctype:{})",
+          rec.field_idx, rec.ctypename.c_str(), rec.field_name.c_str(), rec.field_ctypename.c_str());
+      case ESerTraceEvent::field_out:
+        return fmt::format("serialized_out {}::{} in {} bytes", rec.ctypename.c_str(), rec.field_name.c_str(), rec.size);
+      case ESerTraceEvent::field_out_failed:
+        return fmt::format("couldn't serialize_out {}::{}", rec.ctypename.c_str(), rec.field_name.c_str());
+      case ESerTraceEvent::prop_in:
+        return fmt::format("serialized_in {} in {} bytes", rec.ctypename.c_str(), rec.size);
+      case ESerTraceEvent::prop_out:
+        return fmt::format("serialized_out {} in {} bytes", rec.ctypename.c_str(), rec.size);
+      default:
+        break;
+    }
+    return "unknown event";
+  }
+};
+
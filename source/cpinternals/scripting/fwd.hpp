@@ -3,6 +3,7 @@
 
 class CStringPool;
 class CProperty;
+class CHandleProperty;
 class CObject;
 class CSystem;
 class CSystemSerCtx;
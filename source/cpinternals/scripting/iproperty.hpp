@@ -1,5 +1,6 @@
 #pragma once
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <memory>
 #include <list>
@@ -9,11 +10,14 @@
 #include <exception>
 
 #include "cpinternals/common.hpp"
+#include "cpinternals/common/memory_usage.hpp"
 #include "cpinternals/ctypes.hpp"
 #include "cpinternals/csav/node.hpp"
 #include "cpinternals/csav/serializers.hpp"
+#include "cpinternals/io/span_reader.hpp"
 #include "CStringPool.hpp"
 #include "csystem_serctx.hpp"
+#include "csystem_arena.hpp"
 
 #ifndef DISABLE_CP_IMGUI_WIDGETS
 #include <appbase/widgets/list_widget.hpp>
@@ -91,6 +95,10 @@ protected:
 public:
   virtual ~CProperty() = default;
 
+  // from the arena of the current scope if any (see CSystemArena)
+  static void* operator new(size_t size) { return CSystemArena::allocate(size); }
+  static void operator delete(void* p) { CSystemArena::deallocate(p); }
+
   CPropertyOwner* owner() const  { return m_owner; }
   EPropertyKind kind() const { return m_kind; }
 
@@ -109,12 +117,42 @@ public:
   // todo: dump them...
   virtual bool has_default_value() const { return false; }
 
+  // memory accounting, nested properties and owned objects included
+  virtual void accumulate_memory_usage(cp::memory_usage& mu) const = 0;
+
+protected:
+  static void count_prop(cp::memory_usage& mu, size_t bytes)
+  {
+    ++mu.props_cnt;
+    mu.prop_bytes += bytes;
+  }
+
+public:
+
   // serialization
 
 protected:
   // when called, a data_modified event is sent automatically by base class' serialize_in(..)
   virtual bool serialize_in_impl(std::istream& is, CSystemSerCtx& serctx) = 0;
 
+  // contiguous fast path, same contract as the stream one.
+  // defaults to the stream implementation over the remaining bytes.
+  virtual bool serialize_in_impl(span_reader& reader, CSystemSerCtx& serctx)
+  {
+    const auto rest = reader.remaining_span();
+    span_istreambuf sbuf(rest.data(), rest.data() + rest.size());
+    std::istream is(&sbuf);
+
+    const bool ok = serialize_in_impl(is, serctx);
+
+    // the buffer's position is still valid if the stream failed
+    const auto read = sbuf.pubseekoff(0, std::ios_base::cur, std::ios_base::in);
+    if (read < 0 || !reader.skip((size_t)read))
+      reader.set_error();
+
+    return ok && !is.bad();
+  }
+
 public:
   bool serialize_in(std::istream& is, CSystemSerCtx& serctx)
   {
@@ -123,8 +161,26 @@ public:
     return ok;
   }
 
+  bool serialize_in(span_reader& reader, CSystemSerCtx& serctx)
+  {
+    bool ok = serialize_in_impl(reader, serctx);
+    post_cproperty_event(EPropertyEvent::data_serialized_in);
+    return ok;
+  }
+
   virtual bool serialize_out(std::ostream& os, CSystemSerCtx& serctx) const = 0;
 
+  // defaults to the stream implementation
+  virtual bool serialize_out(vector_writer& writer, CSystemSerCtx& serctx) const
+  {
+    std::ostringstream ss;
+    if (!serialize_out(ss, serctx))
+      return false;
+    const auto data = ss.str();
+    writer.write_bytes(data.data(), data.size());
+    return true;
+  }
+
   // gui (define DISABLE_CP_IMGUI_WIDGETS to disable implementations)
 
 protected:
@@ -209,6 +265,11 @@ public:
 
   gname ctypename() const override { return m_ctypename; };
 
+  void accumulate_memory_usage(cp::memory_usage& mu) const override
+  {
+    count_prop(mu, sizeof(*this) + cp::heap_bytes(m_data));
+  }
+
   bool serialize_in_impl(std::istream& is, CSystemSerCtx& serctx) override
   {
     std::streampos beg = is.tellg();
@@ -222,12 +283,24 @@ public:
     return is.good();
   }
 
+  bool serialize_in_impl(span_reader& reader, CSystemSerCtx& serctx) override
+  {
+    m_data.resize(reader.remaining());
+    return reader.read_bytes(m_data.data(), m_data.size());
+  }
+
   virtual bool serialize_out(std::ostream& os, CSystemSerCtx& serctx) const
   {
     os.write(m_data.data(), m_data.size());
     return true;
   }
 
+  bool serialize_out(vector_writer& writer, CSystemSerCtx& serctx) const override
+  {
+    writer.write_bytes(m_data.data(), m_data.size());
+    return true;
+  }
+
 #ifndef DISABLE_CP_IMGUI_WIDGETS
 
   [[nodiscard]] bool imgui_widget_impl(const char* label, bool editable) override
@@ -0,0 +1,245 @@
+#include <cpinternals/startup_snapshot.hpp>
+
+#include <utility>
+
+#include <spdlog/spdlog.h>
+
+#include <cpinternals/asset_db.hpp>
+#include <cpinternals/ctypes.hpp>
+#include <cpinternals/common/instrumentation.hpp>
+#include <cpinternals/os/file_mapping.hpp>
+
+namespace cp {
+
+namespace {
+
+using asset_db::db_kind;
+using asset_db::source_stamp;
+using asset_db::detail::db_view;
+using asset_db::detail::words_reader;
+
+constexpr size_t source_words = 9;
+
+void push_u64(asset_db::db_builder& builder, uint64_t x)
+{
+  builder.push((uint32_t)x);
+  builder.push((uint32_t)(x >> 32));
+}
+
+uint64_t read_u64(words_reader& reader)
+{
+  const uint64_t lo = reader.word();
+  return lo | ((uint64_t)reader.word() << 32);
+}
+
+void push_names(asset_db::db_builder& builder, std::span<const gname> names)
+{
+  builder.push((uint32_t)names.size());
+  for (const auto& name : names)
+  {
+    builder.push(builder.intern(name.strv()));
+  }
+}
+
+void read_names(words_reader& reader, std::vector<gname>& out)
+{
+  out.resize(reader.count(1));
+  for (auto& name : out)
+  {
+    name = reader.string();
+  }
+}
+
+// the recorded sources must be the same paths, with the same stamps
+bool sources_match(const db_view& view, std::span<const std::filesystem::path> sources)
+{
+  const std::vector<gname> no_strings;
+  words_reader reader(view.words, no_strings);
+
+  if (reader.count(source_words) != sources.size())
+  {
+    return false;
+  }
+
+  for (const auto& src : sources)
+  {
+    const uint32_t path_idx = reader.word();
+    if (path_idx >= view.hdr.strings_cnt || view.string(path_idx) != src.generic_string())
+    {
+      return false;
+    }
+
+    const source_stamp src_stamp = {read_u64(reader), read_u64(reader)};
+    const source_stamp db_stamp = {read_u64(reader), read_u64(reader)};
+    if (!reader.ok()
+      || !(src_stamp == source_stamp::of_file(src))
+      || !(db_stamp == source_stamp::of_file(asset_db::db_path_of(src))))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+} // namespace
+
+bool load_startup_snapshot(const std::filesystem::path& path, std::span<const std::filesystem::path> sources)
+{
+  scoped_span span("init.snapshot.load");
+
+  os::file_mapping mapping;
+  if (!mapping.open(path))
+  {
+    return false;
+  }
+
+  db_view view;
+  if (!view.parse(mapping.view(), db_kind::snapshot))
+  {
+    SPDLOG_WARN("{} is corrupt or from another version", path.string());
+    return false;
+  }
+
+  if (!sources_match(view, sources))
+  {
+    SPDLOG_INFO("{} is stale", path.string());
+    return false;
+  }
+
+  span.set_bytes(mapping.view().size());
+
+  // the pool keeps views of the strings, the mapping is never released
+  asset_db::detail::retain(std::move(mapping));
+  const auto strings = asset_db::detail::register_strings(view);
+  words_reader reader(view.words, strings);
+
+  const uint32_t sources_cnt = reader.count(source_words);
+  for (size_t i = 0; i < sources_cnt * source_words; ++i)
+  {
+    reader.word();
+  }
+
+  TweakDBID_resolver::image tdbid_img;
+  read_names(reader, tdbid_img.full_list);
+  read_names(reader, tdbid_img.item_list);
+  read_names(reader, tdbid_img.attachment_list);
+  read_names(reader, tdbid_img.vehicle_list);
+  read_names(reader, tdbid_img.unknown_list);
+  tdbid_img.ids.resize(reader.count(3));
+  for (auto& [id, name] : tdbid_img.ids)
+  {
+    name = reader.string();
+    id = TweakDBID(read_u64(reader));
+  }
+
+  // cnames are looked up by the fnv1a64 hashes of their strings
+  std::vector<gname> cnames(reader.count(1));
+  std::vector<uint64_t> cname_hashes(cnames.size());
+  bool cnames_ok = true;
+  for (size_t i = 0; i < cnames.size() && cnames_ok; ++i)
+  {
+    const uint32_t idx = reader.word();
+    cnames_ok = idx < strings.size();
+    if (cnames_ok)
+    {
+      cnames[i] = strings[idx];
+      cname_hashes[i] = view.hashes[idx];
+    }
+  }
+
+  std::vector<gname> cfacts;
+  read_names(reader, cfacts);
+
+  std::vector<std::pair<gname, std::vector<CEnum_member>>> enums(reader.count(2));
+  for (auto& [name, members] : enums)
+  {
+    name = reader.string();
+    const uint32_t members_cnt = reader.count(1);
+    members.reserve(members_cnt);
+    for (uint32_t i = 0; i < members_cnt; ++i)
+    {
+      members.emplace_back(reader.string(), i);
+    }
+  }
+
+  if (!cnames_ok || !reader.ok() || !reader.at_end())
+  {
+    SPDLOG_ERROR("{} has unexpected content", path.string());
+    return false;
+  }
+
+  TweakDBID_resolver::get().adopt_image(std::move(tdbid_img));
+  CName_resolver::get().adopt_sorted(std::move(cnames), cname_hashes);
+  CFact_resolver::get().adopt_sorted_names(std::move(cfacts));
+
+  auto& enum_resolver = CEnum_resolver::get();
+  enum_resolver.clear();
+  enum_resolver.reserve(enums.size());
+  for (auto& [name, members] : enums)
+  {
+    enum_resolver.register_enum(name, std::make_shared<CEnum_desc>(name, std::move(members)));
+  }
+
+  SPDLOG_INFO("resolvers loaded from {} ({} strings)", path.string(), strings.size());
+  return true;
+}
+
+bool write_startup_snapshot(const std::filesystem::path& path, std::span<const std::filesystem::path> sources)
+{
+  scoped_span span("init.snapshot.write");
+
+  asset_db::db_builder builder(db_kind::snapshot);
+
+  builder.push((uint32_t)sources.size());
+  for (const auto& src : sources)
+  {
+    const auto src_stamp = source_stamp::of_file(src);
+    const auto db_stamp = source_stamp::of_file(asset_db::db_path_of(src));
+    builder.push(builder.intern(src.generic_string()));
+    push_u64(builder, src_stamp.size);
+    push_u64(builder, src_stamp.time);
+    push_u64(builder, db_stamp.size);
+    push_u64(builder, db_stamp.time);
+  }
+
+  const auto tdbid_img = TweakDBID_resolver::get().make_image();
+  push_names(builder, tdbid_img.full_list);
+  push_names(builder, tdbid_img.item_list);
+  push_names(builder, tdbid_img.attachment_list);
+  push_names(builder, tdbid_img.vehicle_list);
+  push_names(builder, tdbid_img.unknown_list);
+  builder.push((uint32_t)tdbid_img.ids.size());
+  for (const auto& [id, name] : tdbid_img.ids)
+  {
+    builder.push(builder.intern(name.strv()));
+    push_u64(builder, id.as_u64);
+  }
+
+  push_names(builder, *CName_resolver::get().sorted_names().get());
+  push_names(builder, *CFact_resolver::get().sorted_names().get());
+
+  const auto& enums = CEnum_resolver::get().enums();
+  builder.push((uint32_t)enums.size());
+  for (const auto& [name, desc] : enums)
+  {
+    const auto& members = std::as_const(*desc).members();
+    builder.push(builder.intern(name.strv()));
+    builder.push((uint32_t)members.size());
+    for (const auto& member : members)
+    {
+      builder.push(builder.intern(member.name().strv()));
+    }
+  }
+
+  if (!builder.write(path))
+  {
+    SPDLOG_WARN("couldn't write {}", path.string());
+    return false;
+  }
+
+  return true;
+}
+
+} // namespace cp
+
@@ -0,0 +1,37 @@
+#pragma once
+#include <filesystem>
+#include <span>
+
+#include <cpinternals/common.hpp>
+
+namespace cp {
+
+// Image of the resolvers filled by init_cpinternals (TweakDBIDs, CNames,
+// CFacts and CEnums) in the .cpdb layout (db_kind::snapshot, see
+// asset_db_format.hpp): one table of every string they reference and their
+// already sorted lists, ids and hashes.
+//
+// Loading it maps the file, registers the strings in the gname pool as views
+// of the mapping (no copies, hashes aren't recomputed) and hands the lists
+// to the resolvers as is: nothing is parsed, sorted or hashed again.
+// The image keeps the stamps (size, write time) of the source dbs and of
+// their compiled .cpdb, it is ignored if any of them changed.
+//
+// words layout:
+//   cnt, { path, src_size(2), src_time(2), db_size(2), db_time(2) }[cnt]
+//   TweakDBIDs: 5 lists (full, item, attachment, vehicle, unknown): cnt, name[cnt]
+//               cnt, { name, id_lo, id_hi }[cnt]
+//   CNames:     cnt, name[cnt]
+//   CFacts:     cnt, name[cnt]
+//   CEnums:     cnt, { name, members_cnt, member[members_cnt] }[cnt]
+
+// returns false if the image is missing, stale or corrupt, the resolvers
+// are then left untouched.
+bool load_startup_snapshot(const std::filesystem::path& path, std::span<const std::filesystem::path> sources);
+
+// writes the current state of the resolvers, sources are the paths of the
+// dbs they were loaded from.
+bool write_startup_snapshot(const std::filesystem::path& path, std::span<const std::filesystem::path> sources);
+
+} // namespace cp
+
@@ -4,12 +4,17 @@
 #include <filesystem>
 #include <iostream>
 #include <fstream>
+#include <functional>
 #include <vector>
 #include <numeric>
 #include "cpinternals/common.hpp"
 #include "cpinternals/ctypes.hpp"
 #include "cpinternals/scripting.hpp"
 #include "cpinternals/io/file_stream.hpp"
+#include "cpinternals/io/memory_istream.hpp"
+#include "cpinternals/os/file_mapping.hpp"
+#include "cpinternals/common/parallel.hpp"
+#include "cpinternals/common/small_string.hpp"
 #include "value_pool.hpp"
 
 namespace cp::tdb {
@@ -28,8 +33,8 @@ struct header_t
 
 struct QuatElem
 {
-  std::string name;
-  std::string type;
+  small_string<24> name;
+  small_string<24> type;
   uint64_t uk;
 
   friend streambase& operator<<(streambase& ar, QuatElem& x)
@@ -41,13 +46,23 @@ struct QuatElem
   {
     return a.uk < b.uk;
   }
+
+  friend bool operator==(const QuatElem& a, const QuatElem& b)
+  {
+    return a.uk == b.uk && a.name == b.name && a.type == b.type;
+  }
+
+  friend uint64_t hash_value(const QuatElem& x)
+  {
+    return detail::hash_combine(detail::hash_combine(fnv1a64(x.name), fnv1a64(x.type)), x.uk);
+  }
 };
 
 struct Quaternion
 {
   uint8_t uk0;
   QuatElem x, y, z, w;
-  std::string uk1;
+  small_string<24> uk1;
 
   friend streambase& operator<<(streambase& ar, Quaternion& x)
   {
@@ -61,6 +76,21 @@ struct Quaternion
   {
     return a.x < b.x && a.y < b.y && a.z < b.z && a.w < b.w;
   }
+
+  friend bool operator==(const Quaternion& a, const Quaternion& b)
+  {
+    return a.uk0 == b.uk0 && a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w && a.uk1 == b.uk1;
+  }
+
+  friend uint64_t hash_value(const Quaternion& x)
+  {
+    uint64_t h = x.uk0;
+    for (const auto* e : {&x.x, &x.y, &x.z, &x.w})
+    {
+      h = detail::hash_combine(h, hash_value(*e));
+    }
+    return detail::hash_combine(h, fnv1a64(x.uk1));
+  }
 };
 
 struct pool_desc_t
@@ -70,9 +100,10 @@ struct pool_desc_t
 
   friend streambase& operator<<(streambase& ar, pool_desc_t& x)
   {
+    const auto prev_flags = ar.flags();
     ar << armanip::cnamehash;
     ar << x.ctypename << x.len;
-    ar << armanip::cnamestr; // todo: save and restore
+    ar << prev_flags;
     return ar;
   }
 };
@@ -91,7 +122,9 @@ struct pool_key_t
 template <typename T>
 struct pool_t
 {
-  value_pool<T> vpool;
+  using value_type = T;
+
+  typename pool_storage<T>::type vpool;
   std::vector<pool_key_t> keys;
 
   friend streambase& operator<<(streambase& ar, pool_t& x)
@@ -125,62 +158,284 @@ enum class pool_element_kind : uint64_t
   boolean       = "Bool"_fnv1a64,
 };
 
+struct Vector2
+{
+  float x = 0, y = 0;
+
+  friend streambase& operator<<(streambase& ar, Vector2& v)
+  {
+    return ar << v.x << v.y;
+  }
+};
+
+struct Vector3
+{
+  float x = 0, y = 0, z = 0;
+
+  friend streambase& operator<<(streambase& ar, Vector3& v)
+  {
+    return ar << v.x << v.y << v.z;
+  }
+};
+
+struct EulerAngles
+{
+  float pitch = 0, yaw = 0, roll = 0;
+
+  friend streambase& operator<<(streambase& ar, EulerAngles& v)
+  {
+    return ar << v.pitch << v.yaw << v.roll;
+  }
+};
+
+namespace detail {
+
+template <> struct is_flat<Vector2> : std::true_type {};
+template <> struct is_flat<Vector3> : std::true_type {};
+template <> struct is_flat<EulerAngles> : std::true_type {};
+
+} // namespace detail
+
 template <pool_element_kind EltKind>
 struct pool_type {};
 
-// Thinking...
-
 template <> struct pool_type<pool_element_kind::string> { using type = std::string; };
-template <> struct pool_type<pool_element_kind::quaternion> { using type = std::string; };
-template <> struct pool_type<pool_element_kind::array_bool> { using type = std::string; };
-template <> struct pool_type<pool_element_kind::array_cname> { using type = std::string; };
-template <> struct pool_type<pool_element_kind::array_i32> { using type = std::string; };
-template <> struct pool_type<pool_element_kind::array_cres> { using type = std::string; };
-template <> struct pool_type<pool_element_kind::array_vec2> { using type = std::string; };
-template <> struct pool_type<pool_element_kind::array_string> { using type = std::string; };
-template <> struct pool_type<pool_element_kind::array_flt> { using type = std::string; };
-template <> struct pool_type<pool_element_kind::array_vec3> { using type = std::string; };
-template <> struct pool_type<pool_element_kind::array_tdbid> { using type = std::string; };
-template <> struct pool_type<pool_element_kind::vec3> { using type = std::string; };
+template <> struct pool_type<pool_element_kind::quaternion> { using type = Quaternion; };
+template <> struct pool_type<pool_element_kind::array_bool> { using type = std::vector<bool>; };
+template <> struct pool_type<pool_element_kind::array_cname> { using type = std::vector<CName>; };
+template <> struct pool_type<pool_element_kind::array_i32> { using type = std::vector<int32_t>; };
+template <> struct pool_type<pool_element_kind::array_cres> { using type = std::vector<uint64_t>; };
+template <> struct pool_type<pool_element_kind::array_vec2> { using type = std::vector<Vector2>; };
+template <> struct pool_type<pool_element_kind::array_string> { using type = std::vector<std::string>; };
+template <> struct pool_type<pool_element_kind::array_flt> { using type = std::vector<float>; };
+template <> struct pool_type<pool_element_kind::array_vec3> { using type = std::vector<Vector3>; };
+template <> struct pool_type<pool_element_kind::array_tdbid> { using type = std::vector<TweakDBID>; };
+template <> struct pool_type<pool_element_kind::vec3> { using type = Vector3; };
+template <> struct pool_type<pool_element_kind::euler> { using type = EulerAngles; };
+template <> struct pool_type<pool_element_kind::vec2> { using type = Vector2; };
+template <> struct pool_type<pool_element_kind::tdbid> { using type = TweakDBID; };
+template <> struct pool_type<pool_element_kind::cname> { using type = CName; };
+template <> struct pool_type<pool_element_kind::cres> { using type = uint64_t; };
+template <> struct pool_type<pool_element_kind::lockey> { using type = uint64_t; };
+template <> struct pool_type<pool_element_kind::flt> { using type = float; };
+template <> struct pool_type<pool_element_kind::i32> { using type = int32_t; };
+template <> struct pool_type<pool_element_kind::boolean> { using type = bool; };
+
+template <pool_element_kind EltKind>
+using pool_of = pool_t<typename pool_type<EltKind>::type>;
+
+template <typename T>
+struct type_tag
+{
+  using type = T;
+};
+
+// calls fn(type_tag<value type>{}), returns false for unknown kinds
+template <typename Fn>
+bool visit_pool_type(pool_element_kind kind, Fn&& fn)
+{
+  switch (kind)
+  {
+    case pool_element_kind::string:        fn(type_tag<pool_type<pool_element_kind::string>::type>{}); return true;
+    case pool_element_kind::quaternion:    fn(type_tag<pool_type<pool_element_kind::quaternion>::type>{}); return true;
+    case pool_element_kind::array_bool:    fn(type_tag<pool_type<pool_element_kind::array_bool>::type>{}); return true;
+    case pool_element_kind::array_cname:   fn(type_tag<pool_type<pool_element_kind::array_cname>::type>{}); return true;
+    case pool_element_kind::array_i32:     fn(type_tag<pool_type<pool_element_kind::array_i32>::type>{}); return true;
+    case pool_element_kind::array_cres:    fn(type_tag<pool_type<pool_element_kind::array_cres>::type>{}); return true;
+    case pool_element_kind::array_vec2:    fn(type_tag<pool_type<pool_element_kind::array_vec2>::type>{}); return true;
+    case pool_element_kind::array_string:  fn(type_tag<pool_type<pool_element_kind::array_string>::type>{}); return true;
+    case pool_element_kind::array_flt:     fn(type_tag<pool_type<pool_element_kind::array_flt>::type>{}); return true;
+    case pool_element_kind::array_vec3:    fn(type_tag<pool_type<pool_element_kind::array_vec3>::type>{}); return true;
+    case pool_element_kind::array_tdbid:   fn(type_tag<pool_type<pool_element_kind::array_tdbid>::type>{}); return true;
+    case pool_element_kind::vec3:          fn(type_tag<pool_type<pool_element_kind::vec3>::type>{}); return true;
+    case pool_element_kind::euler:         fn(type_tag<pool_type<pool_element_kind::euler>::type>{}); return true;
+    case pool_element_kind::vec2:          fn(type_tag<pool_type<pool_element_kind::vec2>::type>{}); return true;
+    case pool_element_kind::tdbid:         fn(type_tag<pool_type<pool_element_kind::tdbid>::type>{}); return true;
+    case pool_element_kind::cname:         fn(type_tag<pool_type<pool_element_kind::cname>::type>{}); return true;
+    case pool_element_kind::cres:          fn(type_tag<pool_type<pool_element_kind::cres>::type>{}); return true;
+    case pool_element_kind::lockey:        fn(type_tag<pool_type<pool_element_kind::lockey>::type>{}); return true;
+    case pool_element_kind::flt:           fn(type_tag<pool_type<pool_element_kind::flt>::type>{}); return true;
+    case pool_element_kind::i32:           fn(type_tag<pool_type<pool_element_kind::i32>::type>{}); return true;
+    case pool_element_kind::boolean:       fn(type_tag<pool_type<pool_element_kind::boolean>::type>{}); return true;
+    default: break;
+  }
+  return false;
+}
+
+// record: id and hash of its type name
+struct group_t
+{
+  TweakDBID id;
+  uint32_t type_hash = 0;
+
+  friend streambase& operator<<(streambase& ar, group_t& x)
+  {
+    return ar << x.id << x.type_hash;
+  }
+};
+
+struct inlgroup_t
+{
+  TweakDBID id;
+  std::vector<TweakDBID> ids;
+
+  friend streambase& operator<<(streambase& ar, inlgroup_t& x)
+  {
+    return ar << x.id << x.ids;
+  }
+};
+
+struct package_t
+{
+  TweakDBID id;
+  uint8_t tag = 0;
+
+  friend streambase& operator<<(streambase& ar, package_t& x)
+  {
+    return ar << x.id << x.tag;
+  }
+};
+
+namespace detail {
+
+// serialized size of fixed-size values, 0 for variable-size ones
+template <typename T> struct fixed_size : std::integral_constant<size_t, 0> {};
+template <> struct fixed_size<bool> : std::integral_constant<size_t, 1> {};
+template <> struct fixed_size<uint8_t> : std::integral_constant<size_t, 1> {};
+template <> struct fixed_size<int32_t> : std::integral_constant<size_t, 4> {};
+template <> struct fixed_size<uint32_t> : std::integral_constant<size_t, 4> {};
+template <> struct fixed_size<float> : std::integral_constant<size_t, 4> {};
+template <> struct fixed_size<uint64_t> : std::integral_constant<size_t, 8> {};
+template <> struct fixed_size<TweakDBID> : std::integral_constant<size_t, 8> {};
+template <> struct fixed_size<Vector2> : std::integral_constant<size_t, 8> {};
+template <> struct fixed_size<Vector3> : std::integral_constant<size_t, 12> {};
+template <> struct fixed_size<EulerAngles> : std::integral_constant<size_t, 12> {};
+template <> struct fixed_size<pool_key_t> : std::integral_constant<size_t, 12> {};
+template <> struct fixed_size<group_t> : std::integral_constant<size_t, 12> {};
+template <> struct fixed_size<package_t> : std::integral_constant<size_t, 9> {};
+
+// minimum serialized size, used to reject counts before allocating
+template <typename T>
+constexpr size_t min_size()
+{
+  return fixed_size<T>::value ? fixed_size<T>::value : 1;
+}
+
+inline void skip_string(streambase& ar)
+{
+  int64_t cnt = 0;
+  ar.serialize_int_packed(cnt);
+  ar.seek(cnt < 0 ? -cnt : cnt * 2, streambase::cur);
+}
+
+template <typename T>
+void skip_values(streambase& ar, uint32_t cnt, size_t end);
+
+// skips a value without decoding it (no allocations)
+template <typename T>
+void skip_value(streambase& ar, size_t end)
+{
+  if constexpr (fixed_size<T>::value != 0)
+  {
+    ar.seek(fixed_size<T>::value, streambase::cur);
+  }
+  else if constexpr (std::is_same_v<T, std::string> || std::is_same_v<T, CName>)
+  {
+    skip_string(ar);
+  }
+  else if constexpr (std::is_same_v<T, Quaternion>)
+  {
+    ar.seek(1, streambase::cur);
+    for (int i = 0; i < 4; ++i)
+    {
+      skip_string(ar);
+      skip_string(ar);
+      ar.seek(8, streambase::cur);
+    }
+    skip_string(ar);
+  }
+  else
+  {
+    // arrays
+    uint32_t cnt = 0;
+    ar << cnt;
+    skip_values<typename T::value_type>(ar, cnt, end);
+  }
+}
+
+template <typename T>
+void skip_values(streambase& ar, uint32_t cnt, size_t end)
+{
+  if constexpr (fixed_size<T>::value != 0)
+  {
+    ar.seek(size_t(cnt) * fixed_size<T>::value, streambase::cur);
+  }
+  else
+  {
+    for (uint32_t i = 0; i < cnt && !ar.has_error() && (size_t)ar.tell() <= end; ++i)
+    {
+      skip_value<T>(ar, end);
+    }
+  }
+}
+
+// count-prefixed array, the count is checked against the remaining bytes
+// (streambase's vector operator caps it lower than big pools' sizes)
+template <typename T>
+bool read_array(streambase& ar, std::vector<T>& out, size_t end)
+{
+  uint32_t cnt = 0;
+  ar << cnt;
+
+  const size_t pos = (size_t)ar.tell();
+  if (ar.has_error() || pos > end || size_t(cnt) * min_size<T>() > end - pos)
+  {
+    return false;
+  }
+
+  out.clear();
+  out.reserve(cnt);
+  for (uint32_t i = 0; i < cnt && !ar.has_error(); ++i)
+  {
+    T value{};
+    ar << value;
+    out.push_back(std::move(value));
+  }
+
+  return !ar.has_error();
+}
+
+} // namespace detail
 
 struct tweakdb
 {
   tweakdb()
   {
     // Add some types to the CNames
-    auto& resolver = CName_resolver::get();
-    resolver.register_str("String");
-    resolver.register_str("Quaternion");
-    resolver.register_str("array:Bool");
-    resolver.register_str("array:CName");
-    resolver.register_str("array:Int32");
-    resolver.register_str("array:raRef:CResource");
-    resolver.register_str("array:Vector2");
-    resolver.register_str("array:String");
-    resolver.register_str("array:Float");
-    resolver.register_str("array:Vector3");
-    resolver.register_str("array:TweakDBID");
-    resolver.register_str("Vector3");
-    resolver.register_str("EulerAngles");
-    resolver.register_str("Vector2");
-    resolver.register_str("TweakDBID");
-    resolver.register_str("CName");
-    resolver.register_str("raRef:CResource");
-    resolver.register_str("gamedataLocKeyWrapper");
-    resolver.register_str("Float");
-    resolver.register_str("Int32");
-    resolver.register_str("Bool");
+    static constexpr std::string_view type_names[] = {
+      "String", "Quaternion", "array:Bool", "array:CName", "array:Int32",
+      "array:raRef:CResource", "array:Vector2", "array:String", "array:Float",
+      "array:Vector3", "array:TweakDBID", "Vector3", "EulerAngles", "Vector2",
+      "TweakDBID", "CName", "raRef:CResource", "gamedataLocKeyWrapper", "Float",
+      "Int32", "Bool",
+    };
+    CName_resolver::get().register_strs(type_names);
   }
 
   bool open(std::filesystem::path path)
   {
-    file_istream ifa(path);
-
-    ifa.seek(0, std::ios_base::end);
-    uint32_t blob_size = (uint32_t)ifa.tell();
-    ifa.seek(0, std::ios_base::beg);
+    os::file_mapping mapping;
+    if (!mapping.open(path))
+    {
+      SPDLOG_ERROR("couldn't open {}", path.string());
+      return false;
+    }
 
-    op_status status = serialize_in(ifa, blob_size);
+    op_status status = load(mapping.view());
+    if (!status)
+    {
+      SPDLOG_ERROR("{}: {}", path.string(), status.err());
+    }
 
     return status;
   }
@@ -190,17 +445,39 @@ struct tweakdb
     return m_pools_descs;
   }
 
+  // 0 means one per hardware thread
+  void set_workers_count(size_t workers_cnt)
+  {
+    m_workers_cnt = workers_cnt;
+  }
+
 public:
   op_status serialize_in(streambase& ar, size_t blob_size)
   {
-    // let's get our header start position
-    size_t start_pos = (size_t)ar.tell();
+    std::vector<char> blob(blob_size);
+    ar.serialize_bytes(blob.data(), blob_size);
+    if (ar.has_error())
+    {
+      return ar.error();
+    }
+
+    return load(blob);
+  }
 
-    ar.serialize_pod_raw(m_header);
+  // Pools are laid out one after the other in pool descs order. A first
+  // pass skips over them to find their offsets (only string and array
+  // sizes are read), then pools and the groups, inlgroups and packages
+  // sections (at the header's offsets) are decoded concurrently.
+  // On error what could be decoded is kept.
+  op_status load(std::span<const char> blob)
+  {
+    memory_istream ar(blob);
 
-    auto blob_spos = ar.tell();
+    ar.serialize_pod_raw(m_header);
 
     // check header
+    if (ar.has_error())
+      return ar.error();
     if (m_header.five != 5 || m_header.four != 4)
       return false;
     if (m_header.variables_offset > m_header.groups_offset)
@@ -209,53 +486,290 @@ public:
       return false;
     if (m_header.inlgroups_offset > m_header.packages_offset)
       return false;
-    if (m_header.packages_offset > blob_size)
+    if (m_header.packages_offset > blob.size())
       return false;
 
     ar << m_pools_descs;
+    if (ar.has_error())
+      return ar.error();
+
+    std::vector<load_job> jobs;
+    jobs.reserve(m_pools_descs.size() + 3);
+
+    uint64_t visited_kinds = 0;
+    const size_t pools_end = m_header.groups_offset;
+
+    for (size_t i = 0; i < m_pools_descs.size(); ++i)
+    {
+      const auto& desc = m_pools_descs[i];
+      const auto kind = static_cast<pool_element_kind>(desc.ctypename.hash);
+
+      auto& job = jobs.emplace_back();
+      job.name = fmt::format("pool {}", desc.ctypename.string());
+      job.beg = (size_t)ar.tell();
+
+      const bool known = visit_pool(kind, [&](auto& pool, size_t kind_idx) {
+        using value_type = typename std::remove_reference_t<decltype(pool)>::value_type;
+
+        if (visited_kinds & (1ull << kind_idx))
+        {
+          ar.set_error("duplicate pool");
+          return;
+        }
+        visited_kinds |= 1ull << kind_idx;
+
+        // values, then keys
+        uint32_t cnt = 0;
+        ar << cnt;
+        detail::skip_values<value_type>(ar, cnt, pools_end);
+        ar << cnt;
+        detail::skip_values<pool_key_t>(ar, cnt, pools_end);
+
+        job.decode = [&pool](streambase& jar, size_t end) {
+          return read_pool(jar, pool, end);
+        };
+      });
+
+      job.end = (size_t)ar.tell();
+
+      if (!known)
+        return fmt::format("unknown pool type {}", desc.ctypename.string());
+      if (ar.has_error())
+        return fmt::format("{}: {}", job.name, ar.error());
+      if (job.end > pools_end)
+        return fmt::format("{} is truncated", job.name);
+    }
+
+    add_section_job(jobs, "groups", m_header.groups_offset, m_header.inlgroups_offset, m_groups);
+    add_section_job(jobs, "inlgroups", m_header.inlgroups_offset, m_header.packages_offset, m_inlgroups);
+    add_section_job(jobs, "packages", m_header.packages_offset, blob.size(), m_packages);
+
+    parallel_for(jobs.size(), m_workers_cnt, [&](size_t i) {
+      auto& job = jobs[i];
+      memory_istream jar(blob);
+      jar.seek(job.beg);
+      job.ok = job.decode(jar, job.end) && !jar.has_error() && (size_t)jar.tell() == job.end;
+    });
+
+    std::string err;
+    for (const auto& job : jobs)
+    {
+      if (!job.ok)
+      {
+        err += fmt::format("{}{} has unexpected content", err.empty() ? "" : ", ", job.name);
+      }
+    }
+
+    return err;
+  }
 
-    // TODO check that each pool desc corresponds
+  pool_of<pool_element_kind::string>        pool_string;
+  pool_of<pool_element_kind::quaternion>    pool_quats;
+  pool_of<pool_element_kind::array_bool>    pool_array_bool;
+  pool_of<pool_element_kind::array_cname>   pool_array_cname;
+  pool_of<pool_element_kind::array_i32>     pool_array_i32;
+  pool_of<pool_element_kind::array_cres>    pool_array_cres;
+  pool_of<pool_element_kind::array_vec2>    pool_array_vec2;
+  pool_of<pool_element_kind::array_string>  pool_array_string;
+  pool_of<pool_element_kind::array_flt>     pool_array_flt;
+  pool_of<pool_element_kind::array_vec3>    pool_array_vec3;
+  pool_of<pool_element_kind::array_tdbid>   pool_array_tdbid;
+  pool_of<pool_element_kind::vec3>          pool_vec3;
+  pool_of<pool_element_kind::euler>         pool_euler;
+  pool_of<pool_element_kind::vec2>          pool_vec2;
+  pool_of<pool_element_kind::tdbid>         pool_tdbid;
+  pool_of<pool_element_kind::cname>         pool_cname;
+  pool_of<pool_element_kind::cres>          pool_cres;
+  pool_of<pool_element_kind::lockey>        pool_lockey;
+  pool_of<pool_element_kind::flt>           pool_flt;
+  pool_of<pool_element_kind::i32>           pool_i32;
+  pool_of<pool_element_kind::boolean>       pool_bool;
+
+  const std::vector<group_t>& groups() const { return m_groups; }
+  const std::vector<inlgroup_t>& inlgroups() const { return m_inlgroups; }
+  const std::vector<package_t>& packages() const { return m_packages; }
+
+  // calls fn(pool, kind_idx), returns false for unknown kinds
+  template <typename Fn>
+  bool visit_pool(pool_element_kind kind, Fn&& fn)
+  {
+    switch (kind)
+    {
+      case pool_element_kind::string:       fn(pool_string, 0); return true;
+      case pool_element_kind::quaternion:   fn(pool_quats, 1); return true;
+      case pool_element_kind::array_bool:   fn(pool_array_bool, 2); return true;
+      case pool_element_kind::array_cname:  fn(pool_array_cname, 3); return true;
+      case pool_element_kind::array_i32:    fn(pool_array_i32, 4); return true;
+      case pool_element_kind::array_cres:   fn(pool_array_cres, 5); return true;
+      case pool_element_kind::array_vec2:   fn(pool_array_vec2, 6); return true;
+      case pool_element_kind::array_string: fn(pool_array_string, 7); return true;
+      case pool_element_kind::array_flt:    fn(pool_array_flt, 8); return true;
+      case pool_element_kind::array_vec3:   fn(pool_array_vec3, 9); return true;
+      case pool_element_kind::array_tdbid:  fn(pool_array_tdbid, 10); return true;
+      case pool_element_kind::vec3:         fn(pool_vec3, 11); return true;
+      case pool_element_kind::euler:        fn(pool_euler, 12); return true;
+      case pool_element_kind::vec2:         fn(pool_vec2, 13); return true;
+      case pool_element_kind::tdbid:        fn(pool_tdbid, 14); return true;
+      case pool_element_kind::cname:        fn(pool_cname, 15); return true;
+      case pool_element_kind::cres:         fn(pool_cres, 16); return true;
+      case pool_element_kind::lockey:       fn(pool_lockey, 17); return true;
+      case pool_element_kind::flt:          fn(pool_flt, 18); return true;
+      case pool_element_kind::i32:          fn(pool_i32, 19); return true;
+      case pool_element_kind::boolean:      fn(pool_bool, 20); return true;
+      default: break;
+    }
+    return false;
+  }
 
-    ar << pool_string;
-    ar << pool_quats;
-    ar << pool_array_bool;
-    ar << pool_array_cname;
-    ar << pool_array_i32;
+  template <typename Fn>
+  bool visit_pool(pool_element_kind kind, Fn&& fn) const
+  {
+    return const_cast<tweakdb*>(this)->visit_pool(kind, [&](const auto& pool, size_t kind_idx) {
+      fn(pool, kind_idx);
+    });
+  }
 
-    size_t new_pos = (size_t)ar.tell();
+  size_t workers_count() const
+  {
+    return m_workers_cnt;
+  }
+
+protected:
+  // decodes [beg, end) of the blob
+  struct load_job
+  {
+    size_t beg = 0;
+    size_t end = 0;
+    std::function<bool(streambase&, size_t)> decode;
+    std::string name;
+    bool ok = false;
+  };
+
+  template <typename T>
+  static bool read_pool(streambase& ar, pool_t<T>& pool, size_t end)
+  {
+    using vpool_type = decltype(pool.vpool);
+
+    size_t values_cnt = 0;
+    if constexpr (is_flat_array_pool<vpool_type>::value)
+    {
+      // arrays are read into the contiguous storage directly
+      using elem_type = typename vpool_type::element_type;
+      static_assert(detail::fixed_size<elem_type>::value == sizeof(elem_type));
+
+      uint32_t cnt = 0;
+      ar << cnt;
+      if (ar.has_error() || (size_t)ar.tell() > end || size_t(cnt) * 4 > end - (size_t)ar.tell())
+        return false;
+
+      std::vector<elem_type> elements;
+      std::vector<uint32_t> offsets;
+      offsets.reserve(size_t(cnt) + 1);
+      offsets.push_back(0);
+      for (uint32_t i = 0; i < cnt; ++i)
+      {
+        uint32_t len = 0;
+        ar << len;
+        if (ar.has_error() || size_t(len) * sizeof(elem_type) > end - (size_t)ar.tell())
+          return false;
+
+        const size_t beg = elements.size();
+        elements.resize(beg + len);
+        ar.serialize_pods_array_raw(elements.data() + beg, len);
+        offsets.push_back((uint32_t)elements.size());
+      }
+
+      if (ar.has_error())
+        return false;
+
+      values_cnt = cnt;
+      pool.vpool.assign(std::move(elements), std::move(offsets));
+    }
+    else if constexpr (is_bool_array_pool<vpool_type>::value)
+    {
+      // a byte per bool, packed into the pool's bit buffer
+      uint32_t cnt = 0;
+      ar << cnt;
+      if (ar.has_error() || (size_t)ar.tell() > end || size_t(cnt) * 4 > end - (size_t)ar.tell())
+        return false;
+
+      std::vector<uint64_t> words;
+      std::vector<uint32_t> offsets;
+      offsets.reserve(size_t(cnt) + 1);
+      offsets.push_back(0);
+      std::vector<char> bytes;
+      for (uint32_t i = 0; i < cnt; ++i)
+      {
+        uint32_t len = 0;
+        ar << len;
+        if (ar.has_error() || len > end - (size_t)ar.tell())
+          return false;
+
+        bytes.resize(len);
+        ar.serialize_bytes(bytes.data(), len);
+
+        size_t pos = offsets.back();
+        for (uint32_t j = 0; j < len; j += 64)
+        {
+          const uint32_t bits_cnt = std::min<uint32_t>(64, len - j);
+          uint64_t bits = 0;
+          for (uint32_t k = 0; k < bits_cnt; ++k)
+          {
+            bits |= uint64_t(bytes[j + k] != 0) << k;
+          }
+          detail::append_bits(words, pos, bits, bits_cnt);
+          pos += bits_cnt;
+        }
+        offsets.push_back((uint32_t)pos);
+      }
+
+      if (ar.has_error())
+        return false;
+
+      values_cnt = cnt;
+      pool.vpool.assign(std::move(words), std::move(offsets));
+    }
+    else
+    {
+      std::vector<T> values;
+      if (!detail::read_array(ar, values, end))
+        return false;
+
+      values_cnt = values.size();
+      pool.vpool.assign(std::move(values));
+    }
+
+    if (!detail::read_array(ar, pool.keys, end))
+      return false;
+
+    for (const auto& key : pool.keys)
+    {
+      if (key.idx >= values_cnt)
+        return false;
+    }
 
     return true;
   }
 
-  pool_t<std::string> pool_string;
-  pool_t<Quaternion> pool_quats;
-  pool_t<std::vector<bool>> pool_array_bool;
-  pool_t<std::vector<CName>> pool_array_cname;
-  pool_t<std::vector<int32_t>> pool_array_i32;
-
-  // thinking about a less verbose way to do this.
-
-  //resolver.register_name("array:raRef:CResource");
-  //resolver.register_name("array:Vector2");
-  //resolver.register_name("array:String");
-  //resolver.register_name("array:Float");
-  //resolver.register_name("array:Vector3");
-  //resolver.register_name("array:TweakDBID");
-  //resolver.register_name("Vector3");
-  //resolver.register_name("EulerAngles");
-  //resolver.register_name("Vector2");
-  //resolver.register_name("TweakDBID");
-  //resolver.register_name("CName");
-  //resolver.register_name("raRef:CResource");
-  //resolver.register_name("gamedataLocKeyWrapper");
-  //resolver.register_name("Float");
-  //resolver.register_name("Int32");
-  //resolver.register_name("Bool");
+  template <typename T>
+  static void add_section_job(std::vector<load_job>& jobs, const char* name, size_t beg, size_t end, std::vector<T>& out)
+  {
+    auto& job = jobs.emplace_back();
+    job.name = name;
+    job.beg = beg;
+    job.end = end;
+    job.decode = [&out](streambase& ar, size_t end) {
+      return detail::read_array(ar, out, end);
+    };
+  }
 
 private:
   header_t m_header;
   std::vector<pool_desc_t> m_pools_descs;
+  std::vector<group_t> m_groups;
+  std::vector<inlgroup_t> m_inlgroups;
+  std::vector<package_t> m_packages;
+  size_t m_workers_cnt = 0;
 };
 
 } // namespace cp::tdb
-
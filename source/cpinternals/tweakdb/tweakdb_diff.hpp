@@ -0,0 +1,274 @@
+#pragma once
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <vector>
+#include "cpinternals/common.hpp"
+#include "cpinternals/common/parallel.hpp"
+#include "tweakdb.hpp"
+
+namespace cp::tdb {
+
+// Differences between two loaded tweakdbs (e.g. two game patches).
+//
+// Pools are paired by type name, flats by id: a flat only in the newer db
+// is added, only in the older one removed, in both with different values
+// changed. Records (groups) are paired by id, changed if their type differs.
+// Each pool is a job of a parallel_for, keys are compared with a sorted
+// merge and values by their indexed hash first.
+
+enum class diff_op : uint8_t
+{
+  added,
+  removed,
+  changed,
+};
+
+inline const char* diff_op_name(diff_op op)
+{
+  switch (op)
+  {
+    case diff_op::added:   return "added";
+    case diff_op::removed: return "removed";
+    case diff_op::changed: return "changed";
+    default: break;
+  }
+  return "unknown";
+}
+
+struct flat_diff
+{
+  static constexpr uint32_t npos = UINT32_MAX;
+
+  TweakDBID id;
+  diff_op op = diff_op::changed;
+  uint32_t old_value_idx = npos; // in the older db's pool, npos if added
+  uint32_t new_value_idx = npos; // in the newer db's pool, npos if removed
+};
+
+// flats of one pool type, by id
+struct pool_diff
+{
+  pool_element_kind kind = {};
+  std::vector<flat_diff> flats;
+};
+
+struct record_diff
+{
+  TweakDBID id;
+  diff_op op = diff_op::changed;
+  uint32_t old_type_hash = 0; // 0 if added
+  uint32_t new_type_hash = 0; // 0 if removed
+};
+
+struct tweakdb_diff
+{
+  std::vector<pool_diff> pools;     // only pools with differences, in the newer db's order
+  std::vector<record_diff> records; // by id
+
+  bool empty() const
+  {
+    return pools.empty() && records.empty();
+  }
+
+  size_t flats_count() const
+  {
+    size_t cnt = 0;
+    for (const auto& pool : pools)
+    {
+      cnt += pool.flats.size();
+    }
+    return cnt;
+  }
+};
+
+namespace detail {
+
+// indices of the elements of a table sorted by id (stable), id_fn(i) gives
+// the id of element i. tables are usually sorted already.
+template <typename IdFn>
+std::vector<uint32_t> sorted_by_id(size_t cnt, IdFn&& id_fn)
+{
+  std::vector<uint32_t> ret(cnt);
+  std::iota(ret.begin(), ret.end(), 0);
+
+  bool sorted = true;
+  for (size_t i = 1; i < cnt && sorted; ++i)
+  {
+    sorted = !(id_fn(i) < id_fn(i - 1));
+  }
+
+  if (!sorted)
+  {
+    std::stable_sort(ret.begin(), ret.end(), [&](uint32_t a, uint32_t b) { return id_fn(a) < id_fn(b); });
+  }
+
+  return ret;
+}
+
+// calls fn(old_idx, new_idx) for each id in ascending order, indices are npos
+// on the side where the id is missing
+template <typename IdFn0, typename IdFn1, typename Fn>
+void merge_by_id(size_t cnt0, IdFn0&& id_fn0, size_t cnt1, IdFn1&& id_fn1, Fn&& fn)
+{
+  constexpr uint32_t npos = flat_diff::npos;
+
+  const auto sorted0 = sorted_by_id(cnt0, id_fn0);
+  const auto sorted1 = sorted_by_id(cnt1, id_fn1);
+
+  size_t i = 0, j = 0;
+  while (i < cnt0 || j < cnt1)
+  {
+    if (j == cnt1 || (i < cnt0 && id_fn0(sorted0[i]) < id_fn1(sorted1[j])))
+    {
+      fn(sorted0[i++], npos);
+    }
+    else if (i == cnt0 || id_fn1(sorted1[j]) < id_fn0(sorted0[i]))
+    {
+      fn(npos, sorted1[j++]);
+    }
+    else
+    {
+      fn(sorted0[i++], sorted1[j++]);
+    }
+  }
+}
+
+template <typename VPool>
+bool pool_values_equal(const VPool& vpool0, uint32_t idx0, const VPool& vpool1, uint32_t idx1)
+{
+  if (vpool0.hash_at(idx0) != vpool1.hash_at(idx1))
+  {
+    return false;
+  }
+
+  if constexpr (is_flat_array_pool<VPool>::value)
+  {
+    const auto a = vpool0.at(idx0);
+    const auto b = vpool1.at(idx1);
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size_bytes()) == 0;
+  }
+  else if constexpr (is_bool_array_pool<VPool>::value)
+  {
+    return vpool0.at(idx0) == vpool1.at(idx1);
+  }
+  else
+  {
+    using value_type = typename VPool::value_type;
+    return value_equal<value_type>(vpool0.at(idx0), vpool1.at(idx1));
+  }
+}
+
+// any of the pools can be null (pool missing in that db)
+template <typename T>
+void diff_pool(const pool_t<T>* pool0, const pool_t<T>* pool1, std::vector<flat_diff>& out)
+{
+  static const std::vector<pool_key_t> no_keys;
+  const auto& keys0 = pool0 ? pool0->keys : no_keys;
+  const auto& keys1 = pool1 ? pool1->keys : no_keys;
+
+  merge_by_id(
+    keys0.size(), [&](size_t i) { return keys0[i].key.as_u64; },
+    keys1.size(), [&](size_t i) { return keys1[i].key.as_u64; },
+    [&](uint32_t i, uint32_t j) {
+      if (j == flat_diff::npos)
+      {
+        out.push_back(flat_diff{keys0[i].key, diff_op::removed, keys0[i].idx, flat_diff::npos});
+      }
+      else if (i == flat_diff::npos)
+      {
+        out.push_back(flat_diff{keys1[j].key, diff_op::added, flat_diff::npos, keys1[j].idx});
+      }
+      else if (!pool_values_equal(pool0->vpool, keys0[i].idx, pool1->vpool, keys1[j].idx))
+      {
+        out.push_back(flat_diff{keys1[j].key, diff_op::changed, keys0[i].idx, keys1[j].idx});
+      }
+    });
+}
+
+inline void diff_records(const std::vector<group_t>& groups0, const std::vector<group_t>& groups1, std::vector<record_diff>& out)
+{
+  merge_by_id(
+    groups0.size(), [&](size_t i) { return groups0[i].id.as_u64; },
+    groups1.size(), [&](size_t i) { return groups1[i].id.as_u64; },
+    [&](uint32_t i, uint32_t j) {
+      if (j == flat_diff::npos)
+      {
+        out.push_back(record_diff{groups0[i].id, diff_op::removed, groups0[i].type_hash, 0});
+      }
+      else if (i == flat_diff::npos)
+      {
+        out.push_back(record_diff{groups1[j].id, diff_op::added, 0, groups1[j].type_hash});
+      }
+      else if (groups0[i].type_hash != groups1[j].type_hash)
+      {
+        out.push_back(record_diff{groups1[j].id, diff_op::changed, groups0[i].type_hash, groups1[j].type_hash});
+      }
+    });
+}
+
+} // namespace detail
+
+// workers_cnt: 0 means one per hardware thread
+inline tweakdb_diff diff(const tweakdb& older, const tweakdb& newer, size_t workers_cnt = 0)
+{
+  auto has_pool = [](const tweakdb& tdb, pool_element_kind kind) {
+    for (const auto& desc : tdb.pools_descs())
+    {
+      if (static_cast<pool_element_kind>(desc.ctypename.hash) == kind)
+        return true;
+    }
+    return false;
+  };
+
+  // pools of the newer db, then the ones that were removed
+  std::vector<pool_element_kind> kinds;
+  for (const auto* tdb : {&newer, &older})
+  {
+    for (const auto& desc : tdb->pools_descs())
+    {
+      const auto kind = static_cast<pool_element_kind>(desc.ctypename.hash);
+      if (std::find(kinds.begin(), kinds.end(), kind) == kinds.end())
+        kinds.push_back(kind);
+    }
+  }
+
+  tweakdb_diff ret;
+  std::vector<pool_diff> pools(kinds.size());
+
+  // last job diffs the records
+  parallel_for(kinds.size() + 1, workers_cnt, [&](size_t i) {
+    if (i == kinds.size())
+    {
+      detail::diff_records(older.groups(), newer.groups(), ret.records);
+      return;
+    }
+
+    const auto kind = kinds[i];
+    pools[i].kind = kind;
+
+    const bool in_older = has_pool(older, kind);
+    const bool in_newer = has_pool(newer, kind);
+
+    // both dbs have the same pool type for a kind
+    older.visit_pool(kind, [&](const auto& pool0, size_t) {
+      newer.visit_pool(kind, [&](const auto& pool1, size_t) {
+        if constexpr (std::is_same_v<decltype(pool0), decltype(pool1)>)
+        {
+          detail::diff_pool(in_older ? &pool0 : nullptr, in_newer ? &pool1 : nullptr, pools[i].flats);
+        }
+      });
+    });
+  });
+
+  for (auto& pool : pools)
+  {
+    if (!pool.flats.empty())
+      ret.pools.push_back(std::move(pool));
+  }
+
+  return ret;
+}
+
+} // namespace cp::tdb
+
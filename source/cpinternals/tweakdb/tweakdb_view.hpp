@@ -0,0 +1,344 @@
+#pragma once
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <numeric>
+#include <vector>
+#include "cpinternals/common.hpp"
+#include "cpinternals/io/memory_istream.hpp"
+#include "cpinternals/os/file_mapping.hpp"
+#include "tweakdb.hpp"
+
+namespace cp::tdb {
+
+// Read-only view of a memory-mapped tweakdb.bin, nothing is decoded
+// upfront: values are decoded on access, one by one.
+//
+// Opening skips over the pools once to find where they start (see
+// tweakdb::load) and keeps the offsets of variable-size values (strings,
+// arrays). Flats and records are looked up by binary search over their key
+// tables in the file, when a table isn't sorted by id an index sorted by
+// id is built instead.
+struct tweakdb_view
+{
+  static constexpr uint32_t npos = UINT32_MAX;
+
+  struct pool_info
+  {
+    pool_desc_t desc;
+    pool_element_kind kind;
+    size_t   value_size = 0;     // serialized size of fixed-size values, 0 otherwise
+    size_t   values_beg = 0;     // offset of the first value
+    uint32_t values_cnt = 0;
+    size_t   keys_beg = 0;       // offset of the first key (TweakDBID + value index)
+    uint32_t keys_cnt = 0;
+    std::vector<uint32_t> value_offsets; // variable-size values only, values_cnt + 1
+    std::vector<uint32_t> sorted_keys;   // key indices by id, empty if sorted in the file
+  };
+
+  // a flat: value of its pool
+  struct flat_ref
+  {
+    uint32_t pool_idx = npos;
+    uint32_t value_idx = 0;
+
+    explicit operator bool() const
+    {
+      return pool_idx != npos;
+    }
+  };
+
+  tweakdb_view() = default;
+
+  tweakdb_view(const tweakdb_view&) = delete;
+  tweakdb_view& operator=(const tweakdb_view&) = delete;
+
+  bool open(const std::filesystem::path& path)
+  {
+    close();
+
+    if (!m_mapping.open(path))
+    {
+      SPDLOG_ERROR("couldn't open {}", path.string());
+      return false;
+    }
+
+    op_status status = index(m_mapping.view());
+    if (!status)
+    {
+      SPDLOG_ERROR("{}: {}", path.string(), status.err());
+      close();
+      return false;
+    }
+
+    return true;
+  }
+
+  void close()
+  {
+    m_pools.clear();
+    m_records_cnt = 0;
+    m_sorted_records.clear();
+    m_blob = {};
+    if (m_mapping.is_open())
+    {
+      m_mapping.close();
+    }
+  }
+
+  bool is_open() const
+  {
+    return !m_blob.empty();
+  }
+
+  const std::vector<pool_info>& pools() const
+  {
+    return m_pools;
+  }
+
+  // npos if there is no pool of that kind
+  uint32_t find_pool(pool_element_kind kind) const
+  {
+    for (uint32_t i = 0; i < (uint32_t)m_pools.size(); ++i)
+    {
+      if (m_pools[i].kind == kind)
+        return i;
+    }
+    return npos;
+  }
+
+  flat_ref find_flat(TweakDBID id, uint32_t pool_idx) const
+  {
+    const auto& pool = m_pools[pool_idx];
+
+    const uint32_t key_idx = search(pool.keys_cnt, pool.sorted_keys, id.as_u64,
+      [&](uint32_t i) { return key_id(pool, i); });
+
+    if (key_idx == npos)
+      return {};
+
+    const uint32_t value_idx = read_u32(pool.keys_beg + size_t(key_idx) * key_size + 8);
+    if (value_idx >= pool.values_cnt)
+      return {};
+
+    return flat_ref{pool_idx, value_idx};
+  }
+
+  // searches all pools
+  flat_ref find_flat(TweakDBID id) const
+  {
+    for (uint32_t i = 0; i < (uint32_t)m_pools.size(); ++i)
+    {
+      if (auto ref = find_flat(id, i))
+        return ref;
+    }
+    return {};
+  }
+
+  // serialized value, a view of the mapping
+  std::span<const char> value_bytes(flat_ref ref) const
+  {
+    const auto& pool = m_pools[ref.pool_idx];
+    if (pool.value_size)
+    {
+      return m_blob.subspan(pool.values_beg + size_t(ref.value_idx) * pool.value_size, pool.value_size);
+    }
+
+    const size_t beg = pool.value_offsets[ref.value_idx];
+    return m_blob.subspan(beg, pool.value_offsets[ref.value_idx + 1] - beg);
+  }
+
+  // decodes a value, T must be the value type of the pool's kind
+  template <typename T>
+  bool read_value(flat_ref ref, T& out) const
+  {
+    memory_istream ar(value_bytes(ref));
+    ar << out;
+    return !ar.has_error();
+  }
+
+  // decodes the flat of id if it is in the pool of kind EltKind
+  template <pool_element_kind EltKind>
+  bool get_flat(TweakDBID id, typename pool_type<EltKind>::type& out) const
+  {
+    const uint32_t pool_idx = find_pool(EltKind);
+    if (pool_idx == npos)
+      return false;
+
+    auto ref = find_flat(id, pool_idx);
+    return ref && read_value(ref, out);
+  }
+
+  size_t records_count() const
+  {
+    return m_records_cnt;
+  }
+
+  // returns false if there is no record of that id
+  bool find_record(TweakDBID id, uint32_t& type_hash) const
+  {
+    const uint32_t idx = search(m_records_cnt, m_sorted_records, id.as_u64,
+      [&](uint32_t i) { return read_u64(m_records_beg + size_t(i) * record_size); });
+
+    if (idx == npos)
+      return false;
+
+    type_hash = read_u32(m_records_beg + size_t(idx) * record_size + 8);
+    return true;
+  }
+
+protected:
+  static constexpr size_t key_size = 12;     // TweakDBID + value index
+  static constexpr size_t record_size = 12;  // TweakDBID + type hash
+
+  uint64_t read_u64(size_t offset) const
+  {
+    uint64_t v;
+    std::memcpy(&v, m_blob.data() + offset, sizeof(v));
+    return v;
+  }
+
+  uint32_t read_u32(size_t offset) const
+  {
+    uint32_t v;
+    std::memcpy(&v, m_blob.data() + offset, sizeof(v));
+    return v;
+  }
+
+  uint64_t key_id(const pool_info& pool, uint32_t key_idx) const
+  {
+    return read_u64(pool.keys_beg + size_t(key_idx) * key_size);
+  }
+
+  // binary search over a table sorted by id (sorted is empty) or through
+  // its sorted indices, returns the table index of id
+  template <typename IdFn>
+  static uint32_t search(uint32_t cnt, const std::vector<uint32_t>& sorted, uint64_t id, IdFn&& id_fn)
+  {
+    auto table_idx = [&](uint32_t i) { return sorted.empty() ? i : sorted[i]; };
+
+    uint32_t lo = 0, hi = cnt;
+    while (lo < hi)
+    {
+      const uint32_t mid = lo + (hi - lo) / 2;
+      if (id_fn(table_idx(mid)) < id)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+    if (lo < cnt && id_fn(table_idx(lo)) == id)
+      return table_idx(lo);
+    return npos;
+  }
+
+  // returns the index sorted by id, empty if the table is already sorted
+  template <typename IdFn>
+  static std::vector<uint32_t> sort_index(uint32_t cnt, IdFn&& id_fn)
+  {
+    std::vector<uint32_t> ret;
+    for (uint32_t i = 1; i < cnt; ++i)
+    {
+      if (id_fn(i) < id_fn(i - 1))
+      {
+        ret.resize(cnt);
+        std::iota(ret.begin(), ret.end(), 0);
+        std::sort(ret.begin(), ret.end(), [&](uint32_t a, uint32_t b) { return id_fn(a) < id_fn(b); });
+        break;
+      }
+    }
+    return ret;
+  }
+
+  op_status index(std::span<const char> blob)
+  {
+    memory_istream ar(blob);
+
+    header_t hdr;
+    ar.serialize_pod_raw(hdr);
+    if (ar.has_error())
+      return ar.error();
+    if (hdr.five != 5 || hdr.four != 4)
+      return false;
+    if (hdr.groups_offset > hdr.inlgroups_offset || hdr.packages_offset > blob.size())
+      return false;
+
+    std::vector<pool_desc_t> descs;
+    ar << descs;
+    if (ar.has_error())
+      return ar.error();
+
+    const size_t pools_end = hdr.groups_offset;
+    m_pools.reserve(descs.size());
+
+    for (auto& desc : descs)
+    {
+      auto& pool = m_pools.emplace_back();
+      pool.desc = desc;
+      pool.kind = static_cast<pool_element_kind>(desc.ctypename.hash);
+
+      const bool known = visit_pool_type(pool.kind, [&](auto tag) {
+        using value_type = typename decltype(tag)::type;
+
+        ar << pool.values_cnt;
+        pool.values_beg = (size_t)ar.tell();
+
+        if constexpr (detail::fixed_size<value_type>::value != 0)
+        {
+          pool.value_size = detail::fixed_size<value_type>::value;
+          ar.seek(size_t(pool.values_cnt) * pool.value_size, streambase::cur);
+        }
+        else
+        {
+          pool.value_offsets.reserve(size_t(pool.values_cnt) + 1);
+          for (uint32_t i = 0; i < pool.values_cnt && !ar.has_error() && (size_t)ar.tell() <= pools_end; ++i)
+          {
+            pool.value_offsets.push_back((uint32_t)ar.tell());
+            detail::skip_value<value_type>(ar, pools_end);
+          }
+          pool.value_offsets.push_back((uint32_t)ar.tell());
+        }
+
+        ar << pool.keys_cnt;
+        pool.keys_beg = (size_t)ar.tell();
+        ar.seek(size_t(pool.keys_cnt) * key_size, streambase::cur);
+      });
+
+      if (!known)
+        return fmt::format("unknown pool type {}", desc.ctypename.string());
+      if (ar.has_error() || (size_t)ar.tell() > pools_end
+        || (pool.value_size == 0 && pool.value_offsets.size() != size_t(pool.values_cnt) + 1))
+        return fmt::format("pool {} is truncated", desc.ctypename.string());
+    }
+
+    // records
+    ar.seek(hdr.groups_offset);
+    ar << m_records_cnt;
+    m_records_beg = (size_t)ar.tell();
+    if (ar.has_error() || m_records_beg + size_t(m_records_cnt) * record_size > hdr.inlgroups_offset)
+      return "groups section is truncated";
+
+    // m_blob is used by the id functions
+    m_blob = blob;
+
+    for (auto& pool : m_pools)
+    {
+      pool.sorted_keys = sort_index(pool.keys_cnt, [&](uint32_t i) { return key_id(pool, i); });
+    }
+
+    m_sorted_records = sort_index(m_records_cnt,
+      [&](uint32_t i) { return read_u64(m_records_beg + size_t(i) * record_size); });
+
+    return true;
+  }
+
+  os::file_mapping m_mapping;
+  std::span<const char> m_blob;
+  std::vector<pool_info> m_pools;
+  size_t m_records_beg = 0;
+  uint32_t m_records_cnt = 0;
+  std::vector<uint32_t> m_sorted_records;
+};
+
+} // namespace cp::tdb
+
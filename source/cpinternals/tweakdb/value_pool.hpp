@@ -1,13 +1,216 @@
 #pragma once
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
 #include "cpinternals/common.hpp"
 
 namespace cp::tdb {
 
+namespace detail {
+
+template <typename T>
+struct is_vector : std::false_type {};
+
+template <typename E>
+struct is_vector<std::vector<E>> : std::true_type {};
+
+// flat element types are trivially copyable without padding, they are
+// hashed and compared bitwise and arrays of them are stored contiguously
+// (see flat_array_pool). specialized for tweakdb's structs in tweakdb.hpp.
+template <typename T>
+struct is_flat : std::bool_constant<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>> {};
+
+template <>
+struct is_flat<TweakDBID> : std::true_type {};
+
+inline uint64_t hash_bytes(const void* data, size_t size)
+{
+  return fnv1a64(std::string_view(static_cast<const char*>(data), size));
+}
+
+inline uint64_t hash_combine(uint64_t seed, uint64_t hash)
+{
+  return seed ^ (hash + 0x9E3779B97F4A7C15ull + (seed << 6) + (seed >> 2));
+}
+
+// other types provide a hash_value overload (found by adl)
+template <typename T>
+uint64_t value_hash(const T& v)
+{
+  if constexpr (is_flat<T>::value)
+  {
+    return hash_bytes(&v, sizeof(T));
+  }
+  else if constexpr (std::is_same_v<T, bool>)
+  {
+    return v ? 1 : 0;
+  }
+  else if constexpr (std::is_same_v<T, std::string>)
+  {
+    return fnv1a64(v);
+  }
+  else if constexpr (std::is_same_v<T, CName>)
+  {
+    return v.hash;
+  }
+  else if constexpr (is_vector<T>::value)
+  {
+    using elem_type = typename T::value_type;
+    if constexpr (is_flat<elem_type>::value)
+    {
+      return hash_bytes(v.data(), v.size() * sizeof(elem_type));
+    }
+    else
+    {
+      uint64_t h = v.size();
+      for (const auto& e : v)
+      {
+        h = hash_combine(h, value_hash<elem_type>(e));
+      }
+      return h;
+    }
+  }
+  else
+  {
+    return hash_value(v);
+  }
+}
+
+template <typename T>
+bool value_equal(const T& a, const T& b)
+{
+  if constexpr (is_flat<T>::value)
+  {
+    return std::memcmp(&a, &b, sizeof(T)) == 0;
+  }
+  else if constexpr (is_vector<T>::value)
+  {
+    using elem_type = typename T::value_type;
+    if constexpr (is_flat<elem_type>::value)
+    {
+      return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(elem_type)) == 0;
+    }
+    else
+    {
+      return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+        [](const elem_type& x, const elem_type& y) { return value_equal<elem_type>(x, y); });
+    }
+  }
+  else
+  {
+    return a == b;
+  }
+}
+
+// hash -> value index, flat open-addressing table (linear probing).
+// hashes of all values are kept so that rehashing doesn't need them.
+// duplicates can be inserted (push_back), find returns one of them.
+struct pool_index
+{
+  static constexpr uint32_t npos = UINT32_MAX;
+
+  void clear()
+  {
+    m_hashes.clear();
+    m_slots.clear();
+  }
+
+  void reserve(size_t cnt)
+  {
+    m_hashes.reserve(cnt);
+
+    // load factor kept under 1/2
+    size_t capacity = 16;
+    while (capacity < cnt * 2)
+    {
+      capacity *= 2;
+    }
+
+    if (capacity > m_slots.size())
+    {
+      rehash(capacity);
+    }
+  }
+
+  // eq(idx) tells if the value at idx is the searched one
+  template <typename Eq>
+  uint32_t find(uint64_t hash, Eq&& eq) const
+  {
+    if (m_slots.empty())
+    {
+      return npos;
+    }
+
+    const size_t mask = m_slots.size() - 1;
+    size_t i = static_cast<size_t>(hash) & mask;
+    while (true)
+    {
+      const uint32_t idx = m_slots[i];
+      if (idx == npos)
+      {
+        return npos;
+      }
+      if (m_hashes[idx] == hash && eq(idx))
+      {
+        return idx;
+      }
+      i = (i + 1) & mask;
+    }
+  }
+
+  // hash of the value at idx
+  uint64_t hash(uint32_t idx) const
+  {
+    return m_hashes[idx];
+  }
+
+  // values are indexed in order, idx must be the number of indexed values
+  void insert(uint64_t hash, uint32_t idx)
+  {
+    if ((m_hashes.size() + 1) * 2 > m_slots.size())
+    {
+      rehash(m_slots.size() ? m_slots.size() * 2 : 16);
+    }
+
+    m_hashes.push_back(hash);
+    place(idx);
+  }
+
+protected:
+  void place(uint32_t idx)
+  {
+    const size_t mask = m_slots.size() - 1;
+    size_t i = static_cast<size_t>(m_hashes[idx]) & mask;
+    while (m_slots[i] != npos)
+    {
+      i = (i + 1) & mask;
+    }
+    m_slots[i] = idx;
+  }
+
+  void rehash(size_t capacity)
+  {
+    m_slots.assign(capacity, npos);
+    for (uint32_t idx = 0; idx < (uint32_t)m_hashes.size(); ++idx)
+    {
+      place(idx);
+    }
+  }
+
+  std::vector<uint64_t> m_hashes; // by value index
+  std::vector<uint32_t> m_slots;  // value indices, npos if empty
+};
+
+} // namespace detail
+
+// Deduplicated values, indexed by hash (O(1) insertion).
 template <typename T, int ReserveCnt = 0x100>
 struct value_pool
 {
   using value_type = T;
 
+  static constexpr uint32_t npos = detail::pool_index::npos;
+
   value_pool()
   {
     m_values.reserve(ReserveCnt);
@@ -23,39 +226,51 @@ struct value_pool
     return m_values[idx];
   }
 
+  // Returns the index of the value in pool, npos if not found.
+  uint32_t find(const value_type& val) const
+  {
+    return m_index.find(detail::value_hash(val), [&](uint32_t idx) {
+      return detail::value_equal<value_type>(m_values[idx], val);
+    });
+  }
+
   // Returns the index of the value in pool.
   const size_t insert(const value_type& val)
   {
-    uint32_t idx = 0;
-    auto it = lower_bound_idx(val);
-    if (it != m_sorted_indices.end())
+    const uint64_t hash = detail::value_hash(val);
+    const uint32_t found_idx = m_index.find(hash, [&](uint32_t idx) {
+      return detail::value_equal<value_type>(m_values[idx], val);
+    });
+
+    if (found_idx != npos)
     {
-      idx = (uint32_t)*it;
-      if (val == at(idx))
-        return idx;
+      return found_idx;
     }
 
-    idx = (uint32_t)m_values.size();
+    const uint32_t idx = (uint32_t)m_values.size();
     m_values.emplace_back(val);
-    m_sorted_indices.insert(it, idx);
+    m_index.insert(hash, idx);
 
     return idx;
   }
 
-  // This is used for serialiation
+  // This is used for serialiation, values aren't deduplicated
   const void push_back(const value_type& val)
   {
     const uint32_t idx = (uint32_t)m_values.size();
     m_values.emplace_back(val);
-
-    auto it = lower_bound_idx(val);
-    m_sorted_indices.insert(it, idx);
+    m_index.insert(detail::value_hash(val), idx);
   }
 
   bool has_value(const value_type& val) const
   {
-    auto it = lower_bound_idx(val);
-    return it != m_sorted_indices.end() && val == at(*it);
+    return find(val) != npos;
+  }
+
+  // indexed hash of the value at idx
+  uint64_t hash_at(size_t idx) const
+  {
+    return m_index.hash((uint32_t)idx);
   }
 
   const std::vector<value_type>& values() const
@@ -63,52 +278,501 @@ struct value_pool
     return m_values;
   }
 
+  // used by loading
+  void assign(std::vector<value_type>&& values)
+  {
+    m_values = std::move(values);
+    reindex();
+  }
+
   friend streambase& operator<<(streambase& ar, value_pool& x)
   {
-    return ar << x.m_values;
-    if (!ar.is_reader())
+    ar << x.m_values;
+    if (ar.is_reader())
     {
-      x.m_sorted_indices.resize(x.m_values.size());
-      std::iota(x.m_sorted_indices.begin(), x.m_sorted_indices.end(), 0);
-      std::sort(x.m_sorted_indices.begin(), x.m_sorted_indices.end(), [&x](const size_t& a, const size_t& b) -> bool {
-        return x.m_values[a] < x.m_values[b];
-      });
+      x.reindex();
     }
+    return ar;
   }
 
 protected:
+  void reindex()
+  {
+    m_index.clear();
+    m_index.reserve(m_values.size());
+    for (uint32_t idx = 0; idx < (uint32_t)m_values.size(); ++idx)
+    {
+      m_index.insert(detail::value_hash<value_type>(m_values[idx]), idx);
+    }
+  }
+
   std::vector<value_type> m_values;
+  detail::pool_index m_index;
+};
+
+// Deduplicated arrays of flat elements (e.g. array:Int32, array:Vector3).
+// All elements are stored contiguously, arrays are ranges of them.
+template <typename E>
+struct flat_array_pool
+{
+  static_assert(detail::is_flat<E>::value);
+
+  using element_type = E;
+  using value_type = std::vector<E>;
 
-  // Accelerated search
+  static constexpr uint32_t npos = detail::pool_index::npos;
 
-  std::vector<size_t> m_sorted_indices;
+  size_t size() const
+  {
+    return m_offsets.size() - 1;
+  }
+
+  std::span<const E> at(size_t idx) const
+  {
+    return std::span<const E>(m_elements.data() + m_offsets[idx], m_offsets[idx + 1] - m_offsets[idx]);
+  }
+
+  // Returns the index of the array in pool, npos if not found.
+  uint32_t find(std::span<const E> val) const
+  {
+    return m_index.find(hash(val), [&](uint32_t idx) {
+      return equal(at(idx), val);
+    });
+  }
+
+  // Returns the index of the array in pool.
+  const size_t insert(std::span<const E> val)
+  {
+    const uint64_t h = hash(val);
+    const uint32_t found_idx = m_index.find(h, [&](uint32_t idx) {
+      return equal(at(idx), val);
+    });
+
+    if (found_idx != npos)
+    {
+      return found_idx;
+    }
+
+    return append(val, h);
+  }
+
+  // This is used for serialiation, arrays aren't deduplicated
+  const void push_back(std::span<const E> val)
+  {
+    append(val, hash(val));
+  }
 
-  struct search_value_t
+  bool has_value(std::span<const E> val) const
   {
-    const std::vector<value_type>& values;
-    const value_type& ref;
+    return find(val) != npos;
+  }
+
+  // indexed hash of the array at idx
+  uint64_t hash_at(size_t idx) const
+  {
+    return m_index.hash((uint32_t)idx);
+  }
 
-    bool operator>(const size_t& idx) const
+  // all arrays' elements
+  const std::vector<E>& elements() const
+  {
+    return m_elements;
+  }
+
+  // used by loading, offsets has one more entry than there are arrays
+  void assign(std::vector<E>&& elements, std::vector<uint32_t>&& offsets)
+  {
+    m_elements = std::move(elements);
+    m_offsets = std::move(offsets);
+    if (m_offsets.empty())
     {
-      const bool ret = ref > values[idx];
-      return ret;
+      m_offsets.push_back(0);
     }
 
-    friend bool operator<(const size_t& idx, const search_value_t& sv)
+    m_index.clear();
+    m_index.reserve(size());
+    for (uint32_t idx = 0; idx < (uint32_t)size(); ++idx)
     {
-      return sv.operator>(idx);
+      m_index.insert(hash(at(idx)), idx);
     }
-  };
+  }
 
-  std::vector<size_t>::const_iterator lower_bound_idx(std::string_view s) const
+  // same layout as value_pool<std::vector<E>>
+  friend streambase& operator<<(streambase& ar, flat_array_pool& x)
   {
-    // TODO (in 2022): C++20 has a variant with Pred.
-    return std::lower_bound(
-      m_sorted_indices.begin(),
-      m_sorted_indices.end(),
-      search_value_t{this, s}
-    );
+    uint32_t cnt = (uint32_t)x.size();
+    ar << cnt;
+
+    if (ar.is_reader())
+    {
+      std::vector<E> elements;
+      std::vector<uint32_t> offsets;
+      offsets.reserve(size_t(cnt) + 1);
+      offsets.push_back(0);
+      for (uint32_t i = 0; i < cnt && !ar.has_error(); ++i)
+      {
+        uint32_t len = 0;
+        ar << len;
+        elements.resize(elements.size() + len);
+        for (uint32_t j = 0; j < len; ++j)
+        {
+          ar << elements[elements.size() - len + j];
+        }
+        offsets.push_back((uint32_t)elements.size());
+      }
+      x.assign(std::move(elements), std::move(offsets));
+    }
+    else
+    {
+      for (uint32_t i = 0; i < cnt; ++i)
+      {
+        uint32_t len = x.m_offsets[i + 1] - x.m_offsets[i];
+        ar << len;
+        for (uint32_t j = 0; j < len; ++j)
+        {
+          ar << x.m_elements[x.m_offsets[i] + j];
+        }
+      }
+    }
+
+    return ar;
+  }
+
+protected:
+  static uint64_t hash(std::span<const E> val)
+  {
+    return detail::hash_bytes(val.data(), val.size() * sizeof(E));
+  }
+
+  static bool equal(std::span<const E> a, std::span<const E> b)
+  {
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(E)) == 0;
+  }
+
+  uint32_t append(std::span<const E> val, uint64_t h)
+  {
+    const uint32_t idx = (uint32_t)size();
+    m_elements.insert(m_elements.end(), val.begin(), val.end());
+    m_offsets.push_back((uint32_t)m_elements.size());
+    m_index.insert(h, idx);
+    return idx;
+  }
+
+  std::vector<E> m_elements;
+  std::vector<uint32_t> m_offsets = {0};
+  detail::pool_index m_index;
+};
+
+namespace detail {
+
+// appends the cnt low bits of bits at bit position pos, bits past pos must
+// be zero and words must hold exactly the words pos touches
+inline void append_bits(std::vector<uint64_t>& words, size_t pos, uint64_t bits, uint32_t cnt)
+{
+  if (!cnt)
+  {
+    return;
+  }
+
+  const uint32_t shift = pos & 63;
+  if (!shift)
+  {
+    words.push_back(bits);
+    return;
+  }
+
+  words.back() |= bits << shift;
+  if (shift + cnt > 64)
+  {
+    words.push_back(bits >> (64 - shift));
+  }
+}
+
+} // namespace detail
+
+// bit-packed view of a bool array, bits are counted from the low bit of
+// each word. valid as long as the pool it comes from isn't modified.
+struct bool_array_view
+{
+  const uint64_t* words = nullptr;
+  size_t first = 0; // bit offset of the first element in words
+  size_t len = 0;
+
+  size_t size() const
+  {
+    return len;
+  }
+
+  bool empty() const
+  {
+    return len == 0;
+  }
+
+  bool operator[](size_t i) const
+  {
+    const size_t bit = first + i;
+    return (words[bit >> 6] >> (bit & 63)) & 1;
+  }
+
+  size_t words_count() const
+  {
+    return (len + 63) / 64;
+  }
+
+  // elements [i * 64, i * 64 + 64), zero past the end
+  uint64_t word(size_t i) const
+  {
+    const size_t bit = first + i * 64;
+    const size_t end = first + len;
+    const uint32_t shift = bit & 63;
+
+    uint64_t ret = words[bit >> 6] >> shift;
+    if (shift && (bit - shift) + 64 < end)
+    {
+      ret |= words[(bit >> 6) + 1] << (64 - shift);
+    }
+
+    const size_t remaining = len - i * 64;
+    return remaining < 64 ? ret & ((uint64_t(1) << remaining) - 1) : ret;
+  }
+
+  friend bool operator==(const bool_array_view& a, const bool_array_view& b)
+  {
+    if (a.len != b.len)
+    {
+      return false;
+    }
+
+    for (size_t i = 0; i < a.words_count(); ++i)
+    {
+      if (a.word(i) != b.word(i))
+      {
+        return false;
+      }
+    }
+
+    return true;
   }
 };
 
-} // namespace cp::tdb
\ No newline at end of file
+// Deduplicated arrays of bools (array:Bool).
+// All elements are packed in one bit buffer, arrays are ranges of it.
+struct bool_array_pool
+{
+  using element_type = bool;
+  using value_type = std::vector<bool>;
+
+  static constexpr uint32_t npos = detail::pool_index::npos;
+
+  size_t size() const
+  {
+    return m_offsets.size() - 1;
+  }
+
+  bool_array_view at(size_t idx) const
+  {
+    return bool_array_view{m_words.data(), m_offsets[idx], size_t(m_offsets[idx + 1] - m_offsets[idx])};
+  }
+
+  // Returns the index of the array in pool, npos if not found.
+  uint32_t find(bool_array_view val) const
+  {
+    return m_index.find(hash(val), [&](uint32_t idx) {
+      return at(idx) == val;
+    });
+  }
+
+  uint32_t find(const std::vector<bool>& val) const
+  {
+    const auto words = pack(val);
+    return find(bool_array_view{words.data(), 0, val.size()});
+  }
+
+  // Returns the index of the array in pool.
+  const size_t insert(bool_array_view val)
+  {
+    const uint64_t h = hash(val);
+    const uint32_t found_idx = m_index.find(h, [&](uint32_t idx) {
+      return at(idx) == val;
+    });
+
+    if (found_idx != npos)
+    {
+      return found_idx;
+    }
+
+    return append(val, h);
+  }
+
+  const size_t insert(const std::vector<bool>& val)
+  {
+    const auto words = pack(val);
+    return insert(bool_array_view{words.data(), 0, val.size()});
+  }
+
+  // This is used for serialiation, arrays aren't deduplicated
+  const void push_back(bool_array_view val)
+  {
+    append(val, hash(val));
+  }
+
+  bool has_value(bool_array_view val) const
+  {
+    return find(val) != npos;
+  }
+
+  // indexed hash of the array at idx
+  uint64_t hash_at(size_t idx) const
+  {
+    return m_index.hash((uint32_t)idx);
+  }
+
+  // used by loading, offsets are bit offsets in words and have one more
+  // entry than there are arrays
+  void assign(std::vector<uint64_t>&& words, std::vector<uint32_t>&& offsets)
+  {
+    m_words = std::move(words);
+    m_offsets = std::move(offsets);
+    if (m_offsets.empty())
+    {
+      m_offsets.push_back(0);
+    }
+
+    m_index.clear();
+    m_index.reserve(size());
+    for (uint32_t idx = 0; idx < (uint32_t)size(); ++idx)
+    {
+      m_index.insert(hash(at(idx)), idx);
+    }
+  }
+
+  // same layout as value_pool<std::vector<bool>> (a byte per element)
+  friend streambase& operator<<(streambase& ar, bool_array_pool& x)
+  {
+    uint32_t cnt = (uint32_t)x.size();
+    ar << cnt;
+
+    if (ar.is_reader())
+    {
+      std::vector<uint64_t> words;
+      std::vector<uint32_t> offsets;
+      offsets.reserve(size_t(cnt) + 1);
+      offsets.push_back(0);
+      for (uint32_t i = 0; i < cnt && !ar.has_error(); ++i)
+      {
+        uint32_t len = 0;
+        ar << len;
+        for (uint32_t j = 0; j < len && !ar.has_error(); ++j)
+        {
+          bool b = false;
+          ar << b;
+          detail::append_bits(words, offsets.back() + j, b ? 1 : 0, 1);
+        }
+        offsets.push_back(offsets.back() + len);
+      }
+      x.assign(std::move(words), std::move(offsets));
+    }
+    else
+    {
+      for (uint32_t i = 0; i < cnt; ++i)
+      {
+        const auto val = x.at(i);
+        uint32_t len = (uint32_t)val.size();
+        ar << len;
+        for (uint32_t j = 0; j < len; ++j)
+        {
+          bool b = val[j];
+          ar << b;
+        }
+      }
+    }
+
+    return ar;
+  }
+
+protected:
+  static std::vector<uint64_t> pack(const std::vector<bool>& val)
+  {
+    std::vector<uint64_t> words((val.size() + 63) / 64);
+    for (size_t i = 0; i < val.size(); ++i)
+    {
+      if (val[i])
+      {
+        words[i >> 6] |= uint64_t(1) << (i & 63);
+      }
+    }
+    return words;
+  }
+
+  static uint64_t hash(bool_array_view val)
+  {
+    uint64_t h = val.size();
+    for (size_t i = 0; i < val.words_count(); ++i)
+    {
+      const uint64_t w = val.word(i);
+      h = detail::hash_combine(h, detail::hash_bytes(&w, sizeof(w)));
+    }
+    return h;
+  }
+
+  uint32_t append(bool_array_view val, uint64_t h)
+  {
+    // val can view this pool's words, which can be reallocated
+    std::vector<uint64_t> src(val.words_count());
+    for (size_t i = 0; i < src.size(); ++i)
+    {
+      src[i] = val.word(i);
+    }
+
+    const uint32_t idx = (uint32_t)size();
+    size_t pos = m_offsets.back();
+    for (size_t i = 0; i < src.size(); ++i)
+    {
+      const uint32_t cnt = (uint32_t)std::min<size_t>(64, val.size() - i * 64);
+      detail::append_bits(m_words, pos, src[i], cnt);
+      pos += cnt;
+    }
+
+    m_offsets.push_back((uint32_t)pos);
+    m_index.insert(h, idx);
+    return idx;
+  }
+
+  std::vector<uint64_t> m_words;
+  std::vector<uint32_t> m_offsets = {0};
+  detail::pool_index m_index;
+};
+
+template <typename T>
+struct is_flat_array_pool : std::false_type {};
+
+template <typename E>
+struct is_flat_array_pool<flat_array_pool<E>> : std::true_type {};
+
+template <typename T>
+struct is_bool_array_pool : std::false_type {};
+
+template <>
+struct is_bool_array_pool<bool_array_pool> : std::true_type {};
+
+// storage of a pool's values
+template <typename T>
+struct pool_storage
+{
+  using type = value_pool<T>;
+};
+
+template <typename E>
+struct pool_storage<std::vector<E>>
+{
+  using type = std::conditional_t<detail::is_flat<E>::value, flat_array_pool<E>, value_pool<std::vector<E>>>;
+};
+
+template <>
+struct pool_storage<std::vector<bool>>
+{
+  using type = bool_array_pool;
+};
+
+} // namespace cp::tdb
+
@@ -97,6 +97,88 @@ public:
 };
 
 
+// writes into a referenced vector (which keeps its capacity on reset),
+// seeking back and overwriting is supported
+class vector_ostreambuf
+	: public std::streambuf
+{
+	std::vector<char>* m_vec = nullptr;
+	size_t m_pos = 0;
+
+public:
+	vector_ostreambuf() = default;
+	explicit vector_ostreambuf(std::vector<char>& vec)
+		: m_vec(&vec), m_pos(vec.size()) {}
+
+	// empties the vector without releasing its memory
+	void reset()
+	{
+		if (m_vec)
+			m_vec->clear();
+		m_pos = 0;
+	}
+
+protected:
+	// Positioning
+
+	std::streampos seekoff(
+		std::streamoff off,
+		std::ios_base::seekdir way,
+		std::ios_base::openmode mode = std::ios_base::out) override
+	{
+		if (!m_vec || !(mode & std::ios_base::out))
+			return std::streampos(-1);
+
+		switch (way)
+		{
+			case std::ios_base::beg: break;
+			case std::ios_base::cur: off += m_pos; break;
+			case std::ios_base::end: off += m_vec->size(); break;
+			default:
+				return std::streampos(-1);
+		}
+
+		if (off < 0 || (size_t)off > m_vec->size())
+			return std::streampos(-1);
+
+		m_pos = (size_t)off;
+		return std::streampos(off);
+	}
+
+	std::streampos seekpos(
+		std::streampos streampos,
+		std::ios_base::openmode mode = std::ios_base::out) override
+	{
+		return seekoff(streampos, std::ios_base::beg, mode);
+	}
+
+	// Put area
+
+	std::streamsize xsputn(const char* s, std::streamsize n) override
+	{
+		if (!m_vec)
+			return 0;
+
+		const size_t end_pos = m_pos + (size_t)n;
+		if (end_pos > m_vec->size())
+			m_vec->resize(end_pos);
+
+		std::copy(s, s + n, m_vec->data() + m_pos);
+		m_pos = end_pos;
+		return n;
+	}
+
+	int_type overflow(int_type c) override
+	{
+		if (traits_type::eq_int_type(c, traits_type::eof()))
+			return traits_type::not_eof(c);
+
+		const char ch = traits_type::to_char_type(c);
+		return xsputn(&ch, 1) == 1 ? c : traits_type::eof();
+	}
+};
+
+
 // does update the parent stream read position
 class isubstreambuf
 	: public std::streambuf
@@ -5,6 +5,8 @@
 #include <sstream>
 #include <fstream>
 #include <iomanip>
+#include <new>
+#include <cstdlib>
 
 #include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
@@ -15,10 +17,62 @@
 #include <cpinternals/tmp/archive_test.hpp>
 //#include <cpinternals/radr.hpp>
 #include <cpinternals/init.hpp>
+#include <cpinternals/common/alloc_profiler.hpp>
 #include "appbase/app_version.h"
+#include "appbase/frame_profiler.hpp"
 
 using namespace std::chrono_literals;
 
+//--------------------------------------------------------
+// allocations counting (frame profiler)
+
+static thread_local uint64_t tls_allocs_cnt = 0;
+
+static uint64_t thread_allocs_count()
+{
+  return tls_allocs_cnt;
+}
+
+void* operator new(size_t size)
+{
+  ++tls_allocs_cnt;
+  cp::profile_alloc(size);
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+  cp::profile_free(0);
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+  cp::profile_free(0);
+  std::free(p);
+}
+
+void operator delete(void* p, size_t size) noexcept
+{
+  cp::profile_free(size);
+  std::free(p);
+}
+
+void operator delete[](void* p, size_t size) noexcept
+{
+  cp::profile_free(size);
+  std::free(p);
+}
+
+//--------------------------------------------------------
+
 void to_json(nlohmann::json& j, const ImVec4& p)
 {
   j = {{"x", p.x}, {"y", p.y}, {"z", p.z}, {"w", p.w}};
@@ -64,6 +118,7 @@ protected:
 protected:
   void startup() override
   {
+    cp::set_allocs_counter(&thread_allocs_count);
 
 #ifdef _DEBUG
 
@@ -178,6 +233,7 @@ protected:
     static bool test_hexeditor = false;
     static bool imgui_demo = false;
     static bool imgui_style_editor = false;
+    static bool show_frame_profiler = false;
 
 
     static bool cploaded = cp::init_cpinternals();
@@ -202,6 +258,20 @@ protected:
       {
         csav_list.draw_menu_item(this);
 
+        if (ImGui::BeginMenu("Edit"))
+        {
+          auto& history = node_editor_widget::history();
+          const bool can_undo = history.can_undo();
+          const bool can_redo = history.can_redo();
+          std::string undo_label = can_undo ? "undo " + history.undo_label() : "undo";
+          std::string redo_label = can_redo ? "redo " + history.redo_label() : "redo";
+          if (ImGui::MenuItem(undo_label.c_str(), 0, false, can_undo))
+            history.undo();
+          if (ImGui::MenuItem(redo_label.c_str(), 0, false, can_redo))
+            history.redo();
+          ImGui::EndMenu();
+        }
+
         if (ImGui::BeginMenu("Options"))
         {
           imgui_style_editor |= ImGui::MenuItem("ui style editor", 0, false);
@@ -212,6 +282,8 @@ protected:
         {
           if (ImGui::MenuItem("imgui demo", 0, false))
             imgui_demo = true;
+          if (ImGui::MenuItem("frame profiler", 0, false))
+            show_frame_profiler = true;
           ImGui::EndMenu(); 
         }
 
@@ -252,6 +324,9 @@ protected:
     if (imgui_demo)
       ImGui::ShowDemoWindow(&imgui_demo);
 
+    if (show_frame_profiler)
+      frame_profiler::get().draw_window(&show_frame_profiler);
+
     if (imgui_style_editor)
     {
       ImGui::Begin("ImGui Style Editor", &imgui_style_editor);
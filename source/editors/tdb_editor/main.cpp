@@ -43,6 +43,7 @@ protected:
   ImVec4 addr_color = ImVec4(0.f, 0.6f, 0.8f, 1.f);
 
   cp::tdb::tweakdb tdb;
+  ui::tweakdb_widget tdb_widget;
 
 public:
   CPTEApp()
@@ -187,8 +188,7 @@ protected:
         ImGui::EndMainMenuBar();
       }
 
-      static int selected = 0;
-      ui::im_tweakdb(tdb, &selected);
+      tdb_widget.draw(tdb);
     }
     ImGui::End();
 
@@ -215,6 +215,7 @@ protected:
     auto fname = p.filename().string();
     if (fname.rfind("tweakdb.bin", 0) == 0)
     {
+      tdb_widget.reset();
       tdb.open(fpath);
       return;
     }
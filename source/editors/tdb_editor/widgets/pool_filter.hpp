@@ -0,0 +1,329 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <appbase/IApp.hpp>
+#include <cpinternals/common/parallel.hpp>
+#include <cpinternals/tweakdb/tweakdb.hpp>
+
+namespace ui {
+
+using namespace cp::tdb;
+
+// formatting of pool values for display and search
+
+inline std::string format_value(const std::string& v) { return v; }
+inline std::string format_value(bool v) { return v ? "true" : "false"; }
+inline std::string format_value(int32_t v) { return fmt::format("{}", v); }
+inline std::string format_value(uint64_t v) { return fmt::format("{:016X}", v); }
+inline std::string format_value(float v) { return fmt::format("{}", v); }
+inline std::string format_value(const cp::CName& v) { return v.string(); }
+inline std::string format_value(const Vector2& v) { return fmt::format("({}, {})", v.x, v.y); }
+inline std::string format_value(const Vector3& v) { return fmt::format("({}, {}, {})", v.x, v.y, v.z); }
+inline std::string format_value(const EulerAngles& v) { return fmt::format("({}, {}, {})", v.pitch, v.yaw, v.roll); }
+
+inline std::string format_value(const cp::TweakDBID& v)
+{
+  auto name = v.name();
+  return name ? name.string() : fmt::format("<tdbid:{:010X}>", v.as_u64);
+}
+
+inline std::string format_value(const Quaternion& v)
+{
+  return fmt::format("({}, {}, {}, {})", v.x.name.strv(), v.y.name.strv(), v.z.name.strv(), v.w.name.strv());
+}
+
+// arrays are clipped, long ones would only make the list unreadable
+inline constexpr size_t max_formatted_elements = 16;
+
+template <typename E>
+std::string format_value(std::span<const E> v)
+{
+  std::string s = "[";
+  for (size_t i = 0; i < v.size() && i < max_formatted_elements; ++i)
+  {
+    if (i)
+      s += ", ";
+    s += format_value(v[i]);
+  }
+  if (v.size() > max_formatted_elements)
+    s += fmt::format(", ... ({} total)", v.size());
+  s += "]";
+  return s;
+}
+
+template <typename E>
+std::string format_value(const std::vector<E>& v)
+{
+  return format_value(std::span<const E>(v));
+}
+
+inline std::string format_value(const bool_array_view& v)
+{
+  std::string s = "[";
+  for (size_t i = 0; i < v.size() && i < max_formatted_elements; ++i)
+  {
+    if (i)
+      s += ", ";
+    s += format_value(v[i]);
+  }
+  if (v.size() > max_formatted_elements)
+    s += fmt::format(", ... ({} total)", v.size());
+  s += "]";
+  return s;
+}
+
+// Entries of a pool ("name = value", one per key) with their lower-cased
+// search keys. Immutable once built so that filter jobs can share it.
+class pool_search_index
+{
+public:
+  // entries are formatted in chunks across workers_cnt threads (0: hardware)
+  static std::shared_ptr<const pool_search_index> build(tweakdb& tdb, size_t pool_idx, size_t workers_cnt = 0)
+  {
+    auto ret = std::make_shared<pool_search_index>();
+
+    const auto& descs = tdb.pools_descs();
+    if (pool_idx >= descs.size())
+      return ret;
+
+    const auto kind = static_cast<pool_element_kind>(descs[pool_idx].ctypename.hash);
+    tdb.visit_pool(kind, [&](auto& pool, size_t) {
+      const size_t cnt = pool.keys.size();
+      ret->m_labels.resize(cnt);
+      ret->m_keys.resize(cnt);
+
+      cp::parallel_for(chunks_count(cnt), workers_cnt, [&](size_t chunk) {
+        const size_t end = std::min(cnt, (chunk + 1) * chunk_size);
+        for (size_t i = chunk * chunk_size; i < end; ++i)
+        {
+          const auto& key = pool.keys[i];
+          std::string value = key.idx < pool.vpool.size()
+            ? format_value(pool.vpool.at(key.idx)) : "<invalid value index>";
+          ret->m_labels[i] = fmt::format("{} = {}", format_value(key.key), value);
+          ret->m_keys[i] = to_lower(ret->m_labels[i]);
+        }
+      });
+    });
+
+    return ret;
+  }
+
+  size_t size() const
+  {
+    return m_labels.size();
+  }
+
+  const std::string& label(size_t idx) const
+  {
+    return m_labels[idx];
+  }
+
+  // needles must be lower-cased
+  bool matches(size_t idx, std::string_view needle, bool fuzzy) const
+  {
+    const std::string_view key = m_keys[idx];
+    return fuzzy ? is_subsequence(needle, key) : key.find(needle) != std::string_view::npos;
+  }
+
+  // tells if the matches of needle are a subset of the matches of prev_needle
+  static bool refines(std::string_view prev_needle, std::string_view needle, bool fuzzy)
+  {
+    return fuzzy ? is_subsequence(prev_needle, needle) : needle.find(prev_needle) != std::string_view::npos;
+  }
+
+  static std::string to_lower(std::string_view s)
+  {
+    std::string ret(s);
+    for (char& c : ret)
+    {
+      if (c >= 'A' && c <= 'Z')
+        c = static_cast<char>(c - 'A' + 'a');
+    }
+    return ret;
+  }
+
+  static constexpr size_t chunk_size = 0x1000;
+
+  static size_t chunks_count(size_t cnt)
+  {
+    return (cnt + chunk_size - 1) / chunk_size;
+  }
+
+protected:
+  static bool is_subsequence(std::string_view needle, std::string_view s)
+  {
+    size_t i = 0;
+    for (size_t j = 0; i < needle.size() && j < s.size(); ++j)
+    {
+      if (s[j] == needle[i])
+        ++i;
+    }
+    return i == needle.size();
+  }
+
+  std::vector<std::string> m_labels;
+  std::vector<std::string> m_keys;
+};
+
+// Background filtering of a pool_search_index, entries are matched in
+// chunks across threads and the sorted matching indices are handed to the
+// UI thread by poll() once complete.
+// A filter whose needle refines the previous completed one (e.g. the user
+// typed one more character) only goes through the previous matches.
+class pool_filter_job
+{
+public:
+  using index_type = pool_search_index;
+
+  pool_filter_job() = default;
+  pool_filter_job(const pool_filter_job&) = delete;
+  pool_filter_job& operator=(const pool_filter_job&) = delete;
+
+  ~pool_filter_job()
+  {
+    cancel();
+  }
+
+  bool is_running() const { return m_running; }
+
+  // matching indices of the last completed filter
+  const std::vector<uint32_t>& results() const { return m_results; }
+
+  void start(const std::shared_ptr<const index_type>& index, std::string_view needle, bool fuzzy, size_t workers_cnt = 0)
+  {
+    poll();
+
+    std::string lneedle = index_type::to_lower(needle);
+
+    const bool refine = !is_running() && m_completed && m_index == index
+      && m_fuzzy == fuzzy && index_type::refines(m_needle, lneedle, fuzzy);
+
+    std::vector<uint32_t> candidates;
+    if (refine)
+      candidates = m_results;
+
+    cancel();
+
+    // results of another index are meaningless
+    if (m_index != index)
+      m_results.clear();
+
+    m_index = index;
+    m_needle = lneedle;
+    m_fuzzy = fuzzy;
+
+    auto st = std::make_shared<state>();
+    m_state = st;
+
+    IApp::begin_background_job();
+    m_running = true;
+    m_filter.run([st, index, lneedle = std::move(lneedle), fuzzy, refine, workers_cnt, candidates = std::move(candidates)]()
+    {
+      const size_t cnt = refine ? candidates.size() : index->size();
+      std::vector<std::vector<uint32_t>> chunks(index_type::chunks_count(cnt));
+
+      bool completed = true;
+      try
+      {
+        cp::parallel_for(chunks.size(), workers_cnt, [&](size_t chunk) {
+          if (st->cancel)
+            return;
+          const size_t end = std::min(cnt, (chunk + 1) * index_type::chunk_size);
+          for (size_t i = chunk * index_type::chunk_size; i < end; ++i)
+          {
+            const uint32_t idx = refine ? candidates[i] : (uint32_t)i;
+            if (lneedle.empty() || index->matches(idx, lneedle, fuzzy))
+              chunks[chunk].push_back(idx);
+          }
+        });
+      }
+      catch (std::exception&)
+      {
+        completed = false;
+      }
+
+      if (st->cancel)
+        completed = false;
+
+      if (completed)
+      {
+        std::vector<uint32_t> matches;
+        for (auto& c : chunks)
+          matches.insert(matches.end(), c.begin(), c.end());
+        std::lock_guard<std::mutex> lock(st->mtx);
+        st->results = std::move(matches);
+      }
+
+      st->completed = completed;
+      st->done = true;
+      IApp::end_background_job();
+    });
+  }
+
+  // returns true if new results are available
+  bool poll()
+  {
+    if (!m_state || !m_state->done || !m_running)
+      return false;
+
+    m_filter.wait();
+    m_running = false;
+    m_completed = m_state->completed;
+    if (m_completed)
+    {
+      std::lock_guard<std::mutex> lock(m_state->mtx);
+      m_results = std::move(m_state->results);
+    }
+    return m_completed;
+  }
+
+  // discards the running filter, blocks until its task is done.
+  // the last results are kept.
+  void cancel()
+  {
+    if (m_state)
+      m_state->cancel = true;
+    if (m_running)
+      m_filter.wait();
+    m_running = false;
+    m_state.reset();
+    m_completed = false;
+  }
+
+  void reset()
+  {
+    cancel();
+    m_index.reset();
+    m_results.clear();
+  }
+
+protected:
+  struct state
+  {
+    std::atomic<bool> cancel = false;
+    std::atomic<bool> done = false;
+    bool completed = false; // valid once done
+    std::mutex mtx;
+    std::vector<uint32_t> results;
+  };
+
+  cp::task_group m_filter{cp::task_priority::high};
+  bool m_running = false;
+  std::shared_ptr<state> m_state;
+
+  // last filter
+  std::shared_ptr<const index_type> m_index;
+  std::string m_needle;
+  bool m_fuzzy = false;
+  bool m_completed = false;
+  std::vector<uint32_t> m_results;
+};
+
+} // namespace ui
+
@@ -4,21 +4,82 @@
 
 namespace ui {
 
-bool im_tweakdb(tweakdb& tdb, int* selected)
+bool tweakdb_widget::draw(tweakdb& tdb)
 {
   bool modified = false;
 
   ImGui::BeginGroup();
   {
     ImGui::Text("pool descs:");
-    ImGui::ListBox("pool descs", selected, [](const pool_desc_t& pd) -> std::string {
+    ImGui::ListBox("pool descs", &m_selected, [](const pool_desc_t& pd) -> std::string {
       return fmt::format("{}[{}]", pd.ctypename.name().strv(), pd.len);
     }, tdb.pools_descs());
+    ImGui::Text("groups: %zu, inlgroups: %zu, packages: %zu",
+      tdb.groups().size(), tdb.inlgroups().size(), tdb.packages().size());
   }
   ImGui::EndGroup();
 
+  ImGui::SameLine();
+
+  ImGui::BeginGroup();
+  draw_pool_entries(tdb);
+  ImGui::EndGroup();
+
   return modified;
 }
 
+void tweakdb_widget::draw_pool_entries(tweakdb& tdb)
+{
+  bool refilter = false;
+
+  if (m_selected != m_index_pool)
+  {
+    m_filter_job.reset();
+    m_index = pool_search_index::build(tdb, (size_t)m_selected);
+    m_index_pool = m_selected;
+    refilter = true;
+  }
+
+  refilter |= ImGui::InputText("filter", m_needle.data(), m_needle.size());
+  ImGui::SameLine();
+  refilter |= ImGui::Checkbox("fuzzy", &m_fuzzy);
+
+  // typing restarts the filter, previous results stay displayed meanwhile
+  if (refilter)
+    m_filter_job.start(m_index, m_needle.data(), m_fuzzy);
+
+  m_filter_job.poll();
+
+  const auto& results = m_filter_job.results();
+  ImGui::Text("%zu/%zu entries%s", results.size(), m_index->size(),
+    m_filter_job.is_running() ? " (filtering..)" : "");
+
+  static ImGuiTableFlags flags = ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg
+    | ImGuiTableFlags_BordersOuter | ImGuiTableFlags_BordersV;
+
+  ImVec2 size = ImVec2(0, ImGui::GetContentRegionAvail().y);
+  if (ImGui::BeginTable("##pool_entries", 1, flags, size))
+  {
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableSetupColumn("entries", ImGuiTableColumnFlags_WidthStretch);
+    ImGui::TableHeadersRow();
+
+    // only visible rows are submitted
+    ImGuiListClipper clipper;
+    clipper.Begin((int)results.size());
+    while (clipper.Step())
+    {
+      for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++)
+      {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(m_index->label(results[row]).c_str());
+      }
+    }
+
+    ImGui::EndTable();
+  }
+}
+
 } // namespace ui
 
@@ -1,11 +1,39 @@
 #pragma once
+#include <array>
+#include <memory>
 #include <cpinternals/tweakdb/tweakdb.hpp>
+#include "pool_filter.hpp"
 
 namespace ui {
 
 using namespace cp::tdb;
 
-bool im_tweakdb(tweakdb& tdb, int* selected);
+// pools list and filterable entries of the selected pool
+class tweakdb_widget
+{
+public:
+  // to be called when the tweakdb is reloaded
+  void reset()
+  {
+    m_filter_job.reset();
+    m_index.reset();
+    m_index_pool = -1;
+  }
+
+  bool draw(tweakdb& tdb);
+
+protected:
+  void draw_pool_entries(tweakdb& tdb);
+
+  int m_selected = 0;
+
+  // entries of the selected pool
+  int m_index_pool = -1;
+  std::shared_ptr<const pool_search_index> m_index;
+  pool_filter_job m_filter_job;
+  std::array<char, 256> m_needle = {};
+  bool m_fuzzy = false;
+};
 
 } // namespace ui
 
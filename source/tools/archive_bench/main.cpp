@@ -0,0 +1,511 @@
+#define NOMINMAX
+#include <Windows.h>
+#include <string>
+#include <vector>
+#include <array>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <cstdlib>
+#include <algorithm>
+#include <filesystem>
+
+#include <spdlog/spdlog.h>
+#include <cpinternals/common/latency_histogram.hpp>
+#include <cpinternals/archive/archive.hpp>
+#include <cpinternals/archive/segment_cache.hpp>
+#include <cpinternals/io/archive_file_istream.hpp>
+#include <cpinternals/oodle/oodle.hpp>
+
+namespace fs = std::filesystem;
+
+// read throughput of archives, to catch regressions of the archive readers
+// usage: archive_bench <archive_or_dir>... [-n reads] [-j readers] [-s size] [-m] [-f text|json|csv]
+//
+// scenarios, each run on the files whose first segment is raw and on the
+// ones whose first segment is oodle-compressed:
+//  - seq: full-file reads through archive_file_istream,
+//  - random: small reads at random offsets of random files (read_file_range),
+//  - concurrent: the random reads from several threads on the same archive,
+//  - decode: compressed first segments read raw then decompressed, gives the
+//    share of the time spent in oodle.
+// the segment cache is cleared before each scenario.
+// json output is one object per line (scenario x class), csv has a header.
+
+using clock_type = std::chrono::steady_clock;
+
+enum class output_format
+{
+  text,
+  json,
+  csv,
+};
+
+struct options
+{
+  std::vector<fs::path> inputs;
+  size_t reads_cnt = 10000;
+  size_t readers_cnt = 8;
+  size_t read_size = 4096;
+  bool mapped = false;
+  output_format format = output_format::text;
+};
+
+//--------------------------------------------------------
+// stats
+
+struct scenario_result
+{
+  std::string scenario;
+  std::string seg_class; // raw or oodle
+  size_t threads_cnt = 1;
+  uint64_t bytes = 0;
+  double wall_s = 0;
+  // decode scenario only
+  double io_s = 0;
+  double decode_s = 0;
+  uint64_t failed_cnt = 0;
+  cp::latency_histogram latencies;
+
+  double mb_per_s() const
+  {
+    return wall_s > 0 ? double(bytes) / (1024.0 * 1024.0) / wall_s : 0;
+  }
+
+  double iops() const
+  {
+    return wall_s > 0 ? double(latencies.count) / wall_s : 0;
+  }
+
+  double decode_share() const
+  {
+    return (io_s + decode_s) > 0 ? decode_s / (io_s + decode_s) : 0;
+  }
+};
+
+static uint64_t elapsed_ns(clock_type::time_point start)
+{
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start).count());
+}
+
+static double elapsed_s(clock_type::time_point start)
+{
+  return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+//--------------------------------------------------------
+// scenarios
+
+struct archive_files
+{
+  std::shared_ptr<cp::archive> ar;
+  // non-empty files by class of their first segment
+  std::vector<uint32_t> raw_files;
+  std::vector<uint32_t> oodle_files;
+
+  const std::vector<uint32_t>& files_of(bool compressed) const
+  {
+    return compressed ? oodle_files : raw_files;
+  }
+};
+
+static archive_files classify_files(const std::shared_ptr<cp::archive>& ar)
+{
+  archive_files ret;
+  ret.ar = ar;
+
+  const auto& segs = ar->segments();
+  const auto& records = ar->records();
+  for (uint32_t i = 0; i < records.size(); ++i)
+  {
+    const auto& rec = records[i];
+    if (!ar->is_valid_segments_irange(rec.segs_irange) || rec.segs_irange.empty())
+      continue;
+
+    if (ar->get_file_info(i).size == 0)
+      continue;
+
+    if (segs[rec.segs_irange.beg()].is_segment_compressed())
+      ret.oodle_files.push_back(i);
+    else
+      ret.raw_files.push_back(i);
+  }
+
+  return ret;
+}
+
+static void run_seq(const archive_files& af, bool compressed, scenario_result& res)
+{
+  static constexpr size_t chunk_size = 1024 * 1024;
+  std::vector<char> buf(chunk_size);
+
+  const auto wall_start = clock_type::now();
+  for (uint32_t idx : af.files_of(compressed))
+  {
+    const auto start = clock_type::now();
+
+    cp::archive_file_istream st(af.ar->get_file_handle(idx));
+    const size_t fsize = st.size();
+    size_t remaining = fsize;
+    while (remaining && !st.has_error())
+    {
+      const size_t cnt = std::min(remaining, chunk_size);
+      st.serialize_bytes(buf.data(), cnt);
+      remaining -= cnt;
+    }
+
+    if (st.has_error())
+    {
+      ++res.failed_cnt;
+      continue;
+    }
+
+    res.latencies.record(elapsed_ns(start));
+    res.bytes += fsize;
+  }
+  res.wall_s += elapsed_s(wall_start);
+}
+
+// reads_cnt reads of read_size bytes, returns the bytes read
+static uint64_t random_reads(const archive_files& af, bool compressed, const options& opts, uint32_t seed,
+  cp::latency_histogram& latencies, uint64_t& failed_cnt)
+{
+  const auto& files = af.files_of(compressed);
+  if (files.empty())
+    return 0;
+
+  std::mt19937_64 rng(seed);
+  std::vector<char> buf(opts.read_size);
+  uint64_t bytes = 0;
+
+  for (size_t i = 0; i < opts.reads_cnt; ++i)
+  {
+    const uint32_t idx = files[rng() % files.size()];
+    const uint64_t fsize = af.ar->get_file_info(idx).size;
+    const size_t cnt = static_cast<size_t>(std::min<uint64_t>(fsize, opts.read_size));
+    const uint64_t offset = fsize > cnt ? rng() % (fsize - cnt + 1) : 0;
+
+    const auto start = clock_type::now();
+    if (!af.ar->read_file_range(idx, offset, {buf.data(), cnt}))
+    {
+      ++failed_cnt;
+      continue;
+    }
+
+    latencies.record(elapsed_ns(start));
+    bytes += cnt;
+  }
+
+  return bytes;
+}
+
+static void run_random(const archive_files& af, bool compressed, const options& opts, scenario_result& res)
+{
+  const auto wall_start = clock_type::now();
+  res.bytes += random_reads(af, compressed, opts, 0x5EED, res.latencies, res.failed_cnt);
+  res.wall_s += elapsed_s(wall_start);
+}
+
+static void run_concurrent(const archive_files& af, bool compressed, const options& opts, scenario_result& res)
+{
+  struct reader_result
+  {
+    cp::latency_histogram latencies;
+    uint64_t bytes = 0;
+    uint64_t failed_cnt = 0;
+  };
+
+  std::vector<reader_result> results(opts.readers_cnt);
+  std::vector<std::thread> readers;
+  readers.reserve(opts.readers_cnt);
+
+  const auto wall_start = clock_type::now();
+  for (size_t i = 0; i < opts.readers_cnt; ++i)
+  {
+    readers.emplace_back([&, i]() {
+      auto& rr = results[i];
+      rr.bytes = random_reads(af, compressed, opts, 0x5EED + static_cast<uint32_t>(i), rr.latencies, rr.failed_cnt);
+    });
+  }
+
+  for (auto& t : readers)
+    t.join();
+  res.wall_s += elapsed_s(wall_start);
+
+  res.threads_cnt = opts.readers_cnt;
+  for (const auto& rr : results)
+  {
+    res.latencies.merge(rr.latencies);
+    res.bytes += rr.bytes;
+    res.failed_cnt += rr.failed_cnt;
+  }
+}
+
+static void run_decode(const archive_files& af, scenario_result& res)
+{
+  const auto& segs = af.ar->segments();
+  const auto& records = af.ar->records();
+
+  std::vector<char> raw;
+  std::vector<char> dst;
+
+  const auto wall_start = clock_type::now();
+  for (uint32_t idx : af.oodle_files)
+  {
+    const auto& sd = segs[records[idx].segs_irange.beg()];
+    raw.resize(sd.disk_size);
+    dst.resize(sd.size);
+
+    const auto start = clock_type::now();
+    if (!af.ar->read_segment(sd, raw, false))
+    {
+      ++res.failed_cnt;
+      continue;
+    }
+    const auto io_end = clock_type::now();
+
+    if (!cp::oodle::decompress(raw, dst, false))
+    {
+      ++res.failed_cnt;
+      continue;
+    }
+
+    res.io_s += std::chrono::duration<double>(io_end - start).count();
+    res.decode_s += elapsed_s(io_end);
+    res.latencies.record(elapsed_ns(start));
+    res.bytes += sd.size;
+  }
+  res.wall_s += elapsed_s(wall_start);
+}
+
+//--------------------------------------------------------
+// output
+
+static void print_results(const std::vector<scenario_result>& results, output_format format)
+{
+  if (format == output_format::json)
+  {
+    for (const auto& r : results)
+    {
+      fmt::print(
+        "{{\"scenario\":\"{}\",\"class\":\"{}\",\"threads\":{},\"reads\":{},\"failed\":{},\"bytes\":{},"
+        "\"wall_s\":{:.6f},\"mb_per_s\":{:.3f},\"iops\":{:.1f},\"mean_us\":{:.3f},\"p50_us\":{:.3f},"
+        "\"p90_us\":{:.3f},\"p99_us\":{:.3f},\"max_us\":{:.3f},\"decode_share\":{:.4f}}}\n",
+        r.scenario, r.seg_class, r.threads_cnt, r.latencies.count, r.failed_cnt, r.bytes,
+        r.wall_s, r.mb_per_s(), r.iops(), r.latencies.mean() / 1000.0, r.latencies.percentile(0.5) / 1000.0,
+        r.latencies.percentile(0.9) / 1000.0, r.latencies.percentile(0.99) / 1000.0, r.latencies.max / 1000.0,
+        r.decode_share());
+    }
+    return;
+  }
+
+  if (format == output_format::csv)
+  {
+    fmt::print("scenario,class,threads,reads,failed,bytes,wall_s,mb_per_s,iops,mean_us,p50_us,p90_us,p99_us,max_us,decode_share\n");
+    for (const auto& r : results)
+    {
+      fmt::print("{},{},{},{},{},{},{:.6f},{:.3f},{:.1f},{:.3f},{:.3f},{:.3f},{:.3f},{:.3f},{:.4f}\n",
+        r.scenario, r.seg_class, r.threads_cnt, r.latencies.count, r.failed_cnt, r.bytes,
+        r.wall_s, r.mb_per_s(), r.iops(), r.latencies.mean() / 1000.0, r.latencies.percentile(0.5) / 1000.0,
+        r.latencies.percentile(0.9) / 1000.0, r.latencies.percentile(0.99) / 1000.0, r.latencies.max / 1000.0,
+        r.decode_share());
+    }
+    return;
+  }
+
+  fmt::print("  {:<12}{:<7}{:>4}{:>10}{:>12}{:>12}{:>10}{:>10}{:>10}{:>10}{:>8}\n",
+    "scenario", "class", "thr", "reads", "MB/s", "IOPS", "p50 us", "p90 us", "p99 us", "max us", "decode");
+  for (const auto& r : results)
+  {
+    fmt::print("  {:<12}{:<7}{:>4}{:>10}{:>12.1f}{:>12.0f}{:>10.1f}{:>10.1f}{:>10.1f}{:>10.1f}{:>8}\n",
+      r.scenario, r.seg_class, r.threads_cnt, r.latencies.count, r.mb_per_s(), r.iops(),
+      r.latencies.percentile(0.5) / 1000.0, r.latencies.percentile(0.9) / 1000.0, r.latencies.percentile(0.99) / 1000.0,
+      r.latencies.max / 1000.0,
+      r.scenario == "decode" ? fmt::format("{:.1f}%", r.decode_share() * 100.0) : std::string("-"));
+    if (r.failed_cnt)
+      fmt::print("  {} failed read(s)\n", r.failed_cnt);
+  }
+}
+
+//--------------------------------------------------------
+
+static void print_usage()
+{
+  fmt::print(
+    "usage: archive_bench <archive_or_dir>... [-n reads] [-j readers] [-s size] [-m] [-f text|json|csv]\n"
+    "  -n  random reads per reader (default: 10000)\n"
+    "  -j  readers of the concurrent scenario (default: 8)\n"
+    "  -s  size of the random reads in bytes (default: 4096)\n"
+    "  -m  load the archives memory-mapped\n"
+    "  -f  output format (default: text), json is one object per line\n");
+}
+
+static bool parse_args(int argc, wchar_t* argv[], options& opts)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::wstring arg = argv[i];
+    if (arg == L"-n" && i + 1 < argc)
+    {
+      opts.reads_cnt = std::max<size_t>(1, std::wcstoul(argv[++i], nullptr, 10));
+    }
+    else if (arg == L"-j" && i + 1 < argc)
+    {
+      opts.readers_cnt = std::max<size_t>(1, std::wcstoul(argv[++i], nullptr, 10));
+    }
+    else if (arg == L"-s" && i + 1 < argc)
+    {
+      opts.read_size = std::max<size_t>(1, std::wcstoul(argv[++i], nullptr, 10));
+    }
+    else if (arg == L"-m")
+    {
+      opts.mapped = true;
+    }
+    else if (arg == L"-f" && i + 1 < argc)
+    {
+      const std::wstring fmt_name = argv[++i];
+      if (fmt_name == L"text")
+        opts.format = output_format::text;
+      else if (fmt_name == L"json")
+        opts.format = output_format::json;
+      else if (fmt_name == L"csv")
+        opts.format = output_format::csv;
+      else
+        return false;
+    }
+    else if (!arg.empty() && arg[0] == L'-')
+    {
+      return false;
+    }
+    else
+    {
+      opts.inputs.emplace_back(arg);
+    }
+  }
+
+  return !opts.inputs.empty();
+}
+
+static std::vector<fs::path> find_archives(const std::vector<fs::path>& inputs)
+{
+  std::vector<fs::path> ret;
+
+  for (const auto& input : inputs)
+  {
+    if (!fs::is_directory(input))
+    {
+      ret.emplace_back(input);
+      continue;
+    }
+
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(input, ec); it != fs::recursive_directory_iterator(); it.increment(ec))
+    {
+      if (ec)
+        break;
+      if (it->is_regular_file() && it->path().extension() == L".archive")
+        ret.emplace_back(it->path());
+    }
+  }
+
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+  options opts;
+  if (!parse_args(argc, argv, opts))
+  {
+    print_usage();
+    return -1;
+  }
+
+  if (!cp::oodle::is_available())
+  {
+    SPDLOG_ERROR("oodle is not available, compressed segments can't be read");
+    return -1;
+  }
+
+  const auto paths = find_archives(opts.inputs);
+  if (opts.format == output_format::text)
+    fmt::print("{} archive(s), {} random read(s) of {} bytes per reader, {} reader(s){}\n",
+      paths.size(), opts.reads_cnt, opts.read_size, opts.readers_cnt, opts.mapped ? ", mapped" : "");
+
+  std::vector<scenario_result> corpus_results;
+  auto& seg_cache = cp::segment_cache::get();
+  size_t failed_cnt = 0;
+
+  for (const auto& path : paths)
+  {
+    auto ar = opts.mapped ? cp::archive::load_mapped(path) : cp::archive::load(path);
+    if (!ar)
+    {
+      SPDLOG_ERROR("{}: couldn't load archive", path.string());
+      ++failed_cnt;
+      continue;
+    }
+
+    const auto af = classify_files(ar);
+
+    std::vector<scenario_result> results;
+    auto add_result = [&](std::string_view scenario, bool compressed) -> scenario_result& {
+      seg_cache.clear();
+      auto& r = results.emplace_back();
+      r.scenario = scenario;
+      r.seg_class = compressed ? "oodle" : "raw";
+      return r;
+    };
+
+    for (bool compressed : {false, true})
+    {
+      run_seq(af, compressed, add_result("seq", compressed));
+      run_random(af, compressed, opts, add_result("random", compressed));
+      run_concurrent(af, compressed, opts, add_result("concurrent", compressed));
+    }
+    run_decode(af, add_result("decode", true));
+
+    if (opts.format == output_format::text)
+    {
+      fmt::print("{} ({} raw, {} oodle files)\n", path.string(), af.raw_files.size(), af.oodle_files.size());
+      print_results(results, opts.format);
+    }
+
+    // the corpus totals sum the archives scenario by scenario
+    if (corpus_results.empty())
+    {
+      corpus_results = results;
+    }
+    else
+    {
+      for (size_t i = 0; i < results.size(); ++i)
+      {
+        auto& cr = corpus_results[i];
+        const auto& r = results[i];
+        cr.bytes += r.bytes;
+        cr.wall_s += r.wall_s;
+        cr.io_s += r.io_s;
+        cr.decode_s += r.decode_s;
+        cr.failed_cnt += r.failed_cnt;
+        cr.latencies.merge(r.latencies);
+      }
+    }
+
+    seg_cache.erase_archive(ar.get());
+  }
+
+  if (opts.format == output_format::text)
+  {
+    if (paths.size() > 1)
+    {
+      fmt::print("corpus ({} archive(s), {} failed)\n", paths.size() - failed_cnt, failed_cnt);
+      print_results(corpus_results, opts.format);
+    }
+  }
+  else
+  {
+    print_results(corpus_results, opts.format);
+  }
+
+  return failed_cnt ? 1 : 0;
+}
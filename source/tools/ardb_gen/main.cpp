@@ -0,0 +1,149 @@
+#define NOMINMAX
+#include <Windows.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <filesystem>
+
+#include <spdlog/spdlog.h>
+#include <cpinternals/archive/archive.hpp>
+#include <cpinternals/filesystem/ardb_builder.hpp>
+
+namespace fs = std::filesystem;
+using clock_type = std::chrono::steady_clock;
+
+// generates the ardbs (see treefs::load_ardb) of the archives of a content
+// directory from lists of candidate paths, e.g. after a game patch
+// usage: ardb_gen <content_dir> -n names.txt [-n names.txt ..] [-o out_dir] [-j workers]
+
+struct options
+{
+  fs::path content_dir;
+  std::vector<fs::path> lists;
+  fs::path out_dir = "./ardbs";
+  size_t workers_cnt = 0;
+};
+
+static double elapsed_ms(clock_type::time_point since)
+{
+  return std::chrono::duration<double, std::milli>(clock_type::now() - since).count();
+}
+
+static void print_usage()
+{
+  fmt::print(
+    "usage: ardb_gen <content_dir> -n names.txt [-n names.txt ..] [-o out_dir] [-j workers]\n"
+    "  content_dir  directory of the archives (searched recursively)\n"
+    "  -n           list of candidate paths, one per line (e.g. internal_names.txt)\n"
+    "  -o           output directory (default: ./ardbs)\n"
+    "  -j           worker threads (default: one per hardware thread)\n");
+}
+
+static bool parse_args(int argc, wchar_t* argv[], options& opts)
+{
+  if (argc < 2)
+    return false;
+
+  opts.content_dir = argv[1];
+
+  for (int i = 2; i < argc; ++i)
+  {
+    const std::wstring arg = argv[i];
+    if (arg == L"-n" && i + 1 < argc)
+    {
+      opts.lists.emplace_back(argv[++i]);
+    }
+    else if (arg == L"-o" && i + 1 < argc)
+    {
+      opts.out_dir = argv[++i];
+    }
+    else if (arg == L"-j" && i + 1 < argc)
+    {
+      opts.workers_cnt = static_cast<size_t>(std::wcstoull(argv[++i], nullptr, 10));
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  return !opts.lists.empty();
+}
+
+static std::vector<fs::path> list_archives(const fs::path& dir)
+{
+  std::vector<fs::path> ret;
+
+  std::error_code ec;
+  for (auto it = fs::recursive_directory_iterator(dir, ec); it != fs::recursive_directory_iterator(); it.increment(ec))
+  {
+    if (ec)
+      break;
+    if (it->is_regular_file() && it->path().extension() == L".archive")
+      ret.emplace_back(it->path());
+  }
+
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+  options opts;
+  if (!parse_args(argc, argv, opts))
+  {
+    print_usage();
+    return -1;
+  }
+
+  if (!fs::is_directory(opts.content_dir))
+  {
+    SPDLOG_ERROR("{} is not a directory", opts.content_dir.string());
+    return -1;
+  }
+
+  cp::filesystem::ardb_builder builder;
+
+  auto start = clock_type::now();
+  for (const auto& p : list_archives(opts.content_dir))
+  {
+    auto ar = cp::archive::load(p);
+    if (!ar)
+    {
+      SPDLOG_ERROR("couldn't load {}", p.string());
+      return -1;
+    }
+    builder.add_archive(ar);
+  }
+
+  for (const auto& p : opts.lists)
+  {
+    if (!builder.add_candidates_file(p))
+      return -1;
+  }
+
+  fmt::print("loaded {} archives and {} candidates ({:.2f}ms)\n",
+    builder.results().size(), builder.candidates_cnt(), elapsed_ms(start));
+
+  start = clock_type::now();
+  builder.match(opts.workers_cnt);
+  fmt::print("matched ({:.2f}ms)\n", elapsed_ms(start));
+
+  start = clock_type::now();
+  const bool ok = builder.write_all(opts.out_dir, opts.workers_cnt);
+  fmt::print("written to {} ({:.2f}ms)\n\n", opts.out_dir.string(), elapsed_ms(start));
+
+  size_t files_cnt = 0, identified_cnt = 0;
+  for (const auto& res : builder.results())
+  {
+    files_cnt += res.files_cnt;
+    identified_cnt += res.paths.size();
+    fmt::print("{:<40}{:>10} / {:<10}\n", res.ar->path().filename().string(), res.paths.size(), res.files_cnt);
+  }
+
+  fmt::print("\n{:<40}{:>10} / {:<10}\n", "total identified", identified_cnt, files_cnt);
+
+  return ok ? 0 : -1;
+}
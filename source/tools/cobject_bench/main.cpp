@@ -0,0 +1,493 @@
+#define NOMINMAX
+#include <Windows.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+#include <filesystem>
+
+#include <spdlog/spdlog.h>
+#include <cpinternals/init.hpp>
+#include <cpinternals/csav.hpp>
+#include <cpinternals/io/span_reader.hpp>
+#include <cpinternals/scripting/cobject.hpp>
+#include <cpinternals/scripting/cproperty.hpp>
+#include <cpinternals/scripting/cproperty_packed.hpp>
+
+#include <tools/common/counting_new.hpp>
+
+namespace fs = std::filesystem;
+
+// CObject::serialize_in and serialize_out timings by property class
+// usage: cobject_bench [corpus_dir] [-n iterations] [-f text|json]
+//
+// synthetic objects have 8 fields of a single property type, filled with
+// non-default values so that they are all serialized. real objects are the
+// root objects of the CSystem based systems of the saves of corpus_dir (any
+// directory tree containing sav.dat files), grouped by the property class
+// most of their serialized fields have.
+// each object is decoded from its blob into a new object and encoded back
+// iterations times, ns and allocations are reported per object.
+
+using clock_type = std::chrono::steady_clock;
+
+//--------------------------------------------------------
+// stats
+
+struct options
+{
+  fs::path corpus_dir;
+  size_t iterations_cnt = 1000;
+  bool json = false;
+};
+
+struct class_stats
+{
+  uint64_t objects_cnt = 0; // decoded (or encoded) objects, iterations included
+  uint64_t bytes = 0;
+  uint64_t in_ns = 0;
+  uint64_t out_ns = 0;
+  uint64_t in_allocs = 0;
+  uint64_t out_allocs = 0;
+  uint64_t failed_cnt = 0;
+
+  double per_object(uint64_t v) const
+  {
+    return objects_cnt ? double(v) / double(objects_cnt) : 0;
+  }
+};
+
+// "synthetic" or "real" -> property class -> stats
+using bench_stats = std::map<std::string, std::map<std::string, class_stats>>;
+
+static uint64_t elapsed_ns(clock_type::time_point start)
+{
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start).count());
+}
+
+// name of the class of prop, most derived first
+static std::string_view prop_class_name(const CProperty* prop)
+{
+  if (dynamic_cast<const CBoolProperty*>(prop))       return "CBoolProperty";
+  if (dynamic_cast<const CIntProperty*>(prop))        return "CIntProperty";
+  if (dynamic_cast<const CFloatProperty*>(prop))      return "CFloatProperty";
+  if (dynamic_cast<const CArrayProperty*>(prop))      return "CArrayProperty";
+  if (dynamic_cast<const CDynArrayProperty*>(prop))   return "CDynArrayProperty";
+  if (dynamic_cast<const CObjectProperty*>(prop))     return "CObjectProperty";
+  if (dynamic_cast<const CEnumProperty*>(prop))       return "CEnumProperty";
+  if (dynamic_cast<const CTweakDBIDProperty*>(prop))  return "CTweakDBIDProperty";
+  if (dynamic_cast<const CNameProperty*>(prop))       return "CNameProperty";
+  if (dynamic_cast<const CRaRefProperty*>(prop))      return "CRaRefProperty";
+  if (dynamic_cast<const CCRUIDProperty*>(prop))      return "CCRUIDProperty";
+  if (dynamic_cast<const CHandleProperty*>(prop))     return "CHandleProperty";
+  if (dynamic_cast<const CNodeRefProperty*>(prop))    return "CNodeRefProperty";
+  if (dynamic_cast<const CUnknownProperty*>(prop))    return "CUnknownProperty";
+  // packed arrays are templates, by kind
+  if (prop->kind() == EPropertyKind::DynArray)        return "CPackedArrayProperty";
+  return "other";
+}
+
+// decodes blob into new objects of ctypename and encodes them back
+template <typename MakeFn>
+static void bench_blob(const std::vector<char>& blob, MakeFn&& make_obj, CSystemSerCtx& serctx, size_t iterations_cnt, class_stats& cs)
+{
+  cp::vector_writer writer;
+  writer.reserve(blob.size());
+
+  for (size_t i = 0; i < iterations_cnt; ++i)
+  {
+    auto obj = make_obj();
+
+    uint64_t allocs_start = thread_allocs_count();
+    auto start = clock_type::now();
+    const bool in_ok = obj->serialize_in(blob, serctx);
+    cs.in_ns += elapsed_ns(start);
+    cs.in_allocs += thread_allocs_count() - allocs_start;
+
+    if (!in_ok)
+    {
+      ++cs.failed_cnt;
+      return;
+    }
+
+    writer.buffer().clear();
+    allocs_start = thread_allocs_count();
+    start = clock_type::now();
+    const bool out_ok = obj->serialize_out(writer, serctx);
+    cs.out_ns += elapsed_ns(start);
+    cs.out_allocs += thread_allocs_count() - allocs_start;
+
+    if (!out_ok)
+    {
+      ++cs.failed_cnt;
+      return;
+    }
+
+    ++cs.objects_cnt;
+    cs.bytes += blob.size();
+  }
+}
+
+//--------------------------------------------------------
+// synthetic objects
+
+// object of a blueprint that isn't in the bp list, so that the bench types
+// aren't learned (and persisted, see CObjectBPList::learn_fields)
+class synthetic_object
+  : public CObject
+{
+public:
+  synthetic_object(const CObjectBPSPtr& bp)
+    : CObject(bp->ctypename(), true)
+  {
+    m_blueprint = bp;
+    reset_fields_from_bp();
+  }
+};
+
+struct synthetic_type
+{
+  std::string_view prop_class; // expected class, checked against the created props
+  std::string field_ctypename;
+  std::function<void(cp::vector_writer&, CSystemSerCtx&)> write_value;
+};
+
+static constexpr size_t synthetic_fields_cnt = 8;
+static constexpr uint32_t synthetic_array_size = 16;
+
+// registered enum with the most members, its second member is used
+static std::pair<gname, gname> pick_enum_value()
+{
+  gname enum_name, value_name;
+  size_t best_cnt = 0;
+  for (const auto& [name, desc] : cp::CEnum_resolver::get().enums())
+  {
+    if (!desc)
+      continue;
+    const size_t cnt = desc->members().size();
+    if (cnt >= 2 && (cnt > best_cnt || (cnt == best_cnt && name.strv() < enum_name.strv())))
+    {
+      best_cnt = cnt;
+      enum_name = name;
+      value_name = desc->members()[1].name();
+    }
+  }
+  return {enum_name, value_name};
+}
+
+static std::vector<synthetic_type> synthetic_types(uint32_t target_handle)
+{
+  std::vector<synthetic_type> ret;
+
+  auto add = [&](std::string_view prop_class, std::string ctypename, auto&& write_value) {
+    ret.push_back({prop_class, std::move(ctypename), std::forward<decltype(write_value)>(write_value)});
+  };
+
+  add("CBoolProperty", "Bool", [](cp::vector_writer& w, CSystemSerCtx&) { w.write(uint8_t(1)); });
+  add("CIntProperty", "Int32", [](cp::vector_writer& w, CSystemSerCtx&) { w.write(int32_t(0x12345678)); });
+  add("CFloatProperty", "Float", [](cp::vector_writer& w, CSystemSerCtx&) { w.write(1.5f); });
+  add("CTweakDBIDProperty", "TweakDBID", [](cp::vector_writer& w, CSystemSerCtx&) { w.write(uint64_t(0x0B1A2B3C4D5E6F70)); });
+  add("CCRUIDProperty", "CRUID", [](cp::vector_writer& w, CSystemSerCtx&) { w.write(uint64_t(0x0123456789ABCDEF)); });
+  add("CNameProperty", "CName", [](cp::vector_writer& w, CSystemSerCtx& serctx) {
+    w.write(static_cast<uint16_t>(serctx.strpool.to_idx("cpbench_name")));
+  });
+  add("CRaRefProperty", "raRef:CResource", [](cp::vector_writer& w, CSystemSerCtx&) { w.write(uint16_t(1)); });
+  add("CNodeRefProperty", "NodeRef", [](cp::vector_writer& w, CSystemSerCtx&) {
+    static constexpr std::string_view ref = "$/cpbench/node_ref";
+    w.write(static_cast<uint16_t>(ref.size()));
+    w.write_bytes(ref.data(), ref.size());
+  });
+
+  const auto [enum_name, value_name] = pick_enum_value();
+  if (!enum_name.strv().empty())
+  {
+    add("CEnumProperty", std::string(enum_name.strv()), [value_name = value_name](cp::vector_writer& w, CSystemSerCtx& serctx) {
+      w.write(static_cast<uint16_t>(serctx.strpool.to_idx(value_name.strv())));
+    });
+  }
+
+  add("CHandleProperty", "handle:cpbench_target", [target_handle](cp::vector_writer& w, CSystemSerCtx&) {
+    w.write(target_handle);
+  });
+  add("CPackedArrayProperty", "array:Int32", [](cp::vector_writer& w, CSystemSerCtx&) {
+    w.write(synthetic_array_size);
+    for (uint32_t i = 0; i < synthetic_array_size; ++i)
+      w.write(int32_t(i + 1));
+  });
+  add("CDynArrayProperty", "array:handle:cpbench_target", [target_handle](cp::vector_writer& w, CSystemSerCtx&) {
+    w.write(synthetic_array_size);
+    for (uint32_t i = 0; i < synthetic_array_size; ++i)
+      w.write(target_handle);
+  });
+  add("CArrayProperty", "[4]NodeRef", [](cp::vector_writer& w, CSystemSerCtx&) {
+    static constexpr std::string_view ref = "$/cpbench/node_ref";
+    w.write(uint32_t(4));
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+      w.write(static_cast<uint16_t>(ref.size()));
+      w.write_bytes(ref.data(), ref.size());
+    }
+  });
+  // an empty struct, its class would be learned otherwise
+  add("CObjectProperty", "cpbench_struct", [](cp::vector_writer& w, CSystemSerCtx&) { w.write(uint16_t(0)); });
+
+  return ret;
+}
+
+static void run_synthetic(const options& opts, bench_stats& stats)
+{
+  CSystemSerCtx serctx;
+
+  auto target = CObject::create("cpbench_target");
+  const uint32_t target_handle = serctx.to_handle(target);
+
+  for (const auto& st : synthetic_types(target_handle))
+  {
+    auto& cs = stats["synthetic"][std::string(st.prop_class)];
+
+    std::vector<CFieldDesc> fdescs;
+    for (size_t i = 0; i < synthetic_fields_cnt; ++i)
+      fdescs.emplace_back(gname(fmt::format("f{}", i)), gname(st.field_ctypename));
+
+    const gname ctypename(fmt::format("cpbench_{}", st.prop_class));
+    auto bp = std::make_shared<CObjectBP>(ctypename, nullptr, fdescs, false);
+
+    // source object, its fields are set by decoding their values
+    auto src = std::make_shared<synthetic_object>(bp);
+    bool ok = true;
+    for (const auto& fdesc : fdescs)
+    {
+      CProperty* prop = src->get_prop(fdesc.name);
+      if (!prop || prop_class_name(prop) != st.prop_class)
+      {
+        SPDLOG_ERROR("{}: {} isn't a {}", ctypename.strv(), st.field_ctypename, st.prop_class);
+        ok = false;
+        break;
+      }
+
+      cp::vector_writer value;
+      st.write_value(value, serctx);
+      cp::span_reader reader(value.buffer());
+      if (!prop->serialize_in(reader, serctx))
+      {
+        SPDLOG_ERROR("{}: couldn't set {}", ctypename.strv(), fdesc.name.strv());
+        ok = false;
+        break;
+      }
+    }
+
+    cp::vector_writer blob;
+    if (!ok || !src->serialize_out(blob, serctx))
+    {
+      ++cs.failed_cnt;
+      continue;
+    }
+
+    bench_blob(blob.buffer(), [&]() { return std::make_shared<synthetic_object>(bp); }, serctx, opts.iterations_cnt, cs);
+  }
+}
+
+//--------------------------------------------------------
+// real-save objects
+
+static std::vector<fs::path> find_saves(const fs::path& dir)
+{
+  std::vector<fs::path> ret;
+
+  std::error_code ec;
+  for (auto it = fs::recursive_directory_iterator(dir, ec); it != fs::recursive_directory_iterator(); it.increment(ec))
+  {
+    if (ec)
+      break;
+    if (it->is_regular_file() && it->path().filename() == L"sav.dat")
+      ret.emplace_back(it->path());
+  }
+
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
+// property class most of the serialized fields of obj have
+static std::string dominant_prop_class(const CObject& obj)
+{
+  std::map<std::string_view, size_t> counts;
+  obj.for_each_field([&](gname, const CProperty* prop) {
+    if (prop && !prop->is_skippable_in_serialization())
+      ++counts[prop_class_name(prop)];
+  });
+
+  std::string_view best = "empty";
+  size_t best_cnt = 0;
+  for (const auto& [name, cnt] : counts)
+  {
+    if (cnt > best_cnt)
+    {
+      best = name;
+      best_cnt = cnt;
+    }
+  }
+  return std::string(best);
+}
+
+// the real objects are fewer and bigger, they get fewer iterations
+static bool run_save(const options& opts, const fs::path& path, bench_stats& stats)
+{
+  cp::savegame save;
+  save.interactive = false;
+  save.lazy_systems = false;
+  save.systems_workers_count = 1;
+
+  progress_t progress;
+  op_status status = save.open_with_progress(path, progress, false, false, false);
+  if (!status)
+  {
+    SPDLOG_ERROR("{}: {}", path.string(), status.err());
+    return false;
+  }
+
+  CSystem* systems[] = {
+    &save.godmode.system(),
+    &save.scriptables.system(),
+    &save.psdata.system(),
+    &save.stats.system(),
+    &save.statspool.system(),
+  };
+
+  const size_t iterations_cnt = std::max<size_t>(1, opts.iterations_cnt / 100);
+
+  for (CSystem* sys : systems)
+  {
+    auto& serctx = sys->serctx();
+    for (const auto& obj : sys->objects())
+    {
+      if (!obj)
+        continue;
+
+      cp::vector_writer blob;
+      if (!obj->serialize_out(blob, serctx))
+        continue;
+
+      auto& cs = stats["real"][dominant_prop_class(*obj)];
+      const gname ctypename = obj->ctypename();
+      bench_blob(blob.buffer(), [&]() { return CObject::create(ctypename); }, serctx, iterations_cnt, cs);
+    }
+  }
+
+  return true;
+}
+
+//--------------------------------------------------------
+
+static void print_stats(const bench_stats& stats, bool json)
+{
+  if (!json)
+  {
+    fmt::print("  {:<10}{:<24}{:>10}{:>10}{:>12}{:>12}{:>12}{:>12}{:>8}\n",
+      "objects", "property class", "count", "bytes/obj", "in ns/obj", "out ns/obj", "in alloc", "out alloc", "failed");
+  }
+
+  for (const auto& [source, classes] : stats)
+  {
+    for (const auto& [name, cs] : classes)
+    {
+      if (json)
+      {
+        fmt::print(
+          "{{\"objects\":\"{}\",\"class\":\"{}\",\"count\":{},\"bytes_per_object\":{:.1f},\"in_ns_per_object\":{:.1f},"
+          "\"out_ns_per_object\":{:.1f},\"in_allocs_per_object\":{:.2f},\"out_allocs_per_object\":{:.2f},\"failed\":{}}}\n",
+          source, name, cs.objects_cnt, cs.per_object(cs.bytes), cs.per_object(cs.in_ns), cs.per_object(cs.out_ns),
+          cs.per_object(cs.in_allocs), cs.per_object(cs.out_allocs), cs.failed_cnt);
+      }
+      else
+      {
+        fmt::print("  {:<10}{:<24}{:>10}{:>10.1f}{:>12.1f}{:>12.1f}{:>12.2f}{:>12.2f}{:>8}\n",
+          source, name, cs.objects_cnt, cs.per_object(cs.bytes), cs.per_object(cs.in_ns), cs.per_object(cs.out_ns),
+          cs.per_object(cs.in_allocs), cs.per_object(cs.out_allocs), cs.failed_cnt);
+      }
+    }
+  }
+}
+
+static void print_usage()
+{
+  fmt::print(
+    "usage: cobject_bench [corpus_dir] [-n iterations] [-f text|json]\n"
+    "  -n  iterations per synthetic object (default: 1000), real objects\n"
+    "      get a hundredth of it\n"
+    "  -f  output format (default: text), json is one object per line\n");
+}
+
+static bool parse_args(int argc, wchar_t* argv[], options& opts)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::wstring arg = argv[i];
+    if (arg == L"-n" && i + 1 < argc)
+    {
+      opts.iterations_cnt = std::max<size_t>(1, std::wcstoul(argv[++i], nullptr, 10));
+    }
+    else if (arg == L"-f" && i + 1 < argc)
+    {
+      const std::wstring fmt_name = argv[++i];
+      if (fmt_name == L"json")
+        opts.json = true;
+      else if (fmt_name != L"text")
+        return false;
+    }
+    else if (!arg.empty() && arg[0] != L'-' && opts.corpus_dir.empty())
+    {
+      opts.corpus_dir = arg;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+  options opts;
+  if (!parse_args(argc, argv, opts))
+  {
+    print_usage();
+    return -1;
+  }
+
+  if (!opts.corpus_dir.empty() && !fs::is_directory(opts.corpus_dir))
+  {
+    SPDLOG_ERROR("{} is not a directory", opts.corpus_dir.string());
+    return -1;
+  }
+
+  if (!cp::init_cpinternals())
+  {
+    SPDLOG_ERROR("couldn't init cpinternals");
+    return -1;
+  }
+
+  // keep the blueprints db loading out of the timings
+  CObjectBPList::get();
+
+  bench_stats stats;
+  run_synthetic(opts, stats);
+
+  size_t failed_cnt = 0;
+  if (!opts.corpus_dir.empty())
+  {
+    const auto saves = find_saves(opts.corpus_dir);
+    if (!opts.json)
+      fmt::print("{} save(s) found\n", saves.size());
+
+    for (const auto& path : saves)
+      failed_cnt += run_save(opts, path, stats) ? 0 : 1;
+  }
+
+  print_stats(stats, opts.json);
+
+  return failed_cnt ? 1 : 0;
+}
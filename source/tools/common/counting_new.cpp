@@ -0,0 +1,52 @@
+#include "counting_new.hpp"
+
+#include <new>
+#include <cstdlib>
+
+#include <cpinternals/common/alloc_profiler.hpp>
+
+static thread_local uint64_t tls_allocs_cnt = 0;
+
+uint64_t thread_allocs_count()
+{
+  return tls_allocs_cnt;
+}
+
+void* operator new(size_t size)
+{
+  ++tls_allocs_cnt;
+  cp::profile_alloc(size);
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+  cp::profile_free(0);
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+  cp::profile_free(0);
+  std::free(p);
+}
+
+void operator delete(void* p, size_t size) noexcept
+{
+  cp::profile_free(size);
+  std::free(p);
+}
+
+void operator delete[](void* p, size_t size) noexcept
+{
+  cp::profile_free(size);
+  std::free(p);
+}
+
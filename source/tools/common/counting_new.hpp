@@ -0,0 +1,10 @@
+#pragma once
+#include <inttypes.h>
+
+// operator new and delete of the benches (counting_new.cpp, linked in by
+// the bench projects): allocations are counted per thread and passed to
+// the allocation profiler (see cpinternals/common/alloc_profiler.hpp).
+
+// allocations made by the calling thread so far
+uint64_t thread_allocs_count();
+
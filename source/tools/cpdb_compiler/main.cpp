@@ -0,0 +1,113 @@
+#define NOMINMAX
+#include <Windows.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <filesystem>
+
+#include <spdlog/spdlog.h>
+#include <cpinternals/asset_db.hpp>
+
+namespace fs = std::filesystem;
+using clock_type = std::chrono::steady_clock;
+
+// compiles the json dbs (and names lists) into .cpdb files (see asset_db.hpp), which the apps
+// otherwise compile on first load
+// usage: cpdb_compiler <db_dir> [-o out_dir]
+
+struct options
+{
+  fs::path db_dir;
+  fs::path out_dir;
+};
+
+struct db_def
+{
+  const wchar_t* json_name;
+  bool (*compile)(const fs::path& json_path, const fs::path& db_path);
+};
+
+static const db_def db_defs[] = {
+  {L"TweakDBIDs.json", cp::asset_db::compile_names_json},
+  {L"CFacts.json",     cp::asset_db::compile_names_json},
+  {L"internal_names.txt", cp::asset_db::compile_names_txt},
+  {L"CEnums.json",     cp::asset_db::compile_enums_json},
+  {L"CObjectBPs.json", cp::asset_db::compile_classes_json},
+};
+
+static double elapsed_ms(clock_type::time_point since)
+{
+  return std::chrono::duration<double, std::milli>(clock_type::now() - since).count();
+}
+
+static void print_usage()
+{
+  fmt::print(
+    "usage: cpdb_compiler <db_dir> [-o out_dir]\n"
+    "  db_dir  directory of the dbs (TweakDBIDs, CFacts, internal_names, CEnums, CObjectBPs)\n"
+    "  -o      output directory (default: db_dir)\n");
+}
+
+static bool parse_args(int argc, wchar_t* argv[], options& opts)
+{
+  if (argc < 2)
+    return false;
+
+  opts.db_dir = argv[1];
+
+  for (int i = 2; i < argc; ++i)
+  {
+    const std::wstring arg = argv[i];
+    if (arg == L"-o" && i + 1 < argc)
+    {
+      opts.out_dir = argv[++i];
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  if (opts.out_dir.empty())
+    opts.out_dir = opts.db_dir;
+
+  return true;
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+  options opts;
+  if (!parse_args(argc, argv, opts))
+  {
+    print_usage();
+    return -1;
+  }
+
+  if (!fs::is_directory(opts.db_dir))
+  {
+    SPDLOG_ERROR("{} is not a directory", opts.db_dir.string());
+    return -1;
+  }
+
+  std::error_code ec;
+  fs::create_directories(opts.out_dir, ec);
+
+  size_t failed_cnt = 0;
+  for (const auto& def : db_defs)
+  {
+    const fs::path json_path = opts.db_dir / def.json_name;
+    const fs::path db_path = opts.out_dir / cp::asset_db::db_path_of(json_path).filename();
+
+    const auto start = clock_type::now();
+    if (!def.compile(json_path, db_path))
+    {
+      ++failed_cnt;
+      continue;
+    }
+
+    fmt::print("{} -> {} ({:.2f}ms, {:.3f}MB)\n", json_path.string(), db_path.string(),
+      elapsed_ms(start), fs::file_size(db_path, ec) / (1024. * 1024.));
+  }
+
+  return failed_cnt ? -1 : 0;
+}
@@ -0,0 +1,925 @@
+#define NOMINMAX
+#include <Windows.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <optional>
+#include <atomic>
+#include <cstdlib>
+#include <malloc.h>
+#include <filesystem>
+
+#include <spdlog/spdlog.h>
+#include <cpinternals/init.hpp>
+#include <cpinternals/csav.hpp>
+#include <cpinternals/csav/save_index.hpp>
+#include <cpinternals/csav/ndjson_export.hpp>
+#include <cpinternals/csav/save_peek.hpp>
+#include <cpinternals/csav/save_patch.hpp>
+#include <cpinternals/csav/memory_report.hpp>
+#include <cpinternals/csav/roundtrip.hpp>
+#include <cpinternals/common/parallel.hpp>
+#include <cpinternals/common/task_scheduler.hpp>
+#include <cpinternals/common/instrumentation.hpp>
+#include <cpinternals/common/alloc_profiler.hpp>
+#include <cpinternals/common/trace_recorder.hpp>
+
+namespace fs = std::filesystem;
+using clock_type = std::chrono::steady_clock;
+
+// headless batch processing of save files
+// usage: csav_batch <load|validate|stats|memory|resave|export|index|peek|patch|roundtrip> <saves_dir> [-j workers] [-o out_dir] [-t] [-q query] [-p patch] [-c profile] [-m max_mb] [-T trace.json] [-P]
+//        csav_batch serve <pipe_name> [-j workers] [-t] [-c profile] [-m max_mb] [-T trace.json] [-P]
+
+enum class command_e
+{
+  load,      // tree only
+  validate,  // systems + reserialization test
+  stats,     // systems + tree stats
+  memory,    // systems + memory usage per system node
+  resave,    // systems + save (to out_dir if given, in place with backup otherwise)
+  export_,   // systems + NDJSON export (to out_dir if given, next to the save otherwise)
+  index,     // updates the save_index of saves_dir (see -o), then runs the queries
+  peek,      // header and node descriptors only, plus the nodes given as queries
+  patch,     // applies a save_patch (see -p), to out_dir if given, in place with backup otherwise
+  serve,     // runs the jobs sent to a named pipe, see run_server
+  roundtrip, // round-trip verification of the saves and blobs of saves_dir (see roundtrip_verifier)
+};
+
+struct options
+{
+  command_e cmd = command_e::load;
+  fs::path saves_dir; // pipe name for serve
+  fs::path out_dir;
+  size_t workers_cnt = 0;
+  bool timings = false;
+  std::vector<std::string> queries; // <item|fact|stat|node>:<name>
+  fs::path patch_path;
+  cp::csav::save_patch patch;
+  cp::csav::node_tree::save_profile save_profile = cp::csav::node_tree::save_profile::balanced;
+  size_t job_memory_limit = 0; // bytes, 0: unlimited
+  fs::path trace_path;
+  bool pipelined = false;
+};
+
+struct job_result
+{
+  bool ok = false;
+  double load_ms = 0;
+  double save_ms = 0;
+  std::string info;
+  std::string details; // printed below the result line
+  std::vector<cp::span_log::entry> timings;
+};
+
+static double elapsed_ms(clock_type::time_point since)
+{
+  return std::chrono::duration<double, std::milli>(clock_type::now() - since).count();
+}
+
+// live bytes allocated by a job, for the memory limit of jobs.
+// the budget is the job context of the scheduler (see scoped_job_context),
+// so the tasks a job fans out to (systems parsing, parallel_for..) are
+// charged to it too. it is checked by operator new, which throws
+// std::bad_alloc once it is exceeded.
+// memory allocated within the job and freed outside of it (or the other way
+// around) is only counted on the side the job saw.
+namespace job_memory {
+
+struct budget
+{
+  std::atomic<int64_t> bytes = 0;
+  int64_t limit = 0;
+  std::atomic<bool> exceeded = false;
+};
+
+static budget* current()
+{
+  return static_cast<budget*>(cp::task_scheduler::current_job_context());
+}
+
+// no budget if limit is 0 (unlimited)
+struct scope
+{
+  explicit scope(size_t limit)
+  {
+    m_budget.limit = (int64_t)limit;
+    if (limit)
+      m_ctx.emplace(&m_budget);
+  }
+
+  bool exceeded() const
+  {
+    return m_budget.exceeded.load();
+  }
+
+  budget m_budget;
+  std::optional<cp::scoped_job_context> m_ctx;
+};
+
+} // namespace job_memory
+
+void* operator new(size_t size)
+{
+  job_memory::budget* const budget = job_memory::current();
+  if (budget && budget->bytes.load(std::memory_order_relaxed) + (int64_t)size > budget->limit)
+  {
+    budget->exceeded = true;
+    throw std::bad_alloc();
+  }
+
+  void* p = std::malloc(size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+
+  if (budget)
+    budget->bytes.fetch_add((int64_t)_msize(p), std::memory_order_relaxed);
+  cp::profile_alloc(size);
+  return p;
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+  if (p)
+  {
+    const size_t size = _msize(p);
+    if (job_memory::budget* const budget = job_memory::current())
+      budget->bytes.fetch_sub((int64_t)size, std::memory_order_relaxed);
+    cp::profile_free(size);
+    std::free(p);
+  }
+}
+
+void operator delete[](void* p) noexcept
+{
+  operator delete(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  operator delete(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+  operator delete(p);
+}
+
+static void print_usage()
+{
+  fmt::print(
+    "usage: csav_batch <load|validate|stats|memory|resave|export|index|peek|patch|roundtrip> <saves_dir> [-j workers] [-o out_dir] [-t] [-q query] [-p patch] [-c profile] [-m max_mb] [-T trace.json] [-P]\n"
+    "       csav_batch serve <pipe_name> [-j workers] [-t] [-c profile] [-m max_mb] [-T trace.json] [-P]\n"
+    "  load      loads the node tree only\n"
+    "  validate  loads the systems and checks they reserialize identically, mismatching\n"
+    "            systems are dumped into out_dir if given\n"
+    "  stats     loads the systems and prints tree stats\n"
+    "  memory    loads the systems and prints their memory usage (nodes, objects, props, caches)\n"
+    "  resave    loads the systems and saves (into out_dir, or in place with a .old backup)\n"
+    "  export    loads the systems and exports them as sav.ndjson (into out_dir, or next to the save)\n"
+    "  index     updates the index file (-o, default: <saves_dir>/csav.index) with the new and\n"
+    "            modified saves, then prints the saves matching all the queries\n"
+    "  peek      reads the version and node descriptors only, and the nodes given as node:<name>\n"
+    "            queries (only their chunks are decompressed)\n"
+    "  patch     applies the edits of the patch file given with -p, loading only the systems they\n"
+    "            need (into out_dir, or in place with a .old backup)\n"
+    "  roundtrip reserializes the systems of the saves and the .bin/.buffer blobs and compares\n"
+    "            them with the originals, dumping the differing ranges into out_dir if given\n"
+    "  serve     loads the databases once and runs the jobs sent to the named pipe \\\\.\\pipe\\<pipe_name>,\n"
+    "            one connection per job, the request being one line of tab separated fields:\n"
+    "              <command>\\t<sav.dat path>[\\t<out_dir>[\\t<patch file>]]\n"
+    "            (any command but index, roundtrip and serve, the patch file is required by patch)\n"
+    "            and the reply the result line of the job; \"stop\" stops the server\n"
+    "  -j        worker count, one save per task (default: hardware threads)\n"
+    "  -t        prints the timings of each load/save phase\n"
+    "  -q        index query, item:<TweakDBID name>, fact:<name> (set facts) or stat:<statType>,\n"
+    "            or node:<name> for peek\n"
+    "  -p        patch file (JSON, see save_patch.hpp)\n"
+    "  -c        compression profile of resave: balanced (default), fast (LZ4 acceleration) or\n"
+    "            small (chunks packed for size)\n"
+    "  -m        memory limit of each job in MB, its tasks on the shared workers included, a job\n"
+    "            exceeding it fails (default: none, not with -P)\n"
+    "  -T        records a trace of the jobs (Chrome trace events), written at exit; the CP_TRACE\n"
+    "            environment variable does the same\n"
+    "  -P        pipelined load: systems are parsed as soon as their node is decompressed, the\n"
+    "            phases of a save run on the shared workers\n");
+}
+
+static bool parse_command(std::wstring_view cmd, command_e& out)
+{
+  if (cmd == L"load")
+    out = command_e::load;
+  else if (cmd == L"validate")
+    out = command_e::validate;
+  else if (cmd == L"stats")
+    out = command_e::stats;
+  else if (cmd == L"memory")
+    out = command_e::memory;
+  else if (cmd == L"resave")
+    out = command_e::resave;
+  else if (cmd == L"export")
+    out = command_e::export_;
+  else if (cmd == L"index")
+    out = command_e::index;
+  else if (cmd == L"peek")
+    out = command_e::peek;
+  else if (cmd == L"patch")
+    out = command_e::patch;
+  else if (cmd == L"serve")
+    out = command_e::serve;
+  else if (cmd == L"roundtrip")
+    out = command_e::roundtrip;
+  else
+    return false;
+  return true;
+}
+
+static bool parse_args(int argc, wchar_t* argv[], options& opts)
+{
+  if (argc < 3)
+    return false;
+
+  if (!parse_command(argv[1], opts.cmd))
+    return false;
+
+  opts.saves_dir = argv[2];
+
+  for (int i = 3; i < argc; ++i)
+  {
+    const std::wstring arg = argv[i];
+    if (arg == L"-j" && i + 1 < argc)
+    {
+      opts.workers_cnt = (size_t)std::wcstoul(argv[++i], nullptr, 10);
+    }
+    else if (arg == L"-o" && i + 1 < argc)
+    {
+      opts.out_dir = argv[++i];
+    }
+    else if (arg == L"-t")
+    {
+      opts.timings = true;
+    }
+    else if (arg == L"-q" && i + 1 < argc)
+    {
+      opts.queries.emplace_back(fs::path(argv[++i]).u8string());
+    }
+    else if (arg == L"-p" && i + 1 < argc)
+    {
+      opts.patch_path = argv[++i];
+    }
+    else if (arg == L"-c" && i + 1 < argc)
+    {
+      const std::wstring profile = argv[++i];
+      if (profile == L"balanced")
+        opts.save_profile = cp::csav::node_tree::save_profile::balanced;
+      else if (profile == L"fast")
+        opts.save_profile = cp::csav::node_tree::save_profile::fast;
+      else if (profile == L"small")
+        opts.save_profile = cp::csav::node_tree::save_profile::small;
+      else
+        return false;
+    }
+    else if (arg == L"-m" && i + 1 < argc)
+    {
+      opts.job_memory_limit = (size_t)std::wcstoull(argv[++i], nullptr, 10) * 1024 * 1024;
+    }
+    else if (arg == L"-T" && i + 1 < argc)
+    {
+      opts.trace_path = argv[++i];
+    }
+    else if (arg == L"-P")
+    {
+      opts.pipelined = true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static std::vector<fs::path> find_saves(const fs::path& dir)
+{
+  std::vector<fs::path> ret;
+
+  std::error_code ec;
+  for (auto it = fs::recursive_directory_iterator(dir, ec); it != fs::recursive_directory_iterator(); it.increment(ec))
+  {
+    if (ec)
+      break;
+    if (it->is_regular_file() && it->path().filename() == L"sav.dat")
+      ret.emplace_back(it->path());
+  }
+
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
+static job_result peek_save(const options& opts, const fs::path& path)
+{
+  job_result res;
+
+  cp::csav::save_peek peek;
+
+  auto start = clock_type::now();
+  op_status status = peek.open(path);
+
+  std::string nodes_info;
+  for (const auto& q : opts.queries)
+  {
+    if (!status)
+      break;
+    if (q.rfind("node:", 0) != 0)
+      continue;
+
+    const std::string_view name = std::string_view(q).substr(5);
+    auto node = peek.read_node(name);
+    if (!node)
+      status = op_status(fmt::format("couldn't read node {}", name));
+    else
+      nodes_info += fmt::format(" {}:{:#x}", name, node->calcsize());
+  }
+  res.load_ms = elapsed_ms(start);
+
+  if (!status)
+  {
+    res.info = status.err();
+    return res;
+  }
+
+  res.info = fmt::format("{} descs:{} nodedata:{:#x} read:{:#x} decompressed:{:#x}{}",
+    peek.ver().string(), peek.descs().size(), peek.nodedata_size(),
+    peek.chunks_read_size(), peek.decompressed_size(), nodes_info);
+
+  res.ok = true;
+  return res;
+}
+
+static job_result patch_save(const options& opts, const fs::path& path)
+{
+  job_result res;
+
+  fs::path out_path;
+  if (!opts.out_dir.empty())
+  {
+    out_path = opts.out_dir / fs::relative(path, opts.saves_dir);
+    std::error_code ec;
+    fs::create_directories(out_path.parent_path(), ec);
+  }
+
+  auto start = clock_type::now();
+  const auto patch_res = opts.patch.apply_to_file(path, out_path);
+  res.load_ms = elapsed_ms(start);
+
+  if (!patch_res.status)
+  {
+    res.info = patch_res.status.err();
+    return res;
+  }
+
+  res.info = fmt::format("{} change(s){}", patch_res.changes_cnt, patch_res.saved ? "" : ", not saved");
+  res.ok = true;
+  return res;
+}
+
+static job_result process_save(const options& opts, const fs::path& path)
+{
+  if (opts.cmd == command_e::peek)
+    return peek_save(opts, path);
+  if (opts.cmd == command_e::patch)
+    return patch_save(opts, path);
+
+  job_result res;
+
+  cp::savegame save;
+  save.interactive = false;
+  // workers run concurrently: reserialization mismatches are dumped per save
+  // into out_dir, not into the working directory
+  save.dump_reserialize_mismatches = (opts.cmd == command_e::validate) && !opts.out_dir.empty();
+  if (save.dump_reserialize_mismatches)
+  {
+    save.dumps_dir = opts.out_dir / fs::relative(path.parent_path(), opts.saves_dir);
+    std::error_code ec;
+    fs::create_directories(save.dumps_dir, ec);
+  }
+  // parallelism is at the file level, unless pipelined: the phases of the
+  // save then overlap on the shared workers
+  if (!opts.pipelined)
+  {
+    save.tree.set_workers_count(1);
+    save.systems_workers_count = 1;
+  }
+
+  progress_t progress;
+  const bool tree_only = (opts.cmd == command_e::load);
+  const bool test = (opts.cmd == command_e::validate);
+
+  auto start = clock_type::now();
+  op_status status = (opts.pipelined && !tree_only)
+    ? save.open_pipelined(path, progress, test)
+    : save.open_with_progress(path, progress, false, tree_only, test);
+  res.load_ms = elapsed_ms(start);
+
+  if (!status)
+  {
+    res.info = status.err();
+    return res;
+  }
+
+  if (save.load_errors.size())
+  {
+    res.info = fmt::format("{} error(s), first: {}", save.load_errors.size(), save.load_errors.front());
+    return res;
+  }
+
+  switch (opts.cmd)
+  {
+    case command_e::stats:
+    {
+      const auto& root = save.tree.root;
+      res.info = fmt::format("{} nodes:{} size:{:#x} descs:{}",
+        save.tree.ver().string(), root->treecount(), root->calcsize(), save.tree.original_descs.size());
+      break;
+    }
+    case command_e::memory:
+    {
+      // one line per system, below the job's line
+      const auto report = cp::csav::memory_report::build(save);
+      res.info = cp::csav::format_memory_usage("total", report.total);
+      res.details = report.to_string();
+      break;
+    }
+    case command_e::resave:
+    {
+      fs::path out_path = path;
+      if (!opts.out_dir.empty())
+      {
+        out_path = opts.out_dir / fs::relative(path, opts.saves_dir);
+        std::error_code ec;
+        fs::create_directories(out_path.parent_path(), ec);
+      }
+
+      start = clock_type::now();
+      status = save.save_with_progress(out_path, progress, false, save.tree.ver().ps4w, opts.save_profile);
+      res.save_ms = elapsed_ms(start);
+
+      if (!status)
+      {
+        res.info = status.err();
+        return res;
+      }
+      break;
+    }
+    case command_e::export_:
+    {
+      fs::path out_path = path.parent_path() / L"sav.ndjson";
+      if (!opts.out_dir.empty())
+      {
+        out_path = opts.out_dir / fs::relative(out_path, opts.saves_dir);
+        std::error_code ec;
+        fs::create_directories(out_path.parent_path(), ec);
+      }
+
+      start = clock_type::now();
+      cp::csav::ndjson_exporter exporter(save);
+      // parallelism is at the file level
+      status = exporter.write_file(out_path, 1);
+      res.save_ms = elapsed_ms(start);
+
+      if (!status)
+      {
+        res.info = status.err();
+        return res;
+      }
+      break;
+    }
+    default:
+      break;
+  }
+
+  res.ok = true;
+  return res;
+}
+
+static int run_index(const options& opts)
+{
+  const fs::path index_path = opts.out_dir.empty() ? opts.saves_dir / L"csav.index" : opts.out_dir;
+
+  cp::csav::save_index index;
+  index.set_workers_count(opts.workers_cnt);
+
+  cp::csav::save_index::update_stats stats;
+  auto start = clock_type::now();
+  op_status status = index.update(opts.saves_dir, index_path, &stats);
+  if (!status)
+  {
+    SPDLOG_ERROR("couldn't update {}: {}", index_path.string(), status.err());
+    return -1;
+  }
+
+  using column_e = cp::csav::save_index::column_e;
+  fmt::print("{} updated in {:.1f}ms: {} save(s), {} loaded, {} failed, {} removed, keys items:{} facts:{} stats:{}\n",
+    index_path.string(), elapsed_ms(start), stats.saves_cnt, stats.loaded_cnt, stats.failed_cnt, stats.removed_cnt,
+    index.keys_count(column_e::items), index.keys_count(column_e::facts), index.keys_count(column_e::stats));
+
+  if (opts.queries.empty())
+    return 0;
+
+  start = clock_type::now();
+  std::optional<std::vector<uint32_t>> matches;
+  for (const auto& q : opts.queries)
+  {
+    const size_t sep = q.find(':');
+    const std::string_view kind = std::string_view(q).substr(0, sep);
+    const std::string_view name = (sep == std::string::npos) ? std::string_view() : std::string_view(q).substr(sep + 1);
+
+    std::vector<uint32_t> saves;
+    if (kind == "item")
+      saves = index.saves_with_item(TweakDBID(name, false));
+    else if (kind == "fact")
+      saves = index.saves_with_fact(name);
+    else if (kind == "stat")
+      saves = index.saves_with_stat(name);
+    else
+    {
+      SPDLOG_ERROR("invalid query \"{}\"", q);
+      return -1;
+    }
+
+    matches = matches ? cp::csav::save_index::intersect(*matches, saves) : std::move(saves);
+  }
+
+  for (uint32_t i : *matches)
+    fmt::print("{}\n", index.saves()[i].path);
+  fmt::print("{} match(es) in {:.3f}ms\n", matches->size(), elapsed_ms(start));
+
+  return 0;
+}
+
+static int run_roundtrip(const options& opts)
+{
+  cp::csav::roundtrip_verifier verifier;
+  verifier.add_default_formats();
+  verifier.dump_dir = opts.out_dir;
+
+  const auto inputs = verifier.find_inputs(opts.saves_dir);
+  fmt::print("{} input(s) found, using {} worker(s)\n",
+    inputs.size(), cp::resolve_workers_count(opts.workers_cnt, inputs.size()));
+
+  const auto start = clock_type::now();
+  const auto results = verifier.verify_all(inputs, opts.workers_cnt);
+  const double total_ms = elapsed_ms(start);
+
+  size_t failed_cnt = 0, mismatching_cnt = 0, total_size = 0;
+  double read_ms = 0, load_ms = 0, reserialize_ms = 0, compare_ms = 0;
+  for (const auto& r : results)
+  {
+    fmt::print("[{}] {} {} units:{} size:{:#x} read:{:.1f}ms load:{:.1f}ms reser:{:.1f}ms cmp:{:.1f}ms{}\n",
+      r.ok() ? " OK " : "FAIL", r.format, r.path.string(), r.units_cnt, r.size,
+      r.read_ms, r.load_ms, r.reserialize_ms, r.compare_ms, r.status ? "" : " " + r.status.err());
+    for (const auto& m : r.mismatches)
+    {
+      fmt::print("  {} differs in [{:#x}, {:#x}] (size {:#x} -> {:#x})\n",
+        m.unit, m.first_diff, m.last_diff, m.original_size, m.reserialized_size);
+    }
+
+    failed_cnt += r.status ? 0 : 1;
+    mismatching_cnt += (r.status && !r.mismatches.empty()) ? 1 : 0;
+    total_size += r.size;
+    read_ms += r.read_ms;
+    load_ms += r.load_ms;
+    reserialize_ms += r.reserialize_ms;
+    compare_ms += r.compare_ms;
+  }
+
+  fmt::print("done in {:.1f}ms ({:.1f}MB/s): {} ok, {} mismatching, {} failed (cumulated read:{:.1f}ms load:{:.1f}ms reser:{:.1f}ms cmp:{:.1f}ms)\n",
+    total_ms, total_ms > 0 ? total_size / (1024. * 1024.) / (total_ms / 1000.) : 0.,
+    results.size() - failed_cnt - mismatching_cnt, mismatching_cnt, failed_cnt, read_ms, load_ms, reserialize_ms, compare_ms);
+
+  return (failed_cnt || mismatching_cnt) ? 1 : 0;
+}
+
+static std::string format_timings(const std::vector<cp::span_log::entry>& entries)
+{
+  std::string ret;
+  for (const auto& e : entries)
+  {
+    std::string label = e.label.empty() ? e.name : fmt::format("{} ({})", e.name, e.label);
+    if (e.count > 1)
+      label += fmt::format(" x{}", e.count);
+    fmt::format_to(std::back_inserter(ret), "  {:{}}{:<48} {:>9.2f}ms {:>10.3f}MB\n", "", e.depth * 2,
+      label, e.duration_ms, e.bytes / (1024. * 1024.));
+  }
+  return ret;
+}
+
+// result line of a job, followed by its details and timings
+static std::string format_result(const job_result& r, const fs::path& path)
+{
+  return fmt::format("[{}] {} load:{:.1f}ms save:{:.1f}ms {}\n{}{}",
+    r.ok ? " OK " : "FAIL", path.string(), r.load_ms, r.save_ms, r.info, r.details, format_timings(r.timings));
+}
+
+// runs process_save within the job's memory limit
+static job_result run_job(const options& opts, const fs::path& path)
+{
+  job_result res;
+
+  // spans are reported on the calling thread, one log per save
+  cp::span_log spans;
+  {
+    std::optional<cp::scoped_span_sink> sink;
+    if (opts.timings)
+      sink.emplace(&spans);
+
+    job_memory::scope memory_scope(opts.job_memory_limit);
+    try
+    {
+      res = process_save(opts, path);
+    }
+    catch (std::bad_alloc&)
+    {
+      res = job_result();
+      res.info = memory_scope.exceeded()
+        ? fmt::format("memory limit of {}MB exceeded", opts.job_memory_limit / (1024 * 1024))
+        : std::string("out of memory");
+    }
+    catch (std::exception& e)
+    {
+      res = job_result();
+      res.info = fmt::format("exception: {}", e.what());
+    }
+  }
+  res.timings = spans.entries();
+
+  return res;
+}
+
+static std::wstring full_pipe_name(const fs::path& name)
+{
+  const std::wstring prefix = L"\\\\.\\pipe\\";
+  const std::wstring s = name.wstring();
+  return s.rfind(prefix, 0) == 0 ? s : prefix + s;
+}
+
+static bool read_request(HANDLE pipe, std::string& line)
+{
+  constexpr size_t max_request_size = 0x10000;
+
+  char buf[0x1000];
+  while (line.size() < max_request_size)
+  {
+    DWORD read_cnt = 0;
+    if (!ReadFile(pipe, buf, sizeof(buf), &read_cnt, nullptr) || !read_cnt)
+      return !line.empty();
+
+    line.append(buf, read_cnt);
+    const size_t eol = line.find('\n');
+    if (eol != std::string::npos)
+    {
+      line.resize(eol);
+      if (!line.empty() && line.back() == '\r')
+        line.pop_back();
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static std::vector<std::string> split_fields(const std::string& line)
+{
+  std::vector<std::string> ret;
+  size_t pos = 0;
+  while (true)
+  {
+    const size_t sep = line.find('\t', pos);
+    ret.emplace_back(line.substr(pos, sep - pos));
+    if (sep == std::string::npos)
+      break;
+    pos = sep + 1;
+  }
+  return ret;
+}
+
+// runs the job requested by the client of pipe, replies with its result.
+// returns false for a stop request.
+static bool serve_client(const options& opts, HANDLE pipe, std::mutex& print_mtx)
+{
+  std::string reply;
+  bool keep_serving = true;
+
+  std::string line;
+  if (!read_request(pipe, line))
+  {
+    reply = "[FAIL] invalid request\n";
+  }
+  else if (line == "stop")
+  {
+    reply = "stopping\n";
+    keep_serving = false;
+  }
+  else
+  {
+    const auto fields = split_fields(line);
+
+    // the job runs with the server's options but its own command and paths
+    options job_opts = opts;
+    const fs::path path = fields.size() > 1 ? fs::u8path(fields[1]) : fs::path();
+    job_opts.saves_dir = path.parent_path();
+    job_opts.out_dir = fields.size() > 2 ? fs::u8path(fields[2]) : fs::path();
+
+    job_result res;
+    if (!parse_command(fs::u8path(fields[0]).wstring(), job_opts.cmd)
+      || job_opts.cmd == command_e::index || job_opts.cmd == command_e::roundtrip
+      || job_opts.cmd == command_e::serve || path.empty())
+    {
+      res.info = fmt::format("invalid request \"{}\"", line);
+    }
+    else
+    {
+      op_status status = true;
+      if (job_opts.cmd == command_e::patch)
+      {
+        status = fields.size() > 3
+          ? job_opts.patch.load(fs::u8path(fields[3]))
+          : op_status(std::string("missing patch file"));
+      }
+
+      if (!status)
+        res.info = fmt::format("couldn't load the patch: {}", status.err());
+      else
+        res = run_job(job_opts, path);
+    }
+
+    reply = format_result(res, path);
+  }
+
+  DWORD written = 0;
+  WriteFile(pipe, reply.data(), (DWORD)reply.size(), &written, nullptr);
+  FlushFileBuffers(pipe);
+  DisconnectNamedPipe(pipe);
+  CloseHandle(pipe);
+
+  std::lock_guard<std::mutex> lock(print_mtx);
+  fmt::print("{}", reply);
+
+  return keep_serving;
+}
+
+// accepts the clients of the pipe on this thread and runs their jobs on a
+// pool of opts.workers_cnt threads. the databases are loaded once by wmain,
+// so a job only pays for its save.
+static int run_server(const options& opts)
+{
+  const std::wstring pipe_name = full_pipe_name(opts.saves_dir);
+
+  cp::task_pool pool;
+  pool.start(opts.workers_cnt);
+
+  std::atomic<bool> stopping = false;
+  std::mutex print_mtx;
+
+  fmt::print("serving {} with {} worker(s)\n", fs::path(pipe_name).string(),
+    cp::resolve_workers_count(opts.workers_cnt, SIZE_MAX));
+
+  while (!stopping)
+  {
+    HANDLE pipe = CreateNamedPipeW(pipe_name.c_str(), PIPE_ACCESS_DUPLEX,
+      PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+      PIPE_UNLIMITED_INSTANCES, 0x10000, 0x10000, 0, nullptr);
+    if (pipe == INVALID_HANDLE_VALUE)
+    {
+      SPDLOG_ERROR("couldn't create pipe {}: {}", fs::path(pipe_name).string(), GetLastError());
+      return -1;
+    }
+
+    if (!ConnectNamedPipe(pipe, nullptr) && GetLastError() != ERROR_PIPE_CONNECTED)
+    {
+      CloseHandle(pipe);
+      continue;
+    }
+
+    if (stopping)
+    {
+      CloseHandle(pipe);
+      break;
+    }
+
+    pool.submit([&, pipe]()
+    {
+      if (!serve_client(opts, pipe, print_mtx) && !stopping.exchange(true))
+      {
+        // wakes up the accepting thread
+        HANDLE h = CreateFileW(pipe_name.c_str(), GENERIC_READ, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+        if (h != INVALID_HANDLE_VALUE)
+          CloseHandle(h);
+      }
+    });
+  }
+
+  // lets the queued jobs finish
+  pool.join();
+  return 0;
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+  options opts;
+  if (!parse_args(argc, argv, opts))
+  {
+    print_usage();
+    return -1;
+  }
+
+  // a pipelined job parses as many systems at once as there are free
+  // workers, whether it fits in the limit would depend on the scheduling
+  if (opts.pipelined && opts.job_memory_limit)
+  {
+    SPDLOG_ERROR("-m can't be used with -P");
+    return -1;
+  }
+
+  if (opts.cmd != command_e::serve && !fs::is_directory(opts.saves_dir))
+  {
+    SPDLOG_ERROR("{} is not a directory", opts.saves_dir.string());
+    return -1;
+  }
+
+  if (!opts.trace_path.empty())
+    cp::trace_recorder::get().start(opts.trace_path, true);
+  else
+    cp::trace_recorder::get().start_from_env();
+
+  if (!cp::init_cpinternals())
+  {
+    SPDLOG_ERROR("couldn't init cpinternals");
+    return -1;
+  }
+
+  if (opts.cmd == command_e::index)
+    return run_index(opts);
+
+  if (opts.cmd == command_e::patch)
+  {
+    op_status status = opts.patch_path.empty()
+      ? op_status(std::string("missing patch file (-p)"))
+      : opts.patch.load(opts.patch_path);
+    if (!status)
+    {
+      SPDLOG_ERROR("couldn't load the patch: {}", status.err());
+      return -1;
+    }
+  }
+
+  cp::preload_blueprints();
+
+  if (opts.cmd == command_e::serve)
+    return run_server(opts);
+
+  if (opts.cmd == command_e::roundtrip)
+    return run_roundtrip(opts);
+
+  const auto saves = find_saves(opts.saves_dir);
+  fmt::print("{} save(s) found, using {} worker(s)\n",
+    saves.size(), cp::resolve_workers_count(opts.workers_cnt, saves.size()));
+
+  std::vector<job_result> results(saves.size());
+  std::mutex print_mtx;
+
+  const auto batch_start = clock_type::now();
+
+  cp::parallel_for(saves.size(), opts.workers_cnt, [&](size_t i)
+  {
+    results[i] = run_job(opts, saves[i]);
+    const std::string line = format_result(results[i], saves[i]);
+
+    std::lock_guard<std::mutex> lock(print_mtx);
+    fmt::print("{}", line);
+  });
+
+  const double batch_ms = elapsed_ms(batch_start);
+
+  size_t failed_cnt = 0;
+  double total_load_ms = 0, total_save_ms = 0;
+  for (const auto& r : results)
+  {
+    failed_cnt += r.ok ? 0 : 1;
+    total_load_ms += r.load_ms;
+    total_save_ms += r.save_ms;
+  }
+
+  fmt::print("done in {:.1f}ms: {} ok, {} failed (cumulated load:{:.1f}ms save:{:.1f}ms)\n",
+    batch_ms, saves.size() - failed_cnt, failed_cnt, total_load_ms, total_save_ms);
+
+  return failed_cnt ? 1 : 0;
+}
+
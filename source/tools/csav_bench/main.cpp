@@ -0,0 +1,283 @@
+#define NOMINMAX
+#include <Windows.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdlib>
+#include <algorithm>
+#include <filesystem>
+
+#include <spdlog/spdlog.h>
+#include <cpinternals/init.hpp>
+#include <cpinternals/csav.hpp>
+#include <cpinternals/io/memory_ostream.hpp>
+#include <cpinternals/common/instrumentation.hpp>
+#include <cpinternals/common/alloc_profiler.hpp>
+
+#include <tools/common/counting_new.hpp>
+
+namespace fs = std::filesystem;
+
+// per-phase timings of csav load and save on a corpus of saves
+// usage: csav_bench <corpus_dir> [-n iterations] [-j workers]
+//
+// the corpus is any directory tree containing sav.dat files (game saves
+// aren't redistributable, so none are committed).
+
+//--------------------------------------------------------
+// stats
+
+struct options
+{
+  fs::path corpus_dir;
+  size_t iterations_cnt = 5;
+  size_t workers_cnt = 1;
+};
+
+struct phase_stats
+{
+  size_t samples_cnt = 0;
+  double total_ms = 0;
+  double min_ms = 0;
+  double max_ms = 0;
+  uint64_t total_allocs = 0;
+
+  void add_sample(double ms, uint64_t allocs)
+  {
+    if (samples_cnt == 0 || ms < min_ms)
+      min_ms = ms;
+    if (samples_cnt == 0 || ms > max_ms)
+      max_ms = ms;
+    ++samples_cnt;
+    total_ms += ms;
+    total_allocs += allocs;
+  }
+
+  double mean_ms() const
+  {
+    return samples_cnt ? total_ms / samples_cnt : 0;
+  }
+
+  uint64_t mean_allocs() const
+  {
+    return samples_cnt ? total_allocs / samples_cnt : 0;
+  }
+};
+
+// sums spans by name over one iteration (chunk spans are reported per chunk)
+struct iteration_sink
+  : cp::span_sink
+{
+  struct accum
+  {
+    double ms = 0;
+    uint64_t allocs = 0;
+  };
+
+  void on_span(const cp::span_record& rec) override
+  {
+    auto& a = rec.label.empty() ? phases[rec.name] : phases[fmt::format("{} ({})", rec.name, rec.label)];
+    a.ms += rec.duration_ms;
+    a.allocs += rec.allocs_cnt;
+  }
+
+  std::map<std::string, accum> phases;
+};
+
+using phases_stats = std::map<std::string, phase_stats>;
+
+static void print_usage()
+{
+  fmt::print(
+    "usage: csav_bench <corpus_dir> [-n iterations] [-j workers]\n"
+    "  -n  iterations per save (default: 5)\n"
+    "  -j  threads used to (de)compress chunks (default: 1, allocations of\n"
+    "      worker threads aren't counted)\n");
+}
+
+static bool parse_args(int argc, wchar_t* argv[], options& opts)
+{
+  if (argc < 2)
+    return false;
+
+  opts.corpus_dir = argv[1];
+
+  for (int i = 2; i < argc; ++i)
+  {
+    const std::wstring arg = argv[i];
+    if (arg == L"-n" && i + 1 < argc)
+    {
+      opts.iterations_cnt = std::max<size_t>(1, std::wcstoul(argv[++i], nullptr, 10));
+    }
+    else if (arg == L"-j" && i + 1 < argc)
+    {
+      opts.workers_cnt = (size_t)std::wcstoul(argv[++i], nullptr, 10);
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static std::vector<fs::path> find_saves(const fs::path& dir)
+{
+  std::vector<fs::path> ret;
+
+  std::error_code ec;
+  for (auto it = fs::recursive_directory_iterator(dir, ec); it != fs::recursive_directory_iterator(); it.increment(ec))
+  {
+    if (ec)
+      break;
+    if (it->is_regular_file() && it->path().filename() == L"sav.dat")
+      ret.emplace_back(it->path());
+  }
+
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
+// one load + systems + save round, returns false on failure
+// out is reused across iterations (it keeps its memory)
+static bool run_iteration(const options& opts, const fs::path& path, iteration_sink& sink, cp::memory_ostream& out)
+{
+  cp::scoped_span_sink sink_guard(&sink);
+
+  cp::savegame save;
+  save.interactive = false;
+  save.tree.set_workers_count(opts.workers_cnt);
+
+  {
+    cp::scoped_span span("load.total");
+    if (!save.tree.load(path))
+    {
+      SPDLOG_ERROR("{}: couldn't load node tree", path.string());
+      return false;
+    }
+  }
+
+  const auto& ver = save.tree.ver();
+  for (const auto& [name, var] : save.systems())
+  {
+    auto node = save.tree.find_node(name);
+    if (!node)
+      continue;
+
+    bool loaded = false;
+    try
+    {
+      cp::scoped_span span("sys.from_node", name);
+      loaded = var->from_node(node, ver);
+    }
+    catch (std::exception& e)
+    {
+      SPDLOG_ERROR("{}: couldn't load {}, reason: {}", path.string(), name, e.what());
+    }
+
+    if (!loaded)
+      continue;
+
+    cp::scoped_span span("sys.to_node", name);
+    var->to_node(ver);
+  }
+
+  // saves to memory to leave the disk out of the loop
+  out.clear();
+  {
+    cp::scoped_span span("save.total");
+    out << save.tree;
+    if (out.has_error())
+    {
+      SPDLOG_ERROR("{}: couldn't save node tree, reason: {}", path.string(), out.error());
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void print_stats(const phases_stats& stats)
+{
+  fmt::print("  {:<52} {:>10} {:>10} {:>10} {:>12}\n", "phase", "mean ms", "min ms", "max ms", "allocs");
+  for (const auto& [name, ps] : stats)
+  {
+    fmt::print("  {:<52} {:>10.3f} {:>10.3f} {:>10.3f} {:>12}\n",
+      name, ps.mean_ms(), ps.min_ms, ps.max_ms, ps.mean_allocs());
+  }
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+  options opts;
+  if (!parse_args(argc, argv, opts))
+  {
+    print_usage();
+    return -1;
+  }
+
+  if (!fs::is_directory(opts.corpus_dir))
+  {
+    SPDLOG_ERROR("{} is not a directory", opts.corpus_dir.string());
+    return -1;
+  }
+
+  if (!cp::init_cpinternals())
+  {
+    SPDLOG_ERROR("couldn't init cpinternals");
+    return -1;
+  }
+
+  // keep the blueprints db loading out of the first iteration
+  CObjectBPList::get();
+
+  cp::set_allocs_counter(&thread_allocs_count);
+  cp::alloc_profiler::get().reset();
+
+  const auto saves = find_saves(opts.corpus_dir);
+  fmt::print("{} save(s) found, {} iteration(s) each\n", saves.size(), opts.iterations_cnt);
+
+  phases_stats corpus_stats;
+  size_t failed_cnt = 0;
+  cp::memory_ostream out;
+
+  for (const auto& path : saves)
+  {
+    phases_stats file_stats;
+    bool failed = false;
+
+    for (size_t i = 0; i < opts.iterations_cnt && !failed; ++i)
+    {
+      iteration_sink sink;
+      failed = !run_iteration(opts, path, sink, out);
+
+      for (const auto& [name, a] : sink.phases)
+      {
+        file_stats[name].add_sample(a.ms, a.allocs);
+        corpus_stats[name].add_sample(a.ms, a.allocs);
+      }
+    }
+
+    failed_cnt += failed ? 1 : 0;
+
+    fmt::print("{}{}\n", path.string(), failed ? " (FAILED)" : "");
+    print_stats(file_stats);
+  }
+
+  if (saves.size() > 1)
+  {
+    fmt::print("corpus ({} ok, {} failed)\n", saves.size() - failed_cnt, failed_cnt);
+    print_stats(corpus_stats);
+  }
+
+  // by subsystem, when built with CP_ENABLE_ALLOC_PROFILER
+  if constexpr (cp::alloc_profiler_compiled)
+  {
+    auto& profiler = cp::alloc_profiler::get();
+    fmt::print("\n{}", cp::alloc_profiler::report(profiler.take_snapshot()));
+  }
+
+  return failed_cnt ? 1 : 0;
+}
+
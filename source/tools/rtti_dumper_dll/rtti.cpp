@@ -1,9 +1,12 @@
 #include <tools/rtti_dumper_dll/rtti.hpp>
 
 #include <shlobj.h>
+#include <chrono>
 #include <filesystem>
 #include <fstream>
 
+#include <cpinternals/asset_db_format.hpp>
+
 namespace dumper {
 
 CRTTISystem* CRTTISystem::Get()
@@ -68,6 +71,17 @@ using record_map_type = std::unordered_map<uint64_t, std::shared_ptr<BaseRecord>
 
 record_map_type g_typerecs;
 
+// the binary dump, same dbs as the json ones compiled by cpdb_compiler
+// (see asset_db_format.hpp). the apps map them without parsing.
+struct db_writer
+{
+  cp::asset_db::db_builder classes{cp::asset_db::db_kind::classes};
+  cp::asset_db::db_builder enums{cp::asset_db::db_kind::enums};
+
+  // of the written classes
+  std::unordered_map<const BaseRecord*, uint32_t> class_indices;
+};
+
 
 struct TypeRecord
   : BaseRecord
@@ -103,9 +117,20 @@ struct ClassRecord
 
   std::vector<std::unique_ptr<PropertyRecord>> props;
 
+  const char* label() const
+  {
+    return name.hash != 0 ? name.ToString() : "";
+  }
+
   // expects the root json
   void dump(nlohmann::json& j) override
   {
+    auto label = this->label();
+
+    // already dumped as a parent
+    if (j.contains(label))
+      return;
+
     auto jc = nlohmann::json::object();
 
     if (parent)
@@ -114,10 +139,6 @@ struct ClassRecord
       jc["parent"] = parent->name.ToString();
     }
 
-    auto label = "";
-    if (name.hash != 0)
-      label = name.ToString();
-
     jc["ctypename"] = label;
 
     nlohmann::json jprops = nlohmann::json::array();
@@ -132,6 +153,33 @@ struct ClassRecord
 
     j[label] = jc;
   }
+
+  // returns the index of the class in the db
+  uint32_t write(db_writer& w)
+  {
+    auto it = w.class_indices.find(this);
+    if (it != w.class_indices.end())
+      return it->second;
+
+    // parents come first
+    uint32_t parent_idx = cp::asset_db::npos;
+    if (parent)
+      parent_idx = parent->write(w);
+
+    auto& db = w.classes;
+    db.push(db.intern(label()));
+    db.push(parent_idx);
+    db.push((uint32_t)props.size());
+    for (auto& prop : props)
+    {
+      db.push(db.intern(prop->name.ToString()));
+      db.push(db.intern(prop->type ? prop->type->name.ToString() : ""));
+    }
+
+    const uint32_t idx = (uint32_t)w.class_indices.size();
+    w.class_indices.emplace(this, idx);
+    return idx;
+  }
 };
 
 struct EnumRecord
@@ -143,22 +191,21 @@ struct EnumRecord
     int64_t value;
   };
 
+  // sorted by value
   std::vector<Member> members;
   std::vector<Member> members2;
 
+  // the _TEST members are a separate record
+  size_t db_records_cnt() const
+  {
+    return members2.empty() ? 1 : 2;
+  }
+
   // expects the root json
   void dump(nlohmann::json& j) override
   {
     //file << "enum " << name.ToString() << std::endl;
 
-    std::sort(members.begin(), members.end(),
-      [](auto& lhs, auto& rhs) { return lhs.value < rhs.value; }
-    );
-
-    std::sort(members2.begin(), members2.end(),
-      [](auto& lhs, auto& rhs) { return lhs.value < rhs.value; }
-    );
-
     nlohmann::json jmbrs = nlohmann::json::array();
 
     for (auto& member : members)
@@ -184,6 +231,29 @@ struct EnumRecord
       j[sname + std::string("_TEST")] = jmbrs2;
     }
   }
+
+  void write(db_writer& w)
+  {
+    auto sname = name.ToString();
+
+    write_members(w.enums, sname, members);
+
+    if (!members2.empty())
+    {
+      write_members(w.enums, sname + std::string("_TEST"), members2);
+    }
+  }
+
+protected:
+  static void write_members(cp::asset_db::db_builder& db, std::string_view name, const std::vector<Member>& mbrs)
+  {
+    db.push(db.intern(name));
+    db.push((uint32_t)mbrs.size());
+    for (auto& member : mbrs)
+    {
+      db.push(db.intern(member.enumerator.ToString()));
+    }
+  }
 };
 
 std::pair<record_map_type::iterator, bool>
@@ -267,6 +337,14 @@ proc_enum(CEnum* enm)
     ptr->members2.emplace_back(std::move(mbr));
   }
 
+  std::sort(ptr->members.begin(), ptr->members.end(),
+    [](auto& lhs, auto& rhs) { return lhs.value < rhs.value; }
+  );
+
+  std::sort(ptr->members2.begin(), ptr->members2.end(),
+    [](auto& lhs, auto& rhs) { return lhs.value < rhs.value; }
+  );
+
   return g_typerecs.emplace(name.hash, ptr);
 }
 
@@ -293,18 +371,20 @@ void dump()
   auto rtti = CRTTISystem::Get();
   SPDLOG_INFO("dump start");
 
+  const auto start_time = std::chrono::steady_clock::now();
+
   if (!rtti)
   {
     SPDLOG_ERROR("couldn't get the rtti system");
     return;
   }
 
+  // printing each type to the console would take most of the dump time
+  size_t types_cnt = 0;
   rtti->types.for_each(
-    [](CName name, IRTTIType* typ)
+    [&types_cnt](CName name, IRTTIType* typ)
     {
-      typ->GetName(name);
-
-      SPDLOG_INFO(name.ToString());
+      ++types_cnt;
 
       if (typ->GetType() == ERTTIType::Class)
       {
@@ -317,6 +397,47 @@ void dump()
     }
   );
 
+  SPDLOG_INFO("processed {} types", types_cnt);
+
+  // binary dump first, the json one is for the repo's db files and diffs
+  {
+    db_writer w;
+
+    uint32_t classes_cnt = 0, enums_cnt = 0;
+    for (auto& i : g_typerecs)
+    {
+      if (std::dynamic_pointer_cast<ClassRecord>(i.second))
+        ++classes_cnt;
+      else if (auto enm = std::dynamic_pointer_cast<EnumRecord>(i.second))
+        enums_cnt += (uint32_t)enm->db_records_cnt();
+    }
+
+    w.classes.push(classes_cnt);
+    w.enums.push(enums_cnt);
+
+    for (auto& i : g_typerecs)
+    {
+      auto& ptr = i.second;
+      if (auto cls = std::dynamic_pointer_cast<ClassRecord>(ptr))
+      {
+        cls->write(w);
+      }
+      else if (auto enm = std::dynamic_pointer_cast<EnumRecord>(ptr))
+      {
+        enm->write(w);
+      }
+    }
+
+    // null stamps: loaded as is by the apps, even next to an older json
+    if (!w.classes.write(path / L"CObjectBPs.cpdb"))
+      SPDLOG_ERROR("couldn't write CObjectBPs.cpdb");
+
+    if (!w.enums.write(path / L"CEnums.cpdb"))
+      SPDLOG_ERROR("couldn't write CEnums.cpdb");
+
+    SPDLOG_INFO("binary dump written ({} classes, {} enums)", classes_cnt, enums_cnt);
+  }
+
   nlohmann::json jenums = nlohmann::json::object();
   nlohmann::json jclasses = nlohmann::json::object();
   nlohmann::json jglob = nlohmann::json::object();
@@ -344,7 +465,8 @@ void dump()
     file << jenums.dump(2);
   }
 
-  SPDLOG_INFO("dump finished");
+  const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time);
+  SPDLOG_INFO("dump finished in {:.0f}ms", elapsed.count());
 }
 
 } // namespace dumper
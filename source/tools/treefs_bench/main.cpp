@@ -0,0 +1,573 @@
+#define NOMINMAX
+#include <Windows.h>
+#include <Psapi.h>
+#include <string>
+#include <vector>
+#include <array>
+#include <chrono>
+#include <random>
+#include <memory>
+#include <fstream>
+#include <cstdlib>
+#include <algorithm>
+#include <filesystem>
+
+#include <spdlog/spdlog.h>
+#include <cpinternals/common/latency_histogram.hpp>
+#include <cpinternals/io/file_ostream.hpp>
+#include <cpinternals/filesystem/treefs.hpp>
+#include <cpinternals/filesystem/ardb_builder.hpp>
+#include <cpinternals/filesystem/directory_entry.hpp>
+#include <cpinternals/filesystem/directory_iterator.hpp>
+
+namespace fs = std::filesystem;
+namespace cpfs = cp::filesystem;
+
+// mount and lookup timings of treefs, the numbers cpfs users feel
+// usage: treefs_bench [-a ardbs_dir] [-c content_dir] [-s entries] [-n lookups] [-t trace] [-f text|json]
+//
+// trees:
+//  - ardbs: every ardb of ardbs_dir (e.g. assets/ardbs) loaded in one tree,
+//  - archives: every archive of content_dir (load_archive, their ardbs are
+//    looked up in ./ardbs as usual), then compacted,
+//  - synthetic: a generated ardb of the given count of entries.
+// on each tree: existing and missing path lookups (has_entry), directory_entry
+// assign by path, directory_iterator scans of every directory, and the replay
+// of a trace if one is given.
+// traces are the call lines cpfs prints when built with PRINT_CALL_ARGS:
+// "Open <path> ..." and "GetSecurityByName <path>" lines are replayed as
+// directory_entry assigns, "ReadDirectory(.., \"<path>\", ..." lines as scans,
+// other lines are ignored.
+// json output is one object per line (tree x operation).
+
+using clock_type = std::chrono::steady_clock;
+
+struct options
+{
+  fs::path ardbs_dir;
+  fs::path content_dir;
+  size_t synthetic_entries_cnt = 0;
+  size_t lookups_cnt = 100000;
+  fs::path trace_path;
+  bool json = false;
+};
+
+//--------------------------------------------------------
+// stats
+
+struct memory_usage
+{
+  uint64_t working_set = 0;
+  uint64_t peak_working_set = 0;
+  uint64_t private_bytes = 0;
+};
+
+static memory_usage get_memory_usage()
+{
+  memory_usage ret;
+
+  PROCESS_MEMORY_COUNTERS pmc = {};
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+  {
+    ret.working_set = pmc.WorkingSetSize;
+    ret.peak_working_set = pmc.PeakWorkingSetSize;
+    ret.private_bytes = pmc.PagefileUsage;
+  }
+
+  return ret;
+}
+
+struct op_result
+{
+  std::string tree;
+  std::string op;
+  uint64_t items = 0; // misses for lookups, entries for scans
+  double wall_s = 0;
+  memory_usage mem;
+  cp::latency_histogram latencies;
+};
+
+static uint64_t elapsed_ns(clock_type::time_point start)
+{
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start).count());
+}
+
+static double elapsed_s(clock_type::time_point start)
+{
+  return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+static void print_result(const op_result& r, bool json)
+{
+  if (json)
+  {
+    fmt::print(
+      "{{\"tree\":\"{}\",\"op\":\"{}\",\"calls\":{},\"items\":{},\"wall_s\":{:.6f},\"mean_us\":{:.3f},"
+      "\"p50_us\":{:.3f},\"p90_us\":{:.3f},\"p99_us\":{:.3f},\"max_us\":{:.3f},"
+      "\"working_set\":{},\"peak_working_set\":{},\"private_bytes\":{}}}\n",
+      r.tree, r.op, r.latencies.count, r.items, r.wall_s, r.latencies.mean() / 1000.0,
+      r.latencies.percentile(0.5) / 1000.0, r.latencies.percentile(0.9) / 1000.0, r.latencies.percentile(0.99) / 1000.0,
+      r.latencies.max / 1000.0, r.mem.working_set, r.mem.peak_working_set, r.mem.private_bytes);
+    return;
+  }
+
+  fmt::print("  {:<22}{:>10}{:>12}{:>12.3f}{:>10.2f}{:>10.2f}{:>10.2f}{:>12.1f}{:>10}{:>10}\n",
+    r.op, r.latencies.count, r.items, r.wall_s,
+    r.latencies.percentile(0.5) / 1000.0, r.latencies.percentile(0.9) / 1000.0, r.latencies.percentile(0.99) / 1000.0,
+    r.latencies.max / 1000.0, r.mem.working_set >> 20, r.mem.peak_working_set >> 20);
+}
+
+static void print_header(std::string_view tree, bool json)
+{
+  if (json)
+    return;
+
+  fmt::print("{}\n", tree);
+  fmt::print("  {:<22}{:>10}{:>12}{:>12}{:>10}{:>10}{:>10}{:>12}{:>10}{:>10}\n",
+    "op", "calls", "items", "wall s", "p50 us", "p90 us", "p99 us", "max us", "ws MB", "peak MB");
+}
+
+//--------------------------------------------------------
+// synthetic ardb
+
+using cpfs::ardb_header;
+using cpfs::ardb_record;
+
+// root, then directories fanout by fanout, then files spread over the
+// directories (~1 directory per 64 entries)
+static bool write_synthetic_ardb(const fs::path& p, size_t entries_cnt)
+{
+  static constexpr uint32_t fanout = 32;
+
+  const uint32_t dirs_cnt = static_cast<uint32_t>(std::max<size_t>(2, entries_cnt / 64));
+  const uint32_t files_cnt = static_cast<uint32_t>(entries_cnt > dirs_cnt ? entries_cnt - dirs_cnt : 0);
+  const uint32_t files_per_dir = (files_cnt + dirs_cnt - 1) / dirs_cnt;
+
+  // "" (root), d0..d31, then f0.bin..
+  std::vector<std::string> names;
+  names.emplace_back();
+  for (uint32_t i = 0; i < fanout; ++i)
+    names.emplace_back(fmt::format("d{}", i));
+  const uint32_t dirnames_cnt = static_cast<uint32_t>(names.size());
+  for (uint32_t i = 0; i < files_per_dir; ++i)
+    names.emplace_back(fmt::format("f{}.bin", i));
+
+  std::vector<ardb_record> recs;
+  recs.reserve(dirs_cnt + files_cnt);
+  recs.push_back({0, -1});
+  for (uint32_t j = 1; j < dirs_cnt; ++j)
+    recs.push_back({1 + (j - 1) % fanout, static_cast<int32_t>((j - 1) / fanout)});
+  for (uint32_t k = 0; k < files_cnt; ++k)
+    recs.push_back({dirnames_cnt + k / dirs_cnt, static_cast<int32_t>(k % dirs_cnt)});
+
+  ardb_header hdr;
+  hdr.names_cnt = static_cast<uint32_t>(names.size());
+  hdr.dirnames_cnt = dirnames_cnt;
+  hdr.entries_cnt = static_cast<uint32_t>(recs.size());
+
+  cp::file_ostream ofs(p);
+  ofs.serialize_pod_raw(hdr);
+  for (auto& name : names)
+    ofs.serialize_str_lpfxd(name);
+  ofs.serialize_pods_array_raw(recs.data(), recs.size());
+
+  return !ofs.has_error();
+}
+
+//--------------------------------------------------------
+// lookups
+
+struct tree_sample
+{
+  std::vector<cp::path> paths;
+  std::vector<cp::path> dir_paths;
+};
+
+// every entry of the tree, in iteration order
+static tree_sample sample_tree(const cpfs::treefs& tfs)
+{
+  tree_sample ret;
+  ret.dir_paths.emplace_back();
+
+  cpfs::recursive_directory_iterator it(tfs, cp::path());
+  for (const auto& dirent : it)
+  {
+    ret.paths.emplace_back(dirent.tfs_path());
+    if (dirent.is_directory())
+      ret.dir_paths.emplace_back(ret.paths.back());
+  }
+
+  return ret;
+}
+
+static void run_lookups(const cpfs::treefs& tfs, const tree_sample& sample, const options& opts, std::vector<op_result>& results)
+{
+  if (sample.paths.empty())
+    return;
+
+  std::mt19937_64 rng(0x5EED);
+  std::vector<cp::path_id> pids;
+  std::vector<const cp::path*> paths;
+  pids.reserve(opts.lookups_cnt);
+  paths.reserve(opts.lookups_cnt);
+  for (size_t i = 0; i < opts.lookups_cnt; ++i)
+  {
+    paths.push_back(&sample.paths[rng() % sample.paths.size()]);
+    pids.emplace_back(*paths.back());
+  }
+
+  {
+    auto& r = results.emplace_back();
+    r.op = "has_entry";
+    const auto wall_start = clock_type::now();
+    for (const auto& pid : pids)
+    {
+      const auto start = clock_type::now();
+      r.items += tfs.has_entry(pid) ? 0 : 1;
+      r.latencies.record(elapsed_ns(start));
+    }
+    r.wall_s = elapsed_s(wall_start);
+  }
+
+  {
+    auto& r = results.emplace_back();
+    r.op = "has_entry (miss)";
+    const auto wall_start = clock_type::now();
+    for (size_t i = 0; i < opts.lookups_cnt; ++i)
+    {
+      const cp::path_id pid(rng());
+      const auto start = clock_type::now();
+      r.items += tfs.has_entry(pid) ? 0 : 1;
+      r.latencies.record(elapsed_ns(start));
+    }
+    r.wall_s = elapsed_s(wall_start);
+  }
+
+  {
+    auto& r = results.emplace_back();
+    r.op = "directory_entry";
+    cpfs::directory_entry dirent(tfs);
+    const auto wall_start = clock_type::now();
+    for (const cp::path* p : paths)
+    {
+      const auto start = clock_type::now();
+      dirent.assign(*p);
+      r.items += dirent.exists() ? 0 : 1;
+      r.latencies.record(elapsed_ns(start));
+    }
+    r.wall_s = elapsed_s(wall_start);
+  }
+
+  {
+    auto& r = results.emplace_back();
+    r.op = "directory_iterator";
+    const auto wall_start = clock_type::now();
+    for (const auto& dir_path : sample.dir_paths)
+    {
+      const auto start = clock_type::now();
+      for (const auto& dirent : cpfs::directory_iterator(tfs, dir_path))
+      {
+        (void)dirent;
+        ++r.items;
+      }
+      r.latencies.record(elapsed_ns(start));
+    }
+    r.wall_s = elapsed_s(wall_start);
+  }
+}
+
+//--------------------------------------------------------
+// trace replay
+
+enum class trace_op
+{
+  open,
+  stat,
+  list,
+};
+
+struct trace_record
+{
+  trace_op op;
+  cp::path p;
+};
+
+static std::vector<trace_record> load_trace(const fs::path& trace_path)
+{
+  std::vector<trace_record> ret;
+
+  std::ifstream ifs(trace_path);
+  std::string line;
+  while (std::getline(ifs, line))
+  {
+    const std::string_view sv = line;
+    trace_op op;
+    std::string_view spath;
+
+    if (cp::starts_with(line, "Open "))
+    {
+      op = trace_op::open;
+      spath = sv.substr(5);
+      spath = spath.substr(0, spath.find(" CreateOptions:"));
+    }
+    else if (cp::starts_with(line, "GetSecurityByName "))
+    {
+      op = trace_op::stat;
+      spath = sv.substr(18);
+    }
+    else if (cp::starts_with(line, "ReadDirectory(.., \""))
+    {
+      op = trace_op::list;
+      spath = sv.substr(19);
+      spath = spath.substr(0, spath.find('"'));
+    }
+    else
+    {
+      continue;
+    }
+
+    bool ok = false;
+    cp::path p(spath, ok);
+    if (ok)
+      ret.push_back({op, std::move(p)});
+  }
+
+  return ret;
+}
+
+static void run_replay(const cpfs::treefs& tfs, const std::vector<trace_record>& trace, std::vector<op_result>& results)
+{
+  if (trace.empty())
+    return;
+
+  const size_t first_idx = results.size();
+  results.resize(first_idx + 3);
+  auto& r_open = results[first_idx];
+  r_open.op = "replay open";
+  auto& r_stat = results[first_idx + 1];
+  r_stat.op = "replay stat";
+  auto& r_list = results[first_idx + 2];
+  r_list.op = "replay list";
+
+  cpfs::directory_entry dirent(tfs);
+  const auto wall_start = clock_type::now();
+  for (const auto& rec : trace)
+  {
+    const auto start = clock_type::now();
+    switch (rec.op)
+    {
+      case trace_op::open:
+        dirent.assign(rec.p);
+        r_open.items += dirent.exists() ? 0 : 1;
+        r_open.latencies.record(elapsed_ns(start));
+        break;
+      case trace_op::stat:
+        dirent.assign(rec.p);
+        r_stat.items += dirent.exists() ? 0 : 1;
+        r_stat.latencies.record(elapsed_ns(start));
+        break;
+      case trace_op::list:
+        for (const auto& child : cpfs::directory_iterator(tfs, rec.p))
+        {
+          (void)child;
+          ++r_list.items;
+        }
+        r_list.latencies.record(elapsed_ns(start));
+        break;
+    }
+  }
+
+  // all three ran interleaved
+  const double wall_s = elapsed_s(wall_start);
+  r_open.wall_s = r_stat.wall_s = r_list.wall_s = wall_s;
+}
+
+//--------------------------------------------------------
+
+static void print_usage()
+{
+  fmt::print(
+    "usage: treefs_bench [-a ardbs_dir] [-c content_dir] [-s entries] [-n lookups] [-t trace] [-f text|json]\n"
+    "  -a  loads every ardb of the directory (e.g. assets/ardbs)\n"
+    "  -c  loads every archive of the directory (ardbs from ./ardbs)\n"
+    "  -s  generates a tree of that many entries (e.g. 1000000)\n"
+    "  -n  lookups per lookup benchmark (default: 100000)\n"
+    "  -t  replays the cpfs call lines of a trace on each tree\n"
+    "  -f  output format (default: text), json is one object per line\n");
+}
+
+static bool parse_args(int argc, wchar_t* argv[], options& opts)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::wstring arg = argv[i];
+    if (i + 1 >= argc)
+    {
+      return false;
+    }
+    else if (arg == L"-a")
+    {
+      opts.ardbs_dir = argv[++i];
+    }
+    else if (arg == L"-c")
+    {
+      opts.content_dir = argv[++i];
+    }
+    else if (arg == L"-s")
+    {
+      opts.synthetic_entries_cnt = std::wcstoul(argv[++i], nullptr, 10);
+    }
+    else if (arg == L"-n")
+    {
+      opts.lookups_cnt = std::max<size_t>(1, std::wcstoul(argv[++i], nullptr, 10));
+    }
+    else if (arg == L"-t")
+    {
+      opts.trace_path = argv[++i];
+    }
+    else if (arg == L"-f")
+    {
+      const std::wstring fmt_name = argv[++i];
+      if (fmt_name == L"json")
+        opts.json = true;
+      else if (fmt_name != L"text")
+        return false;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  return !opts.ardbs_dir.empty() || !opts.content_dir.empty() || opts.synthetic_entries_cnt;
+}
+
+static std::vector<fs::path> list_files(const fs::path& dir, std::wstring_view ext)
+{
+  std::vector<fs::path> ret;
+
+  std::error_code ec;
+  for (auto it = fs::directory_iterator(dir, ec); it != fs::directory_iterator(); it.increment(ec))
+  {
+    if (ec)
+      break;
+    if (it->is_regular_file() && it->path().extension() == ext)
+      ret.emplace_back(it->path());
+  }
+
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
+// loads a tree with load_fn (which adds its load results), then runs the
+// lookups and the replay on it
+template <typename LoadFn>
+static bool bench_tree(std::string_view tree_name, const options& opts, const std::vector<trace_record>& trace, LoadFn&& load_fn)
+{
+  std::vector<op_result> results;
+  auto tfs = std::make_unique<cpfs::treefs>();
+
+  const bool loaded = load_fn(*tfs, results);
+  if (loaded)
+  {
+    const auto sample = sample_tree(*tfs);
+    run_lookups(*tfs, sample, opts, results);
+    run_replay(*tfs, trace, results);
+  }
+
+  print_header(tree_name, opts.json);
+  for (auto& r : results)
+  {
+    r.tree = tree_name;
+    if (!r.mem.working_set)
+      r.mem = get_memory_usage();
+    print_result(r, opts.json);
+  }
+
+  return loaded;
+}
+
+// times one load step and records the memory right after it
+template <typename StepFn>
+static bool timed_step(std::vector<op_result>& results, std::string op, StepFn&& step_fn)
+{
+  auto& r = results.emplace_back();
+  r.op = std::move(op);
+
+  const auto start = clock_type::now();
+  const bool ok = step_fn();
+  const uint64_t ns = elapsed_ns(start);
+
+  r.latencies.record(ns);
+  r.wall_s = double(ns) / 1e9;
+  r.items = ok ? 0 : 1;
+  r.mem = get_memory_usage();
+  return ok;
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+  options opts;
+  if (!parse_args(argc, argv, opts))
+  {
+    print_usage();
+    return -1;
+  }
+
+  std::vector<trace_record> trace;
+  if (!opts.trace_path.empty())
+  {
+    trace = load_trace(opts.trace_path);
+    if (trace.empty())
+    {
+      SPDLOG_ERROR("no replayable call found in {}", opts.trace_path.string());
+      return -1;
+    }
+  }
+
+  bool ok = true;
+
+  if (!opts.ardbs_dir.empty())
+  {
+    ok &= bench_tree("ardbs", opts, trace, [&](cpfs::treefs& tfs, std::vector<op_result>& results) {
+      bool ret = true;
+      for (const auto& p : list_files(opts.ardbs_dir, L".ardb"))
+        ret &= timed_step(results, "load_ardb " + p.stem().string(), [&]() { return tfs.load_ardb(p); });
+      timed_step(results, "compact", [&]() { tfs.compact(); return true; });
+      return ret;
+    });
+  }
+
+  if (!opts.content_dir.empty())
+  {
+    ok &= bench_tree("archives", opts, trace, [&](cpfs::treefs& tfs, std::vector<op_result>& results) {
+      bool ret = true;
+      for (const auto& p : list_files(opts.content_dir, L".archive"))
+        ret &= timed_step(results, "load_archive " + p.stem().string(), [&]() { return tfs.load_archive(p); });
+      timed_step(results, "compact", [&]() { tfs.compact(); return true; });
+      return ret;
+    });
+  }
+
+  if (opts.synthetic_entries_cnt)
+  {
+    const auto ardb_path = fs::temp_directory_path() / "treefs_bench_synthetic.ardb";
+    if (!write_synthetic_ardb(ardb_path, opts.synthetic_entries_cnt))
+    {
+      SPDLOG_ERROR("couldn't write {}", ardb_path.string());
+      return -1;
+    }
+
+    ok &= bench_tree(fmt::format("synthetic ({} entries)", opts.synthetic_entries_cnt), opts, trace,
+      [&](cpfs::treefs& tfs, std::vector<op_result>& results) {
+        const bool ret = timed_step(results, "load_ardb", [&]() { return tfs.load_ardb(ardb_path); });
+        timed_step(results, "compact", [&]() { tfs.compact(); return true; });
+        return ret;
+      });
+
+    std::error_code ec;
+    fs::remove(ardb_path, ec);
+  }
+
+  return ok ? 0 : 1;
+}